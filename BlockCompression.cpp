@@ -0,0 +1,678 @@
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace
+{
+	// A block as floats, one row of 16 per channel (so four pixels fit a register)
+	struct BlockPixels
+	{
+		alignas(16) float Channel[4][16];
+	};
+
+	void LoadPixels(const unsigned char* rgba, BlockPixels& px)
+	{
+		for (unsigned int i = 0; i < 16; i++)
+			for (unsigned int c = 0; c < 4; c++)
+				px.Channel[c][i] = rgba[i * 4 + c];
+	}
+
+	// --------------------------------------------------------
+	// Picks the nearest palette entry for every pixel, comparing
+	// the first channels of four pixels at once
+	// --------------------------------------------------------
+	template <typename Entry>
+	float FitIndices(const BlockPixels& px, unsigned int channels, const Entry (*palette)[4], unsigned int count, unsigned char* indices)
+	{
+		__m128 best[4];
+		__m128i bestIndex[4];
+		for (unsigned int g = 0; g < 4; g++) {
+			best[g] = _mm_set1_ps(1e30f);
+			bestIndex[g] = _mm_setzero_si128();
+		}
+
+		for (unsigned int k = 0; k < count; k++) {
+			__m128 entry[4];
+			for (unsigned int c = 0; c < channels; c++)
+				entry[c] = _mm_set1_ps(palette[k][c]);
+			__m128i index = _mm_set1_epi32((int)k);
+
+			for (unsigned int g = 0; g < 4; g++) {
+				__m128 distance = _mm_setzero_ps();
+				for (unsigned int c = 0; c < channels; c++) {
+					__m128 d = _mm_sub_ps(_mm_load_ps(&px.Channel[c][g * 4]), entry[c]);
+					distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+				}
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best[g]));
+				best[g] = _mm_min_ps(distance, best[g]);
+				bestIndex[g] = _mm_or_si128(_mm_and_si128(closer, index), _mm_andnot_si128(closer, bestIndex[g]));
+			}
+		}
+
+		alignas(16) float errors[16];
+		alignas(16) int32_t picked[16];
+		for (unsigned int g = 0; g < 4; g++) {
+			_mm_store_ps(&errors[g * 4], best[g]);
+			_mm_store_si128((__m128i*)&picked[g * 4], bestIndex[g]);
+		}
+		float total = 0;
+		for (unsigned int i = 0; i < 16; i++) {
+			indices[i] = (unsigned char)picked[i];
+			total += errors[i];
+		}
+		return total;
+	}
+
+	// --------------------------------------------------------
+	// The line through the block's colors: its mean, the axis they
+	// vary most along (power iteration on the covariance), and the
+	// two ends of the range they cover along it (within 0 to maximum)
+	// --------------------------------------------------------
+	void FitLine(const BlockPixels& px, unsigned int channels, float* start, float* end, float maximum = 255.0f)
+	{
+		float mean[4] = {};
+		for (unsigned int c = 0; c < channels; c++) {
+			for (unsigned int i = 0; i < 16; i++) mean[c] += px.Channel[c][i];
+			mean[c] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for (unsigned int i = 0; i < 16; i++)
+			for (unsigned int a = 0; a < channels; a++)
+				for (unsigned int b = a; b < channels; b++)
+					covariance[a][b] += (px.Channel[a][i] - mean[a]) * (px.Channel[b][i] - mean[b]);
+		for (unsigned int a = 0; a < channels; a++)
+			for (unsigned int b = 0; b < a; b++)
+				covariance[a][b] = covariance[b][a];
+
+		float axis[4] = { 1, 1, 1, 1 };
+		for (unsigned int iteration = 0; iteration < 8; iteration++) {
+			float next[4] = {};
+			float length = 0;
+			for (unsigned int a = 0; a < channels; a++) {
+				for (unsigned int b = 0; b < channels; b++) next[a] += covariance[a][b] * axis[b];
+				length += next[a] * next[a];
+			}
+			if (length < 1e-12f) break;		// a flat block, any axis will do
+			length = 1.0f / sqrtf(length);
+			for (unsigned int a = 0; a < channels; a++) axis[a] = next[a] * length;
+		}
+
+		float lo = 1e30f, hi = -1e30f;
+		for (unsigned int i = 0; i < 16; i++) {
+			float t = 0;
+			for (unsigned int c = 0; c < channels; c++) t += (px.Channel[c][i] - mean[c]) * axis[c];
+			lo = std::min(lo, t);
+			hi = std::max(hi, t);
+		}
+		for (unsigned int c = 0; c < channels; c++) {
+			start[c] = std::clamp(mean[c] + axis[c] * lo, 0.0f, maximum);
+			end[c] = std::clamp(mean[c] + axis[c] * hi, 0.0f, maximum);
+		}
+	}
+
+	// --------------------------------------------------------
+	// Least squares endpoints for a set of indices, where each
+	// index sits weight[index] of the way from start to end
+	// --------------------------------------------------------
+	bool RefitLine(const BlockPixels& px, unsigned int channels, const unsigned char* indices, const float* weights, float* start, float* end, float maximum = 255.0f)
+	{
+		float aa = 0, ab = 0, bb = 0;
+		float ap[4] = {}, bp[4] = {};
+		for (unsigned int i = 0; i < 16; i++) {
+			float b = weights[indices[i]];
+			float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (unsigned int c = 0; c < channels; c++) {
+				ap[c] += a * px.Channel[c][i];
+				bp[c] += b * px.Channel[c][i];
+			}
+		}
+		float det = aa * bb - ab * ab;
+		if (fabsf(det) < 1e-6f) return false;
+		for (unsigned int c = 0; c < channels; c++) {
+			start[c] = std::clamp((bb * ap[c] - ab * bp[c]) / det, 0.0f, maximum);
+			end[c] = std::clamp((aa * bp[c] - ab * ap[c]) / det, 0.0f, maximum);
+		}
+		return true;
+	}
+
+	// Writes (or reads) little endian bit fields, lowest bit first
+	struct BitStream
+	{
+		unsigned char* bytes;
+		unsigned int at;
+
+		void Write(unsigned int value, unsigned int bits)
+		{
+			for (unsigned int b = 0; b < bits; b++, at++)
+				if (value & (1u << b)) bytes[at >> 3] |= (unsigned char)(1u << (at & 7));
+		}
+		unsigned int Read(unsigned int bits)
+		{
+			unsigned int value = 0;
+			for (unsigned int b = 0; b < bits; b++, at++)
+				value |= ((bytes[at >> 3] >> (at & 7)) & 1u) << b;
+			return value;
+		}
+	};
+
+
+	// --------------------------------------------------------
+	// BC1
+	// --------------------------------------------------------
+	uint16_t Pack565(const float* color)
+	{
+		unsigned int r = (unsigned int)(color[0] * 31.0f / 255.0f + 0.5f);
+		unsigned int g = (unsigned int)(color[1] * 63.0f / 255.0f + 0.5f);
+		unsigned int b = (unsigned int)(color[2] * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)(r << 11 | g << 5 | b);
+	}
+
+	void Unpack565(uint16_t packed, unsigned char* color)
+	{
+		unsigned int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+		color[0] = (unsigned char)(r << 3 | r >> 2);
+		color[1] = (unsigned char)(g << 2 | g >> 4);
+		color[2] = (unsigned char)(b << 3 | b >> 2);
+		color[3] = 255;
+	}
+
+	void PaletteBC1(uint16_t c0, uint16_t c1, unsigned char (*palette)[4])
+	{
+		Unpack565(c0, palette[0]);
+		Unpack565(c1, palette[1]);
+		for (unsigned int c = 0; c < 3; c++) {
+			if (c0 > c1) {
+				palette[2][c] = (unsigned char)((2 * palette[0][c] + palette[1][c]) / 3);
+				palette[3][c] = (unsigned char)((palette[0][c] + 2 * palette[1][c]) / 3);
+			}
+			else {
+				palette[2][c] = (unsigned char)((palette[0][c] + palette[1][c]) / 2);
+				palette[3][c] = 0;
+			}
+		}
+		palette[2][3] = palette[3][3] = 255;
+	}
+
+	void EncodeBC1(const BlockPixels& px, unsigned char* out)
+	{
+		// where each index sits between the endpoints (4 color mode)
+		static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		float start[4], end[4];
+		FitLine(px, 3, start, end);
+
+		float bestError = 1e30f;
+		for (unsigned int pass = 0; pass < 2; pass++) {
+			uint16_t c0 = Pack565(end);
+			uint16_t c1 = Pack565(start);
+			bool swapped = c0 < c1;
+			if (swapped) std::swap(c0, c1);		// keeps 4 color mode
+
+			unsigned char palette[4][4];
+			unsigned char indices[16];
+			PaletteBC1(c0, c1, palette);
+			float error = FitIndices(px, 3, palette, 4, indices);
+			if (error < bestError) {
+				bestError = error;
+				uint32_t bits = 0;
+				for (unsigned int i = 0; i < 16; i++) bits |= (uint32_t)indices[i] << (i * 2);
+				out[0] = (unsigned char)c0; out[1] = (unsigned char)(c0 >> 8);
+				out[2] = (unsigned char)c1; out[3] = (unsigned char)(c1 >> 8);
+				memcpy(out + 4, &bits, 4);
+			}
+
+			// c0 is index 0, so it's the refit's start
+			if (pass == 0 && (c0 == c1 || !RefitLine(px, 3, indices, weights, swapped ? start : end, swapped ? end : start)))
+				break;
+		}
+	}
+
+	void DecodeBC1(const unsigned char* in, unsigned char* rgba)
+	{
+		unsigned char palette[4][4];
+		PaletteBC1((uint16_t)(in[0] | in[1] << 8), (uint16_t)(in[2] | in[3] << 8), palette);
+		uint32_t bits;
+		memcpy(&bits, in + 4, 4);
+		for (unsigned int i = 0; i < 16; i++)
+			memcpy(rgba + i * 4, palette[(bits >> (i * 2)) & 3], 4);
+	}
+
+
+	// --------------------------------------------------------
+	// BC4 (BC5 is two of these)
+	// --------------------------------------------------------
+	void PaletteBC4(unsigned int r0, unsigned int r1, unsigned char (*palette)[4])
+	{
+		unsigned int values[8] = { r0, r1 };
+		if (r0 > r1) {
+			for (unsigned int i = 1; i < 7; i++) values[i + 1] = ((7 - i) * r0 + i * r1) / 7;
+		}
+		else {
+			for (unsigned int i = 1; i < 5; i++) values[i + 1] = ((5 - i) * r0 + i * r1) / 5;
+			values[6] = 0;
+			values[7] = 255;
+		}
+		for (unsigned int i = 0; i < 8; i++) palette[i][0] = (unsigned char)values[i];
+	}
+
+	// Encodes channel 0 of px
+	void EncodeBC4(const BlockPixels& px, unsigned char* out)
+	{
+		float lo = 255, hi = 0, innerLo = 255, innerHi = 0;
+		for (unsigned int i = 0; i < 16; i++) {
+			float v = px.Channel[0][i];
+			lo = std::min(lo, v);
+			hi = std::max(hi, v);
+			if (v > 0 && v < 255) {
+				innerLo = std::min(innerLo, v);
+				innerHi = std::max(innerHi, v);
+			}
+		}
+		if (innerLo > innerHi) innerLo = innerHi = 0;
+
+		// 8 values between the extremes, or 6 between the others plus exact 0 and 255
+		unsigned int candidates[2][2] = {
+			{ (unsigned int)hi, (unsigned int)lo },
+			{ (unsigned int)innerLo, (unsigned int)innerHi }
+		};
+
+		float bestError = 1e30f;
+		for (unsigned int mode = 0; mode < 2; mode++) {
+			unsigned int r0 = candidates[mode][0], r1 = candidates[mode][1];
+			unsigned char palette[8][4];
+			unsigned char indices[16];
+			PaletteBC4(r0, r1, palette);
+			float error = FitIndices(px, 1, palette, 8, indices);
+			if (error >= bestError) continue;
+
+			bestError = error;
+			uint64_t bits = 0;
+			for (unsigned int i = 0; i < 16; i++) bits |= (uint64_t)indices[i] << (i * 3);
+			out[0] = (unsigned char)r0;
+			out[1] = (unsigned char)r1;
+			for (unsigned int b = 0; b < 6; b++) out[2 + b] = (unsigned char)(bits >> (b * 8));
+		}
+	}
+
+	void DecodeBC4(const unsigned char* in, unsigned char* rgba, unsigned int channel)
+	{
+		unsigned char palette[8][4];
+		PaletteBC4(in[0], in[1], palette);
+		uint64_t bits = 0;
+		for (unsigned int b = 0; b < 6; b++) bits |= (uint64_t)in[2 + b] << (b * 8);
+		for (unsigned int i = 0; i < 16; i++)
+			rgba[i * 4 + channel] = palette[(bits >> (i * 3)) & 7][0];
+	}
+
+
+	// --------------------------------------------------------
+	// BC7 mode 6: 7 bit RGBA endpoints, each with its own p-bit
+	// (the shared lowest bit), and 16 weights between them
+	// --------------------------------------------------------
+	const unsigned int Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	void PaletteBC7(const unsigned int* e0, const unsigned int* e1, unsigned char (*palette)[4])
+	{
+		for (unsigned int k = 0; k < 16; k++)
+			for (unsigned int c = 0; c < 4; c++)
+				palette[k][c] = (unsigned char)(((64 - Weights4[k]) * e0[c] + Weights4[k] * e1[c] + 32) >> 6);
+	}
+
+	void EncodeBC7(const BlockPixels& px, unsigned char* out)
+	{
+		float weights[16];
+		for (unsigned int k = 0; k < 16; k++) weights[k] = Weights4[k] / 64.0f;
+
+		float start[4], end[4];
+		FitLine(px, 4, start, end);
+
+		float bestError = 1e30f;
+		unsigned int best0[4] = {}, best1[4] = {};
+		unsigned char bestIndices[16] = {};
+		for (unsigned int pass = 0; pass < 2; pass++) {
+			for (unsigned int p = 0; p < 4; p++) {
+				unsigned int p0 = p & 1, p1 = p >> 1;
+				unsigned int e0[4], e1[4];
+				for (unsigned int c = 0; c < 4; c++) {
+					e0[c] = (unsigned int)std::clamp((int)((start[c] - p0) * 0.5f + 0.5f), 0, 127) << 1 | p0;
+					e1[c] = (unsigned int)std::clamp((int)((end[c] - p1) * 0.5f + 0.5f), 0, 127) << 1 | p1;
+				}
+
+				unsigned char palette[16][4];
+				unsigned char indices[16];
+				PaletteBC7(e0, e1, palette);
+				float error = FitIndices(px, 4, palette, 16, indices);
+				if (error < bestError) {
+					bestError = error;
+					memcpy(best0, e0, sizeof(e0));
+					memcpy(best1, e1, sizeof(e1));
+					memcpy(bestIndices, indices, 16);
+				}
+			}
+			if (pass == 0 && (bestError == 0 || !RefitLine(px, 4, bestIndices, weights, start, end)))
+				break;
+		}
+
+		// the first index has an implied top bit of 0, so flip the ends if it's set
+		if (bestIndices[0] & 8) {
+			std::swap(best0, best1);
+			for (unsigned int i = 0; i < 16; i++) bestIndices[i] = (unsigned char)(15 - bestIndices[i]);
+		}
+
+		memset(out, 0, 16);
+		BitStream bits = { out, 0 };
+		bits.Write(1 << 6, 7);
+		for (unsigned int c = 0; c < 4; c++) {
+			bits.Write(best0[c] >> 1, 7);
+			bits.Write(best1[c] >> 1, 7);
+		}
+		bits.Write(best0[0] & 1, 1);
+		bits.Write(best1[0] & 1, 1);
+		bits.Write(bestIndices[0], 3);
+		for (unsigned int i = 1; i < 16; i++) bits.Write(bestIndices[i], 4);
+	}
+
+	void DecodeBC7(const unsigned char* in, unsigned char* rgba)
+	{
+		if ((in[0] & 0x7F) != 0x40) {
+			// not mode 6, which the encoder never writes
+			memset(rgba, 0, 64);
+			return;
+		}
+
+		BitStream bits = { (unsigned char*)in, 7 };
+		unsigned int e0[4], e1[4];
+		for (unsigned int c = 0; c < 4; c++) {
+			e0[c] = bits.Read(7) << 1;
+			e1[c] = bits.Read(7) << 1;
+		}
+		unsigned int p0 = bits.Read(1), p1 = bits.Read(1);
+		for (unsigned int c = 0; c < 4; c++) {
+			e0[c] |= p0;
+			e1[c] |= p1;
+		}
+
+		unsigned char palette[16][4];
+		PaletteBC7(e0, e1, palette);
+		for (unsigned int i = 0; i < 16; i++)
+			memcpy(rgba + i * 4, palette[bits.Read(i == 0 ? 3 : 4)], 4);
+	}
+
+
+	// --------------------------------------------------------
+	// BC6H (unsigned), mode 11 only: one subset, 10 bit
+	// endpoints stored whole and 4 bit indices. Pixels are
+	// fitted as their half float bit patterns, which are close
+	// to logarithmic, so dark and bright blocks weigh the same
+	// --------------------------------------------------------
+	void LoadHalfPixels(const unsigned short* rgba, BlockPixels& px)
+	{
+		// unsigned: negatives are black and infinities the largest half
+		for (unsigned int i = 0; i < 16; i++)
+			for (unsigned int c = 0; c < 4; c++) {
+				unsigned int h = rgba[i * 4 + c];
+				px.Channel[c][i] = (float)((h & 0x8000) ? 0 : std::min(h, 0x7BFFu));
+			}
+	}
+
+	// 10 bit endpoint to the 16 bit range interpolation works in, and back to half bits
+	unsigned int UnquantizeBC6H(unsigned int value)
+	{
+		if (value == 0) return 0;
+		if (value == 1023) return 0xFFFF;
+		return ((value << 16) + 0x8000) >> 10;
+	}
+
+	// the endpoint whose decoded value is nearest half bits h (they decode to 31 e + 15)
+	unsigned int QuantizeBC6H(float h)
+	{
+		return (unsigned int)std::clamp((int)((h - 15.0f) / 31.0f + 0.5f), 0, 1023);
+	}
+
+	void PaletteBC6H(const unsigned int* e0, const unsigned int* e1, unsigned int (*palette)[4])
+	{
+		for (unsigned int c = 0; c < 3; c++) {
+			unsigned int a = UnquantizeBC6H(e0[c]), b = UnquantizeBC6H(e1[c]);
+			for (unsigned int k = 0; k < 16; k++)
+				palette[k][c] = ((((64 - Weights4[k]) * a + Weights4[k] * b + 32) >> 6) * 31) >> 6;
+		}
+		for (unsigned int k = 0; k < 16; k++) palette[k][3] = 0x3C00;
+	}
+
+	void EncodeBC6H(const BlockPixels& px, unsigned char* out)
+	{
+		float weights[16];
+		for (unsigned int k = 0; k < 16; k++) weights[k] = Weights4[k] / 64.0f;
+
+		float start[4], end[4];
+		FitLine(px, 3, start, end, 31743.0f);
+
+		float bestError = 1e30f;
+		unsigned int best0[3] = {}, best1[3] = {};
+		unsigned char bestIndices[16] = {};
+		for (unsigned int pass = 0; pass < 2; pass++) {
+			unsigned int e0[3], e1[3];
+			for (unsigned int c = 0; c < 3; c++) {
+				e0[c] = QuantizeBC6H(start[c]);
+				e1[c] = QuantizeBC6H(end[c]);
+			}
+
+			unsigned int palette[16][4];
+			unsigned char indices[16];
+			PaletteBC6H(e0, e1, palette);
+			float error = FitIndices(px, 3, palette, 16, indices);
+			if (error < bestError) {
+				bestError = error;
+				memcpy(best0, e0, sizeof(e0));
+				memcpy(best1, e1, sizeof(e1));
+				memcpy(bestIndices, indices, 16);
+			}
+			if (pass == 0 && (bestError == 0 || !RefitLine(px, 3, bestIndices, weights, start, end, 31743.0f)))
+				break;
+		}
+
+		// the first index has an implied top bit of 0, as in BC7
+		if (bestIndices[0] & 8) {
+			std::swap(best0, best1);
+			for (unsigned int i = 0; i < 16; i++) bestIndices[i] = (unsigned char)(15 - bestIndices[i]);
+		}
+
+		memset(out, 0, 16);
+		BitStream bits = { out, 0 };
+		bits.Write(0x03, 5);
+		for (unsigned int c = 0; c < 3; c++) bits.Write(best0[c], 10);
+		for (unsigned int c = 0; c < 3; c++) bits.Write(best1[c], 10);
+		bits.Write(bestIndices[0], 3);
+		for (unsigned int i = 1; i < 16; i++) bits.Write(bestIndices[i], 4);
+	}
+
+	void DecodeBC6H(const unsigned char* in, unsigned short* rgba)
+	{
+		BitStream bits = { (unsigned char*)in, 0 };
+		if (bits.Read(5) != 0x03) {
+			// not mode 11, which the encoder never writes
+			for (unsigned int i = 0; i < 16 * 4; i++) rgba[i] = (i & 3) == 3 ? 0x3C00 : 0;
+			return;
+		}
+
+		unsigned int e0[3], e1[3];
+		for (unsigned int c = 0; c < 3; c++) e0[c] = bits.Read(10);
+		for (unsigned int c = 0; c < 3; c++) e1[c] = bits.Read(10);
+
+		unsigned int palette[16][4];
+		PaletteBC6H(e0, e1, palette);
+		for (unsigned int i = 0; i < 16; i++) {
+			unsigned int k = bits.Read(i == 0 ? 3 : 4);
+			for (unsigned int c = 0; c < 4; c++) rgba[i * 4 + c] = (unsigned short)palette[k][c];
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Formats
+// --------------------------------------------------------
+unsigned int BlockCompression::GetBlockSize(BlockFormat format)
+{
+	return (format == BlockFormatBC1 || format == BlockFormatBC4) ? 8 : 16;
+}
+
+unsigned int BlockCompression::GetChannelCount(BlockFormat format)
+{
+	switch (format) {
+	case BlockFormatBC1: return 3;
+	case BlockFormatBC4: return 1;
+	case BlockFormatBC5: return 2;
+	default: return 4;
+	}
+}
+
+const char* BlockCompression::GetName(BlockFormat format)
+{
+	static const char* names[] = { "BC1", "BC4", "BC5", "BC7" };
+	return names[format];
+}
+
+
+// --------------------------------------------------------
+// Blocks
+// --------------------------------------------------------
+void BlockCompression::EncodeBlock(BlockFormat format, const unsigned char* rgba, unsigned char* out)
+{
+	BlockPixels px;
+	LoadPixels(rgba, px);
+
+	switch (format) {
+	case BlockFormatBC1:
+		EncodeBC1(px, out);
+		break;
+	case BlockFormatBC4:
+		EncodeBC4(px, out);
+		break;
+	case BlockFormatBC5:
+		// red, then green moved into channel 0
+		EncodeBC4(px, out);
+		memcpy(px.Channel[0], px.Channel[1], sizeof(px.Channel[0]));
+		EncodeBC4(px, out + 8);
+		break;
+	case BlockFormatBC7:
+		EncodeBC7(px, out);
+		break;
+	}
+}
+
+void BlockCompression::DecodeBlock(BlockFormat format, const unsigned char* in, unsigned char* rgba)
+{
+	switch (format) {
+	case BlockFormatBC1:
+		DecodeBC1(in, rgba);
+		break;
+	case BlockFormatBC4:
+	case BlockFormatBC5:
+		for (unsigned int i = 0; i < 16; i++) {
+			rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+			rgba[i * 4 + 3] = 255;
+		}
+		DecodeBC4(in, rgba, 0);
+		if (format == BlockFormatBC5) DecodeBC4(in + 8, rgba, 1);
+		break;
+	case BlockFormatBC7:
+		DecodeBC7(in, rgba);
+		break;
+	}
+}
+
+void BlockCompression::EncodeBlockBC6H(const unsigned short* rgba, unsigned char* out)
+{
+	BlockPixels px;
+	LoadHalfPixels(rgba, px);
+	EncodeBC6H(px, out);
+}
+
+void BlockCompression::DecodeBlockBC6H(const unsigned char* in, unsigned short* rgba)
+{
+	DecodeBC6H(in, rgba);
+}
+
+
+// --------------------------------------------------------
+// Images
+// --------------------------------------------------------
+std::vector<unsigned char> BlockCompression::Compress(BlockFormat format, const unsigned char* rgba, unsigned int width, unsigned int height, ThreadPool* pool)
+{
+	unsigned int blocksX = (width + 3) / 4;
+	unsigned int blocksY = (height + 3) / 4;
+	unsigned int blockSize = GetBlockSize(format);
+	std::vector<unsigned char> blocks((size_t)blocksX * blocksY * blockSize);
+
+	auto compressRow = [&](unsigned int by) {
+		unsigned char block[64];
+		for (unsigned int bx = 0; bx < blocksX; bx++) {
+			for (unsigned int y = 0; y < 4; y++) {
+				unsigned int sy = std::min(by * 4 + y, height - 1);
+				for (unsigned int x = 0; x < 4; x++) {
+					unsigned int sx = std::min(bx * 4 + x, width - 1);
+					memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+				}
+			}
+			EncodeBlock(format, block, &blocks[((size_t)by * blocksX + bx) * blockSize]);
+		}
+	};
+
+	if (pool) pool->ParallelFor(blocksY, compressRow);
+	else for (unsigned int by = 0; by < blocksY; by++) compressRow(by);
+	return blocks;
+}
+
+std::vector<unsigned char> BlockCompression::Decompress(BlockFormat format, const unsigned char* blocks, unsigned int width, unsigned int height)
+{
+	unsigned int blocksX = (width + 3) / 4;
+	unsigned int blocksY = (height + 3) / 4;
+	unsigned int blockSize = GetBlockSize(format);
+	std::vector<unsigned char> rgba((size_t)width * height * 4);
+
+	unsigned char block[64];
+	for (unsigned int by = 0; by < blocksY; by++) {
+		for (unsigned int bx = 0; bx < blocksX; bx++) {
+			DecodeBlock(format, blocks + ((size_t)by * blocksX + bx) * blockSize, block);
+			for (unsigned int y = 0; y < 4 && by * 4 + y < height; y++)
+				for (unsigned int x = 0; x < 4 && bx * 4 + x < width; x++)
+					memcpy(&rgba[((size_t)(by * 4 + y) * width + bx * 4 + x) * 4], block + (y * 4 + x) * 4, 4);
+		}
+	}
+	return rgba;
+}
+
+std::vector<unsigned char> BlockCompression::CompressBC6H(const unsigned short* rgba, unsigned int width, unsigned int height, ThreadPool* pool)
+{
+	unsigned int blocksX = (width + 3) / 4;
+	unsigned int blocksY = (height + 3) / 4;
+	std::vector<unsigned char> blocks((size_t)blocksX * blocksY * 16);
+
+	auto compressRow = [&](unsigned int by) {
+		unsigned short block[64];
+		for (unsigned int bx = 0; bx < blocksX; bx++) {
+			for (unsigned int y = 0; y < 4; y++) {
+				unsigned int sy = std::min(by * 4 + y, height - 1);
+				for (unsigned int x = 0; x < 4; x++) {
+					unsigned int sx = std::min(bx * 4 + x, width - 1);
+					memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 8);
+				}
+			}
+			EncodeBlockBC6H(block, &blocks[((size_t)by * blocksX + bx) * 16]);
+		}
+	};
+
+	if (pool) pool->ParallelFor(blocksY, compressRow);
+	else for (unsigned int by = 0; by < blocksY; by++) compressRow(by);
+	return blocks;
+}
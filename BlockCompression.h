@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+class ThreadPool;
+
+// The block compressed formats the cooker writes
+enum BlockFormat
+{
+	BlockFormatBC1,		// RGB, 4 bits per pixel
+	BlockFormatBC4,		// one channel (R), 4 bits per pixel
+	BlockFormatBC5,		// two channels (RG), 8 bits per pixel
+	BlockFormatBC7		// RGBA, 8 bits per pixel
+};
+
+// --------------------------------------------------------
+// Encoders and decoders for 4x4 blocks of 8 bit RGBA (and
+// of half floats, for BC6H)
+//
+// - BC1 fits the block's principal axis, then refits the
+//   endpoints to the indices it picked (4 color mode only)
+// - BC4/BC5 try both the 8 value and the 6 value (with 0
+//   and 255) modes
+// - BC7 only uses mode 6 (one subset, RGBA, 4 bit indices),
+//   trying every p-bit combination, and only decodes mode 6
+// - BC6H (unsigned) only uses mode 11 (one subset, 10 bit
+//   endpoints, 4 bit indices), fitted to the halves' bit
+//   patterns, and only decodes mode 11
+// - Indices are picked with SSE2, all 16 pixels at a time
+// - Only depends on the standard library (and ThreadPool)
+// --------------------------------------------------------
+class BlockCompression
+{
+public:
+	// Bytes per 4x4 block
+	static unsigned int GetBlockSize(BlockFormat format);
+	// Channels the format keeps (the rest decode as 0, or 255 for alpha)
+	static unsigned int GetChannelCount(BlockFormat format);
+	static const char* GetName(BlockFormat format);
+
+	/// <summary>
+	/// Encodes one block of 16 RGBA pixels (64 bytes, rows top to bottom)
+	/// </summary>
+	static void EncodeBlock(BlockFormat format, const unsigned char* rgba, unsigned char* out);
+	static void DecodeBlock(BlockFormat format, const unsigned char* in, unsigned char* rgba);
+
+	/// <summary>
+	/// Compresses a whole image, one row of blocks per job (edges
+	/// that aren't a multiple of 4 repeat their last pixel)
+	/// </summary>
+	/// <param name="pool">spreads the rows across threads, or null to do them all here</param>
+	static std::vector<unsigned char> Compress(BlockFormat format, const unsigned char* rgba, unsigned int width, unsigned int height, ThreadPool* pool);
+	static std::vector<unsigned char> Decompress(BlockFormat format, const unsigned char* blocks, unsigned int width, unsigned int height);
+
+	/// <summary>
+	/// BC6H (unsigned, 16 bytes a block) from 16 pixels of RGBA halves; alpha isn't kept and decodes as 1
+	/// </summary>
+	static void EncodeBlockBC6H(const unsigned short* rgba, unsigned char* out);
+	static void DecodeBlockBC6H(const unsigned char* in, unsigned short* rgba);
+	static std::vector<unsigned char> CompressBC6H(const unsigned short* rgba, unsigned int width, unsigned int height, ThreadPool* pool);
+};
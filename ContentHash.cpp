@@ -0,0 +1,109 @@
+#include "ContentHash.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	const uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+	const uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+	const uint64_t Prime3 = 0x165667B19E3779F9ull;
+	const uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+	const uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+	uint64_t RotateLeft(uint64_t v, unsigned int bits) { return (v << bits) | (v >> (64 - bits)); }
+
+	// little endian loads (memcpy, so unaligned data is fine)
+	uint64_t Read64(const unsigned char* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+	uint32_t Read32(const unsigned char* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+	uint64_t Round(uint64_t lane, uint64_t input)
+	{
+		lane += input * Prime2;
+		lane = RotateLeft(lane, 31);
+		return lane * Prime1;
+	}
+
+	uint64_t MergeRound(uint64_t hash, uint64_t lane)
+	{
+		hash ^= Round(0, lane);
+		return hash * Prime1 + Prime4;
+	}
+}
+
+
+// --------------------------------------------------------
+// XXH64
+// --------------------------------------------------------
+unsigned long long ContentHash::Hash64(const void* data, size_t size, unsigned long long seed)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + size;
+	uint64_t hash;
+
+	if (size >= 32) {
+		// four lanes, 8 bytes each per stripe
+		uint64_t v1 = seed + Prime1 + Prime2;
+		uint64_t v2 = seed + Prime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - Prime1;
+		const unsigned char* last = end - 32;
+		do {
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+			p += 32;
+		} while (p <= last);
+
+		hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		hash = MergeRound(hash, v1);
+		hash = MergeRound(hash, v2);
+		hash = MergeRound(hash, v3);
+		hash = MergeRound(hash, v4);
+	}
+	else hash = seed + Prime5;
+
+	hash += size;
+
+	// whatever's left: 8, then 4, then 1 byte at a time
+	for (; p + 8 <= end; p += 8) {
+		hash ^= Round(0, Read64(p));
+		hash = RotateLeft(hash, 27) * Prime1 + Prime4;
+	}
+	if (p + 4 <= end) {
+		hash ^= (uint64_t)Read32(p) * Prime1;
+		hash = RotateLeft(hash, 23) * Prime2 + Prime3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		hash ^= *p * Prime5;
+		hash = RotateLeft(hash, 11) * Prime1;
+	}
+
+	// avalanche
+	hash ^= hash >> 33;
+	hash *= Prime2;
+	hash ^= hash >> 29;
+	hash *= Prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+bool ContentHash::HashFile(const std::wstring& path, std::vector<unsigned char>& contents, unsigned long long& hash)
+{
+	std::ifstream file(std::filesystem::path(path), std::ios::binary | std::ios::ate);
+	if (!file) return false;
+
+	// one read of the whole file
+	std::streamoff size = file.tellg();
+	file.seekg(0);
+	contents.resize((size_t)size);
+	if (size > 0 && !file.read((char*)contents.data(), size))
+		return false;
+
+	hash = Hash64(contents.data(), contents.size());
+	return true;
+}
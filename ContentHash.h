@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Fast 64 bit content hashing (XXH64), for telling whether
+// two files hold the same bytes
+//
+// - Matches the reference XXH64, so hashes can be checked
+//   against other tools
+// - Runs four independent lanes over 32 byte stripes, which
+//   keeps it near memory speed without needing 64 bit SIMD
+//   multiplies (which SSE2 doesn't have)
+// - Only depends on the standard library
+// --------------------------------------------------------
+class ContentHash
+{
+public:
+	/// <summary>
+	/// Hashes a block of memory
+	/// </summary>
+	static unsigned long long Hash64(const void* data, size_t size, unsigned long long seed = 0);
+
+	/// <summary>
+	/// Reads a whole file and hashes it
+	/// </summary>
+	/// <param name="contents">gets the file's bytes, so they don't have to be read twice</param>
+	/// <returns>false if the file couldn't be read</returns>
+	static bool HashFile(const std::wstring& path, std::vector<unsigned char>& contents, unsigned long long& hash);
+};
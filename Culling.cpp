@@ -0,0 +1,145 @@
+#include "Culling.h"
+
+#include <cfloat>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Moves a local space box into world space.  The result
+// is the axis-aligned box around the rotated original.
+// --------------------------------------------------------
+BoundingBox Culling::TransformBounds(const BoundingBox& local, const XMFLOAT4X4& world)
+{
+	BoundingBox result;
+	local.Transform(result, XMLoadFloat4x4(&world));
+	return result;
+}
+
+// --------------------------------------------------------
+// Projects the 8 corners of a world space box and returns
+// their extents in NDC.  If any corner ends up behind a
+// perspective eye the bounds are widened to "everything",
+// which keeps the tests below conservative.
+// --------------------------------------------------------
+ProjectedBounds Culling::ProjectBounds(const BoundingBox& box, const XMFLOAT4X4& viewProj)
+{
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+
+	XMMATRIX vp = XMLoadFloat4x4(&viewProj);
+
+	ProjectedBounds result = EmptyBounds();
+	for (size_t i = 0; i < BoundingBox::CORNER_COUNT; i++)
+	{
+		XMVECTOR clip = XMVector3Transform(XMLoadFloat3(&corners[i]), vp);
+		float w = XMVectorGetW(clip);
+		if (w <= 0.0f)
+		{
+			result.Min = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			result.Max = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			result.Empty = false;
+			return result;
+		}
+
+		XMFLOAT3 ndc;
+		XMStoreFloat3(&ndc, XMVectorScale(clip, 1.0f / w));
+
+		ProjectedBounds corner = { ndc, ndc, false };
+		MergeBounds(result, corner);
+	}
+
+	return result;
+}
+
+ProjectedBounds Culling::EmptyBounds()
+{
+	ProjectedBounds empty;
+	empty.Min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	empty.Max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	empty.Empty = true;
+	return empty;
+}
+
+void Culling::MergeBounds(ProjectedBounds& into, const ProjectedBounds& other)
+{
+	if (other.Empty) return;
+
+	XMStoreFloat3(&into.Min, XMVectorMin(XMLoadFloat3(&into.Min), XMLoadFloat3(&other.Min)));
+	XMStoreFloat3(&into.Max, XMVectorMax(XMLoadFloat3(&into.Max), XMLoadFloat3(&other.Max)));
+	into.Empty = false;
+}
+
+// --------------------------------------------------------
+// Tests a world space box against the clip volume of a
+// view-projection matrix.  The box is only rejected when
+// all 8 corners are outside the same clip plane.
+// --------------------------------------------------------
+bool Culling::IsVisible(const BoundingBox& box, const XMFLOAT4X4& viewProj)
+{
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+
+	XMMATRIX vp = XMLoadFloat4x4(&viewProj);
+
+	// one bit per plane: -x, +x, -y, +y, near, far
+	unsigned int allOutside = 0x3F;
+	for (size_t i = 0; i < BoundingBox::CORNER_COUNT; i++)
+	{
+		XMFLOAT4 c;
+		XMStoreFloat4(&c, XMVector3Transform(XMLoadFloat3(&corners[i]), vp));
+
+		unsigned int outside = 0;
+		if (c.x < -c.w) outside |= 0x01;
+		if (c.x > c.w)  outside |= 0x02;
+		if (c.y < -c.w) outside |= 0x04;
+		if (c.y > c.w)  outside |= 0x08;
+		if (c.z < 0.0f) outside |= 0x10;
+		if (c.z > c.w)  outside |= 0x20;
+
+		allOutside &= outside;
+		if (allOutside == 0)
+			return true;
+	}
+
+	return allOutside == 0;
+}
+
+// --------------------------------------------------------
+// Is a caster (projected by the light's view-projection)
+// inside the light's orthographic volume?
+//
+// The volume is extended toward the light: anything in
+// front of the near plane can still throw a shadow into
+// the map, since the shadow rasterizer clamps its depth
+// instead of clipping it.  Only the sides and the far
+// plane reject casters.
+// --------------------------------------------------------
+bool Culling::CasterInLightVolume(const ProjectedBounds& caster)
+{
+	if (caster.Empty) return false;
+
+	return
+		caster.Max.x >= -1.0f && caster.Min.x <= 1.0f &&
+		caster.Max.y >= -1.0f && caster.Min.y <= 1.0f &&
+		caster.Min.z <= 1.0f;
+}
+
+// --------------------------------------------------------
+// Could a caster's shadow land on any visible receiver?
+//
+// receivers - merged light space bounds of everything the
+//             camera can see
+//
+// The shadow travels away from the light (+z in light
+// space), so the caster must overlap the receivers in x/y
+// and must start before the farthest receiver ends.
+// --------------------------------------------------------
+bool Culling::CasterReachesReceivers(const ProjectedBounds& caster, const ProjectedBounds& receivers)
+{
+	if (caster.Empty || receivers.Empty) return false;
+
+	return
+		caster.Max.x >= receivers.Min.x && caster.Min.x <= receivers.Max.x &&
+		caster.Max.y >= receivers.Min.y && caster.Min.y <= receivers.Max.y &&
+		caster.Min.z <= receivers.Max.z;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+// --------------------------------------------------------
+// Bounds of something after projection, in normalized
+// device coordinates (x and y in [-1, 1], z in [0, 1] when
+// inside the volume)
+// --------------------------------------------------------
+struct ProjectedBounds
+{
+	DirectX::XMFLOAT3 Min;
+	DirectX::XMFLOAT3 Max;
+	bool Empty;		// nothing merged in yet
+};
+
+// --------------------------------------------------------
+// Per-frame shadow caster culling results
+// --------------------------------------------------------
+struct ShadowCullStats
+{
+	unsigned int CastersDrawn;
+	unsigned int SkippedOutsideVolume;	// not inside the light's (extended) volume
+	unsigned int SkippedNoReceiver;		// shadow can't land on anything visible
+};
+
+// --------------------------------------------------------
+// Visibility tests shared by the renderer
+//
+// - Only depends on DirectXMath, so the math can be
+//   exercised without a device (Tools/CullingTestMain.cpp)
+// --------------------------------------------------------
+namespace Culling
+{
+	// Bounds helpers
+	DirectX::BoundingBox TransformBounds(const DirectX::BoundingBox& local, const DirectX::XMFLOAT4X4& world);
+	ProjectedBounds ProjectBounds(const DirectX::BoundingBox& box, const DirectX::XMFLOAT4X4& viewProj);
+	ProjectedBounds EmptyBounds();
+	void MergeBounds(ProjectedBounds& into, const ProjectedBounds& other);
+
+	// Camera visibility (works for perspective and orthographic projections)
+	bool IsVisible(const DirectX::BoundingBox& box, const DirectX::XMFLOAT4X4& viewProj);
+
+	// Shadow casters
+	bool CasterInLightVolume(const ProjectedBounds& caster);
+	bool CasterReachesReceivers(const ProjectedBounds& caster, const ProjectedBounds& receivers);
+}
@@ -0,0 +1,114 @@
+#include "D3D11FrameGraph.h"
+#include "D3D11RenderBackend.h"
+
+D3D11FrameGraphBackend::D3D11FrameGraphBackend(Microsoft::WRL::ComPtr<ID3D11Device> device, std::shared_ptr<DeferredRenderer> deferredRenderer) :
+	device(device),
+	deferredRenderer(deferredRenderer),
+	texturesCreated(0)
+{
+}
+
+void D3D11FrameGraphBackend::Realize(const std::vector<FrameGraphSlot>& slots)
+{
+	// slots past the end aren't needed this frame
+	textures.resize(slots.size());
+
+	for (size_t i = 0; i < slots.size(); i++) {
+		const FrameGraphSlot& want = slots[i];
+		const FrameGraphSlot& have = textures[i].Slot;
+		bool matches = textures[i].Texture &&
+			have.Desc.Width == want.Desc.Width &&
+			have.Desc.Height == want.Desc.Height &&
+			have.Desc.Format == want.Desc.Format &&
+			(have.Usage & want.Usage) == want.Usage;
+
+		if (!matches) {
+			textures[i] = {};
+			if (Create(want, textures[i])) texturesCreated++;
+		}
+	}
+}
+
+void D3D11FrameGraphBackend::UnbindShaderResources()
+{
+	deferredRenderer->RecordCommands([](ID3D11DeviceContext* context)
+		{
+			ID3D11ShaderResourceView* nullSRV[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = {};
+			context->VSSetShaderResources(0, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, nullSRV);
+			context->PSSetShaderResources(0, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT, nullSRV);
+		});
+}
+
+// --------------------------------------------------------
+// Creates a slot's texture and the views its usage needs
+//
+// Depth is stored typeless so it can be both a depth
+// buffer and a shader resource.
+// --------------------------------------------------------
+bool D3D11FrameGraphBackend::Create(const FrameGraphSlot& slot, PhysicalTexture& physical)
+{
+	bool depth = slot.Desc.Format == RenderTextureFormat::D32_Float;
+	DXGI_FORMAT viewFormat = D3D11RenderDevice::GetFormat(slot.Desc.Format);
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = slot.Desc.Width;
+	desc.Height = slot.Desc.Height;
+	desc.ArraySize = 1;
+	desc.MipLevels = 1;
+	desc.Format = depth ? DXGI_FORMAT_R32_TYPELESS : viewFormat;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	if (slot.Usage & FrameUsageShaderResource) desc.BindFlags |= D3D11_BIND_SHADER_RESOURCE;
+	if (slot.Usage & FrameUsageRenderTarget) desc.BindFlags |= D3D11_BIND_RENDER_TARGET;
+	if (slot.Usage & FrameUsageDepthStencil) desc.BindFlags |= D3D11_BIND_DEPTH_STENCIL;
+
+	if (FAILED(device->CreateTexture2D(&desc, 0, physical.Texture.GetAddressOf())))
+		return false;
+	physical.Slot = slot;
+
+	if (slot.Usage & FrameUsageShaderResource) {
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = viewFormat;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = 1;
+		device->CreateShaderResourceView(physical.Texture.Get(), &srvDesc, physical.SRV.GetAddressOf());
+	}
+	if (slot.Usage & FrameUsageRenderTarget)
+		device->CreateRenderTargetView(physical.Texture.Get(), 0, physical.RTV.GetAddressOf());
+	if (slot.Usage & FrameUsageDepthStencil) {
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		device->CreateDepthStencilView(physical.Texture.Get(), &dsvDesc, physical.DSV.GetAddressOf());
+	}
+	return true;
+}
+
+
+// --------------------------------------------------------
+// GETTERS
+// --------------------------------------------------------
+ID3D11Texture2D* D3D11FrameGraphBackend::GetTexture(int slot)
+{
+	return slot >= 0 && slot < (int)textures.size() ? textures[slot].Texture.Get() : 0;
+}
+
+ID3D11ShaderResourceView* D3D11FrameGraphBackend::GetSRV(int slot)
+{
+	return slot >= 0 && slot < (int)textures.size() ? textures[slot].SRV.Get() : 0;
+}
+
+ID3D11RenderTargetView* D3D11FrameGraphBackend::GetRTV(int slot)
+{
+	return slot >= 0 && slot < (int)textures.size() ? textures[slot].RTV.Get() : 0;
+}
+
+ID3D11DepthStencilView* D3D11FrameGraphBackend::GetDSV(int slot)
+{
+	return slot >= 0 && slot < (int)textures.size() ? textures[slot].DSV.Get() : 0;
+}
+
+unsigned int D3D11FrameGraphBackend::GetTexturesCreated()
+{
+	return texturesCreated;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+
+#include "FrameGraph.h"
+#include "DeferredRenderer.h"
+
+// --------------------------------------------------------
+// Backs a FrameGraph's transient slots with D3D11 textures
+//
+// - D3D11 can't place two resources in the same memory, so
+//   aliasing means the slot's texture is reused by every
+//   resource the graph put in it
+// - Textures are kept between frames and only recreated
+//   when a slot's description or bind flags change
+// - Unbinds are recorded through the deferred renderer, so
+//   they stay in order with the passes around them
+// --------------------------------------------------------
+class D3D11FrameGraphBackend : public IFrameGraphBackend
+{
+public:
+	D3D11FrameGraphBackend(Microsoft::WRL::ComPtr<ID3D11Device> device, std::shared_ptr<DeferredRenderer> deferredRenderer);
+
+	void Realize(const std::vector<FrameGraphSlot>& slots) override;
+	void UnbindShaderResources() override;
+
+	// Views of a slot's texture (null if the slot's usage doesn't include them)
+	ID3D11Texture2D* GetTexture(int slot);
+	ID3D11ShaderResourceView* GetSRV(int slot);
+	ID3D11RenderTargetView* GetRTV(int slot);
+	ID3D11DepthStencilView* GetDSV(int slot);
+
+	unsigned int GetTexturesCreated();		// since startup
+
+private:
+	struct PhysicalTexture
+	{
+		FrameGraphSlot Slot;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> RTV;
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DSV;
+	};
+
+	bool Create(const FrameGraphSlot& slot, PhysicalTexture& physical);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	std::shared_ptr<DeferredRenderer> deferredRenderer;
+	std::vector<PhysicalTexture> textures;
+	unsigned int texturesCreated;
+};
@@ -0,0 +1,69 @@
+#include "D3D11IBL.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+bool D3D11IBL::Create(Microsoft::WRL::ComPtr<ID3D11Device> device, const IBLData& data, D3D11IBLResources& resources)
+{
+	resources = {};
+	const IBLOptions& o = data.Options;
+	if (data.Specular.size() != o.SpecularLevels || data.BRDF.empty()) return false;
+
+	// the cube: subresources go face by face, every mip of one face before the next
+	std::vector<D3D11_SUBRESOURCE_DATA> initial((size_t)6 * o.SpecularLevels);
+	for (unsigned int face = 0; face < 6; face++)
+		for (unsigned int level = 0; level < o.SpecularLevels; level++) {
+			unsigned int size = std::max(1u, o.SpecularSize >> level);
+			D3D11_SUBRESOURCE_DATA& d = initial[D3D11CalcSubresource(level, face, o.SpecularLevels)];
+			d.pSysMem = data.Specular[level].data() + (size_t)face * size * size * 4;
+			d.SysMemPitch = size * 4 * sizeof(unsigned short);
+		}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = o.SpecularSize;
+	desc.Height = o.SpecularSize;
+	desc.MipLevels = o.SpecularLevels;
+	desc.ArraySize = 6;
+	desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = desc.MipLevels;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cube;
+	if (FAILED(device->CreateTexture2D(&desc, initial.data(), cube.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(cube.Get(), &srvDesc, resources.Specular.GetAddressOf())))
+		return false;
+
+	// the table
+	D3D11_SUBRESOURCE_DATA table = {};
+	table.pSysMem = data.BRDF.data();
+	table.SysMemPitch = o.LUTSize * 2 * sizeof(unsigned short);
+
+	desc = {};
+	desc.Width = o.LUTSize;
+	desc.Height = o.LUTSize;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R16G16_FLOAT;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> lut;
+	if (FAILED(device->CreateTexture2D(&desc, &table, lut.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(lut.Get(), 0, resources.BRDF.GetAddressOf()))) {
+		resources = {};
+		return false;
+	}
+
+	resources.SpecularLevels = o.SpecularLevels;
+	memcpy(resources.Irradiance, data.Irradiance, sizeof(resources.Irradiance));
+	return true;
+}
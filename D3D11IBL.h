@@ -0,0 +1,31 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "IBLBaker.h"
+
+// --------------------------------------------------------
+// What the main pixel shader lights with, on the GPU
+// --------------------------------------------------------
+struct D3D11IBLResources
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Specular;		// prefiltered cube, one roughness per mip
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> BRDF;			// split sum table
+	unsigned int SpecularLevels;
+	float Irradiance[9][4];		// spherical harmonics, straight into the constant buffer
+};
+
+// --------------------------------------------------------
+// The D3D11 half of image based lighting: turning a bake
+// from IBLBaker into textures the shader can read
+// --------------------------------------------------------
+class D3D11IBL
+{
+public:
+	/// <summary>
+	/// Creates the prefiltered cube (RGBA16F) and BRDF table (RG16F) for a bake
+	/// </summary>
+	/// <returns>false if either texture couldn't be made</returns>
+	static bool Create(Microsoft::WRL::ComPtr<ID3D11Device> device, const IBLData& data, D3D11IBLResources& resources);
+};
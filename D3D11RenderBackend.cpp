@@ -0,0 +1,179 @@
+#include "D3D11RenderBackend.h"
+
+D3D11RenderContext::D3D11RenderContext(ID3D11DeviceContext* context) :
+	context(context)
+{
+}
+
+void D3D11RenderContext::SetTopology(RenderTopology topology)
+{
+	D3D11_PRIMITIVE_TOPOLOGY t = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	switch (topology)
+	{
+	case RenderTopology::TriangleList: t = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST; break;
+	case RenderTopology::TriangleStrip: t = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP; break;
+	case RenderTopology::LineList: t = D3D11_PRIMITIVE_TOPOLOGY_LINELIST; break;
+	case RenderTopology::PointList: t = D3D11_PRIMITIVE_TOPOLOGY_POINTLIST; break;
+	}
+	context->IASetPrimitiveTopology(t);
+}
+
+void D3D11RenderContext::SetVertexBuffer(RenderBufferHandle buffer, unsigned int stride, unsigned int offset)
+{
+	ID3D11Buffer* vb = D3D11RenderDevice::GetBuffer(buffer);
+	context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+}
+
+void D3D11RenderContext::SetIndexBuffer(RenderBufferHandle buffer, RenderIndexFormat format)
+{
+	context->IASetIndexBuffer(
+		D3D11RenderDevice::GetBuffer(buffer),
+		format == RenderIndexFormat::UInt16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT,
+		0);
+}
+
+void D3D11RenderContext::SetConstantBuffer(RenderShaderStage stage, unsigned int slot, RenderBufferHandle buffer)
+{
+	ID3D11Buffer* cb = D3D11RenderDevice::GetBuffer(buffer);
+	if (stage == RenderShaderStage::Vertex) context->VSSetConstantBuffers(slot, 1, &cb);
+	else context->PSSetConstantBuffers(slot, 1, &cb);
+}
+
+void D3D11RenderContext::SetTexture(RenderShaderStage stage, unsigned int slot, RenderTextureHandle texture)
+{
+	ID3D11ShaderResourceView* srv = D3D11RenderDevice::GetTexture(texture);
+	if (stage == RenderShaderStage::Vertex) context->VSSetShaderResources(slot, 1, &srv);
+	else context->PSSetShaderResources(slot, 1, &srv);
+}
+
+void D3D11RenderContext::UpdateBuffer(RenderBufferHandle buffer, const void* data, unsigned int byteSize)
+{
+	context->UpdateSubresource(D3D11RenderDevice::GetBuffer(buffer), 0, 0, data, 0, 0);
+}
+
+void D3D11RenderContext::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	context->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderContext::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+ID3D11DeviceContext* D3D11RenderContext::GetContext()
+{
+	return context;
+}
+
+
+D3D11RenderDevice::D3D11RenderDevice(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context),
+	immediate(context.Get())
+{
+}
+
+// --------------------------------------------------------
+// The handle owns one reference to the buffer, given back
+// in ReleaseBuffer
+// --------------------------------------------------------
+RenderBufferHandle D3D11RenderDevice::CreateBuffer(RenderBufferType type, const void* data, unsigned int byteSize, bool immutable)
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = byteSize;
+	desc.Usage = immutable ? D3D11_USAGE_IMMUTABLE : D3D11_USAGE_DEFAULT;
+	switch (type)
+	{
+	case RenderBufferType::Vertex: desc.BindFlags = D3D11_BIND_VERTEX_BUFFER; break;
+	case RenderBufferType::Index: desc.BindFlags = D3D11_BIND_INDEX_BUFFER; break;
+	case RenderBufferType::Constant:
+		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		desc.ByteWidth = (byteSize + 15) / 16 * 16;	// constant buffers come in 16 byte chunks
+		break;
+	}
+
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = data;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	if (FAILED(device->CreateBuffer(&desc, data ? &initialData : 0, buffer.GetAddressOf())))
+		return 0;
+
+	return (RenderBufferHandle)(uintptr_t)buffer.Detach();
+}
+
+RenderTextureHandle D3D11RenderDevice::CreateTexture2D(unsigned int width, unsigned int height, RenderTextureFormat format, const void* data)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = width;
+	desc.Height = height;
+	desc.ArraySize = 1;
+	desc.MipLevels = 1;
+	desc.Format = GetFormat(format);
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = data;
+	initialData.SysMemPitch = width * Render::GetFormatSize(format);
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(device->CreateTexture2D(&desc, data ? &initialData : 0, texture.GetAddressOf())))
+		return 0;
+
+	// the view keeps the texture alive
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf())))
+		return 0;
+
+	return (RenderTextureHandle)(uintptr_t)srv.Detach();
+}
+
+// --------------------------------------------------------
+// The format a shader reads a texture of the given format
+// as (depth comes back as its 32 bit float)
+// --------------------------------------------------------
+DXGI_FORMAT D3D11RenderDevice::GetFormat(RenderTextureFormat format)
+{
+	switch (format)
+	{
+	case RenderTextureFormat::RGBA8: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	case RenderTextureFormat::RGBA8_SRGB: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	case RenderTextureFormat::R32_Float: return DXGI_FORMAT_R32_FLOAT;
+	case RenderTextureFormat::RGBA16_Float: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case RenderTextureFormat::D32_Float: return DXGI_FORMAT_R32_FLOAT;
+	}
+	return DXGI_FORMAT_R8G8B8A8_UNORM;
+}
+
+void D3D11RenderDevice::ReleaseBuffer(RenderBufferHandle buffer)
+{
+	if (buffer) GetBuffer(buffer)->Release();
+}
+
+void D3D11RenderDevice::ReleaseTexture(RenderTextureHandle texture)
+{
+	if (texture) GetTexture(texture)->Release();
+}
+
+IRenderContext* D3D11RenderDevice::GetImmediateContext()
+{
+	return &immediate;
+}
+
+const char* D3D11RenderDevice::GetName()
+{
+	return "Direct3D 11";
+}
+
+ID3D11Buffer* D3D11RenderDevice::GetBuffer(RenderBufferHandle buffer)
+{
+	return (ID3D11Buffer*)(uintptr_t)buffer;
+}
+
+ID3D11ShaderResourceView* D3D11RenderDevice::GetTexture(RenderTextureHandle texture)
+{
+	return (ID3D11ShaderResourceView*)(uintptr_t)texture;
+}
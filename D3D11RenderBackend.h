@@ -0,0 +1,60 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+
+#include "RenderInterface.h"
+
+// --------------------------------------------------------
+// Wraps a D3D11 device context (immediate or deferred)
+//
+// - Holds nothing but the context pointer, so it's cheap
+//   to make one on the stack around any context
+// - Buffer handles are ID3D11Buffer pointers and texture
+//   handles are ID3D11ShaderResourceView pointers
+// --------------------------------------------------------
+class D3D11RenderContext : public IRenderContext
+{
+public:
+	D3D11RenderContext(ID3D11DeviceContext* context);
+
+	void SetTopology(RenderTopology topology) override;
+	void SetVertexBuffer(RenderBufferHandle buffer, unsigned int stride, unsigned int offset) override;
+	void SetIndexBuffer(RenderBufferHandle buffer, RenderIndexFormat format) override;
+	void SetConstantBuffer(RenderShaderStage stage, unsigned int slot, RenderBufferHandle buffer) override;
+	void SetTexture(RenderShaderStage stage, unsigned int slot, RenderTextureHandle texture) override;
+	void UpdateBuffer(RenderBufferHandle buffer, const void* data, unsigned int byteSize) override;
+	void Draw(unsigned int vertexCount, unsigned int startVertex) override;
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+
+	ID3D11DeviceContext* GetContext();
+
+private:
+	ID3D11DeviceContext* context;
+};
+
+// --------------------------------------------------------
+// The D3D11 backend, on top of Graphics::Device/Context
+// --------------------------------------------------------
+class D3D11RenderDevice : public IRenderDevice
+{
+public:
+	D3D11RenderDevice(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	RenderBufferHandle CreateBuffer(RenderBufferType type, const void* data, unsigned int byteSize, bool immutable) override;
+	RenderTextureHandle CreateTexture2D(unsigned int width, unsigned int height, RenderTextureFormat format, const void* data) override;
+	void ReleaseBuffer(RenderBufferHandle buffer) override;
+	void ReleaseTexture(RenderTextureHandle texture) override;
+	IRenderContext* GetImmediateContext() override;
+	const char* GetName() override;
+
+	// Handle <-> D3D object
+	static ID3D11Buffer* GetBuffer(RenderBufferHandle buffer);
+	static ID3D11ShaderResourceView* GetTexture(RenderTextureHandle texture);
+	static DXGI_FORMAT GetFormat(RenderTextureFormat format);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	D3D11RenderContext immediate;
+};
@@ -0,0 +1,95 @@
+#include "D3D11ShaderVariants.h"
+#include "PathHelpers.h"
+
+#include <cstdio>
+#include <filesystem>
+
+PixelShaderVariants::PixelShaderVariants(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	std::shared_ptr<ShaderVariantCache> cache, const std::string& sourcePath, std::shared_ptr<SimplePixelShader> fallback) :
+	device(device),
+	context(context),
+	cache(cache),
+	sourcePath(sourcePath),
+	fallback(fallback)
+{
+	sourceHash = ShaderVariantCache::HashSourceFile(sourcePath);
+}
+
+std::shared_ptr<SimplePixelShader> PixelShaderVariants::Get(unsigned int features)
+{
+	auto found = loaded.find(features);
+	if (found != loaded.end()) return found->second;
+
+	std::shared_ptr<SimplePixelShader> shader = fallback;
+	if (sourceHash != 0) {
+		ShaderVariantKey key = {};
+		key.Source = std::filesystem::path(sourcePath).filename().string();
+		key.Entry = "main";
+		key.Profile = "ps_5_0";
+		key.Features = features;
+		key.SourceHash = sourceHash;
+
+		std::string path = cache->FindOrCompile(sourcePath, key, Compile);
+		if (!path.empty()) {
+			std::shared_ptr<SimplePixelShader> variant = std::make_shared<SimplePixelShader>(device, context, NarrowToWide(path).c_str());
+			if (variant->IsShaderValid()) shader = variant;
+		}
+		else {
+			printf("Shader variant failed, using the full shader: %s\n", cache->GetLastError().c_str());
+		}
+	}
+
+	loaded[features] = shader;
+	return shader;
+}
+
+// --------------------------------------------------------
+// Compiles one variant with the same settings the project
+// uses for its own shaders (shader model 5, main)
+// --------------------------------------------------------
+bool PixelShaderVariants::Compile(const std::string& sourcePath, const ShaderVariantKey& key,
+	const std::vector<ShaderDefine>& defines, std::vector<unsigned char>& bytecode, std::string& errors)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (auto& d : defines) macros.push_back({ d.Name.c_str(), d.Value.c_str() });
+	macros.push_back({ 0, 0 });
+
+	UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if defined(DEBUG) || defined(_DEBUG)
+	flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+	flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#endif
+
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	Microsoft::WRL::ComPtr<ID3DBlob> errorBlob;
+	HRESULT hr = D3DCompileFromFile(NarrowToWide(sourcePath).c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		key.Entry.c_str(), key.Profile.c_str(), flags, 0, blob.GetAddressOf(), errorBlob.GetAddressOf());
+
+	if (errorBlob)
+		errors.assign((const char*)errorBlob->GetBufferPointer(), errorBlob->GetBufferSize());
+	if (FAILED(hr)) return false;
+
+	const unsigned char* bytes = (const unsigned char*)blob->GetBufferPointer();
+	bytecode.assign(bytes, bytes + blob->GetBufferSize());
+	return true;
+}
+
+
+// --------------------------------------------------------
+// GETTERS
+// --------------------------------------------------------
+unsigned int PixelShaderVariants::GetLoadedCount()
+{
+	return (unsigned int)loaded.size();
+}
+
+bool PixelShaderVariants::HasSource()
+{
+	return sourceHash != 0;
+}
+
+const std::string& PixelShaderVariants::GetSourcePath()
+{
+	return sourcePath;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "ShaderVariants.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Every variant of one pixel shader that's been asked for
+//
+// - Variants come from the on-disk cache, or are compiled
+//   from the .hlsl (with D3DCompileFromFile) and stored in
+//   it the first time they're used
+// - Each variant is loaded once and shared by every
+//   material that uses it
+// - Falls back to the shader the project built (every
+//   feature on) when the source or compiler isn't there
+// --------------------------------------------------------
+class PixelShaderVariants
+{
+public:
+	/// <summary>
+	/// Sets up variants of one shader
+	/// </summary>
+	/// <param name="cache">where compiled variants are kept</param>
+	/// <param name="sourcePath">the .hlsl to compile variants from</param>
+	/// <param name="fallback">used for any variant that can't be made</param>
+	PixelShaderVariants(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		std::shared_ptr<ShaderVariantCache> cache, const std::string& sourcePath, std::shared_ptr<SimplePixelShader> fallback);
+
+	/// <summary>
+	/// The variant with exactly these features, loaded (or compiled) on first use
+	/// </summary>
+	std::shared_ptr<SimplePixelShader> Get(unsigned int features);
+
+	unsigned int GetLoadedCount();		// feature sets asked for so far
+	bool HasSource();
+	const std::string& GetSourcePath();	// empty when there wasn't one
+
+	// D3DCompileFromFile as a ShaderCompileFunction
+	static bool Compile(const std::string& sourcePath, const ShaderVariantKey& key,
+		const std::vector<ShaderDefine>& defines, std::vector<unsigned char>& bytecode, std::string& errors);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	std::shared_ptr<ShaderVariantCache> cache;
+	std::string sourcePath;
+	unsigned long long sourceHash;		// 0 when the source isn't there
+	std::shared_ptr<SimplePixelShader> fallback;
+	std::unordered_map<unsigned int, std::shared_ptr<SimplePixelShader>> loaded;
+};
@@ -0,0 +1,77 @@
+#include "D3D11TextureArrays.h"
+
+// --------------------------------------------------------
+// Gets the texture an SRV views, if it's a plain 2D one
+// --------------------------------------------------------
+static Microsoft::WRL::ComPtr<ID3D11Texture2D> GetTexture(ID3D11ShaderResourceView* srv, D3D11_TEXTURE2D_DESC& desc)
+{
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (!srv) return texture;
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	srv->GetResource(resource.GetAddressOf());
+	if (FAILED(resource.As(&texture))) return texture;
+
+	texture->GetDesc(&desc);
+	if (desc.ArraySize != 1 || desc.SampleDesc.Count != 1)
+		texture.Reset();
+	return texture;
+}
+
+bool D3D11TextureArrays::Describe(ID3D11ShaderResourceView* srv, TextureArrayInput& input)
+{
+	D3D11_TEXTURE2D_DESC desc = {};
+	if (!GetTexture(srv, desc)) return false;
+
+	input.Width = desc.Width;
+	input.Height = desc.Height;
+	input.MipLevels = desc.MipLevels;
+	input.Format = (unsigned int)desc.Format;
+	return true;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> D3D11TextureArrays::Create(Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const std::vector<ID3D11ShaderResourceView*>& layers)
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (layers.empty()) return srv;
+
+	D3D11_TEXTURE2D_DESC first = {};
+	if (!GetTexture(layers[0], first)) return srv;
+
+	// the array only needs to be read from
+	D3D11_TEXTURE2D_DESC desc = first;
+	desc.ArraySize = (UINT)layers.size();
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> array;
+	if (FAILED(device->CreateTexture2D(&desc, 0, array.GetAddressOf()))) return srv;
+
+	// GPU side copies, every mip of every layer
+	for (UINT layer = 0; layer < desc.ArraySize; layer++)
+	{
+		D3D11_TEXTURE2D_DESC layerDesc = {};
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture = GetTexture(layers[layer], layerDesc);
+		if (!texture || layerDesc.Width != desc.Width || layerDesc.Height != desc.Height ||
+			layerDesc.MipLevels != desc.MipLevels || layerDesc.Format != desc.Format)
+			return srv;
+
+		for (UINT mip = 0; mip < desc.MipLevels; mip++)
+			context->CopySubresourceRegion(
+				array.Get(), D3D11CalcSubresource(mip, layer, desc.MipLevels), 0, 0, 0,
+				texture.Get(), D3D11CalcSubresource(mip, 0, desc.MipLevels), 0);
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = desc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+	srvDesc.Texture2DArray.MostDetailedMip = 0;
+	srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+	srvDesc.Texture2DArray.FirstArraySlice = 0;
+	srvDesc.Texture2DArray.ArraySize = desc.ArraySize;
+	device->CreateShaderResourceView(array.Get(), &srvDesc, srv.GetAddressOf());
+	return srv;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+
+#include "TextureArrayPlanner.h"
+
+// --------------------------------------------------------
+// The D3D11 half of texture array packing: describing
+// existing textures for the planner, and copying them
+// into a Texture2DArray once it has planned the layers
+// --------------------------------------------------------
+class D3D11TextureArrays
+{
+public:
+	/// <summary>
+	/// Describes the 2D texture behind an SRV
+	/// </summary>
+	/// <returns>false if it isn't a single 2D texture</returns>
+	static bool Describe(ID3D11ShaderResourceView* srv, TextureArrayInput& input);
+
+	/// <summary>
+	/// Copies textures (every mip) into a new array, one per layer
+	/// </summary>
+	/// <param name="layers">textures that all match, as TextureArrayPlanner::Matches sees it</param>
+	/// <returns>an SRV of the whole array, or null if it couldn't be made</returns>
+	static Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Create(Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const std::vector<ID3D11ShaderResourceView*>& layers);
+};
@@ -0,0 +1,235 @@
+#include "D3D11TextureStreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+
+D3D11TextureStreamer::D3D11TextureStreamer(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	size_t budgetBytes, unsigned int tailSize, unsigned int maxLoadsInFlight) :
+	device(device),
+	context(context),
+	tailSize(std::max(4u, tailSize)),
+	residency(budgetBytes, maxLoadsInFlight),
+	contentHits(0),
+	lastUpdateMs(0)
+{
+	stopping = false;
+	loader = std::thread([this]() { LoaderLoop(); });
+}
+
+D3D11TextureStreamer::~D3D11TextureStreamer()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	loader.join();
+}
+
+
+// --------------------------------------------------------
+// Adding textures
+// --------------------------------------------------------
+int D3D11TextureStreamer::Add(const std::wstring& path, const TextureLoadResult& loaded)
+{
+	if (!loaded.Succeeded) return -1;
+
+	// the same path, or the same bytes under another one
+	std::wstring key = std::filesystem::path(path).lexically_normal().wstring();
+	auto known = byPath.find(key);
+	if (known != byPath.end()) return (int)known->second;
+	auto same = byHash.find(loaded.Hash);
+	if (same != byHash.end() && textures[same->second].FileBytes == loaded.FileBytes) {
+		textures[same->second].Aliases.push_back(key);
+		byPath[key] = same->second;
+		contentHits++;
+		return (int)same->second;
+	}
+
+	// just the size first, to find where the tail starts
+	TextureMips mips = {};
+	std::string error;
+	bool decoded = !loaded.Image.Pixels.empty();
+	if (decoded)
+		TextureMipReader::FromImage(loaded.Image, {}, 0, 0, mips);
+	else if (!TextureMipReader::ReadDDS(loaded.Contents.data(), loaded.Contents.size(), 0, 0, mips, error))
+		return -1;
+
+	// the tail's top has to stay a whole number of blocks for BC formats
+	bool blocks = mips.Format != TextureMipReader::FormatRGBA8 && mips.Format != TextureMipReader::FormatR8;
+	unsigned int tail = 0;
+	while (tail + 1 < mips.MipLevels && std::max(mips.Width >> tail, mips.Height >> tail) > tailSize) tail++;
+	while (blocks && tail > 0 && (((mips.Width >> tail) & 3) || ((mips.Height >> tail) & 3))) tail--;
+
+	if (decoded)
+		TextureMipReader::FromImage(loaded.Image, TextureMipReader::GetMipOptions(path, loaded.Image), tail, mips.MipLevels, mips);
+	else if (!TextureMipReader::ReadDDS(loaded.Contents.data(), loaded.Contents.size(), tail, mips.MipLevels, mips, error))
+		return -1;
+	if (mips.FirstMip + mips.Levels.size() != mips.MipLevels) return -1;
+
+	StreamedTexture t = {};
+	t.Path = path;
+	t.Hash = loaded.Hash;
+	t.FileBytes = loaded.FileBytes;
+	t.Width = mips.Width;
+	t.Height = mips.Height;
+	t.MipLevels = mips.MipLevels;
+	t.Format = mips.Format;
+	t.TopMip = mips.MipLevels;		// nothing yet
+	textures.push_back(t);
+	unsigned int index = (unsigned int)textures.size() - 1;
+	if (!Rebuild(index, tail, &mips)) {
+		textures.pop_back();
+		return -1;
+	}
+
+	std::vector<size_t> mipBytes;
+	for (unsigned int mip = 0; mip < mips.MipLevels; mip++)
+		mipBytes.push_back(TextureMipReader::GetMipBytes(mips.Format, mips.Width, mips.Height, mip));
+	residency.Add(mipBytes, tail);
+	byPath[key] = index;
+	byHash.emplace(loaded.Hash, index);
+	return (int)index;
+}
+
+int D3D11TextureStreamer::Find(ID3D11ShaderResourceView* srv)
+{
+	for (unsigned int i = 0; i < textures.size(); i++)
+		if (srv && textures[i].SRV.Get() == srv) return (int)i;
+	return -1;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> D3D11TextureStreamer::GetSRV(unsigned int texture)
+{
+	return textures[texture].SRV;
+}
+
+
+// --------------------------------------------------------
+// Remaking a texture with a different number of levels
+// (everything it keeps is copied on the GPU, the rest
+// uploaded from levels)
+// --------------------------------------------------------
+bool D3D11TextureStreamer::Rebuild(unsigned int texture, unsigned int topMip, const TextureMips* levels)
+{
+	StreamedTexture& t = textures[texture];
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = std::max(1u, t.Width >> topMip);
+	desc.Height = std::max(1u, t.Height >> topMip);
+	desc.MipLevels = t.MipLevels - topMip;
+	desc.ArraySize = 1;
+	desc.Format = (DXGI_FORMAT)t.Format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> resized;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(device->CreateTexture2D(&desc, 0, resized.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(resized.Get(), 0, srv.GetAddressOf()))) {
+		lastError = "couldn't create a texture for streaming";
+		return false;
+	}
+
+	for (unsigned int mip = topMip; mip < t.MipLevels; mip++) {
+		UINT subresource = mip - topMip;
+		if (levels && mip >= levels->FirstMip && mip - levels->FirstMip < levels->Levels.size())
+			context->UpdateSubresource(resized.Get(), subresource, 0, levels->Levels[mip - levels->FirstMip].data(),
+				TextureMipReader::GetRowPitch(t.Format, t.Width, mip), 0);
+		else if (t.Texture && mip >= t.TopMip)
+			context->CopySubresourceRegion(resized.Get(), subresource, 0, 0, 0, t.Texture.Get(), mip - t.TopMip, 0);
+	}
+
+	t.Texture = resized;
+	t.SRV = srv;
+	t.TopMip = topMip;
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Per frame
+// --------------------------------------------------------
+void D3D11TextureStreamer::BeginFrame()
+{
+	residency.BeginFrame();
+}
+
+void D3D11TextureStreamer::Request(unsigned int texture, float mip)
+{
+	residency.Request(texture, mip);
+}
+
+std::vector<unsigned int> D3D11TextureStreamer::Update()
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Clock::time_point start = Clock::now();
+	std::vector<unsigned int> changed;
+
+	// finished loads first, so Plan sees what's really resident
+	std::deque<LoadDone> finished;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		finished.swap(done);
+	}
+	for (auto& d : finished) {
+		bool created = d.Succeeded && Rebuild(d.Texture, d.Mips.FirstMip, &d.Mips);
+		if (!d.Succeeded) lastError = d.Error;
+		residency.Finish(d.Texture, created);
+		if (created) changed.push_back(d.Texture);
+	}
+
+	// evictions happen now, loads go to the loader thread
+	std::vector<LoadJob> started;
+	for (auto& c : residency.Plan()) {
+		if (!c.Load) {
+			if (Rebuild(c.Texture, c.TopMip, 0)) changed.push_back(c.Texture);
+			continue;
+		}
+		const StreamedTexture& t = textures[c.Texture];
+		started.push_back({ c.Texture, t.Path, c.TopMip, t.TopMip - c.TopMip });
+	}
+	if (!started.empty()) {
+		std::lock_guard<std::mutex> guard(lock);
+		jobs.insert(jobs.end(), started.begin(), started.end());
+		wake.notify_one();
+	}
+
+	lastUpdateMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	return changed;
+}
+
+void D3D11TextureStreamer::LoaderLoop()
+{
+	while (true) {
+		LoadJob job;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this]() { return stopping || !jobs.empty(); });
+			if (stopping) return;
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		LoadDone result = {};
+		result.Texture = job.Texture;
+		result.Succeeded = TextureMipReader::ReadFile(job.Path, job.TopMip, job.Count, result.Mips, result.Error) &&
+			result.Mips.FirstMip == job.TopMip && result.Mips.Levels.size() == job.Count;
+		if (!result.Succeeded && result.Error.empty()) result.Error = "mips missing from a streamed texture";
+
+		std::lock_guard<std::mutex> guard(lock);
+		done.push_back(std::move(result));
+	}
+}
+
+
+// --------------------------------------------------------
+// Accounting
+// --------------------------------------------------------
+TextureResidency& D3D11TextureStreamer::GetResidency() { return residency; }
+const std::vector<StreamedTexture>& D3D11TextureStreamer::GetTextures() { return textures; }
+unsigned int D3D11TextureStreamer::GetContentHits() { return contentHits; }
+const std::string& D3D11TextureStreamer::GetLastError() { return lastError; }
+double D3D11TextureStreamer::GetLastUpdateMs() { return lastUpdateMs; }
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureStreaming.h"
+#include "TextureLoadPipeline.h"
+
+// --------------------------------------------------------
+// One streamed texture, as it is on the GPU right now
+// --------------------------------------------------------
+struct StreamedTexture
+{
+	std::wstring Path;			// the file later mips are read from (.dds or .png)
+	std::vector<std::wstring> Aliases;	// other paths that turned out to hold the same bytes
+	unsigned long long Hash;	// of the file's contents (see ContentHash)
+	size_t FileBytes;
+	unsigned int Width;			// of mip 0, resident or not
+	unsigned int Height;
+	unsigned int MipLevels;
+	unsigned int Format;		// DXGI_FORMAT value
+	unsigned int TopMip;		// the finest level the texture below holds
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> Texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+};
+
+// --------------------------------------------------------
+// The D3D11 half of mip streaming
+//
+// - Textures start with just their tail (every mip no
+//   larger than tailSize) on the GPU
+// - TextureResidency decides what's resident; loads are
+//   read (and for PNGs, decoded and mipped) on a loader
+//   thread of its own, so they never hold up the frame's
+//   thread pool work
+// - A texture's resident levels live in one texture of
+//   exactly that many mips, remade whenever they change:
+//   levels that stay are copied over on the GPU, new ones
+//   uploaded.  Its SRV changes with it, so whoever binds
+//   it has to pick up the new one (see Update).
+// - Like TextureRegistry, textures are looked up by path
+//   and then by contents, so the same image under two
+//   names is streamed (and budgeted) once
+// --------------------------------------------------------
+class D3D11TextureStreamer
+{
+public:
+	D3D11TextureStreamer(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		size_t budgetBytes, unsigned int tailSize = 64, unsigned int maxLoadsInFlight = 4);
+	~D3D11TextureStreamer();
+	D3D11TextureStreamer(const D3D11TextureStreamer&) = delete;
+	D3D11TextureStreamer& operator=(const D3D11TextureStreamer&) = delete;
+
+	/// <summary>
+	/// Starts streaming a texture TextureLoadPipeline loaded (decoded pixels or a cooked .dds)
+	/// </summary>
+	/// <param name="path">the file it was loaded from, read again for finer mips</param>
+	/// <returns>the texture's index (an existing one if the path or contents match), or -1 if it can't be streamed</returns>
+	int Add(const std::wstring& path, const TextureLoadResult& loaded);
+
+	// Index of the streamed texture behind an SRV, or -1
+	int Find(ID3D11ShaderResourceView* srv);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetSRV(unsigned int texture);
+
+	// Forgets last frame's requests
+	void BeginFrame();
+
+	// Asks for a texture down to a mip (see TextureResidency::GetDesiredMip)
+	void Request(unsigned int texture, float mip);
+
+	/// <summary>
+	/// Creates the loads that finished, applies evictions and starts new loads
+	/// </summary>
+	/// <returns>textures whose SRV changed</returns>
+	std::vector<unsigned int> Update();
+
+	TextureResidency& GetResidency();
+	const std::vector<StreamedTexture>& GetTextures();
+	unsigned int GetContentHits();		// Adds that found the same bytes under another path
+	const std::string& GetLastError();
+	double GetLastUpdateMs();
+
+private:
+	struct LoadJob
+	{
+		unsigned int Texture;
+		std::wstring Path;
+		unsigned int TopMip;
+		unsigned int Count;		// levels from TopMip to what's resident
+	};
+	struct LoadDone
+	{
+		unsigned int Texture;
+		bool Succeeded;
+		std::string Error;
+		TextureMips Mips;
+	};
+
+	// remakes a texture with levels topMip and smaller, from its old texture and (optionally) new levels
+	bool Rebuild(unsigned int texture, unsigned int topMip, const TextureMips* levels);
+	void LoaderLoop();
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	unsigned int tailSize;
+	TextureResidency residency;
+	std::vector<StreamedTexture> textures;
+	std::unordered_map<std::wstring, unsigned int> byPath;		// every path and alias, into textures
+	std::unordered_map<unsigned long long, unsigned int> byHash;
+	unsigned int contentHits;
+	std::string lastError;
+	double lastUpdateMs;
+
+	// the loader thread's queues
+	std::thread loader;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<LoadJob> jobs;
+	std::deque<LoadDone> done;
+	bool stopping;
+};
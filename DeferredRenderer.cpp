@@ -0,0 +1,144 @@
+#include "DeferredRenderer.h"
+#include "Graphics.h"
+#include "SimpleShader.h"
+
+DeferredRenderer::DeferredRenderer(Microsoft::WRL::ComPtr<ID3D11Device> device, std::shared_ptr<ThreadPool> pool) :
+	device(device),
+	pool(pool)
+{
+	multithreaded = true;
+	minItemsPerJob = 64;
+	jobCount = 0;
+	lastJobCount = 0;
+
+	// one deferred context per thread that can record at once (the workers
+	// plus the caller), limited by how many local data slots shaders have
+	unsigned int contextCount = pool->GetThreadCount() + 1;
+	if (contextCount > ISimpleShader::MaxThreadSlots - 1)
+		contextCount = ISimpleShader::MaxThreadSlots - 1;
+
+	std::vector<ID3D11DeviceContext*> raw;
+	for (unsigned int i = 0; i < contextCount; i++)
+	{
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		if (FAILED(device->CreateDeferredContext(0, context.GetAddressOf())))
+			break;
+
+		deferredContexts.push_back(context);
+		raw.push_back(context.Get());
+	}
+
+	// no deferred contexts means no multithreading
+	if (deferredContexts.empty())
+		multithreaded = false;
+
+	recorder = std::make_unique<ParallelRecorder<ID3D11DeviceContext>>(pool.get(), raw);
+}
+
+DeferredRenderer::~DeferredRenderer()
+{
+}
+
+void DeferredRenderer::RecordPass(
+	unsigned int itemCount,
+	const std::function<void(ID3D11DeviceContext*)>& setup,
+	const std::function<void(ID3D11DeviceContext*, unsigned int)>& draw)
+{
+	// single threaded: same functions, straight into the immediate context
+	if (!multithreaded)
+	{
+		setup(Graphics::Context.Get());
+		for (unsigned int i = 0; i < itemCount; i++)
+			draw(Graphics::Context.Get(), i);
+
+		jobCount++;
+		return;
+	}
+
+	// each job gets its own slot in the command list array, filled
+	// in whatever order the threads happen to finish
+	size_t first = commandLists.size();
+	commandLists.resize(first + deferredContexts.size());
+
+	unsigned int jobs = recorder->Record(itemCount, minItemsPerJob,
+		[&](ID3D11DeviceContext* context, unsigned int job, RecordRange range)
+		{
+			// shaders used on this thread now record into our context,
+			// with their own copy of the constant data
+			ISimpleShader::BindThreadContext(context, job + 1);
+
+			setup(context);
+			for (unsigned int i = range.Begin; i < range.End; i++)
+				draw(context, i);
+
+			ISimpleShader::UnbindThreadContext();
+
+			// close the list; the context is reset and ready for reuse
+			context->FinishCommandList(FALSE, commandLists[first + job].GetAddressOf());
+		});
+
+	// drop the slots we didn't need
+	commandLists.resize(first + jobs);
+	jobCount += jobs;
+}
+
+void DeferredRenderer::RecordCommands(const std::function<void(ID3D11DeviceContext*)>& commands)
+{
+	// a single item pass whose setup does all the work
+	RecordPass(1, commands, [](ID3D11DeviceContext*, unsigned int) {});
+}
+
+void DeferredRenderer::FlushPasses(ID3D11DeviceContext* immediate)
+{
+	// play back in recording order, which is submission order
+	for (auto& list : commandLists)
+		immediate->ExecuteCommandList(list.Get(), FALSE);
+
+	// the lists wrote constant buffers behind the shaders' backs
+	if (!commandLists.empty())
+		ISimpleShader::InvalidateUploads();
+	commandLists.clear();
+}
+
+void DeferredRenderer::ExecutePasses(ID3D11DeviceContext* immediate)
+{
+	FlushPasses(immediate);
+
+	// frame's done, keep its job count around for display
+	lastJobCount = jobCount;
+	jobCount = 0;
+}
+
+bool DeferredRenderer::IsMultithreaded()
+{
+	return multithreaded;
+}
+
+void DeferredRenderer::SetMultithreaded(bool enabled)
+{
+	// can't switch modes halfway through a frame
+	if (!commandLists.empty())
+		return;
+
+	multithreaded = enabled && !deferredContexts.empty();
+}
+
+unsigned int DeferredRenderer::GetMinItemsPerJob()
+{
+	return minItemsPerJob;
+}
+
+void DeferredRenderer::SetMinItemsPerJob(unsigned int count)
+{
+	minItemsPerJob = count > 0 ? count : 1;
+}
+
+unsigned int DeferredRenderer::GetJobCount()
+{
+	return lastJobCount;
+}
+
+unsigned int DeferredRenderer::GetContextCount()
+{
+	return (unsigned int)deferredContexts.size();
+}
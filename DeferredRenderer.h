@@ -0,0 +1,80 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ParallelRecorder.h"
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// Records draw passes on worker threads into D3D11 deferred
+// contexts, then plays the command lists back in order on
+// the immediate context.
+//
+// A pass is a setup function (run once per job, since every
+// deferred context starts from default pipeline state) and
+// a draw function that is called for each item in the job.
+// --------------------------------------------------------
+class DeferredRenderer
+{
+public:
+	DeferredRenderer(Microsoft::WRL::ComPtr<ID3D11Device> device, std::shared_ptr<ThreadPool> pool);
+	~DeferredRenderer();
+
+	/// <summary>
+	/// Records a pass, split into in-order jobs across the worker threads.
+	/// When multithreading is off this draws straight into the immediate context.
+	/// </summary>
+	/// <param name="itemCount">number of items (usually entities) in the pass</param>
+	/// <param name="setup">binds targets and state for the pass on the given context</param>
+	/// <param name="draw">draws item i on the given context</param>
+	void RecordPass(
+		unsigned int itemCount,
+		const std::function<void(ID3D11DeviceContext*)>& setup,
+		const std::function<void(ID3D11DeviceContext*, unsigned int)>& draw);
+
+	/// <summary>
+	/// Records one-off commands (clears, copies) so they run in order with the passes
+	/// </summary>
+	/// <param name="commands">issues the commands on the given context</param>
+	void RecordCommands(const std::function<void(ID3D11DeviceContext*)>& commands);
+
+	/// <summary>
+	/// Executes every recorded command list on the immediate context
+	/// in the order it was recorded.  The immediate context is left
+	/// in its default state afterwards.
+	/// </summary>
+	/// <param name="immediate">the immediate context</param>
+	void ExecutePasses(ID3D11DeviceContext* immediate);
+
+	/// <summary>
+	/// Executes what's been recorded so far without ending the frame,
+	/// for work that has to go straight to the immediate context next
+	/// </summary>
+	/// <param name="immediate">the immediate context</param>
+	void FlushPasses(ID3D11DeviceContext* immediate);
+
+	// GETTERS / SETTERS
+	bool IsMultithreaded();
+	void SetMultithreaded(bool enabled);
+	unsigned int GetMinItemsPerJob();
+	void SetMinItemsPerJob(unsigned int count);
+	unsigned int GetJobCount();				// jobs recorded last frame, across all passes
+	unsigned int GetContextCount();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	std::shared_ptr<ThreadPool> pool;
+
+	std::vector<Microsoft::WRL::ComPtr<ID3D11DeviceContext>> deferredContexts;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11CommandList>> commandLists;	// in execution order
+	std::unique_ptr<ParallelRecorder<ID3D11DeviceContext>> recorder;
+
+	bool multithreaded;
+	unsigned int minItemsPerJob;
+	unsigned int jobCount;		// jobs recorded so far this frame
+	unsigned int lastJobCount;	// jobs recorded in the last finished frame
+};
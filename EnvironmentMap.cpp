@@ -0,0 +1,489 @@
+#include "EnvironmentMap.h"
+#include "BlockCompression.h"
+#include "ContentHash.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <emmintrin.h>
+
+namespace
+{
+	const float Pi = 3.14159265358979f;
+	const unsigned int CacheVersion = 1;		// bump when the conversion itself changes
+
+	// Splits rows into blocks, across the pool if there is one
+	void ForRows(ThreadPool* pool, unsigned int rows, const std::function<void(unsigned int, unsigned int)>& body)
+	{
+		const unsigned int block = 16;
+		unsigned int blocks = (rows + block - 1) / block;
+		auto job = [&](unsigned int b) { body(b * block, std::min(rows, (b + 1) * block)); };
+		if (pool && blocks > 1) pool->ParallelFor(blocks, job);
+		else for (unsigned int b = 0; b < blocks; b++) job(b);
+	}
+
+	unsigned int FloorPowerOfTwo(unsigned int value)
+	{
+		unsigned int p = 1;
+		while (p * 2 <= value) p *= 2;
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// atan2 for four lanes: a polynomial for atan on [0, 1]
+	// (within 2e-6 radians, a hundredth of a texel of a 32k
+	// wide image), then the octant fixed up
+	// --------------------------------------------------------
+	__m128 Atan2(__m128 y, __m128 x)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 ax = _mm_andnot_ps(signMask, x), ay = _mm_andnot_ps(signMask, y);
+		__m128 high = _mm_max_ps(ax, ay), low = _mm_min_ps(ax, ay);
+		__m128 a = _mm_div_ps(low, _mm_max_ps(high, _mm_set1_ps(1e-30f)));
+		__m128 s = _mm_mul_ps(a, a);
+
+		__m128 r = _mm_set1_ps(-0.01172120f);
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.05265332f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.11643287f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.19354346f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(-0.33262347f));
+		r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(0.99997726f));
+		r = _mm_mul_ps(r, a);
+
+		__m128 steep = _mm_cmpgt_ps(ay, ax);
+		r = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(_mm_set1_ps(Pi / 2), r)), _mm_andnot_ps(steep, r));
+		__m128 behind = _mm_cmplt_ps(x, _mm_setzero_ps());
+		r = _mm_or_ps(_mm_and_ps(behind, _mm_sub_ps(_mm_set1_ps(Pi), r)), _mm_andnot_ps(behind, r));
+		return _mm_or_ps(r, _mm_and_ps(signMask, y));
+	}
+
+	// floor for four lanes (SSE2 only truncates)
+	__m128i Floor(__m128 value)
+	{
+		__m128i t = _mm_cvttps_epi32(value);
+		return _mm_add_epi32(t, _mm_castps_si128(_mm_cmplt_ps(value, _mm_cvtepi32_ps(t))));
+	}
+
+	// --------------------------------------------------------
+	// Cube map addressing, D3D's conventions: u across each
+	// face (four lanes) and v down it, both in [-1, 1]; the
+	// direction isn't normalized, atan2 doesn't need it to be
+	// --------------------------------------------------------
+	void FaceDirections(unsigned int face, __m128 u, float v, __m128& x, __m128& y, __m128& z)
+	{
+		const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+		__m128 vv = _mm_set1_ps(v);
+		switch (face) {
+		case 0: x = one; y = _mm_sub_ps(zero, vv); z = _mm_sub_ps(zero, u); break;
+		case 1: x = _mm_sub_ps(zero, one); y = _mm_sub_ps(zero, vv); z = u; break;
+		case 2: x = u; y = one; z = vv; break;
+		case 3: x = u; y = _mm_sub_ps(zero, one); z = _mm_sub_ps(zero, vv); break;
+		case 4: x = u; y = _mm_sub_ps(zero, vv); z = one; break;
+		default: x = _mm_sub_ps(zero, u); y = _mm_sub_ps(zero, vv); z = _mm_sub_ps(zero, one); break;
+		}
+	}
+
+	void BoxDown(const float* above, unsigned int aboveSize, float* below, ThreadPool* pool)
+	{
+		unsigned int size = std::max(1u, aboveSize / 2);
+		ForRows(pool, size, [&](unsigned int first, unsigned int end) {
+			for (unsigned int y = first; y < end; y++)
+				for (unsigned int x = 0; x < size; x++) {
+					const float* a = above + ((size_t)(y * 2) * aboveSize + x * 2) * 4;
+					const float* b = a + (size_t)aboveSize * 4;
+					__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(a + 4)), _mm_add_ps(_mm_loadu_ps(b), _mm_loadu_ps(b + 4)));
+					_mm_storeu_ps(below + ((size_t)y * size + x) * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+				}
+		});
+	}
+
+	float HalfToFloat(unsigned short half)
+	{
+		unsigned int exponent = (half >> 10) & 0x1F, mantissa = half & 0x3FF;
+		float value = exponent == 0 ? mantissa / 16777216.0f : ldexpf(1.0f + mantissa / 1024.0f, (int)exponent - 15);
+		return (half & 0x8000) ? -value : value;
+	}
+
+	template <typename T>
+	bool Read(std::ifstream& in, T& value)
+	{
+		return (bool)in.read((char*)&value, sizeof(T));
+	}
+}
+
+
+// --------------------------------------------------------
+// Options, keys and formats
+// --------------------------------------------------------
+EnvironmentMapOptions EnvironmentMap::Resolve(const EnvironmentMapOptions& options, unsigned int width)
+{
+	EnvironmentMapOptions o = options;
+	o.FaceSize = std::clamp(FloorPowerOfTwo(o.FaceSize ? o.FaceSize : std::min(width / 4, 1024u)), 4u, 8192u);
+
+	// a face texel spans about (pi / 2) / FaceSize, an image texel 2 pi / width
+	unsigned int cover = (unsigned int)ceilf(width / (4.0f * o.FaceSize));
+	o.Samples = std::clamp(o.Samples ? o.Samples : cover, 1u, 4u);
+	return o;
+}
+
+unsigned long long EnvironmentMap::GetKey(const unsigned char* data, size_t size, const EnvironmentMapOptions& options)
+{
+	unsigned int settings[4] = { CacheVersion, options.FaceSize, options.Samples, options.BC6H ? 1u : 0u };
+	unsigned long long key = ContentHash::Hash64(settings, sizeof(settings));
+	return ContentHash::Hash64(data, size, key);
+}
+
+size_t EnvironmentMap::GetSubresourceSize(unsigned int format, unsigned int size)
+{
+	return (size_t)GetRowPitch(format, size) * (format == FormatBC6H ? (size + 3) / 4 : size);
+}
+
+unsigned int EnvironmentMap::GetRowPitch(unsigned int format, unsigned int size)
+{
+	return format == FormatBC6H ? (size + 3) / 4 * 16 : size * 8;
+}
+
+void EnvironmentMap::FloatsToHalves(const float* in, size_t count, unsigned short* out)
+{
+	// round to nearest even, with halves' denormals made by adding a magic
+	// number whose mantissa lines up with theirs (the usual bit tricks, four wide)
+	const __m128 denormalMagic = _mm_castsi128_ps(_mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23));
+	const __m128i smallest = _mm_set1_epi32(113 << 23);			// 2^-14, the smallest normal half
+	const __m128i rebias = _mm_set1_epi32(((15 - 127) << 23) + 0xFFF);
+	auto convert = [&](__m128 f) {
+		f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(65504.0f));
+		__m128i bits = _mm_castps_si128(f);
+		__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(f, denormalMagic)), _mm_castps_si128(denormalMagic));
+		__m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+		__m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, rebias), odd), 13);
+		__m128i isDenormal = _mm_cmplt_epi32(bits, smallest);
+		return _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+	};
+
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = convert(_mm_loadu_ps(in + i)), b = convert(_mm_loadu_ps(in + i + 4));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));		// every half fits a signed 16 bit
+	}
+	for (; i < count; i++) {
+		__m128i h = convert(_mm_set1_ps(in[i]));
+		out[i] = (unsigned short)_mm_cvtsi128_si32(h);
+	}
+}
+
+
+// --------------------------------------------------------
+// Conversion
+// --------------------------------------------------------
+void EnvironmentMap::ResampleFace(const HdrImage& image, unsigned int face, unsigned int faceSize, unsigned int samples, ThreadPool* pool, float* out)
+{
+	const int width = (int)image.Width, height = (int)image.Height;
+	const float* pixels = image.Pixels.data();
+	const __m128 uScale = _mm_set1_ps(width / (2 * Pi)), vScale = _mm_set1_ps(-height / Pi);
+	const __m128 uOffset = _mm_set1_ps(width * 0.5f - 0.5f), vOffset = _mm_set1_ps(height * 0.5f - 0.5f);
+	const __m128 vMax = _mm_set1_ps(height - 1.0f);
+	const float toFace = 2.0f / faceSize, step = 1.0f / samples;
+	const __m128 normalize = _mm_set1_ps(1.0f / (samples * samples));
+
+	ForRows(pool, faceSize, [&](unsigned int first, unsigned int end) {
+		alignas(16) int32_t x0[4], y0[4];
+		alignas(16) float wx[4], wy[4];
+		for (unsigned int y = first; y < end; y++) {
+			for (unsigned int x = 0; x < faceSize; x += 4) {
+				__m128 sum[4] = {};
+				for (unsigned int sy = 0; sy < samples; sy++) {
+					float v = (y + (sy + 0.5f) * step) * toFace - 1;
+					for (unsigned int sx = 0; sx < samples; sx++) {
+						float u0 = (x + (sx + 0.5f) * step) * toFace - 1;
+						__m128 u = _mm_add_ps(_mm_set1_ps(u0), _mm_setr_ps(0, toFace, 2 * toFace, 3 * toFace));
+						__m128 dx, dy, dz;
+						FaceDirections(face, u, v, dx, dy, dz);
+
+						// longitude from +Z towards +X, latitude up from the horizon
+						__m128 longitude = Atan2(dx, dz);
+						__m128 latitude = Atan2(dy, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz))));
+						__m128 fx = _mm_add_ps(_mm_mul_ps(longitude, uScale), uOffset);
+						__m128 fy = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(latitude, vScale), vOffset), _mm_setzero_ps()), vMax);
+						__m128i ix = Floor(fx), iy = _mm_cvttps_epi32(fy);
+						_mm_store_ps(wx, _mm_sub_ps(fx, _mm_cvtepi32_ps(ix)));
+						_mm_store_ps(wy, _mm_sub_ps(fy, _mm_cvtepi32_ps(iy)));
+						_mm_store_si128((__m128i*)x0, ix);
+						_mm_store_si128((__m128i*)y0, iy);
+
+						for (unsigned int lane = 0; lane < 4; lane++) {
+							// wrap around in longitude, clamp at the poles
+							int ax = x0[lane] < 0 ? x0[lane] + width : (x0[lane] >= width ? x0[lane] - width : x0[lane]);
+							int bx = ax + 1 == width ? 0 : ax + 1;
+							int by = std::min(y0[lane] + 1, height - 1);
+							const float* top = pixels + (size_t)y0[lane] * width * 4;
+							const float* bottom = pixels + (size_t)by * width * 4;
+							__m128 a = _mm_loadu_ps(top + ax * 4), b = _mm_loadu_ps(top + bx * 4);
+							__m128 c = _mm_loadu_ps(bottom + ax * 4), d = _mm_loadu_ps(bottom + bx * 4);
+							__m128 fx1 = _mm_set1_ps(wx[lane]);
+							__m128 upper = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fx1));
+							__m128 lower = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), fx1));
+							sum[lane] = _mm_add_ps(sum[lane], _mm_add_ps(upper, _mm_mul_ps(_mm_sub_ps(lower, upper), _mm_set1_ps(wy[lane]))));
+						}
+					}
+				}
+				float* dst = out + ((size_t)y * faceSize + x) * 4;
+				for (unsigned int lane = 0; lane < 4 && x + lane < faceSize; lane++)
+					_mm_storeu_ps(dst + lane * 4, _mm_mul_ps(sum[lane], normalize));
+			}
+		}
+	});
+}
+
+bool EnvironmentMap::Convert(const HdrImage& image, const EnvironmentMapOptions& options, ThreadPool* pool,
+	EnvironmentCube& cube, EnvironmentMapStats& stats, std::string& error)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	if (image.Width < 2 || image.Height < 1 || image.Pixels.size() != (size_t)image.Width * image.Height * 4) {
+		error = "no image to convert";
+		return false;
+	}
+	EnvironmentMapOptions o = Resolve(options, image.Width);
+	stats.SourceWidth = image.Width;
+	stats.SourceHeight = image.Height;
+
+	cube = {};
+	cube.FaceSize = o.FaceSize;
+	cube.Format = o.BC6H ? FormatBC6H : FormatRGBA16F;
+	while ((o.FaceSize >> cube.MipLevels) > 0) cube.MipLevels++;
+	cube.Subresources.resize((size_t)6 * cube.MipLevels);
+
+	// mips go back and forth between the two (every one after
+	// the first fits where mip 0 was)
+	std::vector<float> top((size_t)o.FaceSize * o.FaceSize * 4), second(top.size() / 4);
+	std::vector<unsigned short> halves;
+	for (unsigned int face = 0; face < 6; face++) {
+		float* level = top.data();
+		float* below = second.data();
+		Clock::time_point step = Clock::now();
+		ResampleFace(image, face, o.FaceSize, o.Samples, pool, level);
+		stats.ResampleMs += ms(step, Clock::now());
+
+		for (unsigned int mip = 0; mip < cube.MipLevels; mip++) {
+			unsigned int size = o.FaceSize >> mip;
+			if (mip > 0) {
+				step = Clock::now();
+				BoxDown(level, size * 2, below, pool);
+				std::swap(level, below);
+				stats.MipsMs += ms(step, Clock::now());
+			}
+
+			// halves straight into the subresource, or on their way to BC6H
+			step = Clock::now();
+			std::vector<unsigned char>& sub = cube.Subresources[(size_t)face * cube.MipLevels + mip];
+			size_t count = (size_t)size * size * 4;
+			unsigned short* dst;
+			if (o.BC6H) {
+				halves.resize(count);
+				dst = halves.data();
+			}
+			else {
+				sub.resize(count * sizeof(unsigned short));
+				dst = (unsigned short*)sub.data();
+			}
+			ForRows(pool, size, [&](unsigned int first, unsigned int end) {
+				FloatsToHalves(level + (size_t)first * size * 4, (size_t)(end - first) * size * 4, dst + (size_t)first * size * 4);
+			});
+			if (o.BC6H) sub = BlockCompression::CompressBC6H(halves.data(), size, size, pool);
+			stats.EncodeMs += ms(step, Clock::now());
+		}
+	}
+	return true;
+}
+
+bool EnvironmentMap::LoadOrConvert(const std::string& hdrPath, const EnvironmentMapOptions& options, const std::string& cacheDirectory,
+	ThreadPool* pool, EnvironmentCube& cube, EnvironmentMapStats& stats, std::string& error)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+	Clock::time_point start = Clock::now();
+	stats = {};
+
+	// cooked beats everything, like textures' .dds files
+	std::string ignored;
+	std::error_code ec;
+	std::string cooked = GetCookedPath(hdrPath);
+	if (std::filesystem::exists(cooked, ec) && Load(cooked, cube, ignored)) {
+		stats.FromCache = true;
+		stats.LoadMs = stats.TotalMs = ms(start, Clock::now());
+		return true;
+	}
+
+	std::ifstream file(hdrPath, std::ios::binary);
+	if (!file) {
+		error = "couldn't open " + hdrPath;
+		return false;
+	}
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	Clock::time_point step = Clock::now();
+	stats.LoadMs = ms(start, step);
+
+	unsigned long long key = GetKey(data.data(), data.size(), options);
+	std::string path = GetCachePath(cacheDirectory, key);
+	stats.HashMs = ms(step, Clock::now());
+
+	step = Clock::now();
+	if (Load(path, cube, ignored) && cube.Key == key) {
+		stats.FromCache = true;
+		stats.LoadMs += ms(step, Clock::now());
+		stats.TotalMs = ms(start, Clock::now());
+		return true;
+	}
+
+	HdrImage image;
+	step = Clock::now();
+	if (!HdrDecoder::Decode(data.data(), data.size(), image, error)) {
+		error = hdrPath + ": " + error;
+		return false;
+	}
+	data = {};
+	stats.DecodeMs = ms(step, Clock::now());
+
+	if (!Convert(image, options, pool, cube, stats, error)) return false;
+	cube.Key = key;
+
+	// not being able to cache it only means converting again next time
+	step = Clock::now();
+	std::filesystem::create_directories(cacheDirectory, ec);
+	Save(path, cube, ignored);
+	stats.SaveMs = ms(step, Clock::now());
+	stats.TotalMs = ms(start, Clock::now());
+	return true;
+}
+
+
+// --------------------------------------------------------
+// .dds files
+//
+// the usual 124 byte header, a DX10 one marking the texture
+// as a cube (caps2 all faces, misc TEXTURECUBE, one cube),
+// then each face's mips, largest first
+// --------------------------------------------------------
+std::string EnvironmentMap::GetCachePath(const std::string& cacheDirectory, unsigned long long key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.dds", key);
+	return (std::filesystem::path(cacheDirectory) / name).string();
+}
+
+std::string EnvironmentMap::GetCookedPath(const std::string& hdrPath)
+{
+	return std::filesystem::path(hdrPath).replace_extension(".dds").string();
+}
+
+bool EnvironmentMap::Save(const std::string& path, const EnvironmentCube& cube, std::string& error)
+{
+	std::vector<uint32_t> header(1 + 31 + 5, 0);
+	header[0] = 0x20534444;			// "DDS "
+	header[1] = 124;
+	header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;		// caps, height, width, pixel format, mip count, linear size
+	header[3] = cube.FaceSize;
+	header[4] = cube.FaceSize;
+	header[5] = (uint32_t)GetSubresourceSize(cube.Format, cube.FaceSize);
+	header[7] = cube.MipLevels;
+	header[8] = (uint32_t)cube.Key;	// reserved, so readers skip it
+	header[9] = (uint32_t)(cube.Key >> 32);
+	header[19] = 32;				// pixel format size
+	header[20] = 0x4;				// fourCC
+	header[21] = 0x30315844;		// "DX10"
+	header[27] = 0x1000 | 0x400000 | 0x8;		// texture, mipmap, complex
+	header[28] = 0x200 | 0xFC00;	// cube map, all six faces
+	header[32] = cube.Format;
+	header[33] = 3;					// 2D
+	header[34] = 0x4;				// texture cube
+	header[35] = 1;					// one cube
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)header.data(), header.size() * sizeof(uint32_t));
+	for (auto& sub : cube.Subresources)
+		out.write((const char*)sub.data(), sub.size());
+	if (!out) {
+		error = "couldn't write " + path;
+		return false;
+	}
+	return true;
+}
+
+bool EnvironmentMap::Load(const std::string& path, EnvironmentCube& cube, std::string& error)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		error = "no cube at " + path;
+		return false;
+	}
+
+	uint32_t header[37] = {};
+	if (!Read(in, header) || header[0] != 0x20534444 || header[21] != 0x30315844 || header[33] != 3 || !(header[34] & 0x4) || header[35] != 1 ||
+		(header[32] != FormatRGBA16F && header[32] != FormatBC6H) || header[3] != header[4]) {
+		error = path + " isn't a half float or BC6H cube map";
+		return false;
+	}
+
+	EnvironmentCube loaded = {};
+	loaded.Key = header[8] | (unsigned long long)header[9] << 32;
+	loaded.FaceSize = header[4];
+	loaded.MipLevels = std::max(1u, header[7]);
+	loaded.Format = header[32];
+	if (loaded.FaceSize == 0 || loaded.FaceSize > 16384 || (loaded.FaceSize >> (loaded.MipLevels - 1)) == 0) {
+		error = path + " is damaged";
+		return false;
+	}
+
+	loaded.Subresources.resize((size_t)6 * loaded.MipLevels);
+	for (unsigned int i = 0; i < loaded.Subresources.size(); i++) {
+		std::vector<unsigned char>& sub = loaded.Subresources[i];
+		sub.resize(GetSubresourceSize(loaded.Format, loaded.FaceSize >> (i % loaded.MipLevels)));
+		if (!in.read((char*)sub.data(), sub.size())) {
+			error = path + " is truncated";
+			return false;
+		}
+	}
+	cube = std::move(loaded);
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Linear floats back out
+// --------------------------------------------------------
+void EnvironmentMap::GetLinearFaces(const EnvironmentCube& cube, unsigned int maxSize, std::vector<float>& faces, unsigned int& faceSize)
+{
+	unsigned int mip = 0;
+	while (mip + 1 < cube.MipLevels && (cube.FaceSize >> mip) > maxSize) mip++;
+	faceSize = cube.FaceSize >> mip;
+	size_t texels = (size_t)faceSize * faceSize;
+	faces.resize(6 * texels * 4);
+
+	std::vector<unsigned short> halves(texels * 4);
+	unsigned short block[64];
+	for (unsigned int face = 0; face < 6; face++) {
+		const std::vector<unsigned char>& sub = cube.Subresources[(size_t)face * cube.MipLevels + mip];
+		if (cube.Format == FormatBC6H) {
+			unsigned int blocks = (faceSize + 3) / 4;
+			for (unsigned int by = 0; by < blocks; by++)
+				for (unsigned int bx = 0; bx < blocks; bx++) {
+					BlockCompression::DecodeBlockBC6H(&sub[((size_t)by * blocks + bx) * 16], block);
+					for (unsigned int y = 0; y < 4 && by * 4 + y < faceSize; y++)
+						for (unsigned int x = 0; x < 4 && bx * 4 + x < faceSize; x++)
+							memcpy(&halves[((size_t)(by * 4 + y) * faceSize + bx * 4 + x) * 4], block + (y * 4 + x) * 4, 8);
+				}
+		}
+		else memcpy(halves.data(), sub.data(), halves.size() * sizeof(unsigned short));
+
+		float* dst = faces.data() + face * texels * 4;
+		for (size_t i = 0; i < halves.size(); i++) dst[i] = HalfToFloat(halves[i]);
+	}
+}
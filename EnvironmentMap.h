@@ -0,0 +1,123 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "HdrDecoder.h"
+
+class ThreadPool;
+
+// How a sky becomes a cube map - zero (false) for the default
+struct EnvironmentMapOptions
+{
+	unsigned int FaceSize;		// texels across a face (the image's width / 4 as a power of two, at most 1024)
+	unsigned int Samples;		// per texel along each axis, enough to cover the image's texels under it (at most 4)
+	bool BC6H;					// compressed (what cooking does), instead of RGBA16F
+};
+
+// --------------------------------------------------------
+// A sky cube map ready for the GPU: 6 faces (+X, -X, +Y,
+// -Y, +Z, -Z) with full mip chains, linear and unclipped
+// --------------------------------------------------------
+struct EnvironmentCube
+{
+	unsigned long long Key;		// hash of the .hdr file and options it was made from
+	unsigned int FaceSize;
+	unsigned int MipLevels;
+	unsigned int Format;		// DXGI_FORMAT_R16G16B16A16_FLOAT (10) or DXGI_FORMAT_BC6H_UF16 (95)
+
+	// face * MipLevels + mip, the order D3D and .dds files keep them in
+	std::vector<std::vector<unsigned char>> Subresources;
+};
+
+struct EnvironmentMapStats
+{
+	bool FromCache;			// or a cooked .dds
+	unsigned int SourceWidth;
+	unsigned int SourceHeight;
+	double HashMs;			// of the .hdr file
+	double LoadMs;			// reading it, or the cache
+	double DecodeMs;
+	double ResampleMs;		// to the cube's faces
+	double MipsMs;
+	double EncodeMs;		// to halves, and BC6H
+	double SaveMs;
+	double TotalMs;
+};
+
+// --------------------------------------------------------
+// Turns an equirectangular (latitude/longitude) HDR sky
+// into a cube map on the CPU
+//
+// - The image's middle is +Z and its top +Y; longitude
+//   wraps around, latitude clamps at the poles
+// - Every face texel averages a grid of bilinear samples,
+//   four texels at a time with SSE (directions, atan2 and
+//   the filter weights), rows split across the thread pool
+// - Faces are done one at a time, floats then mips then
+//   halves (or BC6H), so a big cube never needs all its
+//   floats at once
+// - Conversions are cached on disk as cube .dds files named
+//   by a hash of the .hdr and the options, and a cooked
+//   .dds next to the .hdr is used instead when there is one
+// - Only depends on the standard library (and ThreadPool)
+// --------------------------------------------------------
+class EnvironmentMap
+{
+public:
+	static const unsigned int FormatRGBA16F = 10;
+	static const unsigned int FormatBC6H = 95;
+
+	// The options for an image this wide, with every zero replaced by its default
+	static EnvironmentMapOptions Resolve(const EnvironmentMapOptions& options, unsigned int width);
+
+	/// <summary>
+	/// Resamples one face of an equirectangular image to faceSize x faceSize linear RGBA floats
+	/// </summary>
+	/// <param name="pool">splits rows across threads, or null for this thread only</param>
+	static void ResampleFace(const HdrImage& image, unsigned int face, unsigned int faceSize, unsigned int samples, ThreadPool* pool, float* out);
+
+	/// <summary>
+	/// The whole conversion: every face resampled, its mips, then halves or BC6H
+	/// </summary>
+	static bool Convert(const HdrImage& image, const EnvironmentMapOptions& options, ThreadPool* pool,
+		EnvironmentCube& cube, EnvironmentMapStats& stats, std::string& error);
+
+	/// <summary>
+	/// Hashes a .hdr file's bytes and the options (what a conversion is cached by)
+	/// </summary>
+	static unsigned long long GetKey(const unsigned char* data, size_t size, const EnvironmentMapOptions& options);
+
+	/// <summary>
+	/// The cooked .dds next to hdrPath if there is one, else the cached conversion,
+	/// else decodes and converts the .hdr and caches that
+	/// </summary>
+	/// <param name="cacheDirectory">where conversions are kept, as &lt;key&gt;.dds (created if needed)</param>
+	static bool LoadOrConvert(const std::string& hdrPath, const EnvironmentMapOptions& options, const std::string& cacheDirectory,
+		ThreadPool* pool, EnvironmentCube& cube, EnvironmentMapStats& stats, std::string& error);
+
+	/// <summary>
+	/// Writes and reads cube .dds files (DX10 header, only the two formats above);
+	/// the key rides along in the header's reserved words
+	/// </summary>
+	static bool Save(const std::string& path, const EnvironmentCube& cube, std::string& error);
+	static bool Load(const std::string& path, EnvironmentCube& cube, std::string& error);
+
+	// Where a conversion with this key lives in a cache directory
+	static std::string GetCachePath(const std::string& cacheDirectory, unsigned long long key);
+	// Where a sky's cooked cube goes (same place, .dds extension)
+	static std::string GetCookedPath(const std::string& hdrPath);
+
+	/// <summary>
+	/// The largest mip no bigger than maxSize as linear RGBA floats, 6 faces one
+	/// after another (what IBLBaker bakes an HDR sky from)
+	/// </summary>
+	static void GetLinearFaces(const EnvironmentCube& cube, unsigned int maxSize, std::vector<float>& faces, unsigned int& faceSize);
+
+	// Bytes in one face of one mip
+	static size_t GetSubresourceSize(unsigned int format, unsigned int size);
+	// Bytes from one row (of blocks, for BC6H) to the next
+	static unsigned int GetRowPitch(unsigned int format, unsigned int size);
+
+	// Floats to halves, clamped to [0, 65504] (NaNs become 0), four at a time with SSE2
+	static void FloatsToHalves(const float* in, size_t count, unsigned short* out);
+};
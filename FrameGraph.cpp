@@ -0,0 +1,313 @@
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+
+FrameGraph::FrameGraph()
+{
+	Reset();
+}
+
+void FrameGraph::Reset()
+{
+	resources.clear();
+	versions.clear();
+	passes.clear();
+	order.clear();
+	slots.clear();
+	unbindAfter = false;
+	compiled = false;
+	error.clear();
+	stats = {};
+}
+
+
+// --------------------------------------------------------
+// Declaring the frame
+// --------------------------------------------------------
+FrameResource FrameGraph::CreateTexture(const std::string& name, const FrameTextureDesc& desc)
+{
+	Resource r = { name, desc, false, false, 0, -1, (unsigned int)versions.size() };
+	resources.push_back(r);
+	versions.push_back({ (unsigned int)resources.size() - 1, -1, -1, -1, {} });
+	compiled = false;
+	return r.LastVersion;
+}
+
+FrameResource FrameGraph::ImportTexture(const std::string& name, const FrameTextureDesc& desc, bool retained)
+{
+	FrameResource handle = CreateTexture(name, desc);
+	resources.back().Imported = true;
+	resources.back().Retained = retained;
+	return handle;
+}
+
+unsigned int FrameGraph::AddPass(const std::string& name, std::function<void()> execute)
+{
+	Pass p = {};
+	p.Name = name;
+	p.Execute = execute;
+	passes.push_back(p);
+	compiled = false;
+	return (unsigned int)passes.size() - 1;
+}
+
+void FrameGraph::SetSideEffect(unsigned int pass)
+{
+	passes[pass].SideEffect = true;
+}
+
+void FrameGraph::Read(unsigned int pass, FrameResource resource, FrameAccess access)
+{
+	passes[pass].Reads.push_back({ resource, access });
+	versions[resource].Readers.push_back(pass);
+	if (access == FrameAccess::ShaderRead)
+		resources[versions[resource].ResourceIndex].Usage |= FrameUsageShaderResource;
+	compiled = false;
+}
+
+FrameResource FrameGraph::Write(unsigned int pass, FrameResource resource, FrameAccess access)
+{
+	Resource& r = resources[versions[resource].ResourceIndex];
+
+	// writing over an older version would fork the resource's history
+	if (versions[resource].Next != -1 && error.empty())
+		error = passes[pass].Name + " writes an old version of " + r.Name;
+
+	if (access == FrameAccess::RenderTarget) r.Usage |= FrameUsageRenderTarget;
+	if (access == FrameAccess::DepthStencil) r.Usage |= FrameUsageDepthStencil;
+
+	FrameResource next = (FrameResource)versions.size();
+	versions.push_back({ versions[resource].ResourceIndex, (int)pass, (int)resource, -1, {} });
+	versions[resource].Next = (int)next;
+	r.LastVersion = next;
+
+	passes[pass].Writes.push_back({ next, access });
+	compiled = false;
+	return next;
+}
+
+
+// --------------------------------------------------------
+// Compiling
+//
+// 1. Culling: starting from passes with side effects and
+//    the final writers of retained imports, keep every
+//    pass whose output something kept needs
+// 2. Ordering: a pass runs after the writer of anything it
+//    touches, and before anyone writes over what it read
+//    (ties go to declaration order)
+// 3. Aliasing: each transient texture lives from its first
+//    to its last use; ones with matching descriptions and
+//    disjoint lifetimes share a slot
+// 4. Unbinds: a pass that binds a texture for output after
+//    it was read as a shader resource (since the last
+//    unbind) gets an unbind first.  This runs on slots,
+//    not resources, since a transient written into a slot
+//    another one was just read from is the same texture.
+// --------------------------------------------------------
+bool FrameGraph::Compile()
+{
+	order.clear();
+	slots.clear();
+	unbindAfter = false;
+	stats = {};
+	compiled = false;
+	if (!error.empty()) return false;
+
+	unsigned int passCount = (unsigned int)passes.size();
+
+	// 1. culling
+	std::vector<unsigned int> stack;
+	for (unsigned int p = 0; p < passCount; p++) {
+		passes[p].Culled = true;
+		passes[p].UnbindBefore = false;
+		if (passes[p].SideEffect) stack.push_back(p);
+	}
+	for (auto& r : resources)
+		if (r.Imported && r.Retained && versions[r.LastVersion].Writer >= 0)
+			stack.push_back(versions[r.LastVersion].Writer);
+
+	while (!stack.empty()) {
+		unsigned int p = stack.back();
+		stack.pop_back();
+		if (!passes[p].Culled) continue;
+		passes[p].Culled = false;
+
+		// what it reads, and whatever it draws on top of
+		for (auto& a : passes[p].Reads)
+			if (versions[a.Handle].Writer >= 0) stack.push_back(versions[a.Handle].Writer);
+		for (auto& a : passes[p].Writes) {
+			int previous = versions[a.Handle].Previous;
+			if (previous >= 0 && versions[previous].Writer >= 0) stack.push_back(versions[previous].Writer);
+		}
+	}
+
+	// 2. ordering
+	std::vector<std::vector<unsigned int>> edges(passCount);
+	std::vector<unsigned int> waitingOn(passCount, 0);
+	auto addEdge = [&](int from, int to) {
+		if (from < 0 || to < 0 || from == to) return;
+		if (passes[from].Culled || passes[to].Culled) return;
+		edges[from].push_back(to);
+		waitingOn[to]++;
+	};
+	for (unsigned int p = 0; p < passCount; p++) {
+		for (auto& a : passes[p].Reads) {
+			const Version& v = versions[a.Handle];
+			addEdge(v.Writer, p);
+			if (v.Next >= 0) addEdge(p, versions[v.Next].Writer);
+		}
+		for (auto& a : passes[p].Writes) {
+			int previous = versions[a.Handle].Previous;
+			if (previous < 0) continue;
+			addEdge(versions[previous].Writer, p);
+			for (unsigned int reader : versions[previous].Readers)
+				addEdge(reader, p);
+		}
+	}
+
+	std::set<unsigned int> ready;
+	for (unsigned int p = 0; p < passCount; p++)
+		if (!passes[p].Culled && waitingOn[p] == 0) ready.insert(p);
+
+	while (!ready.empty()) {
+		unsigned int p = *ready.begin();
+		ready.erase(ready.begin());
+		order.push_back(p);
+		for (unsigned int next : edges[p])
+			if (--waitingOn[next] == 0) ready.insert(next);
+	}
+
+	unsigned int kept = 0;
+	for (auto& p : passes) if (!p.Culled) kept++;
+	if (order.size() != kept) {
+		error = "frame graph has a dependency cycle";
+		order.clear();
+		return false;
+	}
+
+	// 3. lifetimes and aliasing
+	const int unused = -1;
+	std::vector<int> firstUse(resources.size(), unused), lastUse(resources.size(), unused);
+	for (unsigned int position = 0; position < order.size(); position++) {
+		auto touch = [&](FrameResource handle) {
+			unsigned int r = versions[handle].ResourceIndex;
+			if (firstUse[r] == unused) firstUse[r] = position;
+			lastUse[r] = position;
+		};
+		for (auto& a : passes[order[position]].Reads) touch(a.Handle);
+		for (auto& a : passes[order[position]].Writes) touch(a.Handle);
+	}
+
+	std::vector<unsigned int> transients;
+	for (unsigned int r = 0; r < resources.size(); r++) {
+		resources[r].Slot = -1;
+		if (!resources[r].Imported && firstUse[r] != unused) transients.push_back(r);
+	}
+	std::stable_sort(transients.begin(), transients.end(),
+		[&](unsigned int a, unsigned int b) { return firstUse[a] < firstUse[b]; });
+
+	std::vector<int> slotLastUse;
+	for (unsigned int r : transients) {
+		Resource& res = resources[r];
+		unsigned long long bytes = (unsigned long long)res.Desc.Width * res.Desc.Height * Render::GetFormatSize(res.Desc.Format);
+
+		for (unsigned int s = 0; s < slots.size() && res.Slot < 0; s++) {
+			const FrameTextureDesc& d = slots[s].Desc;
+			if (slotLastUse[s] < firstUse[r] &&
+				d.Width == res.Desc.Width && d.Height == res.Desc.Height && d.Format == res.Desc.Format)
+				res.Slot = (int)s;
+		}
+		if (res.Slot < 0) {
+			res.Slot = (int)slots.size();
+			slots.push_back({ res.Desc, 0, bytes });
+			slotLastUse.push_back(unused);
+			stats.AllocatedBytes += bytes;
+		}
+
+		slots[res.Slot].Usage |= res.Usage;
+		slotLastUse[res.Slot] = lastUse[r];
+		stats.TransientBytes += bytes;
+	}
+
+	// 4. unbinds, per physical texture: resources sharing a slot are the same
+	// texture to D3D, so writing one unbinds any of the others still read
+	auto texture = [&](FrameResource handle) {
+		unsigned int r = versions[handle].ResourceIndex;
+		return resources[r].Slot >= 0 ? (unsigned int)resources.size() + resources[r].Slot : r;
+	};
+	std::vector<bool> boundForRead(resources.size() + slots.size(), false);
+	bool anyBound = false;
+	for (unsigned int p : order) {
+		Pass& pass = passes[p];
+		for (auto& a : pass.Writes) {
+			bool output = a.Type == FrameAccess::RenderTarget || a.Type == FrameAccess::DepthStencil;
+			if (output && boundForRead[texture(a.Handle)]) {
+				pass.UnbindBefore = true;
+				stats.ShaderResourceUnbinds++;
+				std::fill(boundForRead.begin(), boundForRead.end(), false);
+				anyBound = false;
+				break;
+			}
+		}
+		for (auto& a : pass.Reads) {
+			if (a.Type != FrameAccess::ShaderRead) continue;
+			boundForRead[texture(a.Handle)] = true;
+			anyBound = true;
+		}
+	}
+	unbindAfter = anyBound;
+	if (unbindAfter) stats.ShaderResourceUnbinds++;
+
+	stats.Passes = passCount;
+	stats.CulledPasses = passCount - kept;
+	stats.TransientResources = (unsigned int)transients.size();
+	stats.Slots = (unsigned int)slots.size();
+	stats.SavedBytes = stats.TransientBytes - stats.AllocatedBytes;
+	compiled = true;
+	return true;
+}
+
+void FrameGraph::Execute(IFrameGraphBackend* backend)
+{
+	if (!compiled && !Compile()) return;
+
+	if (backend) backend->Realize(slots);
+	for (unsigned int p : order) {
+		if (passes[p].UnbindBefore && backend) backend->UnbindShaderResources();
+		if (passes[p].Execute) passes[p].Execute();
+	}
+	if (unbindAfter && backend) backend->UnbindShaderResources();
+}
+
+
+// --------------------------------------------------------
+// GETTERS
+// --------------------------------------------------------
+const std::vector<unsigned int>& FrameGraph::GetExecutionOrder() { return order; }
+const std::vector<FrameGraphSlot>& FrameGraph::GetSlots() { return slots; }
+bool FrameGraph::IsCulled(unsigned int pass) { return passes[pass].Culled; }
+bool FrameGraph::UnbindsBefore(unsigned int pass) { return passes[pass].UnbindBefore; }
+int FrameGraph::GetSlot(FrameResource resource) { return resources[versions[resource].ResourceIndex].Slot; }
+unsigned int FrameGraph::GetResourceIndex(FrameResource resource) { return versions[resource].ResourceIndex; }
+const std::string& FrameGraph::GetPassName(unsigned int pass) { return passes[pass].Name; }
+const std::string& FrameGraph::GetError() { return error; }
+FrameGraphStats FrameGraph::GetStats() { return stats; }
+
+std::string FrameGraph::Describe()
+{
+	std::string text;
+	for (unsigned int p : order) {
+		text += passes[p].UnbindBefore ? "  [unbind] " : "  ";
+		text += passes[p].Name + "\n";
+	}
+	for (unsigned int p = 0; p < passes.size(); p++)
+		if (passes[p].Culled) text += "  (culled) " + passes[p].Name + "\n";
+
+	char line[160];
+	snprintf(line, sizeof(line), "  transient: %llu KB in %u textures, %llu KB allocated, %llu KB saved\n",
+		stats.TransientBytes / 1024, stats.TransientResources, stats.AllocatedBytes / 1024, stats.SavedBytes / 1024);
+	return text + line;
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "RenderInterface.h"
+
+// --------------------------------------------------------
+// Names a resource at one point in the frame
+//
+// - Every write produces a new handle (a new version of the
+//   same resource), so reads always say which write they
+//   depend on
+// --------------------------------------------------------
+typedef unsigned int FrameResource;
+
+// Size and format of a texture in the graph
+struct FrameTextureDesc
+{
+	unsigned int Width;
+	unsigned int Height;
+	RenderTextureFormat Format;
+};
+
+// How a pass touches a resource
+enum class FrameAccess
+{
+	ShaderRead,		// bound as a shader resource
+	CopyRead,		// source of a copy
+	RenderTarget,
+	DepthStencil,
+	CopyWrite		// destination of a copy (or a clear)
+};
+
+// Bind flags a transient texture needs, gathered from every access
+enum FrameUsage
+{
+	FrameUsageShaderResource = 0x1,
+	FrameUsageRenderTarget = 0x2,
+	FrameUsageDepthStencil = 0x4
+};
+
+// --------------------------------------------------------
+// One physical texture that transient resources are placed
+// in.  Resources whose lifetimes don't overlap share a slot.
+// --------------------------------------------------------
+struct FrameGraphSlot
+{
+	FrameTextureDesc Desc;
+	unsigned int Usage;				// FrameUsage flags
+	unsigned long long Bytes;
+};
+
+// --------------------------------------------------------
+// What Compile() did, for the GUI and tests
+// --------------------------------------------------------
+struct FrameGraphStats
+{
+	unsigned int Passes;
+	unsigned int CulledPasses;
+	unsigned int TransientResources;
+	unsigned int Slots;						// physical textures backing them
+	unsigned int ShaderResourceUnbinds;
+	unsigned long long TransientBytes;		// if every transient had its own texture
+	unsigned long long AllocatedBytes;		// with aliasing
+	unsigned long long SavedBytes;
+};
+
+// --------------------------------------------------------
+// Whatever actually owns the GPU memory behind the graph
+// --------------------------------------------------------
+class IFrameGraphBackend
+{
+public:
+	virtual ~IFrameGraphBackend() {}
+
+	// makes sure the textures behind slots exist (called after Compile)
+	virtual void Realize(const std::vector<FrameGraphSlot>& slots) = 0;
+
+	// unbinds every shader resource, so they can be written again
+	virtual void UnbindShaderResources() = 0;
+};
+
+// --------------------------------------------------------
+// A declarative description of one frame's passes
+//
+// - Passes declare which resources they read and write;
+//   Compile() orders them from those dependencies, culls
+//   the ones nothing uses, works out where shader resources
+//   have to be unbound before they're written again, and
+//   packs transient textures with non-overlapping lifetimes
+//   into shared slots
+// - Only depends on the standard library (and the neutral
+//   render interface), so compiling a graph can be tested
+//   anywhere; the backend supplies the memory
+// - Built again every frame; the backend keeps its textures
+//   between frames, so this is cheap
+// --------------------------------------------------------
+class FrameGraph
+{
+public:
+	FrameGraph();
+
+	/// <summary>
+	/// Forgets every pass and resource, ready for the next frame
+	/// </summary>
+	void Reset();
+
+	/// <summary>
+	/// Declares a texture that only lives for part of the frame.
+	/// The graph decides where it lives (and who it shares with).
+	/// </summary>
+	/// <returns>the resource before anything has written it</returns>
+	FrameResource CreateTexture(const std::string& name, const FrameTextureDesc& desc);
+
+	/// <summary>
+	/// Declares a texture owned outside the graph (the back buffer, a cache)
+	/// </summary>
+	/// <param name="retained">true if its contents are wanted after the frame, so passes writing it are never culled</param>
+	/// <returns>the resource as it is at the start of the frame</returns>
+	FrameResource ImportTexture(const std::string& name, const FrameTextureDesc& desc, bool retained);
+
+	/// <summary>
+	/// Adds a pass; declare its accesses with Read() and Write()
+	/// </summary>
+	/// <param name="execute">does the pass's work</param>
+	/// <returns>index of the pass</returns>
+	unsigned int AddPass(const std::string& name, std::function<void()> execute);
+
+	/// <summary>
+	/// Marks a pass as doing something outside the graph (presenting, UI), so it's never culled
+	/// </summary>
+	void SetSideEffect(unsigned int pass);
+
+	/// <summary>
+	/// The pass reads a version of a resource, so runs after whatever wrote it
+	/// </summary>
+	void Read(unsigned int pass, FrameResource resource, FrameAccess access = FrameAccess::ShaderRead);
+
+	/// <summary>
+	/// The pass writes a resource
+	/// </summary>
+	/// <returns>the new version, for later passes to read</returns>
+	FrameResource Write(unsigned int pass, FrameResource resource, FrameAccess access);
+
+	/// <summary>
+	/// Orders and culls the passes, inserts unbinds and assigns slots
+	/// </summary>
+	/// <returns>false if the dependencies form a cycle (see GetError)</returns>
+	bool Compile();
+
+	/// <summary>
+	/// Realizes the slots on the backend and runs the surviving passes in order
+	/// </summary>
+	void Execute(IFrameGraphBackend* backend);
+
+	// Results of Compile()
+	const std::vector<unsigned int>& GetExecutionOrder();
+	const std::vector<FrameGraphSlot>& GetSlots();
+	bool IsCulled(unsigned int pass);
+	bool UnbindsBefore(unsigned int pass);		// shader resources are unbound before the pass runs
+	int GetSlot(FrameResource resource);		// -1 for imported (or never used) resources
+	unsigned int GetResourceIndex(FrameResource resource);	// same for every version of a resource
+	const std::string& GetPassName(unsigned int pass);
+	const std::string& GetError();
+	FrameGraphStats GetStats();
+
+	// One line per pass, in execution order, plus the memory report
+	std::string Describe();
+
+private:
+	struct Resource
+	{
+		std::string Name;
+		FrameTextureDesc Desc;
+		bool Imported;
+		bool Retained;
+		unsigned int Usage;
+		int Slot;
+		unsigned int LastVersion;
+	};
+
+	// A resource at one point in the frame
+	struct Version
+	{
+		unsigned int ResourceIndex;
+		int Writer;							// -1 when it's the frame's starting contents
+		int Previous;						// version this one was written over (-1 for the first)
+		int Next;							// version written over this one (-1 for the latest)
+		std::vector<unsigned int> Readers;
+	};
+
+	struct Access
+	{
+		FrameResource Handle;
+		FrameAccess Type;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		std::function<void()> Execute;
+		std::vector<Access> Reads;
+		std::vector<Access> Writes;
+		bool SideEffect;
+		bool Culled;
+		bool UnbindBefore;
+	};
+
+	std::vector<Resource> resources;
+	std::vector<Version> versions;
+	std::vector<Pass> passes;
+
+	std::vector<unsigned int> order;
+	std::vector<FrameGraphSlot> slots;
+	bool unbindAfter;		// something's still bound when the last pass finishes
+	bool compiled;
+	std::string error;
+	FrameGraphStats stats;
+};
@@ -10,10 +10,19 @@
 #include "Mesh.h"
 #include "BufferStructs.h"		// Assignment 4
 #include "Material.h"			// Assignment 7
-#include "WICTextureLoader.h"
+#include "D3D11RenderBackend.h"
+#include "NullRenderBackend.h"
+#include "SoftwareRasterizer.h"
+#include "ContentHash.h"
+#include "TextureAnalysis.h"
 
 
 #include <DirectXMath.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <cstdint>
 
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
@@ -41,56 +50,44 @@ bool goingUp;
 // --------------------------------------------------------
 void Game::Initialize()
 {
+	std::chrono::high_resolution_clock::time_point startupStart = std::chrono::high_resolution_clock::now();
+
 	// init fields
 	// 
 	demoActive = false;
 	curCamera = 0;
 	ambient = DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
 	goingUp = true;
+	ibl = {};
+	iblStats = {};
+	skyStats = {};
+	hdrSky = false;
+	imageLighting = true;
+	iblIntensity = 1.0f;
 
 	// shadow map stuff
 	// assignment 12
 	//shadowOptions = {};
 	shadowOptions.resolution = 1024;
 	shadowOptions.projectionSize = 10.0f;
-	shadowOptions.shadowDSV.Reset();
-	shadowOptions.shadowSRV.Reset();
 	shadowSampler.Reset();
 	shadowRasterizer.Reset();
+	cullShadowCasters = true;
+	cullShadowReceivers = true;
+	shadowCullStats = {};
+	cacheStaticShadows = true;
+	renderList = std::make_shared<RenderList>(GameEntity::ResolveDrawRecord);
+	renderListBenchmark = {};
+	mainPassDraws = 0;
+	uploadStats = {};
+	shadowVertexBytes = 0;
+	shadowVertexBytesInterleaved = 0;
+	batchStaticGeometry = true;
+	streamTextures = true;
+	staticBatcher = std::make_shared<StaticBatcher>();
+
+	// the shadow map itself is a transient in the frame graph (see Draw)
 
-	// create texture
-	D3D11_TEXTURE2D_DESC shadowDesc = {};
-	shadowDesc.Width = shadowOptions.resolution;
-	shadowDesc.Height = shadowOptions.resolution;
-	shadowDesc.ArraySize = 1;
-	shadowDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
-	shadowDesc.CPUAccessFlags = 0;
-	shadowDesc.Format = DXGI_FORMAT_R32_TYPELESS;
-	shadowDesc.MipLevels = 1;
-	shadowDesc.MiscFlags = 0;
-	shadowDesc.SampleDesc.Count = 1;
-	shadowDesc.SampleDesc.Quality = 0;
-	shadowDesc.Usage = D3D11_USAGE_DEFAULT;
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> shadowTexture;
-	Graphics::Device->CreateTexture2D(&shadowDesc, 0, shadowTexture.GetAddressOf());
-
-	// create shadow depth stencil
-	D3D11_DEPTH_STENCIL_VIEW_DESC shadowDSDesc = {};
-	shadowDSDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	shadowDSDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-	shadowDSDesc.Texture2D.MipSlice = 0;
-	Graphics::Device->CreateDepthStencilView(shadowTexture.Get(), &shadowDSDesc, shadowOptions.shadowDSV.GetAddressOf());
-	
-
-
-	// create shadow srv
-	D3D11_SHADER_RESOURCE_VIEW_DESC	srvDesc = {};
-	srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	Graphics::Device->CreateShaderResourceView(shadowTexture.Get(), &srvDesc, shadowOptions.shadowSRV.GetAddressOf());
-	
 	// create comparison sampler state
 	D3D11_SAMPLER_DESC shadowSampDesc = {};
 	shadowSampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR;
@@ -104,11 +101,22 @@ void Game::Initialize()
 	shadowSampDesc.BorderColor[3] = 1.0f;
 	Graphics::Device->CreateSamplerState(&shadowSampDesc, &shadowSampler);
 
+	// plain linear sampler for image lighting's lookups
+	D3D11_SAMPLER_DESC clampSampDesc = {};
+	clampSampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	clampSampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
+	clampSampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	clampSampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	clampSampDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	Graphics::Device->CreateSamplerState(&clampSampDesc, &clampSampler);
+
 	// shadow rasterizer state
 	D3D11_RASTERIZER_DESC shadowRastDesc = {};
 	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
 	shadowRastDesc.CullMode = D3D11_CULL_BACK;
-	shadowRastDesc.DepthClipEnable = true;
+	// casters between the light and the near plane are clamped to depth 0
+	// instead of clipped, so culling can keep them (see CullShadowCasters)
+	shadowRastDesc.DepthClipEnable = false;
 	shadowRastDesc.DepthBias = 1000;
 	shadowRastDesc.DepthBiasClamp = 0.0f;
 	shadowRastDesc.SlopeScaledDepthBias = 1.0f;
@@ -131,6 +139,27 @@ void Game::Initialize()
 
 	InitializeCamera();
 
+	// worker threads and deferred contexts for recording draws
+	threadPool = std::make_shared<ThreadPool>();
+	deferredRenderer = std::make_shared<DeferredRenderer>(Graphics::Device, threadPool);
+	frameGraph = std::make_shared<FrameGraph>();
+	frameGraphBackend = std::make_shared<D3D11FrameGraphBackend>(Graphics::Device, deferredRenderer);
+	softwareRasterizer = std::make_shared<SoftwareRasterizer>(threadPool);
+	referenceStats = {};
+	referenceDiff = {};
+	referenceCompared = false;
+	lightClusters = std::make_shared<LightClusters>(threadPool);
+	clusterLightBuffer = {};
+	clusterGridBuffer = {};
+	clusterIndexBuffer = {};
+	lightClusterBenchmark = {};
+	shaderSetterBenchmarkCount = 0;
+	shaderSetterNameMs = 0;
+	shaderSetterHandleMs = 0;
+	prepareMaterialBenchmarkCount = 0;
+	prepareMaterialUnbakedNs = 0;
+	prepareMaterialBakedNs = 0;
+
 	// IMGUI
 	// 
 	// initialize itself, platform, and renderer backend
@@ -149,6 +178,31 @@ void Game::Initialize()
 	CreateGeometry();
 	CreateLights();
 
+	// compile (or load) only the variants the materials can use, before the first frame
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		for (auto& m : materials)
+			for (unsigned int frame = 0; frame <= ShaderFeaturesFrame; frame++) {
+				// every combination of frame features, image lighting only with a bake to light with
+				if ((frame & ~ShaderFeaturesFrame) || ((frame & ShaderFeatureImageLighting) && !ibl.Specular)) continue;
+				pbrVariants->Get(m->GetFeatures() | frame);
+			}
+		shaderVariantCache->SaveIndex();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		ShaderVariantCacheStats s = shaderVariantCache->GetStats();
+		printf("Shader variants: %u used, %u from cache, %u compiled, %u failed in %.1f ms (%s)\n",
+			pbrVariants->GetLoadedCount(), s.Hits, s.Compiled, s.Failed, ms,
+			pbrVariants->HasSource() ? pbrVariants->GetSourcePath().c_str() : "no source, using the full shader");
+		printf("Shader reflection: %u from cache, %u reflected\n",
+			ISimpleShader::ReflectionCacheHits, ISimpleShader::ReflectionCacheMisses);
+	}
+
+	// static casters are kept in their own map, built with the same rasterizer settings
+	D3D11_RASTERIZER_DESC casterRastDesc = {};
+	shadowRasterizer->GetDesc(&casterRastDesc);
+	shadowCache = std::make_shared<ShadowCache>(Graphics::Device, shadowOptions.resolution, casterRastDesc, shadowClearVS);
+
 	// Set initial graphics API state
 	//  - These settings persist until we change them
 	//  - Some of these, like the primitive topology & input layout, probably won't change
@@ -159,6 +213,9 @@ void Game::Initialize()
 		// Essentially: "What kind of shape should the GPU draw with our vertices?"
 		Graphics::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	}
+
+	startupMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startupStart).count();
+	printf("Startup: %.1f ms (%.1f ms of it loading textures)\n", startupMs, textureLoadStats.WallMs);
 }
 
 
@@ -198,8 +255,25 @@ void Game::LoadShaders()
 		Graphics::Context, FixPath(L"uvPS.cso").c_str());
 	pseudoPS = std::make_shared<SimplePixelShader>(Graphics::Device,
 		Graphics::Context, FixPath(L"pseudoPS.cso").c_str());
+
+	// variants of the main pixel shader are compiled from the source the
+	// build copies next to the executable (or, failing that, the project's
+	// own copy two folders up), and are kept next to the executable
+	shaderVariantCache = std::make_shared<ShaderVariantCache>(FixPath("ShaderCache"));
+	shaderVariantCache->LoadIndex();
+	std::string variantSource = ShaderVariantCache::FindSourceFile({
+		FixPath("PixelShader.hlsl"),
+		FixPath("../../PixelShader.hlsl") });
+	if (variantSource.empty())
+		printf("Shader variants: no PixelShader.hlsl in %s or two folders up, using the full shader\n", GetExePath().c_str());
+	pbrVariants = std::make_shared<PixelShaderVariants>(Graphics::Device, Graphics::Context,
+		shaderVariantCache, variantSource, pixelShader);
+	frameShaderFeatures = ~0u;	// nothing selected yet
+	useTextureArrays = false;
 	shadowVS = std::make_shared<SimpleVertexShader>(Graphics::Device,
 		Graphics::Context, FixPath(L"ShadowVS.cso").c_str());
+	shadowClearVS = std::make_shared<SimpleVertexShader>(Graphics::Device,
+		Graphics::Context, FixPath(L"ShadowClearVS.cso").c_str());
 }
 
 
@@ -292,6 +366,44 @@ void Game::CreateGeometry()
 	// scale up floor for assignment 12
 	entities[7]->GetTransform()->SetScale(XMFLOAT3(20, 20, 20));
 	entities[7]->GetTransform()->MoveAbsolute(0, -22, 0);
+
+	// everything holds still except the cylinder and helix (see UpdateObjectTransformations),
+	// so the rest only need drawing into the shadow map when they're edited
+	for (auto& e : entities) e->SetStatic(true);
+	entities[2]->SetStatic(false);
+	entities[3]->SetStatic(false);
+
+	// main pass draws from here from now on
+	RebuildRenderList();
+}
+
+
+// --------------------------------------------------------
+// Refills the render list, with static entities merged
+// into chunks when batching is on
+// - Merged entities have no handle of their own
+// --------------------------------------------------------
+void Game::RebuildRenderList()
+{
+	renderList->Clear();
+	entityHandles.assign(entities.size(), RenderList::InvalidHandle);
+
+	if (batchStaticGeometry)
+		staticBatcher->Build(entities);
+
+	for (unsigned int i = 0; i < entities.size(); i++) {
+		if (batchStaticGeometry && staticBatcher->IsMerged(i)) continue;
+		entityHandles[i] = renderList->Add(entities[i]);
+	}
+
+	if (batchStaticGeometry) {
+		for (auto& c : staticBatcher->GetChunks()) renderList->Add(c);
+
+		StaticBatchStats s = staticBatcher->GetStats();
+		printf("Static batching: %u of %u static entities merged into %u chunks (%u with 16 bit indices), %u -> %u draws\n",
+			s.MergedEntities, s.StaticEntities, s.Chunks, s.Chunks16Bit,
+			(unsigned int)entities.size(), renderList->GetCount());
+	}
 }
 
 void Game::CreateLights()
@@ -417,209 +529,168 @@ void Game::CreateMaterials()
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodRough;
 
 	// fill textures
-	// bronze
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/bronze_albedo.png").c_str(),
-		0,
-		&bronzeAlbedo
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/bronze_metal.png").c_str(),
-		0,
-		&bronzeMetal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/bronze_normals.png").c_str(),
-		0,
-		&bronzeNormal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/bronze_roughness.png").c_str(),
-		0,
-		&bronzeRough
-	);
-	// cobblestone
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/cobblestone_albedo.png").c_str(),
-		0,
-		&cobblestoneAlbedo
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/cobblestone_metal.png").c_str(),
-		0,
-		&cobblestoneMetal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/cobblestone_normals.png").c_str(),
-		0,
-		&cobblestoneNormal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/cobblestone_roughness.png").c_str(),
-		0,
-		&cobblestoneRough
-	);
-	// floor
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/floor_albedo.png").c_str(),
-		0,
-		&floorAlbedo
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/floor_metal.png").c_str(),
-		0,
-		&floorMetal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/floor_normals.png").c_str(),
-		0,
-		&floorNormal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/floor_roughness.png").c_str(),
-		0,
-		&floorRough
-	);
-	// paint
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/paint_albedo.png").c_str(),
-		0,
-		&paintAlbedo
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/paint_metal.png").c_str(),
-		0,
-		&paintMetal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/paint_normals.png").c_str(),
-		0,
-		&paintNormal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/paint_roughness.png").c_str(),
-		0,
-		&paintRough
-	);
-	// rough
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/rough_albedo.png").c_str(),
-		0,
-		&roughAlbedo
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/rough_metal.png").c_str(),
-		0,
-		&roughMetal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/rough_normals.png").c_str(),
-		0,
-		&roughNormal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/rough_roughness.png").c_str(),
-		0,
-		&roughRough
-	);
-	// scratched
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/scratched_albedo.png").c_str(),
-		0,
-		&scratchedAlbedo
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/scratched_metal.png").c_str(),
-		0,
-		&scratchedMetal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/scratched_normals.png").c_str(),
-		0,
-		&scratchedNormal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/scratched_roughness.png").c_str(),
-		0,
-		&scratchedRough
-	);
-	// wood
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/wood_albedo.png").c_str(),
-		0,
-		&woodAlbedo
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/wood_metal.png").c_str(),
-		0,
-		&woodMetal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/wood_normals.png").c_str(),
-		0,
-		&woodNormal
-	);
-	CreateWICTextureFromFile(
-		Graphics::Device.Get(),
-		Graphics::Context.Get(),
-		FixPath(L"../../textures/PBR/wood_roughness.png").c_str(),
-		0,
-		&woodRough
-	);
+	// - read, decoded and created by TextureLoadPipeline (sky faces too),
+	//   then shared through the registry by path and by contents
+	// - cooked .dds files are used instead of the .pngs when they're there
+	// - a material's roughness and metalness maps wait for each other: one
+	//   that's a single value everywhere becomes a constant, and two that
+	//   both vary are packed into one ORM texture
+	// - albedo, normal and unpacked roughness and metalness maps are
+	//   streamed: only their tails go to the GPU here (see UpdateTextureStreaming)
+	textureRegistry = std::make_shared<TextureRegistry>(Graphics::Device, Graphics::Context);
+	textureStreamer = std::make_shared<D3D11TextureStreamer>(Graphics::Device, Graphics::Context, 64 * 1024 * 1024);
+	enum MaterialMap { MapOther, MapRoughness, MapMetalness };
+	struct TextureSlot
+	{
+		const wchar_t* File;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>* SRV;
+		unsigned int Material;		// which material's roughness or metalness map
+		MaterialMap Map;
+	};
+	TextureSlot textureSlots[] = {
+		// bronze
+		{ L"PBR/bronze_albedo.png", &bronzeAlbedo },
+		{ L"PBR/bronze_metal.png", &bronzeMetal, 0, MapMetalness },
+		{ L"PBR/bronze_normals.png", &bronzeNormal },
+		{ L"PBR/bronze_roughness.png", &bronzeRough, 0, MapRoughness },
+		// cobblestone
+		{ L"PBR/cobblestone_albedo.png", &cobblestoneAlbedo },
+		{ L"PBR/cobblestone_metal.png", &cobblestoneMetal, 1, MapMetalness },
+		{ L"PBR/cobblestone_normals.png", &cobblestoneNormal },
+		{ L"PBR/cobblestone_roughness.png", &cobblestoneRough, 1, MapRoughness },
+		// floor
+		{ L"PBR/floor_albedo.png", &floorAlbedo },
+		{ L"PBR/floor_metal.png", &floorMetal, 2, MapMetalness },
+		{ L"PBR/floor_normals.png", &floorNormal },
+		{ L"PBR/floor_roughness.png", &floorRough, 2, MapRoughness },
+		// paint
+		{ L"PBR/paint_albedo.png", &paintAlbedo },
+		{ L"PBR/paint_metal.png", &paintMetal, 3, MapMetalness },
+		{ L"PBR/paint_normals.png", &paintNormal },
+		{ L"PBR/paint_roughness.png", &paintRough, 3, MapRoughness },
+		// rough
+		{ L"PBR/rough_albedo.png", &roughAlbedo },
+		{ L"PBR/rough_metal.png", &roughMetal, 4, MapMetalness },
+		{ L"PBR/rough_normals.png", &roughNormal },
+		{ L"PBR/rough_roughness.png", &roughRough, 4, MapRoughness },
+		// scratched
+		{ L"PBR/scratched_albedo.png", &scratchedAlbedo },
+		{ L"PBR/scratched_metal.png", &scratchedMetal, 5, MapMetalness },
+		{ L"PBR/scratched_normals.png", &scratchedNormal },
+		{ L"PBR/scratched_roughness.png", &scratchedRough, 5, MapRoughness },
+		// wood
+		{ L"PBR/wood_albedo.png", &woodAlbedo },
+		{ L"PBR/wood_metal.png", &woodMetal, 6, MapMetalness },
+		{ L"PBR/wood_normals.png", &woodNormal },
+		{ L"PBR/wood_roughness.png", &woodRough, 6, MapRoughness }
+	};
+	const wchar_t* skyFaces[6] = { L"Skies/right.png", L"Skies/left.png", L"Skies/up.png", L"Skies/down.png", L"Skies/front.png", L"Skies/back.png" };
+	const unsigned int slotCount = ARRAYSIZE(textureSlots);
+
+	// an equirectangular .hdr sky replaces the six faces when there is one
+	std::string skyHDRPath = FixPath("../../textures/Skies/sky.hdr");
+	std::error_code skyError;
+	hdrSky = std::filesystem::exists(skyHDRPath, skyError);
+
+	std::vector<std::wstring> texturePaths;
+	std::vector<std::wstring> loadPaths;
+	for (auto& slot : textureSlots) {
+		texturePaths.push_back(FixPath(std::wstring(L"../../textures/") + slot.File));
+		loadPaths.push_back(TextureRegistry::GetLoadPath(texturePaths.back()));
+	}
+	for (unsigned int i = 0; i < 6 && !hdrSky; i++) {
+		texturePaths.push_back(FixPath(std::wstring(L"../../textures/") + skyFaces[i]));
+		loadPaths.push_back(texturePaths.back());
+	}
+
+	struct MaterialMaps
+	{
+		TextureLoadResult Loaded[2];	// roughness, metalness (held until both are in)
+		unsigned int Slots[2];
+		unsigned int Arrived;
+		bool Uniform[2];				// replaced by the material's constant
+		float Value[2];
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ORM;
+	};
+	MaterialMaps materialMaps[7] = {};		// one per material below
+	std::vector<bool> replaced(slotCount, false);		// uniform or packed, so never loaded on their own
+
+	// streamed if it can be, shared through the registry if not (either one
+	// hands back the texture it already has for the same path or contents)
+	auto createTexture = [&](unsigned int slot, const TextureLoadResult& loaded) {
+		int streamed = streamTextures ? textureStreamer->Add(loadPaths[slot], loaded) : -1;
+		*textureSlots[slot].SRV = streamed >= 0 ? textureStreamer->GetSRV(streamed) : textureRegistry->Acquire(texturePaths[slot], loaded);
+	};
+
+	auto resolveMaps = [&](MaterialMaps& maps) {
+		for (unsigned int k = 0; k < 2; k++) {
+			const DecodedImage& image = maps.Loaded[k].Image;
+			maps.Uniform[k] = !image.Pixels.empty() && TextureAnalysis::IsUniform(image, 1, 2, &maps.Value[k]);
+			replaced[maps.Slots[k]] = maps.Uniform[k];
+		}
+
+		// both vary: one texture for the two (occlusion is reserved, there are no AO maps yet)
+		if (!maps.Uniform[0] && !maps.Uniform[1]) {
+			const DecodedImage* sources[3] = { 0, &maps.Loaded[0].Image, &maps.Loaded[1].Image };
+			const unsigned char constants[3] = { 255, 0, 0 };
+			TextureLoadResult packed = {};
+			if (!sources[1]->Pixels.empty() && !sources[2]->Pixels.empty())
+				packed.Image = TextureAnalysis::PackORM(sources, constants);
+			if (!packed.Image.Pixels.empty()) {
+				std::filesystem::path path = texturePaths[maps.Slots[0]];
+				std::wstring stem = path.stem().wstring();
+				path.replace_filename(stem.substr(0, stem.rfind(L'_')) + L"_orm.png");
+
+				packed.Succeeded = true;
+				packed.FileBytes = packed.Image.Pixels.size();
+				packed.Hash = ContentHash::Hash64(packed.Image.Pixels.data(), packed.Image.Pixels.size());
+				maps.ORM = textureRegistry->Acquire(path.wstring(), packed);
+				replaced[maps.Slots[0]] = replaced[maps.Slots[1]] = (bool)maps.ORM;
+			}
+		}
+
+		for (unsigned int k = 0; k < 2; k++) {
+			if (!replaced[maps.Slots[k]])
+				createTexture(maps.Slots[k], maps.Loaded[k]);
+			maps.Loaded[k] = {};
+		}
+	};
+
+	DecodedImage skyImages[6] = {};
+	bool skyDecoded = !hdrSky;
+	textureLoadStats = TextureLoadPipeline::Run(*threadPool, loadPaths, 64 * 1024 * 1024, [&](TextureLoadResult& loaded) {
+		if (loaded.Index < slotCount) {
+			const TextureSlot& slot = textureSlots[loaded.Index];
+			if (slot.Map == MapOther) {
+				createTexture(loaded.Index, loaded);
+				return;
+			}
+			MaterialMaps& maps = materialMaps[slot.Material];
+			unsigned int k = slot.Map == MapRoughness ? 0 : 1;
+			maps.Slots[k] = loaded.Index;
+			maps.Loaded[k] = std::move(loaded);
+			if (++maps.Arrived == 2) resolveMaps(maps);
+			return;
+		}
+		// the sky keeps its faces' pixels until they're all in
+		skyDecoded &= loaded.Succeeded;
+		skyImages[loaded.Index - slotCount] = std::move(loaded.Image);
+	});
+
+	// anything the pipeline couldn't read or decode gets another try through
+	// the registry (ImageDecoder again, then WIC for any other format)
+	for (unsigned int i = 0; i < slotCount; i++)
+		if (!*textureSlots[i].SRV && !replaced[i])
+			*textureSlots[i].SRV = textureRegistry->Acquire(texturePaths[i]);
+
+	printf("Texture loading: %u files in %.1f ms | read %.1f ms, decode %.1f ms (all workers), create %.1f ms, waiting %.1f ms | %.1f MB read, %.1f MB peak in flight, %u stalls\n",
+		textureLoadStats.Files, textureLoadStats.WallMs, textureLoadStats.ReadMs, textureLoadStats.DecodeMs,
+		textureLoadStats.CreateMs, textureLoadStats.WaitMs, textureLoadStats.BytesRead / 1048576.0,
+		textureLoadStats.PeakBytesInFlight / 1048576.0, textureLoadStats.Stalls);
+	TextureRegistryStats textureStats = textureRegistry->GetStats();
+	printf("Textures: %u requested, %u loaded, %u shared by contents, %u failed | %.1f MB on the GPU, %.1f MB saved | hash %.1f ms, create %.1f ms\n",
+		textureStats.Requests, textureStats.Loads, textureStats.ContentHits, textureStats.Failed,
+		textureStats.GpuBytes / 1048576.0, textureStats.GpuBytesSaved / 1048576.0, textureStats.HashMs, textureStats.CreateMs);
 
 	// make materials
 	// bronze
@@ -728,6 +799,40 @@ void Game::CreateMaterials()
 	materials[6]->AddTextureSRV("RoughnessMap", woodRough);
 	materials[6]->AddTextureSRV("MetalnessMap", woodMetal);
 
+	// every PBR material has a normal map, and its roughness and
+	// metalness as maps, one ORM map, or constants
+	unsigned int constantMaps = 0, packedMaterials = 0;
+	for (unsigned int i = 0; i < materials.size(); i++) {
+		const MaterialMaps& maps = materialMaps[i];
+		unsigned int features = ShaderFeatureNormalMap;
+		if (maps.ORM) {
+			materials[i]->AddTextureSRV("ORMMap", maps.ORM);
+			features |= ShaderFeatureORMMap;
+			packedMaterials++;
+		}
+		if (maps.Uniform[0]) materials[i]->SetRoughness(maps.Value[0]);
+		if (maps.Uniform[1]) materials[i]->SetMetalness(maps.Value[1]);
+		if (materials[i]->GetTextureSRV("RoughnessMap")) features |= ShaderFeatureRoughnessMap;
+		if (materials[i]->GetTextureSRV("MetalnessMap")) features |= ShaderFeatureMetalnessMap;
+		constantMaps += maps.Uniform[0] + maps.Uniform[1];
+		materials[i]->SetShaderVariants(pbrVariants, features);
+	}
+	printf("Material maps: %u constant, %u materials with roughness and metalness packed into ORM maps\n", constantMaps, packedMaterials);
+
+	// which material slots hold streamed textures, so new SRVs reach them
+	for (auto& m : materials) {
+		for (const char* slot : { "Albedo", "NormalMap", "RoughnessMap", "MetalnessMap" }) {
+			int streamed = textureStreamer->Find(m->GetTextureSRV(slot).Get());
+			if (streamed >= 0) streamedTextures[m.get()].push_back({ slot, (unsigned int)streamed });
+		}
+	}
+	TextureResidencyStats streamStats = textureStreamer->GetResidency().GetStats();
+	printf("Texture streaming: %u textures (%u more shared by contents), %.1f MB of small mips resident, %.1f MB budget\n",
+		streamStats.Textures, textureStreamer->GetContentHits(), streamStats.ResidentBytes / 1048576.0, streamStats.BudgetBytes / 1048576.0);
+
+	// and the same textures in arrays, for when that mode is on
+	BuildTextureArrays();
+
 
 
 	//
@@ -740,7 +845,48 @@ void Game::CreateMaterials()
 		FixPath(L"../../meshes/cube.obj").c_str()
 	);
 
-	sky = std::make_shared<Sky>(
+	// an HDR sky's cube: cooked, cached, or converted from the .hdr now
+	EnvironmentCube hdrCube = {};
+	if (hdrSky) {
+		std::string error;
+		hdrSky = EnvironmentMap::LoadOrConvert(skyHDRPath, {}, FixPath("SkyCache"), threadPool.get(), hdrCube, skyStats, error);
+		if (!hdrSky)
+			printf("HDR sky: %s, using the six faces instead\n", error.c_str());
+		else
+			printf("HDR sky: 6 x %u^2 %s, %s in %.1f ms | read %.1f ms, hash %.1f ms, decode %.1f ms, resample %.1f ms, mips %.1f ms, encode %.1f ms, save %.1f ms\n",
+				hdrCube.FaceSize, hdrCube.Format == EnvironmentMap::FormatBC6H ? "BC6H" : "RGBA16F", skyStats.FromCache ? "loaded" : "converted",
+				skyStats.TotalMs, skyStats.LoadMs, skyStats.HashMs, skyStats.DecodeMs, skyStats.ResampleMs, skyStats.MipsMs, skyStats.EncodeMs, skyStats.SaveMs);
+	}
+
+	// the sky's lighting, baked from its faces (or found in the cache) while they're still
+	// decoded, or from an HDR sky's mip at the bake's source size
+	if (skyDecoded || hdrSky) {
+		IBLData iblData;
+		std::string error;
+		bool baked;
+		if (hdrSky) {
+			std::vector<float> faces;
+			unsigned int faceSize = 0;
+			EnvironmentMap::GetLinearFaces(hdrCube, IBLBaker::Resolve({}).SourceSize, faces, faceSize);
+			baked = IBLBaker::LoadOrBake(faces.data(), faceSize, {}, FixPath("IBLCache"), threadPool.get(), iblData, iblStats, error);
+		}
+		else baked = IBLBaker::LoadOrBake(skyImages, {}, FixPath("IBLCache"), threadPool.get(), iblData, iblStats, error);
+
+		if (!baked)
+			printf("Image lighting: %s, using ambient instead\n", error.c_str());
+		else if (!D3D11IBL::Create(Graphics::Device, iblData, ibl))
+			printf("Image lighting: couldn't create its textures, using ambient instead\n");
+		else
+			printf("Image lighting: %s in %.1f ms | hash %.1f ms, source %.1f ms, irradiance %.1f ms, specular %.1f ms, brdf %.1f ms\n",
+				iblStats.FromCache ? "from cache" : "baked", iblStats.TotalMs, iblStats.HashMs, iblStats.SourceMs,
+				iblStats.IrradianceMs, iblStats.SpecularMs, iblStats.BRDFMs);
+	}
+
+	if (hdrSky)
+		sky = std::make_shared<Sky>(hdrCube, cube, skyVS, skyPS, sampler);
+	else if (skyDecoded)
+		sky = std::make_shared<Sky>(skyImages, cube, skyVS, skyPS, sampler);
+	else sky = std::make_shared<Sky>(
 		FixPath(L"../../textures/Skies/right.png").c_str(),
 		FixPath(L"../../textures/Skies/left.png").c_str(),
 		FixPath(L"../../textures/Skies/up.png").c_str(),
@@ -792,7 +938,178 @@ void Game::BuildGui()
 
 	
 	//ImGui::DragFloat3("Offset: ", &_offset.x, 0.01f);
-	ImGui::ColorEdit4("ambient: ", &ambient.x);
+	ImGui::ColorEdit3("ambient: ", &ambient.x);
+
+	// multithreaded recording
+	{
+		bool mt = deferredRenderer->IsMultithreaded();
+		ImGui::Checkbox("Multithreaded Recording", &mt);
+		deferredRenderer->SetMultithreaded(mt);
+
+		int minItems = (int)deferredRenderer->GetMinItemsPerJob();
+		ImGui::DragInt("Min Draws Per Job", &minItems, 1.0f, 1, 4096);
+		deferredRenderer->SetMinItemsPerJob((unsigned int)minItems);
+
+		ImGui::Text("Deferred Contexts: %d | Jobs Last Frame: %d",
+			deferredRenderer->GetContextCount(), deferredRenderer->GetJobCount());
+	}
+
+	// retained render list
+	{
+		ImGui::Text("Draw Records: %d | Drawn Last Frame: %d", renderList->GetCount(), mainPassDraws);
+		ImGui::Text("CB Uploads: %d (%.1f KB) | Skipped: %d (%.1f KB avoided)",
+			uploadStats.Uploads, uploadStats.BytesUploaded / 1024.0, uploadStats.Skipped, uploadStats.BytesAvoided / 1024.0);
+		if (ImGui::Button("Benchmark Render List (100k entities)"))
+			BenchmarkRenderList(100000);
+
+		if (renderListBenchmark.EntityCount > 0) {
+			ImGui::Text("Entity Walk: %.3f ms | Record Walk: %.3f ms",
+				renderListBenchmark.EntityWalkMs, renderListBenchmark.RecordWalkMs);
+			ImGui::Text("Add All: %.3f ms | 10%% Churn: %.3f ms",
+				renderListBenchmark.AddMs, renderListBenchmark.ChurnMs);
+		}
+	}
+
+	// render backend
+	{
+		ImGui::Text("Render Backend: %s", Render::GetDevice()->GetName());
+		if (ImGui::Button("Capture Geometry Stream (Null Backend)")) {
+			// replay the main pass's geometry submission with nothing behind it,
+			// which times the CPU side on its own
+			NullRenderContext capture;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			for (const DrawRecord& r : renderList->GetRecords())
+				r.EntityMesh->Draw(&capture);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			NullRenderStats s = capture.GetStats();
+			printf("Null backend capture: %u commands, %u draws, %llu indices in %.3f ms\n",
+				s.Commands, s.DrawCalls, (unsigned long long)s.Vertices, ms);
+		}
+	}
+
+	// frame graph
+	{
+		FrameGraphStats s = frameGraph->GetStats();
+		ImGui::Text("Frame Graph: %d passes (%d culled) | %d unbinds",
+			s.Passes, s.CulledPasses, s.ShaderResourceUnbinds);
+		ImGui::Text("Transients: %d in %d textures | %.1f KB allocated, %.1f KB saved",
+			s.TransientResources, s.Slots, s.AllocatedBytes / 1024.0, s.SavedBytes / 1024.0);
+		if (ImGui::Button("Print Frame Graph"))
+			printf("Frame graph:\n%s", frameGraph->Describe().c_str());
+	}
+
+	// software reference renderer
+	{
+		if (ImGui::Button("Render CPU Reference Image"))
+			RenderReferenceImage();
+
+		if (referenceStats.TrianglesIn > 0) {
+			ImGui::Text("CPU Frame: %.2f ms | %.2f M tris/s | %.2f M pixels/s",
+				referenceStats.Milliseconds,
+				referenceStats.TrianglesPerSecond / 1000000.0,
+				referenceStats.PixelsPerSecond / 1000000.0);
+			if (referenceCompared)
+				ImGui::Text("vs Golden: %d pixels differ | max delta %d | MAE %.3f",
+					referenceDiff.DifferentPixels, referenceDiff.MaxChannelDelta, referenceDiff.MeanAbsoluteError);
+		}
+	}
+
+	// clustered lights
+	{
+		int extraCount = (int)extraLights.size();
+		if (ImGui::SliderInt("Extra Clustered Lights", &extraCount, 0, 10000))
+			CreateExtraLights((unsigned int)extraCount);
+
+		LightClusterStats s = lightClusters->GetStats();
+		ImGui::Text("Clusters: %dx%dx%d | Lights: %d | Assign: %.3f ms",
+			lightClusters->GetGridX(), lightClusters->GetGridY(), lightClusters->GetGridZ(), s.Lights, s.Milliseconds);
+		ImGui::Text("Light Indices: %d | Max Per Cluster: %d | Empty Clusters: %d",
+			s.Indices, s.MaxPerCluster, s.EmptyClusters);
+
+		if (ImGui::Button("Benchmark Light Clusters (10k)")) {
+			lightClusterBenchmark = LightClusters::Benchmark(threadPool, 10000);
+			printf("Light clusters: %u lights, %ux%ux%u grid, avg %.3f ms, best %.3f ms, %u indices, max %u per cluster\n",
+				lightClusterBenchmark.LightCount, lightClusterBenchmark.GridX, lightClusterBenchmark.GridY, lightClusterBenchmark.GridZ,
+				lightClusterBenchmark.AverageMs, lightClusterBenchmark.BestMs,
+				lightClusterBenchmark.Stats.Indices, lightClusterBenchmark.Stats.MaxPerCluster);
+		}
+		if (lightClusterBenchmark.Runs > 0)
+			ImGui::Text("10k Lights: avg %.3f ms | best %.3f ms",
+				lightClusterBenchmark.AverageMs, lightClusterBenchmark.BestMs);
+	}
+
+	// shader setters
+	{
+		if (ImGui::Button("Benchmark Shader Setters (1M)"))
+			BenchmarkShaderSetters(1000000);
+		if (shaderSetterBenchmarkCount > 0)
+			ImGui::Text("By Name: %.3f ms | By Handle: %.3f ms", shaderSetterNameMs, shaderSetterHandleMs);
+
+		ImGui::Checkbox("Baked Material Bindings", &Material::UseBakedBindings);
+
+		bool arrays = useTextureArrays;
+		if (ImGui::Checkbox("Texture Arrays", &arrays))
+			SetTextureArrayMode(arrays);
+		ImGui::SameLine();
+		ImGui::Text("%d of %d materials in %d sets",
+			textureArrayPlan.PackedMaterials, (int)materials.size(), (int)textureArrayPlan.Sets.size());
+		if (ImGui::Button("Benchmark PrepareMaterial (100k)"))
+			BenchmarkPrepareMaterial(100000);
+		if (prepareMaterialBenchmarkCount > 0)
+			ImGui::Text("Per Draw: %.0f ns unbaked | %.0f ns baked", prepareMaterialUnbakedNs, prepareMaterialBakedNs);
+	}
+
+	// static batching
+	{
+		if (ImGui::Checkbox("Batch Static Geometry", &batchStaticGeometry))
+			RebuildRenderList();
+
+		if (batchStaticGeometry) {
+			StaticBatchStats s = staticBatcher->GetStats();
+			ImGui::Text("Merged: %d of %d static | Chunks: %d (%d with 16 bit indices)",
+				s.MergedEntities, s.StaticEntities, s.Chunks, s.Chunks16Bit);
+			ImGui::Text("Main Pass Draws: %d entities -> %d records",
+				(int)entities.size(), renderList->GetCount());
+		}
+	}
+
+	// shader variants
+	{
+		ShaderVariantCacheStats s = shaderVariantCache->GetStats();
+		ImGui::Text("Shader Variants: %d used | %d cached | Frame: %s",
+			pbrVariants->GetLoadedCount(), s.Entries, ShaderVariantCache::DescribeFeatures(frameShaderFeatures).c_str());
+		ImGui::Text("Shader Reflection: %d from cache | %d reflected",
+			ISimpleShader::ReflectionCacheHits, ISimpleShader::ReflectionCacheMisses);
+	}
+
+	// shadow caster culling
+	{
+		ImGui::Checkbox("Cull Shadow Casters", &cullShadowCasters);
+		ImGui::Checkbox("Cull Casters Without Visible Receivers", &cullShadowReceivers);
+		ImGui::Text("Shadow Casters Drawn: %d | Outside Light: %d | No Receiver: %d",
+			shadowCullStats.CastersDrawn,
+			shadowCullStats.SkippedOutsideVolume,
+			shadowCullStats.SkippedNoReceiver);
+		ImGui::Text("Shadow Vertex Fetch: %.1f KB (%.1f KB with full vertices)",
+			shadowVertexBytes / 1024.0, shadowVertexBytesInterleaved / 1024.0);
+	}
+
+	// static shadow caching
+	{
+		ImGui::Checkbox("Cache Static Shadows", &cacheStaticShadows);
+		if (ImGui::Button("Rebuild Static Shadows"))
+			shadowCache->Invalidate();
+
+		ShadowCacheStats cacheStats = shadowCache->GetStats();
+		ImGui::Text("Static Redrawn: %d | Dirty Texels: %d%s",
+			cacheStats.StaticRedrawn,
+			cacheStats.DirtyTexels,
+			cacheStats.FullRebuild ? " (full)" : "");
+		ImGui::Text("Full Rebuilds: %d | Partial Rebuilds: %d",
+			cacheStats.FullRebuilds,
+			cacheStats.PartialRebuilds);
+	}
 
 
 	//ImGui::Image(shadowSRV);
@@ -840,6 +1157,18 @@ void Game::BuildGui()
 		for (auto& e : entities) {
 			ImGui::PushID(i);
 			ImGui::Text("Name: %s %d", e->GetMesh()->GetName(), i);
+			// static entities live in the cached shadow map
+			bool isStatic = e->IsStatic();
+			ImGui::Checkbox("Static", &isStatic);
+			e->SetStatic(isStatic);
+			// material swaps have to patch the entity's draw record
+			int mat = 0;
+			for (int m = 0; m < (int)materials.size(); m++)
+				if (materials[m] == e->GetMaterial()) mat = m;
+			if (ImGui::SliderInt("Material", &mat, 0, (int)materials.size() - 1)) {
+				e->SetMaterial(materials[mat]);
+				renderList->Update(entityHandles[i]);
+			}
 			// position
 			DirectX::XMFLOAT3 pos = e->GetTransform()->GetPosition();
 			ImGui::DragFloat3("Position: ", &pos.x, 0.1f);
@@ -934,6 +1263,81 @@ void Game::BuildGui()
 		ImGui::TreePop();
 	}
 	
+	if (ImGui::TreeNode("Textures")) {
+		TextureRegistryStats s = textureRegistry->GetStats();
+		ImGui::Text("Requests: %d | Loaded: %d | Shared by Path: %d | Shared by Contents: %d",
+			s.Requests, s.Loads, s.PathHits, s.ContentHits);
+		ImGui::Text("GPU: %.2f MB | Saved: %.2f MB | Hash: %.1f ms | Create: %.1f ms",
+			s.GpuBytes / 1048576.0, s.GpuBytesSaved / 1048576.0, s.HashMs, s.CreateMs);
+		const TextureLoadStats& l = textureLoadStats;
+		ImGui::Text("Startup: %.1f ms | Texture Loading: %.1f ms for %d files", startupMs, l.WallMs, l.Files);
+		ImGui::Text("Read: %.1f ms | Decode: %.1f ms (all workers) | Create: %.1f ms | Waiting: %.1f ms",
+			l.ReadMs, l.DecodeMs, l.CreateMs, l.WaitMs);
+		ImGui::Text("Peak In Flight: %.1f MB of %.1f MB read | Stalls: %d",
+			l.PeakBytesInFlight / 1048576.0, l.BytesRead / 1048576.0, l.Stalls);
+		unsigned int constant = 0, orm = 0;
+		for (auto& m : materials) {
+			if (m->GetTextureSRV("ORMMap")) orm++;
+			else constant += !m->GetTextureSRV("RoughnessMap") + !m->GetTextureSRV("MetalnessMap");
+		}
+		ImGui::Text("ORM Packed: %d materials | Constant Maps: %d", orm, constant);
+
+		for (auto& r : textureRegistry->GetRecords()) {
+			if (!r.SRV) continue;
+			std::string name = std::filesystem::path(r.Path).filename().string();
+			ImGui::Text("%-28s refs %2d | %7.1f KB%s%s", name.c_str(), r.References, r.GpuBytes / 1024.0,
+				r.Cooked ? " | dds" : "", r.Aliases.empty() ? "" : " | shared");
+			if (!r.Aliases.empty() && ImGui::IsItemHovered()) {
+				std::string aliases;
+				for (auto& a : r.Aliases) aliases += std::filesystem::path(a).filename().string() + "\n";
+				ImGui::SetTooltip("%s", aliases.c_str());
+			}
+		}
+		ImGui::TreePop();
+	}
+	if (ImGui::TreeNode("Streaming")) {
+		TextureResidency& residency = textureStreamer->GetResidency();
+		int budgetMB = (int)(residency.GetBudget() / 1048576);
+		if (ImGui::SliderInt("Budget (MB)", &budgetMB, 4, 256))
+			residency.SetBudget((size_t)budgetMB * 1048576);
+
+		TextureResidencyStats s = residency.GetStats();
+		ImGui::Text("Resident: %.2f MB | Loading: %.2f MB | Wanted: %.2f MB",
+			s.ResidentBytes / 1048576.0, s.PendingBytes / 1048576.0, s.WantedBytes / 1048576.0);
+		ImGui::Text("Textures: %d (%d visible) | Loads: %d in flight, %d done, %d failed | Evictions: %d | Deferred: %d",
+			s.Textures, s.Visible, s.LoadsInFlight, s.LoadsFinished, s.LoadsFailed, s.Evictions, s.Deferred);
+		ImGui::Text("Update: %.3f ms%s%s", textureStreamer->GetLastUpdateMs(),
+			textureStreamer->GetLastError().empty() ? "" : " | ", textureStreamer->GetLastError().c_str());
+
+		const std::vector<StreamedTexture>& textures = textureStreamer->GetTextures();
+		for (unsigned int i = 0; i < textures.size(); i++) {
+			const StreamedTexture& t = textures[i];
+			std::string name = std::filesystem::path(t.Path).filename().string();
+			ImGui::Text("%-28s mip %2d (%4dx%-4d) wants %2d | %7.1f KB%s%s", name.c_str(), t.TopMip,
+				std::max(1u, t.Width >> t.TopMip), std::max(1u, t.Height >> t.TopMip), residency.GetWantedMip(i),
+				residency.GetResidentBytes(i) / 1024.0, residency.IsLoading(i) ? " | loading" : "",
+				t.Aliases.empty() ? "" : (" | +" + std::to_string(t.Aliases.size()) + " shared").c_str());
+		}
+		ImGui::TreePop();
+	}
+	if (ImGui::TreeNode("Image Lighting")) {
+		if (hdrSky)
+			ImGui::Text("HDR sky %s in %.1f ms | decode %.1f ms, resample %.1f ms, mips %.1f ms, encode %.1f ms",
+				skyStats.FromCache ? "loaded" : "converted", skyStats.TotalMs, skyStats.DecodeMs, skyStats.ResampleMs, skyStats.MipsMs, skyStats.EncodeMs);
+		if (!ibl.Specular)
+			ImGui::Text("No bake (the sky's faces didn't decode), lighting with ambient");
+		else {
+			ImGui::Checkbox("Light With The Sky (instead of ambient)", &imageLighting);
+			ImGui::SliderFloat("Intensity", &iblIntensity, 0.0f, 4.0f);
+			ImGui::Text("%s in %.1f ms | hash %.1f ms, read %.1f ms", iblStats.FromCache ? "From cache" : "Baked",
+				iblStats.TotalMs, iblStats.HashMs, iblStats.LoadMs);
+			ImGui::Text("Source %.1f ms | Irradiance %.1f ms | Specular %.1f ms | BRDF %.1f ms | Save %.1f ms",
+				iblStats.SourceMs, iblStats.IrradianceMs, iblStats.SpecularMs, iblStats.BRDFMs, iblStats.SaveMs);
+			ImGui::Text("Specular: %u levels | Irradiance (DC): %.3f %.3f %.3f", ibl.SpecularLevels,
+				ibl.Irradiance[0][0], ibl.Irradiance[0][1], ibl.Irradiance[0][2]);
+		}
+		ImGui::TreePop();
+	}
 	if (ImGui::TreeNode("Materials")) {
 		int i = 1000;
 
@@ -947,6 +1351,17 @@ void Game::BuildGui()
 			m->SetUVOffset(offset);
 			m->SetUVScale(scale);
 
+			// turning a feature off switches to a cheaper variant
+			unsigned int features = m->GetFeatures();
+			bool changed = ImGui::CheckboxFlags("Normal Map", &features, ShaderFeatureNormalMap);
+			changed |= ImGui::CheckboxFlags("Roughness Map", &features, ShaderFeatureRoughnessMap);
+			changed |= ImGui::CheckboxFlags("Metalness Map", &features, ShaderFeatureMetalnessMap);
+			if (changed) {
+				m->SetFeatures(features);
+				SelectShaderVariants(frameShaderFeatures);
+				shaderVariantCache->SaveIndex();
+			}
+
 			ImGui::PopID();
 			i++;
 		}
@@ -992,6 +1407,565 @@ void Game::UpdateObjectTransformations(float deltaTime)
 }
 
 
+// --------------------------------------------------------
+// Picks which entities get drawn into the shadow map
+// 
+// - Casters outside the light's orthographic volume are
+//   skipped, though the volume reaches all the way back to
+//   the light so off-screen casters still cast into view
+// - Optionally, casters whose shadow can't reach anything
+//   the camera sees are skipped too
+// - When static shadows are cached, static casters go in
+//   their own list instead.  The cached map is reused from
+//   any camera angle, so only the light volume test applies.
+// --------------------------------------------------------
+void Game::CullShadowCasters()
+{
+	shadowCasters.clear();
+	staticShadowCasters.clear();
+	shadowCullStats = {};
+
+	// light and camera view-projection matrices
+	XMFLOAT4X4 lightViewProj;
+	XMStoreFloat4x4(&lightViewProj, XMMatrixMultiply(
+		XMLoadFloat4x4(&shadowOptions.shadowViewMatrix),
+		XMLoadFloat4x4(&shadowOptions.shadowProjectionMatrix)));
+
+	XMFLOAT4X4 camView = cameras[curCamera]->GetView();
+	XMFLOAT4X4 camProj = cameras[curCamera]->GetProjection();
+	XMFLOAT4X4 camViewProj;
+	XMStoreFloat4x4(&camViewProj, XMMatrixMultiply(XMLoadFloat4x4(&camView), XMLoadFloat4x4(&camProj)));
+
+	// project everything into light space once, and gather the
+	// light space bounds of whatever the camera can see
+	// (the shadow cache needs the light space bounds even when culling is off)
+	shadowLightBounds.resize(entities.size());
+	ProjectedBounds receivers = Culling::EmptyBounds();
+	for (unsigned int i = 0; i < entities.size(); i++) {
+		BoundingBox world = entities[i]->GetWorldBounds();
+		shadowLightBounds[i] = Culling::ProjectBounds(world, lightViewProj);
+
+		if (cullShadowCasters && cullShadowReceivers && Culling::IsVisible(world, camViewProj))
+			Culling::MergeBounds(receivers, shadowLightBounds[i]);
+	}
+
+	for (unsigned int i = 0; i < entities.size(); i++) {
+		bool cached = cacheStaticShadows && entities[i]->IsStatic();
+
+		if (cullShadowCasters && !Culling::CasterInLightVolume(shadowLightBounds[i])) {
+			shadowCullStats.SkippedOutsideVolume++;
+			continue;
+		}
+
+		if (cached) {
+			staticShadowCasters.push_back(i);
+			continue;
+		}
+
+		if (cullShadowCasters && cullShadowReceivers && !Culling::CasterReachesReceivers(shadowLightBounds[i], receivers)) {
+			shadowCullStats.SkippedNoReceiver++;
+			continue;
+		}
+
+		shadowCasters.push_back(i);
+	}
+
+	shadowCullStats.CastersDrawn = (unsigned int)shadowCasters.size();
+}
+
+
+// --------------------------------------------------------
+// Times walking a big scene the old way (the entity vector,
+// following shared_ptrs for every draw) against walking a
+// render list, plus the cost of building and patching it.
+//
+// - No drawing happens, just the lookups each draw needs,
+//   so this measures the traversal and nothing else
+// - Results show up in the GUI and the console
+// --------------------------------------------------------
+void Game::BenchmarkRenderList(unsigned int entityCount)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	// fake scene made of the real meshes and materials
+	std::vector<std::shared_ptr<GameEntity>> fakeEntities;
+	fakeEntities.reserve(entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+		fakeEntities.push_back(std::make_shared<GameEntity>(meshes[i % meshes.size()], materials[i % materials.size()]));
+
+	RenderListBenchmarkResults results = {};
+	results.EntityCount = entityCount;
+
+	// build the list
+	RenderList list(GameEntity::ResolveDrawRecord);
+	std::vector<RenderHandle> handles(entityCount);
+	Clock::time_point start = Clock::now();
+	for (unsigned int i = 0; i < entityCount; i++)
+		handles[i] = list.Add(fakeEntities[i]);
+	results.AddMs = ms(start);
+
+	// the lookups the main pass used to do per entity
+	uintptr_t sink = 0;
+	start = Clock::now();
+	for (auto& g : fakeEntities) {
+		std::shared_ptr<SimpleVertexShader> vs = g->GetMaterial()->GetVertexShader();
+		std::shared_ptr<SimplePixelShader> ps = g->GetMaterial()->GetPixelShader();
+		std::shared_ptr<Transform> t = g->GetTransform();
+		std::shared_ptr<Mesh> m = g->GetMesh();
+		sink += (uintptr_t)vs.get() ^ (uintptr_t)ps.get() ^ (uintptr_t)t.get() ^ (uintptr_t)m.get();
+	}
+	results.EntityWalkMs = ms(start);
+
+	// same lookups from the prebuilt records
+	start = Clock::now();
+	for (const DrawRecord& r : list.GetRecords())
+		sink += (uintptr_t)r.VertexShader ^ (uintptr_t)r.PixelShader ^ (uintptr_t)r.EntityTransform ^ (uintptr_t)r.EntityMesh;
+	results.RecordWalkMs = ms(start);
+
+	// remove, re-add and update every 10th entity
+	start = Clock::now();
+	for (unsigned int i = 0; i < entityCount; i += 10) list.Remove(handles[i]);
+	for (unsigned int i = 0; i < entityCount; i += 10) handles[i] = list.Add(fakeEntities[i]);
+	for (unsigned int i = 5; i < entityCount; i += 10) list.Update(handles[i]);
+	results.ChurnMs = ms(start);
+
+	renderListBenchmark = results;
+	printf("Render list benchmark (%u entities, checksum %llu)\n", entityCount, (unsigned long long)sink);
+	printf("  entity walk: %.3f ms | record walk: %.3f ms | add all: %.3f ms | 10%% churn: %.3f ms\n",
+		results.EntityWalkMs, results.RecordWalkMs, results.AddMs, results.ChurnMs);
+}
+
+// --------------------------------------------------------
+// Times setting one float3 in the main pixel shader, first
+// by name (a string and a hash lookup per set), then by a
+// handle looked up once
+// - Only touches the local data, nothing reaches the GPU
+// --------------------------------------------------------
+void Game::BenchmarkShaderSetters(unsigned int count)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	std::shared_ptr<SimplePixelShader> ps = materials[0]->GetPixelShader();
+	unsigned int failed = 0;
+
+	Clock::time_point start = Clock::now();
+	for (unsigned int i = 0; i < count; i++)
+		if (!ps->SetFloat3("camPos", XMFLOAT3((float)i, 0, 0))) failed++;
+	shaderSetterNameMs = ms(start);
+
+	start = Clock::now();
+	SimpleShaderHandle camPos = ps->GetVariableHandle("camPos");
+	for (unsigned int i = 0; i < count; i++)
+		if (!ps->SetFloat3(camPos, XMFLOAT3((float)i, 0, 0))) failed++;
+	shaderSetterHandleMs = ms(start);
+
+	shaderSetterBenchmarkCount = count;
+	printf("Shader setter benchmark (%u sets, %u failed)\n", count, failed);
+	printf("  method: SetFloat3(camPos) on the first material's pixel shader, %u times by name then %u by\n"
+		"  handle (one lookup outside the loop), one pass each, no uploads, timed with high_resolution_clock\n", count, count);
+	printf("  by name: %.3f ms | by handle: %.3f ms | %.1fx\n",
+		shaderSetterNameMs, shaderSetterHandleMs, shaderSetterNameMs / (shaderSetterHandleMs > 0 ? shaderSetterHandleMs : 1e-6));
+}
+
+// --------------------------------------------------------
+// Times PrepareMaterial on the immediate context, cycling
+// through the materials the way consecutive draws would,
+// with the baked bindings off and then on
+// - Nothing is drawn, but the state changes are real D3D
+//   calls, so the driver's share of the cost is included
+// --------------------------------------------------------
+void Game::BenchmarkPrepareMaterial(unsigned int count)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	Transform* transform = entities[0]->GetTransform().get();
+	Camera* cam = cameras[curCamera].get();
+	bool wasBaked = Material::UseBakedBindings;
+
+	Material::UseBakedBindings = false;
+	Clock::time_point start = Clock::now();
+	for (unsigned int i = 0; i < count; i++)
+		materials[i % materials.size()]->PrepareMaterial(transform, cam);
+	prepareMaterialUnbakedNs = ms(start) * 1000000.0 / count;
+
+	Material::UseBakedBindings = true;
+	start = Clock::now();
+	for (unsigned int i = 0; i < count; i++)
+		materials[i % materials.size()]->PrepareMaterial(transform, cam);
+	prepareMaterialBakedNs = ms(start) * 1000000.0 / count;
+
+	Material::UseBakedBindings = wasBaked;
+	prepareMaterialBenchmarkCount = count;
+	printf("PrepareMaterial benchmark (%u draws, %u materials)\n", count, (unsigned int)materials.size());
+	printf("  method: PrepareMaterial(entity 0's transform, current camera) on the immediate context, cycling\n"
+		"  through the materials, %u calls unbaked then %u baked, one pass each, no draws, timed with\n"
+		"  high_resolution_clock (includes the driver's share of the state changes)\n", count, count);
+	printf("  unbaked: %.0f ns/draw | baked: %.0f ns/draw\n", prepareMaterialUnbakedNs, prepareMaterialBakedNs);
+}
+
+
+// --------------------------------------------------------
+// Renders the current frame on the CPU and writes it out
+// as reference.ppm (color) and reference_depth.pfm (depth)
+//
+// - Draws the same records as the main pass, plus a CPU
+//   shadow map with the GPU's shadow rasterizer settings
+// - Textures only live on the GPU, so materials fall back
+//   to their tint and roughness (and the sky isn't drawn)
+// - If reference_golden.ppm exists the new image is diffed
+//   against it; the results and the throughput go to the
+//   GUI and the console
+// --------------------------------------------------------
+void Game::RenderReferenceImage()
+{
+	static_assert(sizeof(SoftwareLight) == sizeof(Light), "SoftwareLight must match Light");
+	static_assert(sizeof(Vertex) == sizeof(float) * 11, "SoftwareDrawItem reads Vertex as 11 floats");
+
+	// one software material per real one
+	const std::vector<DrawRecord>& records = renderList->GetRecords();
+	std::vector<SoftwareMaterial> swMaterials(records.size());
+	std::vector<SoftwareDrawItem> items(records.size());
+	for (size_t i = 0; i < records.size(); i++) {
+		const DrawRecord& r = records[i];
+
+		SoftwareMaterial& m = swMaterials[i];
+		m = {};
+		XMFLOAT4 tint = r.EntityMaterial->GetColorTint();
+		XMFLOAT2 scale = r.EntityMaterial->GetUVScale();
+		XMFLOAT2 offset = r.EntityMaterial->GetUVOffset();
+		m.ColorTint[0] = tint.x; m.ColorTint[1] = tint.y; m.ColorTint[2] = tint.z;
+		m.UVScale[0] = scale.x; m.UVScale[1] = scale.y;
+		m.UVOffset[0] = offset.x; m.UVOffset[1] = offset.y;
+		m.Roughness = r.EntityMaterial->GetRoughness();
+		m.Metalness = 0.0f;
+
+		SoftwareDrawItem& item = items[i];
+		item.Vertices = &r.EntityMesh->GetVertexData()[0].Position.x;
+		item.VertexCount = (unsigned int)r.EntityMesh->GetVertexData().size();
+		item.Indices = r.EntityMesh->GetIndexData().data();
+		item.IndexCount = (unsigned int)r.EntityMesh->GetIndexData().size();
+		XMFLOAT4X4 world = r.EntityTransform->GetWorldMatrix();
+		XMFLOAT4X4 worldInvTranspose = r.EntityTransform->GetInverseTransposeWorldMatrix();
+		memcpy(item.World, &world, sizeof(item.World));
+		memcpy(item.WorldInvTranspose, &worldInvTranspose, sizeof(item.WorldInvTranspose));
+		item.Material = &m;
+	}
+
+	// shadow map, matching shadowRasterizer
+	SoftwareRasterState shadowState = { true, true, 1000, 1.0f };
+	SoftwareFramebuffer shadowMap;
+	shadowMap.Resize(shadowOptions.resolution, shadowOptions.resolution);
+	softwareRasterizer->RenderDepth(&shadowOptions.shadowViewMatrix._11, &shadowOptions.shadowProjectionMatrix._11, items, shadowState, shadowMap);
+
+	// scene
+	std::shared_ptr<Camera> cam = cameras[curCamera];
+	SoftwareScene scene = {};
+	XMFLOAT4X4 view = cam->GetView();
+	XMFLOAT4X4 projection = cam->GetProjection();
+	XMFLOAT3 camPos = cam->GetTransform()->GetPosition();
+	memcpy(scene.View, &view, sizeof(scene.View));
+	memcpy(scene.Projection, &projection, sizeof(scene.Projection));
+	memcpy(scene.CameraPosition, &camPos, sizeof(scene.CameraPosition));
+	scene.Lights.resize(lights.size());
+	memcpy(scene.Lights.data(), lights.data(), sizeof(Light) * lights.size());
+	scene.ShadowMap = shadowMap.Depth.data();
+	scene.ShadowMapSize = shadowMap.Width;
+	scene.ShadowMapStride = shadowMap.Stride;
+	memcpy(scene.ShadowView, &shadowOptions.shadowViewMatrix, sizeof(scene.ShadowView));
+	memcpy(scene.ShadowProjection, &shadowOptions.shadowProjectionMatrix, sizeof(scene.ShadowProjection));
+
+	// color pass at the window's size
+	SoftwareFramebuffer image;
+	image.Resize(Window::Width(), Window::Height());
+	uint32_t clear =
+		(uint32_t)(_color.x * 255.0f + 0.5f) |
+		((uint32_t)(_color.y * 255.0f + 0.5f) << 8) |
+		((uint32_t)(_color.z * 255.0f + 0.5f) << 16) | 0xFF000000;
+	image.Clear(clear, 1.0f);
+
+	SoftwareRasterState mainState = { true, false, 0, 0.0f };
+	softwareRasterizer->Render(scene, items, mainState, image);
+	referenceStats = softwareRasterizer->GetStats();
+
+	SoftwareRasterizer::SaveColor(image, FixPath("reference.ppm"));
+	SoftwareRasterizer::SaveDepth(image, FixPath("reference_depth.pfm"));
+	printf("CPU reference: %llu triangles (%llu rasterized), %llu pixels in %.2f ms | %.2f M tris/s | %.2f M pixels/s\n",
+		(unsigned long long)referenceStats.TrianglesIn, (unsigned long long)referenceStats.TrianglesRasterized,
+		(unsigned long long)referenceStats.PixelsShaded, referenceStats.Milliseconds,
+		referenceStats.TrianglesPerSecond / 1000000.0, referenceStats.PixelsPerSecond / 1000000.0);
+
+	// diff against a golden image, if there is one
+	SoftwareFramebuffer golden;
+	referenceCompared = SoftwareRasterizer::LoadColor(golden, FixPath("reference_golden.ppm"));
+	if (referenceCompared) {
+		if (!SoftwareRasterizer::LoadDepth(golden, FixPath("reference_golden_depth.pfm")))
+			golden.Depth.clear();	// color only
+		referenceDiff = SoftwareRasterizer::Compare(image, golden, 2);
+		printf("  vs golden: %u pixels differ (tolerance 2), max delta %u, MAE %.3f, max depth delta %f\n",
+			referenceDiff.DifferentPixels, referenceDiff.MaxChannelDelta, referenceDiff.MeanAbsoluteError, referenceDiff.MaxDepthDelta);
+	}
+}
+
+
+// --------------------------------------------------------
+// Replaces the GUI's extra lights with count random point
+// and spot lights scattered over the scene
+//
+// - Fixed seed, so the same count gives the same lights
+// --------------------------------------------------------
+void Game::CreateExtraLights(unsigned int count)
+{
+	std::mt19937 random(12345);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	auto range = [&](float low, float high) { return low + (high - low) * unit(random); };
+
+	extraLights.clear();
+	extraLights.reserve(count);
+	for (unsigned int i = 0; i < count; i++) {
+		Light l = {};
+		l.type = unit(random) < 0.2f ? LIGHT_TYPE_SPOT : LIGHT_TYPE_POINT;
+		l.position = XMFLOAT3(range(-20.0f, 20.0f), range(0.0f, 4.0f), range(-20.0f, 20.0f));
+		l.range = range(0.5f, 3.0f);
+		l.color = XMFLOAT3(range(0.2f, 1.0f), range(0.2f, 1.0f), range(0.2f, 1.0f));
+		l.intensity = 0.5f;
+		if (l.type == LIGHT_TYPE_SPOT) {
+			XMStoreFloat3(&l.direction, XMVector3Normalize(XMVectorSet(range(-0.5f, 0.5f), -1.0f, range(-0.5f, 0.5f), 0.0f)));
+			l.spotOuterAngle = range(0.2f, 0.8f);
+			l.spotInnerAngle = l.spotOuterAngle * 0.5f;
+		}
+		extraLights.push_back(l);
+	}
+}
+
+// --------------------------------------------------------
+// Writes a frame's worth of data into a structured buffer,
+// recreating it (and its view) if it's too small
+//
+// - Buffers are never empty, so the views always exist
+// --------------------------------------------------------
+static void UploadStructuredBuffer(DynamicStructuredBuffer& buffer, const void* data, unsigned int count, unsigned int stride)
+{
+	if (!buffer.Buffer || buffer.Capacity < count) {
+		unsigned int capacity = std::max(std::max(count, buffer.Capacity * 2), 64u);
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = capacity * stride;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.NumElements = capacity;
+
+		buffer = {};
+		if (FAILED(Graphics::Device->CreateBuffer(&desc, 0, buffer.Buffer.GetAddressOf())))
+			return;
+		Graphics::Device->CreateShaderResourceView(buffer.Buffer.Get(), &srvDesc, buffer.SRV.GetAddressOf());
+		buffer.Capacity = capacity;
+	}
+
+	if (count == 0) return;
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (SUCCEEDED(Graphics::Context->Map(buffer.Buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+		memcpy(mapped.pData, data, (size_t)count * stride);
+		Graphics::Context->Unmap(buffer.Buffer.Get(), 0);
+	}
+}
+
+// --------------------------------------------------------
+// Splits this frame's lights between the constant buffer
+// (directional) and the clusters (point and spot), assigns
+// the clustered ones for the current camera and uploads
+// the results for the pixel shader
+//
+// - Runs before anything is recorded, so the maps happen
+//   before the command lists that read the buffers
+// --------------------------------------------------------
+void Game::UpdateLightClusters()
+{
+	directionalLights.clear();
+	clusteredLights.clear();
+	clusterInputs.clear();
+
+	auto addLight = [&](const Light& l) {
+		if (l.type == LIGHT_TYPE_DIRECTIONAL) {
+			if (directionalLights.size() < MAX_DIRECTIONAL_LIGHTS) directionalLights.push_back(l);
+			return;
+		}
+
+		ClusterLight c = {};
+		memcpy(c.Position, &l.position, sizeof(c.Position));
+		c.Range = l.range;
+		memcpy(c.Direction, &l.direction, sizeof(c.Direction));
+		c.SpotOuterAngle = l.spotOuterAngle;
+		c.Spot = l.type == LIGHT_TYPE_SPOT;
+		clusterInputs.push_back(c);
+		clusteredLights.push_back(l);
+	};
+	for (auto& l : lights) addLight(l);
+	for (auto& l : extraLights) addLight(l);
+
+	std::shared_ptr<Camera> cam = cameras[curCamera];
+	XMFLOAT4X4 view = cam->GetView();
+	XMFLOAT4X4 projection = cam->GetProjection();
+	lightClusters->Assign(&view._11, &projection._11, cam->GetNearClip(), cam->GetFarClip(), clusterInputs);
+
+	UploadStructuredBuffer(clusterLightBuffer, clusteredLights.data(), (unsigned int)clusteredLights.size(), sizeof(Light));
+	UploadStructuredBuffer(clusterGridBuffer, lightClusters->GetGrid().data(), (unsigned int)lightClusters->GetGrid().size(), sizeof(ClusterRange));
+	UploadStructuredBuffer(clusterIndexBuffer, lightClusters->GetIndices().data(), (unsigned int)lightClusters->GetIndices().size(), sizeof(unsigned int));
+}
+
+
+// --------------------------------------------------------
+// Points every material at the variant for its features
+// plus the frame's, then rebuilds the render list, whose
+// records hold the pixel shaders
+// --------------------------------------------------------
+void Game::SelectShaderVariants(unsigned int frameFeatures)
+{
+	frameShaderFeatures = frameFeatures;
+	for (auto& m : materials)
+		m->SelectVariant(frameFeatures);
+	RebuildRenderList();
+}
+
+// --------------------------------------------------------
+// Packs the materials' textures into Texture2DArrays
+// - Materials whose four maps match (size, mips, format)
+//   share a set of arrays, one per map, each material on
+//   its own layer
+// - Materials keep their own textures too; the mode only
+//   decides which the shader variant reads
+// --------------------------------------------------------
+void Game::BuildTextureArrays()
+{
+	static const char* slots[] = { "Albedo", "NormalMap", "RoughnessMap", "MetalnessMap", "ORMMap" };
+	const unsigned int slotCount = sizeof(slots) / sizeof(slots[0]);
+
+	// describe every material's maps (a map it doesn't have, like roughness
+	// that's packed or constant, is all zeros, so it only shares a set with
+	// materials that don't have it either - one that can't be described,
+	// or that's streamed and so changes size, leaves the material out)
+	std::vector<std::vector<TextureArrayInput>> inputs(materials.size());
+	for (unsigned int m = 0; m < materials.size(); m++) {
+		for (unsigned int s = 0; s < slotCount; s++) {
+			TextureArrayInput input = {};
+			ID3D11ShaderResourceView* srv = materials[m]->GetTextureSRV(slots[s]).Get();
+			if (srv && (textureStreamer->Find(srv) >= 0 || !D3D11TextureArrays::Describe(srv, input))) {
+				inputs[m].clear();
+				break;
+			}
+			inputs[m].push_back(input);
+		}
+	}
+	textureArrayPlan = TextureArrayPlanner::Plan(inputs);
+
+	// copy each set's textures into its arrays
+	textureArrays.clear();
+	for (unsigned int set = 0; set < textureArrayPlan.Sets.size(); set++) {
+		const TextureArraySet& s = textureArrayPlan.Sets[set];
+		std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> arrays;
+		for (unsigned int slot = 0; slot < slotCount; slot++) {
+			if (s.Slots[slot].Width == 0) continue;
+			std::vector<ID3D11ShaderResourceView*> layers;
+			for (unsigned int m : s.Materials)
+				layers.push_back(materials[m]->GetTextureSRV(slots[slot]).Get());
+
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> array = D3D11TextureArrays::Create(Graphics::Device, Graphics::Context, layers);
+			if (!array) {
+				arrays.clear();
+				break;
+			}
+			arrays[std::string(slots[slot]) + "Array"] = array;
+			textureArrays.push_back(array);
+		}
+
+		for (unsigned int layer = 0; layer < s.Materials.size(); layer++)
+			materials[s.Materials[layer]]->SetTextureArrays(arrays, (int)layer);
+	}
+
+	printf("Texture arrays: %u of %u materials in %u sets (%.1f MB of top mips)\n",
+		textureArrayPlan.PackedMaterials, (unsigned int)materials.size(), (unsigned int)textureArrayPlan.Sets.size(),
+		textureArrayPlan.PackedBytes / (1024.0 * 1024.0));
+}
+
+// --------------------------------------------------------
+// Switches every packed material to (or from) the variant
+// that reads its textures from the arrays
+// --------------------------------------------------------
+void Game::SetTextureArrayMode(bool enabled)
+{
+	useTextureArrays = enabled;
+	for (auto& m : materials) {
+		if (!m->HasTextureArrays()) continue;
+		unsigned int features = m->GetFeatures();
+		m->SetFeatures(enabled ? features | ShaderFeatureTextureArrays : features & ~ShaderFeatureTextureArrays);
+	}
+	SelectShaderVariants(frameShaderFeatures);
+	shaderVariantCache->SaveIndex();
+}
+
+// --------------------------------------------------------
+// Asks for the mips each visible entity's textures need,
+// from how large its bounds are on screen, then hands the
+// textures that changed to their materials
+//
+// - Each texture is assumed to cover the bounds once per
+//   UV repeat, so the estimate errs on the fine side for
+//   anything long and thin
+// - Entities the camera can't see ask for nothing, so their
+//   textures are the first to go when the budget is tight
+// --------------------------------------------------------
+void Game::UpdateTextureStreaming()
+{
+	textureStreamer->BeginFrame();
+
+	std::shared_ptr<Camera> cam = cameras[curCamera];
+	XMFLOAT4X4 view = cam->GetView();
+	XMFLOAT4X4 projection = cam->GetProjection();
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&projection)));
+	XMFLOAT3 position = cam->GetTransform()->GetPosition();
+	XMVECTOR camPos = XMLoadFloat3(&position);
+
+	const std::vector<StreamedTexture>& textures = textureStreamer->GetTextures();
+	for (auto& e : entities) {
+		auto found = streamedTextures.find(e->GetMaterial().get());
+		if (found == streamedTextures.end()) continue;
+		BoundingBox bounds = e->GetWorldBounds();
+		if (!Culling::IsVisible(bounds, viewProj)) continue;
+
+		float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+		float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&bounds.Center), camPos))) - radius;
+		XMFLOAT2 scale = e->GetMaterial()->GetUVScale();
+		for (auto& t : found->second) {
+			const StreamedTexture& texture = textures[t.Texture];
+			textureStreamer->Request(t.Texture, TextureResidency::GetDesiredMip(std::max(texture.Width, texture.Height),
+				std::max(scale.x, scale.y), radius, distance, projection._22, (float)Window::Height()));
+		}
+	}
+
+	for (unsigned int changed : textureStreamer->Update()) {
+		for (auto& m : streamedTextures)
+			for (auto& t : m.second)
+				if (t.Texture == changed) m.first->SetTextureSRV(t.Slot, textureStreamer->GetSRV(changed));
+	}
+}
+
+
 // --------------------------------------------------------
 // Handle resizing to match the new window size
 // update our 3D camera
@@ -1020,8 +1994,15 @@ void Game::Update(float deltaTime, float totalTime)
 
 	UpdateObjectTransformations(deltaTime);
 
+	// chunks are baked, so they have to be rebuilt if what went into them changed
+	if (batchStaticGeometry && staticBatcher->IsStale(entities))
+		RebuildRenderList();
+
 	// update cameras
 	for (auto& c : cameras) c->Update(deltaTime);
+
+	// finer mips for whatever got closer, before anything is recorded with the old ones
+	UpdateTextureStreaming();
 	
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::KeyDown(VK_ESCAPE))
@@ -1035,103 +2016,362 @@ void Game::Update(float deltaTime, float totalTime)
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
-	// Frame START
-	// - These things should happen ONCE PER FRAME
-	// - At the beginning of Game::Draw() before drawing *anything*
-	{
-		// Clear the back buffer (erase what's on screen) and depth buffer
-		float color[4] = { _color.x, _color.y, _color.z, _color.w };
-		Graphics::Context->ClearRenderTargetView(Graphics::BackBufferRTV.Get(),	color);
-		Graphics::Context->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
- 
-	}
+	// point and spot lights go to the clusters, directional lights to the constant buffer
+	UpdateLightClusters();
+
+	// pick the pixel shader variants this frame's lights need
+	// - only changes when shadows are turned on or off, or the
+	//   clustered lights come or go, so the rebuild is rare
+	bool anyShadowLight = false;
+	for (auto& l : lights)
+		if (l.castsShadows) anyShadowLight = true;
+	unsigned int frameFeatures =
+		(anyShadowLight ? ShaderFeatureShadows : 0) |
+		(clusteredLights.empty() ? 0 : ShaderFeatureClusteredLights) |
+		(imageLighting && ibl.Specular ? ShaderFeatureImageLighting : 0);
+	if (frameFeatures != frameShaderFeatures)
+		SelectShaderVariants(frameFeatures);
 
 	// shadow map stuff
-	
-	// clear shadow map and set up targets
-	// switch render target
-	Graphics::Context->OMSetRenderTargets(0, 0, shadowOptions.shadowDSV.Get());
-	Graphics::Context->ClearDepthStencilView(shadowOptions.shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-	Graphics::Context->RSSetState(shadowRasterizer.Get());
 
-	// create and change viewport
+	// create viewports for both passes
 	// 
 	// 
-	D3D11_VIEWPORT vp = {};
-	vp.TopLeftX = 0.0f;
-	vp.TopLeftY = 0.0f;
-	vp.Width = (float)shadowOptions.resolution;
-	vp.Height = (float)shadowOptions.resolution;
-	vp.MinDepth = 0.0f;
-	vp.MaxDepth = 1.0f;
-	Graphics::Context->RSSetViewports(1, &vp);
-
-	// set shadow vertex shader
-	shadowVS->SetShader();
-	// send data
-	shadowVS->SetMatrix4x4("view", shadowOptions.shadowViewMatrix);
-	shadowVS->SetMatrix4x4("projection", shadowOptions.shadowProjectionMatrix);
-	// turn off pixel shader
-	Graphics::Context->PSSetShader(0, 0, 0);
+	D3D11_VIEWPORT shadowVP = {};
+	shadowVP.TopLeftX = 0.0f;
+	shadowVP.TopLeftY = 0.0f;
+	shadowVP.Width = (float)shadowOptions.resolution;
+	shadowVP.Height = (float)shadowOptions.resolution;
+	shadowVP.MinDepth = 0.0f;
+	shadowVP.MaxDepth = 1.0f;
+
+	D3D11_VIEWPORT vp = shadowVP;
+	vp.Width = (float)Window::Width();
+	vp.Height = (float)Window::Height();
+
+	// the frame's resources
+	// - the shadow map only lives for the frame, so the graph owns it
+	// - views of it can only be looked up once the graph is compiled,
+	//   which is fine, since passes only run after that
+	frameGraph->Reset();
+	FrameTextureDesc screenDesc = { (unsigned int)Window::Width(), (unsigned int)Window::Height(), RenderTextureFormat::RGBA8 };
+	FrameTextureDesc screenDepthDesc = { screenDesc.Width, screenDesc.Height, RenderTextureFormat::D32_Float };
+	FrameTextureDesc shadowDesc = { (unsigned int)shadowOptions.resolution, (unsigned int)shadowOptions.resolution, RenderTextureFormat::D32_Float };
+
+	FrameResource backBuffer = frameGraph->ImportTexture("Back Buffer", screenDesc, true);
+	FrameResource depthBuffer = frameGraph->ImportTexture("Depth Buffer", screenDepthDesc, false);
+	FrameResource staticShadowMap = frameGraph->ImportTexture("Static Shadow Map", shadowDesc, false);
+	FrameResource shadowMap = frameGraph->CreateTexture("Shadow Map", shadowDesc);
+	FrameResource shadowMapHandle = shadowMap;
+
+	auto shadowDSV = [&]() { return frameGraphBackend->GetDSV(frameGraph->GetSlot(shadowMapHandle)); };
+	auto shadowSRV = [&]() { return frameGraphBackend->GetSRV(frameGraph->GetSlot(shadowMapHandle)); };
+
+	// Frame START
+	// - These things should happen ONCE PER FRAME
+	// - At the beginning of Game::Draw() before drawing *anything*
+	unsigned int clearPass = frameGraph->AddPass("Clear", [&]()
+		{
+			// Clear the back buffer (erase what's on screen) and depth buffer
+			deferredRenderer->RecordCommands([&](ID3D11DeviceContext* context)
+				{
+					float color[4] = { _color.x, _color.y, _color.z, _color.w };
+					context->ClearRenderTargetView(Graphics::BackBufferRTV.Get(), color);
+					context->ClearDepthStencilView(Graphics::DepthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+				});
+		});
+	backBuffer = frameGraph->Write(clearPass, backBuffer, FrameAccess::CopyWrite);
+	depthBuffer = frameGraph->Write(clearPass, depthBuffer, FrameAccess::CopyWrite);
 
 	// render sene entities to shadow maps from the light's point of view
 	// do once for each light that casts shadows
 	// hardcoded for now, only one light casts shadows
-	for (auto& e : entities) {
-		shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
+	// - only casters that survive culling are drawn
+	// - every job starts from default state, so the setup runs once per job
+	// - the clears and copies are recorded too, so they stay in order with the draws
+	CullShadowCasters();
+
+	auto bindShadowVS = [&](ID3D11DeviceContext* context)
+		{
+			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+			// set shadow vertex shader
+			shadowVS->SetShader();
+			// send data
+			shadowVS->SetMatrix4x4("view", shadowOptions.shadowViewMatrix);
+			shadowVS->SetMatrix4x4("projection", shadowOptions.shadowProjectionMatrix);
+			// turn off pixel shader
+			context->PSSetShader(0, 0, 0);
+		};
+	auto drawCaster = [&](ID3D11DeviceContext* context, unsigned int entityIndex)
+		{
+			std::shared_ptr<GameEntity>& e = entities[entityIndex];
+			shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
+			shadowVS->CopyAllBufferData();
+
+			D3D11RenderContext rc(context);
+			e->GetMesh()->DrawDepthOnly(&rc);
+		};
+
+	std::vector<unsigned int> redraw;
+	unsigned int staticRedrawPass = 0;
+	bool redrawStatic = false;
+	if (cacheStaticShadows) {
+		// redraw whatever part of the static map changed, then start
+		// the live map from a copy of it
+		redrawStatic = shadowCache->Update(lights, shadowOptions.shadowViewMatrix, shadowOptions.shadowProjectionMatrix,
+			entities, shadowLightBounds);
+		if (redrawStatic)
+		{
+			for (unsigned int i : staticShadowCasters)
+				if (shadowCache->NeedsRedraw(shadowLightBounds[i])) redraw.push_back(i);
+			shadowCache->CountStaticRedrawn((unsigned int)redraw.size());
+
+			staticRedrawPass = frameGraph->AddPass("Static Shadow Casters", [&]()
+				{
+					deferredRenderer->RecordCommands([&](ID3D11DeviceContext* context) { shadowCache->ClearDirtyRegion(context); });
+					deferredRenderer->RecordPass((unsigned int)redraw.size(),
+						[&](ID3D11DeviceContext* context)
+						{
+							shadowCache->BindStaticTarget(context);
+							bindShadowVS(context);
+						},
+						[&](ID3D11DeviceContext* context, unsigned int i) { drawCaster(context, redraw[i]); });
+				});
+			staticShadowMap = frameGraph->Write(staticRedrawPass, staticShadowMap, FrameAccess::DepthStencil);
+		}
 
-		e->GetMesh()->Draw();
+		unsigned int copyPass = frameGraph->AddPass("Copy Static Shadows", [&]()
+			{
+				deferredRenderer->RecordCommands([&](ID3D11DeviceContext* context)
+					{
+						shadowCache->CopyToShadowMap(context, frameGraphBackend->GetTexture(frameGraph->GetSlot(shadowMapHandle)));
+					});
+			});
+		frameGraph->Read(copyPass, staticShadowMap, FrameAccess::CopyRead);
+		shadowMap = frameGraph->Write(copyPass, shadowMap, FrameAccess::CopyWrite);
 	}
+	else {
+		// whatever's cached is stale by the time caching comes back on
+		shadowCache->Invalidate();
 
-	// switch render target back
-	Graphics::Context->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
-	vp.Width = (float)Window::Width();
-	vp.Height = (float)Window::Height();
-	Graphics::Context->RSSetViewports(1, &vp);
-	Graphics::Context->RSSetState(0);
-	
+		unsigned int shadowClearPass = frameGraph->AddPass("Clear Shadow Map", [&]()
+			{
+				deferredRenderer->RecordCommands([&](ID3D11DeviceContext* context)
+					{
+						context->ClearDepthStencilView(shadowDSV(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+					});
+			});
+		shadowMap = frameGraph->Write(shadowClearPass, shadowMap, FrameAccess::CopyWrite);
+	}
+
+	// dynamic casters (or everything, without the cache) go straight into the live map
+	unsigned int shadowPass = frameGraph->AddPass("Shadow Casters", [&]()
+		{
+			deferredRenderer->RecordPass((unsigned int)shadowCasters.size(),
+				[&](ID3D11DeviceContext* context)
+				{
+					// switch render target and state
+					context->OMSetRenderTargets(0, 0, shadowDSV());
+					context->RSSetState(shadowRasterizer.Get());
+					context->RSSetViewports(1, &shadowVP);
+					bindShadowVS(context);
+				},
+				[&](ID3D11DeviceContext* context, unsigned int i) { drawCaster(context, shadowCasters[i]); });
+		});
+	shadowMap = frameGraph->Write(shadowPass, shadowMap, FrameAccess::DepthStencil);
+
+	// vertex data the shadow draws read (each vertex once, so a lower bound)
+	shadowVertexBytes = 0;
+	shadowVertexBytesInterleaved = 0;
+	for (auto* casters : { &shadowCasters, &redraw }) {
+		for (unsigned int i : *casters) {
+			unsigned long long verts = entities[i]->GetMesh()->GetVertexCount();
+			shadowVertexBytes += verts * sizeof(XMFLOAT3);
+			shadowVertexBytesInterleaved += verts * sizeof(Vertex);
+		}
+	}
 
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
 	// assignment 12
 	// pass in shadow map, perform per pixel shadow calculations
-	for (auto& g : entities) {
-		// vert shader
-		std::shared_ptr<SimpleVertexShader> vs = g->GetMaterial()->GetVertexShader();
-		vs->SetMatrix4x4("shadowView", shadowOptions.shadowViewMatrix);
-		vs->SetMatrix4x4("shadowProjection", shadowOptions.shadowProjectionMatrix);
-
-		// pixel shader
-		std::shared_ptr<SimplePixelShader> ps = g->GetMaterial()->GetPixelShader();
-		ps->SetFloat3("ambient", ambient);
-		ps->SetData(
-			"lights", 
-			&lights[0],
-			sizeof(Light) * (int)lights.size()
-		);
-		
-		ps->SetShaderResourceView("ShadowMap", shadowOptions.shadowSRV);
-		ps->SetSamplerState("ShadowSampler", shadowSampler);
-
-		g->Draw(_colorTint, cameras[curCamera]);
+	// - walks the retained render list, not the entities
+	// - records (batched chunks included) outside the camera are skipped
+	std::shared_ptr<Camera> cam = cameras[curCamera];
+	const std::vector<DrawRecord>& allRecords = renderList->GetRecords();
+
+	XMFLOAT4X4 camView = cam->GetView();
+	XMFLOAT4X4 camProj = cam->GetProjection();
+	XMFLOAT4X4 camViewProj;
+	XMStoreFloat4x4(&camViewProj, XMMatrixMultiply(XMLoadFloat4x4(&camView), XMLoadFloat4x4(&camProj)));
+
+	std::vector<const DrawRecord*> records;
+	records.reserve(allRecords.size());
+	for (const DrawRecord& r : allRecords)
+		if (Culling::IsVisible(r.Entity->GetWorldBounds(), camViewProj)) records.push_back(&r);
+	mainPassDraws = (unsigned int)records.size();
+
+	// where the pixel shader finds its clusters
+	XMFLOAT4 clusterViewZ(camView._13, camView._23, camView._33, camView._43);
+	XMFLOAT2 clusterScreenSize((float)Window::Width(), (float)Window::Height());
+	unsigned int clusterCount[3] = { lightClusters->GetGridX(), lightClusters->GetGridY(), lightClusters->GetGridZ() };
+
+	// the handful of shaders those records use, with the per-frame
+	// variables looked up once here instead of by name every draw
+	struct MainPassVS
+	{
+		SimpleVertexShader* Shader;
+		SimpleShaderHandle ShadowView, ShadowProjection;
+	};
+	struct MainPassPS
+	{
+		SimplePixelShader* Shader;
+		SimpleShaderHandle Ambient, Lights, DirectionalLightCount;
+		SimpleShaderHandle ClusterViewZ, ClusterScreenSize, ClusterSliceScale, ClusterSliceBias, ClusterCount;
+		SimpleShaderHandle ClusterLights, ClusterGrid, ClusterLightIndices, ShadowMap, ShadowSampler;
+		SimpleShaderHandle IBLIntensity, IrradianceSH, SpecularMipCount, SpecularIBL, BRDFLookup, ClampSampler;
+	};
+	std::vector<MainPassVS> mainVS;
+	std::vector<MainPassPS> mainPS;
+	for (const DrawRecord* r : records)
+	{
+		bool seen = false;
+		for (auto& v : mainVS) seen |= v.Shader == r->VertexShader;
+		if (!seen)
+			mainVS.push_back({ r->VertexShader,
+				r->VertexShader->GetVariableHandle("shadowView"),
+				r->VertexShader->GetVariableHandle("shadowProjection") });
+
+		seen = false;
+		for (auto& p : mainPS) seen |= p.Shader == r->PixelShader;
+		if (!seen) {
+			SimplePixelShader* ps = r->PixelShader;
+			mainPS.push_back({ ps,
+				ps->GetVariableHandle("ambient"), ps->GetVariableHandle("lights"), ps->GetVariableHandle("directionalLightCount"),
+				ps->GetVariableHandle("clusterViewZ"), ps->GetVariableHandle("clusterScreenSize"),
+				ps->GetVariableHandle("clusterSliceScale"), ps->GetVariableHandle("clusterSliceBias"), ps->GetVariableHandle("clusterCount"),
+				ps->GetShaderResourceViewHandle("ClusterLights"), ps->GetShaderResourceViewHandle("ClusterGrid"),
+				ps->GetShaderResourceViewHandle("ClusterLightIndices"), ps->GetShaderResourceViewHandle("ShadowMap"),
+				ps->GetSamplerHandle("ShadowSampler"),
+				ps->GetVariableHandle("iblIntensity"), ps->GetVariableHandle("irradianceSH"), ps->GetVariableHandle("specularMipCount"),
+				ps->GetShaderResourceViewHandle("SpecularIBL"), ps->GetShaderResourceViewHandle("BRDFLookup"),
+				ps->GetSamplerHandle("ClampSampler") });
+		}
 	}
-	
-	// sky
-	sky->Draw(cameras[curCamera]);
 
-	//unbind shadow map
-	ID3D11ShaderResourceView* nullSRV[16] = {};
-	Graphics::Context->PSSetShaderResources(0, 16, nullSRV);
+	// the shadow map is only needed (and only drawn) if some light uses it
+	// (anyShadowLight, from the top of the frame)
+	unsigned int mainPass = frameGraph->AddPass("Main", [&]()
+		{
+			ID3D11ShaderResourceView* mainShadowSRV = anyShadowLight ? shadowSRV() : 0;
+			deferredRenderer->RecordPass((unsigned int)records.size(),
+				[&](ID3D11DeviceContext* context)
+				{
+					// switch render target back
+					context->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
+					context->RSSetViewports(1, &vp);
+					context->RSSetState(0);
+					context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+					// per-frame data, once per job rather than per draw
+					// - it stays in this thread's copy of each shader's
+					//   local data, and PrepareMaterial uploads it
+					for (auto& v : mainVS) {
+						v.Shader->SetMatrix4x4(v.ShadowView, shadowOptions.shadowViewMatrix);
+						v.Shader->SetMatrix4x4(v.ShadowProjection, shadowOptions.shadowProjectionMatrix);
+					}
+					for (auto& p : mainPS) {
+						SimplePixelShader* ps = p.Shader;
+						ps->SetFloat3(p.Ambient, ambient);
+						if (!directionalLights.empty())
+							ps->SetData(p.Lights, &directionalLights[0], sizeof(Light) * (int)directionalLights.size());
+						ps->SetInt(p.DirectionalLightCount, (int)directionalLights.size());
+
+						// clustered lights
+						ps->SetFloat4(p.ClusterViewZ, clusterViewZ);
+						ps->SetFloat2(p.ClusterScreenSize, clusterScreenSize);
+						ps->SetFloat(p.ClusterSliceScale, lightClusters->GetSliceScale());
+						ps->SetFloat(p.ClusterSliceBias, lightClusters->GetSliceBias());
+						ps->SetData(p.ClusterCount, clusterCount, sizeof(clusterCount));
+
+						// stage bindings outlive shader switches, but variants
+						// may not all have every resource, so each one sets its own
+						ps->SetShaderResourceView(p.ClusterLights, clusterLightBuffer.SRV.Get());
+						ps->SetShaderResourceView(p.ClusterGrid, clusterGridBuffer.SRV.Get());
+						ps->SetShaderResourceView(p.ClusterLightIndices, clusterIndexBuffer.SRV.Get());
+						ps->SetShaderResourceView(p.ShadowMap, mainShadowSRV);
+						ps->SetSamplerState(p.ShadowSampler, shadowSampler.Get());
+
+						// image lighting
+						ps->SetFloat(p.IBLIntensity, iblIntensity);
+						ps->SetData(p.IrradianceSH, ibl.Irradiance, sizeof(ibl.Irradiance));
+						ps->SetFloat(p.SpecularMipCount, (float)ibl.SpecularLevels);
+						ps->SetShaderResourceView(p.SpecularIBL, ibl.Specular.Get());
+						ps->SetShaderResourceView(p.BRDFLookup, ibl.BRDF.Get());
+						ps->SetSamplerState(p.ClampSampler, clampSampler.Get());
+					}
+				},
+				[&](ID3D11DeviceContext* context, unsigned int i)
+				{
+					const DrawRecord& r = *records[i];
+
+					// same as GameEntity::Draw, minus the pointer chasing
+					r.EntityMaterial->PrepareMaterial(r.EntityTransform, cam.get());
+					D3D11RenderContext rc(context);
+					r.EntityMesh->Draw(&rc);
+				});
+		});
+	if (anyShadowLight) frameGraph->Read(mainPass, shadowMap);
+	backBuffer = frameGraph->Write(mainPass, backBuffer, FrameAccess::RenderTarget);
+	depthBuffer = frameGraph->Write(mainPass, depthBuffer, FrameAccess::DepthStencil);
+
+	// sky
+	// - goes straight to the immediate context, so everything
+	//   recorded before it has to be played back first
+	unsigned int skyPass = frameGraph->AddPass("Sky", [&]()
+		{
+			deferredRenderer->FlushPasses(Graphics::Context.Get());
+
+			// command lists leave the immediate context in its default state
+			Graphics::Context->OMSetRenderTargets(1, Graphics::BackBufferRTV.GetAddressOf(), Graphics::DepthBufferDSV.Get());
+			Graphics::Context->RSSetViewports(1, &vp);
+			Graphics::Context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			sky->Draw(cam);
+		});
+	backBuffer = frameGraph->Write(skyPass, backBuffer, FrameAccess::RenderTarget);
+	depthBuffer = frameGraph->Write(skyPass, depthBuffer, FrameAccess::DepthStencil);
 
 	//
 	// IMGUI
 	//
-	{
-		ImGui::Render();
-		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
-	}
+	unsigned int uiPass = frameGraph->AddPass("ImGui", [&]()
+		{
+			deferredRenderer->FlushPasses(Graphics::Context.Get());
+			ImGui::Render();
+			ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+		});
+	frameGraph->SetSideEffect(uiPass);
+	backBuffer = frameGraph->Write(uiPass, backBuffer, FrameAccess::RenderTarget);
+
+	// order, cull, alias, then run it all
+	// - the graph adds the shader resource unbinds itself
+	if (!frameGraph->Compile())
+		printf("Frame graph failed to compile: %s\n", frameGraph->GetError().c_str());
+
+	// the static map isn't drawn when nothing reads it, so it's stale afterwards
+	if (redrawStatic && frameGraph->IsCulled(staticRedrawPass))
+		shadowCache->Invalidate();
+
+	frameGraph->Execute(frameGraphBackend.get());
+
+	// play back whatever's left (the graph's closing unbind)
+	deferredRenderer->ExecutePasses(Graphics::Context.Get());
+
+	// constant buffer uploads this frame, shown next frame
+	uploadStats = ISimpleShader::GetUploadStats();
+	ISimpleShader::ResetUploadStats();
 
 
 	// Frame END
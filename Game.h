@@ -4,6 +4,7 @@
 #include <wrl/client.h>
 #include <vector>
 #include <memory>
+#include <unordered_map>
 
 #include "Mesh.h"
 #include "GameEntity.h"
@@ -11,6 +12,42 @@
 #include "SimpleShader.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "ThreadPool.h"
+#include "DeferredRenderer.h"
+#include "Culling.h"
+#include "ShadowCache.h"
+#include "RenderList.h"
+#include "StaticBatcher.h"
+#include "SoftwareRasterizer.h"
+#include "FrameGraph.h"
+#include "D3D11FrameGraph.h"
+#include "LightClusters.h"
+#include "ShaderVariants.h"
+#include "D3D11ShaderVariants.h"
+#include "TextureArrayPlanner.h"
+#include "D3D11TextureArrays.h"
+#include "TextureRegistry.h"
+#include "D3D11TextureStreamer.h"
+#include "D3D11IBL.h"
+#include "EnvironmentMap.h"
+
+// --------------------------------------------------------
+// A structured buffer rewritten every frame, and its view
+// (grows when the data outgrows it)
+// --------------------------------------------------------
+struct DynamicStructuredBuffer
+{
+	Microsoft::WRL::ComPtr<ID3D11Buffer> Buffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
+	unsigned int Capacity;		// elements
+};
+
+// A material texture that's streamed, and the slot it's bound to
+struct StreamedMaterialTexture
+{
+	std::string Slot;			// Albedo, NormalMap, ...
+	unsigned int Texture;		// in the streamer
+};
 
 class Game
 {
@@ -38,6 +75,18 @@ private:
 	void BuildGui();
 	void InitializeCamera();
 	void UpdateObjectTransformations(float deltaTime);
+	void CullShadowCasters();
+	void BenchmarkRenderList(unsigned int entityCount);
+	void BenchmarkShaderSetters(unsigned int count);
+	void BenchmarkPrepareMaterial(unsigned int count);
+	void RebuildRenderList();
+	void RenderReferenceImage();
+	void CreateExtraLights(unsigned int count);
+	void UpdateLightClusters();
+	void SelectShaderVariants(unsigned int frameFeatures);
+	void BuildTextureArrays();
+	void SetTextureArrayMode(bool enabled);
+	void UpdateTextureStreaming();
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -52,10 +101,30 @@ private:
 	std::vector<std::shared_ptr<Material>> materials;
 	std::vector<Light> lights;
 
+	// retained draws for the main pass, and each entity's handle in it
+	std::shared_ptr<RenderList> renderList;
+	std::vector<RenderHandle> entityHandles;
+	RenderListBenchmarkResults renderListBenchmark;
+	unsigned int mainPassDraws;		// records that survived camera culling last frame
+	SimpleShaderUploadStats uploadStats;	// constant buffer uploads last frame
+
+	// static entities merged into chunks for the main pass
+	bool batchStaticGeometry;
+	std::shared_ptr<StaticBatcher> staticBatcher;
+
 	int curCamera;
 	DirectX::XMFLOAT3 ambient;
 	std::shared_ptr<Sky> sky;
 
+	// the sky's baked lighting, which stands in for ambient when it's there
+	D3D11IBLResources ibl;
+	IBLBakeStats iblStats;
+	bool hdrSky;					// the sky came from an .hdr (textures/Skies/sky.hdr), not six faces
+	EnvironmentMapStats skyStats;
+	bool imageLighting;
+	float iblIntensity;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> clampSampler;		// the BRDF table mustn't wrap
+
 	// Shaders and shader-related constructs
 	std::shared_ptr<SimplePixelShader> pixelShader;
 	std::shared_ptr<SimpleVertexShader> vertexShader;
@@ -63,9 +132,29 @@ private:
 	std::shared_ptr<SimplePixelShader> uvPS;
 	std::shared_ptr<SimplePixelShader> pseudoPS;
 
+	// variants of pixelShader, compiled per feature set and cached on disk
+	std::shared_ptr<ShaderVariantCache> shaderVariantCache;
+	std::shared_ptr<PixelShaderVariants> pbrVariants;
+	unsigned int frameShaderFeatures;	// ShaderFeaturesFrame bits the materials were last selected with
+
+	// every material texture, loaded once and shared
+	std::shared_ptr<TextureRegistry> textureRegistry;
+	TextureLoadStats textureLoadStats;		// how startup loading went
+	double startupMs;
+
+	// material textures that start with only their small mips, and
+	// stream finer ones in as they get larger on screen
+	bool streamTextures;
+	std::shared_ptr<D3D11TextureStreamer> textureStreamer;
+	std::unordered_map<Material*, std::vector<StreamedMaterialTexture>> streamedTextures;
+
+	// material textures packed into arrays, one per slot per set,
+	// for the optional texture array mode
+	TextureArrayPlan textureArrayPlan;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureArrays;
+	bool useTextureArrays;
+
 	// shadow mapping
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRasterizer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSampler;
 	DirectX::XMFLOAT4X4 lightViewMatrix;
@@ -74,6 +163,57 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> shadowDepthMap;
 	ShadowOptions shadowOptions;
 	std::shared_ptr<SimpleVertexShader> shadowVS;
+	std::shared_ptr<SimpleVertexShader> shadowClearVS;
+
+	// shadow caster culling
+	bool cullShadowCasters;
+	bool cullShadowReceivers;
+	std::vector<unsigned int> shadowCasters;	// entity indices drawn into the live shadow map this frame
+	std::vector<unsigned int> staticShadowCasters;	// static entities that can land in the cached map
+	std::vector<ProjectedBounds> shadowLightBounds;	// every entity's bounds in light space, this frame
+	ShadowCullStats shadowCullStats;
+	unsigned long long shadowVertexBytes;			// vertex data the shadow passes fetched last frame
+	unsigned long long shadowVertexBytesInterleaved;	// what full vertices would have cost
+
+	// static shadow caching
+	bool cacheStaticShadows;
+	std::shared_ptr<ShadowCache> shadowCache;
+
+	// multithreaded command recording
+	std::shared_ptr<ThreadPool> threadPool;
+	std::shared_ptr<DeferredRenderer> deferredRenderer;
+
+	// the frame's passes, rebuilt every frame, and the textures behind them
+	std::shared_ptr<FrameGraph> frameGraph;
+	std::shared_ptr<D3D11FrameGraphBackend> frameGraphBackend;
+
+	// CPU reference renderer
+	std::shared_ptr<SoftwareRasterizer> softwareRasterizer;
+	SoftwareRasterStats referenceStats;
+	SoftwareImageDiff referenceDiff;
+	bool referenceCompared;		// a golden image was found last time
+
+	// clustered point and spot lights
+	// - directional lights stay in the pixel shader's constant buffer
+	std::shared_ptr<LightClusters> lightClusters;
+	std::vector<Light> extraLights;			// random lights added from the GUI
+	std::vector<Light> directionalLights;	// this frame's, for the constant buffer
+	std::vector<Light> clusteredLights;		// this frame's point and spot lights, as the shader sees them
+	std::vector<ClusterLight> clusterInputs;	// the same lights, as the cluster tests see them
+	DynamicStructuredBuffer clusterLightBuffer;
+	DynamicStructuredBuffer clusterGridBuffer;
+	DynamicStructuredBuffer clusterIndexBuffer;
+	LightClusterBenchmarkResults lightClusterBenchmark;
+
+	// last BenchmarkShaderSetters(), by name vs. by handle
+	unsigned int shaderSetterBenchmarkCount;
+	double shaderSetterNameMs;
+	double shaderSetterHandleMs;
+
+	// last BenchmarkPrepareMaterial(), per draw, unbaked vs. baked
+	unsigned int prepareMaterialBenchmarkCount;
+	double prepareMaterialUnbakedNs;
+	double prepareMaterialBakedNs;
 
 };
 
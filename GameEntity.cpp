@@ -1,12 +1,14 @@
 #include "GameEntity.h"
-#include "Graphics.h"
 #include "BufferStructs.h"
+#include "Culling.h"
+#include "RenderList.h"
 
 GameEntity::GameEntity(std::shared_ptr<Mesh> _m, std::shared_ptr<Material> _material)
 {
     mesh = _m;
     transform = std::make_shared<Transform>();
     this->material = _material;
+    isStatic = false;
 }
 
 GameEntity::~GameEntity()
@@ -18,6 +20,7 @@ GameEntity::GameEntity(GameEntity& ge)
     mesh = ge.mesh;
     transform = ge.transform;
     material = ge.material;
+    isStatic = ge.isStatic;
 }
 
 std::shared_ptr<Mesh> GameEntity::GetMesh()
@@ -35,16 +38,58 @@ std::shared_ptr<Material> GameEntity::GetMaterial()
     return material;
 }
 
+DirectX::BoundingBox GameEntity::GetWorldBounds()
+{
+    return Culling::TransformBounds(mesh->GetBounds(), transform->GetWorldMatrix());
+}
+
+bool GameEntity::IsStatic()
+{
+    return isStatic;
+}
+
 void GameEntity::SetMaterial(std::shared_ptr<Material> _m)
 {
     material = _m;
 }
 
+void GameEntity::SetMesh(std::shared_ptr<Mesh> _m)
+{
+    mesh = _m;
+}
+
+void GameEntity::SetStatic(bool _isStatic)
+{
+    isStatic = _isStatic;
+}
+
 void GameEntity::Draw(DirectX::XMFLOAT4 tint, std::shared_ptr<Camera> cam)
+{
+    Draw(tint, cam, Render::GetDevice()->GetImmediateContext());
+}
+
+void GameEntity::Draw(DirectX::XMFLOAT4 tint, std::shared_ptr<Camera> cam, IRenderContext* context)
 {
     // set up material's shaders and data
+    // (shaders record into whatever context is bound to this thread)
     material->PrepareMaterial(transform, cam);
 
     // draw it
-    mesh->Draw();
+    mesh->Draw(context);
+}
+
+// --------------------------------------------------------
+// Follows the entity's shared_ptrs once, here, instead of
+// every frame
+// --------------------------------------------------------
+void GameEntity::ResolveDrawRecord(DrawRecord& record, GameEntity* entity)
+{
+    std::shared_ptr<Material> material = entity->GetMaterial();
+
+    record.Entity = entity;
+    record.EntityTransform = entity->GetTransform().get();
+    record.EntityMesh = entity->GetMesh().get();
+    record.EntityMaterial = material.get();
+    record.VertexShader = material->GetVertexShader().get();
+    record.PixelShader = material->GetPixelShader().get();
 }
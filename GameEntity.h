@@ -5,6 +5,8 @@
 #include "Camera.h"
 #include "Material.h"
 
+struct DrawRecord;
+
 class GameEntity
 {
 public:
@@ -17,14 +19,23 @@ public:
 	std::shared_ptr<Mesh> GetMesh();
 	std::shared_ptr<Transform> GetTransform();
 	std::shared_ptr<Material> GetMaterial();  
+	DirectX::BoundingBox GetWorldBounds();
+	bool IsStatic();
 
 	void SetMaterial(std::shared_ptr<Material> _m);
+	void SetMesh(std::shared_ptr<Mesh> _m);
+	void SetStatic(bool _isStatic);	// static entities are drawn into the cached shadow map
 
 	void Draw(DirectX::XMFLOAT4 tint, std::shared_ptr<Camera> cam);
+	void Draw(DirectX::XMFLOAT4 tint, std::shared_ptr<Camera> cam, IRenderContext* context);
+
+	// Fills in a RenderList record from the entity (the list's resolver)
+	static void ResolveDrawRecord(DrawRecord& record, GameEntity* entity);
 private:
 
 	std::shared_ptr<Transform> transform;
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
+	bool isStatic;
 };
 
@@ -125,6 +125,10 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 	// We're set up
 	apiInitialized = true;
 
+	// Anything written against the render interface goes through D3D11 from here on
+	Renderer = std::make_unique<D3D11RenderDevice>(Device, Context);
+	Render::SetDevice(Renderer.get());
+
 	// Call ResizeBuffers(), which will also set up the 
 	// render target view and depth stencil view for the
 	// various buffers we need for rendering. This call 
@@ -152,6 +156,8 @@ HRESULT Graphics::Initialize(unsigned int windowWidth, unsigned int windowHeight
 // --------------------------------------------------------
 void Graphics::ShutDown()
 {
+	Render::SetDevice(0);
+	Renderer.reset();
 }
 
 
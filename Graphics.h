@@ -4,6 +4,9 @@
 #include <d3d11.h>
 #include <string>
 #include <wrl/client.h>
+#include <memory>
+
+#include "D3D11RenderBackend.h"
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
@@ -21,6 +24,9 @@ namespace Graphics
 	inline Microsoft::WRL::ComPtr<ID3D11RenderTargetView> BackBufferRTV;
 	inline Microsoft::WRL::ComPtr<ID3D11DepthStencilView> DepthBufferDSV;
 
+	// Backend-neutral wrapper around Device/Context (see RenderInterface.h)
+	inline std::unique_ptr<D3D11RenderDevice> Renderer;
+
 	// --- FUNCTIONS ---
 
 	// Getters
@@ -0,0 +1,183 @@
+#include "HdrDecoder.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <emmintrin.h>
+
+namespace
+{
+	// The next header line (without its newline), false at the end of the data
+	bool ReadLine(const unsigned char*& p, const unsigned char* end, std::string& line)
+	{
+		const unsigned char* newline = (const unsigned char*)memchr(p, '\n', end - p);
+		if (!newline) return false;
+		line.assign((const char*)p, newline - p);
+		p = newline + 1;
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// One scanline as RGBE bytes: per channel run length
+	// encoded if it starts 2, 2 and the width, otherwise flat
+	// pixels with the old (1, 1, 1, count) repeats
+	// --------------------------------------------------------
+	bool ReadScanline(const unsigned char*& p, const unsigned char* end, unsigned int width, unsigned char* rgbe)
+	{
+		if (width >= 8 && width < 32768 && end - p >= 4 && p[0] == 2 && p[1] == 2 && !(p[2] & 0x80)) {
+			if ((unsigned int)((p[2] << 8) | p[3]) != width) return false;
+			p += 4;
+			for (unsigned int c = 0; c < 4; c++) {
+				unsigned int x = 0;
+				while (x < width) {
+					if (p >= end) return false;
+					unsigned int count = *p++;
+					if (count > 128) {
+						count -= 128;
+						if (p >= end || x + count > width) return false;
+						unsigned char value = *p++;
+						for (unsigned int i = 0; i < count; i++) rgbe[(x + i) * 4 + c] = value;
+					}
+					else {
+						if (count == 0 || x + count > width || (size_t)(end - p) < count) return false;
+						for (unsigned int i = 0; i < count; i++) rgbe[(x + i) * 4 + c] = p[i];
+						p += count;
+					}
+					x += count;
+				}
+			}
+			return true;
+		}
+
+		unsigned int x = 0, shift = 0;
+		while (x < width) {
+			if (end - p < 4) return false;
+			if (p[0] == 1 && p[1] == 1 && p[2] == 1) {
+				// repeat the last pixel, counts of consecutive repeats stacking up a byte at a time
+				if (x == 0 || shift > 16) return false;
+				unsigned int count = (unsigned int)p[3] << shift;
+				if (x + count > width) return false;
+				for (unsigned int i = 0; i < count; i++, x++) memcpy(rgbe + x * 4, rgbe + (x - 1) * 4, 4);
+				shift += 8;
+			}
+			else {
+				memcpy(rgbe + x * 4, p, 4);
+				x++;
+				shift = 0;
+			}
+			p += 4;
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// RGBE to float RGBA: mantissa * 2^(exponent - 136), an
+	// exponent of 0 being black (anything under 2^-126 is too)
+	// --------------------------------------------------------
+	void ConvertScanline(const unsigned char* rgbe, unsigned int width, float* rgba)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i alphaMask = _mm_setr_epi32(0, 0, 0, -1);
+		const __m128 one = _mm_set1_ps(1.0f);
+		auto convert = [&](__m128i pixel, float* out) {
+			__m128i exponent = _mm_shuffle_epi32(pixel, _MM_SHUFFLE(3, 3, 3, 3));
+			__m128i bits = _mm_slli_epi32(_mm_sub_epi32(exponent, _mm_set1_epi32(9)), 23);
+			__m128 scale = _mm_castsi128_ps(_mm_and_si128(bits, _mm_cmpgt_epi32(exponent, _mm_set1_epi32(9))));
+			__m128 color = _mm_mul_ps(_mm_cvtepi32_ps(pixel), scale);
+			color = _mm_or_ps(_mm_andnot_ps(_mm_castsi128_ps(alphaMask), color), _mm_and_ps(_mm_castsi128_ps(alphaMask), one));
+			_mm_storeu_ps(out, color);
+		};
+
+		unsigned int x = 0;
+		for (; x + 4 <= width; x += 4) {
+			__m128i bytes = _mm_loadu_si128((const __m128i*)(rgbe + x * 4));
+			__m128i low = _mm_unpacklo_epi8(bytes, zero), high = _mm_unpackhi_epi8(bytes, zero);
+			convert(_mm_unpacklo_epi16(low, zero), rgba + (size_t)x * 4);
+			convert(_mm_unpackhi_epi16(low, zero), rgba + (size_t)x * 4 + 4);
+			convert(_mm_unpacklo_epi16(high, zero), rgba + (size_t)x * 4 + 8);
+			convert(_mm_unpackhi_epi16(high, zero), rgba + (size_t)x * 4 + 12);
+		}
+		for (; x < width; x++) {
+			const unsigned char* p = rgbe + x * 4;
+			convert(_mm_setr_epi32(p[0], p[1], p[2], p[3]), rgba + (size_t)x * 4);
+		}
+	}
+}
+
+
+bool HdrDecoder::DecodeFile(const std::string& path, HdrImage& image, std::string& error)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		error = "couldn't open " + path;
+		return false;
+	}
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Decode(data.data(), data.size(), image, error);
+}
+
+bool HdrDecoder::IsHdr(const unsigned char* data, size_t size)
+{
+	return (size >= 10 && memcmp(data, "#?RADIANCE", 10) == 0) || (size >= 6 && memcmp(data, "#?RGBE", 6) == 0);
+}
+
+bool HdrDecoder::Decode(const unsigned char* data, size_t size, HdrImage& image, std::string& error)
+{
+	if (!IsHdr(data, size)) {
+		error = "not a Radiance HDR";
+		return false;
+	}
+
+	// the header: variables, one per line, up to an empty line
+	const unsigned char* p = data;
+	const unsigned char* end = data + size;
+	std::string line;
+	ReadLine(p, end, line);
+	for (;;) {
+		if (!ReadLine(p, end, line)) {
+			error = "truncated header";
+			return false;
+		}
+		if (line.empty()) break;
+		if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe") {
+			error = "unsupported format " + line.substr(7);
+			return false;
+		}
+	}
+
+	// then the resolution, rows first
+	std::string rows, columns;
+	int height = 0, width = 0;
+	if (!ReadLine(p, end, line) || !(std::istringstream(line) >> rows >> height >> columns >> width)) {
+		error = "no resolution";
+		return false;
+	}
+	bool flipped = rows == "+Y";
+	if ((!flipped && rows != "-Y") || columns != "+X") {
+		error = "unsupported orientation " + line;
+		return false;
+	}
+	if (width <= 0 || height <= 0 || width > 32768 || height > 32768) {
+		error = "bad size";
+		return false;
+	}
+
+	image = {};
+	image.Width = (unsigned int)width;
+	image.Height = (unsigned int)height;
+	image.Pixels.resize((size_t)width * height * 4);
+
+	std::vector<unsigned char> rgbe((size_t)width * 4);
+	for (unsigned int y = 0; y < image.Height; y++) {
+		if (!ReadScanline(p, end, image.Width, rgbe.data())) {
+			error = "bad or truncated scanline " + std::to_string(y);
+			image = {};
+			return false;
+		}
+		unsigned int row = flipped ? image.Height - 1 - y : y;
+		ConvertScanline(rgbe.data(), image.Width, &image.Pixels[(size_t)row * width * 4]);
+	}
+	return true;
+}
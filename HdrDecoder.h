@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// A high dynamic range image, linear floats, rows top to bottom
+// --------------------------------------------------------
+struct HdrImage
+{
+	unsigned int Width;
+	unsigned int Height;
+	std::vector<float> Pixels;		// Width * Height * 4 floats (RGBA, alpha always 1)
+};
+
+// --------------------------------------------------------
+// A Radiance (.hdr, RGBE) decoder, for environment maps
+// brighter than 8 bits can hold
+//
+// - Handles flat, old style run length and the usual
+//   per channel run length encoded scanlines
+// - Only the standard -Y h +X w orientation (and +Y, upside
+//   down) of 32-bit_rle_rgbe; XYZE images fail with an error
+// - Shared exponents become floats four channels at a time
+//   with SSE2
+// - Only depends on the standard library
+// --------------------------------------------------------
+class HdrDecoder
+{
+public:
+	/// <summary>
+	/// Decodes a whole .hdr file already in memory
+	/// </summary>
+	/// <returns>false (with the reason in error) if it couldn't be decoded</returns>
+	static bool Decode(const unsigned char* data, size_t size, HdrImage& image, std::string& error);
+	static bool DecodeFile(const std::string& path, HdrImage& image, std::string& error);
+
+	/// <summary>
+	/// Whether data starts with a Radiance signature (#?RADIANCE or #?RGBE)
+	/// </summary>
+	static bool IsHdr(const unsigned char* data, size_t size);
+};
@@ -0,0 +1,713 @@
+#include "IBLBaker.h"
+#include "ContentHash.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <emmintrin.h>
+
+namespace
+{
+	const float Pi = 3.14159265358979f;
+	const unsigned int CacheMagic = 0x314c4249;		// "IBL1"
+	const unsigned int CacheVersion = 1;				// bump when the bake itself changes
+
+	// Splits rows into blocks, across the pool if there is one
+	void ForRows(ThreadPool* pool, unsigned int rows, const std::function<void(unsigned int, unsigned int)>& body)
+	{
+		const unsigned int block = 16;
+		unsigned int blocks = (rows + block - 1) / block;
+		auto job = [&](unsigned int b) { body(b * block, std::min(rows, (b + 1) * block)); };
+		if (pool && blocks > 1) pool->ParallelFor(blocks, job);
+		else for (unsigned int b = 0; b < blocks; b++) job(b);
+	}
+
+	unsigned int FloorPowerOfTwo(unsigned int value)
+	{
+		unsigned int p = 1;
+		while (p * 2 <= value) p *= 2;
+		return p;
+	}
+
+	// --------------------------------------------------------
+	// Cube map addressing, D3D's conventions: u and v in
+	// [-1, 1] across each face, v down
+	// --------------------------------------------------------
+	void FaceDirection(unsigned int face, float u, float v, float dir[3])
+	{
+		switch (face) {
+		case 0: dir[0] = 1; dir[1] = -v; dir[2] = -u; break;
+		case 1: dir[0] = -1; dir[1] = -v; dir[2] = u; break;
+		case 2: dir[0] = u; dir[1] = 1; dir[2] = v; break;
+		case 3: dir[0] = u; dir[1] = -1; dir[2] = -v; break;
+		case 4: dir[0] = u; dir[1] = -v; dir[2] = 1; break;
+		default: dir[0] = -u; dir[1] = -v; dir[2] = -1; break;
+		}
+		float length = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+		for (int i = 0; i < 3; i++) dir[i] /= length;
+	}
+
+	// The face a direction hits, and where on it (s and t in [0, 1])
+	unsigned int FaceLookup(const float dir[3], float& s, float& t)
+	{
+		float ax = fabsf(dir[0]), ay = fabsf(dir[1]), az = fabsf(dir[2]);
+		unsigned int face;
+		float major, sc, tc;
+		if (ax >= ay && ax >= az) {
+			face = dir[0] > 0 ? 0 : 1;
+			major = ax;
+			sc = dir[0] > 0 ? -dir[2] : dir[2];
+			tc = -dir[1];
+		}
+		else if (ay >= az) {
+			face = dir[1] > 0 ? 2 : 3;
+			major = ay;
+			sc = dir[0];
+			tc = dir[1] > 0 ? dir[2] : -dir[2];
+		}
+		else {
+			face = dir[2] > 0 ? 4 : 5;
+			major = az;
+			sc = dir[2] > 0 ? dir[0] : -dir[0];
+			tc = -dir[1];
+		}
+		s = (sc / major + 1) * 0.5f;
+		t = (tc / major + 1) * 0.5f;
+		return face;
+	}
+
+	// --------------------------------------------------------
+	// The sky in linear floats, with a mip chain of its own
+	// (each face filtered on its own, so seams aren't blended)
+	// --------------------------------------------------------
+	struct SourceCube
+	{
+		unsigned int Size;
+		std::vector<std::vector<float>> Levels;		// 6 faces of Size >> level squared RGBA, one after another
+
+		unsigned int GetSize(unsigned int level) const { return std::max(1u, Size >> level); }
+		const float* GetFace(unsigned int level, unsigned int face) const
+		{
+			size_t size = GetSize(level);
+			return Levels[level].data() + face * size * size * 4;
+		}
+	};
+
+	// texel(face, x, y) reads one face texel as linear RGBA
+	template <typename Texel>
+	SourceCube BuildSource(unsigned int faceSize, unsigned int size, ThreadPool* pool, const Texel& texel)
+	{
+		SourceCube cube;
+		cube.Size = size;
+		cube.Levels.emplace_back((size_t)6 * size * size * 4);
+
+		// each output texel averages the block of face texels under it
+		ForRows(pool, 6 * size, [&](unsigned int first, unsigned int end) {
+			for (unsigned int row = first; row < end; row++) {
+				unsigned int face = row / size, y = row % size;
+				unsigned int y0 = y * faceSize / size, y1 = std::max(y0 + 1, (y + 1) * faceSize / size);
+				float* dst = &cube.Levels[0][((size_t)face * size * size + (size_t)y * size) * 4];
+				for (unsigned int x = 0; x < size; x++) {
+					unsigned int x0 = x * faceSize / size, x1 = std::max(x0 + 1, (x + 1) * faceSize / size);
+					__m128 sum = _mm_setzero_ps();
+					for (unsigned int sy = y0; sy < y1; sy++)
+						for (unsigned int sx = x0; sx < x1; sx++)
+							sum = _mm_add_ps(sum, texel(face, sx, sy));
+					_mm_storeu_ps(dst + (size_t)x * 4, _mm_mul_ps(sum, _mm_set1_ps(1.0f / ((x1 - x0) * (y1 - y0)))));
+				}
+			}
+		});
+
+		// then 2x2 boxes down to 1x1
+		for (unsigned int level = 1; cube.GetSize(level - 1) > 1; level++) {
+			unsigned int above = cube.GetSize(level - 1), below = cube.GetSize(level);
+			cube.Levels.emplace_back((size_t)6 * below * below * 4);
+			for (unsigned int face = 0; face < 6; face++) {
+				const float* src = cube.GetFace(level - 1, face);
+				float* dst = cube.Levels[level].data() + (size_t)face * below * below * 4;
+				for (unsigned int y = 0; y < below; y++)
+					for (unsigned int x = 0; x < below; x++) {
+						const float* a = src + ((size_t)(y * 2) * above + x * 2) * 4;
+						const float* b = a + (size_t)above * 4;
+						__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(a + 4)), _mm_add_ps(_mm_loadu_ps(b), _mm_loadu_ps(b + 4)));
+						_mm_storeu_ps(dst + ((size_t)y * below + x) * 4, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+					}
+			}
+		}
+		return cube;
+	}
+
+	// Bilinear, clamped to the face's edges
+	__m128 SampleFace(const float* face, unsigned int size, float s, float t)
+	{
+		float fx = std::clamp(s * size - 0.5f, 0.0f, size - 1.0f);
+		float fy = std::clamp(t * size - 0.5f, 0.0f, size - 1.0f);
+		unsigned int x0 = (unsigned int)fx, y0 = (unsigned int)fy;
+		unsigned int x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+		__m128 wx = _mm_set1_ps(fx - x0), wy = _mm_set1_ps(fy - y0);
+
+		__m128 a = _mm_loadu_ps(face + ((size_t)y0 * size + x0) * 4);
+		__m128 b = _mm_loadu_ps(face + ((size_t)y0 * size + x1) * 4);
+		__m128 c = _mm_loadu_ps(face + ((size_t)y1 * size + x0) * 4);
+		__m128 d = _mm_loadu_ps(face + ((size_t)y1 * size + x1) * 4);
+		__m128 top = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), wx));
+		__m128 bottom = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), wx));
+		return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), wy));
+	}
+
+	// Trilinear between the two levels around lod
+	__m128 SampleCube(const SourceCube& cube, const float dir[3], float lod)
+	{
+		float s, t;
+		unsigned int face = FaceLookup(dir, s, t);
+		lod = std::clamp(lod, 0.0f, (float)(cube.Levels.size() - 1));
+		unsigned int level = (unsigned int)lod;
+		__m128 fine = SampleFace(cube.GetFace(level, face), cube.GetSize(level), s, t);
+		if (level + 1 >= cube.Levels.size() || lod == level) return fine;
+		__m128 coarse = SampleFace(cube.GetFace(level + 1, face), cube.GetSize(level + 1), s, t);
+		return _mm_add_ps(fine, _mm_mul_ps(_mm_sub_ps(coarse, fine), _mm_set1_ps(lod - level)));
+	}
+
+	// --------------------------------------------------------
+	// GGX importance sampling
+	// --------------------------------------------------------
+	void Hammersley(unsigned int i, unsigned int count, float& x, float& y)
+	{
+		uint32_t bits = i;
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+		bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+		bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+		bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+		x = (float)i / count;
+		y = bits * 2.3283064365386963e-10f;
+	}
+
+	// A half vector around +Z, for alpha = roughness squared (as the shader's D_GGX has it)
+	void SampleGGX(float x, float y, float alpha, float h[3])
+	{
+		float phi = 2 * Pi * x;
+		float cosTheta = sqrtf((1 - y) / (1 + (alpha * alpha - 1) * y));
+		float sinTheta = sqrtf(1 - cosTheta * cosTheta);
+		h[0] = sinTheta * cosf(phi);
+		h[1] = sinTheta * sinf(phi);
+		h[2] = cosTheta;
+	}
+
+	// One prefiltering sample, around +Z with N = V = R
+	struct SpecularSample
+	{
+		float L[3];
+		float Weight;		// N.L
+		float Lod;			// source level matching the sample's solid angle
+	};
+
+	std::vector<SpecularSample> GetSpecularSamples(float roughness, unsigned int count, unsigned int sourceSize)
+	{
+		float alpha = std::max(roughness * roughness, 1e-4f);
+		float texelSolidAngle = 4 * Pi / (6.0f * sourceSize * sourceSize);
+
+		std::vector<SpecularSample> samples;
+		for (unsigned int i = 0; i < count; i++) {
+			float x, y, h[3];
+			Hammersley(i, count, x, y);
+			SampleGGX(x, y, alpha, h);
+
+			SpecularSample s = {};
+			s.L[0] = 2 * h[2] * h[0];
+			s.L[1] = 2 * h[2] * h[1];
+			s.L[2] = 2 * h[2] * h[2] - 1;
+			s.Weight = s.L[2];
+			if (s.Weight <= 0) continue;
+
+			// pdf of L is D * N.H / (4 V.H), and N.H = V.H here
+			float denominator = h[2] * h[2] * (alpha * alpha - 1) + 1;
+			float pdf = alpha * alpha / (Pi * denominator * denominator) / 4;
+			float sampleSolidAngle = 1.0f / (count * pdf + 1e-6f);
+			s.Lod = std::max(0.0f, 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1);
+			samples.push_back(s);
+		}
+		return samples;
+	}
+
+	// --------------------------------------------------------
+	// Cache files
+	// --------------------------------------------------------
+	template<typename T> void Write(std::ofstream& out, const T& value) { out.write((const char*)&value, sizeof(T)); }
+	template<typename T> bool Read(std::ifstream& in, T& value) { return (bool)in.read((char*)&value, sizeof(T)); }
+
+	void WriteArray(std::ofstream& out, const std::vector<unsigned short>& values)
+	{
+		Write(out, (unsigned int)values.size());
+		out.write((const char*)values.data(), values.size() * sizeof(unsigned short));
+	}
+
+	bool ReadArray(std::ifstream& in, std::vector<unsigned short>& values, size_t expected)
+	{
+		unsigned int count = 0;
+		if (!Read(in, count) || count != expected) return false;
+		values.resize(count);
+		return (bool)in.read((char*)values.data(), count * sizeof(unsigned short));
+	}
+}
+
+
+// --------------------------------------------------------
+// Options and keys
+// --------------------------------------------------------
+IBLOptions IBLBaker::Resolve(const IBLOptions& options)
+{
+	IBLOptions o = options;
+	o.SourceSize = FloorPowerOfTwo(o.SourceSize ? o.SourceSize : 256);
+	o.SpecularSize = FloorPowerOfTwo(o.SpecularSize ? o.SpecularSize : 128);
+	o.SpecularLevels = o.SpecularLevels ? o.SpecularLevels : 6;
+	o.SpecularSamples = o.SpecularSamples ? o.SpecularSamples : 128;
+	o.LUTSize = o.LUTSize ? o.LUTSize : 128;
+	o.LUTSamples = o.LUTSamples ? o.LUTSamples : 512;
+
+	// no level smaller than 1x1, and at least two so roughness has a range
+	unsigned int levels = 1;
+	while ((o.SpecularSize >> levels) > 0) levels++;
+	o.SpecularLevels = std::clamp(o.SpecularLevels, 2u, std::max(2u, levels));
+	o.SpecularSize = std::max(o.SpecularSize, 1u << (o.SpecularLevels - 1));
+	return o;
+}
+
+unsigned long long IBLBaker::GetKey(const DecodedImage* faces, const IBLOptions& options)
+{
+	IBLOptions o = Resolve(options);
+	unsigned long long key = ContentHash::Hash64(&CacheVersion, sizeof(CacheVersion));
+	key = ContentHash::Hash64(&o, sizeof(o), key);
+	for (unsigned int face = 0; face < 6; face++) {
+		unsigned int size[2] = { faces[face].Width, faces[face].Height };
+		key = ContentHash::Hash64(size, sizeof(size), key);
+		key = ContentHash::Hash64(faces[face].Pixels.data(), faces[face].Pixels.size(), key);
+	}
+	return key;
+}
+
+unsigned long long IBLBaker::GetKey(const float* faces, unsigned int faceSize, const IBLOptions& options)
+{
+	IBLOptions o = Resolve(options);
+	unsigned long long key = ContentHash::Hash64(&CacheVersion, sizeof(CacheVersion));
+	key = ContentHash::Hash64(&o, sizeof(o), key);
+	key = ContentHash::Hash64(&faceSize, sizeof(faceSize), key);
+	return ContentHash::Hash64(faces, (size_t)6 * faceSize * faceSize * 4 * sizeof(float), key);
+}
+
+
+// --------------------------------------------------------
+// Baking
+// --------------------------------------------------------
+namespace
+{
+	// --------------------------------------------------------
+	// Everything after the source cube: irradiance, specular
+	// levels and the BRDF table, into data (whose options are set)
+	// --------------------------------------------------------
+	void BakeFromSource(const SourceCube& source, IBLData& data, ThreadPool* pool, IBLBakeStats& stats)
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+		auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+		const IBLOptions& o = data.Options;
+
+		// irradiance: every source texel projected onto the basis,
+		// weighted by its solid angle, a partial sum per row block
+		Clock::time_point step = Clock::now();
+		{
+			unsigned int size = o.SourceSize;
+			unsigned int rows = 6 * size;
+			std::vector<float> partials((size_t)((rows + 15) / 16) * 10 * 4);
+			ForRows(pool, rows, [&](unsigned int first, unsigned int end) {
+				__m128 sum[10] = {};
+				for (unsigned int row = first; row < end; row++) {
+					unsigned int face = row / size, y = row % size;
+					const float* texels = source.GetFace(0, face) + (size_t)y * size * 4;
+					float v = 2 * (y + 0.5f) / size - 1;
+					for (unsigned int x = 0; x < size; x++) {
+						float u = 2 * (x + 0.5f) / size - 1;
+						float n[3];
+						FaceDirection(face, u, v, n);
+						float d = 1 + u * u + v * v;
+						float solidAngle = 4.0f / (size * size * d * sqrtf(d));
+
+						float basis[9] = {
+							0.282095f,
+							0.488603f * n[1], 0.488603f * n[2], 0.488603f * n[0],
+							1.092548f * n[0] * n[1], 1.092548f * n[1] * n[2], 0.315392f * (3 * n[2] * n[2] - 1),
+							1.092548f * n[0] * n[2], 0.546274f * (n[0] * n[0] - n[1] * n[1])
+						};
+						__m128 color = _mm_loadu_ps(texels + (size_t)x * 4);
+						for (int i = 0; i < 9; i++)
+							sum[i] = _mm_add_ps(sum[i], _mm_mul_ps(color, _mm_set1_ps(basis[i] * solidAngle)));
+						sum[9] = _mm_add_ps(sum[9], _mm_set1_ps(solidAngle));
+					}
+				}
+				for (int i = 0; i < 10; i++) _mm_storeu_ps(&partials[((size_t)(first / 16) * 10 + i) * 4], sum[i]);
+			});
+
+			__m128 total[10] = {};
+			for (size_t b = 0; b < partials.size(); b += 40)
+				for (int i = 0; i < 10; i++) total[i] = _mm_add_ps(total[i], _mm_loadu_ps(&partials[b + i * 4]));
+
+			// the solid angles should add up to 4 pi, and the cosine
+			// lobe's convolution (pi, 2 pi / 3, pi / 4 per band) over pi
+			float weights[4];
+			_mm_storeu_ps(weights, total[9]);
+			float normalize = 4 * Pi / weights[0];
+			static const float band[9] = { 1.0f, 2.0f / 3, 2.0f / 3, 2.0f / 3, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+			for (int i = 0; i < 9; i++) {
+				_mm_storeu_ps(data.Irradiance[i], _mm_mul_ps(total[i], _mm_set1_ps(normalize * band[i])));
+				data.Irradiance[i][3] = 0;
+			}
+		}
+		stats.IrradianceMs = ms(step, Clock::now());
+
+		// specular: level 0 is the sky itself at the cube's size,
+		// the rest GGX prefiltered around each texel's direction
+		step = Clock::now();
+		data.Specular.resize(o.SpecularLevels);
+		for (unsigned int level = 0; level < o.SpecularLevels; level++) {
+			unsigned int size = std::max(1u, o.SpecularSize >> level);
+			float roughness = (float)level / (o.SpecularLevels - 1);
+			std::vector<SpecularSample> samples;
+			if (level > 0) samples = GetSpecularSamples(roughness, o.SpecularSamples, o.SourceSize);
+			float mirrorLod = log2f((float)o.SourceSize / o.SpecularSize);
+
+			std::vector<unsigned short>& out = data.Specular[level];
+			out.resize((size_t)6 * size * size * 4);
+			ForRows(pool, 6 * size, [&](unsigned int first, unsigned int end) {
+				for (unsigned int row = first; row < end; row++) {
+					unsigned int face = row / size, y = row % size;
+					float v = 2 * (y + 0.5f) / size - 1;
+					for (unsigned int x = 0; x < size; x++) {
+						float n[3];
+						FaceDirection(face, 2 * (x + 0.5f) / size - 1, v, n);
+
+						__m128 color;
+						if (samples.empty())
+							color = SampleCube(source, n, mirrorLod);
+						else {
+							// tangent frame around the normal
+							float up[3] = { 0, 0, 1 };
+							if (fabsf(n[2]) > 0.999f) { up[0] = 1; up[2] = 0; }
+							float t[3] = { up[1] * n[2] - up[2] * n[1], up[2] * n[0] - up[0] * n[2], up[0] * n[1] - up[1] * n[0] };
+							float length = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+							for (int i = 0; i < 3; i++) t[i] /= length;
+							float b[3] = { n[1] * t[2] - n[2] * t[1], n[2] * t[0] - n[0] * t[2], n[0] * t[1] - n[1] * t[0] };
+
+							__m128 sum = _mm_setzero_ps();
+							float weight = 0;
+							for (auto& s : samples) {
+								float l[3];
+								for (int i = 0; i < 3; i++) l[i] = t[i] * s.L[0] + b[i] * s.L[1] + n[i] * s.L[2];
+								sum = _mm_add_ps(sum, _mm_mul_ps(SampleCube(source, l, s.Lod), _mm_set1_ps(s.Weight)));
+								weight += s.Weight;
+							}
+							color = _mm_mul_ps(sum, _mm_set1_ps(weight > 0 ? 1.0f / weight : 0.0f));
+						}
+
+						float rgba[4];
+						_mm_storeu_ps(rgba, color);
+						unsigned short* dst = &out[(((size_t)face * size + y) * size + x) * 4];
+						for (int i = 0; i < 3; i++) dst[i] = IBLBaker::FloatToHalf(rgba[i]);
+						dst[3] = IBLBaker::FloatToHalf(1.0f);
+					}
+				}
+			});
+		}
+		stats.SpecularMs = ms(step, Clock::now());
+
+		// the split sum's BRDF half, per N.V and roughness (k = alpha / 2 for image lighting)
+		step = Clock::now();
+		data.BRDF.resize((size_t)o.LUTSize * o.LUTSize * 2);
+		ForRows(pool, o.LUTSize, [&](unsigned int first, unsigned int end) {
+			for (unsigned int y = first; y < end; y++) {
+				float roughness = (y + 0.5f) / o.LUTSize;
+				float alpha = roughness * roughness;
+				float k = alpha / 2;
+				for (unsigned int x = 0; x < o.LUTSize; x++) {
+					float NdotV = (x + 0.5f) / o.LUTSize;
+					float view[3] = { sqrtf(1 - NdotV * NdotV), 0, NdotV };
+					float scale = 0, bias = 0;
+					for (unsigned int i = 0; i < o.LUTSamples; i++) {
+						float u, w, h[3];
+						Hammersley(i, o.LUTSamples, u, w);
+						SampleGGX(u, w, alpha, h);
+						float VdotH = view[0] * h[0] + view[2] * h[2];
+						float NdotL = 2 * VdotH * h[2] - view[2];
+						if (NdotL <= 0 || VdotH <= 0) continue;
+
+						float G = NdotL / (NdotL * (1 - k) + k) * NdotV / (NdotV * (1 - k) + k);
+						float visibility = G * VdotH / (h[2] * NdotV);
+						float fresnel = powf(1 - VdotH, 5);
+						scale += (1 - fresnel) * visibility;
+						bias += fresnel * visibility;
+					}
+					data.BRDF[((size_t)y * o.LUTSize + x) * 2 + 0] = IBLBaker::FloatToHalf(scale / o.LUTSamples);
+					data.BRDF[((size_t)y * o.LUTSize + x) * 2 + 1] = IBLBaker::FloatToHalf(bias / o.LUTSamples);
+				}
+			}
+		});
+		stats.BRDFMs = ms(step, Clock::now());
+	}
+}
+
+bool IBLBaker::Bake(const DecodedImage* faces, const IBLOptions& options, ThreadPool* pool, IBLData& data, IBLBakeStats& stats, std::string& error)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+	Clock::time_point start = Clock::now();
+
+	for (unsigned int face = 0; face < 6; face++) {
+		const DecodedImage& f = faces[face];
+		if (f.Width == 0 || f.Width != f.Height || f.Width != faces[0].Width || f.Pixels.size() != (size_t)f.Width * f.Height * 4) {
+			error = "sky faces have to be square, all the same size";
+			return false;
+		}
+	}
+
+	data = {};
+	data.Options = Resolve(options);
+	data.Options.SourceSize = std::min(data.Options.SourceSize, FloorPowerOfTwo(faces[0].Width));
+
+	// the faces, linear and small (the same curve the pixel shader undoes albedo with)
+	Clock::time_point step = Clock::now();
+	float gamma[256];
+	for (unsigned int i = 0; i < 256; i++) gamma[i] = powf(i / 255.0f, 2.2f);
+	unsigned int faceSize = faces[0].Width;
+	SourceCube source = BuildSource(faceSize, data.Options.SourceSize, pool, [&](unsigned int face, unsigned int x, unsigned int y) {
+		const unsigned char* p = &faces[face].Pixels[((size_t)y * faceSize + x) * 4];
+		return _mm_setr_ps(gamma[p[0]], gamma[p[1]], gamma[p[2]], p[3] / 255.0f);
+	});
+	stats.SourceMs = ms(step, Clock::now());
+
+	BakeFromSource(source, data, pool, stats);
+	stats.TotalMs = ms(start, Clock::now());
+	return true;
+}
+
+bool IBLBaker::Bake(const float* faces, unsigned int faceSize, const IBLOptions& options, ThreadPool* pool, IBLData& data, IBLBakeStats& stats, std::string& error)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+	Clock::time_point start = Clock::now();
+
+	if (!faces || faceSize == 0) {
+		error = "no sky faces to bake";
+		return false;
+	}
+
+	data = {};
+	data.Options = Resolve(options);
+	data.Options.SourceSize = std::min(data.Options.SourceSize, FloorPowerOfTwo(faceSize));
+
+	// already linear, only made small
+	Clock::time_point step = Clock::now();
+	SourceCube source = BuildSource(faceSize, data.Options.SourceSize, pool, [&](unsigned int face, unsigned int x, unsigned int y) {
+		return _mm_loadu_ps(faces + (((size_t)face * faceSize + y) * faceSize + x) * 4);
+	});
+	stats.SourceMs = ms(step, Clock::now());
+
+	BakeFromSource(source, data, pool, stats);
+	stats.TotalMs = ms(start, Clock::now());
+	return true;
+}
+
+namespace
+{
+	// The cached bake for getKey()'s key if there is one, otherwise bake() and cache what it made
+	bool LoadOrBakeWith(const std::function<unsigned long long()>& getKey, const std::string& cacheDirectory, IBLData& data, IBLBakeStats& stats,
+		const std::function<bool(IBLBakeStats&)>& bake)
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+		auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+		Clock::time_point start = Clock::now();
+		stats = {};
+
+		unsigned long long key = getKey();
+		std::string path = IBLBaker::GetCachePath(cacheDirectory, key);
+		Clock::time_point step = Clock::now();
+		stats.HashMs = ms(start, step);
+
+		std::string ignored;
+		stats.FromCache = IBLBaker::Load(path, key, data, ignored);
+		stats.LoadMs = ms(step, Clock::now());
+		if (!stats.FromCache) {
+			if (!bake(stats)) return false;
+			data.Key = key;
+
+			// not being able to cache it only means baking again next time
+			step = Clock::now();
+			std::error_code ec;
+			std::filesystem::create_directories(cacheDirectory, ec);
+			IBLBaker::Save(path, data, ignored);
+			stats.SaveMs = ms(step, Clock::now());
+		}
+		stats.TotalMs = ms(start, Clock::now());
+		return true;
+	}
+}
+
+bool IBLBaker::LoadOrBake(const DecodedImage* faces, const IBLOptions& options, const std::string& cacheDirectory, ThreadPool* pool,
+	IBLData& data, IBLBakeStats& stats, std::string& error)
+{
+	return LoadOrBakeWith([&] { return GetKey(faces, options); }, cacheDirectory, data, stats,
+		[&](IBLBakeStats& s) { return Bake(faces, options, pool, data, s, error); });
+}
+
+bool IBLBaker::LoadOrBake(const float* faces, unsigned int faceSize, const IBLOptions& options, const std::string& cacheDirectory, ThreadPool* pool,
+	IBLData& data, IBLBakeStats& stats, std::string& error)
+{
+	return LoadOrBakeWith([&] { return GetKey(faces, faceSize, options); }, cacheDirectory, data, stats,
+		[&](IBLBakeStats& s) { return Bake(faces, faceSize, options, pool, data, s, error); });
+}
+
+
+// --------------------------------------------------------
+// The cache
+//
+// magic, version, key, options, irradiance, then each
+// specular level and the BRDF table as a count of halves
+// followed by the halves
+// --------------------------------------------------------
+std::string IBLBaker::GetCachePath(const std::string& cacheDirectory, unsigned long long key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.ibl", key);
+	return (std::filesystem::path(cacheDirectory) / name).string();
+}
+
+bool IBLBaker::Save(const std::string& path, const IBLData& data, std::string& error)
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		error = "couldn't write " + path;
+		return false;
+	}
+	Write(out, CacheMagic);
+	Write(out, CacheVersion);
+	Write(out, data.Key);
+	Write(out, data.Options);
+	Write(out, data.Irradiance);
+	for (auto& level : data.Specular) WriteArray(out, level);
+	WriteArray(out, data.BRDF);
+	if (!out) {
+		error = "couldn't write " + path;
+		return false;
+	}
+	return true;
+}
+
+bool IBLBaker::Load(const std::string& path, unsigned long long key, IBLData& data, std::string& error)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		error = "no cached bake at " + path;
+		return false;
+	}
+
+	unsigned int magic = 0, version = 0;
+	IBLData loaded = {};
+	if (!Read(in, magic) || !Read(in, version) || magic != CacheMagic || version != CacheVersion ||
+		!Read(in, loaded.Key) || loaded.Key != key || !Read(in, loaded.Options) || !Read(in, loaded.Irradiance)) {
+		error = path + " isn't a bake of this sky";
+		return false;
+	}
+
+	const IBLOptions& o = loaded.Options;
+	if (o.SpecularLevels < 2 || o.SpecularLevels > 16 || o.SpecularSize > 4096 || o.LUTSize > 4096) {
+		error = path + " is damaged";
+		return false;
+	}
+	loaded.Specular.resize(o.SpecularLevels);
+	for (unsigned int level = 0; level < o.SpecularLevels; level++) {
+		size_t size = std::max(1u, o.SpecularSize >> level);
+		if (!ReadArray(in, loaded.Specular[level], 6 * size * size * 4)) {
+			error = path + " is missing specular levels";
+			return false;
+		}
+	}
+	if (!ReadArray(in, loaded.BRDF, (size_t)o.LUTSize * o.LUTSize * 2)) {
+		error = path + " is missing its BRDF table";
+		return false;
+	}
+	data = std::move(loaded);
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Helpers
+// --------------------------------------------------------
+void IBLBaker::EvaluateIrradiance(const IBLData& data, const float normal[3], float rgb[3])
+{
+	float x = normal[0], y = normal[1], z = normal[2];
+	float basis[9] = {
+		0.282095f,
+		0.488603f * y, 0.488603f * z, 0.488603f * x,
+		1.092548f * x * y, 1.092548f * y * z, 0.315392f * (3 * z * z - 1),
+		1.092548f * x * z, 0.546274f * (x * x - y * y)
+	};
+	for (int c = 0; c < 3; c++) {
+		float sum = 0;
+		for (int i = 0; i < 9; i++) sum += data.Irradiance[i][c] * basis[i];
+		rgb[c] = std::max(sum, 0.0f);
+	}
+}
+
+unsigned short IBLBaker::FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	if (((bits >> 23) & 0xff) == 0xff) return (unsigned short)(sign | 0x7c00 | (mantissa ? 0x200 : 0));	// inf, nan
+	if (exponent >= 31) return (unsigned short)(sign | 0x7c00);										// too big
+	if (exponent <= 0) {
+		// denormal (or zero), rounded to nearest
+		if (exponent < -10) return (unsigned short)sign;
+		mantissa |= 0x800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1) half++;
+		return (unsigned short)(sign | half);
+	}
+
+	// round to nearest, which can carry into the exponent
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000) half++;
+	return (unsigned short)half;
+}
+
+float IBLBaker::HalfToFloat(unsigned short value)
+{
+	uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+
+	uint32_t bits;
+	if (exponent == 0) {
+		if (mantissa == 0) bits = sign;
+		else {
+			// denormal: shift it up into a normal float
+			exponent = 127 - 15 + 1;
+			while (!(mantissa & 0x400)) { mantissa <<= 1; exponent--; }
+			bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+		}
+	}
+	else if (exponent == 31) bits = sign | 0x7f800000 | (mantissa << 13);
+	else bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "PngDecoder.h"
+
+class ThreadPool;
+
+// Sizes and sample counts for a bake - zero for the default
+struct IBLOptions
+{
+	unsigned int SourceSize;		// faces are box filtered down to this first (256)
+	unsigned int SpecularSize;		// mip 0 of the prefiltered cube (128)
+	unsigned int SpecularLevels;	// roughness 0 to 1, one level each (6)
+	unsigned int SpecularSamples;	// GGX samples per texel (128)
+	unsigned int LUTSize;			// the BRDF table is LUTSize x LUTSize (128)
+	unsigned int LUTSamples;		// per table entry (512)
+};
+
+// --------------------------------------------------------
+// Everything the pixel shader needs to light with the sky
+// --------------------------------------------------------
+struct IBLData
+{
+	unsigned long long Key;			// hash of the faces and options it was baked from
+	IBLOptions Options;				// with the defaults filled in
+
+	// diffuse: 9 spherical harmonics coefficients (rgb, w unused), already
+	// convolved with the cosine lobe and divided by pi, so summed against
+	// the basis at a normal they give the light an albedo of 1 reflects
+	float Irradiance[9][4];
+
+	// specular: level m was prefiltered for roughness m / (levels - 1),
+	// each level is 6 faces (+X, -X, +Y, -Y, +Z, -Z) of RGBA16F, one after another
+	std::vector<std::vector<unsigned short>> Specular;
+
+	// split sum: RG16F scale and bias for F0, x = N.V, y = roughness
+	std::vector<unsigned short> BRDF;
+};
+
+struct IBLBakeStats
+{
+	bool FromCache;
+	double HashMs;
+	double LoadMs;			// reading the cache
+	double SourceMs;		// faces to linear floats and their mips
+	double IrradianceMs;
+	double SpecularMs;
+	double BRDFMs;
+	double SaveMs;
+	double TotalMs;
+};
+
+// --------------------------------------------------------
+// Image based lighting, precomputed on the CPU from the
+// six faces of a sky cube map
+//
+// - Faces are 8 bit with the shader's 2.2 gamma, so they're
+//   linearized the same way the pixel shader does albedo, or
+//   already linear floats (an HDR sky, from EnvironmentMap)
+// - Irradiance is projected onto 9 spherical harmonics
+// - Specular is GGX prefiltered with importance sampling,
+//   each sample read from the source mip that matches its
+//   footprint (filtered importance sampling), so a few
+//   hundred samples don't alias
+// - The BRDF table is the split sum's scale and bias for F0
+// - Texels are worked on as float4s with SSE, and rows are
+//   split across the thread pool
+// - Bakes are cached on disk, named by a hash of the faces
+//   and options, so a changed sky is simply never found
+// - Only depends on the standard library (and ThreadPool)
+// --------------------------------------------------------
+class IBLBaker
+{
+public:
+	// The options with every zero replaced by its default
+	static IBLOptions Resolve(const IBLOptions& options);
+
+	/// <summary>
+	/// Hashes the faces' pixels and the options (what a bake is cached by)
+	/// </summary>
+	static unsigned long long GetKey(const DecodedImage* faces, const IBLOptions& options);
+	static unsigned long long GetKey(const float* faces, unsigned int faceSize, const IBLOptions& options);
+
+	/// <summary>
+	/// Bakes everything from 6 faces (+X, -X, +Y, -Y, +Z, -Z, square and all the same size)
+	/// </summary>
+	/// <param name="pool">splits rows across threads, or null for this thread only</param>
+	static bool Bake(const DecodedImage* faces, const IBLOptions& options, ThreadPool* pool, IBLData& data, IBLBakeStats& stats, std::string& error);
+
+	/// <summary>
+	/// The same from linear faces: 6 of faceSize x faceSize RGBA floats, one after another
+	/// </summary>
+	static bool Bake(const float* faces, unsigned int faceSize, const IBLOptions& options, ThreadPool* pool, IBLData& data, IBLBakeStats& stats, std::string& error);
+
+	/// <summary>
+	/// The cached bake for these faces if there is one, otherwise bakes and caches it
+	/// </summary>
+	/// <param name="cacheDirectory">where bakes are kept, as &lt;key&gt;.ibl (created if needed)</param>
+	static bool LoadOrBake(const DecodedImage* faces, const IBLOptions& options, const std::string& cacheDirectory, ThreadPool* pool,
+		IBLData& data, IBLBakeStats& stats, std::string& error);
+	static bool LoadOrBake(const float* faces, unsigned int faceSize, const IBLOptions& options, const std::string& cacheDirectory, ThreadPool* pool,
+		IBLData& data, IBLBakeStats& stats, std::string& error);
+
+	static bool Save(const std::string& path, const IBLData& data, std::string& error);
+
+	/// <summary>
+	/// Reads a bake, failing if it isn't the one for key
+	/// </summary>
+	static bool Load(const std::string& path, unsigned long long key, IBLData& data, std::string& error);
+
+	// Where a bake with this key lives in a cache directory
+	static std::string GetCachePath(const std::string& cacheDirectory, unsigned long long key);
+
+	// The diffuse light (per unit albedo) from a direction's side, as the shader works it out
+	static void EvaluateIrradiance(const IBLData& data, const float normal[3], float rgb[3]);
+
+	static unsigned short FloatToHalf(float value);
+	static float HalfToFloat(unsigned short value);
+};
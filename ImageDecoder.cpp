@@ -0,0 +1,71 @@
+#include "ImageDecoder.h"
+#include "JpegDecoder.h"
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+bool ImageDecoder::Decode(const unsigned char* data, size_t size, DecodedImage& image, std::string& error)
+{
+	if (PngDecoder::IsPng(data, size)) return PngDecoder::Decode(data, size, image, error);
+	if (JpegDecoder::IsJpeg(data, size)) return JpegDecoder::Decode(data, size, image, error);
+	error = "not a PNG or JPEG";
+	return false;
+}
+
+bool ImageDecoder::DecodeFile(const std::string& path, DecodedImage& image, std::string& error)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		error = "couldn't open " + path;
+		return false;
+	}
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Decode(data.data(), data.size(), image, error);
+}
+
+bool ImageDecoder::CanDecode(const unsigned char* data, size_t size)
+{
+	return PngDecoder::IsPng(data, size) || JpegDecoder::IsJpeg(data, size);
+}
+
+bool ImageDecoder::ReadSize(const unsigned char* data, size_t size, unsigned int& width, unsigned int& height)
+{
+	auto bigEndian16 = [](const unsigned char* p) { return (unsigned int)p[0] << 8 | p[1]; };
+
+	// a PNG's IHDR is always its first chunk
+	if (PngDecoder::IsPng(data, size)) {
+		if (size < 24 || memcmp(data + 12, "IHDR", 4) != 0) return false;
+		width = bigEndian16(data + 16) << 16 | bigEndian16(data + 18);
+		height = bigEndian16(data + 20) << 16 | bigEndian16(data + 22);
+		return true;
+	}
+
+	// a JPEG's frame header is whichever segment is a start of frame
+	if (JpegDecoder::IsJpeg(data, size)) {
+		for (size_t at = 2; at + 4 <= size; ) {
+			if (data[at] != 0xFF) { at++; continue; }
+			unsigned char marker = data[at + 1];
+			if (marker == 0xFF || marker == 0 || (marker >= 0xD0 && marker <= 0xD7)) { at++; continue; }
+			if (marker == 0xD9) return false;
+			bool frame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+			if (frame) {
+				if (at + 9 > size) return false;
+				height = bigEndian16(data + at + 5);
+				width = bigEndian16(data + at + 7);
+				return true;
+			}
+			at += 2 + bigEndian16(data + at + 2);
+		}
+	}
+	return false;
+}
+
+bool ImageDecoder::IsSupportedExtension(const std::string& extension)
+{
+	std::string lower = extension;
+	for (char& c : lower) c = (char)tolower((unsigned char)c);
+	return lower == ".png" || lower == ".jpg" || lower == ".jpeg";
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+#include "PngDecoder.h"
+
+// --------------------------------------------------------
+// The one place textures get decoded without WIC: picks
+// PngDecoder or JpegDecoder from a file's first bytes, so
+// every caller gets the same RGBA8 whatever it started as
+//
+// - Only depends on the standard library
+// --------------------------------------------------------
+class ImageDecoder
+{
+public:
+	/// <summary>
+	/// Decodes a PNG or JPEG already in memory
+	/// </summary>
+	/// <returns>false (with the reason in error) if it isn't either, or couldn't be decoded</returns>
+	static bool Decode(const unsigned char* data, size_t size, DecodedImage& image, std::string& error);
+	static bool DecodeFile(const std::string& path, DecodedImage& image, std::string& error);
+
+	/// <summary>
+	/// Whether the data looks like something Decode understands
+	/// </summary>
+	static bool CanDecode(const unsigned char* data, size_t size);
+
+	/// <summary>
+	/// Reads a PNG or JPEG's size from its header, without decoding anything
+	/// </summary>
+	/// <returns>false if it isn't either, or the header can't be found</returns>
+	static bool ReadSize(const unsigned char* data, size_t size, unsigned int& width, unsigned int& height);
+
+	/// <summary>
+	/// Whether a file extension (with its dot, any case) is one Decode understands
+	/// </summary>
+	static bool IsSupportedExtension(const std::string& extension);
+};
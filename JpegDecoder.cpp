@@ -0,0 +1,541 @@
+#include "JpegDecoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <emmintrin.h>
+
+namespace
+{
+	// Where each of the 64 coefficients, in stream order, goes in the block
+	const unsigned char ZigZag[64] = {
+		0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+		12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+		35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+		58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+	// --------------------------------------------------------
+	// Reads entropy coded data, most significant bit first,
+	// dropping the zero after each 0xFF; at a marker it stops
+	// and gives zeros (the caller decides if that's an error)
+	// --------------------------------------------------------
+	struct BitReader
+	{
+		const unsigned char* data;
+		size_t size;
+		size_t pos;
+		uint64_t bits;			// left aligned
+		unsigned int count;
+		bool atMarker;
+
+		void Refill()
+		{
+			while (count <= 56) {
+				unsigned int byte = 0;
+				if (!atMarker && pos < size) {
+					byte = data[pos];
+					if (byte != 0xFF) pos++;
+					else if (pos + 1 < size && data[pos + 1] == 0) pos += 2;
+					else {
+						atMarker = true;
+						byte = 0;
+					}
+				}
+				bits |= (uint64_t)byte << (56 - count);
+				count += 8;
+			}
+		}
+		unsigned int Peek(unsigned int n) { return (unsigned int)(bits >> (64 - n)); }
+		void Consume(unsigned int n) { bits <<= n; count -= n; }
+
+		// n bits as a signed value, the way coefficients are stored
+		int ReceiveExtend(unsigned int n)
+		{
+			if (n == 0) return 0;
+			Refill();
+			int v = (int)Peek(n);
+			Consume(n);
+			return v < (1 << (n - 1)) ? v - (1 << n) + 1 : v;
+		}
+
+		// Skips the RSTn marker that should be next, and anything left of the byte before it
+		void Restart()
+		{
+			bits = 0;
+			count = 0;
+			atMarker = false;
+			while (pos + 1 < size && !(data[pos] == 0xFF && data[pos + 1] >= 0xD0 && data[pos + 1] <= 0xD7)) pos++;
+			pos += 2;
+		}
+	};
+
+	// --------------------------------------------------------
+	// A Huffman table: codes up to FastBits long come straight
+	// out of a table, longer ones are found the canonical way
+	// --------------------------------------------------------
+	struct Huffman
+	{
+		static const unsigned int FastBits = 9;
+		uint16_t fast[1 << FastBits];		// length << 8 | symbol, 0 = longer code
+		int maxCode[17];					// one past the last code of each length
+		int offset[17];						// code + offset = index into symbols
+		unsigned char symbols[256];
+		bool present;
+
+		bool Build(const unsigned char* counts, const unsigned char* values, unsigned int total)
+		{
+			memset(fast, 0, sizeof(fast));
+			memcpy(symbols, values, total);
+			int code = 0;
+			unsigned int k = 0;
+			for (unsigned int len = 1; len <= 16; len++) {
+				offset[len] = (int)k - code;
+				if (code + counts[len - 1] > 1 << len) return false;		// more codes than fit
+				for (unsigned int i = 0; i < counts[len - 1]; i++, k++, code++) {
+					if (len <= FastBits)
+						for (int j = 0; j < 1 << (FastBits - len); j++)
+							fast[(code << (FastBits - len)) + j] = (uint16_t)(len << 8 | values[k]);
+				}
+				maxCode[len] = code;
+				code <<= 1;
+			}
+			present = true;
+			return true;
+		}
+
+		int Decode(BitReader& in) const
+		{
+			in.Refill();
+			unsigned int e = fast[in.Peek(FastBits)];
+			if (e) {
+				in.Consume(e >> 8);
+				return e & 0xFF;
+			}
+			for (unsigned int len = FastBits + 1; len <= 16; len++) {
+				int code = (int)in.Peek(len);
+				if (code < maxCode[len]) {
+					in.Consume(len);
+					return symbols[code + offset[len]];
+				}
+			}
+			return -1;
+		}
+	};
+
+	struct Component
+	{
+		unsigned int Id;
+		unsigned int H, V;				// sampling factors
+		unsigned int Quant;				// table index
+		unsigned int Width, Height;		// in samples, before upsampling
+		unsigned int Stride;			// of Plane, a whole number of MCUs wide
+		std::vector<unsigned char> Plane;
+		int DC;							// prediction
+		unsigned int DCTable, ACTable;
+		bool Decoded;
+	};
+
+	// --------------------------------------------------------
+	// The inverse DCT as two matrix products, out = M F M^T,
+	// on rows of 8 floats (two SSE registers): a coefficient
+	// row is the sum of M's columns it selects, so the zeros
+	// that make up most of a block are simply skipped
+	// --------------------------------------------------------
+	struct IDCT
+	{
+		float m[8][8];		// [u][x] = C(u) cos((2x + 1) u pi / 16) / 2
+
+		IDCT()
+		{
+			for (int u = 0; u < 8; u++)
+				for (int x = 0; x < 8; x++)
+					m[u][x] = (u == 0 ? sqrtf(0.5f) : 1.0f) * cosf((2 * x + 1) * u * 3.14159265358979f / 16) / 2;
+		}
+
+		// flat: only the DC coefficient is set, as in plenty of blocks (anything smooth)
+		void Transform(const float* block, bool flat, unsigned char* out, size_t stride) const
+		{
+			if (flat) {
+				int v = (int)lrintf(block[0] * m[0][0] * m[0][0] + 128.0f);
+				unsigned char fill = (unsigned char)(v < 0 ? 0 : v > 255 ? 255 : v);
+				for (int y = 0; y < 8; y++) memset(out + y * stride, fill, 8);
+				return;
+			}
+
+			// rows: t[v] = sum over u of F[v][u] * m[u]
+			__m128 t[8][2];
+			for (int v = 0; v < 8; v++) {
+				__m128 lo = _mm_setzero_ps(), hi = _mm_setzero_ps();
+				for (int u = 0; u < 8; u++) {
+					float f = block[v * 8 + u];
+					if (f == 0) continue;
+					__m128 s = _mm_set1_ps(f);
+					lo = _mm_add_ps(lo, _mm_mul_ps(s, _mm_loadu_ps(m[u])));
+					hi = _mm_add_ps(hi, _mm_mul_ps(s, _mm_loadu_ps(m[u] + 4)));
+				}
+				t[v][0] = lo;
+				t[v][1] = hi;
+			}
+
+			// columns: out[y] = sum over v of m[v][y] * t[v], then level shift and clamp
+			const __m128 shift = _mm_set1_ps(128.0f);
+			for (int y = 0; y < 8; y++) {
+				__m128 lo = shift, hi = shift;
+				for (int v = 0; v < 8; v++) {
+					__m128 s = _mm_set1_ps(m[v][y]);
+					lo = _mm_add_ps(lo, _mm_mul_ps(s, t[v][0]));
+					hi = _mm_add_ps(hi, _mm_mul_ps(s, t[v][1]));
+				}
+				__m128i words = _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+				_mm_storel_epi64((__m128i*)(out + y * stride), _mm_packus_epi16(words, words));
+			}
+		}
+	};
+
+	uint16_t ReadBigEndian16(const unsigned char* p) { return (uint16_t)(p[0] << 8 | p[1]); }
+
+	// --------------------------------------------------------
+	// One full resolution row of a component, upsampled like
+	// libjpeg's "fancy" upsampling: a 2x step in either
+	// direction is a 3:1 triangle between the nearest two
+	// samples, anything else is replicated
+	// --------------------------------------------------------
+	void UpsampleRow(const Component& c, unsigned int sx, unsigned int sy, unsigned int y, unsigned int width, std::vector<int>& sums, unsigned char* out)
+	{
+		// vertically, into sums at 4x scale
+		unsigned int cy = y / sy;
+		const unsigned char* near = &c.Plane[(size_t)cy * c.Stride];
+		sums.resize(c.Width);
+		if (sy == 2) {
+			unsigned int fy = (y & 1) ? (cy + 1 < c.Height ? cy + 1 : cy) : (cy > 0 ? cy - 1 : 0);
+			const unsigned char* far = &c.Plane[(size_t)fy * c.Stride];
+			for (unsigned int x = 0; x < c.Width; x++) sums[x] = 3 * near[x] + far[x];
+		}
+		else
+			for (unsigned int x = 0; x < c.Width; x++) sums[x] = 4 * near[x];
+
+		// then horizontally, back down to 8 bits
+		if (sx == 2) {
+			for (unsigned int x = 0; x < c.Width; x++) {
+				int left = sums[x > 0 ? x - 1 : 0];
+				int right = sums[x + 1 < c.Width ? x + 1 : x];
+				if (2 * x < width) out[2 * x] = (unsigned char)((3 * sums[x] + left + 8) >> 4);
+				if (2 * x + 1 < width) out[2 * x + 1] = (unsigned char)((3 * sums[x] + right + 7) >> 4);
+			}
+		}
+		else
+			for (unsigned int x = 0; x < width; x++) out[x] = (unsigned char)((sums[x / sx] + 2) >> 2);
+	}
+
+	// --------------------------------------------------------
+	// YCbCr (JFIF, full range) to RGBA, four pixels at a time
+	// --------------------------------------------------------
+	void ConvertRow(const unsigned char* y, const unsigned char* cb, const unsigned char* cr, unsigned int width, unsigned char* out)
+	{
+		const __m128 zero = _mm_setzero_ps(), max = _mm_set1_ps(255.0f), half = _mm_set1_ps(128.0f);
+		const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+		unsigned int x = 0;
+		for (; x + 4 <= width; x += 4) {
+			auto load = [](const unsigned char* p) {
+				int v;
+				memcpy(&v, p, 4);
+				__m128i b = _mm_cvtsi32_si128(v);
+				b = _mm_unpacklo_epi8(b, _mm_setzero_si128());
+				return _mm_cvtepi32_ps(_mm_unpacklo_epi16(b, _mm_setzero_si128()));
+			};
+			__m128 l = load(y + x);
+			__m128 u = _mm_sub_ps(load(cb + x), half);
+			__m128 v = _mm_sub_ps(load(cr + x), half);
+			__m128 r = _mm_add_ps(l, _mm_mul_ps(v, _mm_set1_ps(1.402f)));
+			__m128 g = _mm_sub_ps(l, _mm_add_ps(_mm_mul_ps(u, _mm_set1_ps(0.344136f)), _mm_mul_ps(v, _mm_set1_ps(0.714136f))));
+			__m128 b = _mm_add_ps(l, _mm_mul_ps(u, _mm_set1_ps(1.772f)));
+			__m128i ri = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(r, zero), max));
+			__m128i gi = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(g, zero), max));
+			__m128i bi = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(b, zero), max));
+			__m128i rgba = _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 8)), _mm_or_si128(_mm_slli_epi32(bi, 16), alpha));
+			_mm_storeu_si128((__m128i*)(out + x * 4), rgba);
+		}
+		for (; x < width; x++) {
+			float l = y[x], u = cb[x] - 128.0f, v = cr[x] - 128.0f;
+			float rgb[3] = { l + 1.402f * v, l - 0.344136f * u - 0.714136f * v, l + 1.772f * u };
+			for (int i = 0; i < 3; i++)
+				out[x * 4 + i] = (unsigned char)lrintf(rgb[i] < 0 ? 0 : rgb[i] > 255 ? 255 : rgb[i]);
+			out[x * 4 + 3] = 255;
+		}
+	}
+
+	// --------------------------------------------------------
+	// Decodes the blocks of one scan straight into the planes
+	// of the components it covers
+	// --------------------------------------------------------
+	bool DecodeScan(BitReader& in, std::vector<Component*>& scan, const Huffman* dc, const Huffman* ac, const uint16_t quant[4][64],
+		unsigned int mcusX, unsigned int mcusY, unsigned int restartInterval, const IDCT& idct, std::string& error)
+	{
+		// a single component scan goes block by block, not by MCU
+		bool single = scan.size() == 1;
+		unsigned int blocksX = mcusX, blocksY = mcusY;
+		if (single) {
+			blocksX = (scan[0]->Width + 7) / 8;
+			blocksY = (scan[0]->Height + 7) / 8;
+		}
+
+		alignas(16) float block[64];
+		unsigned int untilRestart = restartInterval;
+		for (Component* c : scan) c->DC = 0;
+
+		for (unsigned int my = 0; my < blocksY; my++)
+			for (unsigned int mx = 0; mx < blocksX; mx++) {
+				if (restartInterval && untilRestart == 0) {
+					in.Restart();
+					untilRestart = restartInterval;
+					for (Component* c : scan) c->DC = 0;
+				}
+				untilRestart--;
+
+				for (Component* c : scan) {
+					unsigned int h = single ? 1 : c->H, v = single ? 1 : c->V;
+					const Huffman& dcTable = dc[c->DCTable];
+					const Huffman& acTable = ac[c->ACTable];
+					const uint16_t* q = quant[c->Quant];
+
+					for (unsigned int by = 0; by < v; by++)
+						for (unsigned int bx = 0; bx < h; bx++) {
+							memset(block, 0, sizeof(block));
+							int s = dcTable.Decode(in);
+							if (s < 0 || s > 11) { error = "bad DC code"; return false; }
+							c->DC += in.ReceiveExtend((unsigned int)s);
+							block[0] = (float)(c->DC * q[0]);
+							bool flat = true;
+
+							for (unsigned int k = 1; k < 64; ) {
+								int rs = acTable.Decode(in);
+								if (rs < 0) { error = "bad AC code"; return false; }
+								unsigned int run = (unsigned int)rs >> 4, size = (unsigned int)rs & 15;
+								if (size == 0) {
+									if (run != 15) break;		// end of block
+									k += 16;
+									continue;
+								}
+								k += run;
+								if (k > 63 || size > 10) { error = "coefficient out of range"; return false; }
+								block[ZigZag[k]] = (float)(in.ReceiveExtend(size) * q[k]);
+								flat = false;
+								k++;
+							}
+
+							unsigned int x = (mx * h + bx) * 8, y = (my * v + by) * 8;
+							idct.Transform(block, flat, &c->Plane[(size_t)y * c->Stride + x], c->Stride);
+						}
+				}
+			}
+		for (Component* c : scan) c->Decoded = true;
+		return true;
+	}
+}
+
+
+bool JpegDecoder::DecodeFile(const std::string& path, DecodedImage& image, std::string& error)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		error = "couldn't open " + path;
+		return false;
+	}
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Decode(data.data(), data.size(), image, error);
+}
+
+bool JpegDecoder::IsJpeg(const unsigned char* data, size_t size)
+{
+	return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+bool JpegDecoder::Decode(const unsigned char* data, size_t size, DecodedImage& image, std::string& error)
+{
+	if (!IsJpeg(data, size)) {
+		error = "not a JPEG";
+		return false;
+	}
+
+	static const IDCT idct;
+	uint16_t quant[4][64] = {};
+	Huffman dc[4] = {}, ac[4] = {};
+	std::vector<Component> components;
+	unsigned int width = 0, height = 0, hMax = 1, vMax = 1, mcusX = 0, mcusY = 0;
+	unsigned int restartInterval = 0;
+	int adobeTransform = -1;
+	bool frame = false;
+
+	for (size_t at = 2; at + 4 <= size; ) {
+		// markers may be padded with any number of 0xFFs
+		if (data[at] != 0xFF) { at++; continue; }
+		unsigned char marker = data[at + 1];
+		if (marker == 0xFF || marker == 0 || (marker >= 0xD0 && marker <= 0xD7)) { at++; continue; }
+		if (marker == 0xD9) break;
+		size_t length = ReadBigEndian16(data + at + 2);
+		if (length < 2 || at + 2 + length > size) { error = "truncated segment"; return false; }
+		const unsigned char* body = data + at + 4;
+		size_t bodySize = length - 2;
+		size_t next = at + 2 + length;
+
+		switch (marker) {
+		case 0xC0: case 0xC1: {
+			// start of frame: baseline or extended sequential, Huffman coded
+			if (bodySize < 6 || body[0] != 8) { error = "only 8 bit JPEGs are supported"; return false; }
+			height = ReadBigEndian16(body + 1);
+			width = ReadBigEndian16(body + 3);
+			unsigned int count = body[5];
+			if (width == 0 || height == 0) { error = "empty (or DNL sized) image"; return false; }
+			if (width > 32768 || height > 32768) { error = "image too large"; return false; }
+			if ((count != 1 && count != 3) || bodySize < 6 + count * 3) { error = "only gray and three component JPEGs are supported"; return false; }
+			components.resize(count);
+			for (unsigned int i = 0; i < count; i++) {
+				Component& c = components[i];
+				c = {};
+				c.Id = body[6 + i * 3];
+				c.H = body[7 + i * 3] >> 4;
+				c.V = body[7 + i * 3] & 15;
+				c.Quant = body[8 + i * 3] & 3;
+				if (c.H < 1 || c.H > 4 || c.V < 1 || c.V > 4) { error = "bad sampling factors"; return false; }
+				hMax = std::max(hMax, c.H);
+				vMax = std::max(vMax, c.V);
+			}
+			mcusX = (width + 8 * hMax - 1) / (8 * hMax);
+			mcusY = (height + 8 * vMax - 1) / (8 * vMax);
+
+			// every block takes at least two bits (its DC and its end of block), so a
+			// frame bigger than the rest of the file could hold, even counting the
+			// padding at its edges twice over, doesn't get planes
+			unsigned long long blocks = 0;
+			for (Component& c : components) blocks += (unsigned long long)mcusX * mcusY * c.H * c.V;
+			if (blocks > (unsigned long long)(size - next) * 8) { error = "not enough scan data for the frame's size"; return false; }
+			for (Component& c : components) {
+				if (hMax % c.H || vMax % c.V) { error = "unsupported sampling factors"; return false; }
+				c.Width = (width * c.H + hMax - 1) / hMax;
+				c.Height = (height * c.V + vMax - 1) / vMax;
+				c.Stride = mcusX * c.H * 8;
+				c.Plane.assign((size_t)c.Stride * mcusY * c.V * 8, 0);
+			}
+			frame = true;
+			break;
+		}
+		case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+		case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+			error = "progressive, arithmetic coded and lossless JPEGs aren't supported";
+			return false;
+
+		case 0xC4:
+			// Huffman tables: class and index, 16 counts, then the symbols
+			for (size_t p = 0; p < bodySize; ) {
+				if (p + 17 > bodySize) { error = "truncated Huffman table"; return false; }
+				unsigned int kind = body[p] >> 4, index = body[p] & 3;
+				unsigned int total = 0;
+				for (unsigned int i = 0; i < 16; i++) total += body[p + 1 + i];
+				if (total > 256 || p + 17 + total > bodySize) { error = "bad Huffman table"; return false; }
+				Huffman& table = kind == 0 ? dc[index] : ac[index];
+				if (!table.Build(body + p + 1, body + p + 17, total)) { error = "bad Huffman table"; return false; }
+				p += 17 + total;
+			}
+			break;
+
+		case 0xDB:
+			// quantization tables, 8 or 16 bit, in zigzag order like the coefficients
+			for (size_t p = 0; p < bodySize; ) {
+				unsigned int precision = body[p] >> 4, index = body[p] & 3;
+				if (p + 1 + 64 * (precision + 1) > bodySize) { error = "truncated quantization table"; return false; }
+				for (unsigned int i = 0; i < 64; i++)
+					quant[index][i] = precision ? ReadBigEndian16(body + p + 1 + i * 2) : body[p + 1 + i];
+				p += 1 + 64 * (precision + 1);
+			}
+			break;
+
+		case 0xDD:
+			if (bodySize < 2) { error = "truncated restart interval"; return false; }
+			restartInterval = ReadBigEndian16(body);
+			break;
+
+		case 0xEE:
+			// Adobe's segment says whether three components are YCbCr or plain RGB
+			if (bodySize >= 12 && memcmp(body, "Adobe", 5) == 0) adobeTransform = body[11];
+			break;
+
+		case 0xDA: {
+			if (!frame) { error = "scan before the frame header"; return false; }
+			unsigned int count = bodySize > 0 ? body[0] : 0;
+			if (count < 1 || count > components.size() || bodySize < 4 + count * 2) { error = "bad scan header"; return false; }
+			std::vector<Component*> scan;
+			for (unsigned int i = 0; i < count; i++) {
+				Component* found = 0;
+				for (Component& c : components)
+					if (c.Id == body[1 + i * 2]) found = &c;
+				if (!found) { error = "scan of a missing component"; return false; }
+				found->DCTable = body[2 + i * 2] >> 4 & 3;
+				found->ACTable = body[2 + i * 2] & 3;
+				if (!dc[found->DCTable].present || !ac[found->ACTable].present) { error = "scan without its Huffman tables"; return false; }
+				scan.push_back(found);
+			}
+
+			BitReader in = { data, size, next, 0, 0, false };
+			if (!DecodeScan(in, scan, dc, ac, quant, mcusX, mcusY, restartInterval, idct, error))
+				return false;
+
+			// the reader stops at the marker after the data
+			next = in.pos;
+			break;
+		}
+
+		}
+		at = next;
+	}
+
+	if (!frame) { error = "no frame header"; return false; }
+	for (Component& c : components)
+		if (!c.Decoded) { error = "missing scan data"; return false; }
+
+	image.Width = width;
+	image.Height = height;
+	image.SourceChannels = components.size() == 1 ? 1 : 3;
+	image.Pixels.resize((size_t)width * height * 4);
+
+	// RGB if Adobe says so, or if the components are literally named R, G and B
+	bool rgb = components.size() == 3 && (adobeTransform == 0 ||
+		(adobeTransform < 0 && components[0].Id == 'R' && components[1].Id == 'G' && components[2].Id == 'B'));
+
+	std::vector<unsigned char> rows[3];
+	std::vector<int> sums;
+	for (unsigned int y = 0; y < height; y++) {
+		const unsigned char* row[3];
+		for (size_t i = 0; i < components.size(); i++) {
+			const Component& c = components[i];
+			unsigned int sx = hMax / c.H, sy = vMax / c.V;
+			if (sx == 1 && sy == 1) {
+				row[i] = &c.Plane[(size_t)y * c.Stride];
+				continue;
+			}
+			rows[i].resize(width);
+			UpsampleRow(c, sx, sy, y, width, sums, rows[i].data());
+			row[i] = rows[i].data();
+		}
+
+		unsigned char* out = &image.Pixels[(size_t)y * width * 4];
+		if (components.size() == 1)
+			for (unsigned int x = 0; x < width; x++, out += 4) {
+				out[0] = out[1] = out[2] = row[0][x];
+				out[3] = 255;
+			}
+		else if (rgb)
+			for (unsigned int x = 0; x < width; x++, out += 4) {
+				out[0] = row[0][x];
+				out[1] = row[1][x];
+				out[2] = row[2][x];
+				out[3] = 255;
+			}
+		else
+			ConvertRow(row[0], row[1], row[2], width, out);
+	}
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include "PngDecoder.h"
+
+// --------------------------------------------------------
+// A small baseline JPEG decoder, the other half of reading
+// textures without WIC
+//
+// - Handles sequential Huffman coded 8 bit gray and YCbCr
+//   (or Adobe RGB) images with any sampling factors, restart
+//   intervals and interleaved or separate scans
+// - Progressive, arithmetic coded, lossless, 12 bit and
+//   CMYK images aren't supported, and fail with an error
+// - The IDCT and color conversion use SSE2; chroma is
+//   upsampled with the same triangle filter as libjpeg
+// - Only depends on the standard library
+// --------------------------------------------------------
+class JpegDecoder
+{
+public:
+	/// <summary>
+	/// Decodes a whole JPEG file already in memory, to the same RGBA8 a PNG gives
+	/// </summary>
+	/// <returns>false (with the reason in error) if it couldn't be decoded</returns>
+	static bool Decode(const unsigned char* data, size_t size, DecodedImage& image, std::string& error);
+	static bool DecodeFile(const std::string& path, DecodedImage& image, std::string& error);
+
+	/// <summary>
+	/// Whether data starts with a JPEG start of image marker
+	/// </summary>
+	static bool IsJpeg(const unsigned char* data, size_t size);
+};
@@ -0,0 +1,338 @@
+#include "LightClusters.h"
+
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+LightClusters::LightClusters(std::shared_ptr<ThreadPool> pool, unsigned int gridX, unsigned int gridY, unsigned int gridZ) :
+	pool(pool),
+	gridX(std::max(1u, gridX)),
+	gridY(std::max(1u, gridY)),
+	gridZ(std::max(1u, gridZ)),
+	boundsNear(0.0f),
+	boundsFar(0.0f),
+	rowStride(0),
+	sliceScale(0.0f),
+	sliceBias(0.0f),
+	lightCount(0)
+{
+	memset(boundsProjection, 0, sizeof(boundsProjection));
+	grid.resize(this->gridX * this->gridY * this->gridZ);
+	stats = {};
+}
+
+// --------------------------------------------------------
+// View space boxes (and bounding spheres) of every cluster
+//
+// A cluster's corners are the corners of its screen tile,
+// unprojected at the near and far depth of its slice.
+// Works for orthographic projections too, since the
+// unprojection uses the whole matrix.
+// --------------------------------------------------------
+void LightClusters::BuildClusterBounds(const float* projection, float nearClip, float farClip)
+{
+	memcpy(boundsProjection, projection, sizeof(boundsProjection));
+	boundsNear = nearClip;
+	boundsFar = farClip;
+
+	float logRatio = logf(farClip / nearClip);
+	sliceScale = gridZ / logRatio;
+	sliceBias = gridZ * logf(nearClip) / logRatio;
+
+	sliceNear.resize(gridZ + 1);
+	for (unsigned int z = 0; z <= gridZ; z++)
+		sliceNear[z] = nearClip * powf(farClip / nearClip, (float)z / gridZ);
+
+	// ndc (x, y) at view depth z -> view (x, y), with clip = view * projection
+	const float* p = projection;
+	auto unproject = [&](float ndcX, float ndcY, float z, float& x, float& y) {
+		float w = z * p[11] + p[15];
+		x = (ndcX * w - z * p[8] - p[12]) / p[0];
+		y = (ndcY * w - z * p[9] - p[13]) / p[5];
+	};
+
+	// padding boxes are inside out, so every distance to them is infinite
+	rowStride = (gridX + 3) & ~3u;
+	unsigned int count = rowStride * gridY * gridZ;
+	for (auto* v : { &minX, &minY, &minZ }) v->assign(count, INFINITY);
+	for (auto* v : { &maxX, &maxY, &maxZ }) v->assign(count, -INFINITY);
+	for (auto* v : { &sphereX, &sphereY, &sphereZ, &sphereRadius }) v->assign(count, 0.0f);
+
+	for (unsigned int z = 0; z < gridZ; z++) {
+		for (unsigned int y = 0; y < gridY; y++) {
+			for (unsigned int x = 0; x < gridX; x++) {
+				unsigned int c = (z * gridY + y) * rowStride + x;
+				float ndcX[2] = { -1.0f + 2.0f * x / gridX, -1.0f + 2.0f * (x + 1) / gridX };
+				float ndcY[2] = { 1.0f - 2.0f * (y + 1) / gridY, 1.0f - 2.0f * y / gridY };	// top row first
+				float depth[2] = { sliceNear[z], sliceNear[z + 1] };
+
+				float mn[3] = { INFINITY, INFINITY, depth[0] };
+				float mx[3] = { -INFINITY, -INFINITY, depth[1] };
+				for (int i = 0; i < 8; i++) {
+					float vx, vy;
+					unproject(ndcX[i & 1], ndcY[(i >> 1) & 1], depth[i >> 2], vx, vy);
+					mn[0] = std::min(mn[0], vx); mx[0] = std::max(mx[0], vx);
+					mn[1] = std::min(mn[1], vy); mx[1] = std::max(mx[1], vy);
+				}
+
+				minX[c] = mn[0]; minY[c] = mn[1]; minZ[c] = mn[2];
+				maxX[c] = mx[0]; maxY[c] = mx[1]; maxZ[c] = mx[2];
+				sphereX[c] = (mn[0] + mx[0]) * 0.5f;
+				sphereY[c] = (mn[1] + mx[1]) * 0.5f;
+				sphereZ[c] = (mn[2] + mx[2]) * 0.5f;
+				float hx = (mx[0] - mn[0]) * 0.5f, hy = (mx[1] - mn[1]) * 0.5f, hz = (mx[2] - mn[2]) * 0.5f;
+				sphereRadius[c] = sqrtf(hx * hx + hy * hy + hz * hz);
+			}
+		}
+	}
+}
+
+void LightClusters::Assign(const float* view, const float* projection, float nearClip, float farClip, const std::vector<ClusterLight>& lights)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	if (memcmp(projection, boundsProjection, sizeof(boundsProjection)) != 0 || nearClip != boundsNear || farClip != boundsFar)
+		BuildClusterBounds(projection, nearClip, farClip);
+
+	// lights into view space, padded with ones that can't touch anything
+	lightCount = (unsigned int)lights.size();
+	unsigned int padded = (lightCount + 3) & ~3u;
+	for (auto* v : { &lightX, &lightY, &lightZ, &lightDirX, &lightDirY, &lightDirZ, &lightCos, &lightSin, &lightSpot })
+		v->assign(padded, 0.0f);
+	lightRadius.assign(padded, -1.0f);
+	for (unsigned int i = lightCount; i < padded; i++)
+		lightZ[i] = -INFINITY;
+
+	const float* v = view;
+	for (unsigned int i = 0; i < lightCount; i++) {
+		const ClusterLight& l = lights[i];
+		const float* p = l.Position;
+		const float* d = l.Direction;
+		lightX[i] = p[0] * v[0] + p[1] * v[4] + p[2] * v[8] + v[12];
+		lightY[i] = p[0] * v[1] + p[1] * v[5] + p[2] * v[9] + v[13];
+		lightZ[i] = p[0] * v[2] + p[1] * v[6] + p[2] * v[10] + v[14];
+		lightRadius[i] = l.Range;
+		if (l.Spot) {
+			lightDirX[i] = d[0] * v[0] + d[1] * v[4] + d[2] * v[8];
+			lightDirY[i] = d[0] * v[1] + d[1] * v[5] + d[2] * v[9];
+			lightDirZ[i] = d[0] * v[2] + d[1] * v[6] + d[2] * v[10];
+			lightCos[i] = cosf(l.SpotOuterAngle);
+			lightSin[i] = sinf(l.SpotOuterAngle);
+			lightSpot[i] = 1.0f;
+		}
+	}
+
+	// each slice on its own, then packed in order
+	std::vector<std::vector<unsigned int>> sliceIndices(gridZ);
+	std::vector<std::vector<unsigned int>> sliceCounts(gridZ);
+	auto job = [&](unsigned int z) { AssignSlice(z, sliceIndices[z], sliceCounts[z]); };
+	if (pool) pool->ParallelFor(gridZ, job);
+	else for (unsigned int z = 0; z < gridZ; z++) job(z);
+
+	stats = {};
+	indices.clear();
+	unsigned int c = 0;
+	for (unsigned int z = 0; z < gridZ; z++) {
+		unsigned int offset = (unsigned int)indices.size();
+		for (unsigned int count : sliceCounts[z]) {
+			grid[c++] = { offset, count };
+			offset += count;
+			stats.MaxPerCluster = std::max(stats.MaxPerCluster, count);
+			if (count == 0) stats.EmptyClusters++;
+		}
+		indices.insert(indices.end(), sliceIndices[z].begin(), sliceIndices[z].end());
+	}
+
+	stats.Lights = lightCount;
+	stats.Clusters = (unsigned int)grid.size();
+	stats.Indices = (unsigned int)indices.size();
+	stats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Assigns one depth slice
+//
+// 1. Keep the lights whose depth range overlaps the slice
+//    (four at a time)
+// 2. For each of those, find the rows and columns its
+//    sphere could reach, and test it against those clusters
+//    four at a time:
+//    - sphere vs box: squared distance from the light to
+//      each box, against its squared range
+//    - spot lights must also reach each cluster's bounding
+//      sphere with their cone (angle, front and back tests)
+// 3. Pack the slice's lists in cluster order
+// --------------------------------------------------------
+void LightClusters::AssignSlice(unsigned int z, std::vector<unsigned int>& sliceIndices, std::vector<unsigned int>& sliceCounts)
+{
+	const __m128 zero = _mm_setzero_ps();
+	sliceCounts.assign(gridX * gridY, 0);
+
+	// 1. depth overlap
+	__m128 zNear = _mm_set1_ps(sliceNear[z]);
+	__m128 zFar = _mm_set1_ps(sliceNear[z + 1]);
+	std::vector<unsigned int> inSlice;
+	unsigned int padded = (unsigned int)lightZ.size();
+	for (unsigned int i = 0; i < padded; i += 4) {
+		__m128 lz = _mm_loadu_ps(&lightZ[i]);
+		__m128 r = _mm_loadu_ps(&lightRadius[i]);
+		__m128 overlap = _mm_and_ps(
+			_mm_cmple_ps(_mm_sub_ps(lz, r), zFar),
+			_mm_cmpge_ps(_mm_add_ps(lz, r), zNear));
+		int mask = _mm_movemask_ps(overlap);
+		for (int k = 0; k < 4; k++)
+			if (mask & (1 << k)) inSlice.push_back(i + k);
+	}
+	if (inSlice.empty()) return;
+
+	// the slice's row and column extents, to find each light's range of clusters
+	unsigned int sliceStart = z * gridY * rowStride;
+	std::vector<float> rowMin(gridY, INFINITY), rowMax(gridY, -INFINITY);
+	std::vector<float> columnMin(gridX, INFINITY), columnMax(gridX, -INFINITY);
+	for (unsigned int y = 0; y < gridY; y++) {
+		for (unsigned int x = 0; x < gridX; x++) {
+			unsigned int c = sliceStart + y * rowStride + x;
+			rowMin[y] = std::min(rowMin[y], minY[c]); rowMax[y] = std::max(rowMax[y], maxY[c]);
+			columnMin[x] = std::min(columnMin[x], minX[c]); columnMax[x] = std::max(columnMax[x], maxX[c]);
+		}
+	}
+
+	// 2. clusters each light reaches
+	std::vector<std::vector<unsigned int>> clusterLights(gridX * gridY);
+	for (unsigned int i : inSlice) {
+		float r = lightRadius[i];
+		float lx = lightX[i], ly = lightY[i];
+
+		// rows run top to bottom, columns left to right
+		unsigned int x0 = 0, x1 = gridX, y0 = 0, y1 = gridY;
+		while (x0 < gridX && columnMax[x0] < lx - r) x0++;
+		while (x1 > x0 && columnMin[x1 - 1] > lx + r) x1--;
+		while (y0 < gridY && rowMin[y0] > ly + r) y0++;
+		while (y1 > y0 && rowMax[y1 - 1] < ly - r) y1--;
+		if (x0 >= x1 || y0 >= y1) continue;
+
+		__m128 px = _mm_set1_ps(lx), py = _mm_set1_ps(ly), pz = _mm_set1_ps(lightZ[i]);
+		__m128 r2 = _mm_set1_ps(r * r);
+		bool spot = lightSpot[i] > 0.0f;
+		__m128 dirX = _mm_set1_ps(lightDirX[i]), dirY = _mm_set1_ps(lightDirY[i]), dirZ = _mm_set1_ps(lightDirZ[i]);
+		__m128 cosA = _mm_set1_ps(lightCos[i]), sinA = _mm_set1_ps(lightSin[i]), range = _mm_set1_ps(r);
+
+		for (unsigned int y = y0; y < y1; y++) {
+			unsigned int rowStart = sliceStart + y * rowStride;
+			for (unsigned int x = x0 & ~3u; x < x1; x += 4) {
+				unsigned int c = rowStart + x;
+
+				// sphere vs box
+				__m128 dx = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[c]), px), _mm_sub_ps(px, _mm_loadu_ps(&maxX[c]))));
+				__m128 dy = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[c]), py), _mm_sub_ps(py, _mm_loadu_ps(&maxY[c]))));
+				__m128 dz = _mm_max_ps(zero, _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[c]), pz), _mm_sub_ps(pz, _mm_loadu_ps(&maxZ[c]))));
+				__m128 dist2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				__m128 hit = _mm_cmple_ps(dist2, r2);
+
+				// cone vs the clusters' bounding spheres
+				if (spot && _mm_movemask_ps(hit)) {
+					__m128 sr = _mm_loadu_ps(&sphereRadius[c]);
+					__m128 vx = _mm_sub_ps(_mm_loadu_ps(&sphereX[c]), px);
+					__m128 vy = _mm_sub_ps(_mm_loadu_ps(&sphereY[c]), py);
+					__m128 vz = _mm_sub_ps(_mm_loadu_ps(&sphereZ[c]), pz);
+					__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz));
+					__m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, dirX), _mm_mul_ps(vy, dirY)), _mm_mul_ps(vz, dirZ));
+					__m128 across = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(lenSq, _mm_mul_ps(along, along))));
+					__m128 closest = _mm_sub_ps(_mm_mul_ps(cosA, across), _mm_mul_ps(along, sinA));
+
+					__m128 culled = _mm_or_ps(_mm_or_ps(
+						_mm_cmpgt_ps(closest, sr),
+						_mm_cmpgt_ps(along, _mm_add_ps(sr, range))),
+						_mm_cmplt_ps(along, _mm_sub_ps(zero, sr)));
+					hit = _mm_andnot_ps(culled, hit);
+				}
+
+				int mask = _mm_movemask_ps(hit);
+				for (int k = 0; k < 4; k++)
+					if (mask & (1 << k)) clusterLights[y * gridX + x + k].push_back(i);
+			}
+		}
+	}
+
+	// 3. packed in cluster order
+	for (unsigned int c = 0; c < clusterLights.size(); c++) {
+		sliceCounts[c] = (unsigned int)clusterLights[c].size();
+		sliceIndices.insert(sliceIndices.end(), clusterLights[c].begin(), clusterLights[c].end());
+	}
+}
+
+
+// --------------------------------------------------------
+// GETTERS
+// --------------------------------------------------------
+const std::vector<ClusterRange>& LightClusters::GetGrid() { return grid; }
+const std::vector<unsigned int>& LightClusters::GetIndices() { return indices; }
+LightClusterStats LightClusters::GetStats() { return stats; }
+unsigned int LightClusters::GetGridX() { return gridX; }
+unsigned int LightClusters::GetGridY() { return gridY; }
+unsigned int LightClusters::GetGridZ() { return gridZ; }
+float LightClusters::GetSliceScale() { return sliceScale; }
+float LightClusters::GetSliceBias() { return sliceBias; }
+
+
+// --------------------------------------------------------
+// Times Assign() for a camera at the origin looking down +z
+// (60 degree fov, 16:9, 0.1 to 100) with lights scattered
+// through its frustum; a fifth of them are spot lights.
+// The lights are the same every time (fixed seed).
+// --------------------------------------------------------
+LightClusterBenchmarkResults LightClusters::Benchmark(std::shared_ptr<ThreadPool> pool, unsigned int lightCount,
+	unsigned int gridX, unsigned int gridY, unsigned int gridZ, unsigned int runs)
+{
+	const float nearClip = 0.1f, farClip = 100.0f, aspect = 16.0f / 9.0f;
+	float yScale = 1.0f / tanf(3.14159265f / 6.0f);
+	float view[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+	float projection[16] = {
+		yScale / aspect, 0, 0, 0,
+		0, yScale, 0, 0,
+		0, 0, farClip / (farClip - nearClip), 1,
+		0, 0, -nearClip * farClip / (farClip - nearClip), 0 };
+
+	unsigned int seed = 12345;
+	auto random = [&](float lo, float hi) {
+		seed = seed * 1664525u + 1013904223u;
+		return lo + (hi - lo) * ((seed >> 8) / 16777216.0f);
+	};
+
+	std::vector<ClusterLight> lights(lightCount);
+	for (auto& l : lights) {
+		float z = random(1.0f, farClip);
+		l.Position[0] = random(-1.0f, 1.0f) * z * aspect / yScale;
+		l.Position[1] = random(-1.0f, 1.0f) * z / yScale;
+		l.Position[2] = z;
+		l.Range = random(0.5f, 4.0f);
+		l.Spot = random(0.0f, 1.0f) < 0.2f;
+		float d[3] = { random(-1, 1), random(-1, 1), random(-1, 1) };
+		float len = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) + 0.0001f;
+		for (int k = 0; k < 3; k++) l.Direction[k] = d[k] / len;
+		l.SpotOuterAngle = random(0.2f, 0.8f);
+	}
+
+	LightClusterBenchmarkResults results = {};
+	results.LightCount = lightCount;
+	results.GridX = gridX;
+	results.GridY = gridY;
+	results.GridZ = gridZ;
+	results.Runs = std::max(1u, runs);
+	results.BestMs = INFINITY;
+
+	LightClusters clusters(pool, gridX, gridY, gridZ);
+	clusters.Assign(view, projection, nearClip, farClip, lights);	// warm up (and build the bounds)
+	double total = 0.0;
+	for (unsigned int i = 0; i < results.Runs; i++) {
+		clusters.Assign(view, projection, nearClip, farClip, lights);
+		double ms = clusters.GetStats().Milliseconds;
+		total += ms;
+		results.BestMs = std::min(results.BestMs, ms);
+	}
+	results.AverageMs = total / results.Runs;
+	results.Stats = clusters.GetStats();
+	return results;
+}
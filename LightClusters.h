@@ -0,0 +1,128 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// A point or spot light, as the cluster tests see it
+// (world space)
+// --------------------------------------------------------
+struct ClusterLight
+{
+	float Position[3];
+	float Range;
+	float Direction[3];		// normalized, spot lights only
+	float SpotOuterAngle;	// half angle of the cone, in radians
+	bool Spot;
+};
+
+// --------------------------------------------------------
+// Where one cluster's lights are in the index list
+// (same layout as the shader's uint2)
+// --------------------------------------------------------
+struct ClusterRange
+{
+	unsigned int Offset;
+	unsigned int Count;
+};
+
+struct LightClusterStats
+{
+	unsigned int Lights;
+	unsigned int Clusters;
+	unsigned int Indices;			// light/cluster pairs
+	unsigned int MaxPerCluster;
+	unsigned int EmptyClusters;
+	double Milliseconds;			// last Assign()
+};
+
+struct LightClusterBenchmarkResults
+{
+	unsigned int LightCount;
+	unsigned int GridX, GridY, GridZ;
+	unsigned int Runs;
+	double AverageMs;
+	double BestMs;
+	LightClusterStats Stats;		// from the last run
+};
+
+// --------------------------------------------------------
+// Splits the camera's view frustum into a 3D grid of
+// clusters and works out which lights touch each one
+//
+// - Columns and rows split the screen evenly; slices split
+//   view depth exponentially, so near clusters stay small
+// - Each light is tested against 4 clusters at a time with
+//   SSE: its sphere against the clusters' boxes, and spot
+//   cones against the clusters' bounding spheres
+// - Slices are assigned in parallel on the thread pool, then
+//   packed into one index list (ClusterRange per cluster)
+// - Only depends on the standard library and SSE, so it
+//   can be run and timed without a GPU
+// --------------------------------------------------------
+class LightClusters
+{
+public:
+	/// <summary>
+	/// Creates the grid
+	/// </summary>
+	/// <param name="pool">threads to assign slices on (null for single threaded)</param>
+	LightClusters(std::shared_ptr<ThreadPool> pool, unsigned int gridX = 16, unsigned int gridY = 9, unsigned int gridZ = 24);
+
+	/// <summary>
+	/// Assigns lights to clusters for one camera
+	/// </summary>
+	/// <param name="view">view matrix (16 floats, row vectors, like XMFLOAT4X4)</param>
+	/// <param name="projection">projection matrix (perspective or orthographic)</param>
+	/// <param name="nearClip">camera's near plane</param>
+	/// <param name="farClip">camera's far plane</param>
+	/// <param name="lights">point and spot lights, in world space</param>
+	void Assign(const float* view, const float* projection, float nearClip, float farClip, const std::vector<ClusterLight>& lights);
+
+	// Results of Assign()
+	const std::vector<ClusterRange>& GetGrid();		// x fastest, then y (top row first), then z
+	const std::vector<unsigned int>& GetIndices();	// indices into the lights given to Assign()
+	LightClusterStats GetStats();
+
+	// Grid layout, for the shader
+	unsigned int GetGridX();
+	unsigned int GetGridY();
+	unsigned int GetGridZ();
+	float GetSliceScale();	// slice = log(viewZ) * scale - bias
+	float GetSliceBias();
+
+	/// <summary>
+	/// Times Assign() with random lights in front of a fixed camera
+	/// </summary>
+	static LightClusterBenchmarkResults Benchmark(std::shared_ptr<ThreadPool> pool, unsigned int lightCount,
+		unsigned int gridX = 16, unsigned int gridY = 9, unsigned int gridZ = 24, unsigned int runs = 10);
+
+private:
+	void BuildClusterBounds(const float* projection, float nearClip, float farClip);
+	void AssignSlice(unsigned int z, std::vector<unsigned int>& sliceIndices, std::vector<unsigned int>& sliceCounts);
+
+	std::shared_ptr<ThreadPool> pool;
+	unsigned int gridX, gridY, gridZ;
+
+	// view space bounds of every cluster, rebuilt when the projection changes
+	// - structure of arrays, with each row padded out to a multiple of 4
+	//   clusters (rowStride) by boxes nothing can touch
+	float boundsProjection[16];
+	float boundsNear, boundsFar;
+	unsigned int rowStride;
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	std::vector<float> sliceNear;		// view depth where each slice starts (gridZ + 1 of them)
+	float sliceScale, sliceBias;
+
+	// lights in view space, structure of arrays, padded to a multiple of 4
+	std::vector<float> lightX, lightY, lightZ, lightRadius;
+	std::vector<float> lightDirX, lightDirY, lightDirZ, lightCos, lightSin, lightSpot;
+	unsigned int lightCount;
+
+	std::vector<ClusterRange> grid;
+	std::vector<unsigned int> indices;
+	LightClusterStats stats;
+};
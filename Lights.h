@@ -6,6 +6,10 @@
 #define LIGHT_TYPE_POINT 1
 #define LIGHT_TYPE_SPOT 2
 
+// size of the pixel shader's directional light array
+// (point and spot lights are clustered instead)
+#define MAX_DIRECTIONAL_LIGHTS 4
+
 struct Light {
 
 	int type;						// use definitions above
@@ -22,8 +26,6 @@ struct Light {
 
 struct ShadowOptions {
 	int resolution;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
 
 	float projectionSize;
 	DirectX::XMFLOAT4X4 shadowViewMatrix;
@@ -1,28 +1,60 @@
 #include "Material.h"
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
+bool Material::UseBakedBindings = true;
+
+// --------------------------------------------------------
+// Sorts (register, resource) pairs into a register ordered
+// table, split into runs of consecutive registers
+// --------------------------------------------------------
+template<typename T, typename Run>
+static void BuildBindingRuns(std::vector<std::pair<unsigned int, T*>>& slots, std::vector<T*>& table, std::vector<Run>& runs)
+{
+	std::sort(slots.begin(), slots.end(),
+		[](const std::pair<unsigned int, T*>& a, const std::pair<unsigned int, T*>& b) { return a.first < b.first; });
+
+	table.clear();
+	runs.clear();
+	for (auto& s : slots)
+	{
+		if (runs.empty() || runs.back().StartSlot + runs.back().Count != s.first)
+			runs.push_back({ s.first, 0, (unsigned int)table.size() });
+		runs.back().Count++;
+		table.push_back(s.second);
+	}
+}
 
 
 Material::Material(DirectX::XMFLOAT4 _colorTint, float _roughness, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR vsPath, LPCWSTR psPath, DirectX::XMFLOAT2 scale, DirectX::XMFLOAT2 offset, int useSpecularMap)
 {
 	this->colorTint = _colorTint;
 	this->roughness = _roughness;
+	this->metalness = 0.0f;
 	this->vs = std::make_shared<SimpleVertexShader>(device, context, vsPath);
 	this->ps = std::make_shared<SimplePixelShader>(device, context, psPath);
 	this->uvScale = scale;
 	this->uvOffset = offset;
 	this->useSpecularMap = useSpecularMap;
+	this->features = ShaderFeaturesMaterial & ~(ShaderFeatureTextureArrays | ShaderFeatureORMMap);
+	this->textureLayer = 0;
+	ResolveHandles();
 }
 
 Material::Material(DirectX::XMFLOAT4 _colorTint, float _roughness, std::shared_ptr<SimpleVertexShader> _vs, std::shared_ptr<SimplePixelShader> _ps, DirectX::XMFLOAT2 scale, DirectX::XMFLOAT2 offset, int useSpecularMap)
 {
 	this->colorTint = _colorTint;
 	this->roughness = _roughness;
+	this->metalness = 0.0f;
 	this->vs = _vs;
 	this->ps = _ps;
 	this->uvScale = scale;
 	this->uvOffset = offset;
 	this->useSpecularMap = useSpecularMap;
+	this->features = ShaderFeaturesMaterial & ~(ShaderFeatureTextureArrays | ShaderFeatureORMMap);
+	this->textureLayer = 0;
+	ResolveHandles();
 }
 
 Material::~Material()
@@ -35,9 +67,17 @@ Material::Material(Material& m)
 	this->vs = m.vs;
 	this->ps = m.ps;
 	this->roughness = m.roughness;
+	this->metalness = m.metalness;
 	this->uvScale = m.uvScale;
 	this->uvOffset = m.uvOffset;
 	this->useSpecularMap = m.useSpecularMap;
+	this->textureSRVs = m.textureSRVs;
+	this->samplers = m.samplers;
+	this->psVariants = m.psVariants;
+	this->arraySRVs = m.arraySRVs;
+	this->textureLayer = m.textureLayer;
+	this->features = m.features;
+	ResolveHandles();
 }
 
 DirectX::XMFLOAT4 Material::GetColorTint()
@@ -60,27 +100,50 @@ float Material::GetRoughness()
 	return roughness;
 }
 
+float Material::GetMetalness()
+{
+	return metalness;
+}
+
 void Material::SetColorTint(DirectX::XMFLOAT4 _colorTint)
 {
+	if (memcmp(&colorTint, &_colorTint, sizeof(colorTint)) == 0) return;
 	colorTint = _colorTint;
+	BakeConstants();
 }
 
 void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> _vs)
 {
 	vs = _vs;
+	ResolveHandles();
 }
 
 void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> _ps)
 {
 	ps = _ps;
+	ResolveHandles();
 }
 
 void Material::SetRoughness(float _roughness)
 {
+	if (roughness == _roughness) return;
 	roughness = _roughness;
+	BakeConstants();
+}
+
+void Material::SetMetalness(float _metalness)
+{
+	if (metalness == _metalness) return;
+	metalness = _metalness;
+	BakeConstants();
 }
 
 void Material::PrepareMaterial(std::shared_ptr<Transform> transform, std::shared_ptr<Camera> camera)
+{
+	PrepareMaterial(transform.get(), camera.get());
+}
+
+void Material::PrepareMaterial(Transform* transform, Camera* camera)
 {
 	// copied from the demo
 
@@ -89,34 +152,197 @@ void Material::PrepareMaterial(std::shared_ptr<Transform> transform, std::shared
 	ps->SetShader();
 
 	// send data to the vertex shader
-	vs->SetMatrix4x4("world", transform->GetWorldMatrix());
-	vs->SetMatrix4x4("worldInvTranspose", transform->GetInverseTransposeWorldMatrix());
-	vs->SetMatrix4x4("view", camera->GetView());
-	vs->SetMatrix4x4("projection", camera->GetProjection());
+	vs->SetMatrix4x4(handles.World, transform->GetWorldMatrix());
+	vs->SetMatrix4x4(handles.WorldInvTranspose, transform->GetInverseTransposeWorldMatrix());
+	vs->SetMatrix4x4(handles.View, camera->GetView());
+	vs->SetMatrix4x4(handles.Projection, camera->GetProjection());
 	vs->CopyAllBufferData();
 
 	// send data to the pixel shader
-	ps->SetFloat3("colorTint", DirectX::XMFLOAT3(colorTint.x, colorTint.y, colorTint.z));
-	ps->SetFloat3("camPos", camera->GetTransform()->GetPosition());
-	ps->SetFloat("roughness", roughness);
-	ps->SetFloat2("uvScale", uvScale);
-	ps->SetFloat2("uvOffset", uvOffset);
-	ps->SetInt("useSpecularMap", useSpecularMap);
-	ps->CopyAllBufferData();
+	ps->SetFloat3(handles.CamPos, camera->GetTransform()->GetPosition());
+	if (UseBakedBindings && constantBuffer)
+	{
+		// the shader's own MaterialData is never bound, so it isn't uploaded either
+		for (unsigned int i : frameBuffers) ps->CopyBufferData(i);
+		ps->SetConstantBuffer(constantBufferSlot, constantBuffer.Get());
+	}
+	else
+	{
+		ps->SetFloat3(handles.ColorTint, DirectX::XMFLOAT3(colorTint.x, colorTint.y, colorTint.z));
+		ps->SetFloat(handles.Roughness, roughness);
+		ps->SetFloat2(handles.UVScale, uvScale);
+		ps->SetFloat2(handles.UVOffset, uvOffset);
+		ps->SetInt(handles.UseSpecularMap, useSpecularMap);
+		ps->SetInt(handles.TextureLayer, textureLayer);
+		ps->SetFloat(handles.Metalness, metalness);
+		ps->CopyAllBufferData();
+	}
 
-	// loop through shader resource views and sampler states
-	for (auto& t : textureSRVs) { ps->SetShaderResourceView(t.first.c_str(), t.second.Get()); }
-	for (auto& s : samplers) { ps->SetSamplerState(s.first.c_str(), s.second); }
+	// shader resource views and sampler states
+	if (UseBakedBindings)
+	{
+		for (auto& r : srvRuns) { ps->SetShaderResourceViews(r.StartSlot, r.Count, &srvTable[r.First]); }
+		for (auto& r : samplerRuns) { ps->SetSamplerStates(r.StartSlot, r.Count, &samplerTable[r.First]); }
+	}
+	else
+	{
+		for (auto& t : boundSRVs) { ps->SetShaderResourceView(t.Handle, t.SRV); }
+		for (auto& s : boundSamplers) { ps->SetSamplerState(s.Handle, s.Sampler); }
+	}
 }
 
 void Material::AddTextureSRV(std::string _name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _srv)
 {
 	textureSRVs.insert({ _name, _srv });
+	ResolveHandles();
+}
+
+void Material::SetTextureSRV(const std::string& name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	textureSRVs[name] = srv;
+	ResolveHandles();
 }
 
 void Material::AddSampler(std::string _name, Microsoft::WRL::ComPtr<ID3D11SamplerState> _sampler)
 {
 	samplers.insert({_name, _sampler});
+	ResolveHandles();
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Material::GetTextureSRV(const std::string& name)
+{
+	auto found = textureSRVs.find(name);
+	return found == textureSRVs.end() ? 0 : found->second;
+}
+
+void Material::SetTextureArrays(const std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& arrays, int layer)
+{
+	arraySRVs = arrays;
+	textureLayer = layer;
+	if (arraySRVs.empty())
+		features &= ~ShaderFeatureTextureArrays;
+	ResolveHandles();
+}
+
+bool Material::HasTextureArrays()
+{
+	return !arraySRVs.empty();
+}
+
+int Material::GetTextureLayer()
+{
+	return textureLayer;
+}
+
+// --------------------------------------------------------
+// Looks up everything PrepareMaterial sets in the current
+// shaders, skipping textures and samplers the pixel
+// shader doesn't have (a variant without a normal map)
+// --------------------------------------------------------
+void Material::ResolveHandles()
+{
+	handles = {};
+	handles.World = vs ? vs->GetVariableHandle("world") : SimpleShaderInvalidHandle;
+	handles.WorldInvTranspose = vs ? vs->GetVariableHandle("worldInvTranspose") : SimpleShaderInvalidHandle;
+	handles.View = vs ? vs->GetVariableHandle("view") : SimpleShaderInvalidHandle;
+	handles.Projection = vs ? vs->GetVariableHandle("projection") : SimpleShaderInvalidHandle;
+	handles.ColorTint = ps ? ps->GetVariableHandle("colorTint") : SimpleShaderInvalidHandle;
+	handles.CamPos = ps ? ps->GetVariableHandle("camPos") : SimpleShaderInvalidHandle;
+	handles.Roughness = ps ? ps->GetVariableHandle("roughness") : SimpleShaderInvalidHandle;
+	handles.UVScale = ps ? ps->GetVariableHandle("uvScale") : SimpleShaderInvalidHandle;
+	handles.UVOffset = ps ? ps->GetVariableHandle("uvOffset") : SimpleShaderInvalidHandle;
+	handles.UseSpecularMap = ps ? ps->GetVariableHandle("useSpecularMap") : SimpleShaderInvalidHandle;
+	handles.TextureLayer = ps ? ps->GetVariableHandle("textureLayer") : SimpleShaderInvalidHandle;
+	handles.Metalness = ps ? ps->GetVariableHandle("metalness") : SimpleShaderInvalidHandle;
+
+	boundSRVs.clear();
+	boundSamplers.clear();
+	srvTable.clear();
+	srvRuns.clear();
+	samplerTable.clear();
+	samplerRuns.clear();
+	frameBuffers.clear();
+	constantBufferSlot = -1;
+	if (!ps)
+	{
+		constantBuffer.Reset();
+		return;
+	}
+
+	// the shader decides between the textures and the arrays,
+	// since it only has one or the other under these names
+	std::vector<std::pair<unsigned int, ID3D11ShaderResourceView*>> srvSlots;
+	for (auto* srvs : { &textureSRVs, &arraySRVs })
+	{
+		for (auto& t : *srvs)
+		{
+			SimpleShaderHandle h = ps->GetShaderResourceViewHandle(t.first);
+			if (h == SimpleShaderInvalidHandle) continue;
+			boundSRVs.push_back({ h, t.second.Get() });
+			srvSlots.push_back({ ps->GetShaderResourceViewInfo((unsigned int)h)->BindIndex, t.second.Get() });
+		}
+	}
+	BuildBindingRuns(srvSlots, srvTable, srvRuns);
+
+	std::vector<std::pair<unsigned int, ID3D11SamplerState*>> samplerSlots;
+	for (auto& s : samplers)
+	{
+		SimpleShaderHandle h = ps->GetSamplerHandle(s.first);
+		if (h == SimpleShaderInvalidHandle) continue;
+		boundSamplers.push_back({ h, s.second.Get() });
+		samplerSlots.push_back({ ps->GetSamplerInfo((unsigned int)h)->BindIndex, s.second.Get() });
+	}
+	BuildBindingRuns(samplerSlots, samplerTable, samplerRuns);
+
+	// only shaders laid out the way MaterialConstants expects get the buffer
+	const SimpleConstantBuffer* cb = ps->GetBufferInfo("MaterialData");
+	if (cb && cb->Size == sizeof(MaterialConstants))
+		constantBufferSlot = (int)cb->BindIndex;
+	for (unsigned int i = 0; i < ps->GetBufferCount(); i++)
+		if (constantBufferSlot < 0 || ps->GetBufferInfo(i) != cb)
+			frameBuffers.push_back(i);
+
+	// a baked buffer from the last shader is still good if the layout matches
+	if (constantBufferSlot < 0) constantBuffer.Reset();
+	BakeConstants();
+}
+
+// --------------------------------------------------------
+// (Re)makes the immutable buffer of this material's
+// parameters, if the pixel shader takes one
+// - Does nothing if the buffer already holds them, so
+//   swapping a texture or shader doesn't remake it
+// - If it can't be made, PrepareMaterial falls back to
+//   setting them through the shader
+// --------------------------------------------------------
+void Material::BakeConstants()
+{
+	if (constantBufferSlot < 0) return;
+
+	MaterialConstants data = {};
+	data.ColorTint = DirectX::XMFLOAT3(colorTint.x, colorTint.y, colorTint.z);
+	data.Roughness = roughness;
+	data.UVScale = uvScale;
+	data.UVOffset = uvOffset;
+	data.UseSpecularMap = useSpecularMap;
+	data.TextureLayer = textureLayer;
+	data.Metalness = metalness;
+	if (constantBuffer && memcmp(&data, &bakedConstants, sizeof(data)) == 0) return;
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = sizeof(MaterialConstants);
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	D3D11_SUBRESOURCE_DATA initial = {};
+	initial.pSysMem = &data;
+
+	constantBuffer.Reset();
+	if (FAILED(ps->GetDevice()->CreateBuffer(&desc, &initial, constantBuffer.GetAddressOf())))
+	{
+		constantBuffer.Reset();
+		return;
+	}
+	bakedConstants = data;
 }
 
 DirectX::XMFLOAT2 Material::GetUVOffset()
@@ -126,7 +352,9 @@ DirectX::XMFLOAT2 Material::GetUVOffset()
 
 void Material::SetUVOffset(DirectX::XMFLOAT2 offset)
 {
+	if (uvOffset.x == offset.x && uvOffset.y == offset.y) return;
 	uvOffset = offset;
+	BakeConstants();
 }
 
 DirectX::XMFLOAT2 Material::GetUVScale()
@@ -136,6 +364,42 @@ DirectX::XMFLOAT2 Material::GetUVScale()
 
 void Material::SetUVScale(DirectX::XMFLOAT2 scale)
 {
+	if (uvScale.x == scale.x && uvScale.y == scale.y) return;
 	uvScale = scale;
+	BakeConstants();
 }
 
+void Material::SetShaderVariants(std::shared_ptr<PixelShaderVariants> variants, unsigned int features)
+{
+	psVariants = variants;
+	SetFeatures(features);
+}
+
+unsigned int Material::GetFeatures()
+{
+	return features;
+}
+
+void Material::SetFeatures(unsigned int features)
+{
+	this->features = features & ShaderFeaturesMaterial;
+	if (arraySRVs.empty())
+		this->features &= ~ShaderFeatureTextureArrays;
+}
+
+// --------------------------------------------------------
+// Switches to the pixel shader variant with this
+// material's features and the frame's (lights, shadows)
+// - Does nothing without variants, so SetPixelShader
+//   still works for one-off shaders
+// --------------------------------------------------------
+void Material::SelectVariant(unsigned int frameFeatures)
+{
+	if (!psVariants) return;
+	std::shared_ptr<SimplePixelShader> variant = psVariants->Get(features | (frameFeatures & ShaderFeaturesFrame));
+	if (variant != ps)
+	{
+		ps = variant;
+		ResolveHandles();
+	}
+}
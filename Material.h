@@ -2,12 +2,30 @@
 #include <DirectXMath.h>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 #include "SimpleShader.h"
+#include "D3D11ShaderVariants.h"
 #include "Transform.h"
 #include "Camera.h"
 
 
 
+// --------------------------------------------------------
+// What the pixel shader's MaterialData cbuffer holds
+// (HLSL packing: 16 byte rows, padded to a whole row)
+// --------------------------------------------------------
+struct MaterialConstants
+{
+	DirectX::XMFLOAT3 ColorTint;
+	float Roughness;
+	DirectX::XMFLOAT2 UVScale;
+	DirectX::XMFLOAT2 UVOffset;
+	int UseSpecularMap;
+	int TextureLayer;
+	float Metalness;			// used when there's no metalness (or ORM) map
+	float Padding;
+};
+
 class Material
 {
 private:
@@ -15,6 +33,7 @@ private:
 	std::shared_ptr<SimpleVertexShader> vs;
 	std::shared_ptr<SimplePixelShader> ps;
 	float roughness;
+	float metalness;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
 
@@ -22,6 +41,61 @@ private:
 	DirectX::XMFLOAT2 uvOffset;
 	int useSpecularMap;
 
+	// the same textures packed into arrays shared with other materials
+	// (see TextureArrayPlanner), used by variants with texture arrays on
+	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> arraySRVs;
+	int textureLayer;
+
+	// shader variants this material picks its pixel shader from (optional)
+	std::shared_ptr<PixelShaderVariants> psVariants;
+	unsigned int features;		// ShaderFeature bits the material has data for
+
+	// handles into vs and ps, looked up whenever either changes so
+	// PrepareMaterial never hashes a name (and can run on any thread)
+	struct ShaderHandles
+	{
+		SimpleShaderHandle World;
+		SimpleShaderHandle WorldInvTranspose;
+		SimpleShaderHandle View;
+		SimpleShaderHandle Projection;
+		SimpleShaderHandle ColorTint;
+		SimpleShaderHandle CamPos;
+		SimpleShaderHandle Roughness;
+		SimpleShaderHandle UVScale;
+		SimpleShaderHandle UVOffset;
+		SimpleShaderHandle UseSpecularMap;
+		SimpleShaderHandle TextureLayer;
+		SimpleShaderHandle Metalness;
+	};
+	struct BoundSRV { SimpleShaderHandle Handle; ID3D11ShaderResourceView* SRV; };
+	struct BoundSampler { SimpleShaderHandle Handle; ID3D11SamplerState* Sampler; };
+	ShaderHandles handles;
+	std::vector<BoundSRV> boundSRVs;			// textureSRVs the ps has
+	std::vector<BoundSampler> boundSamplers;	// samplers the ps has
+
+	// the same textures and samplers in register order, so each run of
+	// consecutive registers binds with one call (usually a single run)
+	struct BindingRun
+	{
+		unsigned int StartSlot;
+		unsigned int Count;
+		unsigned int First;		// into the table
+	};
+	std::vector<ID3D11ShaderResourceView*> srvTable;
+	std::vector<BindingRun> srvRuns;
+	std::vector<ID3D11SamplerState*> samplerTable;
+	std::vector<BindingRun> samplerRuns;
+
+	// colorTint, roughness, metalness, uv and useSpecularMap, baked into an immutable
+	// buffer (remade when one of them changes) when the ps has MaterialData
+	Microsoft::WRL::ComPtr<ID3D11Buffer> constantBuffer;
+	MaterialConstants bakedConstants;		// what constantBuffer holds
+	int constantBufferSlot;		// -1 if the ps has no MaterialData
+	std::vector<unsigned int> frameBuffers;	// the ps's other buffers, uploaded per draw
+
+	void ResolveHandles();
+	void BakeConstants();
+
 public:
 	Material(DirectX::XMFLOAT4 _colorTint, float _roughness, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, LPCWSTR vsPath, LPCWSTR psPath, DirectX::XMFLOAT2 scale, DirectX::XMFLOAT2 offset, int useSpecularMap);
 	Material(DirectX::XMFLOAT4 _colorTint, float _roughness, std::shared_ptr<SimpleVertexShader> _vs, std::shared_ptr<SimplePixelShader> _ps, DirectX::XMFLOAT2 scale, DirectX::XMFLOAT2 offset, int useSpecularMap);
@@ -32,19 +106,44 @@ public:
 	std::shared_ptr<SimpleVertexShader> GetVertexShader();
 	std::shared_ptr<SimplePixelShader> GetPixelShader();
 	float GetRoughness();
+	float GetMetalness();
 
 	void SetColorTint(DirectX::XMFLOAT4 _colorTint);
 	void SetVertexShader(std::shared_ptr<SimpleVertexShader> _vs);
 	void SetPixelShader(std::shared_ptr<SimplePixelShader> _ps);
 	void SetRoughness(float _roughness);
+	void SetMetalness(float _metalness);
 
 	void PrepareMaterial(std::shared_ptr<Transform> transform, std::shared_ptr<Camera> camera);
+	void PrepareMaterial(Transform* transform, Camera* camera);
 	void AddTextureSRV(std::string _name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> _srv);
+	void SetTextureSRV(const std::string& name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);	// replaces one (a streamed texture's new SRV)
 	void AddSampler(std::string _name, Microsoft::WRL::ComPtr<ID3D11SamplerState> _sampler);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetTextureSRV(const std::string& name);
+
+	// Texture arrays
+	// - arrays are named like the shader's (AlbedoArray, ...), and
+	//   the layer is this material's in all of them
+	// - ShaderFeatureTextureArrays can only be on once they're set
+	void SetTextureArrays(const std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>& arrays, int layer);
+	bool HasTextureArrays();
+	int GetTextureLayer();
 
 	DirectX::XMFLOAT2 GetUVOffset();
 	void SetUVOffset(DirectX::XMFLOAT2 offset);
 	DirectX::XMFLOAT2 GetUVScale();
 	void SetUVScale(DirectX::XMFLOAT2 scale);
+
+	// Shader variants
+	// - features are the material's own (ShaderFeaturesMaterial bits)
+	// - SelectVariant picks the pixel shader for those plus the frame's
+	void SetShaderVariants(std::shared_ptr<PixelShaderVariants> variants, unsigned int features);
+	unsigned int GetFeatures();
+	void SetFeatures(unsigned int features);
+	void SelectVariant(unsigned int frameFeatures);
+
+	// Whether PrepareMaterial uses the baked tables and constant buffer
+	// (on), or sets everything through the shaders one at a time (off)
+	static bool UseBakedBindings;
 };
 
@@ -1,12 +1,58 @@
 #include "Mesh.h"
+#include <cstdlib>
+#include <initializer_list>
+#include <filesystem>
 #include <fstream>
 
 using namespace DirectX;
 
-Mesh::Mesh(const char* _name, Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices)
+namespace
+{
+	// Reads whitespace separated floats into values, stopping at the first
+	// that isn't there; returns how many it read
+	int ReadFloats(const char* text, std::initializer_list<float*> values)
+	{
+		int read = 0;
+		for (float* value : values) {
+			char* end;
+			float f = strtof(text, &end);
+			if (end == text) break;
+			*value = f;
+			text = end;
+			read++;
+		}
+		return read;
+	}
+
+	// Reads up to four face corners, "p/t/n" with UVs or "p//n" without, into
+	// i (three per corner, t left alone without UVs); like the pattern it stands
+	// in for, it stops at the first number that isn't there and returns the count
+	int ReadFace(const char* text, bool withUVs, unsigned int i[12])
+	{
+		int read = 0;
+		for (int corner = 0; corner < 4; corner++) {
+			for (int n = 0; n < 3; n++) {
+				if (n == 1 && !withUVs) continue;
+				if (n > 0) {
+					if (*text++ != '/') return read;
+					if (!withUVs && *text++ != '/') return read;
+				}
+				char* end;
+				long value = strtol(text, &end, 10);
+				if (end == text) return read;
+				i[corner * 3 + n] = (unsigned int)value;
+				text = end;
+				read++;
+			}
+		}
+		return read;
+	}
+}
+
+Mesh::Mesh(const char* _name, Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, bool calculateTangents)
 {
 	name = _name;
-	CreateBuffers(vertArray, numVerts, indexArray, numIndices);
+	CreateBuffers(vertArray, numVerts, indexArray, numIndices, calculateTangents);
 }
 
 Mesh::Mesh(const char* name, const std::wstring& filePath)
@@ -23,11 +69,13 @@ Mesh::Mesh(const char* name, const std::wstring& filePath)
 	this->name = name;
 	indices = 0;
 	verts = 0;
-	indexBuff = Microsoft::WRL::ComPtr<ID3D11Buffer>();
-	vertBuff = Microsoft::WRL::ComPtr<ID3D11Buffer>();
+	device = 0;
+	indexBuff = 0;
+	vertBuff = 0;
+	indexFormat = RenderIndexFormat::UInt32;
 
 	// File input object
-	std::ifstream obj(filePath);
+	std::ifstream obj{ std::filesystem::path(filePath) };
 
 	// Check for successful open
 	if (!obj.is_open())
@@ -38,7 +86,7 @@ Mesh::Mesh(const char* name, const std::wstring& filePath)
 	std::vector<XMFLOAT3> normals;		// Normals from the file
 	std::vector<XMFLOAT2> uvs;		// UVs from the file
 	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indcs;		// Indices of these verts
+	std::vector<unsigned int> indcs;		// Indices of these verts
 	int vertCounter = 0;			// Count of vertices
 	int indexCounter = 0;			// Count of indices
 	char chars[100];			// String for line reading
@@ -54,10 +102,7 @@ Mesh::Mesh(const char* name, const std::wstring& filePath)
 		{
 			// Read the 3 numbers directly into an XMFLOAT3
 			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
+			ReadFloats(chars + 2, { &norm.x, &norm.y, &norm.z });
 
 			// Add to the list of normals
 			normals.push_back(norm);
@@ -66,10 +111,7 @@ Mesh::Mesh(const char* name, const std::wstring& filePath)
 		{
 			// Read the 2 numbers directly into an XMFLOAT2
 			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
+			ReadFloats(chars + 2, { &uv.x, &uv.y });
 
 			// Add to the list of uv's
 			uvs.push_back(uv);
@@ -78,10 +120,7 @@ Mesh::Mesh(const char* name, const std::wstring& filePath)
 		{
 			// Read the 3 numbers directly into an XMFLOAT3
 			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
+			ReadFloats(chars + 1, { &pos.x, &pos.y, &pos.z });
 
 			// Add to the positions
 			positions.push_back(pos);
@@ -92,13 +131,7 @@ Mesh::Mesh(const char* name, const std::wstring& filePath)
 			// NOTE: This assumes the given obj file contains
 			//  vertex positions, uv coordinates AND normals.
 			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
+			int numbersRead = ReadFace(chars + 1, true, i);
 
 			// If we only got the first number, chances are the OBJ
 			// file has no UV coordinates.  This isn't great, but we
@@ -108,13 +141,7 @@ Mesh::Mesh(const char* name, const std::wstring& filePath)
 			if (numbersRead == 1)
 			{
 				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
+				numbersRead = ReadFace(chars + 1, false, i);
 
 				// The following indices are where the UVs should 
 				// have been, so give them a valid value
@@ -316,14 +343,19 @@ void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices,
 
 Mesh::~Mesh()
 {
+	if (device) {
+		device->ReleaseBuffer(vertBuff);
+		device->ReleaseBuffer(indexBuff);
+		device->ReleaseBuffer(posBuff);
+	}
 }
 
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
+RenderBufferHandle Mesh::GetVertexBuffer()
 {
 	return vertBuff;
 }
 
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
+RenderBufferHandle Mesh::GetIndexBuffer()
 {
 	return indexBuff;
 }
@@ -343,61 +375,97 @@ unsigned int Mesh::GetIndexCount()
 	return indices;
 }
 
+DirectX::BoundingBox Mesh::GetBounds()
+{
+	return bounds;
+}
+
+const std::vector<Vertex>& Mesh::GetVertexData()
+{
+	return vertexData;
+}
+
+const std::vector<unsigned int>& Mesh::GetIndexData()
+{
+	return indexData;
+}
+
+RenderIndexFormat Mesh::GetIndexFormat()
+{
+	return indexFormat;
+}
+
+RenderBufferHandle Mesh::GetPositionBuffer()
+{
+	return posBuff;
+}
+
 void Mesh::Draw()
 {
-	UINT stride = sizeof(Vertex); // how far each jump in looking at mem locations is
-	UINT offset = 0;
+	Draw(device->GetImmediateContext());
+}
+
+void Mesh::Draw(IRenderContext* context)
+{
+	unsigned int stride = sizeof(Vertex); // how far each jump in looking at mem locations is
+	unsigned int offset = 0;
 	// set active buffers
-	Graphics::Context->IASetVertexBuffers(0, 1, vertBuff.GetAddressOf(), &stride, &offset);
-	Graphics::Context->IASetIndexBuffer(indexBuff.Get(), DXGI_FORMAT_R32_UINT, 0);
+	context->SetVertexBuffer(vertBuff, stride, offset);
+	context->SetIndexBuffer(indexBuff, indexFormat);
 
 	// now draw it
-	Graphics::Context->DrawIndexed(this->indices, 0, 0);
+	context->DrawIndexed(this->indices, 0, 0);
 }
 
-void Mesh::CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices)
+void Mesh::DrawDepthOnly(IRenderContext* context)
+{
+	// 12 bytes a vertex instead of 44, same indices
+	context->SetVertexBuffer(posBuff, sizeof(DirectX::XMFLOAT3), 0);
+	context->SetIndexBuffer(indexBuff, indexFormat);
+	context->DrawIndexed(this->indices, 0, 0);
+}
+
+void Mesh::CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, bool calculateTangents)
 {
 	// Ensure its being called just before creating the actual Direct3D buffers, regardless of whether youre 
 	// loading data from a file or just providing arrays of vertex & index data to the Mesh constructor.
-	CalculateTangents(vertArray, numVerts, indexArray, numIndices);
+	if (calculateTangents)
+		CalculateTangents(vertArray, (int)numVerts, indexArray, (int)numIndices);
 
 	verts = (unsigned int)numVerts;
 	indices = (unsigned int)numIndices;
 
-	// create vertex buffer
-	{
-		D3D11_BUFFER_DESC vbd = {};
-		vbd.Usage = D3D11_USAGE_IMMUTABLE;
-		vbd.ByteWidth = sizeof(Vertex) * (UINT)numVerts;
-		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		vbd.CPUAccessFlags = 0;
-		vbd.MiscFlags = 0;
-		vbd.StructureByteStride = 0;
-
-		// create struct to hold initial vertex data
-		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertArray;
-
-		// actually create the buffer
-		Graphics::Device->CreateBuffer(&vbd, &initialVertexData, vertBuff.GetAddressOf());
+	// local bounds for culling
+	BoundingBox::CreateFromPoints(bounds, numVerts, &vertArray[0].Position, sizeof(Vertex));
+
+	// keep the data around so meshes can be merged later (see StaticBatcher)
+	vertexData.assign(vertArray, vertArray + numVerts);
+	indexData.assign(indexArray, indexArray + numIndices);
+
+	// half the index memory whenever 16 bits can reach every vertex
+	std::vector<unsigned short> shortIndices;
+	indexFormat = RenderIndexFormat::UInt32;
+	if (numVerts <= 0x10000) {
+		indexFormat = RenderIndexFormat::UInt16;
+		shortIndices.assign(indexArray, indexArray + numIndices);
 	}
 
-	// create index buffer
-	{
-		D3D11_BUFFER_DESC ibd = {};
-		ibd.Usage = D3D11_USAGE_IMMUTABLE;
-		ibd.ByteWidth = sizeof(unsigned int) * (UINT)numIndices; // are unsigned int and UINT different???????? 
-		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		ibd.CPUAccessFlags = 0;
-		ibd.MiscFlags = 0;
-		ibd.StructureByteStride = 0;
+	// buffers go through whichever backend is current (D3D11, or null when headless)
+	device = Render::GetDevice();
 
-		// create struct to hold initial vertex data
-		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indexArray;
+	// create vertex buffer
+	vertBuff = device->CreateBuffer(RenderBufferType::Vertex, vertArray, sizeof(Vertex) * (unsigned int)numVerts, true);
 
-		// actually create the buffer
-		Graphics::Device->CreateBuffer(&ibd, &initialIndexData, indexBuff.GetAddressOf());
+	// and the positions again on their own, so depth-only passes
+	// don't fetch normals, tangents and uvs they'd throw away
+	std::vector<DirectX::XMFLOAT3> positions(numVerts);
+	for (size_t i = 0; i < numVerts; i++)
+		positions[i] = vertArray[i].Position;
+	posBuff = device->CreateBuffer(RenderBufferType::Vertex, &positions[0], sizeof(DirectX::XMFLOAT3) * (unsigned int)numVerts, true);
 
-	}
+	// create index buffer
+	if (indexFormat == RenderIndexFormat::UInt16)
+		indexBuff = device->CreateBuffer(RenderBufferType::Index, &shortIndices[0], sizeof(unsigned short) * (unsigned int)numIndices, true);
+	else
+		indexBuff = device->CreateBuffer(RenderBufferType::Index, indexArray, sizeof(unsigned int) * (unsigned int)numIndices, true);
 }
@@ -1,10 +1,10 @@
 #pragma once
-#include <d3d11.h>
-#include <wrl/client.h>
+#include <DirectXCollision.h>
+#include <string>
 #include <vector>
 #include <memory>
 #include "Vertex.h"
-#include "Graphics.h"
+#include "RenderInterface.h"
 
 class Mesh
 {
@@ -17,7 +17,8 @@ public:
 	/// <param name="numVerts">number of vertices</param>
 	/// <param name="indexArray">index array</param>
 	/// <param name="numIndices">number of indices</param>
-	Mesh(const char* name, Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices);
+	/// <param name="calculateTangents">false if the vertices already have tangents</param>
+	Mesh(const char* name, Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, bool calculateTangents = true);
 	
 	Mesh(const char* name, const std::wstring& filePath);
 	/// <summary>
@@ -26,16 +27,28 @@ public:
 	~Mesh();
 
 	/// <summary>
-	/// Get pointer to Vertex Buffer
+	/// Meshes own their buffers, so they can't be copied
 	/// </summary>
-	/// <returns>vertex buffer pointer</returns>
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
+	Mesh(const Mesh&) = delete;
+	Mesh& operator=(const Mesh&) = delete;
 
 	/// <summary>
-	/// Get pointer to Index Buffer
+	/// Get handle to Vertex Buffer
 	/// </summary>
-	/// <returns>index buffer pointer</returns>
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
+	/// <returns>vertex buffer handle</returns>
+	RenderBufferHandle GetVertexBuffer();
+
+	/// <summary>
+	/// Get handle to Index Buffer
+	/// </summary>
+	/// <returns>index buffer handle</returns>
+	RenderBufferHandle GetIndexBuffer();
+
+	/// <summary>
+	/// Get handle to the position-only vertex buffer
+	/// </summary>
+	/// <returns>buffer of XMFLOAT3 positions, parallel to the vertex buffer</returns>
+	RenderBufferHandle GetPositionBuffer();
 
 	/// <summary>
 	/// Mesh name
@@ -55,17 +68,60 @@ public:
 	/// <returns>int number of indices</returns>
 	unsigned int GetIndexCount();
 
+	/// <summary>
+	/// Local space bounding box around every vertex
+	/// </summary>
+	/// <returns>axis-aligned bounds</returns>
+	DirectX::BoundingBox GetBounds();
+
+	/// <summary>
+	/// CPU copy of the vertices, for building other meshes from this one
+	/// </summary>
+	/// <returns>vertices, tangents included</returns>
+	const std::vector<Vertex>& GetVertexData();
+
+	/// <summary>
+	/// CPU copy of the indices (always 32 bit, whatever the GPU buffer uses)
+	/// </summary>
+	/// <returns>indices</returns>
+	const std::vector<unsigned int>& GetIndexData();
+
+	/// <summary>
+	/// Format of the GPU index buffer
+	/// </summary>
+	/// <returns>UInt16 when every vertex can be addressed with 16 bits, otherwise UInt32</returns>
+	RenderIndexFormat GetIndexFormat();
+
 	/// <summary>
 	/// draw this mesh to the screen
 	/// </summary>
 	void Draw();
 
+	/// <summary>
+	/// draw this mesh using a specific (possibly deferred) context
+	/// </summary>
+	/// <param name="context">context to record the draw into</param>
+	void Draw(IRenderContext* context);
+
+	/// <summary>
+	/// draw just the positions, for depth-only passes (shadows)
+	/// - the vertex shader's input layout must be POSITION alone
+	/// </summary>
+	/// <param name="context">context to record the draw into</param>
+	void DrawDepthOnly(IRenderContext* context);
+
 private:
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertBuff;	// vertex buffer
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuff;	// index buffer
+	IRenderDevice* device;			// device the buffers belong to
+	RenderBufferHandle vertBuff;	// vertex buffer
+	RenderBufferHandle indexBuff;	// index buffer
+	RenderBufferHandle posBuff;		// positions only, for depth-only draws
 	const char* name;		// name of mesh
 	int indices;			// number of indices
 	int verts;				// number of vertices
+	DirectX::BoundingBox bounds;	// local space bounds
+	RenderIndexFormat indexFormat;	// 16 bit indices when they fit
+	std::vector<Vertex> vertexData;			// CPU copies of what went into the buffers
+	std::vector<unsigned int> indexData;
 
 	/// <summary>
 	/// Creates the vertex and index buffers
@@ -74,7 +130,8 @@ private:
 	/// <param name="numVerts">number of vertices</param>
 	/// <param name="indexArray">index array</param>
 	/// <param name="numIndices">number of indices</param>
-	void CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices);
+	/// <param name="calculateTangents">false if the vertices already have tangents</param>
+	void CreateBuffers(Vertex* vertArray, size_t numVerts, unsigned int* indexArray, size_t numIndices, bool calculateTangents = true);
 
 	/// <summary>
 	/// Calculates Vertex tangents oriented towards the U direction of uvs
@@ -0,0 +1,345 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <emmintrin.h>
+
+namespace
+{
+	const float Pi = 3.14159265358979f;
+
+	// For each output texel along one axis, the input texels it reads and their weights
+	struct FilterTaps
+	{
+		std::vector<unsigned int> Start;	// into Index and Weight
+		std::vector<unsigned int> Count;
+		std::vector<unsigned int> Index;
+		std::vector<float> Weight;
+	};
+
+	float Sinc(float x)
+	{
+		if (fabsf(x) < 1e-5f) return 1.0f;
+		x *= Pi;
+		return sinf(x) / x;
+	}
+
+	// Modified Bessel function of the first kind, order 0 (power series)
+	float BesselI0(float x)
+	{
+		float sum = 1.0f, term = 1.0f;
+		for (int k = 1; k < 20; k++) {
+			float t = x / (2.0f * k);
+			term *= t * t;
+			sum += term;
+		}
+		return sum;
+	}
+
+	// Half the width of a filter, in output texels
+	float FilterRadius(MipFilter filter)
+	{
+		return filter == MipFilterBox ? 0.5f : 3.0f;
+	}
+
+	float FilterWeight(MipFilter filter, float x)
+	{
+		x = fabsf(x);
+		switch (filter) {
+		case MipFilterKaiser: {
+			if (x >= 3.0f) return 0.0f;
+			float t = x / 3.0f;
+			return Sinc(x) * BesselI0(4.0f * sqrtf(1.0f - t * t)) / BesselI0(4.0f);
+		}
+		case MipFilterLanczos:
+			return x < 3.0f ? Sinc(x) * Sinc(x / 3.0f) : 0.0f;
+		default:
+			return x < 0.5f ? 1.0f : 0.0f;
+		}
+	}
+
+	FilterTaps BuildTaps(unsigned int from, unsigned int to, MipFilter filter, bool clamp)
+	{
+		FilterTaps taps;
+		float scale = (float)from / to;
+		float radius = FilterRadius(filter) * scale;
+		for (unsigned int d = 0; d < to; d++) {
+			unsigned int begin = (unsigned int)taps.Index.size();
+			taps.Start.push_back(begin);
+
+			// a side that's already 1 texel just carries over
+			if (from == to) {
+				taps.Index.push_back(d);
+				taps.Weight.push_back(1.0f);
+				taps.Count.push_back(1);
+				continue;
+			}
+
+			float center = (d + 0.5f) * scale - 0.5f;
+			float total = 0.0f;
+			for (int s = (int)floorf(center - radius); s <= (int)ceilf(center + radius); s++) {
+				float w = FilterWeight(filter, (s - center) / scale);
+				if (w == 0.0f) continue;
+				int i = clamp ? std::clamp(s, 0, (int)from - 1) : ((s % (int)from) + (int)from) % (int)from;
+				taps.Index.push_back((unsigned int)i);
+				taps.Weight.push_back(w);
+				total += w;
+			}
+			for (size_t k = begin; k < taps.Index.size(); k++) taps.Weight[k] /= total;
+			taps.Count.push_back((unsigned int)taps.Index.size() - begin);
+		}
+		return taps;
+	}
+
+	// Runs body(first, end) over blocks of rows, on the pool when there is one
+	void ForRows(ThreadPool* pool, unsigned int rows, const std::function<void(unsigned int, unsigned int)>& body)
+	{
+		const unsigned int block = 16;
+		unsigned int blocks = (rows + block - 1) / block;
+		auto job = [&](unsigned int b) { body(b * block, std::min(rows, (b + 1) * block)); };
+		if (pool && blocks > 1) pool->ParallelFor(blocks, job);
+		else for (unsigned int b = 0; b < blocks; b++) job(b);
+	}
+
+	// sRGB <-> linear, both ways through tables (the exact curve, not 2.2)
+	struct SRGBTables
+	{
+		static const unsigned int EncodeSize = 8192;
+		float Decode[256];
+		unsigned char Encode[EncodeSize];
+
+		SRGBTables()
+		{
+			for (unsigned int i = 0; i < 256; i++) {
+				float c = i / 255.0f;
+				Decode[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (unsigned int i = 0; i < EncodeSize; i++) {
+				float l = (i + 0.5f) / EncodeSize;
+				float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+				Encode[i] = (unsigned char)std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f);
+			}
+		}
+
+		unsigned char ToSRGB(float linear) const
+		{
+			return Encode[(unsigned int)(std::clamp(linear, 0.0f, 1.0f) * (EncodeSize - 1))];
+		}
+	};
+
+	const SRGBTables& GetSRGBTables()
+	{
+		static const SRGBTables tables;
+		return tables;
+	}
+
+	// Share of texels whose alpha (scaled) reaches the cutoff
+	float Coverage(const float* texels, size_t count, float scale, float cutoff)
+	{
+		size_t covered = 0;
+		for (size_t i = 0; i < count; i++)
+			if (std::min(1.0f, texels[i * 4 + 3] * scale) >= cutoff) covered++;
+		return count ? (float)covered / count : 0.0f;
+	}
+
+	// One level down: across each row, then down each column
+	void Downsample(const std::vector<float>& source, unsigned int width, unsigned int height,
+		std::vector<float>& result, unsigned int newWidth, unsigned int newHeight, const MipOptions& options, ThreadPool* pool)
+	{
+		FilterTaps across = BuildTaps(width, newWidth, options.Filter, options.ClampEdges);
+		FilterTaps down = BuildTaps(height, newHeight, options.Filter, options.ClampEdges);
+
+		std::vector<float> narrowed((size_t)newWidth * height * 4);
+		ForRows(pool, height, [&](unsigned int first, unsigned int end) {
+			for (unsigned int y = first; y < end; y++) {
+				const float* src = &source[(size_t)y * width * 4];
+				float* dst = &narrowed[(size_t)y * newWidth * 4];
+				for (unsigned int x = 0; x < newWidth; x++) {
+					const unsigned int* index = &across.Index[across.Start[x]];
+					const float* weight = &across.Weight[across.Start[x]];
+					__m128 sum = _mm_setzero_ps();
+					for (unsigned int k = 0; k < across.Count[x]; k++)
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(src + (size_t)index[k] * 4), _mm_set1_ps(weight[k])));
+					_mm_storeu_ps(dst + (size_t)x * 4, sum);
+				}
+			}
+		});
+
+		// whole rows at a time, so the reads run along memory
+		result.assign((size_t)newWidth * newHeight * 4, 0.0f);
+		ForRows(pool, newHeight, [&](unsigned int first, unsigned int end) {
+			for (unsigned int y = first; y < end; y++) {
+				float* dst = &result[(size_t)y * newWidth * 4];
+				for (unsigned int k = 0; k < down.Count[y]; k++) {
+					const float* src = &narrowed[(size_t)down.Index[down.Start[y] + k] * newWidth * 4];
+					__m128 weight = _mm_set1_ps(down.Weight[down.Start[y] + k]);
+					for (unsigned int x = 0; x < newWidth * 4; x += 4)
+						_mm_storeu_ps(dst + x, _mm_add_ps(_mm_loadu_ps(dst + x), _mm_mul_ps(_mm_loadu_ps(src + x), weight)));
+				}
+			}
+		});
+	}
+
+	// Filtered floats back to 8 bits (renormalizing normals, re-encoding sRGB)
+	void Encode(const std::vector<float>& texels, unsigned int width, unsigned int height, const MipOptions& options,
+		float alphaScale, DecodedImage& image, std::vector<float>* variance, ThreadPool* pool)
+	{
+		const SRGBTables& srgb = GetSRGBTables();
+		image.Width = width;
+		image.Height = height;
+		image.Pixels.resize((size_t)width * height * 4);
+		if (variance) variance->resize((size_t)width * height);
+
+		const __m128 scale = _mm_set_ps(255.0f * alphaScale, 255.0f, 255.0f, 255.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 top = _mm_set1_ps(255.0f);
+		ForRows(pool, height, [&](unsigned int first, unsigned int end) {
+			for (size_t i = (size_t)first * width; i < (size_t)end * width; i++) {
+				const float* t = &texels[i * 4];
+				__m128 v = _mm_loadu_ps(t);
+				if (options.NormalMap) {
+					// how short the averaged normal is says how much its normals disagreed
+					float length = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+					if (variance) (*variance)[i] = length > 1e-6f ? std::max(0.0f, (1.0f - length) / length) : 1.0f;
+					__m128 n = length > 1e-6f ? _mm_mul_ps(v, _mm_set1_ps(1.0f / length)) : _mm_set_ps(0.0f, 1.0f, 0.0f, 0.0f);
+					v = _mm_add_ps(_mm_mul_ps(n, half), half);
+					v = _mm_set_ps(t[3], _mm_cvtss_f32(_mm_shuffle_ps(v, v, 2)), _mm_cvtss_f32(_mm_shuffle_ps(v, v, 1)), _mm_cvtss_f32(v));
+				}
+
+				__m128i ints = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(v, scale), half), zero), top));
+				ints = _mm_packs_epi32(ints, ints);
+				int packed = _mm_cvtsi128_si32(_mm_packus_epi16(ints, ints));
+				unsigned char* p = &image.Pixels[i * 4];
+				memcpy(p, &packed, 4);
+				if (options.SRGB && !options.NormalMap) {
+					p[0] = srgb.ToSRGB(t[0]);
+					p[1] = srgb.ToSRGB(t[1]);
+					p[2] = srgb.ToSRGB(t[2]);
+				}
+			}
+		});
+	}
+}
+
+
+// --------------------------------------------------------
+// Generating
+// --------------------------------------------------------
+MipChain MipGenerator::Generate(const DecodedImage& image, const MipOptions& options, ThreadPool* pool)
+{
+	MipChain chain;
+	unsigned int width = image.Width, height = image.Height;
+	if (width == 0 || height == 0 || image.Pixels.size() < (size_t)width * height * 4) return chain;
+
+	// the image as floats: linear color, or vectors in [-1, 1]
+	const SRGBTables& srgb = GetSRGBTables();
+	std::vector<float> level((size_t)width * height * 4);
+	ForRows(pool, height, [&](unsigned int first, unsigned int end) {
+		for (size_t i = (size_t)first * width * 4; i < (size_t)end * width * 4; i++) {
+			unsigned char b = image.Pixels[i];
+			bool color = (i & 3) != 3;
+			if (color && options.NormalMap) level[i] = b / 127.5f - 1.0f;
+			else if (color && options.SRGB) level[i] = srgb.Decode[b];
+			else level[i] = b / 255.0f;
+		}
+	});
+
+	float coverage = options.AlphaCutoff > 0.0f ? Coverage(level.data(), (size_t)width * height, 1.0f, options.AlphaCutoff) : 0.0f;
+
+	std::vector<float> next;
+	while (width > 1 || height > 1) {
+		unsigned int newWidth = std::max(1u, width / 2), newHeight = std::max(1u, height / 2);
+		Downsample(level, width, height, next, newWidth, newHeight, options, pool);
+
+		// alpha tested textures thin out as they get smaller unless their
+		// alpha is scaled back up to cover as much as the top level did
+		float alphaScale = 1.0f;
+		if (options.AlphaCutoff > 0.0f) {
+			float lo = 0.0f, hi = 4.0f;
+			for (unsigned int step = 0; step < 16; step++) {
+				float mid = (lo + hi) * 0.5f;
+				if (Coverage(next.data(), (size_t)newWidth * newHeight, mid, options.AlphaCutoff) < coverage) lo = mid;
+				else hi = mid;
+			}
+			alphaScale = hi;
+		}
+
+		DecodedImage mip = {};
+		mip.SourceChannels = image.SourceChannels;
+		std::vector<float> variance;
+		Encode(next, newWidth, newHeight, options, alphaScale, mip, options.NormalMap ? &variance : 0, pool);
+		chain.Levels.push_back(std::move(mip));
+		if (options.NormalMap) chain.NormalVariance.push_back(std::move(variance));
+
+		level.swap(next);
+		width = newWidth;
+		height = newHeight;
+	}
+	return chain;
+}
+
+void MipGenerator::AdjustRoughness(std::vector<DecodedImage>& roughness, const MipChain& normals)
+{
+	for (size_t i = 0; i < roughness.size() && i < normals.NormalVariance.size(); i++) {
+		DecodedImage& r = roughness[i];
+		const DecodedImage& n = normals.Levels[i];
+		if (r.Width != n.Width || r.Height != n.Height) continue;
+
+		// the shader's GGX alpha is roughness squared; the normals'
+		// variance widens the lobe, alpha^2 + variance
+		const std::vector<float>& variance = normals.NormalVariance[i];
+		for (size_t t = 0; t < variance.size(); t++) {
+			unsigned char* p = &r.Pixels[t * 4];
+			float rough = p[0] / 255.0f;
+			float alpha = rough * rough;
+			float adjusted = std::min(1.0f, sqrtf(sqrtf(alpha * alpha + variance[t])));
+			p[0] = p[1] = p[2] = (unsigned char)(adjusted * 255.0f + 0.5f);
+		}
+	}
+}
+
+const char* MipGenerator::GetFilterName(MipFilter filter)
+{
+	switch (filter) {
+	case MipFilterKaiser: return "kaiser";
+	case MipFilterLanczos: return "lanczos";
+	default: return "box";
+	}
+}
+
+
+// --------------------------------------------------------
+// Benchmarking
+// --------------------------------------------------------
+std::vector<MipBenchmarkResult> MipGenerator::Benchmark(const DecodedImage& image, const MipOptions& options, ThreadPool* pool, unsigned int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	std::vector<MipBenchmarkResult> results;
+	iterations = std::max(1u, iterations);
+
+	for (MipFilter filter : { MipFilterBox, MipFilterKaiser, MipFilterLanczos }) {
+		for (ThreadPool* threads : { (ThreadPool*)0, pool }) {
+			MipOptions o = options;
+			o.Filter = filter;
+			Generate(image, o, threads);		// warm up
+
+			Clock::time_point start = Clock::now();
+			for (unsigned int i = 0; i < iterations; i++) Generate(image, o, threads);
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+
+			MipBenchmarkResult r = {};
+			r.Filter = filter;
+			r.Threads = threads ? threads->GetThreadCount() + 1 : 1;
+			r.Ms = ms;
+			r.MegapixelsPerSecond = ((double)image.Width * image.Height / 1000000.0) / (ms / 1000.0);
+			results.push_back(r);
+			if (!pool) break;
+		}
+	}
+	return results;
+}
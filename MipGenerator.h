@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include "PngDecoder.h"
+
+class ThreadPool;
+
+enum MipFilter
+{
+	MipFilterBox,		// 2x2 average
+	MipFilterKaiser,	// Kaiser windowed sinc (width 3, alpha 4)
+	MipFilterLanczos	// Lanczos 3
+};
+
+struct MipOptions
+{
+	MipFilter Filter;
+	bool SRGB;				// RGB is gamma encoded, so it's filtered in linear
+	bool NormalMap;			// RGB is a unit vector: renormalized at every level (and its variance kept)
+	bool ClampEdges;		// instead of wrapping around, for textures that don't tile
+	float AlphaCutoff;		// alpha tested textures keep the share of texels at or above this, 0 for off
+};
+
+// --------------------------------------------------------
+// Every mip below an image
+// --------------------------------------------------------
+struct MipChain
+{
+	std::vector<DecodedImage> Levels;		// mip 1 down to 1x1
+	// normal maps only: for each level, each texel's (1 - |n|) / |n| for the
+	// filtered (not yet renormalized) normal, how much the normals under it disagree
+	std::vector<std::vector<float>> NormalVariance;
+};
+
+struct MipBenchmarkResult
+{
+	MipFilter Filter;
+	unsigned int Threads;			// including the caller
+	double Ms;						// per chain
+	double MegapixelsPerSecond;		// of source image
+};
+
+// --------------------------------------------------------
+// Builds mip chains on the CPU, so they don't depend on
+// whatever the driver's GenerateMips does
+//
+// - Filters are separable (one pass across, one down),
+//   with the taps for each output column and row worked
+//   out once per level
+// - Texels are filtered as 4 floats at a time with SSE,
+//   and rows are split across the thread pool
+// - Each level is filtered from the previous one's floats
+//   (linear color, unnormalized normals), so nothing is
+//   rounded to 8 bits more than once
+// - Normal map variance gives the Toksvig roughness
+//   adjustment (see AdjustRoughness)
+// - Only depends on the standard library (and ThreadPool)
+// --------------------------------------------------------
+class MipGenerator
+{
+public:
+	/// <summary>
+	/// Every level below the image, down to 1x1
+	/// </summary>
+	/// <param name="pool">splits rows across threads, or null for this thread only</param>
+	static MipChain Generate(const DecodedImage& image, const MipOptions& options, ThreadPool* pool);
+
+	/// <summary>
+	/// Raises roughness where the normals under a texel disagree
+	/// (Toksvig), so bumpy surfaces don't turn shiny at a distance
+	/// </summary>
+	/// <param name="roughness">roughness levels (red channel, mip 1 on) to adjust in place</param>
+	/// <param name="normals">the normal map's chain - levels that aren't the same size are skipped</param>
+	static void AdjustRoughness(std::vector<DecodedImage>& roughness, const MipChain& normals);
+
+	static const char* GetFilterName(MipFilter filter);
+
+	/// <summary>
+	/// Times whole chains with every filter, on one thread and then on the pool
+	/// </summary>
+	static std::vector<MipBenchmarkResult> Benchmark(const DecodedImage& image, const MipOptions& options, ThreadPool* pool, unsigned int iterations);
+};
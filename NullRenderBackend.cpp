@@ -0,0 +1,170 @@
+#include "NullRenderBackend.h"
+
+NullRenderContext::NullRenderContext(bool keepCommands) :
+	keepCommands(keepCommands)
+{
+	stats = {};
+}
+
+void NullRenderContext::SetTopology(RenderTopology topology)
+{
+	Add(RenderCommandType::SetTopology, 0, (unsigned int)topology, 0, 0, 0);
+}
+
+void NullRenderContext::SetVertexBuffer(RenderBufferHandle buffer, unsigned int stride, unsigned int offset)
+{
+	Add(RenderCommandType::SetVertexBuffer, buffer, stride, offset, 0, 0);
+}
+
+void NullRenderContext::SetIndexBuffer(RenderBufferHandle buffer, RenderIndexFormat format)
+{
+	Add(RenderCommandType::SetIndexBuffer, buffer, (unsigned int)format, 0, 0, 0);
+}
+
+void NullRenderContext::SetConstantBuffer(RenderShaderStage stage, unsigned int slot, RenderBufferHandle buffer)
+{
+	Add(RenderCommandType::SetConstantBuffer, buffer, (unsigned int)stage, slot, 0, 0);
+}
+
+void NullRenderContext::SetTexture(RenderShaderStage stage, unsigned int slot, RenderTextureHandle texture)
+{
+	Add(RenderCommandType::SetTexture, texture, (unsigned int)stage, slot, 0, 0);
+}
+
+void NullRenderContext::UpdateBuffer(RenderBufferHandle buffer, const void* /*data*/, unsigned int byteSize)
+{
+	Add(RenderCommandType::UpdateBuffer, buffer, 0, 0, 0, byteSize);
+	stats.BytesUploaded += byteSize;
+}
+
+void NullRenderContext::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	Add(RenderCommandType::Draw, 0, vertexCount, startVertex, 0, 0);
+	stats.DrawCalls++;
+	stats.Vertices += vertexCount;
+}
+
+void NullRenderContext::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	Add(RenderCommandType::DrawIndexed, 0, indexCount, startIndex, (unsigned int)baseVertex, 0);
+	stats.DrawCalls++;
+	stats.Vertices += indexCount;
+}
+
+const std::vector<RenderCommand>& NullRenderContext::GetCommands()
+{
+	return commands;
+}
+
+NullRenderStats NullRenderContext::GetStats()
+{
+	return stats;
+}
+
+void NullRenderContext::Reset()
+{
+	commands.clear();
+	stats = {};
+}
+
+void NullRenderContext::Add(RenderCommandType type, uint64_t handle, unsigned int a0, unsigned int a1, unsigned int a2, unsigned int bytes)
+{
+	stats.Commands++;
+	if (!keepCommands) return;
+
+	RenderCommand c;
+	c.Type = type;
+	c.Handle = handle;
+	c.Args[0] = a0;
+	c.Args[1] = a1;
+	c.Args[2] = a2;
+	c.Bytes = bytes;
+	commands.push_back(c);
+}
+
+
+NullRenderDevice::NullRenderDevice(bool keepCommands) :
+	nextHandle(1),
+	keepCommands(keepCommands),
+	immediate(keepCommands)
+{
+	stats = {};
+}
+
+RenderBufferHandle NullRenderDevice::CreateBuffer(RenderBufferType /*type*/, const void* data, unsigned int byteSize, bool immutable)
+{
+	// same rules the real backend has to follow
+	if (byteSize == 0 || (immutable && !data)) return 0;
+
+	std::lock_guard<std::mutex> lock(resourceMutex);
+	RenderBufferHandle handle = nextHandle++;
+	buffers[handle] = byteSize;
+
+	stats.BuffersAlive++;
+	stats.BytesAlive += byteSize;
+	if (data) stats.BytesUploaded += byteSize;
+	return handle;
+}
+
+RenderTextureHandle NullRenderDevice::CreateTexture2D(unsigned int width, unsigned int height, RenderTextureFormat format, const void* data)
+{
+	unsigned int byteSize = width * height * Render::GetFormatSize(format);
+	if (byteSize == 0) return 0;
+
+	std::lock_guard<std::mutex> lock(resourceMutex);
+	RenderTextureHandle handle = nextHandle++;
+	textures[handle] = byteSize;
+
+	stats.TexturesAlive++;
+	stats.BytesAlive += byteSize;
+	if (data) stats.BytesUploaded += byteSize;
+	return handle;
+}
+
+void NullRenderDevice::ReleaseBuffer(RenderBufferHandle buffer)
+{
+	std::lock_guard<std::mutex> lock(resourceMutex);
+	auto it = buffers.find(buffer);
+	if (it == buffers.end()) return;
+
+	stats.BuffersAlive--;
+	stats.BytesAlive -= it->second;
+	buffers.erase(it);
+}
+
+void NullRenderDevice::ReleaseTexture(RenderTextureHandle texture)
+{
+	std::lock_guard<std::mutex> lock(resourceMutex);
+	auto it = textures.find(texture);
+	if (it == textures.end()) return;
+
+	stats.TexturesAlive--;
+	stats.BytesAlive -= it->second;
+	textures.erase(it);
+}
+
+IRenderContext* NullRenderDevice::GetImmediateContext()
+{
+	return &immediate;
+}
+
+const char* NullRenderDevice::GetName()
+{
+	return "Null";
+}
+
+std::unique_ptr<NullRenderContext> NullRenderDevice::CreateContext()
+{
+	return std::make_unique<NullRenderContext>(keepCommands);
+}
+
+NullRenderContext* NullRenderDevice::GetNullContext()
+{
+	return &immediate;
+}
+
+NullRenderStats NullRenderDevice::GetStats()
+{
+	std::lock_guard<std::mutex> lock(resourceMutex);
+	return stats;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "RenderInterface.h"
+
+// --------------------------------------------------------
+// One command as the null backend saw it
+// --------------------------------------------------------
+enum class RenderCommandType
+{
+	SetTopology,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	SetConstantBuffer,
+	SetTexture,
+	UpdateBuffer,
+	Draw,
+	DrawIndexed
+};
+
+struct RenderCommand
+{
+	RenderCommandType Type;
+	uint64_t Handle;			// buffer or texture, if any
+	unsigned int Args[3];		// command specific (counts, slots, strides, formats...)
+	unsigned int Bytes;			// bytes uploaded by the command
+};
+
+// --------------------------------------------------------
+// Running totals for a null context or device
+// --------------------------------------------------------
+struct NullRenderStats
+{
+	unsigned int Commands;
+	unsigned int DrawCalls;
+	uint64_t Vertices;			// vertices (or indices) submitted
+	uint64_t BytesUploaded;		// initial data plus buffer updates
+	unsigned int BuffersAlive;
+	unsigned int TexturesAlive;
+	uint64_t BytesAlive;		// size of every live resource
+};
+
+// --------------------------------------------------------
+// A context that does nothing but keep track
+//
+// - Optionally keeps the full command stream, so tests can
+//   check exactly what got submitted
+// - Not thread safe; use one per recording thread
+// --------------------------------------------------------
+class NullRenderContext : public IRenderContext
+{
+public:
+	NullRenderContext(bool keepCommands = true);
+
+	void SetTopology(RenderTopology topology) override;
+	void SetVertexBuffer(RenderBufferHandle buffer, unsigned int stride, unsigned int offset) override;
+	void SetIndexBuffer(RenderBufferHandle buffer, RenderIndexFormat format) override;
+	void SetConstantBuffer(RenderShaderStage stage, unsigned int slot, RenderBufferHandle buffer) override;
+	void SetTexture(RenderShaderStage stage, unsigned int slot, RenderTextureHandle texture) override;
+	void UpdateBuffer(RenderBufferHandle buffer, const void* data, unsigned int byteSize) override;
+	void Draw(unsigned int vertexCount, unsigned int startVertex) override;
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+
+	const std::vector<RenderCommand>& GetCommands();
+	NullRenderStats GetStats();
+	void Reset();	// forget every command and count
+
+private:
+	void Add(RenderCommandType type, uint64_t handle, unsigned int a0, unsigned int a1, unsigned int a2, unsigned int bytes);
+
+	bool keepCommands;
+	std::vector<RenderCommand> commands;
+	NullRenderStats stats;
+};
+
+// --------------------------------------------------------
+// A device with no GPU behind it, for headless runs
+//
+// - Resources are just ids and sizes; nothing is stored
+// - Resource creation is thread safe
+// --------------------------------------------------------
+class NullRenderDevice : public IRenderDevice
+{
+public:
+	NullRenderDevice(bool keepCommands = true);
+
+	RenderBufferHandle CreateBuffer(RenderBufferType type, const void* data, unsigned int byteSize, bool immutable) override;
+	RenderTextureHandle CreateTexture2D(unsigned int width, unsigned int height, RenderTextureFormat format, const void* data) override;
+	void ReleaseBuffer(RenderBufferHandle buffer) override;
+	void ReleaseTexture(RenderTextureHandle texture) override;
+	IRenderContext* GetImmediateContext() override;
+	const char* GetName() override;
+
+	/// <summary>
+	/// Another context, for recording on other threads
+	/// </summary>
+	std::unique_ptr<NullRenderContext> CreateContext();
+
+	NullRenderContext* GetNullContext();
+	NullRenderStats GetStats();	// resource totals (draw totals live in the contexts)
+
+private:
+	std::mutex resourceMutex;
+	uint64_t nextHandle;
+	std::unordered_map<uint64_t, unsigned int> buffers;		// handle -> size
+	std::unordered_map<uint64_t, unsigned int> textures;
+	NullRenderStats stats;
+
+	bool keepCommands;
+	NullRenderContext immediate;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// A contiguous run of draw items [Begin, End) recorded by one job
+// --------------------------------------------------------
+struct RecordRange
+{
+	unsigned int Begin;
+	unsigned int End;
+};
+
+// --------------------------------------------------------
+// Splits itemCount draws into at most maxJobs contiguous,
+// in-order ranges of at least minItemsPerJob items each
+// (except when there are fewer items than that in total).
+//
+// Executing the ranges in the returned order reproduces
+// the exact submission order of a single-threaded loop.
+// --------------------------------------------------------
+inline std::vector<RecordRange> PartitionRecording(unsigned int itemCount, unsigned int maxJobs, unsigned int minItemsPerJob)
+{
+	std::vector<RecordRange> ranges;
+	if (itemCount == 0 || maxJobs == 0) return ranges;
+	if (minItemsPerJob == 0) minItemsPerJob = 1;
+
+	// as many jobs as we can fill, capped at the number allowed
+	unsigned int jobs = itemCount / minItemsPerJob;
+	if (jobs == 0) jobs = 1;
+	if (jobs > maxJobs) jobs = maxJobs;
+
+	// spread the remainder over the first few jobs
+	unsigned int perJob = itemCount / jobs;
+	unsigned int extra = itemCount % jobs;
+	unsigned int begin = 0;
+	for (unsigned int j = 0; j < jobs; j++)
+	{
+		unsigned int size = perJob + (j < extra ? 1 : 0);
+		ranges.push_back({ begin, begin + size });
+		begin += size;
+	}
+
+	return ranges;
+}
+
+// --------------------------------------------------------
+// Records draw items in parallel, one job per context
+//
+// - TContext is whatever the items are recorded into: a
+//   D3D11 deferred context in the game, or a simple
+//   recording stand-in when checking ordering without a GPU
+// - Job j always records into contexts[j], so no context
+//   is ever touched by two threads at once
+// --------------------------------------------------------
+template<typename TContext>
+class ParallelRecorder
+{
+public:
+	ParallelRecorder(ThreadPool* pool, std::vector<TContext*> contexts) :
+		pool(pool),
+		contexts(contexts)
+	{
+	}
+
+	/// <summary>
+	/// Partitions the items and records every range into its own context
+	/// </summary>
+	/// <param name="itemCount">number of draw items</param>
+	/// <param name="minItemsPerJob">smallest job worth handing to another thread</param>
+	/// <param name="record">called once per job with its context, job index and range</param>
+	/// <returns>number of jobs recorded; contexts [0, jobs) hold the results in submission order</returns>
+	unsigned int Record(unsigned int itemCount, unsigned int minItemsPerJob,
+		const std::function<void(TContext*, unsigned int, RecordRange)>& record)
+	{
+		ranges = PartitionRecording(itemCount, (unsigned int)contexts.size(), minItemsPerJob);
+
+		auto job = [&](unsigned int j) { record(contexts[j], j, ranges[j]); };
+		if (pool)
+			pool->ParallelFor((unsigned int)ranges.size(), job);
+		else
+			for (unsigned int j = 0; j < ranges.size(); j++) job(j);
+
+		return (unsigned int)ranges.size();
+	}
+
+	/// <summary>
+	/// Ranges used by the most recent Record() call
+	/// </summary>
+	const std::vector<RecordRange>& GetRanges() { return ranges; }
+
+	/// <summary>
+	/// The context job j records into
+	/// </summary>
+	TContext* GetContext(unsigned int job) { return contexts[job]; }
+
+private:
+	ThreadPool* pool;
+	std::vector<TContext*> contexts;
+	std::vector<RecordRange> ranges;
+};
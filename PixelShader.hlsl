@@ -1,33 +1,100 @@
 #include "include.hlsli"
 
-#define NUM_LIGHTS 6
+// feature switches, set per variant (see ShaderVariants.h)
+// - the project's own build of this file has everything on,
+//   except texture arrays and image lighting, which need
+//   textures made for them
+#ifndef HAS_NORMAL_MAP
+#define HAS_NORMAL_MAP 1
+#endif
+#ifndef HAS_ROUGHNESS_MAP
+#define HAS_ROUGHNESS_MAP 1
+#endif
+#ifndef HAS_METALNESS_MAP
+#define HAS_METALNESS_MAP 1
+#endif
+#ifndef RECEIVES_SHADOWS
+#define RECEIVES_SHADOWS 1
+#endif
+#ifndef CLUSTERED_LIGHTS
+#define CLUSTERED_LIGHTS 1
+#endif
+#ifndef TEXTURE_ARRAYS
+#define TEXTURE_ARRAYS 0
+#endif
+#ifndef IMAGE_LIGHTING
+#define IMAGE_LIGHTING 0
+#endif
+
+// point and spot lights come from the clusters instead
+#define MAX_DIRECTIONAL_LIGHTS 4
 
 cbuffer ExternalData : register(b0)
 {
-    Light lights[NUM_LIGHTS];
+    Light lights[MAX_DIRECTIONAL_LIGHTS];
+    int directionalLightCount;
     float3 ambient;
-    float3 colorTint;
     float3 camPos;
     
-    float roughness;
+    // clustered lights
+    float4 clusterViewZ;        // view depth = dot(float4(worldPos, 1), clusterViewZ)
+    float2 clusterScreenSize;
+    float clusterSliceScale;    // slice = log(viewZ) * scale - bias
+    float clusterSliceBias;
+    uint3 clusterCount;
     
+    // the sky's baked lighting (see IBLBaker.h)
+    float iblIntensity;
+    float4 irradianceSH[9];     // rgb, convolved with the cosine lobe and over pi
+    float specularMipCount;     // roughness 0 to 1 across them
+}
+
+// per material, baked once into a buffer of its own
+// - layout matches MaterialConstants in Material.h
+cbuffer MaterialData : register(b1)
+{
+    float3 colorTint;
+    float roughness;
     float2 uvScale;
     float2 uvOffset;
     int useSpecularMap;
-    
+    int textureLayer;       // this material's layer, with TEXTURE_ARRAYS
+    float metalness;        // the material's value without a map
 }
 
 // FIELDS
 
 // assignment 11
+#if TEXTURE_ARRAYS
+// shared by every material in a set, each on its own layer
+Texture2DArray AlbedoArray          : register(t0);
+Texture2DArray NormalMapArray       : register(t1);
+Texture2DArray RoughnessMapArray    : register(t2);
+Texture2DArray MetalnessMapArray    : register(t3);
+Texture2DArray ORMMapArray          : register(t8);
+#define SAMPLE_MATERIAL(map, uv) map##Array.Sample(BasicSampler, float3(uv, textureLayer))
+#else
 Texture2D Albedo        : register(t0);
 Texture2D NormalMap     : register(t1);
 Texture2D RoughnessMap  : register(t2);
 Texture2D MetalnessMap  : register(t3);      // t is registers for textures
+Texture2D ORMMap        : register(t8);      // occlusion, roughness, metalness
+#define SAMPLE_MATERIAL(map, uv) map.Sample(BasicSampler, uv)
+#endif
 Texture2D ShadowMap     : register(t4);
 
+// clustered point and spot lights
+StructuredBuffer<Light> ClusterLights       : register(t5);
+StructuredBuffer<uint2> ClusterGrid         : register(t6);  // (offset, count) into the indices
+StructuredBuffer<uint> ClusterLightIndices  : register(t7);
+
+// image based lighting
+TextureCube SpecularIBL     : register(t9);     // GGX prefiltered sky, one roughness per mip
+Texture2D BRDFLookup        : register(t10);    // split sum scale and bias for F0, by N.V and roughness
+
 SamplerState BasicSampler               : register(s0); // s is registers for samplers
 SamplerComparisonState ShadowSampler    : register(s1);
+SamplerState ClampSampler               : register(s2);
 
 // --------------------------------------------------------
 // The entry point (main method) for our pixel shader
@@ -47,9 +114,13 @@ float4 main(VertexToPixel input) : SV_TARGET
     // uv
     input.uv = input.uv * uvScale + uvOffset;
     
+#if HAS_NORMAL_MAP
     // normal
     // get the normal map normal
-    float3 unpackedNormal = NormalMap.Sample(BasicSampler, input.uv).rgb * 2 - 1;
+    // only x and y are trusted (cooked normal maps are BC5, which has no z)
+    float3 unpackedNormal;
+    unpackedNormal.xy = SAMPLE_MATERIAL(NormalMap, input.uv).rg * 2 - 1;
+    unpackedNormal.z = sqrt(saturate(1 - dot(unpackedNormal.xy, unpackedNormal.xy)));
     unpackedNormal = normalize(unpackedNormal);
     // create the tbn matrix
     float3 N = input.normal; // its already normalized above
@@ -59,17 +130,30 @@ float4 main(VertexToPixel input) : SV_TARGET
     float3x3 TBN = float3x3(T, B, N);
     // transform the unpacked normal
     input.normal = mul(unpackedNormal, TBN); // multiplication order important
+#endif
     
     
     // assignment 11 
-    // roughness
-    float roughness = RoughnessMap.Sample(BasicSampler, input.uv).r;
-    // metalness
-    float metalness = MetalnessMap.Sample(BasicSampler, input.uv).r;
+    // roughness and metalness (the material's values without maps),
+    // both from one sample when they're packed together
+#if HAS_ORM_MAP
+    float3 orm = SAMPLE_MATERIAL(ORMMap, input.uv).rgb;
+    float occlusion = orm.r;
+    float roughness = orm.g;
+    float metalness = orm.b;
+#else
+    float occlusion = 1;
+#if HAS_ROUGHNESS_MAP
+    float roughness = SAMPLE_MATERIAL(RoughnessMap, input.uv).r;
+#endif
+#if HAS_METALNESS_MAP
+    float metalness = SAMPLE_MATERIAL(MetalnessMap, input.uv).r;
+#endif
+#endif
     // get the texture color at given uv coords, apply tint and ambient
     // assignment 11
     // undoing gamma correction (added back on final line in main)
-    float3 curColor = pow(Albedo.Sample(BasicSampler, input.uv).rgb, 2.2f);
+    float3 curColor = pow(SAMPLE_MATERIAL(Albedo, input.uv).rgb, 2.2f);
     
     // assignment 11
     // specular 
@@ -82,43 +166,69 @@ float4 main(VertexToPixel input) : SV_TARGET
     
     // assignment 12
     // shadow for a single light
+#if RECEIVES_SHADOWS
     float2 shadowUV = input.shadowPos.xy / input.shadowPos.w * 0.5f + 0.5f;
     shadowUV.y = 1.0f - shadowUV.y;
     // depth from light
     float depthFromLight = input.shadowPos.z / input.shadowPos.w;
     // compare depth with shadow map value
     float shadowAmount = ShadowMap.SampleCmpLevelZero(ShadowSampler, shadowUV, depthFromLight);
+#else
+    float shadowAmount = 1.0f;
+#endif
     
-    float3 totalLight;
+    float3 totalLight = 0;
     
 
-    // loop through lights and apply
-    for (int i = 0; i < NUM_LIGHTS; i++)
+    // loop through directional lights and apply
+    for (int i = 0; i < directionalLightCount; i++)
     {
         // get light and normalize its direction
         Light light = lights[i];
         light.direction = normalize(light.direction);
         
-        switch (lights[i].type)
-        {
-            case LIGHT_TYPE_DIRECTIONAL:
-                float result = DirectionalLight(light, input.normal, input.worldPosition, camPos, roughness, metalness, curColor, specColor);
+        float result = DirectionalLight(light, input.normal, input.worldPosition, camPos, roughness, metalness, curColor, specColor);
                 
-                // apply dir light, scaled by shadow map val
-                // only correct for the one shadow map we have
-                totalLight += result * (light.castsShadows ? shadowAmount : 1.0f);
-                break;
-
-            case LIGHT_TYPE_POINT:
-                totalLight += PointLight(light, input.normal, input.worldPosition, camPos, roughness, metalness, curColor, specColor);
-                break;
-            
-            case LIGHT_TYPE_SPOT:
-                totalLight += SpotLight(light, input.normal, input.worldPosition, camPos, roughness, metalness, curColor, specColor);
-                break;
-        }
+        // apply dir light, scaled by shadow map val
+        // only correct for the one shadow map we have
+        totalLight += result * (light.castsShadows ? shadowAmount : 1.0f);
     }
     
+#if CLUSTERED_LIGHTS
+    // find this pixel's cluster
+    // - screen tiles top row first, slices exponential in view depth
+    float viewZ = max(dot(float4(input.worldPosition, 1), clusterViewZ), 0.0001f);
+    uint2 tile = min(uint2(input.screenPosition.xy / clusterScreenSize * clusterCount.xy), clusterCount.xy - 1);
+    uint slice = (uint)clamp(log(viewZ) * clusterSliceScale - clusterSliceBias, 0.0f, clusterCount.z - 1.0f);
+    uint2 cluster = ClusterGrid[(slice * clusterCount.y + tile.y) * clusterCount.x + tile.x];
+    
+    // only the point and spot lights that touch it
+    for (uint j = 0; j < cluster.y; j++)
+    {
+        Light light = ClusterLights[ClusterLightIndices[cluster.x + j]];
+        
+        if (light.type == LIGHT_TYPE_SPOT)
+            totalLight += SpotLight(light, input.normal, input.worldPosition, camPos, roughness, metalness, curColor, specColor);
+        else
+            totalLight += PointLight(light, input.normal, input.worldPosition, camPos, roughness, metalness, curColor, specColor);
+    }
+#endif
+    
+    // ambient, which only occlusion shadows: the sky's baked
+    // lighting (harmonics for diffuse, split sum for specular),
+    // or a flat color without it
+#if IMAGE_LIGHTING
+    float3 toCam = normalize(camPos - input.worldPosition);
+    float NdotV = saturate(dot(input.normal, toCam));
+    float2 envBRDF = BRDFLookup.Sample(ClampSampler, float2(NdotV, roughness)).rg;
+    float3 envSpecular = specColor * envBRDF.x + envBRDF.y;
+    float3 prefiltered = SpecularIBL.SampleLevel(ClampSampler, reflect(-toCam, input.normal), roughness * (specularMipCount - 1)).rgb;
+    float3 envDiffuse = DiffuseEnergyConserve(EvaluateSH(irradianceSH, input.normal), envSpecular, metalness) * curColor;
+    totalLight += (envDiffuse + prefiltered * envSpecular) * iblIntensity * occlusion;
+#else
+    totalLight += ambient * curColor * occlusion;
+#endif
+    
     // with gamma correction
     return float4(pow(totalLight, 1.0f / 2.2f), 1);
 }
\ No newline at end of file
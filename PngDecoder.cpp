@@ -0,0 +1,746 @@
+#include "PngDecoder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <emmintrin.h>
+
+namespace
+{
+	// --------------------------------------------------------
+	// Reads a deflate stream's bits, least significant first
+	// (reading past the end gives zeros, and is checked by
+	// the caller with Overran())
+	// --------------------------------------------------------
+	struct BitReader
+	{
+		const unsigned char* data;
+		size_t size;
+		size_t pos;
+		uint64_t bits;
+		unsigned int count;
+
+		// Tops the buffer up to at least 56 bits
+		// - away from the end, 8 bytes are loaded at once and
+		//   only the whole bytes that fit are counted; the bits
+		//   above them are the stream's next ones either way
+		void Refill()
+		{
+			if (pos + 8 <= size) {
+				uint64_t word;
+				memcpy(&word, data + pos, 8);		// little endian, like the stream
+				bits |= word << count;
+				unsigned int bytes = (63 - count) >> 3;
+				pos += bytes;
+				count += bytes * 8;
+				return;
+			}
+			while (count <= 56) {
+				uint64_t byte = pos < size ? data[pos] : 0;
+				pos++;
+				bits |= byte << count;
+				count += 8;
+			}
+		}
+		unsigned int Peek(unsigned int n) { return (unsigned int)(bits & ((1ull << n) - 1)); }
+		void Consume(unsigned int n) { bits >>= n; count -= n; }
+		unsigned int Read(unsigned int n)
+		{
+			Refill();
+			return Take(n);
+		}
+
+		// Read without the refill
+		unsigned int Take(unsigned int n)
+		{
+			unsigned int v = Peek(n);
+			Consume(n);
+			return v;
+		}
+		bool Overran() { return pos * 8 - count > size * 8; }
+		size_t BytePosition() { return pos - count / 8; }
+
+		// Skips to a byte position, dropping whatever was buffered
+		void Seek(size_t byte)
+		{
+			pos = byte;
+			bits = 0;
+			count = 0;
+		}
+	};
+
+	// --------------------------------------------------------
+	// A canonical Huffman code as lookup tables: a root table
+	// indexed by the next RootBits bits, and subtables for the
+	// (rare) longer codes hanging off it
+	//
+	// Entries are symbol << 16 | length, or for a link to a
+	// subtable, offset << 16 | index bits << 9 | 0x100
+	// (length 0 = invalid)
+	// --------------------------------------------------------
+	struct Huffman
+	{
+		static const unsigned int RootBits = 10;
+		std::vector<uint32_t> table;
+
+		bool Build(const unsigned char* lengths, unsigned int count)
+		{
+			unsigned int lengthCount[16] = {};
+			for (unsigned int i = 0; i < count; i++) lengthCount[lengths[i]]++;
+
+			// over-subscribed codes are broken; incomplete ones just
+			// leave holes that fail if they're ever hit
+			int left = 1;
+			for (unsigned int len = 1; len < 16; len++) {
+				left = (left << 1) - (int)lengthCount[len];
+				if (left < 0) return false;
+			}
+
+			unsigned int nextCode[16] = {};
+			unsigned int code = 0;
+			lengthCount[0] = 0;
+			for (unsigned int len = 1; len < 16; len++) {
+				code = (code + lengthCount[len - 1]) << 1;
+				nextCode[len] = code;
+			}
+
+			// codes are stored most significant bit first, the stream is read least first
+			std::vector<uint16_t> reversed(count);
+			unsigned char subBits[1 << RootBits] = {};
+			for (unsigned int sym = 0; sym < count; sym++) {
+				unsigned int len = lengths[sym];
+				if (len == 0) continue;
+				unsigned int c = nextCode[len]++, r = 0;
+				for (unsigned int b = 0; b < len; b++)
+					r |= ((c >> b) & 1) << (len - 1 - b);
+				reversed[sym] = (uint16_t)r;
+
+				// a long code's subtable is as big as its longest code needs
+				unsigned int root = r & ((1u << RootBits) - 1);
+				if (len > RootBits && len - RootBits > subBits[root]) subBits[root] = (unsigned char)(len - RootBits);
+			}
+
+			table.assign((size_t)1 << RootBits, 0);
+			for (unsigned int root = 0; root < (1u << RootBits); root++) {
+				if (!subBits[root]) continue;
+				table[root] = (uint32_t)table.size() << 16 | subBits[root] << 9 | 0x100;
+				table.resize(table.size() + ((size_t)1 << subBits[root]), 0);
+			}
+
+			for (unsigned int sym = 0; sym < count; sym++) {
+				unsigned int len = lengths[sym];
+				if (len == 0) continue;
+				uint32_t entry = sym << 16 | len;
+				unsigned int r = reversed[sym];
+				if (len <= RootBits) {
+					for (unsigned int i = r; i < (1u << RootBits); i += 1u << len) table[i] = entry;
+					continue;
+				}
+				uint32_t link = table[r & ((1u << RootBits) - 1)];
+				uint32_t* sub = &table[link >> 16];
+				unsigned int size = 1u << ((link >> 9) & 15);
+				for (unsigned int i = r >> RootBits; i < size; i += 1u << (len - RootBits)) sub[i] = entry;
+			}
+			return true;
+		}
+
+		int Decode(BitReader& in)
+		{
+			in.Refill();
+			return Lookup(in);
+		}
+
+		// Decode without the refill, for when the caller already has enough bits
+		int Lookup(BitReader& in)
+		{
+			uint32_t e = table[in.Peek(RootBits)];
+			if (e & 0x100)
+				e = table[(e >> 16) + ((in.bits >> RootBits) & ((1u << ((e >> 9) & 15)) - 1))];
+			if ((e & 0xFF) == 0) return -1;
+			in.Consume(e & 0xFF);
+			return (int)(e >> 16);
+		}
+	};
+
+	const unsigned short LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const unsigned char LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const unsigned short DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const unsigned char DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// --------------------------------------------------------
+	// zlib's checksum, 16 bytes at a time: a is the sum of the
+	// bytes, and b gets each byte weighted by how many are
+	// left, so per block of 16 it's the sum of the a's before
+	// it (times 16) plus the bytes weighted 16 down to 1
+	// --------------------------------------------------------
+	uint32_t Adler32(const unsigned char* data, size_t size)
+	{
+		uint32_t a = 1, b = 0;
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i weightsHigh = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+		const __m128i weightsLow = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+		while (size > 0) {
+			// the longest run before the sums can overflow, a multiple of 16
+			size_t run = size < 5552 ? size : 5552;
+			size_t vector = run & ~(size_t)15;
+			__m128i sums = zero, before = zero, weighted = zero;
+			for (size_t i = 0; i < vector; i += 16) {
+				__m128i bytes = _mm_loadu_si128((const __m128i*)(data + i));
+				before = _mm_add_epi32(before, sums);
+				sums = _mm_add_epi32(sums, _mm_sad_epu8(bytes, zero));
+				weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), weightsHigh));
+				weighted = _mm_add_epi32(weighted, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), weightsLow));
+			}
+			uint32_t lanes[3][4];
+			_mm_storeu_si128((__m128i*)lanes[0], sums);
+			_mm_storeu_si128((__m128i*)lanes[1], before);
+			_mm_storeu_si128((__m128i*)lanes[2], weighted);
+			uint64_t bSum = b + (uint64_t)a * vector + 16ull * ((uint64_t)lanes[1][0] + lanes[1][2]) +
+				(uint64_t)lanes[2][0] + lanes[2][1] + lanes[2][2] + lanes[2][3];
+			a += lanes[0][0] + lanes[0][2];
+			b = (uint32_t)(bSum % 65521);
+			for (size_t i = vector; i < run; i++) {
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += run;
+			size -= run;
+		}
+		return b << 16 | a;
+	}
+
+	// --------------------------------------------------------
+	// Every chunk's CRC-32, eight bytes at a time: table k
+	// holds each byte's CRC pushed through k more zero bytes,
+	// so the eight lookups for one word can be xored together
+	// --------------------------------------------------------
+	struct CrcTables
+	{
+		uint32_t Table[8][256];
+		CrcTables()
+		{
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				Table[0][i] = c;
+			}
+			for (int k = 1; k < 8; k++)
+				for (uint32_t i = 0; i < 256; i++)
+					Table[k][i] = (Table[k - 1][i] >> 8) ^ Table[0][Table[k - 1][i] & 255];
+		}
+	};
+
+	uint32_t Crc32(const unsigned char* data, size_t size)
+	{
+		static const CrcTables tables;
+		const uint32_t (*t)[256] = tables.Table;
+		uint32_t c = 0xFFFFFFFFu;
+		for (; size >= 8; data += 8, size -= 8) {
+			uint32_t low = c ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+			c = t[7][low & 255] ^ t[6][(low >> 8) & 255] ^ t[5][(low >> 16) & 255] ^ t[4][low >> 24] ^
+				t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+		}
+		for (; size > 0; data++, size--) c = t[0][(c ^ *data) & 255] ^ (c >> 8);
+		return c ^ 0xFFFFFFFFu;
+	}
+
+	uint32_t ReadBigEndian(const unsigned char* p)
+	{
+		return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+	}
+
+	unsigned char Paeth(int a, int b, int c)
+	{
+		int p = a + b - c;
+		int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+		if (pa <= pb && pa <= pc) return (unsigned char)a;
+		return (unsigned char)(pb <= pc ? b : c);
+	}
+
+	// --------------------------------------------------------
+	// Unfiltering
+	//
+	// Sub, Average and Paeth depend on the pixel to the left,
+	// so for 3 and 4 byte pixels they go a pixel at a time
+	// with every channel in one SSE register; Up has no such
+	// chain and goes 16 bytes at a time
+	//
+	// 3 byte pixels are loaded 4 bytes at a time too (the
+	// rows carry a byte of slack after them for the last
+	// one); the extra lane is computed but never stored
+	// --------------------------------------------------------
+	template <size_t Bpp> __m128i LoadPixel(const unsigned char* p)
+	{
+		int v;
+		memcpy(&v, p, 4);
+		return _mm_cvtsi32_si128(v);
+	}
+
+	template <size_t Bpp> void StorePixel(unsigned char* p, __m128i v)
+	{
+		int s = _mm_cvtsi128_si32(v);
+		memcpy(p, &s, Bpp);
+	}
+
+	__m128i Abs16(__m128i v)
+	{
+		return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+	}
+
+	template <size_t Bpp> void UnfilterPixels(unsigned char filter, unsigned char* row, const unsigned char* up, size_t stride)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		__m128i a = zero, c = zero;
+		switch (filter) {
+		case 1:
+			for (size_t x = 0; x < stride; x += Bpp) {
+				a = _mm_add_epi8(a, LoadPixel<Bpp>(row + x));
+				StorePixel<Bpp>(row + x, a);
+			}
+			break;
+		case 3:
+			for (size_t x = 0; x < stride; x += Bpp) {
+				// average rounding down (avg_epu8 rounds up)
+				__m128i b = LoadPixel<Bpp>(up + x);
+				__m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+				a = _mm_add_epi8(LoadPixel<Bpp>(row + x), average);
+				StorePixel<Bpp>(row + x, a);
+			}
+			break;
+		case 4:
+			// in 16 bits, where p - a = b - c and p - b = a - c
+			for (size_t x = 0; x < stride; x += Bpp) {
+				__m128i b = _mm_unpacklo_epi8(LoadPixel<Bpp>(up + x), zero);
+				__m128i pa = _mm_sub_epi16(b, c);
+				__m128i pb = _mm_sub_epi16(a, c);
+				__m128i pc = Abs16(_mm_add_epi16(pa, pb));
+				pa = Abs16(pa);
+				pb = Abs16(pb);
+				__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+				// a if pa is smallest, else b if pb is, else c
+				__m128i useA = _mm_cmpeq_epi16(pa, smallest);
+				__m128i useB = _mm_andnot_si128(useA, _mm_cmpeq_epi16(pb, smallest));
+				__m128i nearest = _mm_or_si128(_mm_and_si128(useA, a),
+					_mm_or_si128(_mm_and_si128(useB, b), _mm_andnot_si128(_mm_or_si128(useA, useB), c)));
+
+				__m128i d = _mm_add_epi8(LoadPixel<Bpp>(row + x), _mm_packus_epi16(nearest, nearest));
+				StorePixel<Bpp>(row + x, d);
+				a = _mm_unpacklo_epi8(d, zero);
+				c = b;
+			}
+			break;
+		}
+	}
+
+	bool UnfilterRow(unsigned char filter, unsigned char* row, const unsigned char* up, size_t stride, size_t bpp)
+	{
+		if (filter > 4) return false;
+		if (filter == 0) return true;
+
+		if (filter == 2) {
+			size_t x = 0;
+			for (; x + 16 <= stride; x += 16)
+				_mm_storeu_si128((__m128i*)(row + x), _mm_add_epi8(_mm_loadu_si128((const __m128i*)(row + x)), _mm_loadu_si128((const __m128i*)(up + x))));
+			for (; x < stride; x++) row[x] = (unsigned char)(row[x] + up[x]);
+			return true;
+		}
+		if (bpp == 3) {
+			UnfilterPixels<3>(filter, row, up, stride);
+			return true;
+		}
+		if (bpp == 4) {
+			UnfilterPixels<4>(filter, row, up, stride);
+			return true;
+		}
+
+		for (size_t x = 0; x < stride; x++) {
+			int a = x >= bpp ? row[x - bpp] : 0;
+			int b = up[x];
+			int c = x >= bpp ? up[x - bpp] : 0;
+			switch (filter) {
+			case 1: row[x] = (unsigned char)(row[x] + a); break;
+			case 3: row[x] = (unsigned char)(row[x] + ((a + b) >> 1)); break;
+			case 4: row[x] = (unsigned char)(row[x] + Paeth(a, b, c)); break;
+			}
+		}
+		return true;
+	}
+
+	// --------------------------------------------------------
+	// Everything needed to turn a row of samples into RGBA8
+	// --------------------------------------------------------
+	struct PixelFormat
+	{
+		unsigned int ColorType;
+		unsigned int Depth;
+		unsigned int Channels;
+		std::vector<unsigned char> Palette;		// RGBA
+		bool HasKey;							// tRNS for gray and RGB: this color is transparent
+		unsigned int Key[3];
+	};
+
+	// count pixels of a row into dst, step bytes apart
+	void ExpandRow(const PixelFormat& f, const unsigned char* row, unsigned int count, unsigned char* dst, size_t step)
+	{
+		// 1, 2 and 4 bit gray and palette indices, packed high bits first
+		if (f.Depth < 8) {
+			unsigned int mask = (1u << f.Depth) - 1;
+			unsigned int scale = 255 / mask;
+			for (unsigned int x = 0; x < count; x++, dst += step) {
+				unsigned int bit = x * f.Depth;
+				unsigned int v = (row[bit >> 3] >> (8 - f.Depth - (bit & 7))) & mask;
+				if (f.ColorType == 3) memcpy(dst, &f.Palette[v * 4], 4);
+				else {
+					dst[0] = dst[1] = dst[2] = (unsigned char)(v * scale);
+					dst[3] = f.HasKey && v == f.Key[0] ? 0 : 255;
+				}
+			}
+			return;
+		}
+
+		// the common cases are already RGBA8, or only missing alpha
+		if (f.ColorType == 6 && f.Depth == 8 && step == 4) {
+			memcpy(dst, row, (size_t)count * 4);
+			return;
+		}
+		if (f.ColorType == 2 && f.Depth == 8 && !f.HasKey) {
+			for (unsigned int x = 0; x < count; x++, dst += step, row += 3) {
+				uint32_t pixel = row[0] | row[1] << 8 | row[2] << 16 | 0xFF000000u;
+				memcpy(dst, &pixel, 4);
+			}
+			return;
+		}
+
+		// 16 bit samples are big endian, so the high byte comes first
+		size_t bytes = f.Depth / 8;
+		size_t bpp = f.Channels * bytes;
+		auto sample = [&](const unsigned char* p, unsigned int i) {
+			return bytes == 2 ? (unsigned int)(p[i * 2] << 8 | p[i * 2 + 1]) : (unsigned int)p[i];
+		};
+		for (unsigned int x = 0; x < count; x++, dst += step) {
+			const unsigned char* p = row + x * bpp;
+			switch (f.ColorType) {
+			case 0:
+				dst[0] = dst[1] = dst[2] = p[0];
+				dst[3] = f.HasKey && sample(p, 0) == f.Key[0] ? 0 : 255;
+				break;
+			case 2:
+				dst[0] = p[0]; dst[1] = p[bytes]; dst[2] = p[2 * bytes];
+				dst[3] = f.HasKey && sample(p, 0) == f.Key[0] && sample(p, 1) == f.Key[1] && sample(p, 2) == f.Key[2] ? 0 : 255;
+				break;
+			case 3: memcpy(dst, &f.Palette[p[0] * 4], 4); break;
+			case 4: dst[0] = dst[1] = dst[2] = p[0]; dst[3] = p[bytes]; break;
+			case 6: dst[0] = p[0]; dst[1] = p[bytes]; dst[2] = p[2 * bytes]; dst[3] = p[3 * bytes]; break;
+			}
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Inflate
+// --------------------------------------------------------
+bool PngDecoder::Inflate(const unsigned char* data, size_t size, std::vector<unsigned char>& out, std::string& error, size_t expectedSize)
+{
+	if (size < 6 || (data[0] & 15) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) {
+		error = "not a zlib stream (or uses a preset dictionary)";
+		return false;
+	}
+
+	// a little slack past the end lets matches copy 8 bytes at a time
+	BitReader in = { data, size, 2, 0, 0 };
+	// (deflate can't shrink anything more than 1032:1, so no more than that up front)
+	out.resize((expectedSize > 0 ? std::min(expectedSize, size * 1032 + 1024) : size * 4) + 8);
+	size_t o = 0;
+	// (growing is also when a stream that's run out of input - and
+	// would otherwise decode zeros forever - is noticed)
+	auto reserve = [&](size_t more) {
+		if (o + more + 8 <= out.size()) return true;
+		if (in.Overran()) return false;
+		out.resize((o + more + 8) * 2);
+		return true;
+	};
+
+	Huffman lit, dist;
+	bool last = false;
+	while (!last) {
+		last = in.Read(1) != 0;
+		unsigned int type = in.Read(2);
+
+		if (type == 0) {
+			// stored: byte aligned length, its complement, then raw bytes
+			in.Consume(in.count & 7);
+			unsigned int len = in.Read(16);
+			unsigned int nlen = in.Read(16);
+			if ((len ^ 0xFFFF) != nlen) { error = "corrupt stored block"; return false; }
+			size_t at = in.BytePosition();
+			if (at + len > size) { error = "truncated stored block"; return false; }
+			reserve(len);		// can't overrun, the length was checked
+			memcpy(&out[o], data + at, len);
+			o += len;
+			in.Seek(at + len);
+		}
+		else if (type == 1 || type == 2) {
+			unsigned char lengths[320];
+			unsigned int litCount = 288, distCount = 30;
+			if (type == 1) {
+				// fixed codes
+				for (unsigned int i = 0; i < 144; i++) lengths[i] = 8;
+				for (unsigned int i = 144; i < 256; i++) lengths[i] = 9;
+				for (unsigned int i = 256; i < 280; i++) lengths[i] = 7;
+				for (unsigned int i = 280; i < 288; i++) lengths[i] = 8;
+				for (unsigned int i = 0; i < 30; i++) lengths[288 + i] = 5;
+			}
+			else {
+				// dynamic codes, themselves Huffman coded
+				litCount = in.Read(5) + 257;
+				distCount = in.Read(5) + 1;
+				unsigned int codeCount = in.Read(4) + 4;
+				static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+				unsigned char codeLengths[19] = {};
+				for (unsigned int i = 0; i < codeCount; i++) codeLengths[order[i]] = (unsigned char)in.Read(3);
+				Huffman codes;
+				if (!codes.Build(codeLengths, 19)) { error = "bad code length code"; return false; }
+
+				unsigned int n = 0;
+				while (n < litCount + distCount) {
+					int sym = codes.Decode(in);
+					if (sym < 0) { error = "bad code length"; return false; }
+					if (sym < 16) { lengths[n++] = (unsigned char)sym; continue; }
+
+					unsigned char value = 0;
+					unsigned int repeat = 0;
+					if (sym == 16) {
+						if (n == 0) { error = "repeat with nothing before it"; return false; }
+						value = lengths[n - 1];
+						repeat = 3 + in.Read(2);
+					}
+					else if (sym == 17) repeat = 3 + in.Read(3);
+					else repeat = 11 + in.Read(7);
+					if (n + repeat > litCount + distCount) { error = "too many code lengths"; return false; }
+					while (repeat--) lengths[n++] = value;
+				}
+				// the distance lengths follow the literal ones directly
+				memmove(lengths + 288, lengths + litCount, distCount);
+			}
+
+			if (!lit.Build(lengths, litCount) || !dist.Build(lengths + 288, distCount)) {
+				error = "bad Huffman code";
+				return false;
+			}
+
+			for (;;) {
+				// one refill covers a whole literal, or length and distance
+				// with their extra bits (15 + 5 + 15 + 13 bits at most), and
+				// one check leaves room for the longest match
+				in.Refill();
+				if (!reserve(258)) { error = "truncated stream"; return false; }
+				int sym = lit.Lookup(in);
+				if (sym < 0) { error = "bad literal/length code"; return false; }
+				if (sym < 256) {
+					out[o++] = (unsigned char)sym;
+					continue;
+				}
+				if (sym == 256) break;
+
+				sym -= 257;
+				if (sym >= 29) { error = "bad length"; return false; }
+				unsigned int len = LengthBase[sym] + in.Take(LengthExtra[sym]);
+				int d = dist.Lookup(in);
+				if (d < 0 || d >= 30) { error = "bad distance code"; return false; }
+				size_t distance = DistanceBase[d] + in.Take(DistanceExtra[d]);
+				if (distance > o) { error = "distance before the start"; return false; }
+
+				// the copy may overlap itself: 8 bytes at a time is only
+				// safe when the source is at least that far back
+				unsigned char* dst = &out[o];
+				const unsigned char* src = dst - distance;
+				if (distance >= 8)
+					for (unsigned int i = 0; i < len; i += 8) memcpy(dst + i, src + i, 8);
+				else if (distance == 1)
+					memset(dst, src[0], len);
+				else
+					for (unsigned int i = 0; i < len; i++) dst[i] = src[i];
+				o += len;
+			}
+		}
+		else {
+			error = "bad block type";
+			return false;
+		}
+
+		if (in.Overran()) { error = "truncated stream"; return false; }
+	}
+	out.resize(o);
+
+	// adler32 of the output follows, byte aligned
+	size_t at = in.BytePosition();
+	if (at + 4 > size) { error = "missing checksum"; return false; }
+	if (Adler32(out.data(), o) != ReadBigEndian(data + at)) { error = "checksum mismatch"; return false; }
+	return true;
+}
+
+
+// --------------------------------------------------------
+// PNG
+// --------------------------------------------------------
+bool PngDecoder::DecodeFile(const std::string& path, DecodedImage& image, std::string& error)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		error = "couldn't open " + path;
+		return false;
+	}
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return Decode(data.data(), data.size(), image, error);
+}
+
+bool PngDecoder::IsPng(const unsigned char* data, size_t size)
+{
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	return size >= 8 && memcmp(data, signature, 8) == 0;
+}
+
+bool PngDecoder::Decode(const unsigned char* data, size_t size, DecodedImage& image, std::string& error)
+{
+	if (!IsPng(data, size)) {
+		error = "not a PNG";
+		return false;
+	}
+
+	unsigned int width = 0, height = 0, interlace = 0;
+	PixelFormat f = {};
+	std::vector<unsigned char> compressed;
+	bool header = false;
+
+	// chunks: length, type, data, crc
+	for (size_t at = 8; at + 12 <= size; ) {
+		uint32_t length = ReadBigEndian(data + at);
+		const unsigned char* type = data + at + 4;
+		const unsigned char* body = data + at + 8;
+		if (length > size - at - 12) { error = "truncated chunk"; return false; }
+		if (Crc32(type, 4 + (size_t)length) != ReadBigEndian(body + length)) {
+			error = "bad CRC in " + std::string((const char*)type, 4) + " chunk";
+			return false;
+		}
+
+		if (memcmp(type, "IHDR", 4) == 0 && length >= 13) {
+			width = ReadBigEndian(body);
+			height = ReadBigEndian(body + 4);
+			f.Depth = body[8];
+			f.ColorType = body[9];
+			interlace = body[12];
+			header = true;
+		}
+		else if (memcmp(type, "PLTE", 4) == 0) {
+			f.Palette.assign(256 * 4, 255);
+			for (uint32_t i = 0; i < length / 3 && i < 256; i++)
+				memcpy(&f.Palette[i * 4], body + i * 3, 3);
+		}
+		else if (memcmp(type, "tRNS", 4) == 0) {
+			if (f.ColorType == 3 && !f.Palette.empty())
+				for (uint32_t i = 0; i < length && i < 256; i++)
+					f.Palette[i * 4 + 3] = body[i];
+			else if ((f.ColorType == 0 && length >= 2) || (f.ColorType == 2 && length >= 6)) {
+				f.HasKey = true;
+				for (uint32_t i = 0; i < length / 2 && i < 3; i++) f.Key[i] = body[i * 2] << 8 | body[i * 2 + 1];
+			}
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+			compressed.insert(compressed.end(), body, body + length);
+		else if (memcmp(type, "IEND", 4) == 0)
+			break;
+
+		at += 12 + (size_t)length;
+	}
+
+	if (!header || width == 0 || height == 0) { error = "missing or empty IHDR"; return false; }
+	if (width > 32768 || height > 32768) { error = "image too large"; return false; }
+	if (interlace > 1) { error = "unknown interlace method"; return false; }
+
+	switch (f.ColorType) {
+	case 0: f.Channels = 1; break;
+	case 2: f.Channels = 3; break;
+	case 3: f.Channels = 1; break;
+	case 4: f.Channels = 2; break;
+	case 6: f.Channels = 4; break;
+	default: error = "bad color type"; return false;
+	}
+	bool depthOk = f.Depth == 8 || (f.Depth == 16 && f.ColorType != 3) ||
+		((f.Depth == 1 || f.Depth == 2 || f.Depth == 4) && (f.ColorType == 0 || f.ColorType == 3));
+	if (!depthOk) { error = "bad bit depth " + std::to_string(f.Depth) + " for color type " + std::to_string(f.ColorType); return false; }
+	if (f.ColorType == 3 && f.Palette.empty()) { error = "palette image without a palette"; return false; }
+
+	// a key only means something at the image's own depth
+	if (f.HasKey && f.Depth < 16)
+		for (unsigned int& k : f.Key) k &= (1u << f.Depth) - 1;
+
+	// Adam7 passes (start x, start y, step x, step y), or the whole image as one
+	struct Pass { unsigned int X, Y, StepX, StepY; };
+	static const Pass adam7[7] = { { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+	static const Pass whole = { 0, 0, 1, 1 };
+	const Pass* passes = interlace ? adam7 : &whole;
+	unsigned int passCount = interlace ? 7 : 1;
+
+	// each pass's rows: one filter byte, then the samples
+	size_t bitsPerPixel = (size_t)f.Channels * f.Depth;
+	size_t bpp = (bitsPerPixel + 7) / 8;		// filters work in whole bytes
+	unsigned long long total = 0;
+	for (unsigned int p = 0; p < passCount; p++) {
+		unsigned long long w = (width - passes[p].X + passes[p].StepX - 1) / passes[p].StepX;
+		unsigned long long h = (height - passes[p].Y + passes[p].StepY - 1) / passes[p].StepY;
+		if (w && h) total += ((w * bitsPerPixel + 7) / 8 + 1) * h;
+	}
+
+	// deflate can't shrink anything more than 1032:1, so a header claiming more
+	// than that is lying, and doesn't get buffers that size (nor, in a 32 bit
+	// build, do sizes that don't fit in memory at all)
+	if (total > (unsigned long long)compressed.size() * 1032 + 1024) { error = "not enough image data"; return false; }
+	if ((unsigned long long)width * height * 4 > SIZE_MAX || total + 8 > SIZE_MAX) { error = "image too large"; return false; }
+
+	std::vector<unsigned char> raw;
+	if (!Inflate(compressed.data(), compressed.size(), raw, error, (size_t)total))
+		return false;
+	if (raw.size() < total) { error = "not enough image data"; return false; }
+	raw.resize(raw.size() + 4, 0);		// slack for LoadPixel
+
+	image.Width = width;
+	image.Height = height;
+	image.SourceChannels = f.ColorType == 3 ? 3 : f.Channels;
+	image.Pixels.resize((size_t)width * height * 4);
+
+	// undo the filters in place, each row against the one above it
+	// (the first against zeros), then expand it into the image
+	size_t at = 0;
+	std::vector<unsigned char> zeros;
+	for (unsigned int p = 0; p < passCount; p++) {
+		const Pass& pass = passes[p];
+		unsigned int w = (width - pass.X + pass.StepX - 1) / pass.StepX;
+		unsigned int h = (height - pass.Y + pass.StepY - 1) / pass.StepY;
+		if (w == 0 || h == 0) continue;
+
+		size_t stride = (w * bitsPerPixel + 7) / 8;
+		zeros.assign(stride + 4, 0);
+		const unsigned char* up = zeros.data();
+		for (unsigned int y = 0; y < h; y++, at += stride + 1) {
+			unsigned char* row = &raw[at + 1];
+			if (!UnfilterRow(raw[at], row, up, stride, bpp)) { error = "bad filter type"; return false; }
+			up = row;
+
+			unsigned char* dst = &image.Pixels[(((size_t)pass.Y + (size_t)y * pass.StepY) * width + pass.X) * 4];
+			ExpandRow(f, row, w, dst, (size_t)pass.StepX * 4);
+		}
+	}
+
+	if (f.ColorType == 3)
+		for (size_t i = 3; i < f.Palette.size(); i += 4)
+			if (f.Palette[i] != 255) { image.SourceChannels = 4; break; }
+	if (f.HasKey) image.SourceChannels = f.ColorType == 0 ? 2 : 4;
+	return true;
+}
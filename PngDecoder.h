@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// An image decoded to 8 bit RGBA, rows top to bottom
+// --------------------------------------------------------
+struct DecodedImage
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int SourceChannels;		// 1 gray, 2 gray+alpha, 3 RGB, 4 RGBA (palettes count as 3 or 4)
+	std::vector<unsigned char> Pixels;	// Width * Height * 4 bytes
+};
+
+// --------------------------------------------------------
+// A small PNG decoder, so textures can be read without WIC
+//
+// - Handles every standard format: 1-16 bit gray, 8 and
+//   16 bit gray+alpha, RGB and RGBA, 1-8 bit palettes,
+//   tRNS transparency and Adam7 interlacing (16 bit
+//   channels keep their high byte)
+// - Includes its own inflate (zlib) with two level Huffman
+//   tables, and unfilters 3 and 4 byte pixels with SSE2
+// - Every chunk's CRC is checked, and images over 32768 on
+//   a side (or claiming more than their data could hold)
+//   are refused before anything that size is allocated
+// - Only depends on the standard library
+// --------------------------------------------------------
+class PngDecoder
+{
+public:
+	/// <summary>
+	/// Decodes a whole PNG file already in memory
+	/// </summary>
+	/// <returns>false (with the reason in error) if it couldn't be decoded</returns>
+	static bool Decode(const unsigned char* data, size_t size, DecodedImage& image, std::string& error);
+	static bool DecodeFile(const std::string& path, DecodedImage& image, std::string& error);
+
+	/// <summary>
+	/// Whether data starts with the PNG signature
+	/// </summary>
+	static bool IsPng(const unsigned char* data, size_t size);
+
+	/// <summary>
+	/// Inflates a zlib stream (header, deflate data, adler32)
+	/// </summary>
+	/// <param name="expectedSize">how much output to reserve, if known</param>
+	static bool Inflate(const unsigned char* data, size_t size, std::vector<unsigned char>& out, std::string& error, size_t expectedSize = 0);
+};
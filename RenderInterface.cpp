@@ -0,0 +1,28 @@
+#include "RenderInterface.h"
+
+static IRenderDevice* currentDevice = 0;
+
+IRenderDevice* Render::GetDevice()
+{
+	return currentDevice;
+}
+
+void Render::SetDevice(IRenderDevice* device)
+{
+	currentDevice = device;
+}
+
+unsigned int Render::GetFormatSize(RenderTextureFormat format)
+{
+	switch (format)
+	{
+	case RenderTextureFormat::RGBA8:
+	case RenderTextureFormat::RGBA8_SRGB:
+	case RenderTextureFormat::R32_Float:
+	case RenderTextureFormat::D32_Float:
+		return 4;
+	case RenderTextureFormat::RGBA16_Float:
+		return 8;
+	}
+	return 0;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+
+// --------------------------------------------------------
+// A small, backend-neutral rendering interface
+//
+// - Only depends on the standard library, so code written
+//   against it builds (and runs, on the null backend)
+//   anywhere, not just where D3D11 exists
+// - Covers buffers, textures and draw submission; shaders
+//   and pipeline state still go through SimpleShader and
+//   D3D11 directly
+// - Handles are opaque 64 bit values whose meaning belongs
+//   to the backend that created them (0 is always "none")
+// --------------------------------------------------------
+
+typedef uint64_t RenderBufferHandle;
+typedef uint64_t RenderTextureHandle;
+
+enum class RenderBufferType
+{
+	Vertex,
+	Index,
+	Constant
+};
+
+enum class RenderIndexFormat
+{
+	UInt16,
+	UInt32
+};
+
+enum class RenderTopology
+{
+	TriangleList,
+	TriangleStrip,
+	LineList,
+	PointList
+};
+
+enum class RenderTextureFormat
+{
+	RGBA8,
+	RGBA8_SRGB,
+	R32_Float,
+	RGBA16_Float,
+	D32_Float		// depth, still readable as R32_Float in shaders
+};
+
+enum class RenderShaderStage
+{
+	Vertex,
+	Pixel
+};
+
+// --------------------------------------------------------
+// Records or submits commands: the immediate context, or
+// one being recorded on another thread
+// --------------------------------------------------------
+class IRenderContext
+{
+public:
+	virtual ~IRenderContext() {}
+
+	virtual void SetTopology(RenderTopology topology) = 0;
+	virtual void SetVertexBuffer(RenderBufferHandle buffer, unsigned int stride, unsigned int offset) = 0;
+	virtual void SetIndexBuffer(RenderBufferHandle buffer, RenderIndexFormat format) = 0;
+	virtual void SetConstantBuffer(RenderShaderStage stage, unsigned int slot, RenderBufferHandle buffer) = 0;
+	virtual void SetTexture(RenderShaderStage stage, unsigned int slot, RenderTextureHandle texture) = 0;
+
+	// whole buffer replacement (the size must match the buffer)
+	virtual void UpdateBuffer(RenderBufferHandle buffer, const void* data, unsigned int byteSize) = 0;
+
+	virtual void Draw(unsigned int vertexCount, unsigned int startVertex) = 0;
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+};
+
+// --------------------------------------------------------
+// Creates and destroys resources, and owns the immediate
+// context
+// --------------------------------------------------------
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() {}
+
+	/// <summary>
+	/// Creates a buffer, optionally filled with initial data
+	/// </summary>
+	/// <param name="type">how the buffer will be bound</param>
+	/// <param name="data">initial contents (required for immutable buffers)</param>
+	/// <param name="byteSize">size of the buffer in bytes</param>
+	/// <param name="immutable">true if the buffer never changes after creation</param>
+	/// <returns>the new buffer, or 0 on failure</returns>
+	virtual RenderBufferHandle CreateBuffer(RenderBufferType type, const void* data, unsigned int byteSize, bool immutable) = 0;
+
+	/// <summary>
+	/// Creates a single mip, shader readable 2D texture
+	/// </summary>
+	/// <param name="data">tightly packed initial contents, or null</param>
+	/// <returns>the new texture, or 0 on failure</returns>
+	virtual RenderTextureHandle CreateTexture2D(unsigned int width, unsigned int height, RenderTextureFormat format, const void* data) = 0;
+
+	virtual void ReleaseBuffer(RenderBufferHandle buffer) = 0;
+	virtual void ReleaseTexture(RenderTextureHandle texture) = 0;
+
+	virtual IRenderContext* GetImmediateContext() = 0;
+	virtual const char* GetName() = 0;
+};
+
+// --------------------------------------------------------
+// The device everything else creates resources on
+// (set up by Graphics::Initialize, or by a headless tool)
+// --------------------------------------------------------
+namespace Render
+{
+	IRenderDevice* GetDevice();
+	void SetDevice(IRenderDevice* device);
+
+	// bytes per texel of each texture format
+	unsigned int GetFormatSize(RenderTextureFormat format);
+}
@@ -0,0 +1,102 @@
+#include "RenderList.h"
+
+RenderList::RenderList(DrawRecordResolver resolve) :
+	resolve(resolve)
+{
+}
+
+RenderList::~RenderList()
+{
+}
+
+RenderHandle RenderList::Add(std::shared_ptr<GameEntity> entity)
+{
+	// reuse a handle if one's free
+	RenderHandle handle;
+	if (!freeHandles.empty()) {
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+	}
+	else {
+		handle = (RenderHandle)handleToIndex.size();
+		handleToIndex.push_back(InvalidHandle);
+	}
+
+	DrawRecord record = {};
+	record.Handle = handle;
+	resolve(record, entity.get());
+
+	handleToIndex[handle] = (unsigned int)records.size();
+	records.push_back(record);
+	owners.push_back(entity);
+
+	return handle;
+}
+
+// --------------------------------------------------------
+// Moves the last record into the removed one's slot, so
+// the array stays packed without shifting everything down
+// --------------------------------------------------------
+void RenderList::Remove(RenderHandle handle)
+{
+	if (!Contains(handle)) return;
+
+	unsigned int index = handleToIndex[handle];
+	unsigned int last = (unsigned int)records.size() - 1;
+
+	if (index != last) {
+		records[index] = records[last];
+		owners[index] = std::move(owners[last]);
+		handleToIndex[records[index].Handle] = index;
+	}
+
+	records.pop_back();
+	owners.pop_back();
+
+	handleToIndex[handle] = InvalidHandle;
+	freeHandles.push_back(handle);
+}
+
+void RenderList::Update(RenderHandle handle)
+{
+	if (!Contains(handle)) return;
+
+	unsigned int index = handleToIndex[handle];
+	resolve(records[index], owners[index].get());
+}
+
+void RenderList::Clear()
+{
+	records.clear();
+	owners.clear();
+	handleToIndex.clear();
+	freeHandles.clear();
+}
+
+void RenderList::Reserve(unsigned int count)
+{
+	records.reserve(count);
+	owners.reserve(count);
+	handleToIndex.reserve(count);
+}
+
+bool RenderList::Contains(RenderHandle handle)
+{
+	return handle < handleToIndex.size() && handleToIndex[handle] != InvalidHandle;
+}
+
+unsigned int RenderList::GetCount()
+{
+	return (unsigned int)records.size();
+}
+
+const std::vector<DrawRecord>& RenderList::GetRecords()
+{
+	return records;
+}
+
+std::shared_ptr<GameEntity> RenderList::GetEntity(RenderHandle handle)
+{
+	if (!Contains(handle)) return 0;
+	return owners[handleToIndex[handle]];
+}
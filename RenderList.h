@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+class GameEntity;
+class Transform;
+class Mesh;
+class Material;
+class SimpleVertexShader;
+class SimplePixelShader;
+
+// Stable name for an entity in a RenderList (survives other entities being removed)
+typedef unsigned int RenderHandle;
+
+// --------------------------------------------------------
+// Everything the main pass needs to draw one entity,
+// resolved ahead of time so drawing never has to chase
+// (or copy) shared_ptrs
+//
+// - Raw pointers are safe as long as the list holds the
+//   entity, which holds its mesh, material and transform
+// - Call RenderList::Update after changing an entity's mesh
+//   or material so its record is rebuilt
+// --------------------------------------------------------
+struct DrawRecord
+{
+	GameEntity* Entity;
+	Transform* EntityTransform;
+	Mesh* EntityMesh;
+	Material* EntityMaterial;
+	SimpleVertexShader* VertexShader;
+	SimplePixelShader* PixelShader;
+	RenderHandle Handle;
+};
+
+// Fills in a record's pointers from its entity (GameEntity::ResolveDrawRecord in the game)
+typedef void (*DrawRecordResolver)(DrawRecord& record, GameEntity* entity);
+
+// --------------------------------------------------------
+// Timings from Game::BenchmarkRenderList, in milliseconds
+// --------------------------------------------------------
+struct RenderListBenchmarkResults
+{
+	unsigned int EntityCount;
+	double EntityWalkMs;	// one frame's worth of walking the entity vector
+	double RecordWalkMs;	// one frame's worth of walking the render list
+	double AddMs;			// adding every entity
+	double ChurnMs;			// removing, re-adding and updating a tenth of them
+};
+
+// --------------------------------------------------------
+// A retained list of draws, patched as entities come and go
+// instead of being rebuilt every frame
+//
+// - Records are packed densely, so drawing is a straight walk
+//   over an array
+// - Add, Remove and Update are O(1) (amortized for Add).
+//   Remove swaps the last record into the hole, so draw
+//   order is not preserved across removals.
+// - Only ever follows entities through the resolver, so it
+//   builds without D3D (see Tools/RenderListBenchMain.cpp)
+// --------------------------------------------------------
+class RenderList
+{
+public:
+	static constexpr RenderHandle InvalidHandle = 0xFFFFFFFF;
+
+	/// <summary>
+	/// Creates an empty list
+	/// </summary>
+	/// <param name="resolve">fills in a record whenever an entity is added or updated</param>
+	RenderList(DrawRecordResolver resolve);
+	~RenderList();
+
+	RenderHandle Add(std::shared_ptr<GameEntity> entity);
+	void Remove(RenderHandle handle);
+	void Update(RenderHandle handle);	// re-resolve after the entity's mesh or material changed
+	void Clear();
+	void Reserve(unsigned int count);
+
+	// GETTERS
+	bool Contains(RenderHandle handle);
+	unsigned int GetCount();
+	const std::vector<DrawRecord>& GetRecords();
+	std::shared_ptr<GameEntity> GetEntity(RenderHandle handle);
+
+private:
+	DrawRecordResolver resolve;
+	std::vector<DrawRecord> records;						// dense, in draw order
+	std::vector<std::shared_ptr<GameEntity>> owners;		// parallel to records, keeps entities alive
+	std::vector<unsigned int> handleToIndex;				// InvalidHandle when the handle is free
+	std::vector<RenderHandle> freeHandles;
+};
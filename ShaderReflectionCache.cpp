@@ -0,0 +1,169 @@
+#include "ShaderReflectionCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+// --------------------------------------------------------
+// Little writer and reader for the flat format
+// --------------------------------------------------------
+namespace
+{
+	struct Writer
+	{
+		std::vector<unsigned char> Bytes;
+
+		void Raw(const void* data, size_t size)
+		{
+			const unsigned char* b = (const unsigned char*)data;
+			Bytes.insert(Bytes.end(), b, b + size);
+		}
+		void U32(unsigned int v) { Raw(&v, sizeof(v)); }
+		void U64(unsigned long long v) { Raw(&v, sizeof(v)); }
+		void String(const std::string& s) { U32((unsigned int)s.size()); Raw(s.data(), s.size()); }
+	};
+
+	struct Reader
+	{
+		const unsigned char* At;
+		const unsigned char* End;
+		bool Ok;
+
+		bool Raw(void* data, size_t size)
+		{
+			if (!Ok || (size_t)(End - At) < size) return Ok = false;
+			memcpy(data, At, size);
+			At += size;
+			return true;
+		}
+		unsigned int U32() { unsigned int v = 0; Raw(&v, sizeof(v)); return v; }
+		unsigned long long U64() { unsigned long long v = 0; Raw(&v, sizeof(v)); return v; }
+		std::string String()
+		{
+			unsigned int length = U32();
+			if (!Ok || (size_t)(End - At) < length) { Ok = false; return ""; }
+			std::string s((const char*)At, length);
+			At += length;
+			return s;
+		}
+
+		// a count that can't possibly fit in what's left is corrupt, not a reason to allocate
+		unsigned int Count(size_t minimumEach)
+		{
+			unsigned int count = U32();
+			if (Ok && (size_t)(End - At) / minimumEach < count) Ok = false;
+			return Ok ? count : 0;
+		}
+	};
+}
+
+std::filesystem::path ShaderReflectionCache::GetPath(const std::filesystem::path& shaderFile)
+{
+	std::filesystem::path path = shaderFile;
+	path += ".refl";
+	return path;
+}
+
+std::vector<unsigned char> ShaderReflectionCache::Serialize(const ShaderReflectionData& data)
+{
+	Writer w;
+	w.U32(Magic);
+	w.U32(Version);
+	w.U64(data.BytecodeHash);
+
+	w.U32((unsigned int)data.ConstantBuffers.size());
+	for (auto& cb : data.ConstantBuffers) {
+		w.String(cb.Name);
+		w.U32(cb.Type);
+		w.U32(cb.BindIndex);
+		w.U32(cb.Size);
+		w.U32((unsigned int)cb.Variables.size());
+		for (auto& v : cb.Variables) {
+			w.String(v.Name);
+			w.U32(v.ByteOffset);
+			w.U32(v.Size);
+		}
+	}
+
+	for (auto* list : { &data.ShaderResources, &data.Samplers }) {
+		w.U32((unsigned int)list->size());
+		for (auto& r : *list) {
+			w.String(r.Name);
+			w.U32(r.BindIndex);
+		}
+	}
+
+	w.U32((unsigned int)data.InputElements.size());
+	for (auto& e : data.InputElements) {
+		w.String(e.SemanticName);
+		w.U32(e.SemanticIndex);
+		w.U32(e.Format);
+		w.U32(e.PerInstance ? 1 : 0);
+	}
+	return w.Bytes;
+}
+
+bool ShaderReflectionCache::Deserialize(const unsigned char* bytes, size_t size, ShaderReflectionData& data)
+{
+	Reader r = { bytes, bytes + size, true };
+	if (r.U32() != Magic || r.U32() != Version) return false;
+
+	ShaderReflectionData read = {};
+	read.BytecodeHash = r.U64();
+
+	// smallest possible entries: an empty string (4) plus their numbers
+	read.ConstantBuffers.resize(r.Count(20));
+	for (auto& cb : read.ConstantBuffers) {
+		cb.Name = r.String();
+		cb.Type = r.U32();
+		cb.BindIndex = r.U32();
+		cb.Size = r.U32();
+		cb.Variables.resize(r.Count(12));
+		for (auto& v : cb.Variables) {
+			v.Name = r.String();
+			v.ByteOffset = r.U32();
+			v.Size = r.U32();
+		}
+	}
+
+	for (auto* list : { &read.ShaderResources, &read.Samplers }) {
+		list->resize(r.Count(8));
+		for (auto& res : *list) {
+			res.Name = r.String();
+			res.BindIndex = r.U32();
+		}
+	}
+
+	read.InputElements.resize(r.Count(16));
+	for (auto& e : read.InputElements) {
+		e.SemanticName = r.String();
+		e.SemanticIndex = r.U32();
+		e.Format = r.U32();
+		e.PerInstance = r.U32() != 0;
+	}
+
+	if (!r.Ok || r.At != r.End) return false;
+	data = std::move(read);
+	return true;
+}
+
+bool ShaderReflectionCache::Save(const std::filesystem::path& path, const ShaderReflectionData& data)
+{
+	std::vector<unsigned char> bytes = Serialize(data);
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)bytes.data(), bytes.size());
+	return (bool)out;
+}
+
+bool ShaderReflectionCache::Load(const std::filesystem::path& path, unsigned long long bytecodeHash, ShaderReflectionData& data)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+	std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	ShaderReflectionData read;
+	if (!Deserialize(bytes.data(), bytes.size(), read) || read.BytecodeHash != bytecodeHash)
+		return false;
+	data = std::move(read);
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// What SimpleShader needs from reflecting a shader, as
+// plain data (D3D enums are stored as their values)
+// --------------------------------------------------------
+struct ReflectedVariable
+{
+	std::string Name;
+	unsigned int ByteOffset;
+	unsigned int Size;
+};
+
+struct ReflectedConstantBuffer
+{
+	std::string Name;
+	unsigned int Type;			// D3D_CBUFFER_TYPE
+	unsigned int BindIndex;
+	unsigned int Size;
+	std::vector<ReflectedVariable> Variables;
+};
+
+// A texture, structured buffer or sampler
+struct ReflectedResource
+{
+	std::string Name;
+	unsigned int BindIndex;
+};
+
+// One vertex shader input, ready for an input layout
+struct ReflectedInputElement
+{
+	std::string SemanticName;
+	unsigned int SemanticIndex;
+	unsigned int Format;		// DXGI_FORMAT
+	bool PerInstance;			// semantic ends in _PER_INSTANCE
+};
+
+struct ShaderReflectionData
+{
+	unsigned long long BytecodeHash;
+	std::vector<ReflectedConstantBuffer> ConstantBuffers;
+	std::vector<ReflectedResource> ShaderResources;
+	std::vector<ReflectedResource> Samplers;
+	std::vector<ReflectedInputElement> InputElements;	// vertex shaders only
+};
+
+// --------------------------------------------------------
+// Reflection results saved next to each compiled shader
+//
+// - Stored as <shader>.refl in a flat little-endian format:
+//   magic, version, bytecode hash, then counted lists with
+//   length-prefixed strings
+// - Keyed by the hash of the bytecode, so recompiling a
+//   shader makes its old file a miss instead of a lie
+// - Only depends on the standard library, so it can be
+//   tested without D3D
+// --------------------------------------------------------
+class ShaderReflectionCache
+{
+public:
+	static const unsigned int Magic = 0x4c464552;	// "REFL"
+	static const unsigned int Version = 1;
+
+	static std::filesystem::path GetPath(const std::filesystem::path& shaderFile);
+
+	static std::vector<unsigned char> Serialize(const ShaderReflectionData& data);
+
+	/// <summary>
+	/// Reads serialized reflection data
+	/// </summary>
+	/// <returns>false if it's truncated, from another version or not reflection data</returns>
+	static bool Deserialize(const unsigned char* bytes, size_t size, ShaderReflectionData& data);
+
+	static bool Save(const std::filesystem::path& path, const ShaderReflectionData& data);
+
+	/// <summary>
+	/// Loads a shader's reflection data, if it's there and matches the bytecode
+	/// </summary>
+	static bool Load(const std::filesystem::path& path, unsigned long long bytecodeHash, ShaderReflectionData& data);
+};
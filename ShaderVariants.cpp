@@ -0,0 +1,232 @@
+#include "ShaderVariants.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+ShaderVariantCache::ShaderVariantCache(const std::string& directory) :
+	directory(directory)
+{
+	stats = {};
+}
+
+
+// --------------------------------------------------------
+// Hashing
+// --------------------------------------------------------
+unsigned long long ShaderVariantCache::Hash(const void* data, size_t size, unsigned long long hash)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= HashPrime;
+	}
+	return hash;
+}
+
+unsigned long long ShaderVariantCache::HashKey(const ShaderVariantKey& key)
+{
+	// strings keep their terminators, so "ab"+"c" and "a"+"bc" differ
+	unsigned long long hash = HashOffset;
+	hash = Hash(key.Source.c_str(), key.Source.size() + 1, hash);
+	hash = Hash(key.Entry.c_str(), key.Entry.size() + 1, hash);
+	hash = Hash(key.Profile.c_str(), key.Profile.size() + 1, hash);
+	hash = Hash(&key.Features, sizeof(key.Features), hash);
+	hash = Hash(&key.SourceHash, sizeof(key.SourceHash), hash);
+	return hash;
+}
+
+unsigned long long ShaderVariantCache::HashSourceFile(const std::string& path)
+{
+	std::vector<std::string> pending = { path };
+	std::vector<std::string> visited;
+	unsigned long long hash = HashOffset;
+
+	while (!pending.empty()) {
+		std::filesystem::path file = pending.back();
+		pending.pop_back();
+		std::string name = file.lexically_normal().string();
+		bool seen = false;
+		for (auto& v : visited) if (v == name) seen = true;
+		if (seen) continue;
+		visited.push_back(name);
+
+		std::ifstream in(file, std::ios::binary);
+		if (!in) {
+			// the file being hashed has to exist, its includes may be system ones
+			if (visited.size() == 1) return 0;
+			continue;
+		}
+		std::stringstream contents;
+		contents << in.rdbuf();
+		std::string text = contents.str();
+		hash = Hash(text.data(), text.size(), hash);
+
+		// queue its quoted includes
+		std::istringstream lines(text);
+		std::string line;
+		while (std::getline(lines, line)) {
+			size_t at = line.find("#include");
+			if (at == std::string::npos) continue;
+			size_t open = line.find('"', at);
+			size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close == std::string::npos) continue;
+			pending.push_back((file.parent_path() / line.substr(open + 1, close - open - 1)).string());
+		}
+	}
+	return hash;
+}
+
+std::string ShaderVariantCache::FindSourceFile(const std::vector<std::string>& candidates)
+{
+	std::error_code ec;
+	for (auto& path : candidates)
+		if (std::filesystem::is_regular_file(path, ec)) return path;
+	return "";
+}
+
+std::vector<ShaderDefine> ShaderVariantCache::GetDefines(unsigned int features)
+{
+	static const char* names[ShaderFeatureCount] = {
+		"HAS_NORMAL_MAP",
+		"HAS_ROUGHNESS_MAP",
+		"HAS_METALNESS_MAP",
+		"RECEIVES_SHADOWS",
+		"CLUSTERED_LIGHTS",
+		"TEXTURE_ARRAYS",
+		"HAS_ORM_MAP",
+		"IMAGE_LIGHTING"
+	};
+
+	std::vector<ShaderDefine> defines;
+	for (unsigned int i = 0; i < ShaderFeatureCount; i++)
+		defines.push_back({ names[i], (features & (1u << i)) ? "1" : "0" });
+	return defines;
+}
+
+std::string ShaderVariantCache::DescribeFeatures(unsigned int features)
+{
+	static const char* names[ShaderFeatureCount] = { "normal", "roughness", "metalness", "shadows", "clustered", "arrays", "orm", "ibl" };
+
+	std::string text;
+	for (unsigned int i = 0; i < ShaderFeatureCount; i++) {
+		if (!(features & (1u << i))) continue;
+		if (!text.empty()) text += "+";
+		text += names[i];
+	}
+	return text.empty() ? "none" : text;
+}
+
+
+// --------------------------------------------------------
+// The index
+//
+// One variant per line:
+//   <hash> <features> <file> <source> <entry> <profile>
+// with the hash and features in hex
+// --------------------------------------------------------
+bool ShaderVariantCache::LoadIndex()
+{
+	entries.clear();
+	std::ifstream in(std::filesystem::path(directory) / "index.txt");
+	if (!in) return false;
+
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+		unsigned long long hash = 0;
+		IndexEntry e = {};
+		if (fields >> std::hex >> hash >> e.Features >> e.File >> e.Source >> e.Entry >> e.Profile)
+			entries[hash] = e;
+	}
+	stats.Entries = (unsigned int)entries.size();
+	return true;
+}
+
+bool ShaderVariantCache::SaveIndex()
+{
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+
+	std::ofstream out(std::filesystem::path(directory) / "index.txt", std::ios::trunc);
+	if (!out) return false;
+
+	char hash[17];
+	for (auto& e : entries) {
+		snprintf(hash, sizeof(hash), "%016llx", e.first);
+		out << hash << " " << std::hex << e.second.Features << std::dec << " " << e.second.File << " "
+			<< e.second.Source << " " << e.second.Entry << " " << e.second.Profile << "\n";
+	}
+	return (bool)out;
+}
+
+
+// --------------------------------------------------------
+// Lookups
+// --------------------------------------------------------
+std::string ShaderVariantCache::GetPath(const ShaderVariantKey& key)
+{
+	char file[24];
+	snprintf(file, sizeof(file), "%016llx.cso", HashKey(key));
+	return (std::filesystem::path(directory) / file).string();
+}
+
+std::string ShaderVariantCache::Find(const ShaderVariantKey& key)
+{
+	auto found = entries.find(HashKey(key));
+	std::string path = GetPath(key);
+	if (found == entries.end() || !std::filesystem::exists(path)) {
+		stats.Misses++;
+		return "";
+	}
+	stats.Hits++;
+	return path;
+}
+
+bool ShaderVariantCache::Store(const ShaderVariantKey& key, const std::vector<unsigned char>& bytecode)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+
+	std::string path = GetPath(key);
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)bytecode.data(), bytecode.size());
+	if (!out) {
+		lastError = "couldn't write " + path;
+		return false;
+	}
+
+	IndexEntry e = { key.Features, std::filesystem::path(path).filename().string(), key.Source, key.Entry, key.Profile };
+	entries[HashKey(key)] = e;
+	stats.Entries = (unsigned int)entries.size();
+	return true;
+}
+
+std::string ShaderVariantCache::FindOrCompile(const std::string& sourcePath, const ShaderVariantKey& key, ShaderCompileFunction compile)
+{
+	std::string path = Find(key);
+	if (!path.empty()) return path;
+
+	std::vector<unsigned char> bytecode;
+	std::string errors;
+	if (!compile || !compile(sourcePath, key, GetDefines(key.Features), bytecode, errors)) {
+		stats.Failed++;
+		lastError = key.Source + " (" + DescribeFeatures(key.Features) + "): " + errors;
+		return "";
+	}
+	if (!Store(key, bytecode)) {
+		stats.Failed++;
+		return "";
+	}
+	stats.Compiled++;
+	return GetPath(key);
+}
+
+
+// --------------------------------------------------------
+// GETTERS
+// --------------------------------------------------------
+const std::string& ShaderVariantCache::GetDirectory() { return directory; }
+const std::string& ShaderVariantCache::GetLastError() { return lastError; }
+ShaderVariantCacheStats ShaderVariantCache::GetStats() { return stats; }
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// --------------------------------------------------------
+// Optional parts of the main pixel shader, as bits
+//
+// - Materials declare the ones they have textures for
+// - The frame decides the rest (whether any light casts a
+//   shadow, whether there are clustered lights, whether the
+//   sky's baked lighting is there to use)
+// --------------------------------------------------------
+enum ShaderFeature
+{
+	ShaderFeatureNormalMap = 0x1,
+	ShaderFeatureRoughnessMap = 0x2,
+	ShaderFeatureMetalnessMap = 0x4,
+	ShaderFeatureShadows = 0x8,
+	ShaderFeatureClusteredLights = 0x10,
+	ShaderFeatureTextureArrays = 0x20,		// material textures come from shared arrays
+	ShaderFeatureORMMap = 0x40,				// occlusion, roughness and metalness packed in one texture
+	ShaderFeatureImageLighting = 0x80		// ambient light from the sky's IBL bake instead of a flat color
+};
+
+static const unsigned int ShaderFeatureCount = 8;
+static const unsigned int ShaderFeaturesMaterial = ShaderFeatureNormalMap | ShaderFeatureRoughnessMap | ShaderFeatureMetalnessMap | ShaderFeatureTextureArrays | ShaderFeatureORMMap;
+static const unsigned int ShaderFeaturesFrame = ShaderFeatureShadows | ShaderFeatureClusteredLights | ShaderFeatureImageLighting;
+static const unsigned int ShaderFeaturesAll = ShaderFeaturesMaterial | ShaderFeaturesFrame;
+
+// A preprocessor define handed to the shader compiler
+struct ShaderDefine
+{
+	std::string Name;
+	std::string Value;
+};
+
+// --------------------------------------------------------
+// Everything that decides a variant's bytecode
+// --------------------------------------------------------
+struct ShaderVariantKey
+{
+	std::string Source;				// source file name (no directory)
+	std::string Entry;
+	std::string Profile;			// ps_5_0, ...
+	unsigned int Features;			// ShaderFeature bits
+	unsigned long long SourceHash;	// contents of the source and its includes
+};
+
+struct ShaderVariantCacheStats
+{
+	unsigned int Entries;		// variants in the index
+	unsigned int Hits;			// found on disk
+	unsigned int Misses;
+	unsigned int Compiled;		// misses that compiled and were stored
+	unsigned int Failed;		// misses that didn't compile
+};
+
+// Compiles one variant: source path, key and defines in, bytecode (or errors) out
+typedef std::function<bool(const std::string& sourcePath, const ShaderVariantKey& key,
+	const std::vector<ShaderDefine>& defines, std::vector<unsigned char>& bytecode, std::string& errors)> ShaderCompileFunction;
+
+// --------------------------------------------------------
+// An on-disk cache of compiled shader variants
+//
+// - Each variant is stored as <hash>.cso in the cache's
+//   directory, named by a 64 bit FNV-1a hash of its key
+// - index.txt lists what's there (hash, features, file,
+//   source, entry, profile), so a lookup never has to touch
+//   the disk to find out a variant is missing
+// - Changing the source (or anything it includes) changes
+//   every key, so stale variants are simply never found
+// - The compiler is passed in, so the cache itself only
+//   depends on the standard library
+// --------------------------------------------------------
+class ShaderVariantCache
+{
+public:
+	static const unsigned long long HashOffset = 0xcbf29ce484222325ull;
+	static const unsigned long long HashPrime = 0x100000001b3ull;
+
+	ShaderVariantCache(const std::string& directory);
+
+	// FNV-1a, continuing from hash
+	static unsigned long long Hash(const void* data, size_t size, unsigned long long hash = HashOffset);
+	static unsigned long long HashKey(const ShaderVariantKey& key);
+
+	/// <summary>
+	/// Hashes a source file and every file it #includes with quotes
+	/// (looked up next to the file that includes them)
+	/// </summary>
+	/// <returns>0 if the file can't be read</returns>
+	static unsigned long long HashSourceFile(const std::string& path);
+
+	/// <summary>
+	/// The first of several places a source file might be that has it
+	/// </summary>
+	/// <returns>empty if none of them do</returns>
+	static std::string FindSourceFile(const std::vector<std::string>& candidates);
+
+	// The defines that turn features on (every feature gets one, 0 or 1)
+	static std::vector<ShaderDefine> GetDefines(unsigned int features);
+	static std::string DescribeFeatures(unsigned int features);
+
+	bool LoadIndex();
+	bool SaveIndex();
+
+	// Where a variant's bytecode lives, whether or not it's there yet
+	std::string GetPath(const ShaderVariantKey& key);
+
+	/// <summary>
+	/// Path of a cached variant, or empty if there isn't one
+	/// </summary>
+	std::string Find(const ShaderVariantKey& key);
+
+	/// <summary>
+	/// Writes a variant's bytecode and adds it to the index
+	/// (the index isn't saved until SaveIndex)
+	/// </summary>
+	bool Store(const ShaderVariantKey& key, const std::vector<unsigned char>& bytecode);
+
+	/// <summary>
+	/// Finds a variant, compiling and storing it on a miss
+	/// </summary>
+	/// <returns>path of the variant's bytecode, empty if it couldn't be compiled</returns>
+	std::string FindOrCompile(const std::string& sourcePath, const ShaderVariantKey& key, ShaderCompileFunction compile);
+
+	const std::string& GetDirectory();
+	const std::string& GetLastError();
+	ShaderVariantCacheStats GetStats();
+
+private:
+	struct IndexEntry
+	{
+		unsigned int Features;
+		std::string File;
+		std::string Source;
+		std::string Entry;
+		std::string Profile;
+	};
+
+	std::string directory;
+	std::unordered_map<unsigned long long, IndexEntry> entries;
+	std::string lastError;
+	ShaderVariantCacheStats stats;
+};
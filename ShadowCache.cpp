@@ -0,0 +1,258 @@
+#include "ShadowCache.h"
+
+#include <cstring>
+#include <algorithm>
+
+using namespace DirectX;
+
+// how far (in texels) to grow the dirty region, so the bias
+// and filtered lookups near its edge still see fresh depth
+static const int DirtyPadding = 2;
+
+ShadowCache::ShadowCache(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	unsigned int resolution,
+	const D3D11_RASTERIZER_DESC& casterRasterDesc,
+	std::shared_ptr<SimpleVertexShader> clearVS) :
+	resolution(resolution),
+	clearVS(clearVS)
+{
+	// static depth, same size and format as the live map so it can be copied over
+	D3D11_TEXTURE2D_DESC texDesc = {};
+	texDesc.Width = resolution;
+	texDesc.Height = resolution;
+	texDesc.ArraySize = 1;
+	texDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+	texDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+	texDesc.MipLevels = 1;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.Usage = D3D11_USAGE_DEFAULT;
+	device->CreateTexture2D(&texDesc, 0, staticTexture.GetAddressOf());
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+	dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	device->CreateDepthStencilView(staticTexture.Get(), &dsvDesc, staticDSV.GetAddressOf());
+
+	// casters are drawn exactly like the live map, but clipped to the dirty region
+	D3D11_RASTERIZER_DESC casterDesc = casterRasterDesc;
+	casterDesc.ScissorEnable = true;
+	device->CreateRasterizerState(&casterDesc, casterRasterizer.GetAddressOf());
+
+	D3D11_RASTERIZER_DESC clearDesc = {};
+	clearDesc.FillMode = D3D11_FILL_SOLID;
+	clearDesc.CullMode = D3D11_CULL_NONE;
+	clearDesc.DepthClipEnable = true;
+	clearDesc.ScissorEnable = true;
+	device->CreateRasterizerState(&clearDesc, clearRasterizer.GetAddressOf());
+
+	// the clear triangle overwrites whatever depth is there
+	D3D11_DEPTH_STENCIL_DESC depthDesc = {};
+	depthDesc.DepthEnable = true;
+	depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+	depthDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+	device->CreateDepthStencilState(&depthDesc, clearDepthState.GetAddressOf());
+
+	valid = false;
+	XMStoreFloat4x4(&trackedView, XMMatrixIdentity());
+	XMStoreFloat4x4(&trackedProjection, XMMatrixIdentity());
+
+	fullyDirty = true;
+	dirtyBounds = Culling::EmptyBounds();
+	dirtyRect = { 0, 0, (LONG)resolution, (LONG)resolution };
+
+	stats = {};
+}
+
+ShadowCache::~ShadowCache()
+{
+}
+
+// --------------------------------------------------------
+// Works out this frame's dirty region
+//
+// - Light or entity list changes redraw everything
+// - A static entity whose transform changed (or that just
+//   became static / stopped being static) dirties both
+//   where it was and where it is now
+// - Dynamic entities never touch the static map
+// --------------------------------------------------------
+bool ShadowCache::Update(
+	const std::vector<Light>& lights,
+	const XMFLOAT4X4& lightView,
+	const XMFLOAT4X4& lightProjection,
+	const std::vector<std::shared_ptr<GameEntity>>& entities,
+	const std::vector<ProjectedBounds>& lightBounds)
+{
+	fullyDirty = !valid;
+	dirtyBounds = Culling::EmptyBounds();
+
+	stats.FullRebuild = false;
+	stats.DirtyTexels = 0;
+	stats.StaticRedrawn = 0;
+
+	// any change to a shadow casting light invalidates the whole map
+	std::vector<Light> shadowLights;
+	for (const Light& l : lights)
+		if (l.castsShadows) shadowLights.push_back(l);
+
+	if (shadowLights.size() != trackedLights.size() ||
+		(!shadowLights.empty() && memcmp(&shadowLights[0], &trackedLights[0], sizeof(Light) * shadowLights.size()) != 0) ||
+		memcmp(&lightView, &trackedView, sizeof(XMFLOAT4X4)) != 0 ||
+		memcmp(&lightProjection, &trackedProjection, sizeof(XMFLOAT4X4)) != 0)
+	{
+		fullyDirty = true;
+		trackedLights = shadowLights;
+		trackedView = lightView;
+		trackedProjection = lightProjection;
+	}
+
+	// so does adding or removing entities
+	bool sameEntities = trackedEntities.size() == entities.size();
+	for (size_t i = 0; sameEntities && i < entities.size(); i++)
+		sameEntities = trackedEntities[i].Entity == entities[i].get();
+
+	if (!sameEntities) {
+		fullyDirty = true;
+		trackedEntities.resize(entities.size());
+	}
+
+	for (size_t i = 0; i < entities.size(); i++) {
+		GameEntity* e = entities[i].get();
+		unsigned int version = e->GetTransform()->GetVersion();
+		bool isStatic = e->IsStatic();
+
+		TrackedEntity& t = trackedEntities[i];
+		if (!fullyDirty && (t.Static || isStatic) && (t.Static != isStatic || t.Version != version)) {
+			if (t.Static) DirtyBounds(t.Bounds);
+			if (isStatic) DirtyBounds(lightBounds[i]);
+		}
+
+		t = { e, version, isStatic, lightBounds[i] };
+	}
+
+	valid = true;
+
+	// where does the redraw land in the map?
+	if (fullyDirty) {
+		dirtyRect = { 0, 0, (LONG)resolution, (LONG)resolution };
+		stats.FullRebuild = true;
+		stats.FullRebuilds++;
+	}
+	else {
+		dirtyRect = ToTexels(dirtyBounds);
+		if (dirtyRect.right <= dirtyRect.left || dirtyRect.bottom <= dirtyRect.top)
+			return false;
+
+		stats.PartialRebuilds++;
+	}
+
+	stats.DirtyTexels = (unsigned int)((dirtyRect.right - dirtyRect.left) * (dirtyRect.bottom - dirtyRect.top));
+	return true;
+}
+
+bool ShadowCache::NeedsRedraw(const ProjectedBounds& caster)
+{
+	if (caster.Empty) return false;
+	if (fullyDirty) return true;
+
+	D3D11_RECT r = ToTexels(caster);
+	return
+		r.left < dirtyRect.right && r.right > dirtyRect.left &&
+		r.top < dirtyRect.bottom && r.bottom > dirtyRect.top;
+}
+
+// --------------------------------------------------------
+// Resets the dirty region to the far plane.  Depth views
+// can't be cleared partially, so anything short of the
+// whole map is cleared with a scissored triangle instead.
+// --------------------------------------------------------
+void ShadowCache::ClearDirtyRegion(ID3D11DeviceContext* context)
+{
+	if (fullyDirty) {
+		context->ClearDepthStencilView(staticDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		return;
+	}
+
+	D3D11_VIEWPORT vp = {};
+	vp.Width = (float)resolution;
+	vp.Height = (float)resolution;
+	vp.MaxDepth = 1.0f;
+
+	context->OMSetRenderTargets(0, 0, staticDSV.Get());
+	context->OMSetDepthStencilState(clearDepthState.Get(), 0);
+	context->RSSetState(clearRasterizer.Get());
+	context->RSSetViewports(1, &vp);
+	context->RSSetScissorRects(1, &dirtyRect);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	clearVS->SetShader();
+	context->PSSetShader(0, 0, 0);
+	context->Draw(3, 0);
+
+	// don't leave the always-pass state around for whoever's next
+	context->OMSetDepthStencilState(0, 0);
+	context->RSSetState(0);
+}
+
+void ShadowCache::BindStaticTarget(ID3D11DeviceContext* context)
+{
+	D3D11_VIEWPORT vp = {};
+	vp.Width = (float)resolution;
+	vp.Height = (float)resolution;
+	vp.MaxDepth = 1.0f;
+
+	context->OMSetRenderTargets(0, 0, staticDSV.Get());
+	context->RSSetState(casterRasterizer.Get());
+	context->RSSetViewports(1, &vp);
+	context->RSSetScissorRects(1, &dirtyRect);
+}
+
+void ShadowCache::CopyToShadowMap(ID3D11DeviceContext* context, ID3D11Resource* shadowMap)
+{
+	context->CopyResource(shadowMap, staticTexture.Get());
+}
+
+void ShadowCache::Invalidate()
+{
+	valid = false;
+}
+
+ShadowCacheStats ShadowCache::GetStats()
+{
+	return stats;
+}
+
+void ShadowCache::CountStaticRedrawn(unsigned int count)
+{
+	stats.StaticRedrawn = count;
+}
+
+void ShadowCache::DirtyBounds(const ProjectedBounds& bounds)
+{
+	// only the part inside the map matters
+	if (!Culling::CasterInLightVolume(bounds)) return;
+	Culling::MergeBounds(dirtyBounds, bounds);
+}
+
+// --------------------------------------------------------
+// Light space NDC bounds to a (padded, clamped) texel rect.
+// NDC y points up, texel y points down.
+// --------------------------------------------------------
+D3D11_RECT ShadowCache::ToTexels(const ProjectedBounds& bounds)
+{
+	if (bounds.Empty) return { 0, 0, 0, 0 };
+
+	float res = (float)resolution;
+	float left = (std::max(bounds.Min.x, -1.0f) * 0.5f + 0.5f) * res;
+	float right = (std::min(bounds.Max.x, 1.0f) * 0.5f + 0.5f) * res;
+	float top = (0.5f - std::min(bounds.Max.y, 1.0f) * 0.5f) * res;
+	float bottom = (0.5f - std::max(bounds.Min.y, -1.0f) * 0.5f) * res;
+
+	D3D11_RECT r;
+	r.left = std::max((LONG)left - DirtyPadding, (LONG)0);
+	r.top = std::max((LONG)top - DirtyPadding, (LONG)0);
+	r.right = std::min((LONG)right + 1 + DirtyPadding, (LONG)resolution);
+	r.bottom = std::min((LONG)bottom + 1 + DirtyPadding, (LONG)resolution);
+	return r;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+
+#include "GameEntity.h"
+#include "Lights.h"
+#include "Culling.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Per-frame static shadow cache results
+// --------------------------------------------------------
+struct ShadowCacheStats
+{
+	bool FullRebuild;				// whole static map redrawn this frame
+	unsigned int DirtyTexels;		// area of the region redrawn this frame
+	unsigned int StaticRedrawn;		// static casters drawn into the cache this frame
+	unsigned int FullRebuilds;		// total since startup
+	unsigned int PartialRebuilds;	// total since startup
+};
+
+// --------------------------------------------------------
+// Keeps the depth of every static shadow caster in its own
+// map, so only dynamic casters are drawn each frame.
+//
+// - The static map is only redrawn where something changed:
+//   a static entity that moved dirties the texels under its
+//   old and new light space bounds, which are reset to the
+//   far plane and redrawn with a scissor rect
+// - Any change to a shadow casting light (or the light's
+//   matrices) redraws the whole thing
+// - Each frame the static map is copied into the live
+//   shadow map, and dynamic casters are drawn on top
+// --------------------------------------------------------
+class ShadowCache
+{
+public:
+	ShadowCache(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		unsigned int resolution,
+		const D3D11_RASTERIZER_DESC& casterRasterDesc,
+		std::shared_ptr<SimpleVertexShader> clearVS);
+	~ShadowCache();
+
+	/// <summary>
+	/// Compares the scene to what the static map was last drawn from
+	/// and works out which part of it needs redrawing this frame
+	/// </summary>
+	/// <param name="lights">all lights; only shadow casters are tracked</param>
+	/// <param name="lightView">light's view matrix</param>
+	/// <param name="lightProjection">light's projection matrix</param>
+	/// <param name="entities">every entity in the scene</param>
+	/// <param name="lightBounds">each entity's bounds projected by the light</param>
+	/// <returns>true if some of the static map needs redrawing</returns>
+	bool Update(
+		const std::vector<Light>& lights,
+		const DirectX::XMFLOAT4X4& lightView,
+		const DirectX::XMFLOAT4X4& lightProjection,
+		const std::vector<std::shared_ptr<GameEntity>>& entities,
+		const std::vector<ProjectedBounds>& lightBounds);
+
+	/// <summary>
+	/// Does a static caster touch the region being redrawn this frame?
+	/// </summary>
+	bool NeedsRedraw(const ProjectedBounds& caster);
+
+	/// <summary>
+	/// Resets the dirty region of the static map to the far plane
+	/// </summary>
+	void ClearDirtyRegion(ID3D11DeviceContext* context);
+
+	/// <summary>
+	/// Binds the static map, clipped to the dirty region, for drawing static casters
+	/// </summary>
+	void BindStaticTarget(ID3D11DeviceContext* context);
+
+	/// <summary>
+	/// Copies the static map into the live shadow map (same size and format)
+	/// </summary>
+	void CopyToShadowMap(ID3D11DeviceContext* context, ID3D11Resource* shadowMap);
+
+	/// <summary>
+	/// Forces a full redraw next frame
+	/// </summary>
+	void Invalidate();
+
+	// GETTERS
+	ShadowCacheStats GetStats();
+	void CountStaticRedrawn(unsigned int count);
+
+private:
+	// What an entity looked like the last time the static map saw it
+	struct TrackedEntity
+	{
+		GameEntity* Entity;
+		unsigned int Version;
+		bool Static;
+		ProjectedBounds Bounds;
+	};
+
+	void DirtyBounds(const ProjectedBounds& bounds);
+	D3D11_RECT ToTexels(const ProjectedBounds& bounds);
+
+	unsigned int resolution;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> staticTexture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> staticDSV;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> casterRasterizer;	// shadow rasterizer + scissor
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> clearRasterizer;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilState> clearDepthState;	// always pass, always write
+	std::shared_ptr<SimpleVertexShader> clearVS;
+
+	// what the static map was drawn from
+	bool valid;
+	std::vector<Light> trackedLights;
+	DirectX::XMFLOAT4X4 trackedView;
+	DirectX::XMFLOAT4X4 trackedProjection;
+	std::vector<TrackedEntity> trackedEntities;
+
+	// this frame's redraw region
+	bool fullyDirty;
+	ProjectedBounds dirtyBounds;
+	D3D11_RECT dirtyRect;
+
+	ShadowCacheStats stats;
+};
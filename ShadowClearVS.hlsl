@@ -0,0 +1,10 @@
+
+// fullscreen triangle sitting on the far plane
+// - drawn with depth test ALWAYS and a scissor rect, this
+//   resets just part of a shadow map back to "nothing here"
+float4 main( uint id : SV_VertexID ) : SV_POSITION
+{
+	// (0,0), (2,0), (0,2) in uv, which covers the whole screen
+	float2 uv = float2((id << 1) & 2, id & 2);
+	return float4(uv * float2(2, -2) + float2(-1, 1), 1.0f, 1.0f);
+}
@@ -7,8 +7,9 @@ cbuffer ExternalData : register(b0) {
 	matrix projection;
 }
 
-float4 main( VertexShaderInput input ) : SV_POSITION
+// positions only, so the input layout matches Mesh::DrawDepthOnly's stream
+float4 main( float3 localPosition : POSITION ) : SV_POSITION
 {
     matrix wvp = mul(projection, mul(view, world));
-    return mul(wvp, float4(input.localPosition, 1.0f));
+    return mul(wvp, float4(localPosition, 1.0f));
 }
\ No newline at end of file
@@ -4,6 +4,18 @@
 bool ISimpleShader::ReportErrors = false;
 bool ISimpleShader::ReportWarnings = false;
 
+// Reflection cache counts, for every shader since startup
+unsigned int ISimpleShader::ReflectionCacheHits = 0;
+unsigned int ISimpleShader::ReflectionCacheMisses = 0;
+
+// Default per-thread state: record into the shader's own context
+thread_local ID3D11DeviceContext* ISimpleShader::threadContext = 0;
+thread_local unsigned int ISimpleShader::threadSlot = 0;
+
+// Upload change tracking (buffers start with an epoch no slot has, see BuildTables)
+unsigned int ISimpleShader::slotEpochs[ISimpleShader::MaxThreadSlots] = {};
+SimpleShaderUploadStats ISimpleShader::slotUploadStats[ISimpleShader::MaxThreadSlots] = {};
+
 // To enable error reporting, use either or both 
 // of the following lines somewhere in your program, 
 // preferably before loading/using any shaders.
@@ -49,6 +61,9 @@ void ISimpleShader::CleanUp()
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
 		delete[] constantBuffers[i].LocalDataBuffer;
+		delete[] constantBuffers[i].ThreadDataBuffers;
+		delete[] constantBuffers[i].UploadedData;
+		delete[] constantBuffers[i].UploadStates;
 	}
 
 	if (constantBuffers)
@@ -64,6 +79,7 @@ void ISimpleShader::CleanUp()
 		delete samplerStates[i];
 
 	// Clean up tables
+	variables.clear();
 	varTable.clear();
 	cbTable.clear();
 	samplerTable.clear();
@@ -74,6 +90,11 @@ void ISimpleShader::CleanUp()
 // Loads the specified shader and builds the variable table 
 // using shader reflection.
 //
+// - Reflection results are cached next to the shader file
+//   (see ShaderReflectionCache), keyed by a hash of the
+//   bytecode, so after the first run loading is a read of
+//   the .cso, a read of the .refl and a table build
+//
 // shaderFile - A "wide string" specifying the compiled shader to load
 // 
 // Returns true if shader is loaded properly, false otherwise
@@ -94,6 +115,23 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
+	// Use the cached reflection if it's for this exact bytecode,
+	// otherwise reflect and cache it for next time
+	unsigned long long bytecodeHash = ShaderVariantCache::Hash(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize());
+	std::filesystem::path reflectionPath = ShaderReflectionCache::GetPath(shaderFile);
+	reflection = {};
+	if (ShaderReflectionCache::Load(reflectionPath, bytecodeHash, reflection))
+	{
+		ReflectionCacheHits++;
+	}
+	else
+	{
+		ReflectionCacheMisses++;
+		Reflect(shaderBlob, reflection);
+		reflection.BytecodeHash = bytecodeHash;
+		ShaderReflectionCache::Save(reflectionPath, reflection);
+	}
+
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -109,12 +147,20 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		return false;
 	}
 
-	// Set up shader reflection to get information about
-	// this shader and its variables,  buffers, etc.
+	BuildTables(reflection);
+	return true;
+}
+
+// --------------------------------------------------------
+// Uses shader reflection to get information about the
+// shader and its variables, buffers, etc. as plain data
+// --------------------------------------------------------
+void ISimpleShader::Reflect(Microsoft::WRL::ComPtr<ID3DBlob> blob, ShaderReflectionData& data)
+{
 	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
 	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
+		blob->GetBufferPointer(),
+		blob->GetBufferSize(),
 		IID_ID3D11ShaderReflection,
 		(void**)refl.GetAddressOf());
 	
@@ -122,10 +168,6 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	D3D11_SHADER_DESC shaderDesc;
 	refl->GetDesc(&shaderDesc);
 
-	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
-	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
-	
 	// Handle bound resources (like shaders and samplers)
 	unsigned int resourceCount = shaderDesc.BoundResources;
 	for (unsigned int r = 0; r < resourceCount; r++)
@@ -139,52 +181,138 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		{
 		case D3D_SIT_STRUCTURED: // Treat structured buffers as texture resources
 		case D3D_SIT_TEXTURE: // A texture resource
-		{
-			// Create the SRV wrapper
-			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
-			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
-
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
-			shaderResourceViews.push_back(srv);
-		}
+			data.ShaderResources.push_back({ resourceDesc.Name, resourceDesc.BindPoint });
 			break;
 
 		case D3D_SIT_SAMPLER: // A sampler resource
-		{
-			// Create the sampler wrapper
-			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
-			samp->Index = (unsigned int)samplerStates.size();	// Raw index
-
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
-			samplerStates.push_back(samp);
-		}
+			data.Samplers.push_back({ resourceDesc.Name, resourceDesc.BindPoint });
 			break;
 		}
 	}
 
 	// Loop through all constant buffers
-	for (unsigned int b = 0; b < constantBufferCount; b++)
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
 	{
-		// Get this buffer
+		// Get this buffer and its description
 		ID3D11ShaderReflectionConstantBuffer* cb =
 			refl->GetConstantBufferByIndex(b);
-		
-		// Get the description of this buffer
 		D3D11_SHADER_BUFFER_DESC bufferDesc;
 		cb->GetDesc(&bufferDesc);
 
-		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
 		// Get the description of the resource binding, so
 		// we know exactly how it's bound in the shader
 		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
 		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
-		
+
+		ReflectedConstantBuffer buffer = {};
+		buffer.Name = bufferDesc.Name;
+		buffer.Type = bufferDesc.Type;
+		buffer.BindIndex = bindDesc.BindPoint;
+		buffer.Size = bufferDesc.Size;
+
+		// Loop through all variables in this buffer
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
+			buffer.Variables.push_back({ varDesc.Name, varDesc.StartOffset, varDesc.Size });
+		}
+		data.ConstantBuffers.push_back(buffer);
+	}
+
+	// Vertex shaders also need their inputs, to make an input layout
+	// that matches what the shader expects.  Code adapted from:
+	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
+	if (D3D11_SHVER_GET_TYPE(shaderDesc.Version) != D3D11_SHVER_VERTEX_SHADER)
+		return;
+
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		// System generated values (like SV_VertexID) don't come from a buffer
+		if (paramDesc.SystemValueType != D3D_NAME_UNDEFINED)
+			continue;
+
+		// Check the semantic name for "_PER_INSTANCE"
+		std::string perInstanceStr = "_PER_INSTANCE";
+		std::string sem = paramDesc.SemanticName;
+		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
+		bool isPerInstance = 
+			lenDiff >= 0 &&
+			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
+
+		// Determine DXGI format
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+		if (paramDesc.Mask == 1)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 3)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 7)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32_FLOAT;
+		}
+		else if (paramDesc.Mask <= 15)
+		{
+			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) format = DXGI_FORMAT_R32G32B32A32_UINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) format = DXGI_FORMAT_R32G32B32A32_SINT;
+			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+
+		data.InputElements.push_back({ sem, paramDesc.SemanticIndex, (unsigned int)format, isPerInstance });
+	}
+}
+
+// --------------------------------------------------------
+// Builds the lookup tables and constant buffers from
+// reflection data (fresh or cached)
+// --------------------------------------------------------
+void ISimpleShader::BuildTables(const ShaderReflectionData& data)
+{
+	// Create resource arrays
+	constantBufferCount = (unsigned int)data.ConstantBuffers.size();
+	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
+
+	for (auto& r : data.ShaderResources)
+	{
+		// Create the SRV wrapper
+		SimpleSRV* srv = new SimpleSRV();
+		srv->BindIndex = r.BindIndex;								// Shader bind point
+		srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
+
+		textureTable.insert(std::pair<std::string, SimpleSRV*>(r.Name, srv));
+		shaderResourceViews.push_back(srv);
+	}
+
+	for (auto& s : data.Samplers)
+	{
+		// Create the sampler wrapper
+		SimpleSampler* samp = new SimpleSampler();
+		samp->BindIndex = s.BindIndex;						// Shader bind point
+		samp->Index = (unsigned int)samplerStates.size();	// Raw index
+
+		samplerTable.insert(std::pair<std::string, SimpleSampler*>(s.Name, samp));
+		samplerStates.push_back(samp);
+	}
+
+	for (unsigned int b = 0; b < constantBufferCount; b++)
+	{
+		const ReflectedConstantBuffer& bufferDesc = data.ConstantBuffers[b];
+
 		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
+		constantBuffers[b].Type = (D3D_CBUFFER_TYPE)bufferDesc.Type;
+		constantBuffers[b].BindIndex = bufferDesc.BindIndex;
 		constantBuffers[b].Name = bufferDesc.Name;
 		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
 
@@ -203,34 +331,30 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
 
-		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
-		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
+		// Extra copies for threads recording with this shader, allocated
+		// up front so no thread ever has to resize shared storage
+		constantBuffers[b].ThreadDataBuffers = new unsigned char[bufferDesc.Size * (MaxThreadSlots - 1)];
+		ZeroMemory(constantBuffers[b].ThreadDataBuffers, bufferDesc.Size * (MaxThreadSlots - 1));
+
+		// What each slot last uploaded, to skip uploads that change nothing
+		constantBuffers[b].UploadedData = new unsigned char[bufferDesc.Size * MaxThreadSlots];
+		constantBuffers[b].UploadStates = new SimpleUploadState[MaxThreadSlots];
+		for (unsigned int s = 0; s < MaxThreadSlots; s++)
+			constantBuffers[b].UploadStates[s] = { 0, 0, slotEpochs[s] - 1 };
 
-			// Create the variable struct
+		// Add each variable to the table and the constant buffer
+		for (auto& v : bufferDesc.Variables)
+		{
 			SimpleShaderVariable varStruct = {};
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
-			varStruct.Size = varDesc.Size;
-			
-			// Get a string version
-			std::string varName(varDesc.Name);
-
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			varStruct.ByteOffset = v.ByteOffset;
+			varStruct.Size = v.Size;
+
+			varTable.insert(std::pair<std::string, unsigned int>(v.Name, (unsigned int)variables.size()));
+			variables.push_back(varStruct);
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
-
-	// All set
-	return true;
 }
 
 // --------------------------------------------------------
@@ -243,15 +367,15 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
+	std::unordered_map<std::string, unsigned int>::iterator result =
 		varTable.find(name);
 
 	// Did we find the key?
 	if (result == varTable.end())
 		return 0;
 
-	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	// Grab the variable the key points to
+	SimpleShaderVariable* var = &variables[result->second];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -322,6 +446,143 @@ void ISimpleShader::LogWarning(std::string message) { Log(message, FOREGROUND_RE
 void ISimpleShader::LogWarningW(std::wstring message) { LogW(message, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY); }
 
 
+// --------------------------------------------------------
+// Makes every shader used on the calling thread record into
+// the given context, using its own copy of the local data.
+//
+// context - The (usually deferred) context to record into
+// slot    - Which copy of the local data to use, from 1 to
+//           MaxThreadSlots - 1.  No two threads may use the
+//           same slot at the same time.
+// --------------------------------------------------------
+void ISimpleShader::BindThreadContext(ID3D11DeviceContext* context, unsigned int slot)
+{
+	threadContext = context;
+	threadSlot = slot < MaxThreadSlots ? slot : 0;
+
+	// A new context starts a new command list, which plays back after
+	// whatever other lists wrote, so nothing this slot uploaded is known
+	slotEpochs[threadSlot]++;
+}
+
+// --------------------------------------------------------
+// Returns the calling thread to the shader's own context
+// and local data
+// --------------------------------------------------------
+void ISimpleShader::UnbindThreadContext()
+{
+	threadContext = 0;
+	threadSlot = 0;
+}
+
+// --------------------------------------------------------
+// Forgets what every slot last uploaded, so the next
+// upload of each buffer happens no matter what
+//
+// NOTE: Not thread safe - call it while nothing is recording
+// --------------------------------------------------------
+void ISimpleShader::InvalidateUploads()
+{
+	for (unsigned int i = 0; i < MaxThreadSlots; i++)
+		slotEpochs[i]++;
+}
+
+// --------------------------------------------------------
+// Totals the upload stats of every slot
+// --------------------------------------------------------
+SimpleShaderUploadStats ISimpleShader::GetUploadStats()
+{
+	SimpleShaderUploadStats total = {};
+	for (unsigned int i = 0; i < MaxThreadSlots; i++)
+	{
+		total.Uploads += slotUploadStats[i].Uploads;
+		total.Skipped += slotUploadStats[i].Skipped;
+		total.BytesUploaded += slotUploadStats[i].BytesUploaded;
+		total.BytesAvoided += slotUploadStats[i].BytesAvoided;
+	}
+	return total;
+}
+
+void ISimpleShader::ResetUploadStats()
+{
+	for (unsigned int i = 0; i < MaxThreadSlots; i++)
+		slotUploadStats[i] = {};
+}
+
+// --------------------------------------------------------
+// Gets the local data buffer for the calling thread's slot
+// --------------------------------------------------------
+unsigned char* ISimpleShader::GetLocalData(unsigned int bufferIndex)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[bufferIndex];
+	if (threadSlot == 0)
+		return cb->LocalDataBuffer;
+
+	return cb->ThreadDataBuffers + (threadSlot - 1) * cb->Size;
+}
+
+// --------------------------------------------------------
+// Grows the calling slot's dirty range for a buffer
+// --------------------------------------------------------
+void ISimpleShader::MarkDirty(unsigned int bufferIndex, unsigned int start, unsigned int end)
+{
+	SimpleUploadState& state = constantBuffers[bufferIndex].UploadStates[threadSlot];
+	if (state.DirtyStart == state.DirtyEnd)
+	{
+		state.DirtyStart = start;
+		state.DirtyEnd = end;
+		return;
+	}
+	if (start < state.DirtyStart) state.DirtyStart = start;
+	if (end > state.DirtyEnd) state.DirtyEnd = end;
+}
+
+// --------------------------------------------------------
+// Uploads one buffer's local data for the calling slot,
+// unless it matches what the slot last uploaded
+//
+// - Only the dirty range is compared, since nothing else
+//   can have changed since the last upload
+// - The last upload only counts while the slot's epoch
+//   hasn't moved on (see BindThreadContext and
+//   InvalidateUploads); otherwise the buffer may hold
+//   someone else's data and has to be uploaded
+// - Constant buffers can't be partially updated in D3D11.0,
+//   so a changed buffer is still uploaded whole
+// --------------------------------------------------------
+void ISimpleShader::UploadBuffer(unsigned int bufferIndex)
+{
+	SimpleConstantBuffer* cb = &constantBuffers[bufferIndex];
+	SimpleUploadState& state = cb->UploadStates[threadSlot];
+	SimpleShaderUploadStats& stats = slotUploadStats[threadSlot];
+	unsigned char* local = GetLocalData(bufferIndex);
+	unsigned char* uploaded = cb->UploadedData + threadSlot * cb->Size;
+
+	if (state.Epoch == slotEpochs[threadSlot])
+	{
+		// Nothing set, or only set to what's already there
+		if (state.DirtyStart == state.DirtyEnd ||
+			memcmp(local + state.DirtyStart, uploaded + state.DirtyStart, state.DirtyEnd - state.DirtyStart) == 0)
+		{
+			state.DirtyStart = state.DirtyEnd = 0;
+			stats.Skipped++;
+			stats.BytesAvoided += cb->Size;
+			return;
+		}
+		memcpy(uploaded + state.DirtyStart, local + state.DirtyStart, state.DirtyEnd - state.DirtyStart);
+	}
+	else
+	{
+		memcpy(uploaded, local, cb->Size);
+		state.Epoch = slotEpochs[threadSlot];
+	}
+
+	GetContext()->UpdateSubresource(cb->ConstantBuffer.Get(), 0, 0, local, 0, 0);
+	state.DirtyStart = state.DirtyEnd = 0;
+	stats.Uploads++;
+	stats.BytesUploaded += cb->Size;
+}
+
 // --------------------------------------------------------
 // Sets the shader and associated constant buffers in Direct3D
 // --------------------------------------------------------
@@ -345,14 +606,9 @@ void ISimpleShader::CopyAllBufferData()
 	// Ensure the shader is valid
 	if (!shaderValid) return;
 
-	// Loop through the constant buffers and copy all data
+	// Loop through the constant buffers and copy any that changed
 	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer.Get(), 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
-	}
+		UploadBuffer(i);
 }
 
 // --------------------------------------------------------
@@ -375,14 +631,8 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if(index >= this->constantBufferCount)
 		return;
 
-	// Check for the buffer
-	SimpleConstantBuffer* cb = &this->constantBuffers[index];
-	if (!cb) return;
-
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer(index);
 }
 
 // --------------------------------------------------------
@@ -401,10 +651,8 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	SimpleConstantBuffer* cb = this->FindConstantBuffer(bufferName);
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer.Get(), 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Copy the data (if it changed) and get out
+	UploadBuffer((unsigned int)(cb - constantBuffers));
 }
 
 
@@ -420,8 +668,8 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
 {
 	// Look for the variable and verify
-	SimpleShaderVariable* var = FindVariable(name, -1);
-	if (var == 0)
+	SimpleShaderHandle handle = GetVariableHandle(name);
+	if (handle == SimpleShaderInvalidHandle)
 	{
 		if (ReportWarnings)
 		{
@@ -432,27 +680,8 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 		return false;
 	}
 
-	// Ensure we're not trying to copy more data than the variable can hold
-	// Note: We can copy less data, in the case of a subset of an array
-	if (size > var->Size)
-	{
-		if (ReportWarnings)
-		{
-			LogWarning("SimpleShader::SetData() - Shader variable '");
-			Log(name);
-			LogWarning("' is smaller than the size of the data being set. Ensure the variable is large enough for the specified data.\n");
-		}
-		return false;
-	}
-
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
-
-	// Success
-	return true;
+	// The handle overload checks the size, copies and marks the range dirty
+	return SetData(handle, data, size);
 }
 
 // --------------------------------------------------------
@@ -535,6 +764,84 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Looks up a variable's handle, for setting it repeatedly
+// without a string lookup each time
+//
+// Returns SimpleShaderInvalidHandle if the variable doesn't exist
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetVariableHandle(const std::string& name)
+{
+	std::unordered_map<std::string, unsigned int>::iterator result =
+		varTable.find(name);
+	if (result == varTable.end())
+		return SimpleShaderInvalidHandle;
+	return (SimpleShaderHandle)result->second;
+}
+
+// --------------------------------------------------------
+// Looks up an SRV's handle (its raw index)
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetShaderResourceViewHandle(const std::string& name)
+{
+	std::unordered_map<std::string, SimpleSRV*>::iterator result =
+		textureTable.find(name);
+	if (result == textureTable.end())
+		return SimpleShaderInvalidHandle;
+	return (SimpleShaderHandle)result->second->Index;
+}
+
+// --------------------------------------------------------
+// Looks up a sampler's handle (its raw index)
+// --------------------------------------------------------
+SimpleShaderHandle ISimpleShader::GetSamplerHandle(const std::string& name)
+{
+	std::unordered_map<std::string, SimpleSampler*>::iterator result =
+		samplerTable.find(name);
+	if (result == samplerTable.end())
+		return SimpleShaderInvalidHandle;
+	return (SimpleShaderHandle)result->second->Index;
+}
+
+// --------------------------------------------------------
+// Sets a variable by handle with arbitrary data of the specified size
+//
+// handle - From GetVariableHandle()
+// data - The data to set in the buffer
+// size - The size of the data (this must be less than or equal to the variable's size)
+//
+// Returns true if data is copied, false if the handle is invalid
+// --------------------------------------------------------
+bool ISimpleShader::SetData(SimpleShaderHandle handle, const void* data, unsigned int size)
+{
+	// Invalid handles are expected (a variable the shader doesn't use),
+	// so they fail quietly like a missing name does without warnings
+	if (handle < 0 || (unsigned int)handle >= variables.size())
+		return false;
+
+	const SimpleShaderVariable& var = variables[handle];
+	if (size > var.Size)
+	{
+		if (ReportWarnings)
+			LogWarning("SimpleShader::SetData() - Shader variable is smaller than the size of the data being set.\n");
+		return false;
+	}
+
+	memcpy(
+		GetLocalData(var.ConstantBufferIndex) + var.ByteOffset,
+		data,
+		size);
+	MarkDirty(var.ConstantBufferIndex, var.ByteOffset, var.ByteOffset + size);
+	return true;
+}
+
+bool ISimpleShader::SetInt(SimpleShaderHandle handle, int data) { return SetData(handle, &data, sizeof(int)); }
+bool ISimpleShader::SetFloat(SimpleShaderHandle handle, float data) { return SetData(handle, &data, sizeof(float)); }
+bool ISimpleShader::SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2& data) { return SetData(handle, &data, sizeof(float) * 2); }
+bool ISimpleShader::SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3& data) { return SetData(handle, &data, sizeof(float) * 3); }
+bool ISimpleShader::SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4& data) { return SetData(handle, &data, sizeof(float) * 4); }
+bool ISimpleShader::SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data) { return SetData(handle, &data, sizeof(float) * 16); }
+
 // --------------------------------------------------------
 // Determines if the shader contains the specified
 // variable within one of its constant buffers
@@ -766,49 +1073,23 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 	if (inputLayout)
 		return true;
 
-	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
-	// matches what the vertex shader expects.  Code adapted from:
-	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
-
-	// Reflect shader info
-	Microsoft::WRL::ComPtr<ID3D11ShaderReflection> refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)refl.GetAddressOf());
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
+	// Vertex shader was created successfully, so we now make an
+	// input layout from the inputs found by reflection (or the cache)
 	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	for (auto& input : reflection.InputElements)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
-
-		// Check the semantic name for "_PER_INSTANCE"
-		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
-		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
-		bool isPerInstance = 
-			lenDiff >= 0 &&
-			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
-
 		// Fill out input element desc
 		D3D11_INPUT_ELEMENT_DESC elementDesc = {};
-		elementDesc.SemanticName = paramDesc.SemanticName;
-		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
+		elementDesc.SemanticName = input.SemanticName.c_str();
+		elementDesc.SemanticIndex = input.SemanticIndex;
+		elementDesc.Format = (DXGI_FORMAT)input.Format;
 		elementDesc.InputSlot = 0;
 		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
 		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 		elementDesc.InstanceDataStepRate = 0;
 
 		// Replace anything affected by "per instance" data
-		if (isPerInstance)
+		if (input.PerInstance)
 		{
 			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
 			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
@@ -817,36 +1098,14 @@ bool SimpleVertexShader::CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlo
 			perInstanceCompatible = true;
 		}
 
-		// Determine DXGI format
-		if (paramDesc.Mask == 1)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 3)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 7)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-		}
-		else if (paramDesc.Mask <= 15)
-		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-		}
-
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
 
+	// Nothing to read from vertex buffers, so no input layout needed
+	if (inputLayoutDesc.empty())
+		return true;
+
 	// Try to create Input Layout
 	HRESULT hr = device->CreateInputLayout(
 		&inputLayoutDesc[0], 
@@ -869,8 +1128,8 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout.Get());
-	deviceContext->VSSetShader(shader.Get(), 0, 0);
+	GetContext()->IASetInputLayout(inputLayout.Get());
+	GetContext()->VSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -880,7 +1139,7 @@ void SimpleVertexShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
+		GetContext()->VSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -910,10 +1169,21 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a shader resource view in the vertex shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleVertexShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
+	GetContext()->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 	return true;
 }
 
@@ -940,10 +1210,21 @@ bool SimpleVertexShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a sampler state in the vertex shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleVertexShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	GetContext()->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 	return true;
 }
 
@@ -1012,7 +1293,7 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader.Get(), 0, 0);
+	GetContext()->PSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1022,7 +1303,7 @@ void SimplePixelShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
+		GetContext()->PSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1052,10 +1333,21 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, Microsoft::WRL::
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a shader resource view in the pixel shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimplePixelShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
+	GetContext()->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 	return true;
 }
 
@@ -1082,13 +1374,49 @@ bool SimplePixelShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a sampler state in the pixel shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimplePixelShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	GetContext()->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 	return true;
 }
 
+// --------------------------------------------------------
+// Binds a contiguous range of SRV registers in one call
+// --------------------------------------------------------
+void SimplePixelShader::SetShaderResourceViews(unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs)
+{
+	GetContext()->PSSetShaderResources(startSlot, count, srvs);
+}
+
+// --------------------------------------------------------
+// Binds a contiguous range of sampler registers in one call
+// --------------------------------------------------------
+void SimplePixelShader::SetSamplerStates(unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplerStates)
+{
+	GetContext()->PSSetSamplers(startSlot, count, samplerStates);
+}
+
+// --------------------------------------------------------
+// Binds a constant buffer the shader doesn't own in place of
+// its own (call after SetShader(), which binds the shader's)
+// --------------------------------------------------------
+void SimplePixelShader::SetConstantBuffer(unsigned int slot, ID3D11Buffer* buffer)
+{
+	GetContext()->PSSetConstantBuffers(slot, 1, &buffer);
+}
+
 
 
 
@@ -1156,7 +1484,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->DSSetShader(shader.Get(), 0, 0);
+	GetContext()->DSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1166,7 +1494,7 @@ void SimpleDomainShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->DSSetConstantBuffers(
+		GetContext()->DSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1196,10 +1524,21 @@ bool SimpleDomainShader::SetShaderResourceView(std::string name, Microsoft::WRL:
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a shader resource view in the domain shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleDomainShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
+	GetContext()->DSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 	return true;
 }
 
@@ -1226,10 +1565,21 @@ bool SimpleDomainShader::SetSamplerState(std::string name, Microsoft::WRL::ComPt
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a sampler state in the domain shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleDomainShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	GetContext()->DSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 	return true;
 }
 
@@ -1299,7 +1649,7 @@ void SimpleHullShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->HSSetShader(shader.Get(), 0, 0);
+	GetContext()->HSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1309,7 +1659,7 @@ void SimpleHullShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->HSSetConstantBuffers(
+		GetContext()->HSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1339,10 +1689,21 @@ bool SimpleHullShader::SetShaderResourceView(std::string name, Microsoft::WRL::C
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a shader resource view in the hull shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleHullShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
+	GetContext()->HSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 	return true;
 }
 
@@ -1369,10 +1730,21 @@ bool SimpleHullShader::SetSamplerState(std::string name, Microsoft::WRL::ComPtr<
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a sampler state in the hull shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleHullShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	GetContext()->HSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 	return true;
 }
 
@@ -1573,7 +1945,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->GSSetShader(shader.Get(), 0, 0);
+	GetContext()->GSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1583,7 +1955,7 @@ void SimpleGeometryShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->GSSetConstantBuffers(
+		GetContext()->GSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1613,10 +1985,21 @@ bool SimpleGeometryShader::SetShaderResourceView(std::string name, Microsoft::WR
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a shader resource view in the geometry shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
+	GetContext()->GSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 	return true;
 }
 
@@ -1643,10 +2026,21 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, Microsoft::WRL::Com
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a sampler state in the geometry shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	GetContext()->GSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 	return true;
 }
 
@@ -1783,7 +2177,7 @@ void SimpleComputeShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader
-	deviceContext->CSSetShader(shader.Get(), 0, 0);
+	GetContext()->CSSetShader(shader.Get(), 0, 0);
 
 	// Set the constant buffers?
 	for (unsigned int i = 0; i < constantBufferCount; i++)
@@ -1793,7 +2187,7 @@ void SimpleComputeShader::SetShaderAndCBs()
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->CSSetConstantBuffers(
+		GetContext()->CSSetConstantBuffers(
 			constantBuffers[i].BindIndex,
 			1,
 			constantBuffers[i].ConstantBuffer.GetAddressOf());
@@ -1822,7 +2216,7 @@ void SimpleComputeShader::SetShaderAndCBs()
 // --------------------------------------------------------
 void SimpleComputeShader::DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
 {
-	deviceContext->Dispatch(groupsX, groupsY, groupsZ);
+	GetContext()->Dispatch(groupsX, groupsY, groupsZ);
 }
 
 // --------------------------------------------------------
@@ -1847,7 +2241,7 @@ void SimpleComputeShader::DispatchByGroups(unsigned int groupsX, unsigned int gr
 // --------------------------------------------------------
 void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ)
 {
-	deviceContext->Dispatch(
+	GetContext()->Dispatch(
 		max((unsigned int)ceil((float)threadsX / this->threadsX), 1),
 		max((unsigned int)ceil((float)threadsY / this->threadsY), 1),
 		max((unsigned int)ceil((float)threadsZ / this->threadsZ), 1));
@@ -1884,10 +2278,21 @@ bool SimpleComputeShader::SetShaderResourceView(std::string name, Microsoft::WRL
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, srv.GetAddressOf());
+	return SetShaderResourceView((SimpleShaderHandle)srvInfo->Index, srv.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a shader resource view in the compute shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleComputeShader::SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv)
+{
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo((unsigned int)handle);
+	if (srvInfo == 0)
+		return false;
+
+	GetContext()->CSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 	return true;
 }
 
@@ -1914,10 +2319,21 @@ bool SimpleComputeShader::SetSamplerState(std::string name, Microsoft::WRL::ComP
 		return false;
 	}
 
-	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, samplerState.GetAddressOf());
+	return SetSamplerState((SimpleShaderHandle)sampInfo->Index, samplerState.Get());
+}
 
-	// Success
+// --------------------------------------------------------
+// Sets a sampler state in the compute shader stage by handle
+//
+// Returns false if the handle is invalid
+// --------------------------------------------------------
+bool SimpleComputeShader::SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState)
+{
+	const SimpleSampler* sampInfo = GetSamplerInfo((unsigned int)handle);
+	if (sampInfo == 0)
+		return false;
+
+	GetContext()->CSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 	return true;
 }
 
@@ -1946,7 +2362,7 @@ bool SimpleComputeShader::SetUnorderedAccessView(std::string name, Microsoft::WR
 	}
 
 	// Set the shader resource view
-	deviceContext->CSSetUnorderedAccessViews(bindIndex, 1, uav.GetAddressOf(), &appendConsumeOffset);
+	GetContext()->CSSetUnorderedAccessViews(bindIndex, 1, uav.GetAddressOf(), &appendConsumeOffset);
 
 	// Success
 	return true;
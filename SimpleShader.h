@@ -11,6 +11,9 @@
 #include <vector>
 #include <string>
 
+#include "ShaderReflectionCache.h"
+#include "ShaderVariants.h"
+
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -23,6 +26,28 @@ struct SimpleShaderVariable
 	unsigned int ConstantBufferIndex;
 };
 
+// --------------------------------------------------------
+// Change tracking for one thread slot's copy of a
+// constant buffer's local data
+// --------------------------------------------------------
+struct SimpleUploadState
+{
+	unsigned int DirtyStart;	// Bytes set since the last upload,
+	unsigned int DirtyEnd;		// empty when start == end
+	unsigned int Epoch;			// Slot epoch of the last upload (see CopyBufferData)
+};
+
+// --------------------------------------------------------
+// Constant buffer uploads, made and skipped
+// --------------------------------------------------------
+struct SimpleShaderUploadStats
+{
+	unsigned int Uploads;
+	unsigned int Skipped;
+	unsigned long long BytesUploaded;
+	unsigned long long BytesAvoided;
+};
+
 // --------------------------------------------------------
 // Contains information about a specific
 // constant buffer in a shader, as well as
@@ -36,6 +61,9 @@ struct SimpleConstantBuffer
 	unsigned int BindIndex = 0;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
+	unsigned char* ThreadDataBuffers = 0; // One Size-byte copy per extra thread slot
+	unsigned char* UploadedData = 0; // What each thread slot last uploaded, Size bytes per slot
+	SimpleUploadState* UploadStates = 0; // One per thread slot
 	std::vector<SimpleShaderVariable> Variables;
 };
 
@@ -57,6 +85,16 @@ struct SimpleSampler
 	unsigned int BindIndex; // The register of the Sampler
 };
 
+// --------------------------------------------------------
+// A variable, SRV or sampler looked up once by name
+//
+// - Handles are small indices into the shader's own arrays,
+//   so setting by handle never hashes a string
+// - They stay valid until the shader is reloaded
+// --------------------------------------------------------
+typedef int SimpleShaderHandle;
+static const SimpleShaderHandle SimpleShaderInvalidHandle = -1;
+
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
 // --------------------------------------------------------
@@ -89,9 +127,26 @@ public:
 	bool SetMatrix4x4(std::string name, const float data[16]);
 	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
 
+	// Looking up handles (SimpleShaderInvalidHandle if not found)
+	SimpleShaderHandle GetVariableHandle(const std::string& name);
+	SimpleShaderHandle GetShaderResourceViewHandle(const std::string& name);
+	SimpleShaderHandle GetSamplerHandle(const std::string& name);
+
+	// Sets shader data by handle
+	bool SetData(SimpleShaderHandle handle, const void* data, unsigned int size);
+
+	bool SetInt(SimpleShaderHandle handle, int data);
+	bool SetFloat(SimpleShaderHandle handle, float data);
+	bool SetFloat2(SimpleShaderHandle handle, const DirectX::XMFLOAT2& data);
+	bool SetFloat3(SimpleShaderHandle handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(SimpleShaderHandle handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(SimpleShaderHandle handle, const DirectX::XMFLOAT4X4& data);
+
 	// Setting shader resources
 	virtual bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv) = 0;
 	virtual bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState) = 0;
+	virtual bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv) = 0;
+	virtual bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState) = 0;
 
 	// Simple resource checking
 	bool HasVariable(std::string name);
@@ -117,11 +172,36 @@ public:
 	
 	// Misc getters
 	Microsoft::WRL::ComPtr<ID3DBlob> GetShaderBlob() { return shaderBlob; }
+	Microsoft::WRL::ComPtr<ID3D11Device> GetDevice() { return device; }
 
 	// Error reporting
 	static bool ReportErrors;
 	static bool ReportWarnings;
 
+	// Shaders whose reflection came from a .refl file vs. had to be reflected
+	static unsigned int ReflectionCacheHits;
+	static unsigned int ReflectionCacheMisses;
+
+	// Multithreaded recording
+	// - Binding a (deferred) context to a thread makes every shader
+	//   used on that thread record into it instead of the context
+	//   given at construction
+	// - Each slot has its own copy of the local constant data, so
+	//   threads using different slots can Set*() the same shader
+	//   at the same time.  Slot 0 is the default, unbound state.
+	static const unsigned int MaxThreadSlots = 9;
+	static void BindThreadContext(ID3D11DeviceContext* context, unsigned int slot);
+	static void UnbindThreadContext();
+
+	// Uploads of unchanged constant buffers are skipped, which is only
+	// safe while nothing else writes them.  Call this after playing
+	// back command lists, since those may have left other data behind.
+	static void InvalidateUploads();
+
+	// Constant buffer uploads since the last reset, over all shaders and slots
+	static SimpleShaderUploadStats GetUploadStats();
+	static void ResetUploadStats();
+
 protected:
 	
 	bool shaderValid;
@@ -137,13 +217,34 @@ protected:
 	std::vector<SimpleSRV*>		shaderResourceViews;
 	std::vector<SimpleSampler*>	samplerStates;
 	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
+	std::vector<SimpleShaderVariable> variables;		// Indexed by variable handle
+	std::unordered_map<std::string, unsigned int> varTable;	// Name to variable handle
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
+	// Per-thread recording state (see BindThreadContext)
+	static thread_local ID3D11DeviceContext* threadContext;
+	static thread_local unsigned int threadSlot;
+	static unsigned int slotEpochs[MaxThreadSlots];
+	static SimpleShaderUploadStats slotUploadStats[MaxThreadSlots];
+
+	// The context and local data buffer for the calling thread
+	ID3D11DeviceContext* GetContext() { return threadContext ? threadContext : deviceContext.Get(); }
+	unsigned char* GetLocalData(unsigned int bufferIndex);
+
+	// Change tracking for the calling thread's local data
+	void MarkDirty(unsigned int bufferIndex, unsigned int start, unsigned int end);
+	void UploadBuffer(unsigned int bufferIndex);
+
 	// Initialization method
 	bool LoadShaderFile(LPCWSTR shaderFile);
 
+	// What the shader exposes, reflected or loaded from the cache
+	// (kept, since vertex shaders build their input layout from it)
+	ShaderReflectionData reflection;
+	static void Reflect(Microsoft::WRL::ComPtr<ID3DBlob> blob, ShaderReflectionData& data);
+	void BuildTables(const ShaderReflectionData& data);
+
 	// Pure virtual functions for dealing with shader types
 	virtual bool CreateShader(Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob) = 0;
 	virtual void SetShaderAndCBs() = 0;
@@ -180,6 +281,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	bool perInstanceCompatible;
@@ -203,6 +306,14 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
+
+	// Raw register ranges, for bindings prepared ahead of time
+	// (registers, not handles - nothing is looked up or checked)
+	void SetShaderResourceViews(unsigned int startSlot, unsigned int count, ID3D11ShaderResourceView* const* srvs);
+	void SetSamplerStates(unsigned int startSlot, unsigned int count, ID3D11SamplerState* const* samplerStates);
+	void SetConstantBuffer(unsigned int slot, ID3D11Buffer* buffer);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
@@ -223,6 +334,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11DomainShader> shader;
@@ -243,6 +356,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D11HullShader> shader;
@@ -263,6 +378,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(Microsoft::WRL::ComPtr<ID3D11Buffer> buffer, int vertexCount);
 
@@ -304,6 +421,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
 	bool SetSamplerState(std::string name, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState);
+	bool SetShaderResourceView(SimpleShaderHandle handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(SimpleShaderHandle handle, ID3D11SamplerState* samplerState);
 	bool SetUnorderedAccessView(std::string name, Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
@@ -1,8 +1,15 @@
 #include "Sky.h"
 #include "Graphics.h"
-#include "WICTextureLoader.h"
+#include "ImageDecoder.h"
 #include "DDSTextureLoader.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
 void Sky::InitRenderStates()
 {
 	// reverse cull mode
@@ -28,6 +35,7 @@ Sky::Sky(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubeMap, std::shared_p
 	this->skyPS = skyPS;
 	this->samplerOptions = samplerOptions;
 
+	hdr = false;
 	InitRenderStates();
 }
 
@@ -38,6 +46,7 @@ Sky::Sky(const wchar_t* cubemapDDSFile, std::shared_ptr<Mesh> mesh, std::shared_
 	this->skyPS = skyPS;
 	this->samplerOptions = samplerOptions;
 
+	hdr = false;
 	InitRenderStates();
 
 	// load the texture
@@ -52,12 +61,39 @@ Sky::Sky(const wchar_t* right, const wchar_t* left, const wchar_t* up, const wch
 	this->skyPS = skyPS;
 	this->samplerOptions = samplerOptions;
 
+	hdr = false;
 	InitRenderStates();
 
 	// create texture out of the 6 images
 	skySRV = CreateCubemap(right, left, up, down, front, back);
 }
 
+Sky::Sky(const DecodedImage* faces, std::shared_ptr<Mesh> mesh, std::shared_ptr<SimpleVertexShader> skyVS, std::shared_ptr<SimplePixelShader> skyPS, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions)
+{
+	skyMesh = mesh;
+	this->skyVS = skyVS;
+	this->skyPS = skyPS;
+	this->samplerOptions = samplerOptions;
+
+	hdr = false;
+	InitRenderStates();
+
+	skySRV = CreateCubemap(faces);
+}
+
+Sky::Sky(const EnvironmentCube& cube, std::shared_ptr<Mesh> mesh, std::shared_ptr<SimpleVertexShader> skyVS, std::shared_ptr<SimplePixelShader> skyPS, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions)
+{
+	skyMesh = mesh;
+	this->skyVS = skyVS;
+	this->skyPS = skyPS;
+	this->samplerOptions = samplerOptions;
+
+	hdr = true;
+	InitRenderStates();
+
+	skySRV = CreateCubemap(cube);
+}
+
 Sky::~Sky()
 {
 }
@@ -78,6 +114,8 @@ void Sky::Draw(std::shared_ptr<Camera> camera)
 	skyVS->CopyAllBufferData();
 
 	// give the pixel shader data
+	skyPS->SetInt("hdr", hdr);
+	skyPS->CopyAllBufferData();
 	skyPS->SetShaderResourceView("SkyTexture", skySRV);
 	skyPS->SetSamplerState("BasicSampler", samplerOptions);
 
@@ -95,23 +133,9 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::GetSkyTexture()
 }
 
 // --------------------------------------------------------
-// Author: Chris Cascioli
-// Purpose: Creates a cube map on the GPU from 6 individual textures
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-//
-// - Note: This code assumes you’re putting the function in Sky.cpp, 
-//   you’ve included WICTextureLoader.h and you have an ID3D11Device 
-//   ComPtr called “device”.  Make any adjustments necessary for
-//   your own implementation.
-// --------------------------------------------------------
-// --------------------------------------------------------
-// Loads six individual textures (the six faces of a cube map), then
-// creates a blank cube map and copies each of the six textures to
-// another face.  Afterwards, creates a shader resource view for
-// the cube map and cleans up all of the temporary resources.
+// Loads six individual textures (the six faces of a cube map)
+// with ImageDecoder, then makes the cube map out of their
+// pixels - no WIC, and no temporary textures to copy from
 // --------------------------------------------------------
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	const wchar_t* right,
@@ -121,78 +145,99 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(
 	const wchar_t* front,
 	const wchar_t* back)
 {
-	// Load the 6 textures into an array.
-	// - We need references to the TEXTURES, not SHADER RESOURCE VIEWS!
-	// - Explicitly NOT generating mipmaps, as we don't need them for the sky!
-	// - Order matters here!  +X, -X, +Y, -Y, +Z, -Z
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[6] = {};
-
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), right, (ID3D11Resource**)textures[0].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), left, (ID3D11Resource**)textures[1].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), up, (ID3D11Resource**)textures[2].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), down, (ID3D11Resource**)textures[3].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), front, (ID3D11Resource**)textures[4].GetAddressOf(), 0);
-	DirectX::CreateWICTextureFromFile(Graphics::Device.Get(), back, (ID3D11Resource**)textures[5].GetAddressOf(), 0);
-
-
-	// We'll assume all of the textures are the same color format and resolution,
-	// so get the description of the first texture
-	D3D11_TEXTURE2D_DESC faceDesc = {};
-	textures[0]->GetDesc(&faceDesc);
-
-	// Describe the resource for the cube map, which is simply 
-	// a "texture 2d array" with the TEXTURECUBE flag set.  
-	// This is a special GPU resource format, NOT just a 
-	// C++ array of textures!!!
+	// Order matters here!  +X, -X, +Y, -Y, +Z, -Z
+	const wchar_t* paths[6] = { right, left, up, down, front, back };
+	DecodedImage faces[6];
+	for (int i = 0; i < 6; i++) {
+		std::ifstream file(std::filesystem::path(paths[i]), std::ios::binary);
+		std::vector<unsigned char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		std::string error;
+		if (!ImageDecoder::Decode(contents.data(), contents.size(), faces[i], error)) {
+			printf("Sky face %ls: %s\n", paths[i], error.c_str());
+			return 0;
+		}
+	}
+
+	// every face has to be the same square size
+	for (int i = 1; i < 6; i++)
+		if (faces[i].Width != faces[0].Width || faces[i].Height != faces[0].Height) {
+			printf("Sky faces aren't all the same size\n");
+			return 0;
+		}
+	return CreateCubemap(faces);
+}
+
+// --------------------------------------------------------
+// Creates the cube map straight from decoded pixels, all six
+// faces uploaded as the texture's initial data (no temporary
+// textures or copies)
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(const DecodedImage* faces)
+{
 	D3D11_TEXTURE2D_DESC cubeDesc = {};
-	cubeDesc.ArraySize = 6;            // Cube map!
-	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE; // We'll be using as a texture in a shader
-	cubeDesc.CPUAccessFlags = 0;       // No read back
-	cubeDesc.Format = faceDesc.Format; // Match the loaded texture's color format
-	cubeDesc.Width = faceDesc.Width;   // Match the size
-	cubeDesc.Height = faceDesc.Height; // Match the size
-	cubeDesc.MipLevels = 1;            // Only need 1
-	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE; // This should be treated as a CUBE, not 6 separate textures
-	cubeDesc.Usage = D3D11_USAGE_DEFAULT; // Standard usage
+	cubeDesc.ArraySize = 6;
+	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	cubeDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	cubeDesc.Width = faces[0].Width;
+	cubeDesc.Height = faces[0].Height;
+	cubeDesc.MipLevels = 1;
+	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+	cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
 	cubeDesc.SampleDesc.Count = 1;
-	cubeDesc.SampleDesc.Quality = 0;
 
-	// Create the final texture resource to hold the cube map
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
-	Graphics::Device->CreateTexture2D(&cubeDesc, 0, cubeMapTexture.GetAddressOf());
-
-	// Loop through the individual face textures and copy them,
-	// one at a time, to the cube map texure
-	for (int i = 0; i < 6; i++)
-	{
-		// Calculate the subresource position to copy into
-		unsigned int subresource = D3D11CalcSubresource(
-			0,  // Which mip (zero, since there's only one)
-			i,  // Which array element?
-			1); // How many mip levels are in the texture?
-
-		// Copy from one resource (texture) to another
-		Graphics::Context->CopySubresourceRegion(
-			cubeMapTexture.Get(),  // Destination resource
-			subresource,           // Dest subresource index (one of the array elements)
-			0, 0, 0,               // XYZ location of copy
-			textures[i].Get(),     // Source resource
-			0,                     // Source subresource index (we're assuming there's only one)
-			0);                    // Source subresource "box" of data to copy (zero means the whole thing)
+	D3D11_SUBRESOURCE_DATA data[6] = {};
+	for (int i = 0; i < 6; i++) {
+		data[i].pSysMem = faces[i].Pixels.data();
+		data[i].SysMemPitch = faces[i].Width * 4;
 	}
 
-	// At this point, all of the faces have been copied into the 
-	// cube map texture, so we can describe a shader resource view for it
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubeSRV;
+	if (FAILED(Graphics::Device->CreateTexture2D(&cubeDesc, data, cubeMapTexture.GetAddressOf())))
+		return cubeSRV;
+
 	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = cubeDesc.Format;         // Same format as texture
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE; // Treat this as a cube!
-	srvDesc.TextureCube.MipLevels = 1;        // Only need access to 1 mip
-	srvDesc.TextureCube.MostDetailedMip = 0;  // Index of the first mip we want to see
+	srvDesc.Format = cubeDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = 1;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+	Graphics::Device->CreateShaderResourceView(cubeMapTexture.Get(), &srvDesc, cubeSRV.GetAddressOf());
+	return cubeSRV;
+}
 
-	// Make the SRV
+// --------------------------------------------------------
+// Creates the cube map from an HDR sky, every face's mips
+// uploaded as the texture's initial data
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Sky::CreateCubemap(const EnvironmentCube& cube)
+{
+	D3D11_TEXTURE2D_DESC cubeDesc = {};
+	cubeDesc.ArraySize = 6;
+	cubeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	cubeDesc.Format = (DXGI_FORMAT)cube.Format;
+	cubeDesc.Width = cube.FaceSize;
+	cubeDesc.Height = cube.FaceSize;
+	cubeDesc.MipLevels = cube.MipLevels;
+	cubeDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+	cubeDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	cubeDesc.SampleDesc.Count = 1;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> data(cube.Subresources.size());
+	for (unsigned int i = 0; i < data.size(); i++) {
+		data[i].pSysMem = cube.Subresources[i].data();
+		data[i].SysMemPitch = EnvironmentMap::GetRowPitch(cube.Format, std::max(1u, cube.FaceSize >> (i % cube.MipLevels)));
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cubeMapTexture;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubeSRV;
-	Graphics::Device->CreateShaderResourceView(cubeMapTexture.Get(), &srvDesc, cubeSRV.GetAddressOf());
+	if (FAILED(Graphics::Device->CreateTexture2D(&cubeDesc, data.data(), cubeMapTexture.GetAddressOf())))
+		return cubeSRV;
 
-	// Send back the SRV, which is what we need for our shaders
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = cubeDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = cube.MipLevels;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+	Graphics::Device->CreateShaderResourceView(cubeMapTexture.Get(), &srvDesc, cubeSRV.GetAddressOf());
 	return cubeSRV;
 }
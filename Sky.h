@@ -3,6 +3,8 @@
 #include "Mesh.h"
 #include "SimpleShader.h"
 #include "Camera.h"
+#include "PngDecoder.h"
+#include "EnvironmentMap.h"
 
 #include <memory>
 #include <wrl/client.h>
@@ -26,6 +28,8 @@ private:
 	// sampler options
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions;
 
+	bool hdr;		// the cube is linear light (from an .hdr), so the shader gamma corrects it
+
 	void InitRenderStates();
 
 	// create cubemap from 6 individual textures
@@ -38,6 +42,12 @@ private:
 		const wchar_t* back
 	);
 
+	// create cubemap from 6 already decoded faces (same order)
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(const DecodedImage* faces);
+
+	// create cubemap from an HDR sky's faces and mips
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(const EnvironmentCube& cube);
+
 
 
 public:
@@ -74,6 +84,26 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions
 	);
 
+	// constructor that makes a cube map out of 6 decoded faces
+	// (+X, -X, +Y, -Y, +Z, -Z, all the same size)
+	Sky(
+		const DecodedImage* faces,
+		std::shared_ptr<Mesh> mesh,
+		std::shared_ptr<SimpleVertexShader> skyVS,
+		std::shared_ptr<SimplePixelShader> skyPS,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions
+	);
+
+	// constructor for an HDR sky, converted from an .hdr by EnvironmentMap
+	// (RGBA16F or BC6H, with mips)
+	Sky(
+		const EnvironmentCube& cube,
+		std::shared_ptr<Mesh> mesh,
+		std::shared_ptr<SimpleVertexShader> skyVS,
+		std::shared_ptr<SimplePixelShader> skyPS,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerOptions
+	);
+
 	~Sky();
 
 	void Draw(std::shared_ptr<Camera> camera);
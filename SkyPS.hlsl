@@ -4,6 +4,11 @@ struct VertexToPixel
     float3 sampleDir : DIRECTION;
 };
 
+cbuffer ExternalData : register(b0)
+{
+    int hdr;    // linear light (an .hdr sky) rather than gamma encoded faces
+}
+
 // Texture resources
 TextureCube SkyTexture		: register(t0);
 SamplerState BasicSampler	: register(s0);
@@ -11,5 +16,10 @@ SamplerState BasicSampler	: register(s0);
 float4 main(VertexToPixel input) : SV_TARGET
 {
     // instead of a uv coord, a cube map takes a float3 direction
-    return SkyTexture.Sample(BasicSampler, input.sampleDir);
+    float4 color = SkyTexture.Sample(BasicSampler, input.sampleDir);
+
+    // the same gamma the main pixel shader puts on its lighting
+    if (hdr)
+        color.rgb = pow(saturate(color.rgb), 1.0f / 2.2f);
+    return color;
 }
\ No newline at end of file
@@ -0,0 +1,815 @@
+#include "SoftwareRasterizer.h"
+
+#include <emmintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+// --------------------------------------------------------
+// Shader constants and layouts (see include.hlsli)
+// --------------------------------------------------------
+static const float F0_NON_METAL = 0.04f;
+static const float MIN_ROUGHNESS = 0.0000001f;
+static const float PI = 3.14159265359f;
+
+static const int LightDirectional = 0;
+static const int LightPoint = 1;
+static const int LightSpot = 2;
+
+// floats per Vertex: position, normal, tangent, uv
+static const unsigned int VertexFloats = 11;
+
+// what the vertex shader hands the pixel shader (besides SV_POSITION)
+enum
+{
+	AttrWorld = 0,
+	AttrNormal = 3,
+	AttrTangent = 6,
+	AttrUV = 9,
+	AttrShadow = 11,
+	AttrCount = 15
+};
+
+struct ClipVertex
+{
+	float Clip[4];
+	float Attr[AttrCount];
+};
+
+// Screen space triangle, ready to rasterize
+// - Edge i is the one opposite vertex i, so its edge
+//   function (over the area) is vertex i's barycentric
+// - Attributes are premultiplied by 1/w for perspective
+//   correct interpolation
+struct SoftwareRasterizer::Triangle
+{
+	float X[3], Y[3], Z[3], InvW[3];
+	float Attr[3][AttrCount];
+	float A[3], B[3], C[3];
+	bool TopLeft[3];
+	float InvArea;
+	float DepthBias;
+	bool ClampDepth;
+	const SoftwareMaterial* Material;
+	int MinX, MinY, MaxX, MaxY;		// pixel bounds, max exclusive
+};
+
+
+// --------------------------------------------------------
+// Small vector helpers for the shader ports
+// --------------------------------------------------------
+struct Vec3
+{
+	float x, y, z;
+};
+
+static inline Vec3 V3(float x, float y, float z) { return { x, y, z }; }
+static inline Vec3 V3(const float* f) { return { f[0], f[1], f[2] }; }
+static inline Vec3 operator+(Vec3 a, Vec3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+static inline Vec3 operator-(Vec3 a, Vec3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+static inline Vec3 operator*(Vec3 a, Vec3 b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+static inline Vec3 operator*(Vec3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+static inline Vec3 operator/(Vec3 a, float s) { return { a.x / s, a.y / s, a.z / s }; }
+static inline Vec3 operator-(Vec3 a) { return { -a.x, -a.y, -a.z }; }
+static inline float Dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+static inline Vec3 Cross(Vec3 a, Vec3 b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+static inline float Saturate(float f) { return f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f); }
+static inline Vec3 Lerp(Vec3 a, Vec3 b, float t) { return a + (b - a) * t; }
+static inline Vec3 Pow(Vec3 a, float p) { return { powf(a.x, p), powf(a.y, p), powf(a.z, p) }; }
+
+static inline Vec3 Normalize(Vec3 a)
+{
+	float len = sqrtf(Dot(a, a));
+	return len > 0.0f ? a / len : a;
+}
+
+// row vector times matrix, like XMVector4Transform
+static inline void Transform4(const float* v, const float* m, float* out)
+{
+	for (int j = 0; j < 4; j++)
+		out[j] = v[0] * m[j] + v[1] * m[4 + j] + v[2] * m[8 + j] + v[3] * m[12 + j];
+}
+
+// direction times the upper 3x3, like the shader's (float3x3) casts
+static inline Vec3 Transform3(const float* v, const float* m)
+{
+	return {
+		v[0] * m[0] + v[1] * m[4] + v[2] * m[8],
+		v[0] * m[1] + v[1] * m[5] + v[2] * m[9],
+		v[0] * m[2] + v[1] * m[6] + v[2] * m[10] };
+}
+
+static void Multiply(const float* a, const float* b, float* out)
+{
+	for (int r = 0; r < 4; r++)
+		Transform4(&a[r * 4], b, &out[r * 4]);
+}
+
+
+// --------------------------------------------------------
+// Texture sampling
+// --------------------------------------------------------
+
+// bilinear, wrapped, like the BasicSampler
+static void Sample(const SoftwareTexture& tex, float u, float v, float* rgba)
+{
+	float x = u * tex.Width - 0.5f;
+	float y = v * tex.Height - 0.5f;
+	float fx = floorf(x), fy = floorf(y);
+	float tx = x - fx, ty = y - fy;
+
+	auto wrap = [](int i, int size) { i %= size; return i < 0 ? i + size : i; };
+	int x0 = wrap((int)fx, tex.Width), x1 = wrap((int)fx + 1, tex.Width);
+	int y0 = wrap((int)fy, tex.Height), y1 = wrap((int)fy + 1, tex.Height);
+
+	const uint8_t* t00 = &tex.Texels[(y0 * tex.Width + x0) * 4];
+	const uint8_t* t10 = &tex.Texels[(y0 * tex.Width + x1) * 4];
+	const uint8_t* t01 = &tex.Texels[(y1 * tex.Width + x0) * 4];
+	const uint8_t* t11 = &tex.Texels[(y1 * tex.Width + x1) * 4];
+	for (int c = 0; c < 4; c++) {
+		float top = t00[c] + (t10[c] - t00[c]) * tx;
+		float bottom = t01[c] + (t11[c] - t01[c]) * tx;
+		rgba[c] = (top + (bottom - top) * ty) / 255.0f;
+	}
+}
+
+// SampleCmpLevelZero with a LESS, linear, white-bordered comparison sampler
+static float SampleShadow(const SoftwareScene& scene, float u, float v, float depth)
+{
+	int size = (int)scene.ShadowMapSize;
+	float x = u * size - 0.5f;
+	float y = v * size - 0.5f;
+	float fx = floorf(x), fy = floorf(y);
+	float tx = x - fx, ty = y - fy;
+
+	auto test = [&](int px, int py) {
+		float stored = (px < 0 || py < 0 || px >= size || py >= size) ? 1.0f : scene.ShadowMap[py * scene.ShadowMapStride + px];
+		return depth < stored ? 1.0f : 0.0f;
+	};
+
+	int x0 = (int)fx, y0 = (int)fy;
+	float top = test(x0, y0) + (test(x0 + 1, y0) - test(x0, y0)) * tx;
+	float bottom = test(x0, y0 + 1) + (test(x0 + 1, y0 + 1) - test(x0, y0 + 1)) * tx;
+	return top + (bottom - top) * ty;
+}
+
+
+// --------------------------------------------------------
+// Port of include.hlsli's lighting functions
+// --------------------------------------------------------
+static float Attenuate(const SoftwareLight& light, Vec3 worldPos)
+{
+	Vec3 d = V3(light.Position) - worldPos;
+	float dist2 = Dot(d, d);
+	float att = Saturate(1.0f - (dist2 / (light.Range * light.Range)));
+	return att * att;
+}
+
+static float Diffuse(Vec3 normal, Vec3 dirToLight)
+{
+	return Saturate(Dot(normal, dirToLight));
+}
+
+static Vec3 DiffuseEnergyConserve(float diffuse, Vec3 F, float metalness)
+{
+	return (V3(1, 1, 1) - F) * (diffuse * (1 - metalness));
+}
+
+static float D_GGX(Vec3 n, Vec3 h, float roughness)
+{
+	float NdotH = Saturate(Dot(n, h));
+	float NdotH2 = NdotH * NdotH;
+	float a = roughness * roughness;
+	float a2 = std::max(a * a, MIN_ROUGHNESS);
+
+	float denomToSquare = NdotH2 * (a2 - 1) + 1;
+	return a2 / (PI * denomToSquare * denomToSquare);
+}
+
+static Vec3 F_Schlick(Vec3 v, Vec3 h, Vec3 f0)
+{
+	float VdotH = Saturate(Dot(v, h));
+	return f0 + (V3(1, 1, 1) - f0) * powf(1 - VdotH, 5);
+}
+
+static float G_SchlickGGX(Vec3 n, Vec3 v, float roughness)
+{
+	float k = powf(roughness + 1, 2) / 8.0f;
+	float NdotV = Saturate(Dot(n, v));
+	return 1 / (NdotV * (1 - k) + k);
+}
+
+static Vec3 MicroFacetBRDF(Vec3 n, Vec3 l, Vec3 v, float roughness, Vec3 specColor, Vec3& F_out)
+{
+	Vec3 h = Normalize(v + l);
+
+	float D = D_GGX(n, h, roughness);
+	Vec3 F = F_Schlick(v, h, specColor);
+	float G = G_SchlickGGX(n, v, roughness) * G_SchlickGGX(n, l, roughness);
+	F_out = F;
+
+	return F * (D * G / 4) * std::max(Dot(n, l), 0.0f);
+}
+
+static Vec3 DirectionalLight(const SoftwareLight& light, Vec3 dir, Vec3 normal, Vec3 worldPos, Vec3 camPos, float roughness, float metalness, Vec3 surfaceColor, Vec3 specular)
+{
+	Vec3 toLight = Normalize(-dir);
+	Vec3 toCam = Normalize(camPos - worldPos);
+
+	float diff = Diffuse(normal, toLight);
+	Vec3 F;
+	Vec3 spec = MicroFacetBRDF(normal, toLight, toCam, roughness, specular, F);
+	Vec3 balancedDiff = DiffuseEnergyConserve(diff, F, metalness);
+
+	return (balancedDiff * surfaceColor + spec) * V3(light.Color) * light.Intensity;
+}
+
+static Vec3 PointLight(const SoftwareLight& light, Vec3 normal, Vec3 worldPos, Vec3 camPos, float roughness, float metalness, Vec3 surfaceColor, Vec3 specular)
+{
+	Vec3 toLight = Normalize(V3(light.Position) - worldPos);
+	Vec3 toCam = Normalize(camPos - worldPos);
+
+	float atten = Attenuate(light, worldPos);
+	float diff = Diffuse(normal, toLight);
+	Vec3 F;
+	Vec3 spec = MicroFacetBRDF(normal, toLight, toCam, roughness, specular, F);
+	Vec3 balancedDiff = DiffuseEnergyConserve(diff, F, metalness);
+
+	return (balancedDiff * surfaceColor + spec) * V3(light.Color) * (atten * light.Intensity);
+}
+
+static Vec3 SpotLight(const SoftwareLight& light, Vec3 dir, Vec3 normal, Vec3 worldPos, Vec3 camPos, float roughness, float metalness, Vec3 surfaceColor, Vec3 specular)
+{
+	Vec3 toLight = Normalize(V3(light.Position) - worldPos);
+	float pixelAngle = Saturate(Dot(-toLight, dir));
+
+	float cosOuter = cosf(light.SpotOuterAngle);
+	float cosInner = cosf(light.SpotInnerAngle);
+	float falloffRange = cosOuter - cosInner;
+	float spotTerm = Saturate((cosOuter - pixelAngle) / falloffRange);
+
+	return PointLight(light, normal, worldPos, camPos, roughness, metalness, surfaceColor, specular) * spotTerm;
+}
+
+
+// --------------------------------------------------------
+// Port of VertexShader.hlsl
+// --------------------------------------------------------
+static void ShadeVertex(const float* v, const SoftwareDrawItem& item, const float* viewProj, const float* shadowViewProj, ClipVertex& out)
+{
+	float local[4] = { v[0], v[1], v[2], 1.0f };
+	float world[4];
+	Transform4(local, item.World, world);
+	Transform4(world, viewProj, out.Clip);
+
+	Vec3 normal = Transform3(&v[3], item.WorldInvTranspose);
+	Vec3 tangent = Transform3(&v[6], item.World);
+
+	float* a = out.Attr;
+	a[AttrWorld + 0] = world[0]; a[AttrWorld + 1] = world[1]; a[AttrWorld + 2] = world[2];
+	a[AttrNormal + 0] = normal.x; a[AttrNormal + 1] = normal.y; a[AttrNormal + 2] = normal.z;
+	a[AttrTangent + 0] = tangent.x; a[AttrTangent + 1] = tangent.y; a[AttrTangent + 2] = tangent.z;
+	a[AttrUV + 0] = v[9]; a[AttrUV + 1] = v[10];
+
+	if (shadowViewProj)
+		Transform4(world, shadowViewProj, &a[AttrShadow]);
+	else
+		a[AttrShadow + 0] = a[AttrShadow + 1] = a[AttrShadow + 2] = a[AttrShadow + 3] = 0.0f;
+}
+
+
+// --------------------------------------------------------
+// Port of PixelShader.hlsl
+// --------------------------------------------------------
+static uint32_t ShadePixel(const SoftwareScene& scene, const SoftwareMaterial& m, const float* attr)
+{
+	Vec3 worldPos = V3(&attr[AttrWorld]);
+	Vec3 N = Normalize(V3(&attr[AttrNormal]));
+	Vec3 T = Normalize(V3(&attr[AttrTangent]));
+
+	float u = attr[AttrUV + 0] * m.UVScale[0] + m.UVOffset[0];
+	float v = attr[AttrUV + 1] * m.UVScale[1] + m.UVOffset[1];
+	float texel[4];
+
+	// normal mapping
+	Vec3 unpackedNormal = V3(0, 0, 1);
+	if (m.NormalMap) {
+		Sample(*m.NormalMap, u, v, texel);
+		unpackedNormal = Normalize(V3(texel[0] * 2 - 1, texel[1] * 2 - 1, texel[2] * 2 - 1));
+	}
+	T = Normalize(T - N * Dot(T, N));
+	Vec3 B = Cross(T, N);
+	Vec3 normal = T * unpackedNormal.x + B * unpackedNormal.y + N * unpackedNormal.z;
+
+	// surface
+	float roughness = m.Roughness;
+	if (m.RoughnessMap) { Sample(*m.RoughnessMap, u, v, texel); roughness = texel[0]; }
+
+	float metalness = m.Metalness;
+	if (m.MetalnessMap) { Sample(*m.MetalnessMap, u, v, texel); metalness = texel[0]; }
+
+	Vec3 albedo = V3(m.ColorTint);
+	if (m.Albedo) { Sample(*m.Albedo, u, v, texel); albedo = V3(texel); }
+	Vec3 curColor = Pow(albedo, 2.2f);
+	Vec3 specColor = Lerp(V3(F0_NON_METAL, F0_NON_METAL, F0_NON_METAL), curColor, metalness);
+
+	// shadow
+	float shadowAmount = 1.0f;
+	if (scene.ShadowMap) {
+		const float* s = &attr[AttrShadow];
+		float shadowU = s[0] / s[3] * 0.5f + 0.5f;
+		float shadowV = 1.0f - (s[1] / s[3] * 0.5f + 0.5f);
+		shadowAmount = SampleShadow(scene, shadowU, shadowV, s[2] / s[3]);
+	}
+
+	// lights
+	Vec3 camPos = V3(scene.CameraPosition);
+	Vec3 totalLight = V3(0, 0, 0);
+	for (const SoftwareLight& light : scene.Lights) {
+		Vec3 dir = Normalize(V3(light.Direction));
+		switch (light.Type)
+		{
+		case LightDirectional:
+		{
+			// the shader stores this in a float, which keeps only the red channel
+			float result = DirectionalLight(light, dir, normal, worldPos, camPos, roughness, metalness, curColor, specColor).x;
+			float lit = result * (light.CastsShadows ? shadowAmount : 1.0f);
+			totalLight = totalLight + V3(lit, lit, lit);
+			break;
+		}
+		case LightPoint:
+			totalLight = totalLight + PointLight(light, normal, worldPos, camPos, roughness, metalness, curColor, specColor);
+			break;
+		case LightSpot:
+			totalLight = totalLight + SpotLight(light, dir, normal, worldPos, camPos, roughness, metalness, curColor, specColor);
+			break;
+		}
+	}
+
+	// gamma correct and pack
+	Vec3 c = Pow(totalLight, 1.0f / 2.2f);
+	uint32_t r = (uint32_t)(Saturate(c.x) * 255.0f + 0.5f);
+	uint32_t g = (uint32_t)(Saturate(c.y) * 255.0f + 0.5f);
+	uint32_t b = (uint32_t)(Saturate(c.z) * 255.0f + 0.5f);
+	return r | (g << 8) | (b << 16) | 0xFF000000;
+}
+
+
+// --------------------------------------------------------
+// Triangle setup
+// --------------------------------------------------------
+
+// Sutherland-Hodgman against one plane: near (z >= 0), or
+// w > 0 when depth is clamped instead of clipped
+static int ClipPolygon(const ClipVertex* in, int count, ClipVertex* out, bool clampDepth)
+{
+	auto dist = [&](const ClipVertex& v) { return clampDepth ? v.Clip[3] - 0.00001f : v.Clip[2]; };
+
+	int outCount = 0;
+	for (int i = 0; i < count; i++) {
+		const ClipVertex& a = in[i];
+		const ClipVertex& b = in[(i + 1) % count];
+		float da = dist(a), db = dist(b);
+
+		if (da >= 0) out[outCount++] = a;
+		if ((da >= 0) != (db >= 0)) {
+			float t = da / (da - db);
+			ClipVertex& c = out[outCount++];
+			for (int k = 0; k < 4; k++) c.Clip[k] = a.Clip[k] + (b.Clip[k] - a.Clip[k]) * t;
+			for (int k = 0; k < AttrCount; k++) c.Attr[k] = a.Attr[k] + (b.Attr[k] - a.Attr[k]) * t;
+		}
+	}
+	return outCount;
+}
+
+static bool SetupTriangle(const ClipVertex* v0, const ClipVertex* v1, const ClipVertex* v2,
+	const SoftwareRasterState& state, const SoftwareMaterial* material, unsigned int width, unsigned int height,
+	SoftwareRasterizer::Triangle& t)
+{
+	const ClipVertex* v[3] = { v0, v1, v2 };
+	for (int i = 0; i < 3; i++) {
+		float invW = 1.0f / v[i]->Clip[3];
+		t.InvW[i] = invW;
+		t.X[i] = (v[i]->Clip[0] * invW * 0.5f + 0.5f) * width;
+		t.Y[i] = (0.5f - v[i]->Clip[1] * invW * 0.5f) * height;
+		t.Z[i] = v[i]->Clip[2] * invW;
+		for (int k = 0; k < AttrCount; k++) t.Attr[i][k] = v[i]->Attr[k] * invW;
+	}
+
+	// clockwise on screen (positive here, since y points down) is front facing
+	float area = (t.X[1] - t.X[0]) * (t.Y[2] - t.Y[0]) - (t.X[2] - t.X[0]) * (t.Y[1] - t.Y[0]);
+	if (area == 0.0f || !std::isfinite(area)) return false;
+	if (area < 0.0f) {
+		if (state.CullBack) return false;
+
+		// wind it the other way so the edge functions stay positive inside
+		std::swap(t.X[1], t.X[2]); std::swap(t.Y[1], t.Y[2]);
+		std::swap(t.Z[1], t.Z[2]); std::swap(t.InvW[1], t.InvW[2]);
+		for (int k = 0; k < AttrCount; k++) std::swap(t.Attr[1][k], t.Attr[2][k]);
+		area = -area;
+	}
+	t.InvArea = 1.0f / area;
+
+	// edge i runs between the other two vertices
+	for (int i = 0; i < 3; i++) {
+		int a = (i + 1) % 3, b = (i + 2) % 3;
+		t.A[i] = -(t.Y[b] - t.Y[a]);
+		t.B[i] = t.X[b] - t.X[a];
+		t.C[i] = -(t.A[i] * t.X[a] + t.B[i] * t.Y[a]);
+
+		// pixels exactly on a left or top edge belong to this triangle
+		t.TopLeft[i] = t.A[i] > 0.0f || (t.A[i] == 0.0f && t.B[i] > 0.0f);
+	}
+
+	float minX = std::min(t.X[0], std::min(t.X[1], t.X[2]));
+	float maxX = std::max(t.X[0], std::max(t.X[1], t.X[2]));
+	float minY = std::min(t.Y[0], std::min(t.Y[1], t.Y[2]));
+	float maxY = std::max(t.Y[0], std::max(t.Y[1], t.Y[2]));
+	t.MinX = std::max(0, (int)floorf(minX));
+	t.MinY = std::max(0, (int)floorf(minY));
+	t.MaxX = std::min((int)width, (int)ceilf(maxX) + 1);
+	t.MaxY = std::min((int)height, (int)ceilf(maxY) + 1);
+	if (t.MinX >= t.MaxX || t.MinY >= t.MaxY) return false;
+
+	// D3D11's float depth bias: DepthBias * 2^(exponent(max z) - 23) + slope * max depth slope
+	t.DepthBias = 0.0f;
+	if (state.DepthBias != 0 || state.SlopeScaledDepthBias != 0.0f) {
+		float maxZ = std::max(fabsf(t.Z[0]), std::max(fabsf(t.Z[1]), fabsf(t.Z[2])));
+		if (maxZ > 0.0f) {
+			int exponent;
+			frexpf(maxZ, &exponent);
+			t.DepthBias = state.DepthBias * ldexpf(1.0f, exponent - 1 - 23);
+		}
+
+		float dzdx = (t.Z[0] * t.A[0] + t.Z[1] * t.A[1] + t.Z[2] * t.A[2]) * t.InvArea;
+		float dzdy = (t.Z[0] * t.B[0] + t.Z[1] * t.B[1] + t.Z[2] * t.B[2]) * t.InvArea;
+		t.DepthBias += state.SlopeScaledDepthBias * std::max(fabsf(dzdx), fabsf(dzdy));
+	}
+
+	t.ClampDepth = state.ClampDepth;
+	t.Material = material;
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Framebuffer
+// --------------------------------------------------------
+void SoftwareFramebuffer::Resize(unsigned int width, unsigned int height)
+{
+	Width = width;
+	Height = height;
+	Stride = (width + 3) & ~3u;
+	Depth.assign((size_t)Stride * height, 1.0f);
+	Color.assign((size_t)Stride * height, 0);
+}
+
+void SoftwareFramebuffer::Clear(uint32_t color, float depth)
+{
+	std::fill(Color.begin(), Color.end(), color);
+	std::fill(Depth.begin(), Depth.end(), depth);
+}
+
+uint32_t SoftwareFramebuffer::GetColor(unsigned int x, unsigned int y) const
+{
+	return Color[(size_t)y * Stride + x];
+}
+
+float SoftwareFramebuffer::GetDepth(unsigned int x, unsigned int y) const
+{
+	return Depth[(size_t)y * Stride + x];
+}
+
+
+// --------------------------------------------------------
+// Rasterizer
+// --------------------------------------------------------
+SoftwareRasterizer::SoftwareRasterizer(std::shared_ptr<ThreadPool> pool, unsigned int tileSize) :
+	pool(pool)
+{
+	// tiles must line up with the 4 pixel groups, so threads never share one
+	this->tileSize = std::max(4u, (tileSize + 3) & ~3u);
+	stats = {};
+}
+
+void SoftwareRasterizer::Render(const SoftwareScene& scene, const std::vector<SoftwareDrawItem>& items, const SoftwareRasterState& state, SoftwareFramebuffer& target)
+{
+	Draw(&scene, scene.View, scene.Projection, items, state, target);
+}
+
+void SoftwareRasterizer::RenderDepth(const float* view, const float* projection, const std::vector<SoftwareDrawItem>& items, const SoftwareRasterState& state, SoftwareFramebuffer& target)
+{
+	Draw(0, view, projection, items, state, target);
+}
+
+SoftwareRasterStats SoftwareRasterizer::GetStats()
+{
+	return stats;
+}
+
+// --------------------------------------------------------
+// Runs the whole pipeline
+//
+// 1. Vertex shading, clipping and setup, one job per item
+// 2. Binning, in submission order, so every tile sees its
+//    triangles in the same order the GPU would
+// 3. One job per tile, each owning its pixels outright
+// --------------------------------------------------------
+void SoftwareRasterizer::Draw(const SoftwareScene* scene, const float* view, const float* projection,
+	const std::vector<SoftwareDrawItem>& items, const SoftwareRasterState& state, SoftwareFramebuffer& target)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	stats = {};
+
+	float viewProj[16];
+	Multiply(view, projection, viewProj);
+
+	float shadowViewProj[16];
+	bool shadows = scene && scene->ShadowMap;
+	if (shadows) Multiply(scene->ShadowView, scene->ShadowProjection, shadowViewProj);
+
+	auto parallelFor = [&](unsigned int count, const std::function<void(unsigned int)>& job) {
+		if (pool) pool->ParallelFor(count, job);
+		else for (unsigned int i = 0; i < count; i++) job(i);
+	};
+
+	// 1. vertex shading and setup
+	std::vector<std::vector<Triangle>> itemTriangles(items.size());
+	parallelFor((unsigned int)items.size(), [&](unsigned int i)
+		{
+			const SoftwareDrawItem& item = items[i];
+			std::vector<ClipVertex> shaded(item.VertexCount);
+			for (unsigned int v = 0; v < item.VertexCount; v++)
+				ShadeVertex(&item.Vertices[v * VertexFloats], item, viewProj, shadows ? shadowViewProj : 0, shaded[v]);
+
+			std::vector<Triangle>& out = itemTriangles[i];
+			for (unsigned int k = 0; k + 2 < item.IndexCount; k += 3) {
+				ClipVertex in[3] = { shaded[item.Indices[k]], shaded[item.Indices[k + 1]], shaded[item.Indices[k + 2]] };
+
+				// only clip when something's actually behind the plane
+				ClipVertex clipped[4];
+				int count = ClipPolygon(in, 3, clipped, state.ClampDepth);
+				for (int f = 1; f + 1 < count; f++) {
+					Triangle t;
+					if (SetupTriangle(&clipped[0], &clipped[f], &clipped[f + 1], state, item.Material, target.Width, target.Height, t))
+						out.push_back(t);
+				}
+			}
+		});
+
+	std::vector<Triangle> triangles;
+	for (auto& list : itemTriangles)
+		triangles.insert(triangles.end(), list.begin(), list.end());
+
+	for (auto& item : items) stats.TrianglesIn += item.IndexCount / 3;
+	stats.TrianglesRasterized = triangles.size();
+
+	// 2. binning
+	unsigned int tilesX = (target.Width + tileSize - 1) / tileSize;
+	unsigned int tilesY = (target.Height + tileSize - 1) / tileSize;
+	std::vector<std::vector<unsigned int>> bins(tilesX * tilesY);
+	for (unsigned int i = 0; i < triangles.size(); i++) {
+		const Triangle& t = triangles[i];
+		for (unsigned int ty = t.MinY / tileSize; ty <= (unsigned int)(t.MaxY - 1) / tileSize; ty++)
+			for (unsigned int tx = t.MinX / tileSize; tx <= (unsigned int)(t.MaxX - 1) / tileSize; tx++)
+				bins[ty * tilesX + tx].push_back(i);
+	}
+
+	// 3. tiles
+	std::atomic<uint64_t> pixelsShaded(0);
+	parallelFor(tilesX * tilesY, [&](unsigned int tile)
+		{
+			if (bins[tile].empty()) return;
+
+			uint64_t pixels = 0;
+			RasterizeTile(scene, triangles, bins[tile], tile % tilesX, tile / tilesX, target, pixels);
+			pixelsShaded += pixels;
+		});
+	stats.PixelsShaded = pixelsShaded;
+
+	// throughput
+	stats.Milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	double seconds = stats.Milliseconds / 1000.0;
+	if (seconds > 0.0) {
+		stats.TrianglesPerSecond = stats.TrianglesIn / seconds;
+		stats.PixelsPerSecond = stats.PixelsShaded / seconds;
+	}
+}
+
+// --------------------------------------------------------
+// Rasterizes one tile's bin, 4 pixels at a time
+// - Edge functions are stepped across each row in SSE
+//   registers; only covered pixels that pass the depth
+//   test are shaded (one at a time)
+// --------------------------------------------------------
+void SoftwareRasterizer::RasterizeTile(const SoftwareScene* scene, const std::vector<Triangle>& triangles,
+	const std::vector<unsigned int>& bin, unsigned int tileX, unsigned int tileY, SoftwareFramebuffer& target,
+	uint64_t& pixelsShaded)
+{
+	int tileMinX = tileX * tileSize;
+	int tileMinY = tileY * tileSize;
+	int tileMaxX = std::min(tileMinX + (int)tileSize, (int)target.Width);
+	int tileMaxY = std::min(tileMinY + (int)tileSize, (int)target.Height);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 columns = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (unsigned int index : bin) {
+		const Triangle& t = triangles[index];
+
+		// start on a 4 pixel boundary (tiles always do)
+		int minX = std::max(t.MinX, tileMinX) & ~3;
+		int maxX = std::min(t.MaxX, tileMaxX);
+		int minY = std::max(t.MinY, tileMinY);
+		int maxY = std::min(t.MaxY, tileMaxY);
+		if (minX >= maxX || minY >= maxY) continue;
+
+		__m128 A[3], B[3], C[3], step[3], topLeft[3];
+		for (int i = 0; i < 3; i++) {
+			A[i] = _mm_set1_ps(t.A[i]);
+			B[i] = _mm_set1_ps(t.B[i]);
+			C[i] = _mm_set1_ps(t.C[i]);
+			step[i] = _mm_set1_ps(t.A[i] * 4.0f);
+			topLeft[i] = t.TopLeft[i] ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : zero;
+		}
+		__m128 invArea = _mm_set1_ps(t.InvArea);
+		__m128 z0 = _mm_set1_ps(t.Z[0]), z1 = _mm_set1_ps(t.Z[1]), z2 = _mm_set1_ps(t.Z[2]);
+		__m128 bias = _mm_set1_ps(t.DepthBias);
+		__m128 right = _mm_set1_ps((float)maxX);
+
+		for (int y = minY; y < maxY; y++) {
+			__m128 py = _mm_set1_ps(y + 0.5f);
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)minX), columns);
+
+			__m128 e[3];
+			for (int i = 0; i < 3; i++)
+				e[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(A[i], px), _mm_mul_ps(B[i], py)), C[i]);
+
+			float* depthRow = &target.Depth[(size_t)y * target.Stride];
+			for (int x = minX; x < maxX; x += 4) {
+				// inside all three edges (ties go to top-left edges), and left of the bounds
+				__m128 inside = _mm_cmplt_ps(px, right);
+				for (int i = 0; i < 3; i++) {
+					__m128 edge = _mm_or_ps(_mm_cmpgt_ps(e[i], zero), _mm_and_ps(_mm_cmpeq_ps(e[i], zero), topLeft[i]));
+					inside = _mm_and_ps(inside, edge);
+				}
+
+				if (_mm_movemask_ps(inside)) {
+					// z/w is linear in screen space
+					__m128 z = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(z0, e[0]), _mm_mul_ps(z1, e[1])), _mm_mul_ps(z2, e[2])), invArea);
+					z = _mm_add_ps(z, bias);
+
+					// past the far plane is clipped, unless depth is being clamped
+					if (!t.ClampDepth) inside = _mm_and_ps(inside, _mm_cmple_ps(z, one));
+					z = _mm_min_ps(_mm_max_ps(z, zero), one);
+
+					__m128 old = _mm_loadu_ps(&depthRow[x]);
+					__m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+					int mask = _mm_movemask_ps(pass);
+					if (mask) {
+						_mm_storeu_ps(&depthRow[x], _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old)));
+
+						if (scene) {
+							float w[3][4];
+							for (int i = 0; i < 3; i++) _mm_storeu_ps(w[i], _mm_mul_ps(e[i], invArea));
+
+							for (int k = 0; k < 4; k++) {
+								if (!(mask & (1 << k))) continue;
+
+								// perspective correct attributes
+								float b0 = w[0][k], b1 = w[1][k], b2 = w[2][k];
+								float invW = b0 * t.InvW[0] + b1 * t.InvW[1] + b2 * t.InvW[2];
+								float attr[AttrCount];
+								for (int a = 0; a < AttrCount; a++)
+									attr[a] = (b0 * t.Attr[0][a] + b1 * t.Attr[1][a] + b2 * t.Attr[2][a]) / invW;
+
+								target.Color[(size_t)y * target.Stride + x + k] = ShadePixel(*scene, *t.Material, attr);
+							}
+						}
+
+						for (int k = 0; k < 4; k++) if (mask & (1 << k)) pixelsShaded++;
+					}
+				}
+
+				for (int i = 0; i < 3; i++) e[i] = _mm_add_ps(e[i], step[i]);
+				px = _mm_add_ps(px, _mm_set1_ps(4.0f));
+			}
+		}
+	}
+}
+
+
+// --------------------------------------------------------
+// Reference image helpers
+// --------------------------------------------------------
+SoftwareImageDiff SoftwareRasterizer::Compare(const SoftwareFramebuffer& a, const SoftwareFramebuffer& b, unsigned int tolerance)
+{
+	SoftwareImageDiff diff = {};
+	if (a.Width != b.Width || a.Height != b.Height) {
+		diff.DifferentPixels = std::max(a.Width * a.Height, b.Width * b.Height);
+		diff.MaxChannelDelta = 255;
+		diff.MeanAbsoluteError = 255.0;
+		return diff;
+	}
+
+	uint64_t total = 0;
+	bool depths = !a.Depth.empty() && !b.Depth.empty();
+	for (unsigned int y = 0; y < a.Height; y++) {
+		for (unsigned int x = 0; x < a.Width; x++) {
+			uint32_t ca = a.GetColor(x, y), cb = b.GetColor(x, y);
+			unsigned int worst = 0;
+			for (int c = 0; c < 3; c++) {
+				int da = (ca >> (c * 8)) & 0xFF, db = (cb >> (c * 8)) & 0xFF;
+				unsigned int d = (unsigned int)abs(da - db);
+				worst = std::max(worst, d);
+				total += d;
+			}
+			if (worst > tolerance) diff.DifferentPixels++;
+			diff.MaxChannelDelta = std::max(diff.MaxChannelDelta, worst);
+
+			if (depths)
+				diff.MaxDepthDelta = std::max(diff.MaxDepthDelta, fabsf(a.GetDepth(x, y) - b.GetDepth(x, y)));
+		}
+	}
+
+	diff.MeanAbsoluteError = (double)total / ((double)a.Width * a.Height * 3);
+	return diff;
+}
+
+// binary PPM (P6), RGB
+bool SoftwareRasterizer::SaveColor(const SoftwareFramebuffer& image, const std::string& ppmPath)
+{
+	std::ofstream file(ppmPath, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	file << "P6\n" << image.Width << " " << image.Height << "\n255\n";
+	std::vector<uint8_t> row(image.Width * 3);
+	for (unsigned int y = 0; y < image.Height; y++) {
+		for (unsigned int x = 0; x < image.Width; x++) {
+			uint32_t c = image.GetColor(x, y);
+			row[x * 3 + 0] = c & 0xFF;
+			row[x * 3 + 1] = (c >> 8) & 0xFF;
+			row[x * 3 + 2] = (c >> 16) & 0xFF;
+		}
+		file.write((const char*)row.data(), row.size());
+	}
+	return file.good();
+}
+
+// grayscale PFM, little endian, rows stored bottom to top
+bool SoftwareRasterizer::SaveDepth(const SoftwareFramebuffer& image, const std::string& pfmPath)
+{
+	std::ofstream file(pfmPath, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	file << "Pf\n" << image.Width << " " << image.Height << "\n-1.0\n";
+	for (unsigned int y = image.Height; y-- > 0;)
+		file.write((const char*)&image.Depth[(size_t)y * image.Stride], image.Width * sizeof(float));
+	return file.good();
+}
+
+bool SoftwareRasterizer::LoadColor(SoftwareFramebuffer& image, const std::string& ppmPath)
+{
+	std::ifstream file(ppmPath, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	std::string magic;
+	unsigned int width = 0, height = 0, maxValue = 0;
+	file >> magic >> width >> height >> maxValue;
+	file.get();	// the single whitespace before the data
+	if (magic != "P6" || maxValue != 255 || width == 0 || height == 0) return false;
+
+	image.Resize(width, height);
+	std::vector<uint8_t> row(width * 3);
+	for (unsigned int y = 0; y < height; y++) {
+		if (!file.read((char*)row.data(), row.size())) return false;
+		for (unsigned int x = 0; x < width; x++)
+			image.Color[(size_t)y * image.Stride + x] = row[x * 3] | (row[x * 3 + 1] << 8) | (row[x * 3 + 2] << 16) | 0xFF000000;
+	}
+	return true;
+}
+
+bool SoftwareRasterizer::LoadDepth(SoftwareFramebuffer& image, const std::string& pfmPath)
+{
+	std::ifstream file(pfmPath, std::ios::binary);
+	if (!file.is_open()) return false;
+
+	std::string magic;
+	unsigned int width = 0, height = 0;
+	float scale = 0.0f;
+	file >> magic >> width >> height >> scale;
+	file.get();
+	if (magic != "Pf" || scale >= 0.0f || width == 0 || height == 0) return false;
+
+	// keep the color if it's already loaded at this size
+	if (image.Width != width || image.Height != height)
+		image.Resize(width, height);
+
+	for (unsigned int y = height; y-- > 0;)
+		if (!file.read((char*)&image.Depth[(size_t)y * image.Stride], width * sizeof(float))) return false;
+	return true;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+
+// --------------------------------------------------------
+// A CPU reference renderer for golden-image tests
+//
+// - Only depends on the standard library and SSE, so it
+//   runs anywhere, GPU or not
+// - Triangles are binned into screen tiles, and the tiles
+//   are rasterized across the thread pool, 4 pixels at a
+//   time with SSE edge functions
+// - Shading is a straight port of VertexShader.hlsl and
+//   PixelShader.hlsl (normal mapping, the PBR light loop,
+//   shadow map comparison), so the images can be compared
+//   to what the GPU draws
+// - Matrices are 16 floats laid out like XMFLOAT4X4, used
+//   with row vectors, same as the rest of the engine
+// --------------------------------------------------------
+
+// RGBA8 texture, sampled bilinear with wrapping
+struct SoftwareTexture
+{
+	unsigned int Width;
+	unsigned int Height;
+	std::vector<uint8_t> Texels;
+};
+
+// Same layout as Light (and the shader's cbuffer struct)
+struct SoftwareLight
+{
+	int Type;
+	float Direction[3];
+	float Range;
+	float Position[3];
+	float Intensity;
+	float Color[3];
+	float SpotInnerAngle;
+	float SpotOuterAngle;
+	int CastsShadows;
+	float Pad;
+};
+
+// Missing textures fall back to constants: ColorTint for
+// albedo, a flat normal, Roughness and Metalness
+struct SoftwareMaterial
+{
+	float ColorTint[3];
+	float UVScale[2];
+	float UVOffset[2];
+	float Roughness;
+	float Metalness;
+	const SoftwareTexture* Albedo;
+	const SoftwareTexture* NormalMap;
+	const SoftwareTexture* RoughnessMap;
+	const SoftwareTexture* MetalnessMap;
+};
+
+// One mesh instance; vertices use the Vertex layout (11 floats)
+struct SoftwareDrawItem
+{
+	const float* Vertices;
+	unsigned int VertexCount;
+	const unsigned int* Indices;
+	unsigned int IndexCount;
+	float World[16];
+	float WorldInvTranspose[16];
+	const SoftwareMaterial* Material;
+};
+
+// Rasterizer state, mirroring the D3D11 settings that matter here
+struct SoftwareRasterState
+{
+	bool CullBack;
+	bool ClampDepth;			// DepthClipEnable = false (shadow pancaking)
+	int DepthBias;				// in units of the depth format's precision, like D3D11 float depth
+	float SlopeScaledDepthBias;
+};
+
+// Everything per-frame the shaders read
+struct SoftwareScene
+{
+	float View[16];
+	float Projection[16];
+	float CameraPosition[3];
+	std::vector<SoftwareLight> Lights;
+
+	// optional shadow map (depth, Size x Size), as rendered by RenderDepth
+	const float* ShadowMap;
+	unsigned int ShadowMapSize;
+	unsigned int ShadowMapStride;
+	float ShadowView[16];
+	float ShadowProjection[16];
+};
+
+// Color (RGBA8, R in the low byte) and depth
+// - Rows are padded to a multiple of 4 pixels
+struct SoftwareFramebuffer
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int Stride;
+	std::vector<float> Depth;
+	std::vector<uint32_t> Color;
+
+	void Resize(unsigned int width, unsigned int height);
+	void Clear(uint32_t color, float depth);
+	uint32_t GetColor(unsigned int x, unsigned int y) const;
+	float GetDepth(unsigned int x, unsigned int y) const;
+};
+
+struct SoftwareRasterStats
+{
+	uint64_t TrianglesIn;
+	uint64_t TrianglesRasterized;	// after culling and clipping
+	uint64_t PixelsShaded;			// passed the depth test
+	double Milliseconds;
+	double TrianglesPerSecond;
+	double PixelsPerSecond;
+};
+
+struct SoftwareImageDiff
+{
+	unsigned int DifferentPixels;	// any channel off by more than the tolerance
+	unsigned int MaxChannelDelta;
+	double MeanAbsoluteError;		// per channel, 0-255
+	float MaxDepthDelta;
+};
+
+class SoftwareRasterizer
+{
+public:
+	/// <summary>
+	/// Creates the rasterizer
+	/// </summary>
+	/// <param name="pool">threads to rasterize tiles on (null for single threaded)</param>
+	/// <param name="tileSize">tile width and height in pixels (rounded up to a multiple of 4)</param>
+	SoftwareRasterizer(std::shared_ptr<ThreadPool> pool, unsigned int tileSize = 32);
+
+	/// <summary>
+	/// Draws lit, shaded items into the target's color and depth (depth test LESS)
+	/// </summary>
+	void Render(const SoftwareScene& scene, const std::vector<SoftwareDrawItem>& items, const SoftwareRasterState& state, SoftwareFramebuffer& target);
+
+	/// <summary>
+	/// Draws depth only, e.g. for a shadow map
+	/// </summary>
+	void RenderDepth(const float* view, const float* projection, const std::vector<SoftwareDrawItem>& items, const SoftwareRasterState& state, SoftwareFramebuffer& target);
+
+	SoftwareRasterStats GetStats();
+
+	// Reference image helpers
+	static SoftwareImageDiff Compare(const SoftwareFramebuffer& a, const SoftwareFramebuffer& b, unsigned int tolerance);
+	static bool SaveColor(const SoftwareFramebuffer& image, const std::string& ppmPath);
+	static bool SaveDepth(const SoftwareFramebuffer& image, const std::string& pfmPath);
+	static bool LoadColor(SoftwareFramebuffer& image, const std::string& ppmPath);
+	static bool LoadDepth(SoftwareFramebuffer& image, const std::string& pfmPath);
+
+	// Screen space triangle after setup (only defined in the .cpp)
+	struct Triangle;
+
+private:
+
+	void Draw(const SoftwareScene* scene, const float* view, const float* projection,
+		const std::vector<SoftwareDrawItem>& items, const SoftwareRasterState& state, SoftwareFramebuffer& target);
+	void RasterizeTile(const SoftwareScene* scene, const std::vector<Triangle>& triangles,
+		const std::vector<unsigned int>& bin, unsigned int tileX, unsigned int tileY, SoftwareFramebuffer& target,
+		uint64_t& pixelsShaded);
+
+	std::shared_ptr<ThreadPool> pool;
+	unsigned int tileSize;
+	SoftwareRasterStats stats;
+};
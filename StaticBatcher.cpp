@@ -0,0 +1,170 @@
+#include "StaticBatcher.h"
+
+#include <cmath>
+#include <map>
+#include <tuple>
+
+using namespace DirectX;
+
+StaticBatcher::StaticBatcher(float cellSize, unsigned int maxVerticesPerChunk) :
+	cellSize(cellSize),
+	maxVerticesPerChunk(maxVerticesPerChunk)
+{
+	stats = {};
+}
+
+StaticBatcher::~StaticBatcher()
+{
+}
+
+void StaticBatcher::Build(const std::vector<std::shared_ptr<GameEntity>>& entities)
+{
+	chunks.clear();
+	merged.assign(entities.size(), false);
+	sources.clear();
+	stats = {};
+
+	// group static entities by material and by the cell their center falls in
+	// (ordered, so the same scene always batches the same way)
+	std::map<std::tuple<Material*, int, int>, std::vector<unsigned int>> groups;
+	for (unsigned int i = 0; i < entities.size(); i++) {
+		GameEntity* e = entities[i].get();
+		sources.push_back({ e, e->GetTransform()->GetVersion(), e->GetMesh().get(), e->GetMaterial().get(), e->IsStatic() });
+
+		if (!e->IsStatic()) continue;
+		stats.StaticEntities++;
+
+		BoundingBox world = e->GetWorldBounds();
+		int x = (int)floorf(world.Center.x / cellSize);
+		int z = (int)floorf(world.Center.z / cellSize);
+		groups[std::make_tuple(e->GetMaterial().get(), x, z)].push_back(i);
+	}
+
+	for (auto& g : groups) {
+		std::vector<unsigned int>& members = g.second;
+
+		// nothing to gain from a chunk of one
+		if (members.size() < 2) continue;
+
+		std::shared_ptr<Material> material = entities[members[0]]->GetMaterial();
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		for (unsigned int i : members) {
+			// start a new chunk rather than go over the limit
+			size_t count = entities[i]->GetMesh()->GetVertexData().size();
+			if (!verts.empty() && verts.size() + count > maxVerticesPerChunk)
+				FlushChunk(material, verts, indices);
+
+			AppendEntity(entities[i].get(), verts, indices);
+			merged[i] = true;
+			stats.MergedEntities++;
+		}
+
+		FlushChunk(material, verts, indices);
+	}
+}
+
+bool StaticBatcher::IsStale(const std::vector<std::shared_ptr<GameEntity>>& entities)
+{
+	if (entities.size() != sources.size()) return true;
+
+	for (size_t i = 0; i < entities.size(); i++) {
+		GameEntity* e = entities[i].get();
+		const SourceState& s = sources[i];
+
+		if (s.Entity != e || s.Static != e->IsStatic()) return true;
+
+		// dynamic entities aren't in any chunk, so nothing else about them matters
+		if (!s.Static) continue;
+
+		if (s.Version != e->GetTransform()->GetVersion() ||
+			s.EntityMesh != e->GetMesh().get() ||
+			s.EntityMaterial != e->GetMaterial().get())
+			return true;
+	}
+
+	return false;
+}
+
+const std::vector<std::shared_ptr<GameEntity>>& StaticBatcher::GetChunks()
+{
+	return chunks;
+}
+
+bool StaticBatcher::IsMerged(unsigned int entityIndex)
+{
+	return entityIndex < merged.size() && merged[entityIndex];
+}
+
+StaticBatchStats StaticBatcher::GetStats()
+{
+	return stats;
+}
+
+float StaticBatcher::GetCellSize()
+{
+	return cellSize;
+}
+
+unsigned int StaticBatcher::GetMaxVerticesPerChunk()
+{
+	return maxVerticesPerChunk;
+}
+
+// --------------------------------------------------------
+// Bakes an entity's world matrix into a copy of its mesh
+//
+// - Normals use the inverse transpose, tangents the world
+//   matrix itself, both renormalized after
+// - Mirroring transforms flip the triangle winding, so
+//   those triangles are flipped back
+// --------------------------------------------------------
+void StaticBatcher::AppendEntity(GameEntity* entity, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	std::shared_ptr<Transform> transform = entity->GetTransform();
+	XMFLOAT4X4 worldF = transform->GetWorldMatrix();
+	XMFLOAT4X4 invTransposeF = transform->GetInverseTransposeWorldMatrix();
+	XMMATRIX world = XMLoadFloat4x4(&worldF);
+	XMMATRIX invTranspose = XMLoadFloat4x4(&invTransposeF);
+	bool mirrored = XMVectorGetX(XMMatrixDeterminant(world)) < 0.0f;
+
+	std::shared_ptr<Mesh> mesh = entity->GetMesh();
+	const std::vector<Vertex>& srcVerts = mesh->GetVertexData();
+	const std::vector<unsigned int>& srcIndices = mesh->GetIndexData();
+
+	unsigned int base = (unsigned int)verts.size();
+	for (const Vertex& v : srcVerts) {
+		Vertex w = v;
+		XMStoreFloat3(&w.Position, XMVector3Transform(XMLoadFloat3(&v.Position), world));
+		XMStoreFloat3(&w.Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&v.Normal), invTranspose)));
+		XMStoreFloat3(&w.Tangent, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&v.Tangent), world)));
+		verts.push_back(w);
+	}
+
+	for (size_t i = 0; i + 2 < srcIndices.size(); i += 3) {
+		indices.push_back(base + srcIndices[i]);
+		indices.push_back(base + srcIndices[i + (mirrored ? 2 : 1)]);
+		indices.push_back(base + srcIndices[i + (mirrored ? 1 : 2)]);
+	}
+}
+
+void StaticBatcher::FlushChunk(std::shared_ptr<Material> material, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	if (verts.empty() || indices.empty()) return;
+
+	// tangents were carried over, so don't recalculate them
+	std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>("static batch",
+		&verts[0], verts.size(), &indices[0], indices.size(), false);
+
+	std::shared_ptr<GameEntity> chunk = std::make_shared<GameEntity>(mesh, material);
+	chunk->SetStatic(true);
+	chunks.push_back(chunk);
+
+	stats.Chunks++;
+	if (mesh->GetIndexFormat() == RenderIndexFormat::UInt16) stats.Chunks16Bit++;
+	stats.Vertices += (unsigned int)verts.size();
+	stats.Indices += (unsigned int)indices.size();
+
+	verts.clear();
+	indices.clear();
+}
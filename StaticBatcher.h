@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "GameEntity.h"
+
+// --------------------------------------------------------
+// What the last StaticBatcher::Build did
+// --------------------------------------------------------
+struct StaticBatchStats
+{
+	unsigned int StaticEntities;	// static entities looked at
+	unsigned int MergedEntities;	// ...of which ended up in a chunk
+	unsigned int Chunks;			// draws that replace the merged entities
+	unsigned int Chunks16Bit;		// chunks small enough for 16 bit indices
+	unsigned int Vertices;			// across all chunks
+	unsigned int Indices;
+};
+
+// --------------------------------------------------------
+// Merges static entities into a few big pre-transformed
+// meshes, so they cost one draw (and one constant upload)
+// per chunk instead of one per entity
+//
+// - Entities are grouped by material, then by a grid cell
+//   on the xz plane, so chunks stay small enough to cull
+// - Positions, normals and tangents are baked into world
+//   space; chunks are drawn with an identity transform
+// - Chunks are split to stay under a vertex limit (65536
+//   by default, which keeps them on 16 bit indices)
+// - Entities alone in their group are left as they are
+// --------------------------------------------------------
+class StaticBatcher
+{
+public:
+	StaticBatcher(float cellSize = 32.0f, unsigned int maxVerticesPerChunk = 0x10000);
+	~StaticBatcher();
+
+	/// <summary>
+	/// Rebuilds every chunk from the static entities in the list
+	/// </summary>
+	/// <param name="entities">every entity in the scene</param>
+	void Build(const std::vector<std::shared_ptr<GameEntity>>& entities);
+
+	/// <summary>
+	/// Has anything the chunks were built from changed since?
+	/// (a static entity moving, swapping mesh or material, or the static flags changing)
+	/// </summary>
+	bool IsStale(const std::vector<std::shared_ptr<GameEntity>>& entities);
+
+	// GETTERS
+	const std::vector<std::shared_ptr<GameEntity>>& GetChunks();
+	bool IsMerged(unsigned int entityIndex);	// is this entity drawn by a chunk?
+	StaticBatchStats GetStats();
+	float GetCellSize();
+	unsigned int GetMaxVerticesPerChunk();
+
+private:
+	// What an entity looked like when the chunks were built
+	struct SourceState
+	{
+		GameEntity* Entity;
+		unsigned int Version;
+		Mesh* EntityMesh;
+		Material* EntityMaterial;
+		bool Static;
+	};
+
+	void AppendEntity(GameEntity* entity, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+	void FlushChunk(std::shared_ptr<Material> material, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+	float cellSize;
+	unsigned int maxVerticesPerChunk;
+
+	std::vector<std::shared_ptr<GameEntity>> chunks;
+	std::vector<bool> merged;
+	std::vector<SourceState> sources;
+	StaticBatchStats stats;
+};
@@ -0,0 +1,136 @@
+#include "TextureAnalysis.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
+
+// --------------------------------------------------------
+// Ranges and averages
+// --------------------------------------------------------
+TextureChannelRange TextureAnalysis::GetRange(const DecodedImage& image)
+{
+	TextureChannelRange range = { { 255, 255, 255, 255 }, { 0, 0, 0, 0 } };
+	size_t bytes = image.Pixels.size();
+	const unsigned char* p = image.Pixels.data();
+
+	// 4 pixels per register, so each byte lane keeps to one channel
+	__m128i lo = _mm_set1_epi8((char)0xFF);
+	__m128i hi = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= bytes; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+		lo = _mm_min_epu8(lo, v);
+		hi = _mm_max_epu8(hi, v);
+	}
+
+	alignas(16) unsigned char los[16], his[16];
+	_mm_store_si128((__m128i*)los, lo);
+	_mm_store_si128((__m128i*)his, hi);
+	for (unsigned int b = 0; b < 16 && i > 0; b++) {
+		range.Min[b & 3] = std::min(range.Min[b & 3], los[b]);
+		range.Max[b & 3] = std::max(range.Max[b & 3], his[b]);
+	}
+	for (; i < bytes; i++) {
+		range.Min[i & 3] = std::min(range.Min[i & 3], p[i]);
+		range.Max[i & 3] = std::max(range.Max[i & 3], p[i]);
+	}
+	return range;
+}
+
+void TextureAnalysis::GetAverage(const DecodedImage& image, float* average)
+{
+	size_t bytes = image.Pixels.size();
+	const unsigned char* p = image.Pixels.data();
+	uint64_t sums[4] = {};
+
+	// psadbw sums 8 bytes at a time, so split the channels into their own
+	// registers first (masking to one channel per 32 bit lane)
+	__m128i mask = _mm_set1_epi32(0xFF);
+	__m128i zero = _mm_setzero_si128();
+	__m128i total[4] = { zero, zero, zero, zero };
+	size_t i = 0;
+	for (; i + 16 <= bytes; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+		for (unsigned int c = 0; c < 4; c++) {
+			__m128i channel = _mm_and_si128(_mm_srli_epi32(v, c * 8), mask);
+			total[c] = _mm_add_epi64(total[c], _mm_sad_epu8(channel, zero));
+		}
+	}
+	for (unsigned int c = 0; c < 4; c++) {
+		alignas(16) uint64_t halves[2];
+		_mm_store_si128((__m128i*)halves, total[c]);
+		sums[c] = halves[0] + halves[1];
+	}
+	for (; i < bytes; i++) sums[i & 3] += p[i];
+
+	size_t pixels = bytes / 4;
+	for (unsigned int c = 0; c < 4; c++)
+		average[c] = pixels ? (float)((double)sums[c] / pixels / 255.0) : 0.0f;
+}
+
+bool TextureAnalysis::IsUniform(const DecodedImage& image, unsigned int channels, unsigned int tolerance, float* value)
+{
+	if (image.Pixels.empty()) return false;
+
+	TextureChannelRange range = GetRange(image);
+	for (unsigned int c = 0; c < channels && c < 4; c++)
+		if ((unsigned int)(range.Max[c] - range.Min[c]) > tolerance) return false;
+
+	if (value) {
+		float average[4];
+		GetAverage(image, average);
+		*value = average[0];
+	}
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Packing
+// --------------------------------------------------------
+DecodedImage TextureAnalysis::PackORM(const DecodedImage* maps[3], const unsigned char constants[3])
+{
+	DecodedImage packed = {};
+	const DecodedImage* first = 0;
+	for (unsigned int m = 0; m < 3; m++) {
+		if (!maps[m]) continue;
+		if (first && (maps[m]->Width != first->Width || maps[m]->Height != first->Height)) return packed;
+		if (!first) first = maps[m];
+	}
+	if (!first) return packed;
+
+	packed.Width = first->Width;
+	packed.Height = first->Height;
+	packed.SourceChannels = 3;
+	packed.Pixels.resize((size_t)packed.Width * packed.Height * 4);
+
+	// the constant channels (and opaque alpha) to start with
+	uint32_t fill = 0xFF000000u;
+	for (unsigned int m = 0; m < 3; m++)
+		if (!maps[m]) fill |= (uint32_t)constants[m] << (m * 8);
+	__m128i base = _mm_set1_epi32((int)fill);
+	__m128i mask = _mm_set1_epi32(0xFF);
+
+	size_t pixels = (size_t)packed.Width * packed.Height;
+	size_t i = 0;
+	for (; i + 4 <= pixels; i += 4) {
+		// each map's red byte, moved over to its own channel
+		__m128i v = base;
+		for (unsigned int m = 0; m < 3; m++) {
+			if (!maps[m]) continue;
+			__m128i red = _mm_and_si128(_mm_loadu_si128((const __m128i*)&maps[m]->Pixels[i * 4]), mask);
+			if (m == 1) red = _mm_slli_epi32(red, 8);
+			if (m == 2) red = _mm_slli_epi32(red, 16);
+			v = _mm_or_si128(v, red);
+		}
+		_mm_storeu_si128((__m128i*)&packed.Pixels[i * 4], v);
+	}
+	for (; i < pixels; i++) {
+		uint32_t v = fill;
+		for (unsigned int m = 0; m < 3; m++)
+			if (maps[m]) v |= (uint32_t)maps[m]->Pixels[i * 4] << (m * 8);
+		memcpy(&packed.Pixels[i * 4], &v, 4);
+	}
+	return packed;
+}
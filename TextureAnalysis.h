@@ -0,0 +1,44 @@
+#pragma once
+
+#include "PngDecoder.h"
+
+// Smallest and largest value of each channel (RGBA)
+struct TextureChannelRange
+{
+	unsigned char Min[4];
+	unsigned char Max[4];
+};
+
+// --------------------------------------------------------
+// CPU-side checks and repacking of decoded 8 bit RGBA
+// images, 16 bytes (4 pixels) at a time with SSE2
+//
+// - Finds maps that are one value everywhere, so materials
+//   can use a constant instead of a texture
+// - Packs occlusion, roughness and metalness (each read
+//   from its map's red channel) into one ORM texture, so
+//   the shader samples once instead of two or three times
+// - Only depends on the standard library
+// --------------------------------------------------------
+class TextureAnalysis
+{
+public:
+	static TextureChannelRange GetRange(const DecodedImage& image);
+
+	// Average of each channel, 0-1
+	static void GetAverage(const DecodedImage& image, float* average);
+
+	/// <summary>
+	/// Whether the first channels never vary by more than tolerance
+	/// </summary>
+	/// <param name="value">the first channel's average (0-1), if it's uniform</param>
+	static bool IsUniform(const DecodedImage& image, unsigned int channels, unsigned int tolerance, float* value);
+
+	/// <summary>
+	/// Packs three single channel maps into R (occlusion), G (roughness) and B (metalness)
+	/// </summary>
+	/// <param name="maps">occlusion, roughness, metalness - null ones are filled with their constant</param>
+	/// <param name="constants">the value (0-255) of each missing map</param>
+	/// <returns>the packed image, or an empty one if the maps aren't all the same size</returns>
+	static DecodedImage PackORM(const DecodedImage* maps[3], const unsigned char constants[3]);
+};
@@ -0,0 +1,55 @@
+#include "TextureArrayPlanner.h"
+
+bool TextureArrayPlanner::Matches(const TextureArrayInput& a, const TextureArrayInput& b)
+{
+	return a.Width == b.Width && a.Height == b.Height && a.MipLevels == b.MipLevels && a.Format == b.Format;
+}
+
+TextureArrayPlan TextureArrayPlanner::Plan(const std::vector<std::vector<TextureArrayInput>>& materials,
+	unsigned int maxLayers, unsigned int minMaterials)
+{
+	TextureArrayPlan plan = {};
+	plan.Placements.assign(materials.size(), { -1, 0 });
+	if (maxLayers == 0) return plan;
+
+	// group in input order, so layers follow the materials' order
+	// (a set that fills up is closed, and a new one started)
+	std::vector<TextureArraySet> sets;
+	std::vector<bool> open;
+	for (unsigned int m = 0; m < materials.size(); m++) {
+		const std::vector<TextureArrayInput>& slots = materials[m];
+		if (slots.empty()) continue;
+
+		int found = -1;
+		for (unsigned int s = 0; s < sets.size() && found < 0; s++) {
+			if (!open[s] || sets[s].Slots.size() != slots.size()) continue;
+			bool same = true;
+			for (unsigned int i = 0; i < slots.size() && same; i++)
+				same = Matches(sets[s].Slots[i], slots[i]);
+			if (same) found = (int)s;
+		}
+		if (found < 0) {
+			sets.push_back({ slots, {} });
+			open.push_back(true);
+			found = (int)sets.size() - 1;
+		}
+
+		sets[found].Materials.push_back(m);
+		if (sets[found].Materials.size() >= maxLayers) open[found] = false;
+	}
+
+	// keep the sets worth keeping
+	for (auto& set : sets) {
+		if (set.Materials.size() < minMaterials) continue;
+
+		int index = (int)plan.Sets.size();
+		for (unsigned int layer = 0; layer < set.Materials.size(); layer++) {
+			plan.Placements[set.Materials[layer]] = { index, layer };
+			for (auto& slot : set.Slots)
+				plan.PackedBytes += (unsigned long long)slot.Width * slot.Height * 4;
+		}
+		plan.PackedMaterials += (unsigned int)set.Materials.size();
+		plan.Sets.push_back(set);
+	}
+	return plan;
+}
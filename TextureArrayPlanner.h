@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// What decides whether two textures can share an array
+// (Format is opaque here - a DXGI_FORMAT in practice)
+// --------------------------------------------------------
+struct TextureArrayInput
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int MipLevels;
+	unsigned int Format;
+};
+
+// --------------------------------------------------------
+// Materials that share one array per texture slot, each
+// on its own layer (its index in Materials)
+// --------------------------------------------------------
+struct TextureArraySet
+{
+	std::vector<TextureArrayInput> Slots;	// the layout of each slot's array
+	std::vector<unsigned int> Materials;	// indices into the planner's input
+};
+
+// Where a material ended up (Set is -1 if it wasn't packed)
+struct TextureArrayPlacement
+{
+	int Set;
+	unsigned int Layer;
+};
+
+struct TextureArrayPlan
+{
+	std::vector<TextureArraySet> Sets;
+	std::vector<TextureArrayPlacement> Placements;	// one per input material
+	unsigned int PackedMaterials;
+	unsigned long long PackedBytes;	// top mip bytes moved into arrays (at 4 bytes per texel)
+};
+
+// --------------------------------------------------------
+// Groups materials whose textures can live in arrays
+//
+// - Every material gives one texture per slot (albedo,
+//   normal, ...) in the same order
+// - Materials whose slots all match (size, mips and format,
+//   slot by slot) go in the same set, so one layer index
+//   picks all of a material's textures
+// - A set never holds more than maxLayers materials, and
+//   sets that would hold fewer than minMaterials aren't
+//   worth an array, so those materials are left alone
+// - Only depends on the standard library
+// --------------------------------------------------------
+class TextureArrayPlanner
+{
+public:
+	/// <summary>
+	/// Plans the arrays for a list of materials
+	/// </summary>
+	/// <param name="materials">each material's textures, one per slot (empty to leave a material out)</param>
+	/// <param name="maxLayers">most layers in one array (2048 in D3D11)</param>
+	/// <param name="minMaterials">fewest materials that make a set worthwhile</param>
+	static TextureArrayPlan Plan(const std::vector<std::vector<TextureArrayInput>>& materials,
+		unsigned int maxLayers = 2048, unsigned int minMaterials = 2);
+
+	static bool Matches(const TextureArrayInput& a, const TextureArrayInput& b);
+};
@@ -0,0 +1,185 @@
+#include "TextureCooker.h"
+#include "ImageDecoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+// --------------------------------------------------------
+// Choosing
+// --------------------------------------------------------
+std::string TextureCooker::GetSuffix(const std::string& path)
+{
+	std::string stem = std::filesystem::path(path).stem().string();
+	std::transform(stem.begin(), stem.end(), stem.begin(), [](unsigned char c) { return (char)tolower(c); });
+	size_t underscore = stem.rfind('_');
+	return underscore == std::string::npos ? stem : stem.substr(underscore + 1);
+}
+
+BlockFormat TextureCooker::ChooseFormat(const std::string& path, const DecodedImage& image, const TextureCookOptions& options)
+{
+	std::string suffix = GetSuffix(path);
+	if (suffix == "normal" || suffix == "normals")
+		return BlockFormatBC5;
+	if (suffix == "roughness" || suffix == "rough" || suffix == "metal" || suffix == "metalness" || suffix == "specular" || image.SourceChannels == 1)
+		return BlockFormatBC4;
+
+	bool opaque = true;
+	for (size_t i = 3; i < image.Pixels.size() && opaque; i += 4)
+		opaque = image.Pixels[i] == 255;
+	return (options.PreferBC1 && opaque) ? BlockFormatBC1 : BlockFormatBC7;
+}
+
+std::string TextureCooker::GetCookedPath(const std::string& path)
+{
+	return std::filesystem::path(path).replace_extension(".dds").string();
+}
+
+
+// --------------------------------------------------------
+// Mips
+// --------------------------------------------------------
+MipOptions TextureCooker::GetMipOptions(const std::string& path, const DecodedImage& image, MipFilter filter)
+{
+	static const char* data[] = { "normal", "normals", "roughness", "rough", "metal", "metalness", "specular", "orm", "ao", "occlusion", "height", "mask" };
+	std::string suffix = GetSuffix(path);
+
+	MipOptions options = {};
+	options.Filter = filter;
+	options.NormalMap = suffix == "normal" || suffix == "normals";
+	options.SRGB = image.SourceChannels >= 3 && std::find(std::begin(data), std::end(data), suffix) == std::end(data);
+	return options;
+}
+
+
+// --------------------------------------------------------
+// Quality
+// --------------------------------------------------------
+double TextureCooker::PSNR(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, unsigned int channels)
+{
+	double squared = 0;
+	size_t pixels = std::min(a.size(), b.size()) / 4;
+	for (size_t i = 0; i < pixels; i++) {
+		for (unsigned int c = 0; c < channels; c++) {
+			double d = (double)a[i * 4 + c] - b[i * 4 + c];
+			squared += d * d;
+		}
+	}
+	if (squared == 0 || pixels == 0) return 100.0;
+	double mse = squared / ((double)pixels * channels);
+	return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+
+// --------------------------------------------------------
+// DDS
+//
+// "DDS ", the 124 byte header (with the 32 byte pixel format
+// saying "DX10"), then the 20 byte DX10 header, then the data
+// --------------------------------------------------------
+bool TextureCooker::WriteDDS(const std::string& path, BlockFormat format, unsigned int width, unsigned int height,
+	const std::vector<std::vector<unsigned char>>& mips, std::string& error)
+{
+	static const uint32_t DXGIFormats[] = { 71, 80, 83, 98 };		// BC1, BC4, BC5, BC7 (all UNORM)
+
+	std::vector<uint32_t> header(1 + 31 + 5, 0);
+	header[0] = 0x20534444;			// "DDS "
+	header[1] = 124;
+	header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;		// caps, height, width, pixel format, mip count, linear size
+	header[3] = height;
+	header[4] = width;
+	header[5] = mips.empty() ? 0 : (uint32_t)mips[0].size();
+	header[7] = (uint32_t)mips.size();
+	header[19] = 32;				// pixel format size
+	header[20] = 0x4;				// fourCC
+	header[21] = 0x30315844;		// "DX10"
+	header[27] = 0x1000 | 0x400000 | 0x8;		// texture, mipmap, complex
+	header[32] = DXGIFormats[format];
+	header[33] = 3;					// 2D
+	header[35] = 1;					// array size
+
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write((const char*)header.data(), header.size() * sizeof(uint32_t));
+	for (auto& mip : mips)
+		out.write((const char*)mip.data(), mip.size());
+	if (!out) {
+		error = "couldn't write " + path;
+		return false;
+	}
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Cooking
+// --------------------------------------------------------
+TextureCookResult TextureCooker::Cook(const std::string& path, const TextureCookOptions& options, ThreadPool* pool)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	TextureCookResult result = {};
+	result.Source = path;
+	result.Output = GetCookedPath(path);
+
+	auto start = Clock::now();
+	DecodedImage image;
+	if (!ImageDecoder::DecodeFile(path, image, result.Error))
+		return result;
+	std::error_code ec;
+	result.SourceBytes = (size_t)std::filesystem::file_size(path, ec);
+	result.Width = image.Width;
+	result.Height = image.Height;
+	result.Format = ChooseFormat(path, image, options);
+
+	auto decoded = Clock::now();
+	MipOptions mipOptions = GetMipOptions(path, image, options.Filter);
+	mipOptions.AlphaCutoff = options.AlphaCutoff;
+	MipChain chain = MipGenerator::Generate(image, mipOptions, pool);
+
+	// roughness gets its normal map's variance folded in, when there's one beside it
+	std::string suffix = GetSuffix(path);
+	if (suffix == "roughness" || suffix == "rough") {
+		std::filesystem::path file = path;
+		std::string stem = file.stem().string();
+		std::string prefix = stem.substr(0, stem.size() - suffix.size());
+		for (const char* name : { "normals", "normal" }) {
+			DecodedImage normals;
+			std::string ignored;
+			std::string normalPath = (file.parent_path() / (prefix + name + file.extension().string())).string();
+			if (!ImageDecoder::DecodeFile(normalPath, normals, ignored) || normals.Width != image.Width || normals.Height != image.Height)
+				continue;
+			MipGenerator::AdjustRoughness(chain.Levels, MipGenerator::Generate(normals, GetMipOptions(normalPath, normals, options.Filter), pool));
+			result.RoughnessAdjusted = true;
+			break;
+		}
+	}
+	auto mipped = Clock::now();
+
+	std::vector<std::vector<unsigned char>> mips;
+	mips.push_back(BlockCompression::Compress(result.Format, image.Pixels.data(), image.Width, image.Height, pool));
+	result.Megapixels = (double)image.Width * image.Height;
+	for (auto& mip : chain.Levels) {
+		mips.push_back(BlockCompression::Compress(result.Format, mip.Pixels.data(), mip.Width, mip.Height, pool));
+		result.Megapixels += (double)mip.Width * mip.Height;
+	}
+	result.Megapixels /= 1000000.0;
+	auto encoded = Clock::now();
+
+	result.DecodeMs = ms(start, decoded);
+	result.MipMs = ms(decoded, mipped);
+	result.EncodeMs = ms(mipped, encoded);
+	result.MipLevels = (unsigned int)mips.size();
+	result.PSNR = PSNR(image.Pixels, BlockCompression::Decompress(result.Format, mips[0].data(), image.Width, image.Height),
+		BlockCompression::GetChannelCount(result.Format));
+
+	if (!WriteDDS(result.Output, result.Format, image.Width, image.Height, mips, result.Error))
+		return result;
+	result.OutputBytes = (size_t)std::filesystem::file_size(result.Output, ec);
+	result.Succeeded = true;
+	return result;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BlockCompression.h"
+#include "MipGenerator.h"
+#include "PngDecoder.h"
+
+class ThreadPool;
+
+struct TextureCookOptions
+{
+	bool PreferBC1;		// BC1 instead of BC7 for color textures without alpha
+	MipFilter Filter;
+	float AlphaCutoff;	// alpha tested textures keep their coverage in every mip, 0 for off
+};
+
+// --------------------------------------------------------
+// What cooking one texture did, and how well
+// --------------------------------------------------------
+struct TextureCookResult
+{
+	bool Succeeded;
+	std::string Error;
+	std::string Source;
+	std::string Output;
+	BlockFormat Format;
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int MipLevels;
+	bool RoughnessAdjusted;		// roughness widened by its normal map's variance (Toksvig)
+	double PSNR;				// top mip, over the channels the format keeps (dB)
+	double DecodeMs;
+	double MipMs;
+	double EncodeMs;
+	double Megapixels;			// every mip
+	size_t SourceBytes;
+	size_t OutputBytes;
+};
+
+// --------------------------------------------------------
+// Turns PNGs and JPEGs into block compressed DDS files with full mip
+// chains, written next to them as <name>.dds
+//
+// - The format comes from the file name's last _suffix:
+//   normals are BC5 (X and Y, Z is rebuilt in the shader),
+//   roughness, metal and specular maps (and anything gray)
+//   are BC4, and the rest is BC7 (or BC1)
+// - Mips come from MipGenerator: color in linear, normal
+//   maps renormalized at every level, and roughness maps
+//   widened where the normal map next to them (same name,
+//   _normals, same extension) gets bumpy
+// - Only depends on the standard library, so it can run as
+//   a command line tool anywhere (see Tools/)
+// --------------------------------------------------------
+class TextureCooker
+{
+public:
+	/// <summary>
+	/// Picks the format for a texture from its path and contents
+	/// </summary>
+	static BlockFormat ChooseFormat(const std::string& path, const DecodedImage& image, const TextureCookOptions& options);
+
+	// Where a texture's cooked version goes (same place, .dds extension)
+	static std::string GetCookedPath(const std::string& path);
+
+	// The file name's last _suffix, lower case (the whole name if there's no _)
+	static std::string GetSuffix(const std::string& path);
+
+	/// <summary>
+	/// How a texture's mips should be filtered, from its name and contents:
+	/// normal maps as vectors, gray and data maps as they are, the rest as sRGB
+	/// </summary>
+	static MipOptions GetMipOptions(const std::string& path, const DecodedImage& image, MipFilter filter = MipFilterKaiser);
+
+	// Peak signal to noise ratio over the first channels (100 if identical)
+	static double PSNR(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, unsigned int channels);
+
+	/// <summary>
+	/// Writes a DDS with a DX10 header (one 2D texture, mips largest first)
+	/// </summary>
+	static bool WriteDDS(const std::string& path, BlockFormat format, unsigned int width, unsigned int height,
+		const std::vector<std::vector<unsigned char>>& mips, std::string& error);
+
+	/// <summary>
+	/// Cooks one PNG or JPEG
+	/// </summary>
+	/// <param name="pool">compresses rows of blocks in parallel, or null for this thread only</param>
+	static TextureCookResult Cook(const std::string& path, const TextureCookOptions& options, ThreadPool* pool);
+};
@@ -0,0 +1,149 @@
+#include "TextureLoadPipeline.h"
+#include "ContentHash.h"
+#include "ImageDecoder.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double Milliseconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	// What the stages share, all behind the one mutex
+	struct PipelineState
+	{
+		std::mutex lock;
+		std::condition_variable room;		// reading can go on
+		std::condition_variable ready;		// something finished decoding
+		std::deque<std::shared_ptr<TextureLoadResult>> finished;
+		size_t bytesInFlight;
+		unsigned int filesInFlight;
+		TextureLoadStats stats;
+	};
+}
+
+TextureLoadStats TextureLoadPipeline::Run(ThreadPool& pool, const std::vector<std::wstring>& paths, size_t maxBytesInFlight,
+	const TextureCreateFunction& create)
+{
+	Clock::time_point start = Clock::now();
+	PipelineState state;
+	state.bytesInFlight = 0;
+	state.filesInFlight = 0;
+	state.stats = {};
+	state.stats.Files = (unsigned int)paths.size();
+
+	// hands a result (decoded or not) over to the creating thread
+	auto finish = [&state](std::shared_ptr<TextureLoadResult> result, size_t bytesBefore, size_t bytesAfter, double decodeMs) {
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.bytesInFlight = state.bytesInFlight - bytesBefore + bytesAfter;
+		state.stats.PeakBytesInFlight = std::max(state.stats.PeakBytesInFlight, state.bytesInFlight);
+		state.stats.DecodeMs += decodeMs;
+		state.finished.push_back(result);
+		state.ready.notify_one();
+	};
+
+	std::thread reader([&]() {
+		for (unsigned int i = 0; i < paths.size(); i++) {
+			{
+				// back-pressure: wait for the creating thread to free some memory
+				std::unique_lock<std::mutex> guard(state.lock);
+				if (state.bytesInFlight >= maxBytesInFlight && state.filesInFlight > 0) state.stats.Stalls++;
+				state.room.wait(guard, [&]() { return state.bytesInFlight < maxBytesInFlight || state.filesInFlight == 0; });
+				state.filesInFlight++;
+			}
+
+			Clock::time_point readStart = Clock::now();
+			std::shared_ptr<TextureLoadResult> result = std::make_shared<TextureLoadResult>();
+			result->Index = i;
+			std::filesystem::path path = paths[i];
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (file) {
+				std::streamoff size = file.tellg();
+				file.seekg(0);
+				result->Contents.resize((size_t)size);
+				if (size > 0 && !file.read((char*)result->Contents.data(), size))
+					result->Contents.clear();
+			}
+			result->FileBytes = result->Contents.size();
+			double readMs = Milliseconds(readStart);
+
+			// an image is charged for its pixels as soon as it's read, so decoding
+			// it never pushes what's in flight over what reading already allowed
+			// (sizes the decoders would refuse count as nothing, since they will)
+			size_t bytes = result->FileBytes;
+			unsigned int width = 0, height = 0;
+			if (ImageDecoder::ReadSize(result->Contents.data(), result->Contents.size(), width, height) &&
+				width <= 32768 && height <= 32768)
+				bytes += (size_t)width * height * 4;
+			{
+				std::lock_guard<std::mutex> guard(state.lock);
+				state.stats.ReadMs += readMs;
+				state.stats.BytesRead += result->FileBytes;
+				state.bytesInFlight += bytes;
+				state.stats.PeakBytesInFlight = std::max(state.stats.PeakBytesInFlight, state.bytesInFlight);
+			}
+			if (!file || bytes == 0) {
+				result->Error = "couldn't read the file";
+				finish(result, bytes, 0, 0);
+				continue;
+			}
+
+			// decode (and hash) on the pool - whatever ImageDecoder
+			// recognizes by its first bytes, whatever the extension
+			pool.Submit([result, bytes, finish]() {
+				Clock::time_point decodeStart = Clock::now();
+				result->Hash = ContentHash::Hash64(result->Contents.data(), result->Contents.size());
+				result->Succeeded = true;
+				if (ImageDecoder::CanDecode(result->Contents.data(), result->Contents.size())) {
+					result->Succeeded = ImageDecoder::Decode(result->Contents.data(), result->Contents.size(), result->Image, result->Error);
+					result->Contents = std::vector<unsigned char>();
+				}
+				finish(result, bytes, result->Contents.size() + result->Image.Pixels.size(), Milliseconds(decodeStart));
+			});
+		}
+	});
+
+	// create everything on this thread, as it comes in
+	for (unsigned int created = 0; created < paths.size(); created++) {
+		std::shared_ptr<TextureLoadResult> result;
+		{
+			Clock::time_point waitStart = Clock::now();
+			std::unique_lock<std::mutex> guard(state.lock);
+			state.ready.wait(guard, [&]() { return !state.finished.empty(); });
+			result = state.finished.front();
+			state.finished.pop_front();
+			state.stats.WaitMs += Milliseconds(waitStart);
+		}
+
+		size_t bytes = result->Contents.size() + result->Image.Pixels.size();
+		bool failed = !result->Succeeded;
+		Clock::time_point createStart = Clock::now();
+		create(*result);
+		double createMs = Milliseconds(createStart);
+		result.reset();
+
+		std::lock_guard<std::mutex> guard(state.lock);
+		state.stats.CreateMs += createMs;
+		if (failed) state.stats.Failed++;
+		state.bytesInFlight -= bytes;
+		state.filesInFlight--;
+		state.room.notify_one();
+	}
+	reader.join();
+
+	state.stats.WallMs = Milliseconds(start);
+	return state.stats;
+}
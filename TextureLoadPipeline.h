@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "PngDecoder.h"
+
+class ThreadPool;
+
+// --------------------------------------------------------
+// One file that went through the pipeline
+// --------------------------------------------------------
+struct TextureLoadResult
+{
+	unsigned int Index;						// into the paths given to Run
+	bool Succeeded;
+	std::string Error;
+	unsigned long long Hash;				// XXH64 of the file (see ContentHash)
+	size_t FileBytes;
+	std::vector<unsigned char> Contents;	// the file itself, only kept when it isn't a PNG or JPEG
+	DecodedImage Image;						// the decoded pixels of a PNG or JPEG
+};
+
+struct TextureLoadStats
+{
+	unsigned int Files;
+	unsigned int Failed;
+	unsigned int Stalls;		// times reading waited for memory to be freed
+	double WallMs;				// first read to last create
+	double ReadMs;				// the reading thread
+	double DecodeMs;			// summed over every worker
+	double CreateMs;			// the calling thread, in create
+	double WaitMs;				// the calling thread, waiting for something to create
+	size_t BytesRead;
+	size_t PeakBytesInFlight;	// read or decoded, but not created yet (pixels counted from the read)
+};
+
+// Called on Run's thread for each file as it's ready (in whatever order they finish)
+typedef std::function<void(TextureLoadResult& result)> TextureCreateFunction;
+
+// --------------------------------------------------------
+// Loads a batch of textures in three overlapping stages
+//
+// - Read: one thread reads the files in order, each with a
+//   single read of the whole file
+// - Decode: PNGs and JPEGs are decoded with ImageDecoder
+//   (and every file hashed) on the thread pool
+// - Create: finished files go back to the calling thread,
+//   the one that owns the device, as they come in
+// - Reading stops once maxBytesInFlight of files and pixels
+//   are waiting, and picks up again as they're created.  A
+//   file's pixels count from when it's read (its header
+//   gives the size), so peak memory stays under that budget
+//   plus one file and its pixels (one file is always let
+//   through, however large)
+// - Only depends on the standard library
+// --------------------------------------------------------
+class TextureLoadPipeline
+{
+public:
+	/// <summary>
+	/// Loads every path, calling create for each before returning
+	/// </summary>
+	/// <param name="maxBytesInFlight">memory budget for files and pixels waiting to be created</param>
+	static TextureLoadStats Run(ThreadPool& pool, const std::vector<std::wstring>& paths, size_t maxBytesInFlight,
+		const TextureCreateFunction& create);
+};
@@ -0,0 +1,221 @@
+#include "TextureRegistry.h"
+#include "ContentHash.h"
+#include "ImageDecoder.h"
+#include "TextureStreaming.h"
+#include "WICTextureLoader.h"
+#include "DDSTextureLoader.h"
+
+#include <chrono>
+#include <filesystem>
+
+TextureRegistry::TextureRegistry(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) :
+	device(device),
+	context(context)
+{
+	stats = {};
+}
+
+
+// --------------------------------------------------------
+// Acquiring and releasing
+// --------------------------------------------------------
+std::wstring TextureRegistry::GetLoadPath(const std::wstring& path)
+{
+	std::filesystem::path cooked = path;
+	cooked.replace_extension(L".dds");
+	std::error_code ec;
+	return std::filesystem::exists(cooked, ec) ? cooked.wstring() : path;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureRegistry::Find(const std::wstring& path)
+{
+	// the same file under any spelling of its path
+	auto found = byPath.find(std::filesystem::path(path).lexically_normal().wstring());
+	if (found == byPath.end()) return 0;
+
+	stats.Requests++;
+	stats.PathHits++;
+	records[found->second].References++;
+	return records[found->second].SRV;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureRegistry::Acquire(const std::wstring& path)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv = Find(path);
+	if (srv) return srv;
+
+	// the cooked texture is what gets hashed (and loaded), when there is one
+	auto start = Clock::now();
+	TextureLoadResult loaded = {};
+	loaded.Succeeded = ContentHash::HashFile(GetLoadPath(path), loaded.Contents, loaded.Hash);
+	loaded.FileBytes = loaded.Contents.size();
+	stats.HashMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	return Acquire(path, loaded);
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureRegistry::Acquire(const std::wstring& path, const TextureLoadResult& loaded)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv = Find(path);
+	if (srv) return srv;
+
+	stats.Requests++;
+	if (!loaded.Succeeded) {
+		stats.Failed++;
+		return 0;
+	}
+
+	// different path, same bytes
+	std::wstring key = std::filesystem::path(path).lexically_normal().wstring();
+	auto same = byHash.find(loaded.Hash);
+	if (same != byHash.end() && records[same->second].FileBytes == loaded.FileBytes) {
+		TextureRecord& r = records[same->second];
+		stats.ContentHits++;
+		stats.GpuBytesSaved += r.GpuBytes;
+		r.Aliases.push_back(key);
+		r.References++;
+		byPath[key] = same->second;
+		return r.SRV;
+	}
+
+	TextureRecord r = {};
+	r.Path = key;
+	r.Hash = loaded.Hash;
+	r.FileBytes = loaded.FileBytes;
+	r.References = 1;
+	r.Cooked = GetLoadPath(path) != path;
+
+	// decoded pixels (already, or now by ImageDecoder), a cooked .dds,
+	// or as a last resort anything else WIC can read
+	auto start = Clock::now();
+	HRESULT hr = E_FAIL;
+	DecodedImage decoded;
+	std::string error;
+	const DecodedImage* image = loaded.Image.Pixels.empty() ? 0 : &loaded.Image;
+	if (!image && !r.Cooked && ImageDecoder::CanDecode(loaded.Contents.data(), loaded.Contents.size()) &&
+		ImageDecoder::Decode(loaded.Contents.data(), loaded.Contents.size(), decoded, error))
+		image = &decoded;
+
+	if (image) {
+		r.SRV = CreateFromPixels(path, *image);
+		hr = r.SRV ? S_OK : E_FAIL;
+	}
+	else if (r.Cooked)
+		hr = DirectX::CreateDDSTextureFromMemory(device.Get(), loaded.Contents.data(), loaded.Contents.size(), 0, r.SRV.GetAddressOf());
+	else
+		hr = DirectX::CreateWICTextureFromMemory(device.Get(), context.Get(), loaded.Contents.data(), loaded.Contents.size(), 0, r.SRV.GetAddressOf());
+	stats.CreateMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	if (FAILED(hr)) {
+		stats.Failed++;
+		return 0;
+	}
+
+	r.GpuBytes = GetGpuBytes(r.SRV.Get());
+	stats.Loads++;
+	stats.GpuBytes += r.GpuBytes;
+	byPath[key] = records.size();
+	byHash[r.Hash] = records.size();
+	records.push_back(r);
+	return records.back().SRV;
+}
+
+// --------------------------------------------------------
+// Makes a texture (with a full mip chain, filtered on the
+// CPU by MipGenerator so color is averaged in linear and
+// normals stay unit length) out of decoded pixels - one
+// channel images become R8
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureRegistry::CreateFromPixels(const std::wstring& path, const DecodedImage& image)
+{
+	TextureMips mips = {};
+	unsigned int levels = TextureMipReader::CountMips(image.Width, image.Height);
+	TextureMipReader::FromImage(image, TextureMipReader::GetMipOptions(path, image), 0, levels, mips);
+
+	std::vector<D3D11_SUBRESOURCE_DATA> data(levels);
+	for (unsigned int mip = 0; mip < levels; mip++) {
+		data[mip].pSysMem = mips.Levels[mip].data();
+		data[mip].SysMemPitch = TextureMipReader::GetRowPitch(mips.Format, mips.Width, mip);
+	}
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = image.Width;
+	desc.Height = image.Height;
+	desc.MipLevels = levels;
+	desc.ArraySize = 1;
+	desc.Format = (DXGI_FORMAT)mips.Format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(device->CreateTexture2D(&desc, data.data(), texture.GetAddressOf())) ||
+		FAILED(device->CreateShaderResourceView(texture.Get(), 0, srv.GetAddressOf())))
+		return 0;
+	return srv;
+}
+
+void TextureRegistry::Release(ID3D11ShaderResourceView* srv)
+{
+	for (size_t i = 0; i < records.size(); i++) {
+		TextureRecord& r = records[i];
+		if (!srv || r.SRV.Get() != srv) continue;
+		if (--r.References > 0) return;
+
+		// the record stays (for the accounting), but can't be found anymore
+		byPath.erase(r.Path);
+		for (auto& alias : r.Aliases) byPath.erase(alias);
+		byHash.erase(r.Hash);
+		stats.GpuBytes -= r.GpuBytes;
+		r.SRV.Reset();
+		return;
+	}
+}
+
+
+// --------------------------------------------------------
+// Accounting
+// --------------------------------------------------------
+size_t TextureRegistry::GetGpuBytes(ID3D11ShaderResourceView* srv)
+{
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	srv->GetResource(resource.GetAddressOf());
+	if (FAILED(resource.As(&texture))) return 0;
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+
+	// block compressed formats are counted in 4x4 blocks, the rest in texels
+	size_t blockBytes = 0, texelBytes = 4;
+	switch (desc.Format) {
+	case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB: case DXGI_FORMAT_BC4_UNORM: case DXGI_FORMAT_BC4_SNORM:
+		blockBytes = 8; break;
+	case DXGI_FORMAT_BC2_UNORM: case DXGI_FORMAT_BC2_UNORM_SRGB: case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM: case DXGI_FORMAT_BC5_SNORM: case DXGI_FORMAT_BC6H_UF16: case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_UNORM: case DXGI_FORMAT_BC7_UNORM_SRGB:
+		blockBytes = 16; break;
+	case DXGI_FORMAT_R8_UNORM: case DXGI_FORMAT_A8_UNORM:
+		texelBytes = 1; break;
+	case DXGI_FORMAT_R8G8_UNORM: case DXGI_FORMAT_R16_UNORM: case DXGI_FORMAT_R16_FLOAT:
+		texelBytes = 2; break;
+	case DXGI_FORMAT_R16G16B16A16_UNORM: case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		texelBytes = 8; break;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		texelBytes = 16; break;
+	default:
+		break;
+	}
+
+	size_t bytes = 0;
+	for (unsigned int mip = 0; mip < desc.MipLevels; mip++) {
+		size_t w = desc.Width >> mip, h = desc.Height >> mip;
+		if (w == 0) w = 1;
+		if (h == 0) h = 1;
+		bytes += blockBytes ? ((w + 3) / 4) * ((h + 3) / 4) * blockBytes : w * h * texelBytes;
+	}
+	return bytes * desc.ArraySize;
+}
+
+const std::vector<TextureRecord>& TextureRegistry::GetRecords() { return records; }
+TextureRegistryStats TextureRegistry::GetStats() { return stats; }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "TextureLoadPipeline.h"
+
+// --------------------------------------------------------
+// One texture the registry has loaded
+// --------------------------------------------------------
+struct TextureRecord
+{
+	std::wstring Path;					// the first path it was loaded from
+	std::vector<std::wstring> Aliases;	// other paths that turned out to hold the same bytes
+	unsigned long long Hash;			// of the file's contents
+	size_t FileBytes;
+	size_t GpuBytes;					// every mip
+	unsigned int References;
+	bool Cooked;						// came from the .dds next to Path
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;	// null once released
+};
+
+struct TextureRegistryStats
+{
+	unsigned int Requests;		// calls to Acquire
+	unsigned int PathHits;		// a path it had already loaded
+	unsigned int ContentHits;	// a new path with the same bytes as a loaded one
+	unsigned int Loads;			// actually created on the GPU
+	unsigned int Failed;
+	size_t GpuBytes;			// live textures
+	size_t GpuBytesSaved;		// what the content hits would have cost
+	double HashMs;				// reading and hashing files
+	double CreateMs;			// decoding and creating textures
+};
+
+// --------------------------------------------------------
+// Loads textures once and hands out shared SRVs
+//
+// - Paths are looked up first (normalized), then the file's
+//   contents by XXH64 hash, so the same image stored under
+//   two names is only decoded and uploaded once
+// - A cooked .dds next to a texture (see TextureCooker) is
+//   used instead of it when there is one
+// - PNGs and JPEGs are decoded with ImageDecoder; WIC is
+//   only left for any other format it happens to read
+// - Files can also come already read and decoded (see
+//   TextureLoadPipeline), so only creation is left here
+// - Every Acquire is a reference, and a texture's SRV is
+//   dropped when its last one is released
+// --------------------------------------------------------
+class TextureRegistry
+{
+public:
+	TextureRegistry(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	/// <summary>
+	/// Gets a texture, loading it if nothing with the same path or contents is loaded
+	/// </summary>
+	/// <returns>the shared SRV, or null if it couldn't be loaded</returns>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Acquire(const std::wstring& path);
+
+	/// <summary>
+	/// Same, for a file TextureLoadPipeline already read (and decoded)
+	/// </summary>
+	/// <param name="loaded">the file at GetLoadPath(path)</param>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Acquire(const std::wstring& path, const TextureLoadResult& loaded);
+
+	/// <summary>
+	/// Gets a texture only if it's already loaded from this path
+	/// </summary>
+	/// <returns>the shared SRV (as one more reference), or null</returns>
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Find(const std::wstring& path);
+
+	// The file that's actually loaded for a path (its cooked .dds, if there is one)
+	static std::wstring GetLoadPath(const std::wstring& path);
+
+	/// <summary>
+	/// Gives back one reference to a texture from Acquire
+	/// </summary>
+	void Release(ID3D11ShaderResourceView* srv);
+
+	// Bytes a texture takes on the GPU, every mip included
+	static size_t GetGpuBytes(ID3D11ShaderResourceView* srv);
+
+	const std::vector<TextureRecord>& GetRecords();
+	TextureRegistryStats GetStats();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	std::vector<TextureRecord> records;
+	std::unordered_map<std::wstring, size_t> byPath;			// every path and alias, into records
+	std::unordered_map<unsigned long long, size_t> byHash;
+	TextureRegistryStats stats;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateFromPixels(const std::wstring& path, const DecodedImage& image);
+};
@@ -0,0 +1,385 @@
+#include "TextureStreaming.h"
+#include "ImageDecoder.h"
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	// Where a .dds's levels start, and what's in them
+	struct DDSLayout
+	{
+		unsigned int Width;
+		unsigned int Height;
+		unsigned int MipLevels;
+		unsigned int Format;
+		size_t DataOffset;
+	};
+
+	uint32_t ReadU32(const unsigned char* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+	// The 4 byte magic, the 124 byte header, and the 20 byte DX10 header if there is one
+	const size_t DDSHeaderBytes = 4 + 124;
+	const size_t DDSHeaderBytesDX10 = DDSHeaderBytes + 20;
+
+	bool ParseDDS(const unsigned char* data, size_t size, DDSLayout& layout, std::string& error)
+	{
+		if (size < DDSHeaderBytes || ReadU32(data) != 0x20534444 || ReadU32(data + 4) != 124) {
+			error = "not a DDS file";
+			return false;
+		}
+		layout.Height = ReadU32(data + 12);
+		layout.Width = ReadU32(data + 16);
+		layout.MipLevels = std::max(1u, ReadU32(data + 28));
+		layout.DataOffset = DDSHeaderBytes;
+
+		uint32_t fourCC = ReadU32(data + 84);
+		switch (fourCC) {
+		case 0x30315844:	// "DX10"
+			if (size < DDSHeaderBytesDX10) {
+				error = "DDS file ends in its header";
+				return false;
+			}
+			layout.Format = ReadU32(data + 128);
+			layout.DataOffset = DDSHeaderBytesDX10;
+			break;
+		case 0x31545844: layout.Format = TextureMipReader::FormatBC1; break;		// "DXT1"
+		case 0x31495441: case 0x55344342: layout.Format = TextureMipReader::FormatBC4; break;		// "ATI1", "BC4U"
+		case 0x32495441: case 0x55354342: layout.Format = TextureMipReader::FormatBC5; break;		// "ATI2", "BC5U"
+		default:
+			layout.Format = 0;
+			break;
+		}
+		if (TextureMipReader::GetMipBytes(layout.Format, layout.Width, layout.Height, 0) == 0) {
+			error = "unsupported DDS format";
+			return false;
+		}
+		return true;
+	}
+
+	// Which levels to hand back, and where the first of them starts in the file
+	void PrepareLevels(const DDSLayout& layout, unsigned int firstMip, unsigned int& count, size_t& offset, TextureMips& mips)
+	{
+		firstMip = std::min(firstMip, layout.MipLevels - 1);
+		count = std::min(count, layout.MipLevels - firstMip);
+		offset = layout.DataOffset;
+		for (unsigned int mip = 0; mip < firstMip; mip++)
+			offset += TextureMipReader::GetMipBytes(layout.Format, layout.Width, layout.Height, mip);
+
+		mips.Width = layout.Width;
+		mips.Height = layout.Height;
+		mips.MipLevels = layout.MipLevels;
+		mips.Format = layout.Format;
+		mips.FirstMip = firstMip;
+		mips.Levels.assign(count, {});
+		for (unsigned int i = 0; i < count; i++)
+			mips.Levels[i].resize(TextureMipReader::GetMipBytes(layout.Format, layout.Width, layout.Height, firstMip + i));
+	}
+}
+
+
+// --------------------------------------------------------
+// Sizes
+// --------------------------------------------------------
+size_t TextureMipReader::GetMipBytes(unsigned int format, unsigned int width, unsigned int height, unsigned int mip)
+{
+	size_t w = std::max(1u, width >> mip), h = std::max(1u, height >> mip);
+	switch (format) {
+	case FormatBC1: case FormatBC4: return ((w + 3) / 4) * ((h + 3) / 4) * 8;
+	case FormatBC5: case FormatBC7: return ((w + 3) / 4) * ((h + 3) / 4) * 16;
+	case FormatRGBA8: return w * h * 4;
+	case FormatR8: return w * h;
+	default: return 0;
+	}
+}
+
+unsigned int TextureMipReader::GetRowPitch(unsigned int format, unsigned int width, unsigned int mip)
+{
+	unsigned int w = std::max(1u, width >> mip);
+	switch (format) {
+	case FormatBC1: case FormatBC4: return ((w + 3) / 4) * 8;
+	case FormatBC5: case FormatBC7: return ((w + 3) / 4) * 16;
+	case FormatRGBA8: return w * 4;
+	default: return w;
+	}
+}
+
+unsigned int TextureMipReader::CountMips(unsigned int width, unsigned int height)
+{
+	unsigned int levels = 1;
+	while ((width >> levels) > 0 || (height >> levels) > 0) levels++;
+	return levels;
+}
+
+
+// --------------------------------------------------------
+// Reading
+// --------------------------------------------------------
+bool TextureMipReader::ReadDDS(const unsigned char* data, size_t size, unsigned int firstMip, unsigned int count, TextureMips& mips, std::string& error)
+{
+	DDSLayout layout;
+	if (!ParseDDS(data, size, layout, error)) return false;
+
+	size_t offset;
+	PrepareLevels(layout, firstMip, count, offset, mips);
+	for (auto& level : mips.Levels) {
+		if (offset + level.size() > size) {
+			error = "DDS file is missing mips";
+			return false;
+		}
+		memcpy(level.data(), data + offset, level.size());
+		offset += level.size();
+	}
+	return true;
+}
+
+void TextureMipReader::FromImage(const DecodedImage& image, const MipOptions& options, unsigned int firstMip, unsigned int count, TextureMips& mips)
+{
+	bool gray = image.SourceChannels == 1;
+	mips.Width = image.Width;
+	mips.Height = image.Height;
+	mips.MipLevels = CountMips(image.Width, image.Height);
+	mips.Format = gray ? FormatR8 : FormatRGBA8;
+	mips.FirstMip = std::min(firstMip, mips.MipLevels - 1);
+	count = std::min(count, mips.MipLevels - mips.FirstMip);
+	mips.Levels.assign(count, {});
+
+	// the chain starts at mip 1, and nothing smaller than what's wanted is thrown away
+	MipChain chain;
+	if (mips.FirstMip + count > 1)
+		chain = MipGenerator::Generate(image, options, 0);
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int mip = mips.FirstMip + i;
+		const std::vector<unsigned char>& pixels = mip == 0 ? image.Pixels : chain.Levels[mip - 1].Pixels;
+		if (!gray) {
+			mips.Levels[i] = pixels;
+			continue;
+		}
+		mips.Levels[i].resize(pixels.size() / 4);
+		for (size_t p = 0; p < mips.Levels[i].size(); p++) mips.Levels[i][p] = pixels[p * 4];
+	}
+}
+
+bool TextureMipReader::ReadFile(const std::wstring& path, unsigned int firstMip, unsigned int count, TextureMips& mips, std::string& error)
+{
+	std::filesystem::path file = path;
+	std::ifstream in(file, std::ios::binary);
+	if (!in) {
+		error = "couldn't open " + file.filename().string();
+		return false;
+	}
+
+	// a .png or .jpg has to be decoded whole
+	if (file.extension() != L".dds") {
+		std::vector<unsigned char> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		DecodedImage image;
+		if (!ImageDecoder::Decode(contents.data(), contents.size(), image, error)) return false;
+		FromImage(image, GetMipOptions(path, image), firstMip, count, mips);
+		return true;
+	}
+
+	// a .dds only needs its header and the levels asked for
+	unsigned char header[DDSHeaderBytesDX10] = {};
+	in.read((char*)header, sizeof(header));
+	DDSLayout layout;
+	if (!ParseDDS(header, (size_t)in.gcount(), layout, error)) return false;
+
+	size_t offset;
+	PrepareLevels(layout, firstMip, count, offset, mips);
+	in.clear();
+	in.seekg(offset);
+	for (auto& level : mips.Levels)
+		in.read((char*)level.data(), level.size());
+	if (!in) {
+		error = file.filename().string() + " is missing mips";
+		return false;
+	}
+	return true;
+}
+
+MipOptions TextureMipReader::GetMipOptions(const std::wstring& path, const DecodedImage& image)
+{
+	return TextureCooker::GetMipOptions(std::filesystem::path(path).filename().string(), image);
+}
+
+
+// --------------------------------------------------------
+// Residency
+// --------------------------------------------------------
+TextureResidency::TextureResidency(size_t budgetBytes, unsigned int maxLoadsInFlight) :
+	frame(0),
+	budget(budgetBytes),
+	committed(0),
+	maxLoadsInFlight(std::max(1u, maxLoadsInFlight))
+{
+	stats = {};
+}
+
+unsigned int TextureResidency::Add(const std::vector<size_t>& mipBytes, unsigned int tailMip)
+{
+	Entry e = {};
+	e.MipBytes = mipBytes;
+	e.TailMip = std::min(tailMip, (unsigned int)mipBytes.size() - 1);
+	e.Resident = e.Wanted = e.LoadingMip = e.TailMip;
+	committed += BytesFrom(e, e.Resident);
+	entries.push_back(e);
+	return (unsigned int)entries.size() - 1;
+}
+
+float TextureResidency::GetDesiredMip(unsigned int textureSize, float uvRepeat, float worldRadius, float distance,
+	float projectionScale, float viewportHeight)
+{
+	// inside (or touching) the bounds, it could fill the screen
+	if (distance <= 0.0f || worldRadius <= 0.0f) return 0.0f;
+
+	// the bounds' diameter on screen, against the texels stretched across it
+	float pixels = worldRadius * projectionScale * viewportHeight / distance;
+	float texels = textureSize * std::max(uvRepeat, 1e-3f);
+	return pixels <= 0.0f ? 0.0f : std::max(0.0f, log2f(texels / pixels));
+}
+
+void TextureResidency::BeginFrame()
+{
+	frame++;
+	for (auto& e : entries) e.Wanted = e.TailMip;
+	stats.Visible = 0;
+	stats.Deferred = 0;
+}
+
+void TextureResidency::Request(unsigned int texture, float mip)
+{
+	Entry& e = entries[texture];
+	unsigned int level = (unsigned int)std::max(0.0f, floorf(mip));
+	e.Wanted = std::min(e.Wanted, std::min(level, e.TailMip));
+	if (e.LastUsed != frame) stats.Visible++;
+	e.LastUsed = frame;
+}
+
+size_t TextureResidency::BytesFrom(const Entry& e, unsigned int mip)
+{
+	size_t bytes = 0;
+	for (unsigned int i = mip; i < e.MipBytes.size(); i++) bytes += e.MipBytes[i];
+	return bytes;
+}
+
+void TextureResidency::Evict(size_t bytes, unsigned int except, std::vector<TextureResidencyChange>& changes)
+{
+	// anything holding finer levels than it was asked for this frame,
+	// the longest unused first (textures nobody asked for want their tail)
+	std::vector<unsigned int> victims;
+	for (unsigned int i = 0; i < entries.size(); i++)
+		if (i != except && !entries[i].Loading && entries[i].Resident < entries[i].Wanted)
+			victims.push_back(i);
+	std::sort(victims.begin(), victims.end(), [&](unsigned int a, unsigned int b) {
+		return entries[a].LastUsed != entries[b].LastUsed ? entries[a].LastUsed < entries[b].LastUsed : a < b;
+	});
+
+	// finest levels go first, only as many as it takes
+	size_t freed = 0;
+	for (unsigned int v : victims) {
+		if (freed >= bytes) break;
+		Entry& e = entries[v];
+		while (e.Resident < e.Wanted && freed < bytes) {
+			freed += e.MipBytes[e.Resident];
+			committed -= e.MipBytes[e.Resident];
+			e.Resident++;
+		}
+		stats.Evictions++;
+		changes.push_back({ v, e.Resident, false });
+	}
+}
+
+std::vector<TextureResidencyChange> TextureResidency::Plan()
+{
+	std::vector<TextureResidencyChange> changes;
+
+	// the budget may have shrunk since the last frame
+	if (committed > budget)
+		Evict(committed - budget, (unsigned int)entries.size(), changes);
+
+	// furthest from what they want first, then the most recently used
+	std::vector<unsigned int> candidates;
+	for (unsigned int i = 0; i < entries.size(); i++)
+		if (!entries[i].Loading && !entries[i].Failed && entries[i].Wanted < entries[i].Resident)
+			candidates.push_back(i);
+	std::sort(candidates.begin(), candidates.end(), [&](unsigned int a, unsigned int b) {
+		unsigned int gapA = entries[a].Resident - entries[a].Wanted, gapB = entries[b].Resident - entries[b].Wanted;
+		if (gapA != gapB) return gapA > gapB;
+		return entries[a].LastUsed != entries[b].LastUsed ? entries[a].LastUsed > entries[b].LastUsed : a < b;
+	});
+
+	for (unsigned int c : candidates) {
+		if (stats.LoadsInFlight >= maxLoadsInFlight) break;
+		Entry& e = entries[c];
+		size_t resident = BytesFrom(e, e.Resident);
+		size_t wanted = BytesFrom(e, e.Wanted) - resident;
+		if (committed + wanted > budget)
+			Evict(committed + wanted - budget, c, changes);
+
+		// whatever's finest that fits now
+		unsigned int target = e.Wanted;
+		while (target < e.Resident && committed + BytesFrom(e, target) - resident > budget) target++;
+		if (target == e.Resident) {
+			stats.Deferred++;
+			continue;
+		}
+
+		size_t extra = BytesFrom(e, target) - resident;
+		e.Loading = true;
+		e.LoadingMip = target;
+		committed += extra;
+		stats.PendingBytes += extra;
+		stats.LoadsInFlight++;
+		stats.LoadsStarted++;
+		changes.push_back({ c, target, true });
+	}
+	return changes;
+}
+
+void TextureResidency::Finish(unsigned int texture, bool succeeded)
+{
+	Entry& e = entries[texture];
+	if (!e.Loading) return;
+
+	size_t extra = BytesFrom(e, e.LoadingMip) - BytesFrom(e, e.Resident);
+	e.Loading = false;
+	stats.PendingBytes -= extra;
+	stats.LoadsInFlight--;
+	if (succeeded) {
+		e.Resident = e.LoadingMip;
+		stats.LoadsFinished++;
+		return;
+	}
+	committed -= extra;
+	e.LoadingMip = e.Resident;
+	e.Failed = true;
+	stats.LoadsFailed++;
+}
+
+
+// --------------------------------------------------------
+// Queries
+// --------------------------------------------------------
+unsigned int TextureResidency::GetResidentMip(unsigned int texture) { return entries[texture].Resident; }
+unsigned int TextureResidency::GetWantedMip(unsigned int texture) { return entries[texture].Wanted; }
+unsigned int TextureResidency::GetTailMip(unsigned int texture) { return entries[texture].TailMip; }
+bool TextureResidency::IsLoading(unsigned int texture) { return entries[texture].Loading; }
+size_t TextureResidency::GetResidentBytes(unsigned int texture) { return BytesFrom(entries[texture], entries[texture].Resident); }
+size_t TextureResidency::GetBudget() { return budget; }
+void TextureResidency::SetBudget(size_t budgetBytes) { budget = budgetBytes; }
+
+TextureResidencyStats TextureResidency::GetStats()
+{
+	TextureResidencyStats s = stats;
+	s.Textures = (unsigned int)entries.size();
+	s.BudgetBytes = budget;
+	s.ResidentBytes = committed - stats.PendingBytes;
+	s.WantedBytes = 0;
+	for (auto& e : entries) s.WantedBytes += BytesFrom(e, e.Wanted);
+	return s;
+}
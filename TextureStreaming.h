@@ -0,0 +1,194 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "MipGenerator.h"
+#include "PngDecoder.h"
+
+// --------------------------------------------------------
+// Some of a texture's mips, ready to upload
+// --------------------------------------------------------
+struct TextureMips
+{
+	unsigned int Width;			// of the whole texture (mip 0)
+	unsigned int Height;
+	unsigned int MipLevels;		// of the whole texture, down to 1x1
+	unsigned int Format;		// DXGI_FORMAT value
+	unsigned int FirstMip;		// the level Levels starts at
+	std::vector<std::vector<unsigned char>> Levels;		// FirstMip, FirstMip + 1, ... tightly packed rows
+};
+
+// --------------------------------------------------------
+// Reads a texture's mips, all or only some of them
+//
+// - Cooked .dds files (DX10 header, or DXT1/ATI1/ATI2) are
+//   read a level at a time, so only the bytes asked for
+//   come off the disk
+// - PNGs and JPEGs are decoded whole and mipped with TextureCooker's
+//   box filter (normal maps renormalized), then everything
+//   not asked for is thrown away.  They come out as RGBA8,
+//   or R8 when they're gray.
+// - Only depends on the standard library
+// --------------------------------------------------------
+class TextureMipReader
+{
+public:
+	// DXGI_FORMAT values the reader produces
+	static const unsigned int FormatRGBA8 = 28;
+	static const unsigned int FormatR8 = 61;
+	static const unsigned int FormatBC1 = 71;
+	static const unsigned int FormatBC4 = 80;
+	static const unsigned int FormatBC5 = 83;
+	static const unsigned int FormatBC7 = 98;
+
+	// Bytes in one level (block formats in whole 4x4 blocks), 0 for unknown formats
+	static size_t GetMipBytes(unsigned int format, unsigned int width, unsigned int height, unsigned int mip);
+
+	// Bytes per row of blocks (or texels) of one level, as UpdateSubresource wants it
+	static unsigned int GetRowPitch(unsigned int format, unsigned int width, unsigned int mip);
+
+	// Number of levels from a size down to 1x1
+	static unsigned int CountMips(unsigned int width, unsigned int height);
+
+	/// <summary>
+	/// Levels [firstMip, firstMip + count) of a .dds already in memory (count is clamped to what's there)
+	/// </summary>
+	static bool ReadDDS(const unsigned char* data, size_t size, unsigned int firstMip, unsigned int count, TextureMips& mips, std::string& error);
+
+	/// <summary>
+	/// The same levels of a decoded image, mipped on this thread
+	/// </summary>
+	/// <param name="options">how the levels are filtered (see GetMipOptions)</param>
+	static void FromImage(const DecodedImage& image, const MipOptions& options, unsigned int firstMip, unsigned int count, TextureMips& mips);
+
+	/// <summary>
+	/// The same levels of a .dds, .png or .jpg on disk (only the
+	/// header and the levels asked for are read from a .dds)
+	/// </summary>
+	static bool ReadFile(const std::wstring& path, unsigned int firstMip, unsigned int count, TextureMips& mips, std::string& error);
+
+	// How a texture's mips are filtered, by TextureCooker's rules for its file name
+	static MipOptions GetMipOptions(const std::wstring& path, const DecodedImage& image);
+};
+
+// Something the residency planner wants done to one texture
+struct TextureResidencyChange
+{
+	unsigned int Texture;
+	unsigned int TopMip;	// the finest level it should have afterwards
+	bool Load;				// stream in everything from TopMip up to what's there (or drop down to TopMip)
+};
+
+struct TextureResidencyStats
+{
+	unsigned int Textures;
+	unsigned int Visible;			// requested this frame
+	unsigned int LoadsInFlight;
+	unsigned int LoadsStarted;		// since the start
+	unsigned int LoadsFinished;
+	unsigned int LoadsFailed;
+	unsigned int Evictions;
+	unsigned int Deferred;			// loads this frame that didn't fit, even after evicting
+	size_t BudgetBytes;
+	size_t ResidentBytes;			// every texture's resident levels
+	size_t PendingBytes;			// levels being streamed in (already counted against the budget)
+	size_t WantedBytes;				// what this frame's requests would take, with nothing else resident
+};
+
+// --------------------------------------------------------
+// Decides which mips of which textures should be resident,
+// under a fixed memory budget
+//
+// - Every texture always keeps its tail (the small mips
+//   it started with), and can't drop below it
+// - Each frame, whatever draws a texture requests the
+//   finest mip it needs (see GetDesiredMip); the finest
+//   request wins, and textures nobody requested are only
+//   kept around while there's room
+// - Loads go out finest-gap first (how many levels short a
+//   texture is), at most maxLoadsInFlight at a time, and are
+//   counted against the budget from the moment they start
+// - When a load doesn't fit, levels nobody needs are
+//   evicted least recently used first: whole textures that
+//   weren't requested this frame before levels finer than
+//   a visible texture asked for.  A load that still doesn't
+//   fit settles for a coarser level, or waits.
+// - Only depends on the standard library
+// --------------------------------------------------------
+class TextureResidency
+{
+public:
+	TextureResidency(size_t budgetBytes, unsigned int maxLoadsInFlight);
+
+	/// <summary>
+	/// Adds a texture with its tail (levels tailMip and smaller) already resident
+	/// </summary>
+	/// <param name="mipBytes">bytes in each level, mip 0 first</param>
+	/// <returns>the texture's index</returns>
+	unsigned int Add(const std::vector<size_t>& mipBytes, unsigned int tailMip);
+
+	/// <summary>
+	/// The mip a texture should be sampled at for something on screen
+	/// </summary>
+	/// <param name="textureSize">the texture's larger side, in texels</param>
+	/// <param name="uvRepeat">times the texture repeats across the object</param>
+	/// <param name="worldRadius">radius of the object's bounds</param>
+	/// <param name="distance">from the camera to the bounds</param>
+	/// <param name="projectionScale">the projection's y scale (1 / tan(fov / 2))</param>
+	/// <param name="viewportHeight">in pixels</param>
+	/// <returns>0 or more (fractional, finer is smaller)</returns>
+	static float GetDesiredMip(unsigned int textureSize, float uvRepeat, float worldRadius, float distance,
+		float projectionScale, float viewportHeight);
+
+	// Starts a frame: requests from the last one are forgotten
+	void BeginFrame();
+
+	// Asks for a texture down to a mip this frame (rounded down, clamped to the texture)
+	void Request(unsigned int texture, float mip);
+
+	/// <summary>
+	/// Evictions to apply now, and loads to start
+	/// </summary>
+	std::vector<TextureResidencyChange> Plan();
+
+	/// <summary>
+	/// A load from Plan finished (a failed one is never retried)
+	/// </summary>
+	void Finish(unsigned int texture, bool succeeded);
+
+	unsigned int GetResidentMip(unsigned int texture);
+	unsigned int GetWantedMip(unsigned int texture);
+	unsigned int GetTailMip(unsigned int texture);
+	bool IsLoading(unsigned int texture);
+	size_t GetResidentBytes(unsigned int texture);
+
+	size_t GetBudget();
+	void SetBudget(size_t budgetBytes);
+	TextureResidencyStats GetStats();
+
+private:
+	struct Entry
+	{
+		std::vector<size_t> MipBytes;
+		unsigned int TailMip;
+		unsigned int Resident;			// finest resident level
+		unsigned int Wanted;			// finest requested this frame (TailMip if none)
+		unsigned int LoadingMip;		// what the load in flight brings it to
+		bool Loading;
+		bool Failed;
+		unsigned long long LastUsed;	// frame it was last requested in
+	};
+
+	// bytes in a texture's levels from mip down
+	size_t BytesFrom(const Entry& e, unsigned int mip);
+
+	// evicts least recently used levels until at least bytes are free (or nothing more can go)
+	void Evict(size_t bytes, unsigned int except, std::vector<TextureResidencyChange>& changes);
+
+	std::vector<Entry> entries;
+	unsigned long long frame;
+	size_t budget;
+	size_t committed;		// resident + pending
+	unsigned int maxLoadsInFlight;
+	TextureResidencyStats stats;
+};
@@ -0,0 +1,158 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	busy = 0;
+	stopping = false;
+
+	// one worker per hardware thread, leaving one for the caller
+	if (threadCount == 0)
+	{
+		unsigned int hw = std::thread::hardware_concurrency();
+		threadCount = hw > 1 ? hw - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& w : workers)
+		w.join();
+}
+
+void ThreadPool::ParallelFor(unsigned int count, const std::function<void(unsigned int)>& job)
+{
+	if (count == 0) return;
+
+	// nothing to gain from waking anyone for a single job
+	if (count == 1 || workers.empty())
+	{
+		for (unsigned int i = 0; i < count; i++) job(i);
+		return;
+	}
+
+	// jobs pull indices from a shared counter so uneven jobs balance out
+	// - the state is shared so a helper that only gets scheduled after
+	//   everything finished can still look at the counter safely
+	struct ForState
+	{
+		std::function<void(unsigned int)> job;
+		unsigned int count;
+		std::atomic<unsigned int> next;
+		std::atomic<unsigned int> done;
+		std::mutex doneMutex;
+		std::condition_variable doneSignal;
+	};
+	std::shared_ptr<ForState> state = std::make_shared<ForState>();
+	state->job = job;
+	state->count = count;
+	state->next = 0;
+	state->done = 0;
+
+	auto drain = [state]()
+	{
+		unsigned int i;
+		while ((i = state->next.fetch_add(1)) < state->count)
+		{
+			state->job(i);
+			if (state->done.fetch_add(1) + 1 == state->count)
+			{
+				std::lock_guard<std::mutex> lock(state->doneMutex);
+				state->doneSignal.notify_all();
+			}
+		}
+	};
+
+	// one helper per worker at most, the caller takes a share too
+	unsigned int helpers = (unsigned int)workers.size() < count - 1 ? (unsigned int)workers.size() : count - 1;
+	for (unsigned int h = 0; h < helpers; h++)
+		Submit(drain);
+
+	drain();
+
+	// wait for stragglers still running on the workers
+	std::unique_lock<std::mutex> lock(state->doneMutex);
+	state->doneSignal.wait(lock, [&]() { return state->done.load() == count; });
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		tasks.push_back(std::move(task));
+	}
+	wake.notify_one();
+}
+
+void ThreadPool::WaitIdle()
+{
+	// help drain the queue rather than just blocking
+	while (RunOneTask()) {}
+
+	std::unique_lock<std::mutex> lock(queueMutex);
+	idle.wait(lock, [this]() { return tasks.empty() && busy == 0; });
+}
+
+unsigned int ThreadPool::GetThreadCount()
+{
+	return (unsigned int)workers.size();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			wake.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+				return;
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			busy++;
+		}
+
+		task();
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			busy--;
+			if (tasks.empty() && busy == 0)
+				idle.notify_all();
+		}
+	}
+}
+
+bool ThreadPool::RunOneTask()
+{
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (tasks.empty())
+			return false;
+
+		task = std::move(tasks.front());
+		tasks.pop_front();
+		busy++;
+	}
+
+	task();
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		busy--;
+		if (tasks.empty() && busy == 0)
+			idle.notify_all();
+	}
+	return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A small fixed-size pool of worker threads
+//
+// - Has no platform or graphics API dependencies, so anything
+//   built on top of it can run headless
+// - ParallelFor() blocks, and the calling thread helps out
+//   with the work instead of sitting idle
+// --------------------------------------------------------
+class ThreadPool
+{
+public:
+	/// <summary>
+	/// Creates the pool
+	/// </summary>
+	/// <param name="threadCount">number of worker threads, or 0 to pick one per hardware thread (minus the caller)</param>
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// <summary>
+	/// Runs job(i) for every i in [0, count) across the workers and
+	/// the calling thread, returning once all of them are finished
+	/// </summary>
+	/// <param name="count">number of jobs</param>
+	/// <param name="job">function taking the job index</param>
+	void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& job);
+
+	/// <summary>
+	/// Queues a single fire-and-forget task
+	/// </summary>
+	/// <param name="task">the work to do on a worker thread</param>
+	void Submit(std::function<void()> task);
+
+	/// <summary>
+	/// Blocks until every submitted task has finished
+	/// </summary>
+	void WaitIdle();
+
+	/// <summary>
+	/// Number of worker threads (not counting the caller)
+	/// </summary>
+	/// <returns>thread count</returns>
+	unsigned int GetThreadCount();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex queueMutex;
+	std::condition_variable wake;		// signals workers that tasks are waiting
+	std::condition_variable idle;		// signals waiters that the queue drained
+	unsigned int busy;					// tasks currently executing
+	bool stopping;
+
+	void WorkerLoop();
+	bool RunOneTask();
+};
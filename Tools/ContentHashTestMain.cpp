@@ -0,0 +1,215 @@
+// --------------------------------------------------------
+// Headless checks for ContentHash::Hash64
+//
+// - Published XXH64 values: strings from the reference
+//   implementation's docs, and xxhsum's sanity buffers
+//   (both the 0.6 one and the 0.8 one)
+// - Every length from 0 to 160 (so every 4, 8 and 32 byte
+//   boundary and tail combination) and every alignment,
+//   against a plain transcription of the XXH64 spec that
+//   reads one byte at a time
+// - HashFile matches Hash64 on the same bytes
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler, e.g.:
+//   g++ -std=c++20 -O2 -I. Tools/ContentHashTestMain.cpp ContentHash.cpp -o hashtest
+//   ./hashtest [scratch directory]
+// (or every headless test at once with make -C Tools check)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "ContentHash.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+const uint32_t Prime32 = 2654435761u;
+
+// --------------------------------------------------------
+// XXH64 as the spec describes it, one byte at a time, with
+// nothing shared with ContentHash.cpp
+// --------------------------------------------------------
+namespace Spec
+{
+	const uint64_t P1 = 11400714785074694791ull;
+	const uint64_t P2 = 14029467366897019727ull;
+	const uint64_t P3 = 1609587929392839161ull;
+	const uint64_t P4 = 9650029242287828579ull;
+	const uint64_t P5 = 2870177450012600261ull;
+
+	uint64_t Rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+
+	uint64_t Load(const unsigned char* p, int bytes)
+	{
+		uint64_t v = 0;
+		for (int i = bytes - 1; i >= 0; i--) v = (v << 8) | p[i];
+		return v;
+	}
+
+	uint64_t Round(uint64_t acc, uint64_t lane) { return Rotl(acc + lane * P2, 31) * P1; }
+
+	uint64_t XXH64(const unsigned char* p, size_t length, uint64_t seed)
+	{
+		size_t at = 0;
+		uint64_t acc;
+		if (length >= 32) {
+			uint64_t a[4] = { seed + P1 + P2, seed + P2, seed, seed - P1 };
+			for (; at + 32 <= length; at += 32)
+				for (int i = 0; i < 4; i++) a[i] = Round(a[i], Load(p + at + i * 8, 8));
+			acc = Rotl(a[0], 1) + Rotl(a[1], 7) + Rotl(a[2], 12) + Rotl(a[3], 18);
+			for (int i = 0; i < 4; i++) acc = (acc ^ Round(0, a[i])) * P1 + P4;
+		}
+		else acc = seed + P5;
+
+		acc += length;
+		for (; at + 8 <= length; at += 8) acc = Rotl(acc ^ Round(0, Load(p + at, 8)), 27) * P1 + P4;
+		for (; at + 4 <= length; at += 4) acc = Rotl(acc ^ (Load(p + at, 4) * P1), 23) * P2 + P3;
+		for (; at < length; at++) acc = Rotl(acc ^ (p[at] * P5), 11) * P1;
+
+		acc ^= acc >> 33; acc *= P2;
+		acc ^= acc >> 29; acc *= P3;
+		acc ^= acc >> 32;
+		return acc;
+	}
+}
+
+std::string Hex(unsigned long long v)
+{
+	char text[20];
+	snprintf(text, sizeof(text), "%016llx", v);
+	return text;
+}
+
+void CheckValue(const void* data, size_t size, unsigned long long seed, unsigned long long expected, const std::string& what)
+{
+	unsigned long long hash = ContentHash::Hash64(data, size, seed);
+	Check(hash == expected, what + ": got " + Hex(hash) + ", expected " + Hex(expected));
+}
+
+void CheckPublished()
+{
+	// strings
+	CheckValue("", 0, 0, 0xef46db3751d8e999ull, "empty");
+	CheckValue("a", 1, 0, 0xd24ec4f1a98c6e5bull, "\"a\"");
+	CheckValue("abc", 3, 0, 0x44bc2cf5ad770999ull, "\"abc\"");
+	const char* spam = "Nobody inspects the spammish repetition";
+	CheckValue(spam, strlen(spam), 0, 0xfbcea83c8a378bf1ull, "\"Nobody inspects the spammish repetition\"");
+
+	// xxhsum 0.6's sanity buffer: each byte the top of a 32 bit generator that squares itself
+	unsigned char oldBuffer[222];
+	uint32_t generator = Prime32;
+	for (auto& b : oldBuffer) { b = (unsigned char)(generator >> 24); generator *= generator; }
+	CheckValue(oldBuffer, 0, Prime32, 0xac75fda2929b17efull, "0.6 sanity, 0 bytes, seeded");
+	CheckValue(oldBuffer, 1, 0, 0x4fce394cc88952d8ull, "0.6 sanity, 1 byte");
+	CheckValue(oldBuffer, 1, Prime32, 0x739840cb819fa723ull, "0.6 sanity, 1 byte, seeded");
+	CheckValue(oldBuffer, 14, 0, 0xcffa8db881bc3a3dull, "0.6 sanity, 14 bytes");
+	CheckValue(oldBuffer, 14, Prime32, 0x5b9611585efcc9cbull, "0.6 sanity, 14 bytes, seeded");
+	CheckValue(oldBuffer, 222, 0, 0x9dd507880debb03dull, "0.6 sanity, 222 bytes");
+	CheckValue(oldBuffer, 222, Prime32, 0xdc515172b8ee0600ull, "0.6 sanity, 222 bytes, seeded");
+
+	// xxhsum 0.8's: the top of a 64 bit generator multiplied by PRIME64_1 each byte
+	unsigned char newBuffer[222];
+	uint64_t generator64 = Prime32;
+	for (auto& b : newBuffer) { b = (unsigned char)(generator64 >> 56); generator64 *= 11400714785074694797ull; }
+	CheckValue(newBuffer, 1, 0, 0xe934a84adb052768ull, "0.8 sanity, 1 byte");
+	CheckValue(newBuffer, 1, Prime32, 0x5014607643a9b4c3ull, "0.8 sanity, 1 byte, seeded");
+	CheckValue(newBuffer, 14, 0, 0x8282dcc4994e35c8ull, "0.8 sanity, 14 bytes");
+	CheckValue(newBuffer, 14, Prime32, 0xc3bd6bf63deb6df0ull, "0.8 sanity, 14 bytes, seeded");
+	CheckValue(newBuffer, 222, 0, 0xb641ae8cb691c174ull, "0.8 sanity, 222 bytes");
+	CheckValue(newBuffer, 222, Prime32, 0x20cb8ab7ae10c14aull, "0.8 sanity, 222 bytes, seeded");
+
+	// and the spec transcription agrees with all of them, so it can stand in below
+	Check(Spec::XXH64(oldBuffer, 222, Prime32) == 0xdc515172b8ee0600ull && Spec::XXH64(newBuffer, 14, 0) == 0x8282dcc4994e35c8ull
+		&& Spec::XXH64((const unsigned char*)"abc", 3, 0) == 0x44bc2cf5ad770999ull, "spec transcription matches the published values");
+}
+
+void CheckLengths()
+{
+	// 0 to 160 bytes covers no stripes through five, with every 8/4/1 byte tail after each
+	const size_t maxLength = 160;
+	std::vector<unsigned char> buffer(maxLength + 8);
+	uint64_t generator = Prime32;
+	for (auto& b : buffer) { b = (unsigned char)(generator >> 56); generator *= 11400714785074694797ull; }
+
+	unsigned int mismatches = 0;
+	unsigned int misaligned = 0;
+	for (unsigned long long seed : { 0ull, (unsigned long long)Prime32, 0xffffffffffffffffull }) {
+		for (size_t length = 0; length <= maxLength; length++) {
+			uint64_t expected = Spec::XXH64(buffer.data(), length, seed);
+			if (ContentHash::Hash64(buffer.data(), length, seed) != expected) {
+				if (mismatches < 8) printf("  length %zu, seed %s: %s vs %s\n", length, Hex(seed).c_str(),
+					Hex(ContentHash::Hash64(buffer.data(), length, seed)).c_str(), Hex(expected).c_str());
+				mismatches++;
+			}
+
+			// the same bytes at every offset in an 8 byte word hash the same
+			for (size_t offset = 1; offset < 8; offset++) {
+				std::vector<unsigned char> shifted(length + offset);
+				if (length) memcpy(shifted.data() + offset, buffer.data(), length);
+				if (ContentHash::Hash64(shifted.data() + offset, length, seed) != expected) misaligned++;
+			}
+		}
+	}
+	Check(mismatches == 0, "every length from 0 to 160, three seeds, matches the spec");
+	Check(misaligned == 0, "unaligned data hashes the same as aligned");
+
+	// the boundaries, by name, so a failure says which one
+	for (size_t length : { 3, 4, 5, 7, 8, 9, 12, 15, 16, 17, 31, 32, 33, 35, 36, 39, 40, 41, 63, 64, 65, 96 })
+		CheckValue(buffer.data(), length, 0, Spec::XXH64(buffer.data(), length, 0), std::to_string(length) + " bytes");
+
+	// every length gives a different hash, and flipping any one bit changes it
+	std::vector<unsigned long long> hashes;
+	for (size_t length = 0; length <= maxLength; length++) hashes.push_back(ContentHash::Hash64(buffer.data(), length));
+	std::sort(hashes.begin(), hashes.end());
+	Check(std::adjacent_find(hashes.begin(), hashes.end()) == hashes.end(), "no two prefixes collide");
+
+	unsigned int unchanged = 0;
+	unsigned long long base = ContentHash::Hash64(buffer.data(), 100);
+	for (size_t bit = 0; bit < 100 * 8; bit++) {
+		std::vector<unsigned char> flipped(buffer.begin(), buffer.begin() + 100);
+		flipped[bit / 8] ^= (unsigned char)(1 << (bit % 8));
+		if (ContentHash::Hash64(flipped.data(), 100) == base) unchanged++;
+	}
+	Check(unchanged == 0, "every bit flip in 100 bytes changes the hash");
+}
+
+void CheckFile(const std::filesystem::path& dir)
+{
+	std::filesystem::path path = dir / "hash.bin";
+	std::string text = "Nobody inspects the spammish repetition";
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out << text;
+	}
+
+	std::vector<unsigned char> contents;
+	unsigned long long hash = 0;
+	Check(ContentHash::HashFile(path.wstring(), contents, hash), "HashFile reads the file");
+	Check(hash == 0xfbcea83c8a378bf1ull, "HashFile hashes what Hash64 does");
+	Check(std::string(contents.begin(), contents.end()) == text, "HashFile returns the contents");
+
+	{ std::ofstream out(path, std::ios::binary | std::ios::trunc); }
+	Check(ContentHash::HashFile(path.wstring(), contents, hash) && contents.empty() && hash == 0xef46db3751d8e999ull, "an empty file");
+	Check(!ContentHash::HashFile((dir / "missing.bin").wstring(), contents, hash), "a missing file fails");
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path dir = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::temp_directory_path() / "ContentHashTest";
+	std::error_code ec;
+	std::filesystem::create_directories(dir, ec);
+
+	CheckPublished();
+	CheckLengths();
+	CheckFile(dir);
+
+	std::filesystem::remove_all(dir, ec);
+	return FinishChecks();
+}
@@ -0,0 +1,147 @@
+// --------------------------------------------------------
+// Headless checks for the culling math
+//
+// Projects boxes through known orthographic and perspective
+// matrices and checks the bounds, the light volume tests
+// and the caster/receiver tests against answers worked out
+// by hand
+//
+// Needs DirectXMath, which is header only: it comes with the
+// Windows SDK, and elsewhere is a checkout of
+// github.com/microsoft/DirectXMath (its Inc directory, plus
+// sal.h from DirectX-Headers' include/wsl/stubs)
+//
+// Build and run from the repo root, e.g.:
+//   g++ -std=c++20 -O2 -I. -I<DirectXMath>/Inc -I<DirectX-Headers>/include/wsl/stubs
+//       Tools/CullingTestMain.cpp Culling.cpp -o culltest
+//   ./culltest
+// (or every headless test at once with make -C Tools check
+// DIRECTXMATH=<DirectXMath>/Inc DXSTUBS=<DirectX-Headers>/include/wsl/stubs)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "Culling.h"
+#include "TestCheck.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+using namespace DirectX;
+
+bool Near(const XMFLOAT3& a, float x, float y, float z)
+{
+	const float epsilon = 1e-4f;
+	return fabsf(a.x - x) < epsilon && fabsf(a.y - y) < epsilon && fabsf(a.z - z) < epsilon;
+}
+
+ProjectedBounds Bounds(float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+{
+	return { XMFLOAT3(minX, minY, minZ), XMFLOAT3(maxX, maxY, maxZ), false };
+}
+
+XMFLOAT4X4 Store(XMMATRIX m)
+{
+	XMFLOAT4X4 result;
+	XMStoreFloat4x4(&result, m);
+	return result;
+}
+
+void CheckProjection()
+{
+	// a light at the origin looking down +z, 20 x 20 wide and 100 deep: ndc = (x / 10, y / 10, z / 100)
+	XMFLOAT4X4 light = Store(XMMatrixOrthographicLH(20, 20, 0, 100));
+	ProjectedBounds p = Culling::ProjectBounds(BoundingBox(XMFLOAT3(5, 0, 50), XMFLOAT3(1, 1, 1)), light);
+	Check(!p.Empty && Near(p.Min, 0.4f, -0.1f, 0.49f) && Near(p.Max, 0.6f, 0.1f, 0.51f), "orthographic projection");
+
+	// the same light moved to y = 50 and looking down: light space x = world x, y = world z, z = 50 - world y
+	XMFLOAT4X4 down = Store(XMMatrixLookToLH(XMVectorSet(0, 50, 0, 1), XMVectorSet(0, -1, 0, 0), XMVectorSet(0, 0, 1, 0)) *
+		XMMatrixOrthographicLH(20, 20, 0, 100));
+	p = Culling::ProjectBounds(BoundingBox(XMFLOAT3(2, 10, -4), XMFLOAT3(1, 2, 1)), down);
+	Check(Near(p.Min, 0.1f, -0.5f, 0.38f) && Near(p.Max, 0.3f, -0.3f, 0.42f), "orthographic projection through a view matrix");
+
+	// 90 degrees, square, near 1 and far 100: x and y divide by z, z = 100/99 * (1 - 1/z)
+	XMFLOAT4X4 camera = Store(XMMatrixPerspectiveFovLH(XM_PIDIV2, 1, 1, 100));
+	p = Culling::ProjectBounds(BoundingBox(XMFLOAT3(0, 0, 10), XMFLOAT3(1, 1, 1)), camera);
+	float zMin = 100.0f / 99 * (1 - 1 / 9.0f), zMax = 100.0f / 99 * (1 - 1 / 11.0f);
+	Check(Near(p.Min, -1 / 9.0f, -1 / 9.0f, zMin) && Near(p.Max, 1 / 9.0f, 1 / 9.0f, zMax), "perspective projection");
+
+	// a corner behind the eye can't be projected, so the bounds cover everything
+	p = Culling::ProjectBounds(BoundingBox(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1)), camera);
+	Check(!p.Empty && p.Min.x == -FLT_MAX && p.Max.z == FLT_MAX, "perspective box behind the eye covers everything");
+}
+
+void CheckBounds()
+{
+	BoundingBox unit(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1));
+	BoundingBox moved = Culling::TransformBounds(unit, Store(XMMatrixScaling(2, 2, 2) * XMMatrixTranslation(1, 2, 3)));
+	Check(Near(moved.Center, 1, 2, 3) && Near(moved.Extents, 2, 2, 2), "scaled and translated bounds");
+
+	BoundingBox turned = Culling::TransformBounds(unit, Store(XMMatrixRotationY(XM_PIDIV4)));
+	Check(Near(turned.Extents, sqrtf(2), 1, sqrtf(2)), "rotated bounds grow to fit");
+
+	ProjectedBounds merged = Culling::EmptyBounds();
+	Check(merged.Empty, "empty bounds are empty");
+	Culling::MergeBounds(merged, Culling::EmptyBounds());
+	Check(merged.Empty, "merging empty bounds stays empty");
+	Culling::MergeBounds(merged, Bounds(0, 0, 0, 1, 1, 1));
+	Culling::MergeBounds(merged, Bounds(-1, 0.5f, 0.2f, 0.5f, 2, 0.4f));
+	Check(!merged.Empty && Near(merged.Min, -1, 0, 0) && Near(merged.Max, 1, 2, 1), "merged bounds");
+
+	XMFLOAT4X4 camera = Store(XMMatrixPerspectiveFovLH(XM_PIDIV2, 1, 1, 100));
+	Check(Culling::IsVisible(BoundingBox(XMFLOAT3(0, 0, 10), XMFLOAT3(1, 1, 1)), camera), "box in front of the camera is visible");
+	Check(!Culling::IsVisible(BoundingBox(XMFLOAT3(0, 0, -10), XMFLOAT3(1, 1, 1)), camera), "box behind the camera isn't");
+	Check(!Culling::IsVisible(BoundingBox(XMFLOAT3(30, 0, 10), XMFLOAT3(1, 1, 1)), camera), "box off to the side isn't");
+	Check(!Culling::IsVisible(BoundingBox(XMFLOAT3(0, 0, 200), XMFLOAT3(1, 1, 1)), camera), "box past the far plane isn't");
+	Check(Culling::IsVisible(BoundingBox(XMFLOAT3(10, 0, 10), XMFLOAT3(1, 1, 1)), camera), "box across the edge is visible");
+	Check(Culling::IsVisible(BoundingBox(XMFLOAT3(0, 0, 0), XMFLOAT3(50, 50, 50)), camera), "box around the camera is visible");
+}
+
+void CheckLightVolume()
+{
+	Check(Culling::CasterInLightVolume(Bounds(-0.5f, -0.5f, 0.2f, 0.5f, 0.5f, 0.4f)), "caster inside the volume");
+	Check(Culling::CasterInLightVolume(Bounds(0.9f, 0.9f, 0.9f, 1.5f, 1.5f, 1.5f)), "caster across a corner");
+	Check(Culling::CasterInLightVolume(Bounds(-0.5f, -0.5f, -3, 0.5f, 0.5f, -2)), "caster in front of the near plane still casts");
+	Check(Culling::CasterInLightVolume(Bounds(-1, -1, 1, -1, -1, 1)), "caster touching the edges");
+	Check(!Culling::CasterInLightVolume(Bounds(-3, 0, 0.5f, -1.01f, 0.5f, 0.6f)), "caster left of the volume");
+	Check(!Culling::CasterInLightVolume(Bounds(1.01f, 0, 0.5f, 3, 0.5f, 0.6f)), "caster right of the volume");
+	Check(!Culling::CasterInLightVolume(Bounds(0, -3, 0.5f, 0.5f, -1.01f, 0.6f)), "caster below the volume");
+	Check(!Culling::CasterInLightVolume(Bounds(0, 1.01f, 0.5f, 0.5f, 3, 0.6f)), "caster above the volume");
+	Check(!Culling::CasterInLightVolume(Bounds(-0.5f, -0.5f, 1.01f, 0.5f, 0.5f, 2)), "caster past the far plane");
+	Check(!Culling::CasterInLightVolume(Culling::EmptyBounds()), "empty caster");
+
+	// end to end: a light looking down +z, 20 wide, 100 deep
+	XMFLOAT4X4 light = Store(XMMatrixOrthographicLH(20, 20, 0, 100));
+	auto inVolume = [&](float x, float y, float z) {
+		return Culling::CasterInLightVolume(Culling::ProjectBounds(BoundingBox(XMFLOAT3(x, y, z), XMFLOAT3(1, 1, 1)), light));
+	};
+	Check(inVolume(0, 0, 50), "projected caster in the middle");
+	Check(inVolume(0, 0, -30), "projected caster behind the light");
+	Check(!inVolume(12, 0, 50), "projected caster off to the side");
+	Check(!inVolume(0, 0, 150), "projected caster too far away");
+}
+
+void CheckReceivers()
+{
+	ProjectedBounds receivers = Bounds(-0.5f, -0.5f, 0.4f, 0.5f, 0.5f, 0.6f);
+	Check(Culling::CasterReachesReceivers(Bounds(-0.1f, -0.1f, 0.1f, 0.1f, 0.1f, 0.2f), receivers), "caster between the light and receivers");
+	Check(Culling::CasterReachesReceivers(Bounds(-0.1f, -0.1f, 0.5f, 0.1f, 0.1f, 0.55f), receivers), "caster among the receivers");
+	Check(Culling::CasterReachesReceivers(Bounds(0.5f, 0.5f, 0.1f, 1, 1, 0.2f), receivers), "caster touching the receivers' corner");
+	Check(Culling::CasterReachesReceivers(Bounds(-0.1f, -0.1f, 0.6f, 0.1f, 0.1f, 0.9f), receivers), "caster starting at the farthest receiver");
+	Check(!Culling::CasterReachesReceivers(Bounds(-0.1f, -0.1f, 0.61f, 0.1f, 0.1f, 0.9f), receivers), "caster behind every receiver");
+	Check(!Culling::CasterReachesReceivers(Bounds(0.6f, -0.1f, 0.1f, 0.9f, 0.1f, 0.2f), receivers), "caster beside the receivers in x");
+	Check(!Culling::CasterReachesReceivers(Bounds(-0.1f, -0.9f, 0.1f, 0.1f, -0.6f, 0.2f), receivers), "caster beside the receivers in y");
+	Check(!Culling::CasterReachesReceivers(Bounds(-0.1f, -0.1f, 0.1f, 0.1f, 0.1f, 0.2f), Culling::EmptyBounds()), "nothing visible to receive");
+	Check(!Culling::CasterReachesReceivers(Culling::EmptyBounds(), receivers), "empty caster reaches nothing");
+}
+
+int main()
+{
+	CheckProjection();
+	CheckBounds();
+	CheckLightVolume();
+	CheckReceivers();
+
+	return FinishChecks();
+}
@@ -0,0 +1,187 @@
+// --------------------------------------------------------
+// Command line HDR sky conversion and benchmark
+//
+// Decodes an equirectangular .hdr, converts it to a cube
+// map with EnvironmentMap (on one thread, then on the
+// pool) and prints the throughput of every step; --cook
+// also writes the BC6H cube next to the .hdr, where the
+// game loads it instead of converting at startup
+//
+// The repo doesn't ship a .hdr, so --synthetic W times a
+// procedural sky (W x W/2, with a sun far past 1.0) instead
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler and SSE2, e.g.:
+//   g++ -std=c++20 -O2 -pthread -I. Tools/EnvironmentMapMain.cpp
+//       EnvironmentMap.cpp HdrDecoder.cpp BlockCompression.cpp
+//       ContentHash.cpp ThreadPool.cpp -o envmap
+//   ./envmap [--threads N] [--runs N] [--size N] [--samples N]
+//            [--bc6h] [--cook] [--synthetic W] [textures/Skies/sky.hdr]
+// --------------------------------------------------------
+#include "EnvironmentMap.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// A blue sky over brown ground, a few bands of cloud and a small, very bright sun
+HdrImage MakeSyntheticSky(unsigned int width)
+{
+	const float pi = 3.14159265f;
+	const float sun[3] = { 0.45f, 0.5f, 0.74f };		// roughly normalized, up and to the front right
+	HdrImage image = {};
+	image.Width = width;
+	image.Height = std::max(1u, width / 2);
+	image.Pixels.resize((size_t)image.Width * image.Height * 4);
+	for (unsigned int y = 0; y < image.Height; y++) {
+		float latitude = pi * (0.5f - (y + 0.5f) / image.Height);
+		for (unsigned int x = 0; x < image.Width; x++) {
+			float longitude = 2 * pi * ((x + 0.5f) / image.Width - 0.5f);
+			float dir[3] = { cosf(latitude) * sinf(longitude), sinf(latitude), cosf(latitude) * cosf(longitude) };
+			float cosSun = dir[0] * sun[0] + dir[1] * sun[1] + dir[2] * sun[2];
+			float angle = acosf(std::clamp(cosSun, -1.0f, 1.0f));
+
+			float* p = &image.Pixels[((size_t)y * image.Width + x) * 4];
+			float rgb[3];
+			if (dir[1] < 0)
+				for (int c = 0; c < 3; c++) rgb[c] = (c == 0 ? 0.3f : c == 1 ? 0.24f : 0.18f);
+			else {
+				float t = sqrtf(dir[1]);
+				float cloud = std::max(0.0f, sinf(longitude * 7 + sinf(latitude * 23) * 2) * sinf(latitude * 17)) * (1 - t);
+				for (int c = 0; c < 3; c++) {
+					float horizon = c == 0 ? 2.4f : c == 1 ? 2.6f : 2.9f;
+					float zenith = c == 0 ? 0.3f : c == 1 ? 0.6f : 1.6f;
+					rgb[c] = horizon + (zenith - horizon) * t + cloud * 3;
+				}
+			}
+			for (int c = 0; c < 3; c++) rgb[c] += 30 * expf(-angle * 12) + (angle < 0.0047f ? 60000.0f : 0.0f);
+			p[0] = rgb[0];
+			p[1] = rgb[1];
+			p[2] = rgb[2];
+			p[3] = 1;
+		}
+	}
+	return image;
+}
+
+int main(int argc, char** argv)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	EnvironmentMapOptions options = {};
+	unsigned int threads = 0;
+	unsigned int runs = 3;
+	unsigned int synthetic = 0;
+	bool cook = false;
+	std::string input = "textures/Skies/sky.hdr";
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) threads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--runs" && i + 1 < argc) runs = std::max(1, atoi(argv[++i]));
+		else if (arg == "--size" && i + 1 < argc) options.FaceSize = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--samples" && i + 1 < argc) options.Samples = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--synthetic" && i + 1 < argc) synthetic = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--bc6h") options.BC6H = true;
+		else if (arg == "--cook") cook = true;
+		else input = arg;
+	}
+
+	// the sky, decoded a few times for its own timing
+	HdrImage image;
+	if (synthetic) {
+		image = MakeSyntheticSky(synthetic);
+		printf("Synthetic sky %ux%u\n", image.Width, image.Height);
+	}
+	else {
+		std::ifstream file(input, std::ios::binary);
+		std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		double best = 0;
+		for (unsigned int run = 0; run < runs; run++) {
+			std::string error;
+			auto start = Clock::now();
+			if (!HdrDecoder::Decode(data.data(), data.size(), image, error)) {
+				printf("%s: %s\n", input.c_str(), error.c_str());
+				return 1;
+			}
+			double t = ms(start, Clock::now());
+			best = run == 0 ? t : std::min(best, t);
+		}
+		printf("%s %ux%u | decode %.1f ms | %.1f MP/s | %.1f MB/s of file\n", input.c_str(), image.Width, image.Height, best,
+			(double)image.Width * image.Height / 1e6 / (best / 1000), data.size() / 1048576.0 / (best / 1000));
+	}
+
+	EnvironmentMapOptions o = EnvironmentMap::Resolve(options, image.Width);
+	double texels = 6.0 * o.FaceSize * o.FaceSize;
+	printf("Cube 6 x %u^2, %u^2 samples per texel, %s, best of %u runs\n", o.FaceSize, o.Samples, o.BC6H ? "BC6H" : "RGBA16F", runs);
+
+	// one thread, then the pool
+	ThreadPool pool(threads);
+	EnvironmentCube cube;
+	for (ThreadPool* p : { (ThreadPool*)0, &pool }) {
+		EnvironmentMapStats best = {};
+		for (unsigned int run = 0; run < runs; run++) {
+			EnvironmentMapStats stats = {};
+			std::string error;
+			auto start = Clock::now();
+			if (!EnvironmentMap::Convert(image, options, p, cube, stats, error)) {
+				printf("%s\n", error.c_str());
+				return 1;
+			}
+			stats.TotalMs = ms(start, Clock::now());
+			if (run == 0 || stats.TotalMs < best.TotalMs) best = stats;
+		}
+		printf("%2u threads: %.1f ms | resample %.1f ms (%.1f MP/s) | mips %.1f ms | encode %.1f ms (%.1f MP/s)\n",
+			p ? pool.GetThreadCount() + 1 : 1, best.TotalMs, best.ResampleMs, texels / 1e6 / (best.ResampleMs / 1000),
+			best.MipsMs, best.EncodeMs, texels * 4 / 3 / 1e6 / (best.EncodeMs / 1000));
+	}
+
+	size_t bytes = 0;
+	for (auto& sub : cube.Subresources) bytes += sub.size();
+	printf("%u mips, %.1f MB\n", cube.MipLevels, bytes / 1048576.0);
+
+	// BC6H for the game to load instead, and how far it is from the halves
+	if (cook) {
+		std::string error;
+		EnvironmentMapStats stats = {};
+		EnvironmentCube halves, cooked;
+		EnvironmentMapOptions halfOptions = options, cookOptions = options;
+		halfOptions.BC6H = false;
+		cookOptions.BC6H = true;
+		if (!EnvironmentMap::Convert(image, halfOptions, &pool, halves, stats, error) ||
+			!EnvironmentMap::Convert(image, cookOptions, &pool, cooked, stats, error)) {
+			printf("%s\n", error.c_str());
+			return 1;
+		}
+
+		std::vector<float> a, b;
+		unsigned int size = 0;
+		EnvironmentMap::GetLinearFaces(halves, o.FaceSize, a, size);
+		EnvironmentMap::GetLinearFaces(cooked, o.FaceSize, b, size);
+		double logError = 0;
+		size_t count = 0;
+		for (size_t i = 0; i < a.size(); i++)
+			if (i % 4 != 3 && a[i] > 0 && b[i] > 0) {
+				logError += fabs(log2(b[i] / a[i]));
+				count++;
+			}
+		printf("BC6H vs RGBA16F: mean |log2 ratio| %.4f\n", count ? logError / count : 0.0);
+
+		std::string output = synthetic ? "synthetic_sky.dds" : EnvironmentMap::GetCookedPath(input);
+		if (!EnvironmentMap::Save(output, cooked, error)) {
+			printf("%s\n", error.c_str());
+			return 1;
+		}
+		std::error_code ec;
+		printf("Cooked %s (%.1f MB)\n", output.c_str(), std::filesystem::file_size(output, ec) / 1048576.0);
+	}
+	return 0;
+}
@@ -0,0 +1,297 @@
+// --------------------------------------------------------
+// Headless checks for FrameGraph::Compile
+//
+// Builds small graphs with known answers and checks pass
+// order, culling (unread transients, retained imports and
+// side effects), unbind insertion (including a transient
+// aliased into a slot another one was just read from),
+// slot assignment and its memory savings, and the errors
+// for cycles and writes to old versions.  Execute() runs
+// against a backend that records what it's asked to do.
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler, e.g.:
+//   g++ -std=c++20 -O2 -I. Tools/FrameGraphTestMain.cpp FrameGraph.cpp RenderInterface.cpp -o graphtest
+//   ./graphtest
+// (or every headless test at once with make -C Tools check)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "FrameGraph.h"
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+const FrameTextureDesc ColorDesc = { 256, 128, RenderTextureFormat::RGBA8 };
+const FrameTextureDesc HdrDesc = { 256, 128, RenderTextureFormat::RGBA16_Float };
+const FrameTextureDesc DepthDesc = { 1024, 1024, RenderTextureFormat::D32_Float };
+const unsigned long long ColorBytes = 256ull * 128 * 4;
+
+// --------------------------------------------------------
+// Remembers what Execute() asked of it, and which passes ran
+// --------------------------------------------------------
+class RecordingBackend : public IFrameGraphBackend
+{
+public:
+	std::vector<std::string> Log;
+
+	void Realize(const std::vector<FrameGraphSlot>& slots) override { Log.push_back("realize " + std::to_string(slots.size())); }
+	void UnbindShaderResources() override { Log.push_back("unbind"); }
+};
+
+std::vector<unsigned int> Order(std::initializer_list<unsigned int> passes) { return passes; }
+
+void CheckAliasAfterRead()
+{
+	// writeA, readA (as a shader resource), writeB, readB: A and B never live
+	// at the same time, so B reuses A's slot, and that's the texture readA left bound
+	FrameGraph graph;
+	RecordingBackend backend;
+	FrameResource backBuffer = graph.ImportTexture("Back Buffer", ColorDesc, true);
+	FrameResource a = graph.CreateTexture("A", ColorDesc);
+	FrameResource b = graph.CreateTexture("B", ColorDesc);
+
+	unsigned int writeA = graph.AddPass("writeA", [&]() { backend.Log.push_back("writeA"); });
+	a = graph.Write(writeA, a, FrameAccess::RenderTarget);
+	unsigned int readA = graph.AddPass("readA", [&]() { backend.Log.push_back("readA"); });
+	graph.Read(readA, a);
+	backBuffer = graph.Write(readA, backBuffer, FrameAccess::RenderTarget);
+	unsigned int writeB = graph.AddPass("writeB", [&]() { backend.Log.push_back("writeB"); });
+	b = graph.Write(writeB, b, FrameAccess::RenderTarget);
+	unsigned int readB = graph.AddPass("readB", [&]() { backend.Log.push_back("readB"); });
+	graph.Read(readB, b);
+	backBuffer = graph.Write(readB, backBuffer, FrameAccess::RenderTarget);
+
+	Check(graph.Compile(), "alias graph compiles");
+	Check(graph.GetExecutionOrder() == Order({ writeA, readA, writeB, readB }), "alias graph runs in declaration order");
+	Check(graph.GetSlot(a) >= 0 && graph.GetSlot(a) == graph.GetSlot(b) && graph.GetSlots().size() == 1, "A and B share one slot");
+	Check(graph.UnbindsBefore(writeB), "writing B into the slot readA has bound unbinds first");
+	Check(!graph.UnbindsBefore(writeA) && !graph.UnbindsBefore(readA) && !graph.UnbindsBefore(readB), "and nowhere else before a pass");
+	Check(graph.GetSlots()[0].Usage == (FrameUsageShaderResource | FrameUsageRenderTarget), "the slot is a render target and a shader resource");
+
+	FrameGraphStats s = graph.GetStats();
+	Check(s.TransientResources == 2 && s.Slots == 1, "two transients, one slot");
+	Check(s.TransientBytes == 2 * ColorBytes && s.AllocatedBytes == ColorBytes && s.SavedBytes == ColorBytes, "aliasing saves one texture");
+	Check(s.ShaderResourceUnbinds == 2, "one unbind before writeB and one after the frame");
+
+	graph.Execute(&backend);
+	std::vector<std::string> expected = { "realize 1", "writeA", "readA", "unbind", "writeB", "readB", "unbind" };
+	Check(backend.Log == expected, "Execute realizes, unbinds right before writeB, and unbinds after the frame");
+
+	// the same graph with B in another format: separate textures, so nothing to unbind
+	FrameGraph apart;
+	backBuffer = apart.ImportTexture("Back Buffer", ColorDesc, true);
+	a = apart.CreateTexture("A", ColorDesc);
+	b = apart.CreateTexture("B", HdrDesc);
+	writeA = apart.AddPass("writeA", 0);
+	a = apart.Write(writeA, a, FrameAccess::RenderTarget);
+	readA = apart.AddPass("readA", 0);
+	apart.Read(readA, a);
+	backBuffer = apart.Write(readA, backBuffer, FrameAccess::RenderTarget);
+	writeB = apart.AddPass("writeB", 0);
+	b = apart.Write(writeB, b, FrameAccess::RenderTarget);
+	readB = apart.AddPass("readB", 0);
+	apart.Read(readB, b);
+	backBuffer = apart.Write(readB, backBuffer, FrameAccess::RenderTarget);
+	Check(apart.Compile() && apart.GetSlot(a) != apart.GetSlot(b), "different formats don't share");
+	Check(!apart.UnbindsBefore(writeB) && apart.GetStats().SavedBytes == 0, "so writeB needs no unbind and nothing is saved");
+}
+
+void CheckSlots()
+{
+	// A, then B while A is still read, then C after both: C can take A's slot, never B's
+	FrameGraph graph;
+	FrameResource backBuffer = graph.ImportTexture("Back Buffer", ColorDesc, true);
+	FrameResource a = graph.CreateTexture("A", ColorDesc);
+	FrameResource b = graph.CreateTexture("B", ColorDesc);
+	FrameResource c = graph.CreateTexture("C", ColorDesc);
+
+	unsigned int p0 = graph.AddPass("write A", 0);
+	a = graph.Write(p0, a, FrameAccess::RenderTarget);
+	unsigned int p1 = graph.AddPass("A to B", 0);
+	graph.Read(p1, a);
+	b = graph.Write(p1, b, FrameAccess::RenderTarget);
+	unsigned int p2 = graph.AddPass("B to C", 0);
+	graph.Read(p2, b);
+	c = graph.Write(p2, c, FrameAccess::RenderTarget);
+	unsigned int p3 = graph.AddPass("C to back buffer", 0);
+	graph.Read(p3, c);
+	backBuffer = graph.Write(p3, backBuffer, FrameAccess::RenderTarget);
+
+	Check(graph.Compile(), "chain compiles");
+	Check(graph.GetSlot(a) != graph.GetSlot(b) && graph.GetSlot(b) != graph.GetSlot(c), "overlapping lifetimes get their own slots");
+	Check(graph.GetSlot(a) == graph.GetSlot(c) && graph.GetSlots().size() == 2, "C reuses A's slot once A's last reader is done");
+	Check(graph.GetStats().SavedBytes == ColorBytes, "saving one of three");
+	Check(graph.UnbindsBefore(p2), "C's write into A's slot, which p1 read, unbinds first");
+	Check(graph.GetSlot(backBuffer) == -1, "imports have no slot");
+
+	// the game's graph today: one transient (the shadow map) has nothing to share with
+	FrameGraph game;
+	backBuffer = game.ImportTexture("Back Buffer", ColorDesc, true);
+	FrameResource shadowMap = game.CreateTexture("Shadow Map", DepthDesc);
+	unsigned int shadows = game.AddPass("Shadow Casters", 0);
+	shadowMap = game.Write(shadows, shadowMap, FrameAccess::DepthStencil);
+	unsigned int mainPass = game.AddPass("Main", 0);
+	game.Read(mainPass, shadowMap);
+	backBuffer = game.Write(mainPass, backBuffer, FrameAccess::RenderTarget);
+	Check(game.Compile() && game.GetStats().Slots == 1 && game.GetStats().SavedBytes == 0, "a lone transient saves nothing");
+	Check(game.GetSlots().size() == 1 && game.GetSlots()[0].Usage == (FrameUsageShaderResource | FrameUsageDepthStencil), "a depth slot read by shaders");
+}
+
+void CheckCulling()
+{
+	FrameGraph graph;
+	FrameResource backBuffer = graph.ImportTexture("Back Buffer", ColorDesc, true);
+	FrameResource depth = graph.ImportTexture("Depth", DepthDesc, false);
+	FrameResource unread = graph.CreateTexture("Unread", ColorDesc);
+	FrameResource chained = graph.CreateTexture("Chained", ColorDesc);
+
+	// nobody reads Unread; Chained is only read by a pass whose output nobody reads
+	unsigned int orphan = graph.AddPass("write Unread", 0);
+	unread = graph.Write(orphan, unread, FrameAccess::RenderTarget);
+	unsigned int first = graph.AddPass("write Chained", 0);
+	chained = graph.Write(first, chained, FrameAccess::RenderTarget);
+	unsigned int second = graph.AddPass("Chained to Unread", 0);
+	graph.Read(second, chained);
+	unread = graph.Write(second, unread, FrameAccess::RenderTarget);
+
+	// a non-retained import written and never read, and one that's read
+	unsigned int depthOnly = graph.AddPass("write Depth", 0);
+	depth = graph.Write(depthOnly, depth, FrameAccess::DepthStencil);
+
+	// the retained back buffer: cleared, then drawn over; nothing reads it but it's kept
+	unsigned int clear = graph.AddPass("Clear", 0);
+	backBuffer = graph.Write(clear, backBuffer, FrameAccess::CopyWrite);
+	unsigned int draw = graph.AddPass("Draw", 0);
+	backBuffer = graph.Write(draw, backBuffer, FrameAccess::RenderTarget);
+
+	// a pass with a side effect and no outputs at all
+	unsigned int present = graph.AddPass("Present", 0);
+	graph.SetSideEffect(present);
+
+	Check(graph.Compile(), "culling graph compiles");
+	Check(graph.IsCulled(orphan), "a pass writing a transient nobody reads is culled");
+	Check(graph.IsCulled(first) && graph.IsCulled(second), "and so is everything that only feeds it");
+	Check(graph.IsCulled(depthOnly), "writing a non-retained import nobody reads is culled");
+	Check(!graph.IsCulled(draw), "the last write to a retained import is kept");
+	Check(!graph.IsCulled(clear), "and what it draws over");
+	Check(!graph.IsCulled(present), "side effects are kept");
+	Check(graph.GetExecutionOrder() == Order({ clear, draw, present }), "only kept passes run, in order");
+	Check(graph.GetStats().CulledPasses == 4 && graph.GetStats().Passes == 7, "four of seven culled");
+	Check(graph.GetStats().TransientResources == 0 && graph.GetSlot(unread) == -1 && graph.GetSlots().empty(),
+		"transients only culled passes touch get no slot");
+
+	// a non-retained import still keeps the writer someone reads
+	FrameGraph read;
+	depth = read.ImportTexture("Depth", DepthDesc, false);
+	unsigned int write = read.AddPass("write Depth", 0);
+	depth = read.Write(write, depth, FrameAccess::DepthStencil);
+	unsigned int use = read.AddPass("read Depth", 0);
+	read.Read(use, depth);
+	read.SetSideEffect(use);
+	Check(read.Compile() && !read.IsCulled(write), "a non-retained import's writer is kept when it's read");
+}
+
+void CheckOrdering()
+{
+	// declared: write v1, write v2 over it, then read v1; the read has to run before v2 overwrites it
+	FrameGraph graph;
+	FrameResource cache = graph.ImportTexture("Cache", ColorDesc, true);
+	unsigned int writeOld = graph.AddPass("write v1", 0);
+	FrameResource v1 = graph.Write(writeOld, cache, FrameAccess::RenderTarget);
+	unsigned int writeNew = graph.AddPass("write v2", 0);
+	graph.Write(writeNew, v1, FrameAccess::RenderTarget);
+	unsigned int readOld = graph.AddPass("read v1", 0);
+	graph.Read(readOld, v1, FrameAccess::CopyRead);
+	graph.SetSideEffect(readOld);
+
+	Check(graph.Compile(), "write-after-read graph compiles");
+	Check(graph.GetExecutionOrder() == Order({ writeOld, readOld, writeNew }), "a reader runs before its version is written over");
+
+	// independent passes keep declaration order; dependencies win over it
+	FrameGraph deps;
+	FrameResource t = deps.CreateTexture("T", ColorDesc);
+	unsigned int reader = deps.AddPass("reader", 0);
+	unsigned int other = deps.AddPass("other", 0);
+	unsigned int writer = deps.AddPass("writer", 0);
+	t = deps.Write(writer, t, FrameAccess::RenderTarget);
+	deps.Read(reader, t);
+	deps.SetSideEffect(reader);
+	deps.SetSideEffect(other);
+	Check(deps.Compile() && deps.GetExecutionOrder() == Order({ other, writer, reader }), "a reader declared first still runs after its writer");
+}
+
+void CheckErrors()
+{
+	// two passes that each read what the other writes
+	FrameGraph cycle;
+	bool ran = false;
+	FrameResource x = cycle.CreateTexture("X", ColorDesc);
+	FrameResource y = cycle.CreateTexture("Y", ColorDesc);
+	unsigned int p0 = cycle.AddPass("p0", [&]() { ran = true; });
+	unsigned int p1 = cycle.AddPass("p1", [&]() { ran = true; });
+	x = cycle.Write(p0, x, FrameAccess::RenderTarget);
+	y = cycle.Write(p1, y, FrameAccess::RenderTarget);
+	cycle.Read(p0, y);
+	cycle.Read(p1, x);
+	cycle.SetSideEffect(p0);
+	cycle.SetSideEffect(p1);
+	Check(!cycle.Compile(), "a cycle doesn't compile");
+	Check(cycle.GetError().find("cycle") != std::string::npos && cycle.GetExecutionOrder().empty(), "and says so, with no order");
+
+	RecordingBackend backend;
+	cycle.Execute(&backend);
+	Check(!ran && backend.Log.empty(), "Execute does nothing after a failed compile");
+
+	// writing over a version something has already written over
+	FrameGraph old;
+	FrameResource v0 = old.CreateTexture("V", ColorDesc);
+	unsigned int first = old.AddPass("first", 0);
+	old.Write(first, v0, FrameAccess::RenderTarget);
+	unsigned int second = old.AddPass("second", 0);
+	old.Write(second, v0, FrameAccess::RenderTarget);
+	old.SetSideEffect(second);
+	Check(!old.Compile(), "writing an old version doesn't compile");
+	Check(old.GetError().find("second") != std::string::npos && old.GetError().find("old version") != std::string::npos,
+		"and names the pass: " + old.GetError());
+
+	// Reset clears the error
+	old.Reset();
+	unsigned int only = old.AddPass("only", 0);
+	old.SetSideEffect(only);
+	Check(old.Compile() && old.GetError().empty(), "Reset forgets the error");
+}
+
+void CheckImportUnbinds()
+{
+	// a shadow map read while drawing, then redrawn (as depth) and read again
+	FrameGraph graph;
+	FrameResource shadow = graph.ImportTexture("Shadow", DepthDesc, true);
+	FrameResource backBuffer = graph.ImportTexture("Back Buffer", ColorDesc, true);
+	unsigned int draw = graph.AddPass("draw", 0);
+	graph.Read(draw, shadow);
+	backBuffer = graph.Write(draw, backBuffer, FrameAccess::RenderTarget);
+	unsigned int redraw = graph.AddPass("redraw shadow", 0);
+	shadow = graph.Write(redraw, shadow, FrameAccess::DepthStencil);
+	unsigned int copy = graph.AddPass("copy into shadow", 0);
+	shadow = graph.Write(copy, shadow, FrameAccess::CopyWrite);
+
+	Check(graph.Compile() && graph.GetExecutionOrder() == Order({ draw, redraw, copy }), "import graph order");
+	Check(graph.UnbindsBefore(redraw), "binding an import as depth after reading it unbinds first");
+	Check(!graph.UnbindsBefore(copy), "copies don't bind anything, so don't unbind");
+	Check(graph.GetStats().ShaderResourceUnbinds == 1, "nothing's left bound after the frame");
+}
+
+int main()
+{
+	CheckAliasAfterRead();
+	CheckSlots();
+	CheckCulling();
+	CheckOrdering();
+	CheckErrors();
+	CheckImportUnbinds();
+
+	return FinishChecks();
+}
@@ -0,0 +1,89 @@
+// --------------------------------------------------------
+// Command line image based lighting bake
+//
+// Bakes (or finds in the cache) the lighting the game
+// derives from a sky's six faces, and prints how long
+// each part took
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler and SSE2, e.g.:
+//   g++ -std=c++20 -O2 -pthread -I. Tools/IBLBakeMain.cpp IBLBaker.cpp
+//       ContentHash.cpp ImageDecoder.cpp PngDecoder.cpp JpegDecoder.cpp
+//       ThreadPool.cpp -o iblbake
+//   ./iblbake [--threads N] [--size N] [--samples N] [--cache DIR]
+//             [--force] [textures/Skies]
+//
+// The directory holds right, left, up, down, front and
+// back.png; --force bakes even if the cache has it
+// --------------------------------------------------------
+#include "IBLBaker.h"
+#include "ImageDecoder.h"
+#include "ThreadPool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+int main(int argc, char** argv)
+{
+	IBLOptions options = {};
+	unsigned int threads = 0;
+	bool force = false;
+	std::string directory = "textures/Skies";
+	std::string cache = "IBLCache";
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) threads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--size" && i + 1 < argc) options.SpecularSize = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--samples" && i + 1 < argc) options.SpecularSamples = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--cache" && i + 1 < argc) cache = argv[++i];
+		else if (arg == "--force") force = true;
+		else directory = arg;
+	}
+
+	static const char* names[6] = { "right", "left", "up", "down", "front", "back" };
+	DecodedImage faces[6];
+	for (unsigned int face = 0; face < 6; face++) {
+		std::string path = (std::filesystem::path(directory) / (std::string(names[face]) + ".png")).string();
+		std::string error;
+		if (!ImageDecoder::DecodeFile(path, faces[face], error)) {
+			printf("%s: %s\n", path.c_str(), error.c_str());
+			return 1;
+		}
+	}
+
+	ThreadPool pool(threads);
+	IBLData data;
+	IBLBakeStats stats = {};
+	std::string error;
+	bool baked = force ?
+		IBLBaker::Bake(faces, options, &pool, data, stats, error) :
+		IBLBaker::LoadOrBake(faces, options, cache, &pool, data, stats, error);
+	if (!baked) {
+		printf("bake failed: %s\n", error.c_str());
+		return 1;
+	}
+	if (force) {
+		data.Key = IBLBaker::GetKey(faces, options);
+		std::filesystem::create_directories(cache);
+		if (!IBLBaker::Save(IBLBaker::GetCachePath(cache, data.Key), data, error)) printf("%s\n", error.c_str());
+	}
+
+	const IBLOptions& o = data.Options;
+	printf("Sky %ux%u on %u threads | %s %016llx\n", faces[0].Width, faces[0].Height, pool.GetThreadCount() + 1,
+		stats.FromCache ? "cached" : "baked", data.Key);
+	printf("hash %.1f ms | cache read %.1f ms | source %.1f ms | irradiance %.1f ms | specular %.1f ms | brdf %.1f ms | save %.1f ms | total %.1f ms\n",
+		stats.HashMs, stats.LoadMs, stats.SourceMs, stats.IrradianceMs, stats.SpecularMs, stats.BRDFMs, stats.SaveMs, stats.TotalMs);
+	printf("source %u^2 | specular %u^2, %u levels, %u samples | brdf %u^2, %u samples\n",
+		o.SourceSize, o.SpecularSize, o.SpecularLevels, o.SpecularSamples, o.LUTSize, o.LUTSamples);
+
+	// what a few normals would get, as a sanity check on the harmonics
+	static const float normals[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	for (unsigned int i = 0; i < 6; i++) {
+		float rgb[3];
+		IBLBaker::EvaluateIrradiance(data, normals[i], rgb);
+		printf("irradiance %-5s %.3f %.3f %.3f\n", names[i], rgb[0], rgb[1], rgb[2]);
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+// --------------------------------------------------------
+// Command line image decoding benchmark
+//
+// Decodes every PNG and JPEG under the given directories
+// (or files) with ImageDecoder, a few times each, and
+// prints the throughput per file and overall - first on
+// one thread, then every file at once on the pool
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler and SSE2, e.g.:
+//   g++ -std=c++20 -O2 -pthread -I. Tools/ImageDecodeBenchMain.cpp
+//       ImageDecoder.cpp PngDecoder.cpp JpegDecoder.cpp ThreadPool.cpp -o decodebench
+//   ./decodebench [--threads N] [--runs N] [textures ...]
+// --------------------------------------------------------
+#include "ImageDecoder.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	unsigned int threads = 0;
+	unsigned int runs = 3;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) threads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--runs" && i + 1 < argc) runs = std::max(1, atoi(argv[++i]));
+		else inputs.push_back(arg);
+	}
+	if (inputs.empty()) inputs.push_back("textures");
+
+	// every png and jpg, sorted so the output is stable
+	std::vector<std::string> files;
+	for (auto& input : inputs) {
+		std::error_code ec;
+		if (std::filesystem::is_directory(input, ec)) {
+			for (auto& entry : std::filesystem::recursive_directory_iterator(input, ec))
+				if (entry.is_regular_file() && ImageDecoder::IsSupportedExtension(entry.path().extension().string()))
+					files.push_back(entry.path().string());
+		}
+		else files.push_back(input);
+	}
+	std::sort(files.begin(), files.end());
+
+	// read everything up front, so only decoding is timed
+	std::vector<std::vector<unsigned char>> contents;
+	for (auto& file : files) {
+		std::ifstream in(file, std::ios::binary);
+		contents.emplace_back((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	}
+
+	printf("Decoding %u images, best of %u runs\n", (unsigned int)files.size(), runs);
+	printf("%-48s %11s %3s %9s %8s %8s\n", "image", "size", "ch", "decode", "MP/s", "MB/s");
+	double totalMs = 0, totalMegapixels = 0, totalMB = 0;
+	unsigned int failed = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		DecodedImage image;
+		std::string error;
+		double best = 0;
+		bool ok = true;
+		for (unsigned int run = 0; run < runs && ok; run++) {
+			auto start = Clock::now();
+			ok = ImageDecoder::Decode(contents[i].data(), contents[i].size(), image, error);
+			double t = ms(start, Clock::now());
+			best = run == 0 ? t : std::min(best, t);
+		}
+		if (!ok) {
+			printf("%-48s failed: %s\n", files[i].c_str(), error.c_str());
+			failed++;
+			continue;
+		}
+
+		// MB/s is of the compressed file, MP/s of the pixels out
+		double megapixels = (double)image.Width * image.Height / 1e6;
+		double mb = contents[i].size() / 1048576.0;
+		std::string size = std::to_string(image.Width) + "x" + std::to_string(image.Height);
+		printf("%-48s %11s %3u %7.1fms %8.1f %8.1f\n", files[i].c_str(), size.c_str(), image.SourceChannels, best,
+			megapixels / (best / 1000), mb / (best / 1000));
+		totalMs += best;
+		totalMegapixels += megapixels;
+		totalMB += mb;
+	}
+	if (totalMs > 0)
+		printf("1 thread: %.1f ms | %.1f MP/s | %.1f MB/s of files | %u failed\n",
+			totalMs, totalMegapixels / (totalMs / 1000), totalMB / (totalMs / 1000), failed);
+
+	// every file at once, as the texture load pipeline would
+	ThreadPool pool(threads);
+	double bestParallel = 0;
+	for (unsigned int run = 0; run < runs; run++) {
+		auto start = Clock::now();
+		pool.ParallelFor((unsigned int)contents.size(), [&contents](unsigned int i) {
+			DecodedImage image;
+			std::string error;
+			ImageDecoder::Decode(contents[i].data(), contents[i].size(), image, error);
+		});
+		double t = ms(start, Clock::now());
+		bestParallel = run == 0 ? t : std::min(bestParallel, t);
+	}
+	if (bestParallel > 0)
+		printf("%u threads: %.1f ms | %.1f MP/s | %.1f MB/s of files\n", pool.GetThreadCount() + 1,
+			bestParallel, totalMegapixels / (bestParallel / 1000), totalMB / (bestParallel / 1000));
+	return failed ? 1 : 0;
+}
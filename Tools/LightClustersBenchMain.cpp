@@ -0,0 +1,50 @@
+// --------------------------------------------------------
+// Command line light cluster benchmark
+//
+// Runs LightClusters::Benchmark (random point and spot
+// lights in front of a fixed camera) on one thread and then
+// on the pool, and prints the average and best Assign()
+// times along with what the assignment produced
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler and SSE2, e.g.:
+//   g++ -std=c++20 -O2 -pthread -I. Tools/LightClustersBenchMain.cpp
+//       LightClusters.cpp ThreadPool.cpp -o clusters
+//   ./clusters [--threads N] [--runs N] [--lights N] [--grid X Y Z]
+//
+// Defaults to the game's benchmark: 10000 lights, 16x9x24
+// --------------------------------------------------------
+#include "LightClusters.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+int main(int argc, char** argv)
+{
+	unsigned int threads = 0;
+	unsigned int runs = 20;
+	unsigned int lights = 10000;
+	unsigned int grid[3] = { 16, 9, 24 };
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) threads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--runs" && i + 1 < argc) runs = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--lights" && i + 1 < argc) lights = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--grid" && i + 3 < argc)
+			for (int k = 0; k < 3; k++) grid[k] = (unsigned int)std::max(1, atoi(argv[++i]));
+	}
+
+	std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(threads);
+	for (std::shared_ptr<ThreadPool> p : { std::shared_ptr<ThreadPool>(), pool }) {
+		LightClusterBenchmarkResults r = LightClusters::Benchmark(p, lights, grid[0], grid[1], grid[2], runs);
+		printf("%2u threads: %u lights, %ux%ux%u grid, %u runs | avg %.3f ms | best %.3f ms\n",
+			p ? p->GetThreadCount() + 1 : 1, r.LightCount, r.GridX, r.GridY, r.GridZ, r.Runs, r.AverageMs, r.BestMs);
+		printf("            %u indices | max %u per cluster | %u of %u clusters empty\n",
+			r.Stats.Indices, r.Stats.MaxPerCluster, r.Stats.EmptyClusters, r.Stats.Clusters);
+	}
+	return 0;
+}
@@ -0,0 +1,189 @@
+// --------------------------------------------------------
+// Headless checks for the null render backend
+//
+// Creates meshes on a NullRenderDevice, draws them into a
+// NullRenderContext and checks the recorded commands and
+// the byte counts (buffers created, alive and uploaded)
+// against what Mesh should have submitted
+//
+// Needs DirectXMath for Mesh, which is header only: it comes
+// with the Windows SDK, and elsewhere is a checkout of
+// github.com/microsoft/DirectXMath (its Inc directory, plus
+// sal.h from DirectX-Headers' include/wsl/stubs)
+//
+// Build and run from the repo root, e.g.:
+//   g++ -std=c++20 -O2 -I. -I<DirectXMath>/Inc -I<DirectX-Headers>/include/wsl/stubs
+//       Tools/NullBackendTestMain.cpp Mesh.cpp NullRenderBackend.cpp RenderInterface.cpp -o nulltest
+//   ./nulltest
+// (or every headless test at once with make -C Tools check
+// DIRECTXMATH=<DirectXMath>/Inc DXSTUBS=<DirectX-Headers>/include/wsl/stubs)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "Mesh.h"
+#include "NullRenderBackend.h"
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+bool IsCommand(const RenderCommand& c, RenderCommandType type, uint64_t handle, unsigned int a0, unsigned int a1, unsigned int a2, unsigned int bytes)
+{
+	return c.Type == type && c.Handle == handle && c.Args[0] == a0 && c.Args[1] == a1 && c.Args[2] == a2 && c.Bytes == bytes;
+}
+
+// A flat 2 x 2 grid of vertices, two triangles
+std::unique_ptr<Mesh> MakeQuad()
+{
+	Vertex vertices[4] = {};
+	vertices[0].Position = DirectX::XMFLOAT3(-1, 0, -1);
+	vertices[1].Position = DirectX::XMFLOAT3(-1, 0, 1);
+	vertices[2].Position = DirectX::XMFLOAT3(1, 0, 1);
+	vertices[3].Position = DirectX::XMFLOAT3(1, 0, -1);
+	for (Vertex& v : vertices) {
+		v.Normal = DirectX::XMFLOAT3(0, 1, 0);
+		v.UV = DirectX::XMFLOAT2(v.Position.x * 0.5f + 0.5f, v.Position.z * 0.5f + 0.5f);
+	}
+	unsigned int indices[6] = { 0, 1, 2, 0, 2, 3 };
+	return std::make_unique<Mesh>("quad", vertices, 4, indices, 6);
+}
+
+void CheckSmallMesh(NullRenderDevice& device)
+{
+	NullRenderStats before = device.GetStats();
+	std::unique_ptr<Mesh> quad = MakeQuad();
+
+	// vertices (44 bytes each), positions (12 bytes each) and 16 bit indices, all uploaded at creation
+	unsigned int bytes = 4 * sizeof(Vertex) + 4 * 12 + 6 * 2;
+	NullRenderStats created = device.GetStats();
+	Check(sizeof(Vertex) == 44, "Vertex is 44 bytes");
+	Check(created.BuffersAlive == before.BuffersAlive + 3, "quad creates 3 buffers");
+	Check(created.BytesAlive == before.BytesAlive + bytes, "quad buffers' size");
+	Check(created.BytesUploaded == before.BytesUploaded + bytes, "quad uploads every buffer's contents");
+	Check(quad->GetIndexFormat() == RenderIndexFormat::UInt16, "a small mesh gets 16 bit indices");
+	Check(quad->GetVertexCount() == 4 && quad->GetIndexCount() == 6, "quad counts");
+
+	// the main pass: full vertices, indices, one indexed draw
+	NullRenderContext context;
+	quad->Draw(&context);
+	const std::vector<RenderCommand>& commands = context.GetCommands();
+	Check(commands.size() == 3, "Draw records 3 commands");
+	if (commands.size() == 3) {
+		Check(IsCommand(commands[0], RenderCommandType::SetVertexBuffer, quad->GetVertexBuffer(), 44, 0, 0, 0), "Draw binds the vertex buffer, 44 byte stride");
+		Check(IsCommand(commands[1], RenderCommandType::SetIndexBuffer, quad->GetIndexBuffer(), (unsigned int)RenderIndexFormat::UInt16, 0, 0, 0), "Draw binds the 16 bit index buffer");
+		Check(IsCommand(commands[2], RenderCommandType::DrawIndexed, 0, 6, 0, 0, 0), "Draw draws 6 indices");
+	}
+
+	// the shadow pass: positions only, same indices
+	context.Reset();
+	quad->DrawDepthOnly(&context);
+	Check(commands.size() == 3 && IsCommand(commands[0], RenderCommandType::SetVertexBuffer, quad->GetPositionBuffer(), 12, 0, 0, 0),
+		"DrawDepthOnly binds the position buffer, 12 byte stride");
+	Check(commands.size() == 3 && IsCommand(commands[2], RenderCommandType::DrawIndexed, 0, 6, 0, 0, 0), "DrawDepthOnly draws 6 indices");
+	Check(quad->GetPositionBuffer() != quad->GetVertexBuffer(), "positions live in their own buffer");
+
+	NullRenderStats stats = context.GetStats();
+	Check(stats.Commands == 3 && stats.DrawCalls == 1 && stats.Vertices == 6, "context totals after Reset and one draw");
+
+	// meshes on the immediate context go through the device
+	device.GetNullContext()->Reset();
+	quad->Draw();
+	Check(device.GetNullContext()->GetStats().DrawCalls == 1, "Draw() with no context uses the device's immediate context");
+
+	DirectX::BoundingBox bounds = quad->GetBounds();
+	Check(bounds.Center.x == 0 && bounds.Center.y == 0 && bounds.Extents.x == 1 && bounds.Extents.y == 0 && bounds.Extents.z == 1, "quad bounds");
+
+	quad.reset();
+	NullRenderStats after = device.GetStats();
+	Check(after.BuffersAlive == before.BuffersAlive && after.BytesAlive == before.BytesAlive, "destroying the mesh releases its buffers");
+}
+
+void CheckLargeMesh(NullRenderDevice& device)
+{
+	// one more vertex than 16 bit indices can reach
+	const unsigned int count = 0x10000 + 3;
+	std::vector<Vertex> vertices(count);
+	std::vector<unsigned int> indices(count);
+	for (unsigned int i = 0; i < count; i++) {
+		vertices[i] = {};
+		vertices[i].Position = DirectX::XMFLOAT3((float)(i % 3), (float)((i / 3) % 2), (float)(i / 6) * 0.001f);
+		vertices[i].Normal = DirectX::XMFLOAT3(0, 0, -1);
+		indices[i] = i;
+	}
+
+	NullRenderStats before = device.GetStats();
+	Mesh big("big", vertices.data(), count, indices.data(), count);
+	Check(big.GetIndexFormat() == RenderIndexFormat::UInt32, "a mesh past 65536 vertices gets 32 bit indices");
+	Check(device.GetStats().BytesAlive - before.BytesAlive == (uint64_t)count * (44 + 12 + 4), "big mesh buffers' size");
+
+	NullRenderContext context;
+	big.Draw(&context);
+	const std::vector<RenderCommand>& commands = context.GetCommands();
+	Check(commands.size() == 3 && commands[1].Args[0] == (unsigned int)RenderIndexFormat::UInt32, "big mesh binds 32 bit indices");
+	Check(commands.size() == 3 && IsCommand(commands[2], RenderCommandType::DrawIndexed, 0, count, 0, 0, 0), "big mesh draws every index");
+}
+
+void CheckObjMesh(NullRenderDevice& device)
+{
+	// 24 triangles, unwelded: 3 vertices and indices each, inside [-1, 1]
+	NullRenderStats before = device.GetStats();
+	Mesh cube("cube", L"meshes/cube.obj");
+	Check(cube.GetVertexCount() == 72 && cube.GetIndexCount() == 72, "cube.obj loads 72 vertices and indices (run from the repo root)");
+	Check(device.GetStats().BytesAlive - before.BytesAlive == 72 * (44 + 12 + 2), "cube buffers' size");
+
+	DirectX::BoundingBox bounds = cube.GetBounds();
+	Check(bounds.Extents.x == 1 && bounds.Extents.y == 1 && bounds.Extents.z == 1, "cube bounds");
+
+	NullRenderContext context;
+	cube.Draw(&context);
+	cube.DrawDepthOnly(&context);
+	NullRenderStats stats = context.GetStats();
+	Check(stats.DrawCalls == 2 && stats.Vertices == 144 && stats.Commands == 6, "two cube draws");
+}
+
+void CheckUploads()
+{
+	NullRenderDevice device;
+	RenderBufferHandle constants = device.CreateBuffer(RenderBufferType::Constant, 0, 256, false);
+	Check(constants != 0, "dynamic buffer without data");
+	Check(device.CreateBuffer(RenderBufferType::Vertex, 0, 64, true) == 0, "immutable buffer without data fails");
+	Check(device.CreateBuffer(RenderBufferType::Vertex, 0, 0, false) == 0, "empty buffer fails");
+
+	float data[64] = {};
+	NullRenderContext context;
+	context.UpdateBuffer(constants, data, 256);
+	context.SetConstantBuffer(RenderShaderStage::Pixel, 2, constants);
+	context.UpdateBuffer(constants, data, 256);
+	const std::vector<RenderCommand>& commands = context.GetCommands();
+	Check(context.GetStats().BytesUploaded == 512, "buffer updates count their bytes");
+	Check(commands.size() == 3 && IsCommand(commands[0], RenderCommandType::UpdateBuffer, constants, 0, 0, 0, 256), "update command");
+	Check(commands.size() == 3 && IsCommand(commands[1], RenderCommandType::SetConstantBuffer, constants, (unsigned int)RenderShaderStage::Pixel, 2, 0, 0), "constant buffer bind");
+
+	NullRenderStats stats = device.GetStats();
+	Check(stats.BuffersAlive == 1 && stats.BytesAlive == 256 && stats.BytesUploaded == 0, "device totals");
+	RenderTextureHandle texture = device.CreateTexture2D(16, 8, RenderTextureFormat::RGBA16_Float, data);
+	Check(device.GetStats().BytesAlive == 256 + 16 * 8 * 8 && device.GetStats().BytesUploaded == 16 * 8 * 8, "texture size");
+	device.ReleaseTexture(texture);
+	device.ReleaseBuffer(constants);
+	device.ReleaseBuffer(constants);
+	Check(device.GetStats().BytesAlive == 0 && device.GetStats().BuffersAlive == 0 && device.GetStats().TexturesAlive == 0, "everything released, once");
+
+	NullRenderContext counting(false);
+	counting.DrawIndexed(36, 0, 0);
+	Check(counting.GetCommands().empty() && counting.GetStats().Commands == 1, "contexts that only count keep no commands");
+}
+
+int main()
+{
+	NullRenderDevice device;
+	Render::SetDevice(&device);
+
+	CheckSmallMesh(device);
+	CheckLargeMesh(device);
+	CheckObjMesh(device);
+	CheckUploads();
+
+	Render::SetDevice(0);
+	return FinishChecks();
+}
@@ -0,0 +1,173 @@
+// --------------------------------------------------------
+// Headless checks for parallel recording
+//
+// Records draws across the thread pool with ParallelRecorder,
+// one NullRenderContext per job (standing in for deferred
+// contexts), replays the contexts in order the way
+// DeferredRenderer executes its command lists, and checks
+// the result matches a single-threaded recording exactly
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler, e.g.:
+//   g++ -std=c++20 -O2 -pthread -I. Tools/ParallelRecorderTestMain.cpp
+//       NullRenderBackend.cpp RenderInterface.cpp ThreadPool.cpp -o recordtest
+//   ./recordtest [--threads N] [--runs N]
+// (or every headless test at once with make -C Tools check)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "NullRenderBackend.h"
+#include "ParallelRecorder.h"
+#include "ThreadPool.h"
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+// What a pass records: setup once per job, then a buffer bind and an indexed draw per item
+void Setup(IRenderContext* context)
+{
+	context->SetTopology(RenderTopology::TriangleList);
+}
+
+void DrawItem(IRenderContext* context, unsigned int item)
+{
+	context->SetVertexBuffer(item + 1, 44, 0);
+	context->DrawIndexed(3 + item, item * 3, 0);
+}
+
+// Plays a context's commands back into another, like ExecuteCommandList
+void Replay(NullRenderContext* from, IRenderContext* into)
+{
+	for (const RenderCommand& c : from->GetCommands()) {
+		switch (c.Type) {
+		case RenderCommandType::SetTopology: into->SetTopology((RenderTopology)c.Args[0]); break;
+		case RenderCommandType::SetVertexBuffer: into->SetVertexBuffer(c.Handle, c.Args[0], c.Args[1]); break;
+		case RenderCommandType::SetIndexBuffer: into->SetIndexBuffer(c.Handle, (RenderIndexFormat)c.Args[0]); break;
+		case RenderCommandType::SetConstantBuffer: into->SetConstantBuffer((RenderShaderStage)c.Args[0], c.Args[1], c.Handle); break;
+		case RenderCommandType::SetTexture: into->SetTexture((RenderShaderStage)c.Args[0], c.Args[1], c.Handle); break;
+		case RenderCommandType::UpdateBuffer: into->UpdateBuffer(c.Handle, 0, c.Bytes); break;
+		case RenderCommandType::Draw: into->Draw(c.Args[0], c.Args[1]); break;
+		case RenderCommandType::DrawIndexed: into->DrawIndexed(c.Args[0], c.Args[1], (int)c.Args[2]); break;
+		}
+	}
+}
+
+bool SameCommands(const std::vector<RenderCommand>& a, const std::vector<RenderCommand>& b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (a[i].Type != b[i].Type || a[i].Handle != b[i].Handle || a[i].Bytes != b[i].Bytes ||
+			a[i].Args[0] != b[i].Args[0] || a[i].Args[1] != b[i].Args[1] || a[i].Args[2] != b[i].Args[2])
+			return false;
+	return true;
+}
+
+void CheckPartitioning()
+{
+	// known answers
+	auto sizes = [](unsigned int items, unsigned int jobs, unsigned int minItems) {
+		std::vector<unsigned int> result;
+		for (RecordRange r : PartitionRecording(items, jobs, minItems)) result.push_back(r.End - r.Begin);
+		return result;
+	};
+	Check(sizes(10, 4, 1) == std::vector<unsigned int>({ 3, 3, 2, 2 }), "10 items, 4 jobs: remainder goes to the first jobs");
+	Check(sizes(10, 4, 5) == std::vector<unsigned int>({ 5, 5 }), "10 items, at least 5 a job: 2 jobs");
+	Check(sizes(3, 4, 8) == std::vector<unsigned int>({ 3 }), "fewer items than a job's minimum: 1 job");
+	Check(sizes(100, 1, 1) == std::vector<unsigned int>({ 100 }), "1 job gets everything");
+	Check(sizes(0, 4, 1).empty(), "no items: no jobs");
+	Check(sizes(10, 0, 1).empty(), "no contexts: no jobs");
+	Check(sizes(4, 8, 0) == std::vector<unsigned int>({ 1, 1, 1, 1 }), "a minimum of 0 acts as 1");
+
+	// every combination covers [0, items) in order, without gaps or empty jobs
+	for (unsigned int items = 0; items < 200; items++)
+		for (unsigned int jobs = 1; jobs < 12; jobs++)
+			for (unsigned int minItems = 1; minItems < 40; minItems += 3) {
+				std::vector<RecordRange> ranges = PartitionRecording(items, jobs, minItems);
+				bool ok = ranges.size() <= jobs && (items == 0) == ranges.empty();
+				unsigned int next = 0;
+				for (RecordRange r : ranges) {
+					ok = ok && r.Begin == next && r.End > r.Begin && (ranges.size() == 1 || r.End - r.Begin >= minItems);
+					next = r.End;
+				}
+				ok = ok && next == items;
+				if (!ok) {
+					Check(false, "partition of " + std::to_string(items) + " items into " + std::to_string(jobs) +
+						" jobs of at least " + std::to_string(minItems));
+					return;
+				}
+			}
+	Check(true, "partitions cover every item in order");
+}
+
+void CheckReplayOrder(ThreadPool* pool, unsigned int runs)
+{
+	const unsigned int contextCount = 8;
+	for (unsigned int items : { 1u, 7u, 64u, 1000u, 4099u }) {
+		// single threaded: one setup per job, straight into one context
+		std::vector<RecordRange> ranges = PartitionRecording(items, contextCount, 16);
+		NullRenderContext expected;
+		for (RecordRange r : ranges) {
+			Setup(&expected);
+			for (unsigned int i = r.Begin; i < r.End; i++) DrawItem(&expected, i);
+		}
+
+		for (unsigned int run = 0; run < runs; run++) {
+			std::vector<std::unique_ptr<NullRenderContext>> contexts;
+			std::vector<NullRenderContext*> pointers;
+			for (unsigned int c = 0; c < contextCount; c++) {
+				contexts.push_back(std::make_unique<NullRenderContext>());
+				pointers.push_back(contexts.back().get());
+			}
+
+			ParallelRecorder<NullRenderContext> recorder(pool, pointers);
+			unsigned int jobs = recorder.Record(items, 16, [](NullRenderContext* context, unsigned int, RecordRange range) {
+				Setup(context);
+				for (unsigned int i = range.Begin; i < range.End; i++) DrawItem(context, i);
+			});
+
+			// each job recorded its own range, into its own context
+			bool ownRange = jobs == ranges.size();
+			for (unsigned int j = 0; ownRange && j < jobs; j++) {
+				const std::vector<RenderCommand>& commands = recorder.GetContext(j)->GetCommands();
+				RecordRange r = recorder.GetRanges()[j];
+				ownRange = commands.size() == 1 + 2 * (r.End - r.Begin) &&
+					commands[1].Handle == r.Begin + 1 && commands.back().Args[1] == (r.End - 1) * 3;
+			}
+			for (unsigned int j = jobs; ownRange && j < contextCount; j++)
+				ownRange = pointers[j]->GetCommands().empty();
+
+			NullRenderContext replayed;
+			for (unsigned int j = 0; j < jobs; j++) Replay(recorder.GetContext(j), &replayed);
+
+			std::string name = std::to_string(items) + " items, run " + std::to_string(run);
+			Check(ownRange, name + ": each job recorded only its own range");
+			Check(SameCommands(replayed.GetCommands(), expected.GetCommands()), name + ": replay matches single-threaded order");
+			Check(replayed.GetStats().DrawCalls == items, name + ": every item drawn once");
+			if (failures) return;
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int threads = 0;
+	unsigned int runs = 50;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) threads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--runs" && i + 1 < argc) runs = (unsigned int)atoi(argv[++i]);
+	}
+
+	CheckPartitioning();
+
+	ThreadPool pool(threads);
+	CheckReplayOrder(0, 1);
+	CheckReplayOrder(&pool, runs);
+
+	printf("%u worker threads\n", pool.GetThreadCount());
+	return FinishChecks();
+}
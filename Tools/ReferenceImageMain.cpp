@@ -0,0 +1,295 @@
+// --------------------------------------------------------
+// Command line golden image test for the software rasterizer
+//
+// Loads a few of the game's meshes and textures, lights them
+// the way Game::CreateLights does (shadow map included),
+// renders with SoftwareRasterizer and compares the image to
+// Tools/Golden/scene.ppm, then prints triangles/s and
+// pixels/s for the best of a few frames
+//
+// Meshes load through Mesh on a NullRenderDevice, so this
+// needs DirectXMath, which is header only: it comes with the
+// Windows SDK, and elsewhere is a checkout of
+// github.com/microsoft/DirectXMath (its Inc directory, plus
+// sal.h from DirectX-Headers' include/wsl/stubs)
+//
+// Build and run from the repo root, e.g.:
+//   g++ -std=c++20 -O2 -pthread -I. -I<DirectXMath>/Inc -I<DirectX-Headers>/include/wsl/stubs
+//       Tools/ReferenceImageMain.cpp SoftwareRasterizer.cpp Mesh.cpp NullRenderBackend.cpp
+//       RenderInterface.cpp ImageDecoder.cpp PngDecoder.cpp JpegDecoder.cpp ThreadPool.cpp -o reference
+//   ./reference [--threads N] [--runs N] [--tolerance T] [--max-different F]
+//               [--out image.ppm] [--update]
+//
+// Pixels count as different when any channel is off by more
+// than T (default 2); the test fails when more than a
+// fraction F of them are (default 0.001, room for a compiler
+// rounding an edge the other way). --update rewrites the
+// golden image instead; only do that after checking the new
+// one by eye
+// --------------------------------------------------------
+#include "ImageDecoder.h"
+#include "Mesh.h"
+#include "NullRenderBackend.h"
+#include "SoftwareRasterizer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Row vector, left handed matrices, laid out like XMFLOAT4X4 (what the rasterizer expects)
+struct Matrix
+{
+	float m[16];
+};
+
+// Same as XMMatrixLookAtLH
+Matrix LookAt(const float eye[3], const float target[3], const float up[3])
+{
+	float z[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+	float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+	for (float& c : z) c /= length;
+	float x[3] = { up[1] * z[2] - up[2] * z[1], up[2] * z[0] - up[0] * z[2], up[0] * z[1] - up[1] * z[0] };
+	length = sqrtf(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+	for (float& c : x) c /= length;
+	float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+	auto dot = [&](const float* a) { return -(a[0] * eye[0] + a[1] * eye[1] + a[2] * eye[2]); };
+	return { {
+		x[0], y[0], z[0], 0,
+		x[1], y[1], z[1], 0,
+		x[2], y[2], z[2], 0,
+		dot(x), dot(y), dot(z), 1 } };
+}
+
+// Same as XMMatrixPerspectiveFovLH and XMMatrixOrthographicLH
+Matrix Perspective(float fov, float aspect, float nearZ, float farZ)
+{
+	float h = 1.0f / tanf(fov * 0.5f);
+	float r = farZ / (farZ - nearZ);
+	return { { h / aspect, 0, 0, 0, 0, h, 0, 0, 0, 0, r, 1, 0, 0, -r * nearZ, 0 } };
+}
+
+Matrix Orthographic(float width, float height, float nearZ, float farZ)
+{
+	float r = 1.0f / (farZ - nearZ);
+	return { { 2 / width, 0, 0, 0, 0, 2 / height, 0, 0, 0, 0, r, 0, 0, 0, -r * nearZ, 1 } };
+}
+
+// One thing in the scene: a mesh, scaled, turned about y and moved
+struct Placement
+{
+	const char* MeshPath;
+	float Scale[3];
+	float Yaw;
+	float Position[3];
+	int Material;
+};
+
+bool LoadTexture(const std::string& path, SoftwareTexture& texture)
+{
+	DecodedImage image;
+	std::string error;
+	if (!ImageDecoder::DecodeFile(path, image, error)) {
+		printf("%s: %s\n", path.c_str(), error.c_str());
+		return false;
+	}
+	texture.Width = image.Width;
+	texture.Height = image.Height;
+	texture.Texels = std::move(image.Pixels);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int threads = 0;
+	unsigned int runs = 5;
+	unsigned int tolerance = 2;
+	double maxDifferent = 0.001;
+	bool update = false;
+	std::string golden = "Tools/Golden/scene.ppm";
+	std::string out;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) threads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--runs" && i + 1 < argc) runs = std::max(1, atoi(argv[++i]));
+		else if (arg == "--tolerance" && i + 1 < argc) tolerance = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--max-different" && i + 1 < argc) maxDifferent = atof(argv[++i]);
+		else if (arg == "--out" && i + 1 < argc) out = argv[++i];
+		else if (arg == "--update") update = true;
+		else golden = arg;
+	}
+
+	// meshes, through the real loader, on a device that doesn't need a GPU
+	NullRenderDevice device(false);
+	Render::SetDevice(&device);
+
+	// textured bronze, textured floor, and two constant materials
+	SoftwareTexture textures[7];
+	const char* texturePaths[7] = {
+		"textures/PBR/bronze_albedo.png", "textures/PBR/bronze_normals.png", "textures/PBR/bronze_roughness.png", "textures/PBR/bronze_metal.png",
+		"textures/PBR/floor_albedo.png", "textures/PBR/floor_normals.png", "textures/PBR/floor_roughness.png" };
+	for (int i = 0; i < 7; i++)
+		if (!LoadTexture(texturePaths[i], textures[i])) return 1;
+
+	SoftwareMaterial materials[4] = {};
+	for (SoftwareMaterial& m : materials) {
+		m.ColorTint[0] = m.ColorTint[1] = m.ColorTint[2] = 1.0f;
+		m.UVScale[0] = m.UVScale[1] = 1.0f;
+		m.Roughness = 0.5f;
+	}
+	materials[0].Albedo = &textures[0]; materials[0].NormalMap = &textures[1];
+	materials[0].RoughnessMap = &textures[2]; materials[0].MetalnessMap = &textures[3];
+	materials[1].Albedo = &textures[4]; materials[1].NormalMap = &textures[5]; materials[1].RoughnessMap = &textures[6];
+	materials[2].ColorTint[0] = 0.8f; materials[2].ColorTint[1] = 0.2f; materials[2].ColorTint[2] = 0.2f;
+	materials[2].Roughness = 0.2f;
+	materials[3].ColorTint[0] = 0.2f; materials[3].ColorTint[1] = 0.4f; materials[3].ColorTint[2] = 0.9f;
+	materials[3].Roughness = 0.8f;
+
+	const Placement placements[] = {
+		{ "meshes/quad.obj", { 6, 1, 6 }, 0, { 0, -1, 0 }, 1 },
+		{ "meshes/sphere.obj", { 1.5f, 1.5f, 1.5f }, 0, { -2.5f, 0, 0 }, 0 },
+		{ "meshes/torus.obj", { 1, 1, 1 }, 0.6f, { 0, 0, 0 }, 2 },
+		{ "meshes/cube.obj", { 0.6f, 0.6f, 0.6f }, 0.8f, { 2.5f, -0.45f, 0 }, 3 },
+		{ "meshes/helix.obj", { 0.5f, 0.5f, 0.5f }, 0, { 0, 0.5f, 3 }, 0 },
+	};
+
+	std::vector<std::unique_ptr<Mesh>> meshes;
+	std::vector<SoftwareDrawItem> items;
+	for (const Placement& p : placements) {
+		std::string path = p.MeshPath;
+		meshes.push_back(std::make_unique<Mesh>(p.MeshPath, std::wstring(path.begin(), path.end())));
+		Mesh* mesh = meshes.back().get();
+		if (mesh->GetVertexCount() == 0) {
+			printf("%s: couldn't load (run from the repo root)\n", p.MeshPath);
+			return 1;
+		}
+
+		// world = scale * rotation about y * translation, and its inverse transpose (rotation / scale)
+		float c = cosf(p.Yaw), s = sinf(p.Yaw);
+		SoftwareDrawItem item = {};
+		const float world[16] = {
+			p.Scale[0] * c, 0, -p.Scale[0] * s, 0,
+			0, p.Scale[1], 0, 0,
+			p.Scale[2] * s, 0, p.Scale[2] * c, 0,
+			p.Position[0], p.Position[1], p.Position[2], 1 };
+		const float inverseTranspose[16] = {
+			c / p.Scale[0], 0, -s / p.Scale[0], 0,
+			0, 1 / p.Scale[1], 0, 0,
+			s / p.Scale[2], 0, c / p.Scale[2], 0,
+			0, 0, 0, 1 };
+		memcpy(item.World, world, sizeof(world));
+		memcpy(item.WorldInvTranspose, inverseTranspose, sizeof(inverseTranspose));
+		item.Vertices = &mesh->GetVertexData()[0].Position.x;
+		item.VertexCount = mesh->GetVertexCount();
+		item.Indices = mesh->GetIndexData().data();
+		item.IndexCount = mesh->GetIndexCount();
+		item.Material = &materials[p.Material];
+		items.push_back(item);
+	}
+
+	// the game's lights: a shadowed directional light, two fill lights, a point and a spot
+	SoftwareScene scene = {};
+	SoftwareLight light = {};
+	light.Type = 0; light.Direction[1] = -1; light.Direction[2] = 1;
+	light.Color[0] = light.Color[1] = light.Color[2] = 1; light.Intensity = 1; light.CastsShadows = 1;
+	scene.Lights.push_back(light);
+	light.Direction[0] = 1; light.Direction[1] = 1; light.Direction[2] = 0; light.CastsShadows = 0;
+	scene.Lights.push_back(light);
+	light.Direction[0] = 0; light.Direction[1] = 1; light.Direction[2] = 0;
+	scene.Lights.push_back(light);
+	SoftwareLight point = {};
+	point.Type = 1; point.Position[0] = 0; point.Position[1] = 1.5f; point.Position[2] = -1;
+	point.Range = 3; point.Intensity = 1; point.Color[0] = 1; point.Color[1] = 0.8f; point.Color[2] = 0.5f;
+	scene.Lights.push_back(point);
+	SoftwareLight spot = {};
+	spot.Type = 2; spot.Position[0] = 2.5f; spot.Position[1] = 3; spot.Direction[1] = -1;
+	spot.Range = 6; spot.Intensity = 2; spot.Color[0] = 0.5f; spot.Color[1] = 1; spot.Color[2] = 0.5f;
+	spot.SpotOuterAngle = 0.35f; spot.SpotInnerAngle = 0.17f;
+	scene.Lights.push_back(spot);
+
+	// shadow map, set up like the game's
+	const unsigned int shadowSize = 1024;
+	const float shadowEye[3] = { 0, 30, -30 }, origin[3] = { 0, 0, 0 }, up[3] = { 0, 1, 0 };
+	Matrix shadowView = LookAt(shadowEye, origin, up);
+	Matrix shadowProjection = Orthographic(10, 10, 0.1f, 100);
+
+	// camera above and in front, with the whole floor ahead of it (triangles clipped
+	// by the near plane pick up enough depth error to change with the compiler)
+	const unsigned int width = 256, height = 144;
+	const float eye[3] = { 0, 3, -7 }, target[3] = { 0, 0, 0.5f };
+	Matrix view = LookAt(eye, target, up);
+	Matrix projection = Perspective(0.785398163f, (float)width / height, 0.1f, 100);
+	memcpy(scene.View, view.m, sizeof(scene.View));
+	memcpy(scene.Projection, projection.m, sizeof(scene.Projection));
+	memcpy(scene.CameraPosition, eye, sizeof(scene.CameraPosition));
+	memcpy(scene.ShadowView, shadowView.m, sizeof(scene.ShadowView));
+	memcpy(scene.ShadowProjection, shadowProjection.m, sizeof(scene.ShadowProjection));
+
+	// render a few frames, keeping the fastest's stats
+	std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(threads);
+	SoftwareRasterizer rasterizer(pool);
+	SoftwareRasterState shadowState = { true, true, 1000, 1.0f };
+	SoftwareRasterState mainState = { true, false, 0, 0.0f };
+	SoftwareFramebuffer shadowMap, image;
+	SoftwareRasterStats best = {}, bestShadow = {};
+	for (unsigned int run = 0; run < runs; run++) {
+		shadowMap.Resize(shadowSize, shadowSize);
+		shadowMap.Clear(0, 1.0f);
+		rasterizer.RenderDepth(shadowView.m, shadowProjection.m, items, shadowState, shadowMap);
+		SoftwareRasterStats shadowStats = rasterizer.GetStats();
+
+		scene.ShadowMap = shadowMap.Depth.data();
+		scene.ShadowMapSize = shadowMap.Width;
+		scene.ShadowMapStride = shadowMap.Stride;
+		image.Resize(width, height);
+		image.Clear(0xFF664D40, 1.0f);
+		rasterizer.Render(scene, items, mainState, image);
+		SoftwareRasterStats stats = rasterizer.GetStats();
+
+		if (run == 0 || stats.Milliseconds < best.Milliseconds) best = stats;
+		if (run == 0 || shadowStats.Milliseconds < bestShadow.Milliseconds) bestShadow = shadowStats;
+	}
+	Render::SetDevice(0);
+
+	printf("Shadow map %ux%u: %llu triangles (%llu rasterized) in %.2f ms | %.2f M tris/s | %.2f M pixels/s\n",
+		shadowSize, shadowSize, (unsigned long long)bestShadow.TrianglesIn, (unsigned long long)bestShadow.TrianglesRasterized,
+		bestShadow.Milliseconds, bestShadow.TrianglesPerSecond / 1e6, bestShadow.PixelsPerSecond / 1e6);
+	printf("Scene %ux%u: %llu triangles (%llu rasterized), %llu pixels in %.2f ms | %.2f M tris/s | %.2f M pixels/s (best of %u, %u threads)\n",
+		width, height, (unsigned long long)best.TrianglesIn, (unsigned long long)best.TrianglesRasterized,
+		(unsigned long long)best.PixelsShaded, best.Milliseconds, best.TrianglesPerSecond / 1e6, best.PixelsPerSecond / 1e6,
+		runs, pool->GetThreadCount() + 1);
+
+	if (!out.empty() && !SoftwareRasterizer::SaveColor(image, out)) {
+		printf("couldn't write %s\n", out.c_str());
+		return 1;
+	}
+	if (update) {
+		if (!SoftwareRasterizer::SaveColor(image, golden)) {
+			printf("couldn't write %s\n", golden.c_str());
+			return 1;
+		}
+		printf("Wrote %s\n", golden.c_str());
+		return 0;
+	}
+
+	SoftwareFramebuffer expected;
+	if (!SoftwareRasterizer::LoadColor(expected, golden)) {
+		printf("couldn't read %s (run from the repo root, or --update to create it)\n", golden.c_str());
+		return 1;
+	}
+	if (expected.Width != width || expected.Height != height) {
+		printf("%s is %ux%u, not %ux%u\n", golden.c_str(), expected.Width, expected.Height, width, height);
+		return 1;
+	}
+	SoftwareImageDiff diff = SoftwareRasterizer::Compare(image, expected, tolerance);
+	unsigned int allowed = (unsigned int)(maxDifferent * width * height);
+	bool passed = diff.DifferentPixels <= allowed;
+	printf("vs %s: %u pixels differ by more than %u (%u allowed), max delta %u, MAE %.3f: %s\n",
+		golden.c_str(), diff.DifferentPixels, tolerance, allowed, diff.MaxChannelDelta, diff.MeanAbsoluteError, passed ? "passed" : "FAILED");
+	return passed ? 0 : 1;
+}
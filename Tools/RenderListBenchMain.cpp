@@ -0,0 +1,160 @@
+// --------------------------------------------------------
+// Command line render list benchmark
+//
+// Does what Game::BenchmarkRenderList does, without D3D:
+// walks a scene's entities the way the main pass used to
+// (a shared_ptr copy per lookup), then walks a RenderList's
+// records, then times adding everything and churning a
+// tenth of it
+//
+// RenderList only sees entities through its resolver, so
+// this file defines small stand-ins for GameEntity and what
+// it points at, shaped like the real ones (shared_ptrs all
+// the way down, handed out by value)
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler, e.g.:
+//   g++ -std=c++20 -O2 -I. Tools/RenderListBenchMain.cpp RenderList.cpp -o renderlist
+//   ./renderlist [--entities N] [--runs N]
+// --------------------------------------------------------
+#include "RenderList.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Stand-ins, padded to about the size of the real classes
+class Transform { float data[48] = {}; };
+class Mesh { float data[32] = {}; };
+class SimpleVertexShader { float data[64] = {}; };
+class SimplePixelShader { float data[64] = {}; };
+
+class Material
+{
+public:
+	Material(std::shared_ptr<SimpleVertexShader> vs, std::shared_ptr<SimplePixelShader> ps) : vs(vs), ps(ps) {}
+	std::shared_ptr<SimpleVertexShader> GetVertexShader() { return vs; }
+	std::shared_ptr<SimplePixelShader> GetPixelShader() { return ps; }
+
+private:
+	std::shared_ptr<SimpleVertexShader> vs;
+	std::shared_ptr<SimplePixelShader> ps;
+	float data[40] = {};
+};
+
+class GameEntity
+{
+public:
+	GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material) :
+		transform(std::make_shared<Transform>()), mesh(mesh), material(material) {}
+	std::shared_ptr<Mesh> GetMesh() { return mesh; }
+	std::shared_ptr<Transform> GetTransform() { return transform; }
+	std::shared_ptr<Material> GetMaterial() { return material; }
+
+	// same as the real one
+	static void ResolveDrawRecord(DrawRecord& record, GameEntity* entity)
+	{
+		std::shared_ptr<Material> material = entity->GetMaterial();
+
+		record.Entity = entity;
+		record.EntityTransform = entity->GetTransform().get();
+		record.EntityMesh = entity->GetMesh().get();
+		record.EntityMaterial = material.get();
+		record.VertexShader = material->GetVertexShader().get();
+		record.PixelShader = material->GetPixelShader().get();
+	}
+
+private:
+	std::shared_ptr<Transform> transform;
+	std::shared_ptr<Mesh> mesh;
+	std::shared_ptr<Material> material;
+};
+
+int main(int argc, char** argv)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	auto ms = [](Clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	};
+
+	unsigned int entityCount = 100000;
+	unsigned int runs = 10;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--entities" && i + 1 < argc) entityCount = std::max(10, atoi(argv[++i]));
+		else if (arg == "--runs" && i + 1 < argc) runs = std::max(1, atoi(argv[++i]));
+	}
+
+	// a scene shaped like the game's: a few meshes and materials shared by many entities
+	std::vector<std::shared_ptr<Mesh>> meshes;
+	std::vector<std::shared_ptr<Material>> materials;
+	for (int i = 0; i < 8; i++) meshes.push_back(std::make_shared<Mesh>());
+	auto vs = std::make_shared<SimpleVertexShader>();
+	for (int i = 0; i < 12; i++) materials.push_back(std::make_shared<Material>(vs, std::make_shared<SimplePixelShader>()));
+
+	std::vector<std::shared_ptr<GameEntity>> entities;
+	entities.reserve(entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+		entities.push_back(std::make_shared<GameEntity>(meshes[i % meshes.size()], materials[i % materials.size()]));
+
+	RenderListBenchmarkResults best = {};
+	uintptr_t sink = 0;
+	for (unsigned int run = 0; run < runs; run++) {
+		RenderListBenchmarkResults results = {};
+		results.EntityCount = entityCount;
+
+		// build the list
+		RenderList list(GameEntity::ResolveDrawRecord);
+		std::vector<RenderHandle> handles(entityCount);
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < entityCount; i++)
+			handles[i] = list.Add(entities[i]);
+		results.AddMs = ms(start);
+
+		// the lookups the main pass used to do per entity
+		start = Clock::now();
+		for (auto& g : entities) {
+			std::shared_ptr<SimpleVertexShader> v = g->GetMaterial()->GetVertexShader();
+			std::shared_ptr<SimplePixelShader> p = g->GetMaterial()->GetPixelShader();
+			std::shared_ptr<Transform> t = g->GetTransform();
+			std::shared_ptr<Mesh> m = g->GetMesh();
+			sink += (uintptr_t)v.get() ^ (uintptr_t)p.get() ^ (uintptr_t)t.get() ^ (uintptr_t)m.get();
+		}
+		results.EntityWalkMs = ms(start);
+
+		// same lookups from the prebuilt records
+		start = Clock::now();
+		for (const DrawRecord& r : list.GetRecords())
+			sink += (uintptr_t)r.VertexShader ^ (uintptr_t)r.PixelShader ^ (uintptr_t)r.EntityTransform ^ (uintptr_t)r.EntityMesh;
+		results.RecordWalkMs = ms(start);
+
+		// remove, re-add and update every 10th entity
+		start = Clock::now();
+		for (unsigned int i = 0; i < entityCount; i += 10) list.Remove(handles[i]);
+		for (unsigned int i = 0; i < entityCount; i += 10) handles[i] = list.Add(entities[i]);
+		for (unsigned int i = 5; i < entityCount; i += 10) list.Update(handles[i]);
+		results.ChurnMs = ms(start);
+
+		if (list.GetCount() != entityCount) {
+			printf("Render list lost entities: %u of %u\n", list.GetCount(), entityCount);
+			return 1;
+		}
+
+		// best of each, separately
+		if (run == 0) best = results;
+		best.EntityWalkMs = std::min(best.EntityWalkMs, results.EntityWalkMs);
+		best.RecordWalkMs = std::min(best.RecordWalkMs, results.RecordWalkMs);
+		best.AddMs = std::min(best.AddMs, results.AddMs);
+		best.ChurnMs = std::min(best.ChurnMs, results.ChurnMs);
+	}
+
+	printf("Render list benchmark (%u entities, best of %u runs, checksum %llu)\n", entityCount, runs, (unsigned long long)sink);
+	printf("  entity walk: %.3f ms (%.1f ns an entity) | record walk: %.3f ms (%.1f ns an entity)\n",
+		best.EntityWalkMs, best.EntityWalkMs * 1e6 / entityCount, best.RecordWalkMs, best.RecordWalkMs * 1e6 / entityCount);
+	printf("  add all: %.3f ms | 10%% churn: %.3f ms\n", best.AddMs, best.ChurnMs);
+	return 0;
+}
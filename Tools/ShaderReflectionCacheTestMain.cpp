@@ -0,0 +1,204 @@
+// --------------------------------------------------------
+// Headless checks for the shader reflection cache
+//
+// Serializes reflection data shaped like the project's
+// shaders, reads it back, and feeds Deserialize every
+// truncation of it, corrupt counts and string lengths, a
+// wrong magic and version, and a stale bytecode hash
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler, e.g.:
+//   g++ -std=c++20 -O2 -I. Tools/ShaderReflectionCacheTestMain.cpp ShaderReflectionCache.cpp -o refltest
+//   ./refltest [scratch directory]
+// (or every headless test at once with make -C Tools check)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "ShaderReflectionCache.h"
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A pixel shader's worth of everything, plus a vertex shader's inputs
+ShaderReflectionData MakeData()
+{
+	ShaderReflectionData data = {};
+	data.BytecodeHash = 0x0123456789abcdefull;
+
+	ReflectedConstantBuffer frame = { "ExternalData", 0, 0, 96, {} };
+	frame.Variables = { { "view", 0, 64 }, { "cameraPosition", 64, 12 }, { "lightCount", 76, 4 }, { "", 80, 16 } };
+	ReflectedConstantBuffer material = { "MaterialData", 0, 1, 32, {} };
+	material.Variables = { { "colorTint", 0, 16 }, { "roughness", 16, 4 } };
+	ReflectedConstantBuffer empty = { "Empty", 1, 5, 16, {} };
+	data.ConstantBuffers = { frame, material, empty };
+
+	data.ShaderResources = { { "Albedo", 0 }, { "NormalMap", 1 }, { "Lights", 12 } };
+	data.Samplers = { { "BasicSampler", 0 }, { "ShadowSampler", 1 } };
+	data.InputElements = { { "POSITION", 0, 6, false }, { "NORMAL", 0, 6, false }, { "TEXCOORD", 0, 16, false }, { "WORLD_PER_INSTANCE", 1, 2, true } };
+	return data;
+}
+
+bool Same(const ShaderReflectionData& a, const ShaderReflectionData& b)
+{
+	if (a.BytecodeHash != b.BytecodeHash || a.ConstantBuffers.size() != b.ConstantBuffers.size() ||
+		a.ShaderResources.size() != b.ShaderResources.size() || a.Samplers.size() != b.Samplers.size() ||
+		a.InputElements.size() != b.InputElements.size())
+		return false;
+
+	for (size_t i = 0; i < a.ConstantBuffers.size(); i++) {
+		const ReflectedConstantBuffer& x = a.ConstantBuffers[i];
+		const ReflectedConstantBuffer& y = b.ConstantBuffers[i];
+		if (x.Name != y.Name || x.Type != y.Type || x.BindIndex != y.BindIndex || x.Size != y.Size || x.Variables.size() != y.Variables.size())
+			return false;
+		for (size_t v = 0; v < x.Variables.size(); v++)
+			if (x.Variables[v].Name != y.Variables[v].Name || x.Variables[v].ByteOffset != y.Variables[v].ByteOffset || x.Variables[v].Size != y.Variables[v].Size)
+				return false;
+	}
+	for (size_t i = 0; i < a.ShaderResources.size(); i++)
+		if (a.ShaderResources[i].Name != b.ShaderResources[i].Name || a.ShaderResources[i].BindIndex != b.ShaderResources[i].BindIndex) return false;
+	for (size_t i = 0; i < a.Samplers.size(); i++)
+		if (a.Samplers[i].Name != b.Samplers[i].Name || a.Samplers[i].BindIndex != b.Samplers[i].BindIndex) return false;
+	for (size_t i = 0; i < a.InputElements.size(); i++) {
+		const ReflectedInputElement& x = a.InputElements[i];
+		const ReflectedInputElement& y = b.InputElements[i];
+		if (x.SemanticName != y.SemanticName || x.SemanticIndex != y.SemanticIndex || x.Format != y.Format || x.PerInstance != y.PerInstance)
+			return false;
+	}
+	return true;
+}
+
+void PutU32(std::vector<unsigned char>& bytes, size_t at, unsigned int value)
+{
+	memcpy(bytes.data() + at, &value, sizeof(value));
+}
+
+void CheckRoundTrip()
+{
+	ShaderReflectionData data = MakeData();
+	std::vector<unsigned char> bytes = ShaderReflectionCache::Serialize(data);
+
+	ShaderReflectionData read;
+	Check(ShaderReflectionCache::Deserialize(bytes.data(), bytes.size(), read), "serialized data reads back");
+	Check(Same(data, read), "everything survives the round trip");
+	Check(ShaderReflectionCache::Serialize(read) == bytes, "reserializing gives the same bytes");
+
+	// the header is magic, version, hash
+	unsigned int magic = 0;
+	unsigned int version = 0;
+	memcpy(&magic, bytes.data(), 4);
+	memcpy(&version, bytes.data() + 4, 4);
+	Check(magic == ShaderReflectionCache::Magic && version == ShaderReflectionCache::Version, "header");
+	Check(memcmp(bytes.data(), "REFL", 4) == 0, "magic reads as REFL");
+
+	// nothing at all reflected (a shader with no bindings) still round trips
+	ShaderReflectionData nothing = {};
+	nothing.BytecodeHash = 7;
+	std::vector<unsigned char> small = ShaderReflectionCache::Serialize(nothing);
+	Check(small.size() == 16 + 4 * 4, "empty data is a header and four zero counts");
+	read = data;
+	Check(ShaderReflectionCache::Deserialize(small.data(), small.size(), read) && Same(nothing, read), "empty data round trips");
+}
+
+void CheckCorrupt()
+{
+	ShaderReflectionData data = MakeData();
+	std::vector<unsigned char> bytes = ShaderReflectionCache::Serialize(data);
+
+	// every truncation fails, and leaves the output alone
+	unsigned int accepted = 0;
+	for (size_t size = 0; size < bytes.size(); size++) {
+		ShaderReflectionData read = {};
+		read.BytecodeHash = 42;
+		std::vector<unsigned char> cut(bytes.begin(), bytes.begin() + size);
+		if (ShaderReflectionCache::Deserialize(cut.data(), cut.size(), read) || read.BytecodeHash != 42 || !read.ConstantBuffers.empty())
+			accepted++;
+	}
+	Check(accepted == 0, "every truncation fails without touching the output");
+
+	// trailing bytes aren't ignored
+	std::vector<unsigned char> longer = bytes;
+	longer.push_back(0);
+	ShaderReflectionData read;
+	Check(!ShaderReflectionCache::Deserialize(longer.data(), longer.size(), read), "trailing bytes fail");
+
+	// wrong magic, wrong version
+	std::vector<unsigned char> bad = bytes;
+	bad[0] ^= 1;
+	Check(!ShaderReflectionCache::Deserialize(bad.data(), bad.size(), read), "wrong magic fails");
+	bad = bytes;
+	PutU32(bad, 4, ShaderReflectionCache::Version + 1);
+	Check(!ShaderReflectionCache::Deserialize(bad.data(), bad.size(), read), "another version fails");
+
+	// huge counts and lengths fail without trying to allocate them
+	const size_t cbCount = 16;
+	const size_t firstNameLength = 20;
+	for (unsigned int count : { 0xffffffffu, 0x10000000u, 1000u, 4u }) {
+		bad = bytes;
+		PutU32(bad, cbCount, count);
+		Check(!ShaderReflectionCache::Deserialize(bad.data(), bad.size(), read), "corrupt constant buffer count " + std::to_string(count) + " fails");
+	}
+	bad = bytes;
+	PutU32(bad, firstNameLength, 0xfffffff0u);
+	Check(!ShaderReflectionCache::Deserialize(bad.data(), bad.size(), read), "corrupt string length fails");
+
+	// 0xffffffff over each 4 byte word in turn: counts and lengths must fail, plain numbers
+	// may read, and nothing may crash or read past the end (run with -fsanitize=address)
+	unsigned int survived = 0;
+	for (size_t at = 0; at + 4 <= bytes.size(); at += 4) {
+		bad = bytes;
+		PutU32(bad, at, 0xffffffffu);
+		ShaderReflectionData anything;
+		if (ShaderReflectionCache::Deserialize(bad.data(), bad.size(), anything)) survived++;
+	}
+	Check(survived > 0, "corrupting plain numbers (offsets, sizes) still reads");
+
+	// an all-0xff file of any size is rejected
+	for (size_t size : { (size_t)16, (size_t)64, (size_t)4096 }) {
+		std::vector<unsigned char> noise(size, 0xff);
+		PutU32(noise, 0, ShaderReflectionCache::Magic);
+		PutU32(noise, 4, ShaderReflectionCache::Version);
+		Check(!ShaderReflectionCache::Deserialize(noise.data(), noise.size(), read), "0xff noise after a valid header fails");
+	}
+}
+
+void CheckFiles(const std::filesystem::path& dir)
+{
+	std::filesystem::path shader = dir / "PixelShader.cso";
+	std::filesystem::path path = ShaderReflectionCache::GetPath(shader);
+	Check(path.filename() == "PixelShader.cso.refl", "reflection lives next to the shader");
+
+	ShaderReflectionData data = MakeData();
+	ShaderReflectionData read;
+	Check(!ShaderReflectionCache::Load(path, data.BytecodeHash, read), "nothing saved yet");
+	Check(ShaderReflectionCache::Save(path, data), "saves");
+	Check(ShaderReflectionCache::Load(path, data.BytecodeHash, read) && Same(data, read), "loads what was saved");
+
+	// recompiling the shader changes its hash, and the old file is a miss
+	read = {};
+	Check(!ShaderReflectionCache::Load(path, data.BytecodeHash + 1, read), "a stale bytecode hash misses");
+	Check(read.ConstantBuffers.empty() && read.BytecodeHash == 0, "a miss leaves the output alone");
+
+	// a file cut short on disk misses too
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+	Check(!ShaderReflectionCache::Load(path, data.BytecodeHash, read), "a truncated file misses");
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path dir = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::temp_directory_path() / "ShaderReflectionCacheTest";
+	std::error_code ec;
+	std::filesystem::remove_all(dir, ec);
+	std::filesystem::create_directories(dir, ec);
+
+	CheckRoundTrip();
+	CheckCorrupt();
+	CheckFiles(dir);
+
+	std::filesystem::remove_all(dir, ec);
+	return FinishChecks();
+}
@@ -0,0 +1,250 @@
+// --------------------------------------------------------
+// Headless checks for the shader variant cache
+//
+// Runs HashKey, FindOrCompile, the index and source lookup
+// against a scratch cache directory, with a stand-in compiler
+// that counts its calls and returns bytecode made from the
+// key's defines
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler, e.g.:
+//   g++ -std=c++20 -O2 -I. Tools/ShaderVariantCacheTestMain.cpp ShaderVariants.cpp -o varianttest
+//   ./varianttest [scratch directory]
+// (or every headless test at once with make -C Tools check)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "ShaderVariants.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+unsigned int compiles = 0;
+
+// Bytecode is the defines that were on, so each variant's is different
+bool FakeCompile(const std::string& sourcePath, const ShaderVariantKey& key,
+	const std::vector<ShaderDefine>& defines, std::vector<unsigned char>& bytecode, std::string& errors)
+{
+	compiles++;
+	if (!std::filesystem::exists(sourcePath)) {
+		errors = "no such file";
+		return false;
+	}
+	bytecode.assign(key.Entry.begin(), key.Entry.end());
+	for (auto& d : defines)
+		if (d.Value == "1") bytecode.insert(bytecode.end(), d.Name.begin(), d.Name.end());
+	return true;
+}
+
+bool FailingCompile(const std::string&, const ShaderVariantKey&, const std::vector<ShaderDefine>&, std::vector<unsigned char>&, std::string& errors)
+{
+	compiles++;
+	errors = "error X3000: syntax error";
+	return false;
+}
+
+void WriteFile(const std::filesystem::path& path, const std::string& text)
+{
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out << text;
+}
+
+std::vector<std::string> ReadLines(const std::filesystem::path& path)
+{
+	std::ifstream in(path);
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(in, line)) lines.push_back(line);
+	std::sort(lines.begin(), lines.end());
+	return lines;
+}
+
+ShaderVariantKey MakeKey(unsigned int features, unsigned long long sourceHash)
+{
+	ShaderVariantKey key = {};
+	key.Source = "PixelShader.hlsl";
+	key.Entry = "main";
+	key.Profile = "ps_5_0";
+	key.Features = features;
+	key.SourceHash = sourceHash;
+	return key;
+}
+
+void CheckKeys()
+{
+	ShaderVariantKey key = MakeKey(ShaderFeatureNormalMap | ShaderFeatureShadows, 0x1234);
+	unsigned long long hash = ShaderVariantCache::HashKey(key);
+
+	// the same key always hashes the same, including a copy of it and the published FNV-1a values
+	Check(hash == ShaderVariantCache::HashKey(MakeKey(ShaderFeatureNormalMap | ShaderFeatureShadows, 0x1234)), "equal keys hash the same");
+	Check(ShaderVariantCache::Hash("", 0) == 0xcbf29ce484222325ull, "FNV-1a of nothing is the offset");
+	Check(ShaderVariantCache::Hash("a", 1) == 0xaf63dc4c8601ec8cull, "FNV-1a of \"a\"");
+	Check(ShaderVariantCache::Hash("foobar", 6) == 0x85944171f73967e8ull, "FNV-1a of \"foobar\"");
+
+	// anything that changes the bytecode changes the key
+	std::vector<ShaderVariantKey> different;
+	for (unsigned int f = 0; f <= ShaderFeaturesAll; f++)
+		if (f != key.Features) different.push_back(MakeKey(f, 0x1234));
+	ShaderVariantKey k = key; k.SourceHash = 0x1235; different.push_back(k);
+	k = key; k.Source = "Other.hlsl"; different.push_back(k);
+	k = key; k.Entry = "main2"; different.push_back(k);
+	k = key; k.Profile = "ps_5_1"; different.push_back(k);
+
+	// strings are hashed with their terminators, so moving a character between them is a different key
+	k = key; k.Source = "PixelShader.hlslm"; k.Entry = "ain"; different.push_back(k);
+
+	unsigned int collisions = 0;
+	for (auto& d : different)
+		if (ShaderVariantCache::HashKey(d) == hash) collisions++;
+	Check(collisions == 0, "features, source, entry, profile and source hash all change the key");
+
+	// all 256 feature sets get their own key
+	std::vector<unsigned long long> hashes;
+	for (unsigned int f = 0; f <= ShaderFeaturesAll; f++) hashes.push_back(ShaderVariantCache::HashKey(MakeKey(f, 0x1234)));
+	std::sort(hashes.begin(), hashes.end());
+	Check(std::adjacent_find(hashes.begin(), hashes.end()) == hashes.end(), "every feature set has its own key");
+
+	// defines: one per feature, in bit order
+	std::vector<ShaderDefine> defines = ShaderVariantCache::GetDefines(ShaderFeatureNormalMap | ShaderFeatureImageLighting);
+	Check(defines.size() == ShaderFeatureCount, "a define for every feature");
+	Check(defines.size() == ShaderFeatureCount && defines[0].Name == "HAS_NORMAL_MAP" && defines[0].Value == "1"
+		&& defines[1].Value == "0" && defines[7].Name == "IMAGE_LIGHTING" && defines[7].Value == "1", "defines follow the feature bits");
+	Check(ShaderVariantCache::DescribeFeatures(0) == "none" && ShaderVariantCache::DescribeFeatures(ShaderFeatureNormalMap | ShaderFeatureShadows) == "normal+shadows",
+		"feature descriptions");
+}
+
+void CheckSourceHash(const std::filesystem::path& dir)
+{
+	std::filesystem::path source = dir / "Test.hlsl";
+	std::filesystem::path include = dir / "test.hlsli";
+	WriteFile(source, "#include \"test.hlsli\"\nfloat4 main() : SV_TARGET { return 1; }\n");
+	WriteFile(include, "cbuffer A : register(b0) { float4 x; }\n");
+
+	unsigned long long first = ShaderVariantCache::HashSourceFile(source.string());
+	Check(first != 0, "an existing source hashes to something");
+	Check(first == ShaderVariantCache::HashSourceFile(source.string()), "hashing a source again gives the same hash");
+
+	// editing only the include changes the hash
+	WriteFile(include, "cbuffer A : register(b0) { float4 y; }\n");
+	Check(ShaderVariantCache::HashSourceFile(source.string()) != first, "editing an include changes the source hash");
+	Check(ShaderVariantCache::HashSourceFile((dir / "Missing.hlsl").string()) == 0, "a missing source hashes to 0");
+
+	// finding the source: first candidate that exists, empty when none do
+	std::string missing = (dir / "nowhere" / "Test.hlsl").string();
+	Check(ShaderVariantCache::FindSourceFile({ missing, source.string() }) == source.string(), "source found in the second place looked");
+	Check(ShaderVariantCache::FindSourceFile({ source.string(), missing }) == source.string(), "the first place that has it wins");
+	Check(ShaderVariantCache::FindSourceFile({ missing, dir.string() }).empty(), "directories aren't sources");
+	Check(ShaderVariantCache::FindSourceFile({}).empty(), "nowhere to look finds nothing");
+}
+
+void CheckCache(const std::filesystem::path& dir)
+{
+	std::filesystem::path source = dir / "PixelShader.hlsl";
+	WriteFile(source, "float4 main() : SV_TARGET { return 1; }\n");
+	std::filesystem::path cacheDir = dir / "ShaderCache";
+	unsigned long long sourceHash = ShaderVariantCache::HashSourceFile(source.string());
+
+	ShaderVariantKey plain = MakeKey(0, sourceHash);
+	ShaderVariantKey normal = MakeKey(ShaderFeatureNormalMap, sourceHash);
+	std::string plainPath;
+	std::string normalPath;
+	{
+		ShaderVariantCache cache(cacheDir.string());
+		Check(!cache.LoadIndex(), "a new cache has no index");
+		Check(cache.Find(plain).empty(), "an empty cache finds nothing");
+
+		// misses compile once, then hit
+		compiles = 0;
+		plainPath = cache.FindOrCompile(source.string(), plain, FakeCompile);
+		normalPath = cache.FindOrCompile(source.string(), normal, FakeCompile);
+		Check(!plainPath.empty() && !normalPath.empty() && plainPath != normalPath, "two variants, two files");
+		Check(compiles == 2, "each miss compiles");
+		Check(cache.FindOrCompile(source.string(), plain, FakeCompile) == plainPath && compiles == 2, "a hit doesn't compile");
+		Check(plainPath == cache.GetPath(plain) && std::filesystem::exists(plainPath), "variant stored where GetPath says");
+		Check(std::filesystem::file_size(normalPath) == std::string("mainHAS_NORMAL_MAP").size(), "the compiler got the key's defines");
+
+		ShaderVariantCacheStats s = cache.GetStats();
+		Check(s.Entries == 2 && s.Compiled == 2 && s.Hits == 1 && s.Misses == 3 && s.Failed == 0, "stats after two compiles and a hit");
+		Check(cache.SaveIndex(), "index saves");
+	}
+
+	// a new cache on the same directory picks everything up from the index
+	{
+		ShaderVariantCache cache(cacheDir.string());
+		Check(cache.LoadIndex() && cache.GetStats().Entries == 2, "index loads both variants");
+		compiles = 0;
+		Check(cache.FindOrCompile(source.string(), plain, FakeCompile) == plainPath, "variant found after reloading");
+		Check(cache.FindOrCompile(source.string(), normal, FakeCompile) == normalPath, "second variant found after reloading");
+		Check(compiles == 0, "nothing recompiled after reloading");
+
+		// saving again writes the same lines (in whatever order the map has them)
+		std::vector<std::string> first = ReadLines(cacheDir / "index.txt");
+		cache.SaveIndex();
+		std::vector<std::string> second = ReadLines(cacheDir / "index.txt");
+		Check(first.size() == 2 && first == second, "index round trips unchanged");
+	}
+
+	// an index entry whose .cso is gone is a miss, and gets recompiled
+	{
+		std::filesystem::remove(normalPath);
+		ShaderVariantCache cache(cacheDir.string());
+		cache.LoadIndex();
+		Check(cache.Find(normal).empty(), "a missing .cso is a miss even though it's in the index");
+		compiles = 0;
+		Check(cache.FindOrCompile(source.string(), normal, FakeCompile) == normalPath && compiles == 1, "a missing .cso is compiled again");
+		Check(std::filesystem::exists(normalPath), "and stored again");
+	}
+
+	// a .cso without an index entry isn't trusted either
+	{
+		std::filesystem::remove(cacheDir / "index.txt");
+		ShaderVariantCache cache(cacheDir.string());
+		Check(!cache.LoadIndex() && cache.Find(plain).empty(), "a .cso missing from the index is a miss");
+	}
+
+	// editing the source makes a new key, so the old variant isn't found
+	{
+		ShaderVariantCache cache(cacheDir.string());
+		cache.FindOrCompile(source.string(), plain, FakeCompile);
+		WriteFile(source, "float4 main() : SV_TARGET { return 0.5; }\n");
+		ShaderVariantKey edited = MakeKey(0, ShaderVariantCache::HashSourceFile(source.string()));
+		Check(cache.Find(edited).empty(), "an edited source misses");
+		compiles = 0;
+		std::string editedPath = cache.FindOrCompile(source.string(), edited, FakeCompile);
+		Check(compiles == 1 && !editedPath.empty() && editedPath != plainPath, "an edited source compiles to a new file");
+	}
+
+	// failures: reported, counted and not stored
+	{
+		ShaderVariantCache cache(cacheDir.string());
+		ShaderVariantKey broken = MakeKey(ShaderFeatureShadows, sourceHash);
+		compiles = 0;
+		Check(cache.FindOrCompile(source.string(), broken, FailingCompile).empty() && compiles == 1, "a failed compile gives no path");
+		Check(cache.GetLastError().find("X3000") != std::string::npos && cache.GetLastError().find("shadows") != std::string::npos,
+			"the error has the compiler's message and the features");
+		Check(cache.GetStats().Failed == 1 && cache.GetStats().Entries == 0, "a failed compile isn't stored");
+		Check(!std::filesystem::exists(cache.GetPath(broken)), "no file for a failed compile");
+		Check(cache.FindOrCompile(source.string(), broken, ShaderCompileFunction()).empty(), "no compiler, no variant");
+		Check(cache.FindOrCompile((dir / "Missing.hlsl").string(), broken, FakeCompile).empty(), "no source, no variant");
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path dir = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::temp_directory_path() / "ShaderVariantCacheTest";
+	std::error_code ec;
+	std::filesystem::remove_all(dir, ec);
+	std::filesystem::create_directories(dir, ec);
+
+	CheckKeys();
+	CheckSourceHash(dir);
+	CheckCache(dir);
+
+	std::filesystem::remove_all(dir, ec);
+	return FinishChecks();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// --------------------------------------------------------
+// What every headless test in Tools/ reports through
+//
+// - Check() counts one check, and prints it if it failed
+// - FinishChecks() prints the tally and is main's exit
+//   code: 1 if anything failed
+// - Header only, so a test still builds from one g++ line
+//   (and Tools/Makefile builds and runs all of them)
+// --------------------------------------------------------
+inline unsigned int checks = 0;
+inline unsigned int failures = 0;
+
+inline void Check(bool ok, const std::string& what)
+{
+	checks++;
+	if (ok) return;
+	printf("FAILED: %s\n", what.c_str());
+	failures++;
+}
+
+inline int FinishChecks()
+{
+	printf("%u of %u checks passed\n", checks - failures, checks);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+// --------------------------------------------------------
+// Headless checks for TextureAnalysis
+//
+// Runs GetRange, GetAverage, IsUniform and PackORM on
+// random images of every size from 0 to 40 pixels (so every
+// count that isn't a multiple of 4 and every SSE2 tail) plus
+// some real texture sizes, and compares each against plain
+// scalar code; then checks PackORM's constants, missing maps
+// and mismatched map sizes
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler and SSE2, e.g.:
+//   g++ -std=c++20 -O2 -I. Tools/TextureAnalysisTestMain.cpp TextureAnalysis.cpp -o analysistest
+//   ./analysistest
+// (or every headless test at once with make -C Tools check)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "TextureAnalysis.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+std::mt19937 rng(1234);
+
+// Random pixels, each channel kept inside [low, low + spread]
+DecodedImage MakeImage(unsigned int width, unsigned int height, unsigned int low = 0, unsigned int spread = 255)
+{
+	DecodedImage image = {};
+	image.Width = width;
+	image.Height = height;
+	image.SourceChannels = 4;
+	image.Pixels.resize((size_t)width * height * 4);
+	for (auto& p : image.Pixels) p = (unsigned char)(low + rng() % (spread + 1));
+	return image;
+}
+
+std::string Size(const DecodedImage& image)
+{
+	return std::to_string(image.Width) + "x" + std::to_string(image.Height);
+}
+
+// --------------------------------------------------------
+// Scalar versions, one pixel at a time
+// --------------------------------------------------------
+TextureChannelRange ScalarRange(const DecodedImage& image)
+{
+	TextureChannelRange range = { { 255, 255, 255, 255 }, { 0, 0, 0, 0 } };
+	for (size_t i = 0; i < image.Pixels.size(); i++) {
+		unsigned char v = image.Pixels[i];
+		if (v < range.Min[i % 4]) range.Min[i % 4] = v;
+		if (v > range.Max[i % 4]) range.Max[i % 4] = v;
+	}
+	return range;
+}
+
+void ScalarAverage(const DecodedImage& image, double* average)
+{
+	double sums[4] = {};
+	for (size_t i = 0; i < image.Pixels.size(); i++) sums[i % 4] += image.Pixels[i];
+	size_t pixels = image.Pixels.size() / 4;
+	for (int c = 0; c < 4; c++) average[c] = pixels ? sums[c] / pixels / 255.0 : 0.0;
+}
+
+std::vector<unsigned char> ScalarORM(const DecodedImage* maps[3], const unsigned char constants[3], size_t pixels)
+{
+	std::vector<unsigned char> packed(pixels * 4);
+	for (size_t i = 0; i < pixels; i++) {
+		for (int m = 0; m < 3; m++) packed[i * 4 + m] = maps[m] ? maps[m]->Pixels[i * 4] : constants[m];
+		packed[i * 4 + 3] = 255;
+	}
+	return packed;
+}
+
+bool SameRange(const TextureChannelRange& a, const TextureChannelRange& b)
+{
+	for (int c = 0; c < 4; c++)
+		if (a.Min[c] != b.Min[c] || a.Max[c] != b.Max[c]) return false;
+	return true;
+}
+
+// Every width from 0 to 40 (one row), some odd rectangles and real texture sizes
+std::vector<DecodedImage> TestImages(unsigned int low = 0, unsigned int spread = 255)
+{
+	std::vector<DecodedImage> images;
+	for (unsigned int w = 0; w <= 40; w++) images.push_back(MakeImage(w, 1, low, spread));
+	for (unsigned int h : { 3u, 5u, 7u }) images.push_back(MakeImage(13, h, low, spread));
+	images.push_back(MakeImage(256, 256, low, spread));
+	images.push_back(MakeImage(1023, 3, low, spread));
+	return images;
+}
+
+void CheckRange()
+{
+	for (const DecodedImage& image : TestImages())
+		Check(SameRange(TextureAnalysis::GetRange(image), ScalarRange(image)), "GetRange matches scalar at " + Size(image));
+	for (const DecodedImage& image : TestImages(100, 20))
+		Check(SameRange(TextureAnalysis::GetRange(image), ScalarRange(image)), "GetRange matches scalar, narrow values, at " + Size(image));
+
+	// an extreme in the very last byte of a tail
+	DecodedImage image = MakeImage(7, 1, 50, 10);
+	image.Pixels[27] = 0;
+	image.Pixels[26] = 255;
+	TextureChannelRange range = TextureAnalysis::GetRange(image);
+	Check(range.Min[3] == 0 && range.Max[2] == 255, "extremes in the tail are found");
+
+	// and in the first register of an image with no tail
+	image = MakeImage(8, 1, 50, 10);
+	image.Pixels[0] = 3;
+	range = TextureAnalysis::GetRange(image);
+	Check(range.Min[0] == 3 && range.Min[1] >= 50, "extremes in the first register stay in their channel");
+}
+
+void CheckAverage()
+{
+	for (const DecodedImage& image : TestImages()) {
+		float simd[4];
+		double scalar[4];
+		TextureAnalysis::GetAverage(image, simd);
+		ScalarAverage(image, scalar);
+		bool close = true;
+		for (int c = 0; c < 4; c++) close = close && std::fabs(simd[c] - scalar[c]) < 1e-6;
+		Check(close, "GetAverage matches scalar at " + Size(image));
+	}
+
+	// a 4096x4096 white image doesn't overflow the sums
+	DecodedImage white = {};
+	white.Width = white.Height = 4096;
+	white.Pixels.assign((size_t)4096 * 4096 * 4, 255);
+	float average[4];
+	TextureAnalysis::GetAverage(white, average);
+	Check(average[0] == 1.0f && average[1] == 1.0f && average[2] == 1.0f && average[3] == 1.0f, "a large white image averages to 1");
+}
+
+void CheckUniform()
+{
+	for (const DecodedImage& image : TestImages(120, 4)) {
+		float value = -1;
+		double scalar[4];
+		ScalarAverage(image, scalar);
+		bool uniform = TextureAnalysis::IsUniform(image, 4, 4, &value);
+		if (image.Pixels.empty()) {
+			Check(!uniform, "an empty image isn't uniform");
+			continue;
+		}
+		Check(uniform, "values within the tolerance are uniform at " + Size(image));
+		Check(std::fabs(value - scalar[0]) < 1e-6, "the uniform value is the first channel's average at " + Size(image));
+		Check(TextureAnalysis::IsUniform(image, 1, 4, 0), "no value pointer is fine");
+	}
+
+	// one byte out of range anywhere, including the scalar tail, breaks it, but only in the channels asked about
+	for (unsigned int width : { 2u, 3u, 4u, 5u, 9u, 16u, 17u }) {
+		for (unsigned int pixel : { 0u, width - 1 }) {
+			for (unsigned int c = 0; c < 4; c++) {
+				DecodedImage image = MakeImage(width, 1, 100, 0);
+				image.Pixels[pixel * 4 + c] = 105;
+				std::string where = std::to_string(width) + " wide, pixel " + std::to_string(pixel) + ", channel " + std::to_string(c);
+				Check(!TextureAnalysis::IsUniform(image, 4, 4, 0), "5 off is over a tolerance of 4: " + where);
+				Check(TextureAnalysis::IsUniform(image, 4, 5, 0), "5 off is within a tolerance of 5: " + where);
+				Check(TextureAnalysis::IsUniform(image, c, 0, 0), "channels past the ones asked about are ignored: " + where);
+			}
+		}
+	}
+}
+
+void CheckPackORM()
+{
+	const unsigned char constants[3] = { 255, 128, 7 };
+
+	// every combination of present and missing maps, on every test size
+	for (unsigned int present = 1; present < 8; present++) {
+		std::vector<DecodedImage> sources[3] = { TestImages(), TestImages(), TestImages() };
+		for (size_t n = 0; n < sources[0].size(); n++) {
+			const DecodedImage* maps[3] = {};
+			for (int m = 0; m < 3; m++) if (present & (1u << m)) maps[m] = &sources[m][n];
+			const DecodedImage& any = sources[0][n];
+			DecodedImage packed = TextureAnalysis::PackORM(maps, constants);
+			std::string what = "maps " + std::to_string(present) + " at " + Size(any);
+
+			Check(packed.Width == any.Width && packed.Height == any.Height && packed.SourceChannels == 3, "packed size: " + what);
+			Check(packed.Pixels == ScalarORM(maps, constants, (size_t)any.Width * any.Height), "PackORM matches scalar: " + what);
+		}
+	}
+
+	// no maps at all is nothing to pack
+	const DecodedImage* none[3] = {};
+	DecodedImage packed = TextureAnalysis::PackORM(none, constants);
+	Check(packed.Width == 0 && packed.Height == 0 && packed.Pixels.empty(), "no maps, no image");
+
+	// mismatched sizes, in every pair and with a missing map between them
+	DecodedImage a = MakeImage(16, 16);
+	DecodedImage wide = MakeImage(32, 16);
+	DecodedImage tall = MakeImage(16, 32);
+	DecodedImage same = MakeImage(16, 16);
+	const DecodedImage* pairs[][3] = {
+		{ &a, &wide, 0 }, { &a, 0, &tall }, { 0, &a, &wide }, { &a, &same, &tall }, { &wide, &a, &a }, { &a, &a, &wide }
+	};
+	for (auto& maps : pairs) {
+		packed = TextureAnalysis::PackORM(maps, constants);
+		Check(packed.Width == 0 && packed.Height == 0 && packed.Pixels.empty(), "mismatched map sizes give an empty image");
+	}
+
+	// the same pixel count in a different shape still doesn't match
+	DecodedImage flat = MakeImage(64, 4);
+	const DecodedImage* reshaped[3] = { &a, &flat, 0 };
+	Check(TextureAnalysis::PackORM(reshaped, constants).Pixels.empty(), "16x16 and 64x4 don't pack together");
+
+	// only each map's red channel is used
+	DecodedImage red = MakeImage(5, 1, 0, 0);
+	for (size_t i = 0; i < red.Pixels.size(); i += 4) { red.Pixels[i] = 200; red.Pixels[i + 1] = red.Pixels[i + 2] = red.Pixels[i + 3] = 9; }
+	const DecodedImage* redOnly[3] = { 0, &red, 0 };
+	packed = TextureAnalysis::PackORM(redOnly, constants);
+	bool reds = packed.Pixels.size() == 20;
+	for (size_t i = 0; reds && i < 20; i += 4)
+		reds = packed.Pixels[i] == 255 && packed.Pixels[i + 1] == 200 && packed.Pixels[i + 2] == 7 && packed.Pixels[i + 3] == 255;
+	Check(reds, "roughness's red goes to green, the rest are constants and alpha is opaque");
+}
+
+int main()
+{
+	CheckRange();
+	CheckAverage();
+	CheckUniform();
+	CheckPackORM();
+
+	return FinishChecks();
+}
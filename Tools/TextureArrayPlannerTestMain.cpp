@@ -0,0 +1,166 @@
+// --------------------------------------------------------
+// Headless checks for the texture array planner
+//
+// Feeds TextureArrayPlanner::Plan small material lists with
+// known answers: grouping by size, mips and format slot by
+// slot, sets split at maxLayers, sets dropped under
+// minMaterials and materials with no maps left out
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler, e.g.:
+//   g++ -std=c++20 -O2 -I. Tools/TextureArrayPlannerTestMain.cpp TextureArrayPlanner.cpp -o arraytest
+//   ./arraytest
+// (or every headless test at once with make -C Tools check)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "TextureArrayPlanner.h"
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// DXGI_FORMAT values, as the game passes them
+const unsigned int RGBA8 = 28;
+const unsigned int RGBA8_SRGB = 29;
+const unsigned int BC7 = 98;
+
+typedef std::vector<TextureArrayInput> Material;
+
+// albedo, normal and roughness maps, all the same size
+Material Maps(unsigned int size, unsigned int mips, unsigned int format = RGBA8)
+{
+	return { { size, size, mips, format }, { size, size, mips, format }, { size, size, mips, format } };
+}
+
+bool PlacedAt(const TextureArrayPlan& plan, unsigned int material, int set, unsigned int layer)
+{
+	return material < plan.Placements.size() && plan.Placements[material].Set == set && plan.Placements[material].Layer == layer;
+}
+
+bool Unplaced(const TextureArrayPlan& plan, unsigned int material)
+{
+	return material < plan.Placements.size() && plan.Placements[material].Set == -1;
+}
+
+void CheckGrouping()
+{
+	// 0, 2 and 4 match; 1 and 3 match; 5 differs from both only in mips, 6 only in format
+	std::vector<Material> materials = {
+		Maps(512, 10), Maps(256, 9), Maps(512, 10), Maps(256, 9), Maps(512, 10), Maps(512, 9), Maps(512, 10, BC7)
+	};
+	TextureArrayPlan plan = TextureArrayPlanner::Plan(materials);
+
+	Check(plan.Placements.size() == materials.size(), "a placement for every material");
+	Check(plan.Sets.size() == 2, "two sets");
+	if (plan.Sets.size() == 2) {
+		Check(plan.Sets[0].Materials == std::vector<unsigned int>({ 0, 2, 4 }), "the 512 set holds 0, 2 and 4 in order");
+		Check(plan.Sets[1].Materials == std::vector<unsigned int>({ 1, 3 }), "the 256 set holds 1 and 3");
+		Check(plan.Sets[0].Slots.size() == 3 && TextureArrayPlanner::Matches(plan.Sets[0].Slots[0], { 512, 512, 10, RGBA8 }), "the set keeps its slots' layout");
+	}
+	Check(PlacedAt(plan, 0, 0, 0) && PlacedAt(plan, 2, 0, 1) && PlacedAt(plan, 4, 0, 2), "layers follow the input order");
+	Check(PlacedAt(plan, 1, 1, 0) && PlacedAt(plan, 3, 1, 1), "second set's layers");
+	Check(Unplaced(plan, 5), "different mips don't share");
+	Check(Unplaced(plan, 6), "different formats don't share");
+	Check(plan.PackedMaterials == 5, "five packed");
+	Check(plan.PackedBytes == 3ull * 3 * 512 * 512 * 4 + 2ull * 3 * 256 * 256 * 4, "packed bytes count every slot's top mip");
+
+	// a match has to hold in every slot, not just the first
+	Material odd = Maps(512, 10);
+	odd[2].Format = RGBA8_SRGB;
+	Material wide = Maps(512, 10);
+	wide[1].Width = 1024;
+	Material tall = Maps(512, 10);
+	tall[1].Height = 1024;
+	Material fewer = Maps(512, 10);
+	fewer.pop_back();
+	plan = TextureArrayPlanner::Plan({ Maps(512, 10), odd, wide, tall, fewer, Maps(512, 10) });
+	Check(plan.Sets.size() == 1 && plan.Sets[0].Materials == std::vector<unsigned int>({ 0, 5 }), "only materials that match in every slot share");
+	Check(Unplaced(plan, 1) && Unplaced(plan, 2) && Unplaced(plan, 3) && Unplaced(plan, 4), "a different format, width, height or slot count in any slot stays out");
+
+	// non-square textures are fine as long as they match
+	Material rect = { { 1024, 256, 11, RGBA8 } };
+	plan = TextureArrayPlanner::Plan({ rect, rect, { { 256, 1024, 11, RGBA8 } } });
+	Check(plan.Sets.size() == 1 && plan.Sets[0].Materials.size() == 2 && Unplaced(plan, 2), "1024x256 and 256x1024 don't share");
+}
+
+void CheckMaxLayers()
+{
+	// seven matching materials, three to an array: 3 + 3 + 1, and the last is too small to keep
+	std::vector<Material> materials(7, Maps(128, 8));
+	TextureArrayPlan plan = TextureArrayPlanner::Plan(materials, 3, 2);
+	Check(plan.Sets.size() == 2, "seven materials at three layers make two full sets");
+	if (plan.Sets.size() == 2) {
+		Check(plan.Sets[0].Materials == std::vector<unsigned int>({ 0, 1, 2 }), "first set is full");
+		Check(plan.Sets[1].Materials == std::vector<unsigned int>({ 3, 4, 5 }), "second set is full");
+	}
+	Check(PlacedAt(plan, 3, 1, 0) && PlacedAt(plan, 5, 1, 2), "layers restart in each set");
+	Check(Unplaced(plan, 6), "the one left over is under minMaterials");
+	Check(plan.PackedMaterials == 6, "six packed");
+
+	// with minMaterials 1 the leftover gets its own set
+	plan = TextureArrayPlanner::Plan(materials, 3, 1);
+	Check(plan.Sets.size() == 3 && PlacedAt(plan, 6, 2, 0), "minMaterials 1 keeps the leftover");
+
+	// a full set closes, but a different layout between doesn't disturb it
+	materials = { Maps(128, 8), Maps(64, 7), Maps(128, 8), Maps(64, 7), Maps(128, 8) };
+	plan = TextureArrayPlanner::Plan(materials, 2, 1);
+	Check(plan.Sets.size() == 3 && PlacedAt(plan, 0, 0, 0) && PlacedAt(plan, 2, 0, 1) && PlacedAt(plan, 1, 1, 0)
+		&& PlacedAt(plan, 3, 1, 1) && PlacedAt(plan, 4, 2, 0), "interleaved layouts split independently");
+
+	// one layer per array means nothing shares, and zero layers means nothing at all
+	plan = TextureArrayPlanner::Plan(std::vector<Material>(4, Maps(128, 8)), 1, 2);
+	Check(plan.Sets.empty() && plan.PackedMaterials == 0, "maxLayers 1 leaves every set under minMaterials 2");
+	plan = TextureArrayPlanner::Plan(std::vector<Material>(4, Maps(128, 8)), 0, 1);
+	Check(plan.Sets.empty() && plan.Placements.size() == 4 && Unplaced(plan, 0) && Unplaced(plan, 3), "maxLayers 0 plans nothing");
+
+	// the D3D11 limit
+	plan = TextureArrayPlanner::Plan(std::vector<Material>(2049, Maps(4, 1)));
+	Check(plan.Sets.size() == 1 && plan.Sets[0].Materials.size() == 2048 && Unplaced(plan, 2048), "2049 materials: one full array of 2048, one left over");
+}
+
+void CheckMinMaterials()
+{
+	std::vector<Material> materials = { Maps(512, 10), Maps(512, 10), Maps(512, 10), Maps(256, 9), Maps(256, 9), Maps(128, 8) };
+
+	// sets of 3, 2 and 1
+	Check(TextureArrayPlanner::Plan(materials, 2048, 1).Sets.size() == 3, "minMaterials 1 keeps all three sets");
+	Check(TextureArrayPlanner::Plan(materials, 2048, 2).Sets.size() == 2, "minMaterials 2 drops the single");
+	TextureArrayPlan plan = TextureArrayPlanner::Plan(materials, 2048, 3);
+	Check(plan.Sets.size() == 1 && plan.PackedMaterials == 3, "minMaterials 3 keeps only the set of 3");
+	Check(Unplaced(plan, 3) && Unplaced(plan, 4) && Unplaced(plan, 5), "dropped sets' materials are unplaced");
+	Check(plan.PackedBytes == 3ull * 3 * 512 * 512 * 4, "dropped sets don't count bytes");
+	Check(TextureArrayPlanner::Plan(materials, 2048, 4).Sets.empty(), "minMaterials 4 keeps nothing");
+
+	// set indices stay dense when one in the middle is dropped
+	materials = { Maps(512, 10), Maps(256, 9), Maps(128, 8), Maps(512, 10), Maps(128, 8) };
+	plan = TextureArrayPlanner::Plan(materials, 2048, 2);
+	Check(plan.Sets.size() == 2 && PlacedAt(plan, 2, 1, 0) && PlacedAt(plan, 4, 1, 1) && Unplaced(plan, 1), "kept sets are numbered without gaps");
+}
+
+void CheckEmpty()
+{
+	// materials with no maps (a flat color) are skipped without breaking anyone else's layers
+	std::vector<Material> materials = { Material(), Maps(256, 9), Material(), Maps(256, 9), Material() };
+	TextureArrayPlan plan = TextureArrayPlanner::Plan(materials);
+	Check(plan.Placements.size() == 5, "a placement even for materials with no maps");
+	Check(Unplaced(plan, 0) && Unplaced(plan, 2) && Unplaced(plan, 4), "no maps, no array");
+	Check(plan.Sets.size() == 1 && PlacedAt(plan, 1, 0, 0) && PlacedAt(plan, 3, 0, 1), "the others still share");
+
+	// all empty, and nothing at all
+	plan = TextureArrayPlanner::Plan(std::vector<Material>(3), 2048, 1);
+	Check(plan.Sets.empty() && plan.PackedMaterials == 0 && plan.PackedBytes == 0, "only empty materials plan nothing, even at minMaterials 1");
+	plan = TextureArrayPlanner::Plan({});
+	Check(plan.Sets.empty() && plan.Placements.empty(), "no materials, no plan");
+}
+
+int main()
+{
+	CheckGrouping();
+	CheckMaxLayers();
+	CheckMinMaterials();
+	CheckEmpty();
+
+	return FinishChecks();
+}
@@ -0,0 +1,121 @@
+// --------------------------------------------------------
+// Command line texture cooker
+//
+// Cooks every PNG and JPEG under the given directories (or
+// files) into a block compressed .dds next to it, which the
+// game loads instead of the original when it's there
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler and SSE2, e.g.:
+//   g++ -std=c++20 -O2 -pthread -I. Tools/TextureCookerMain.cpp TextureCooker.cpp
+//       BlockCompression.cpp MipGenerator.cpp ImageDecoder.cpp PngDecoder.cpp
+//       JpegDecoder.cpp ThreadPool.cpp -o cook
+//   ./cook [--bc1] [--threads N] [--filter box|kaiser|lanczos]
+//          [--alpha-cutoff A] [--bench-mips] [textures/PBR ...]
+//
+// --bench-mips times mip generation for each texture
+// instead of cooking it
+// --------------------------------------------------------
+#include "ImageDecoder.h"
+#include "TextureCooker.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+	TextureCookOptions options = {};
+	options.Filter = MipFilterKaiser;
+	unsigned int threads = 0;
+	bool benchMips = false;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--bc1") options.PreferBC1 = true;
+		else if (arg == "--threads" && i + 1 < argc) threads = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--alpha-cutoff" && i + 1 < argc) options.AlphaCutoff = (float)atof(argv[++i]);
+		else if (arg == "--bench-mips") benchMips = true;
+		else if (arg == "--filter" && i + 1 < argc) {
+			std::string name = argv[++i];
+			if (name == "box") options.Filter = MipFilterBox;
+			else if (name == "kaiser") options.Filter = MipFilterKaiser;
+			else if (name == "lanczos") options.Filter = MipFilterLanczos;
+			else {
+				printf("unknown filter %s (box, kaiser or lanczos)\n", name.c_str());
+				return 1;
+			}
+		}
+		else inputs.push_back(arg);
+	}
+	if (inputs.empty()) inputs.push_back("textures");
+
+	// every png and jpg, sorted so the output is stable
+	std::vector<std::string> files;
+	for (auto& input : inputs) {
+		std::error_code ec;
+		if (std::filesystem::is_directory(input, ec)) {
+			for (auto& entry : std::filesystem::recursive_directory_iterator(input, ec))
+				if (entry.is_regular_file() && ImageDecoder::IsSupportedExtension(entry.path().extension().string()))
+					files.push_back(entry.path().string());
+		}
+		else files.push_back(input);
+	}
+	std::sort(files.begin(), files.end());
+
+	ThreadPool pool(threads);
+	if (benchMips) {
+		printf("Mip generation on 1 and %u threads\n", pool.GetThreadCount() + 1);
+		printf("%-48s %-8s %7s %9s %8s\n", "texture", "filter", "threads", "chain", "MP/s");
+		for (auto& file : files) {
+			DecodedImage image;
+			std::string error;
+			if (!ImageDecoder::DecodeFile(file, image, error)) {
+				printf("%-48s failed: %s\n", file.c_str(), error.c_str());
+				continue;
+			}
+			MipOptions mipOptions = TextureCooker::GetMipOptions(file, image);
+			mipOptions.AlphaCutoff = options.AlphaCutoff;
+			for (auto& r : MipGenerator::Benchmark(image, mipOptions, &pool, 5))
+				printf("%-48s %-8s %7u %7.1fms %8.1f\n", file.c_str(), MipGenerator::GetFilterName(r.Filter), r.Threads, r.Ms, r.MegapixelsPerSecond);
+		}
+		return 0;
+	}
+
+	printf("Cooking %u textures on %u threads\n", (unsigned int)files.size(), pool.GetThreadCount() + 1);
+	printf("Mips filtered with %s\n", MipGenerator::GetFilterName(options.Filter));
+	printf("%-48s %-4s %9s %4s %8s %9s %9s %9s %8s\n", "texture", "fmt", "size", "mips", "PSNR", "decode", "mips", "encode", "MP/s");
+
+	auto start = std::chrono::high_resolution_clock::now();
+	double megapixels = 0, encodeMs = 0;
+	size_t sourceBytes = 0, outputBytes = 0;
+	unsigned int failed = 0;
+	for (auto& file : files) {
+		TextureCookResult r = TextureCooker::Cook(file, options, &pool);
+		if (!r.Succeeded) {
+			printf("%-48s failed: %s\n", file.c_str(), r.Error.c_str());
+			failed++;
+			continue;
+		}
+		char size[32];
+		snprintf(size, sizeof(size), "%ux%u", r.Width, r.Height);
+		printf("%-48s %-4s %9s %4u %6.2fdB %7.1fms %7.1fms %7.1fms %8.1f%s\n",
+			file.c_str(), BlockCompression::GetName(r.Format), size, r.MipLevels, r.PSNR,
+			r.DecodeMs, r.MipMs, r.EncodeMs, r.Megapixels / (r.EncodeMs / 1000.0), r.RoughnessAdjusted ? " (toksvig)" : "");
+		megapixels += r.Megapixels;
+		encodeMs += r.EncodeMs;
+		sourceBytes += r.SourceBytes;
+		outputBytes += r.OutputBytes;
+	}
+
+	double totalMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("%u cooked, %u failed in %.0f ms | encode %.1f MP/s | %.1f MB of png -> %.1f MB of dds\n",
+		(unsigned int)files.size() - failed, failed, totalMs, megapixels / (encodeMs / 1000.0),
+		sourceBytes / 1048576.0, outputBytes / 1048576.0);
+	return failed == 0 ? 0 : 1;
+}
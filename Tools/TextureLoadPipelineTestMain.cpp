@@ -0,0 +1,228 @@
+// --------------------------------------------------------
+// Headless checks for TextureLoadPipeline
+//
+// - Every file in textures/ comes through once, decoded
+//   the same as ImageDecoder on its own, with its hash
+// - A budget smaller than any one image stalls reading,
+//   keeps one file in flight at a time (so they arrive in
+//   order) and peaks under the budget plus one file and
+//   its pixels, as do budgets a few files or a few images
+//   deep; an unlimited budget never stalls
+// - Missing, empty and corrupt files come back failed and
+//   are counted, while files that aren't images are kept
+//   as they are
+// - ImageDecoder::ReadSize, which the budget relies on,
+//   agrees with what decoding gives
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler and SSE2, e.g.:
+//   g++ -std=c++20 -O2 -pthread -I. Tools/TextureLoadPipelineTestMain.cpp TextureLoadPipeline.cpp
+//       ContentHash.cpp ImageDecoder.cpp PngDecoder.cpp JpegDecoder.cpp ThreadPool.cpp -o pipelinetest
+//   ./pipelinetest [scratch directory]
+// (or every headless test at once with make -C Tools check)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "TextureLoadPipeline.h"
+#include "ContentHash.h"
+#include "ImageDecoder.h"
+#include "ThreadPool.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// What each texture should come back as, from decoding it on its own
+struct Expected
+{
+	std::string Name;
+	std::vector<unsigned char> File;
+	DecodedImage Image;
+	size_t InFlightBytes;		// the file and its pixels, what the pipeline charges for it
+};
+
+std::vector<unsigned char> ReadWhole(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<unsigned char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+void WriteWhole(const std::filesystem::path& path, const std::vector<unsigned char>& bytes)
+{
+	std::ofstream file(path, std::ios::binary);
+	file.write((const char*)bytes.data(), bytes.size());
+}
+
+// Runs the pipeline, checking each result as it's created against the expected
+std::vector<unsigned int> RunAndCheck(ThreadPool& pool, const std::vector<std::wstring>& paths,
+	const std::vector<Expected>& expected, size_t budget, TextureLoadStats& stats)
+{
+	std::vector<unsigned int> arrived;
+	stats = TextureLoadPipeline::Run(pool, paths, budget, [&](TextureLoadResult& result) {
+		arrived.push_back(result.Index);
+		if (result.Index >= expected.size()) return;
+		const Expected& e = expected[result.Index];
+		Check(result.Succeeded && result.Error.empty(), e.Name + " loads (" + result.Error + ")");
+		Check(result.FileBytes == e.File.size(), e.Name + " file size");
+		Check(result.Hash == ContentHash::Hash64(e.File.data(), e.File.size()), e.Name + " hash");
+		Check(result.Contents.empty(), e.Name + " drops the file once decoded");
+		Check(result.Image.Width == e.Image.Width && result.Image.Height == e.Image.Height &&
+			result.Image.Pixels == e.Image.Pixels, e.Name + " decodes the same as ImageDecoder");
+	});
+	return arrived;
+}
+
+void CheckTextures()
+{
+	std::vector<std::filesystem::path> files;
+	std::error_code ec;
+	for (auto& entry : std::filesystem::recursive_directory_iterator("textures", ec))
+		if (entry.is_regular_file() && ImageDecoder::IsSupportedExtension(entry.path().extension().string()))
+			files.push_back(entry.path());
+	std::sort(files.begin(), files.end());
+	Check(files.size() >= 4, "textures/ has images (run from the repo root)");
+	if (files.size() < 4) return;
+
+	std::vector<Expected> expected;
+	std::vector<std::wstring> paths;
+	size_t smallest = SIZE_MAX, largest = 0, largestFile = 0, total = 0, fileBytes = 0;
+	for (auto& path : files) {
+		Expected e = {};
+		e.Name = path.generic_string();
+		e.File = ReadWhole(path);
+		std::string error;
+		Check(ImageDecoder::Decode(e.File.data(), e.File.size(), e.Image, error), e.Name + " decodes on its own (" + error + ")");
+
+		unsigned int width = 0, height = 0;
+		Check(ImageDecoder::ReadSize(e.File.data(), e.File.size(), width, height) &&
+			width == e.Image.Width && height == e.Image.Height, e.Name + " ReadSize matches its decoded size");
+
+		e.InFlightBytes = e.File.size() + e.Image.Pixels.size();
+		smallest = std::min(smallest, e.InFlightBytes);
+		largest = std::max(largest, e.InFlightBytes);
+		largestFile = std::max(largestFile, e.File.size());
+		total += e.InFlightBytes;
+		fileBytes += e.File.size();
+		expected.push_back(std::move(e));
+		paths.push_back(path.wstring());
+	}
+
+	ThreadPool pool(4);
+
+	// under any one image: every read after the first waits for the one before
+	// to be created, so they come in one at a time and in order
+	size_t budget = smallest / 2;
+	TextureLoadStats stats;
+	std::vector<unsigned int> arrived = RunAndCheck(pool, paths, expected, budget, stats);
+	std::vector<unsigned int> inOrder(paths.size());
+	for (unsigned int i = 0; i < inOrder.size(); i++) inOrder[i] = i;
+	Check(arrived == inOrder, "a tight budget has one file in flight at a time, so they arrive in order");
+	Check(stats.Files == paths.size() && stats.Failed == 0, "a tight budget loads every file");
+	Check(stats.Stalls > 0, "a tight budget stalls reading");
+	Check(stats.Stalls <= paths.size() - 1, "reading stalls at most once per file after the first");
+	Check(stats.PeakBytesInFlight <= budget + largest, "a tight budget peaks under the budget plus one file and its pixels");
+	Check(stats.PeakBytesInFlight >= largest, "each file counts its pixels while in flight");
+	Check(stats.BytesRead == fileBytes, "bytes read are the files' sizes");
+
+	// a few files deep, but not their pixels: counting files only until they're
+	// decoded would read several and then have all of them grow past the budget
+	budget = largestFile * 4;
+	arrived = RunAndCheck(pool, paths, expected, budget, stats);
+	std::sort(arrived.begin(), arrived.end());
+	Check(arrived == inOrder, "a few files of budget reports every file once");
+	Check(stats.Failed == 0, "a few files of budget loads every file");
+	Check(stats.PeakBytesInFlight <= budget + largest, "a few files of budget peaks under the budget plus one file and its pixels");
+
+	// a few images deep, with several in flight at once
+	budget = largest * 3;
+	arrived = RunAndCheck(pool, paths, expected, budget, stats);
+	std::sort(arrived.begin(), arrived.end());
+	Check(arrived == inOrder, "a few images of budget reports every file once");
+	Check(stats.Failed == 0, "a few images of budget loads every file");
+	Check(stats.PeakBytesInFlight <= budget + largest, "a few images of budget peaks under the budget plus one file and its pixels");
+
+	// no limit: reading never waits, and nothing's charged twice
+	arrived = RunAndCheck(pool, paths, expected, SIZE_MAX, stats);
+	std::sort(arrived.begin(), arrived.end());
+	Check(arrived == inOrder, "an unlimited budget reports every file once");
+	Check(stats.Stalls == 0, "an unlimited budget never stalls");
+	Check(stats.PeakBytesInFlight <= total, "an unlimited budget peaks at most at everything in flight");
+	Check(stats.BytesRead == fileBytes, "an unlimited budget reads each file once");
+}
+
+void CheckFailures(const std::filesystem::path& dir)
+{
+	// a real PNG to break, and one that isn't an image at all
+	std::vector<unsigned char> png = ReadWhole("textures/Skies/up.png");
+	Check(png.size() > 100, "textures/Skies/up.png is there to corrupt");
+	if (png.size() <= 100) return;
+	std::vector<unsigned char> corrupt = png;
+	corrupt[corrupt.size() / 2] ^= 0xFF;
+	WriteWhole(dir / "corrupt.png", corrupt);
+	WriteWhole(dir / "empty.png", {});
+	std::vector<unsigned char> text = { 'n', 'o', 't', ' ', 'a', 'n', ' ', 'i', 'm', 'a', 'g', 'e' };
+	WriteWhole(dir / "notes.txt", text);
+
+	std::vector<std::wstring> paths = {
+		(dir / "missing.png").wstring(),
+		(dir / "corrupt.png").wstring(),
+		(dir / "empty.png").wstring(),
+		(dir / "notes.txt").wstring(),
+		(dir / "missing.png").wstring(),
+	};
+
+	ThreadPool pool(2);
+	std::vector<TextureLoadResult> results(paths.size());
+	std::vector<unsigned int> seen(paths.size(), 0);
+	TextureLoadStats stats = TextureLoadPipeline::Run(pool, paths, 1, [&](TextureLoadResult& result) {
+		seen[result.Index]++;
+		results[result.Index] = std::move(result);
+	});
+
+	Check(seen == std::vector<unsigned int>(paths.size(), 1), "every file, failed or not, is reported once");
+	Check(stats.Failed == 4, "missing, corrupt and empty files are counted as failed");
+	Check(!results[0].Succeeded && !results[0].Error.empty() && results[0].FileBytes == 0, "a missing file fails to read");
+	Check(!results[4].Succeeded && results[4].FileBytes == 0, "the same missing file fails again");
+	Check(!results[1].Succeeded && !results[1].Error.empty() && results[1].Image.Pixels.empty(), "a corrupt PNG fails to decode");
+	Check(results[1].FileBytes == corrupt.size(), "a corrupt PNG was still read");
+	Check(!results[2].Succeeded && !results[2].Error.empty(), "an empty file fails");
+	Check(results[3].Succeeded && results[3].Contents == text, "a file that isn't an image is kept as it is");
+	Check(results[3].Hash == ContentHash::Hash64(text.data(), text.size()), "a file that isn't an image is still hashed");
+	Check(stats.BytesRead == corrupt.size() + text.size(), "only what was read counts as read");
+}
+
+void CheckReadSize()
+{
+	// a JPEG's size comes from its start of frame, after whatever segments are first
+	const unsigned char jpeg[] = {
+		0xFF, 0xD8,
+		0xFF, 0xE0, 0x00, 0x06, 'J', 'F', 'I', 'F',
+		0xFF, 0xDB, 0x00, 0x02,
+		0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x01, 0x2C, 0x02, 0x80, 0x01, 0x01, 0x11, 0x00,
+	};
+	unsigned int width = 0, height = 0;
+	Check(ImageDecoder::ReadSize(jpeg, sizeof(jpeg), width, height) && width == 640 && height == 300, "ReadSize finds a JPEG's frame");
+	Check(!ImageDecoder::ReadSize(jpeg, 14, width, height), "ReadSize fails on a JPEG cut before its frame");
+
+	const unsigned char text[] = "not an image at all";
+	Check(!ImageDecoder::ReadSize(text, sizeof(text), width, height), "ReadSize fails on something that isn't an image");
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path dir = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::temp_directory_path() / "TextureLoadPipelineTest";
+	std::error_code ec;
+	std::filesystem::create_directories(dir, ec);
+
+	CheckTextures();
+	CheckFailures(dir);
+	CheckReadSize();
+
+	std::filesystem::remove_all(dir, ec);
+	return FinishChecks();
+}
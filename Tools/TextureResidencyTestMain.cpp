@@ -0,0 +1,389 @@
+// --------------------------------------------------------
+// Headless checks for texture streaming
+//
+// - TextureResidency: loads within the budget, settling for
+//   coarser levels or waiting when they don't fit, loads in
+//   flight, least recently used eviction (unrequested
+//   textures before visible ones), a shrinking budget and
+//   failed loads
+// - TextureMipReader: partial reads of .dds files made here
+//   (DX10 and DXT1 headers), from memory and from disk,
+//   including files cut short after the levels asked for
+//
+// Build and run from the repo root, on any platform with
+// a C++20 compiler and SSE2, e.g.:
+//   g++ -std=c++20 -O2 -pthread -I. Tools/TextureResidencyTestMain.cpp TextureStreaming.cpp
+//       ImageDecoder.cpp PngDecoder.cpp JpegDecoder.cpp TextureCooker.cpp MipGenerator.cpp
+//       BlockCompression.cpp ThreadPool.cpp -o residencytest
+//   ./residencytest [scratch directory]
+// (or every headless test at once with make -C Tools check)
+//
+// Prints every failed check and exits with 1 if there were any
+// --------------------------------------------------------
+#include "TextureStreaming.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Bytes in each level of a square RGBA8 texture
+std::vector<size_t> MipBytes(unsigned int size)
+{
+	std::vector<size_t> bytes;
+	for (unsigned int mip = 0; mip < TextureMipReader::CountMips(size, size); mip++)
+		bytes.push_back(TextureMipReader::GetMipBytes(TextureMipReader::FormatRGBA8, size, size, mip));
+	return bytes;
+}
+
+size_t BytesFrom(const std::vector<size_t>& mips, unsigned int mip)
+{
+	size_t bytes = 0;
+	for (size_t i = mip; i < mips.size(); i++) bytes += mips[i];
+	return bytes;
+}
+
+bool Has(const std::vector<TextureResidencyChange>& changes, unsigned int texture, unsigned int topMip, bool load)
+{
+	for (auto& c : changes)
+		if (c.Texture == texture && c.TopMip == topMip && c.Load == load) return true;
+	return false;
+}
+
+unsigned int CountLoads(const std::vector<TextureResidencyChange>& changes)
+{
+	unsigned int loads = 0;
+	for (auto& c : changes) if (c.Load) loads++;
+	return loads;
+}
+
+// Finishes every load in a plan
+void FinishAll(TextureResidency& residency, const std::vector<TextureResidencyChange>& changes)
+{
+	for (auto& c : changes) if (c.Load) residency.Finish(c.Texture, true);
+}
+
+// --------------------------------------------------------
+// Residency
+// --------------------------------------------------------
+void CheckLoads()
+{
+	// 256x256 is 9 levels; a tail from mip 4 (16x16) down
+	std::vector<size_t> mips = MipBytes(256);
+	const size_t tail = BytesFrom(mips, 4);
+
+	TextureResidency residency(100 * 1024 * 1024, 8);
+	unsigned int t = residency.Add(mips, 4);
+	Check(residency.GetResidentMip(t) == 4 && residency.GetResidentBytes(t) == tail, "a new texture holds its tail");
+	Check(residency.GetStats().ResidentBytes == tail, "the tail counts against the budget");
+
+	// nothing requested, nothing to do
+	residency.BeginFrame();
+	Check(residency.Plan().empty(), "nothing requested plans nothing");
+
+	// requests round down, and the finest one wins
+	residency.BeginFrame();
+	residency.Request(t, 2.9f);
+	residency.Request(t, 1.2f);
+	residency.Request(t, 3.0f);
+	Check(residency.GetWantedMip(t) == 1, "the finest request wins, rounded down");
+	std::vector<TextureResidencyChange> changes = residency.Plan();
+	Check(changes.size() == 1 && Has(changes, t, 1, true), "one load down to the wanted mip");
+	Check(residency.IsLoading(t) && residency.GetResidentMip(t) == 4, "loading, and still at the tail until it finishes");
+
+	TextureResidencyStats s = residency.GetStats();
+	Check(s.PendingBytes == BytesFrom(mips, 1) - tail && s.ResidentBytes == tail && s.LoadsInFlight == 1, "a load in flight is pending, not resident");
+	Check(residency.Plan().empty(), "a texture that's loading isn't planned again");
+
+	residency.Finish(t, true);
+	s = residency.GetStats();
+	Check(residency.GetResidentMip(t) == 1 && s.ResidentBytes == BytesFrom(mips, 1) && s.PendingBytes == 0 && s.LoadsFinished == 1, "finished loads are resident");
+
+	// requests past the tail, or negative, are clamped
+	residency.BeginFrame();
+	residency.Request(t, 20.0f);
+	Check(residency.GetWantedMip(t) == 4, "a request coarser than the tail wants the tail");
+	residency.BeginFrame();
+	residency.Request(t, -3.0f);
+	Check(residency.GetWantedMip(t) == 0, "a negative request wants mip 0");
+
+	// at most maxLoadsInFlight at once, biggest gap first
+	TextureResidency limited(100 * 1024 * 1024, 2);
+	unsigned int a = limited.Add(mips, 4), b = limited.Add(mips, 4), c = limited.Add(mips, 4);
+	limited.BeginFrame();
+	limited.Request(a, 3);
+	limited.Request(b, 0);
+	limited.Request(c, 2);
+	changes = limited.Plan();
+	Check(CountLoads(changes) == 2 && Has(changes, b, 0, true) && Has(changes, c, 2, true), "two in flight, the furthest behind first");
+	Check(limited.Plan().empty(), "no more until one finishes");
+	limited.Finish(b, true);
+	changes = limited.Plan();
+	Check(CountLoads(changes) == 1 && Has(changes, a, 3, true), "the next goes out when one finishes");
+	Check(limited.GetStats().LoadsStarted == 3, "three started");
+}
+
+void CheckBudget()
+{
+	std::vector<size_t> mips = MipBytes(256);
+	const size_t tail = BytesFrom(mips, 4);
+
+	// room for the tail and mips 3 and 2, but not 1
+	size_t budget = BytesFrom(mips, 2);
+	TextureResidency residency(budget, 8);
+	unsigned int t = residency.Add(mips, 4);
+	residency.BeginFrame();
+	residency.Request(t, 0);
+	std::vector<TextureResidencyChange> changes = residency.Plan();
+	Check(Has(changes, t, 2, true), "a load that doesn't fit settles for the finest level that does");
+	residency.Finish(t, true);
+	Check(residency.GetStats().ResidentBytes <= budget, "resident stays within the budget");
+
+	// nothing finer fits at all: it waits
+	TextureResidency tight(tail + mips[3] - 1, 8);
+	t = tight.Add(mips, 4);
+	tight.BeginFrame();
+	tight.Request(t, 0);
+	changes = tight.Plan();
+	Check(changes.empty() && tight.GetStats().Deferred == 1, "a load with no room at all is deferred");
+	Check(tight.GetStats().WantedBytes == BytesFrom(mips, 0), "wanted bytes count what was asked for");
+
+	// the budget shrinking evicts down to it
+	TextureResidency shrinking(100 * 1024 * 1024, 8);
+	unsigned int x = shrinking.Add(mips, 4);
+	unsigned int y = shrinking.Add(mips, 4);
+	shrinking.BeginFrame();
+	shrinking.Request(x, 0);
+	shrinking.Request(y, 0);
+	FinishAll(shrinking, shrinking.Plan());
+	Check(shrinking.GetResidentMip(x) == 0 && shrinking.GetResidentMip(y) == 0, "both fully resident");
+
+	shrinking.BeginFrame();	// nobody asks for anything now
+	shrinking.SetBudget(BytesFrom(mips, 0) + tail);
+	changes = shrinking.Plan();
+	TextureResidencyStats s = shrinking.GetStats();
+	Check(s.ResidentBytes <= shrinking.GetBudget(), "a smaller budget evicts down to it");
+	Check(CountLoads(changes) == 0 && s.Evictions >= 1, "by evicting, without loading");
+
+	// the textures can't go below their tails, even when that's over the budget
+	shrinking.SetBudget(1);
+	shrinking.Plan();
+	Check(shrinking.GetResidentMip(x) == 4 && shrinking.GetResidentMip(y) == 4 && shrinking.GetStats().ResidentBytes == 2 * tail,
+		"a budget smaller than the tails evicts everything but them");
+}
+
+void CheckEviction()
+{
+	std::vector<size_t> mips = MipBytes(256);
+	const size_t tail = BytesFrom(mips, 4);
+	const size_t full = BytesFrom(mips, 0);
+
+	// room for three tails, two full textures and all but mip 0 of a third
+	TextureResidency residency(3 * tail + 3 * (full - tail) - mips[0], 8);
+	unsigned int a = residency.Add(mips, 4), b = residency.Add(mips, 4), c = residency.Add(mips, 4);
+
+	// frame 1: a, frame 2: b, both fully loaded
+	residency.BeginFrame();
+	residency.Request(a, 0);
+	FinishAll(residency, residency.Plan());
+	residency.BeginFrame();
+	residency.Request(b, 0);
+	FinishAll(residency, residency.Plan());
+	Check(residency.GetResidentMip(a) == 0 && residency.GetResidentMip(b) == 0, "a and b fully resident");
+
+	// frame 3: c needs room, and a was used longest ago
+	residency.BeginFrame();
+	residency.Request(c, 0);
+	std::vector<TextureResidencyChange> changes = residency.Plan();
+	Check(Has(changes, c, 0, true), "c loads in full");
+	Check(residency.GetResidentMip(a) == 1 && residency.GetResidentMip(b) == 0, "the least recently used texture loses only the level it takes, the other keeps everything");
+	Check(!changes.empty() && !changes[0].Load && changes[0].Texture == a, "evictions come before the load they make room for");
+	Check(residency.GetStats().ResidentBytes + residency.GetStats().PendingBytes <= residency.GetBudget(), "resident plus pending fit the budget");
+
+	residency.Finish(c, true);
+
+	// frame 4: c and b are visible, but b only needs mip 2; a (unrequested) goes before b's spare levels
+	residency.BeginFrame();
+	residency.Request(b, 2);
+	residency.Request(c, 0);
+	residency.Request(a, 0);
+	changes = residency.Plan();
+	Check(Has(changes, a, 0, true), "a comes back in full");
+	Check(residency.GetResidentMip(b) > 0 && residency.GetResidentMip(c) == 0, "the room comes from levels finer than b asked for, not c");
+	Check(residency.GetResidentMip(b) <= 2, "but b keeps what it asked for");
+	residency.Finish(a, true);
+
+	// a texture that's loading isn't evicted to make room
+	TextureResidency busy(2 * tail + (full - tail), 8);
+	unsigned int p = busy.Add(mips, 4), q = busy.Add(mips, 4);
+	busy.BeginFrame();
+	busy.Request(p, 0);
+	busy.Plan();
+	busy.BeginFrame();
+	busy.Request(q, 0);
+	changes = busy.Plan();
+	Check(busy.IsLoading(p) && busy.GetResidentMip(p) == 4 && CountLoads(changes) == 0, "loads in flight hold their room");
+}
+
+void CheckFailures()
+{
+	std::vector<size_t> mips = MipBytes(64);
+	TextureResidency residency(100 * 1024 * 1024, 8);
+	unsigned int t = residency.Add(mips, 3);
+	size_t before = residency.GetStats().ResidentBytes;
+
+	residency.BeginFrame();
+	residency.Request(t, 0);
+	residency.Plan();
+	residency.Finish(t, false);
+	TextureResidencyStats s = residency.GetStats();
+	Check(residency.GetResidentMip(t) == 3 && s.ResidentBytes == before && s.PendingBytes == 0 && s.LoadsFailed == 1, "a failed load gives its room back");
+
+	residency.BeginFrame();
+	residency.Request(t, 0);
+	Check(residency.Plan().empty(), "a failed texture isn't retried");
+	residency.Finish(t, true);
+	Check(residency.GetResidentMip(t) == 3 && residency.GetStats().LoadsFinished == 0, "finishing a texture that isn't loading does nothing");
+}
+
+void CheckDesiredMip()
+{
+	// a 1024 texture on a unit sphere: every doubling of distance or tiling is a mip coarser
+	float near = TextureResidency::GetDesiredMip(1024, 1, 1, 2, 1.0f, 512);
+	float far = TextureResidency::GetDesiredMip(1024, 1, 1, 4, 1.0f, 512);
+	Check(fabsf(far - near - 1.0f) < 1e-4f, "twice as far is one mip coarser");
+	Check(fabsf(TextureResidency::GetDesiredMip(1024, 2, 1, 2, 1.0f, 512) - near - 1.0f) < 1e-4f, "twice the tiling is one mip coarser");
+	Check(TextureResidency::GetDesiredMip(1024, 1, 1, 0, 1.0f, 512) == 0.0f, "inside the bounds wants mip 0");
+	Check(TextureResidency::GetDesiredMip(16, 1, 1, 0.01f, 1.0f, 2160) == 0.0f, "never finer than mip 0");
+}
+
+// --------------------------------------------------------
+// DDS files
+// --------------------------------------------------------
+void PutU32(std::vector<unsigned char>& bytes, size_t at, uint32_t value)
+{
+	memcpy(bytes.data() + at, &value, 4);
+}
+
+// A .dds whose every byte in level m is m + 1 (so reads from the wrong offset show)
+std::vector<unsigned char> MakeDDS(unsigned int width, unsigned int height, unsigned int format, bool dx10)
+{
+	unsigned int levels = TextureMipReader::CountMips(width, height);
+	std::vector<unsigned char> file(dx10 ? 148 : 128, 0);
+	PutU32(file, 0, 0x20534444);	// "DDS "
+	PutU32(file, 4, 124);
+	PutU32(file, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000);
+	PutU32(file, 12, height);
+	PutU32(file, 16, width);
+	PutU32(file, 28, levels);
+	PutU32(file, 76, 32);
+	PutU32(file, 80, 0x4);	// fourCC
+	PutU32(file, 84, dx10 ? 0x30315844 : 0x31545844);	// "DX10" or "DXT1"
+	if (dx10) {
+		PutU32(file, 128, format);
+		PutU32(file, 132, 3);	// 2D
+		PutU32(file, 140, 1);	// one array slice
+	}
+	for (unsigned int mip = 0; mip < levels; mip++)
+		file.resize(file.size() + TextureMipReader::GetMipBytes(format, width, height, mip), (unsigned char)(mip + 1));
+	return file;
+}
+
+bool LevelsAre(const TextureMips& mips, unsigned int format, unsigned int width, unsigned int height)
+{
+	for (unsigned int i = 0; i < mips.Levels.size(); i++) {
+		unsigned int mip = mips.FirstMip + i;
+		if (mips.Levels[i].size() != TextureMipReader::GetMipBytes(format, width, height, mip)) return false;
+		for (unsigned char b : mips.Levels[i]) if (b != mip + 1) return false;
+	}
+	return true;
+}
+
+void CheckDDS(const std::filesystem::path& dir)
+{
+	const unsigned int RGBA8 = TextureMipReader::FormatRGBA8;
+	std::vector<unsigned char> dds = MakeDDS(64, 32, RGBA8, true);
+	TextureMips mips;
+	std::string error;
+
+	// from memory
+	Check(TextureMipReader::ReadDDS(dds.data(), dds.size(), 0, 100, mips, error), "whole DX10 .dds reads");
+	Check(mips.Width == 64 && mips.Height == 32 && mips.MipLevels == 7 && mips.Format == RGBA8 && mips.FirstMip == 0 && mips.Levels.size() == 7,
+		"DX10 .dds layout");
+	Check(LevelsAre(mips, RGBA8, 64, 32), "every level from the right offset");
+
+	Check(TextureMipReader::ReadDDS(dds.data(), dds.size(), 2, 3, mips, error) && mips.FirstMip == 2 && mips.Levels.size() == 3
+		&& LevelsAre(mips, RGBA8, 64, 32), "levels 2 to 4 only");
+	Check(TextureMipReader::ReadDDS(dds.data(), dds.size(), 5, 10, mips, error) && mips.Levels.size() == 2, "count clamped to the levels there");
+	Check(TextureMipReader::ReadDDS(dds.data(), dds.size(), 40, 1, mips, error) && mips.FirstMip == 6 && mips.Levels.size() == 1,
+		"first mip clamped to the last level");
+
+	// cut short: levels before the cut still read, levels after it don't
+	size_t throughMip2 = 148;
+	for (unsigned int mip = 0; mip <= 2; mip++) throughMip2 += TextureMipReader::GetMipBytes(RGBA8, 64, 32, mip);
+	Check(TextureMipReader::ReadDDS(dds.data(), throughMip2, 0, 3, mips, error), "levels before a cut read");
+	error.clear();
+	Check(!TextureMipReader::ReadDDS(dds.data(), throughMip2, 2, 2, mips, error) && error.find("missing mips") != std::string::npos,
+		"levels past a cut fail");
+	Check(!TextureMipReader::ReadDDS(dds.data(), 140, 0, 1, mips, error), "a DX10 header cut short fails");
+
+	// legacy DXT1 header
+	std::vector<unsigned char> dxt1 = MakeDDS(32, 32, TextureMipReader::FormatBC1, false);
+	Check(TextureMipReader::ReadDDS(dxt1.data(), dxt1.size(), 1, 2, mips, error) && mips.Format == TextureMipReader::FormatBC1
+		&& mips.Levels.size() == 2 && LevelsAre(mips, TextureMipReader::FormatBC1, 32, 32), "DXT1 .dds, levels 1 and 2");
+	Check(mips.Levels.size() == 2 && mips.Levels[0].size() == 4 * 4 * 8 && mips.Levels[1].size() == 2 * 2 * 8, "BC1 level sizes in whole blocks");
+
+	// not a .dds, or a format it can't size
+	std::vector<unsigned char> bad = dds;
+	bad[0] = 'X';
+	Check(!TextureMipReader::ReadDDS(bad.data(), bad.size(), 0, 1, mips, error), "bad magic fails");
+	bad = dds;
+	PutU32(bad, 128, 2);	// R32G32B32A32_FLOAT
+	Check(!TextureMipReader::ReadDDS(bad.data(), bad.size(), 0, 1, mips, error) && error.find("unsupported") != std::string::npos, "unknown format fails");
+
+	// from disk: only the header and the levels asked for are read, so a file cut short after them still works
+	std::filesystem::path path = dir / "test.dds";
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write((const char*)dds.data(), throughMip2);
+	}
+	Check(TextureMipReader::ReadFile(path.wstring(), 1, 2, mips, error) && mips.FirstMip == 1 && mips.Levels.size() == 2
+		&& LevelsAre(mips, RGBA8, 64, 32), "levels 1 and 2 of a file cut after level 2");
+	Check(TextureMipReader::ReadFile(path.wstring(), 0, 3, mips, error) && LevelsAre(mips, RGBA8, 64, 32), "levels 0 to 2 of the same file");
+	error.clear();
+	Check(!TextureMipReader::ReadFile(path.wstring(), 2, 2, mips, error) && error.find("missing mips") != std::string::npos,
+		"a level past the cut fails");
+	Check(!TextureMipReader::ReadFile((dir / "missing.dds").wstring(), 0, 1, mips, error), "a missing file fails");
+
+	// the whole file on disk, read in the pieces the streamer would ask for
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write((const char*)dds.data(), dds.size());
+	}
+	bool pieces = true;
+	for (unsigned int mip = 0; mip < 7; mip++)
+		pieces = pieces && TextureMipReader::ReadFile(path.wstring(), mip, 1, mips, error) && mips.FirstMip == mip && LevelsAre(mips, RGBA8, 64, 32);
+	Check(pieces, "each level on its own");
+}
+
+int main(int argc, char** argv)
+{
+	std::filesystem::path dir = argc > 1 ? std::filesystem::path(argv[1]) : std::filesystem::temp_directory_path() / "TextureResidencyTest";
+	std::error_code ec;
+	std::filesystem::create_directories(dir, ec);
+
+	CheckLoads();
+	CheckBudget();
+	CheckEviction();
+	CheckFailures();
+	CheckDesiredMip();
+	CheckDDS(dir);
+
+	std::filesystem::remove_all(dir, ec);
+	return FinishChecks();
+}
@@ -16,6 +16,7 @@ Transform::Transform()
     worldInverseTranspose = DirectX::XMFLOAT4X4(world);
 
     dirty = false;
+    version = 0;
 }
 
 Transform::~Transform()
@@ -28,52 +29,49 @@ Transform::Transform(Transform& t)
     rotation = t.rotation;
     scale = t.scale;
     dirty = t.dirty;
+    version = t.version;
     world = t.world;
     worldInverseTranspose = t.worldInverseTranspose;
 }
 
 void Transform::SetPosition(float _x, float _y, float _z)
 {
-    position.x = _x;
-    position.y = _y;
-    position.z = _z;
-    dirty = true;
+    SetPosition(DirectX::XMFLOAT3(_x, _y, _z));
 }
 
 void Transform::SetPosition(DirectX::XMFLOAT3 _pos)
 {
+    // setting the same value isn't a change
+    if (_pos.x == position.x && _pos.y == position.y && _pos.z == position.z) return;
+
     position = _pos;
-    dirty = true;
+    MarkChanged();
 }
 
 void Transform::SetRotation(float _pitch, float _yaw, float _roll)
 {
-    position.x = _pitch;
-    position.y = _yaw;
-    position.z = _roll;
-
-    dirty = true;
+    SetRotation(DirectX::XMFLOAT3(_pitch, _yaw, _roll));
 }
 
 void Transform::SetRotation(DirectX::XMFLOAT3 _rot)
 {
+    if (_rot.x == rotation.x && _rot.y == rotation.y && _rot.z == rotation.z) return;
+
     rotation = _rot;
-    dirty = true;
+    MarkChanged();
 }
 
 void Transform::SetScale(float _x, float _y, float _z)
 {
-    scale.x = _x;
-    scale.y = _y;
-    scale.z = _z;
-
-    dirty = true;
+    SetScale(DirectX::XMFLOAT3(_x, _y, _z));
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 _scale)
 {
+    if (_scale.x == scale.x && _scale.y == scale.y && _scale.z == scale.z) return;
+
     scale = _scale;
-    dirty = true;
+    MarkChanged();
 }
 
 DirectX::XMFLOAT3 Transform::GetPosition()
@@ -114,6 +112,11 @@ DirectX::XMFLOAT4X4 Transform::GetInverseTransposeWorldMatrix()
     return worldInverseTranspose;
 }
 
+unsigned int Transform::GetVersion()
+{
+    return version;
+}
+
 DirectX::XMFLOAT3 Transform::GetRight()
 {
     DirectX::XMVECTOR worldRight = DirectX::XMVectorSet(1, 0, 0, 0);
@@ -177,7 +180,7 @@ void Transform::MoveAbsolute(float _x, float _y, float _z)
     // math to storage
     DirectX::XMStoreFloat3(&position, curr);
 
-    dirty = true;
+    MarkChanged();
 }
 
 void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
@@ -192,7 +195,7 @@ void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
     // math to storage
     DirectX::XMStoreFloat3(&position, curr);
 
-    dirty = true;
+    MarkChanged();
 }
 
 void Transform::Rotate(float _pitch, float _yaw, float _roll)
@@ -207,7 +210,7 @@ void Transform::Rotate(float _pitch, float _yaw, float _roll)
     // math to storage
     DirectX::XMStoreFloat3(&rotation, curr);
 
-    dirty = true;
+    MarkChanged();
 }
 
 void Transform::Rotate(DirectX::XMFLOAT3 _rotation)
@@ -222,7 +225,7 @@ void Transform::Rotate(DirectX::XMFLOAT3 _rotation)
     // math storage
     DirectX::XMStoreFloat3(&rotation, curr);
 
-    dirty = true;
+    MarkChanged();
 }
 
 void Transform::Scale(float _x, float _y, float _z)
@@ -237,7 +240,7 @@ void Transform::Scale(float _x, float _y, float _z)
     // math to storage
     DirectX::XMStoreFloat3(&scale, curr);
 
-    dirty = true;
+    MarkChanged();
 }
 
 void Transform::Scale(DirectX::XMFLOAT3 _scale)
@@ -252,7 +255,7 @@ void Transform::Scale(DirectX::XMFLOAT3 _scale)
     // math to storage
     DirectX::XMStoreFloat3(&scale, curr);
 
-    dirty = true;
+    MarkChanged();
 
 }
 
@@ -274,6 +277,8 @@ void Transform::MoveRelative(float _x, float _y, float _z)
     position.x += move.x;
     position.y += move.y;
     position.z += move.z;
+
+    MarkChanged();
 }
 
 void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
@@ -293,4 +298,12 @@ void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
     position.x += move.x;
     position.y += move.y;
     position.z += move.z;
+
+    MarkChanged();
+}
+
+void Transform::MarkChanged()
+{
+    dirty = true;
+    version++;
 }
@@ -27,6 +27,7 @@ public:
 	DirectX::XMFLOAT3 GetRight();
 	DirectX::XMFLOAT3 GetUp();
 	DirectX::XMFLOAT3 GetForward();
+	unsigned int GetVersion();	// bumps every time the transform actually changes
 
 
 	// TRANSFORMERS
@@ -41,6 +42,9 @@ public:
 
 private:
 	bool dirty; // tracks if any of the world matrix's components have changed this frame
+	unsigned int version;	// change counter, so others can tell if we moved since they last looked
+
+	void MarkChanged();
 	
 	DirectX::XMFLOAT3 position;
 	DirectX::XMFLOAT3 rotation;	// pitch, yaw, roll stored as x, y, z
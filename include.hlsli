@@ -212,6 +212,22 @@ float3 MicroFacetBRDF(float3 n, float3 l, float3 v, float roughness, float3 spec
     return specularResult * max(dot(n, l), 0);
 }
 
+// 9 coefficient spherical harmonics at a direction
+// - the coefficients' rgb, in the order IBLBaker.cpp projects them
+float3 EvaluateSH(float4 sh[9], float3 n)
+{
+    float3 result = sh[0].rgb * 0.282095f
+        + sh[1].rgb * 0.488603f * n.y
+        + sh[2].rgb * 0.488603f * n.z
+        + sh[3].rgb * 0.488603f * n.x
+        + sh[4].rgb * 1.092548f * n.x * n.y
+        + sh[5].rgb * 1.092548f * n.y * n.z
+        + sh[6].rgb * 0.315392f * (3 * n.z * n.z - 1)
+        + sh[7].rgb * 1.092548f * n.x * n.z
+        + sh[8].rgb * 0.546274f * (n.x * n.x - n.y * n.y);
+    return max(result, 0);
+}
+
 // directional light calculation
 float3 DirectionalLight(Light light, float3 normal, float3 worldPos, float3 camPos, float roughness, float metalness, float3 surfaceColor, float3 specular)
 {